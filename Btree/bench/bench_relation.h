@@ -0,0 +1,118 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "file.h"
+#include "page.h"
+#include "exceptions/file_not_found_exception.h"
+#include "exceptions/insufficient_space_exception.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Records of the relations the benchmarks index, those of the tests.
+ */
+struct BenchRecord
+{
+	int i;
+	double d;
+	char s[64];
+};
+
+/**
+ * Orders of the keys of a relation, as createRelationForward, createRelationBackward and
+ * createRelationRandom insert them.
+ */
+enum KeyOrder
+{
+	FORWARD,
+	BACKWARD,
+	RANDOM
+};
+
+/**
+ * Remove a file if it exists.
+ * @param name Name of the file
+ */
+inline void removeBenchFile(const std::string &name)
+{
+	try
+	{
+		File::remove(name);
+	}
+	catch (const FileNotFoundException &e)
+	{
+	}
+}
+
+/**
+ * Make the keys 0 to size - 1 in an order.
+ * @param size Number of keys
+ * @param order Order of the keys
+ * @return the keys
+ */
+inline std::vector<int> makeBenchKeys(int size, KeyOrder order)
+{
+	std::vector<int> keys(size);
+	for (int i = 0; i < size; i++)
+	{
+		keys[i] = order == BACKWARD ? size - 1 - i : i;
+	}
+	if (order == RANDOM)
+	{
+		for (int i = size - 1; i > 0; i--)
+		{
+			std::swap(keys[i], keys[random() % (i + 1)]);
+		}
+	}
+	return keys;
+}
+
+/**
+ * Create a relation of the records of keys, in their order, replacing the file if it exists.
+ * @param name Name of the relation file
+ * @param keys Keys of the records
+ */
+inline void createBenchRelation(const std::string &name, const std::vector<int> &keys)
+{
+	removeBenchFile(name);
+	PageFile file(name, true);
+	BenchRecord record;
+	memset(&record, 0, sizeof(record));
+	PageId pageNo;
+	Page page = file.allocatePage(pageNo);
+	for (int key : keys)
+	{
+		snprintf(record.s, sizeof(record.s), "%05d string record", key);
+		record.i = key;
+		record.d = key;
+		std::string data(reinterpret_cast<char *>(&record), sizeof(record));
+		while (true)
+		{
+			try
+			{
+				page.insertRecord(data);
+				break;
+			}
+			catch (const InsufficientSpaceException &e)
+			{
+				file.writePage(pageNo, page);
+				page = file.allocatePage(pageNo);
+			}
+		}
+	}
+	file.writePage(pageNo, page);
+}
+
+}
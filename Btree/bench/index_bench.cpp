@@ -0,0 +1,259 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+// Micro and macro benchmarks of the index engines, the buffer manager and the file scan, built by
+// "make bench" with Google Benchmark. Each case takes the relation size and the number of frames of the
+// pool as arguments; "make bench CFLAGS='-std=c++17 -O2 -pthread'" after "make clean" builds them optimized.
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "bench_relation.h"
+#include "btree.h"
+#include "art_index.h"
+#include "filescan.h"
+#include "exceptions/end_of_file_exception.h"
+
+using namespace badgerdb;
+
+namespace {
+
+const std::string relationName = "benchRel";
+const std::string pagesName = "benchPages";
+
+/**
+ * Open an index of either engine on the INTEGER attribute of the relation.
+ */
+template <class Index>
+std::unique_ptr<Index> openIndex(BufMgr *bufMgr, std::string &indexName);
+
+template <>
+std::unique_ptr<BTreeIndex> openIndex<BTreeIndex>(BufMgr *bufMgr, std::string &indexName)
+{
+	return std::unique_ptr<BTreeIndex>(new BTreeIndex(relationName, indexName, bufMgr, offsetof(BenchRecord, i), INTEGER));
+}
+
+template <>
+std::unique_ptr<ArtIndex> openIndex<ArtIndex>(BufMgr *bufMgr, std::string &indexName)
+{
+	indexName.clear();
+	return std::unique_ptr<ArtIndex>(new ArtIndex(relationName, bufMgr, offsetof(BenchRecord, i), INTEGER));
+}
+
+/**
+ * Report the share of the page accesses which read the disk.
+ */
+void reportMisses(benchmark::State &state, BufMgr &bufMgr)
+{
+	BufStats stats = bufMgr.getBufStats();
+	state.counters["missRatio"] = stats.accesses > 0 ? (double)stats.diskreads / stats.accesses : 0;
+}
+
+// -----------------------------------------------------------------------------
+// Index insertions
+// -----------------------------------------------------------------------------
+
+template <class Index, KeyOrder order>
+void BM_InsertEntry(benchmark::State &state)
+{
+	const int relationSize = state.range(0);
+	std::vector<int> keys = makeBenchKeys(relationSize, order);
+	createBenchRelation(relationName, std::vector<int>());
+	BufMgr bufMgr(state.range(1));
+	for (auto _ : state)
+	{
+		std::string indexName;
+		{
+			std::unique_ptr<Index> index = openIndex<Index>(&bufMgr, indexName);
+			bufMgr.clearBufStats();
+			for (int n = 0; n < relationSize; n++)
+			{
+				RecordId rid = {(PageId)(n / 64 + 1), (SlotId)(n % 64 + 1), 0};
+				index->insertEntry(&keys[n], rid);
+			}
+			reportMisses(state, bufMgr);
+		}
+		state.PauseTiming();
+		if (!indexName.empty())
+		{
+			removeBenchFile(indexName);
+		}
+		state.ResumeTiming();
+	}
+	state.SetItemsProcessed(state.iterations() * relationSize);
+	removeBenchFile(relationName);
+}
+
+BENCHMARK_TEMPLATE(BM_InsertEntry, BTreeIndex, FORWARD)
+		->ArgsProduct({{10000, 100000}, {256, 4096}})->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_InsertEntry, BTreeIndex, BACKWARD)
+		->ArgsProduct({{10000, 100000}, {256, 4096}})->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_InsertEntry, BTreeIndex, RANDOM)
+		->ArgsProduct({{10000, 100000}, {256, 4096}})->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_InsertEntry, ArtIndex, RANDOM)
+		->ArgsProduct({{10000, 100000}, {256}})->Unit(benchmark::kMillisecond);
+
+// -----------------------------------------------------------------------------
+// Point lookups
+// -----------------------------------------------------------------------------
+
+template <class Index>
+void BM_Lookup(benchmark::State &state)
+{
+	const int relationSize = state.range(0);
+	createBenchRelation(relationName, makeBenchKeys(relationSize, RANDOM));
+	BufMgr bufMgr(state.range(1));
+	std::string indexName;
+	{
+		std::unique_ptr<Index> index = openIndex<Index>(&bufMgr, indexName);
+		std::vector<int> probes = makeBenchKeys(relationSize, RANDOM);
+		bufMgr.clearBufStats();
+		std::size_t next = 0;
+		for (auto _ : state)
+		{
+			RecordId rid;
+			benchmark::DoNotOptimize(index->lookup(&probes[next], rid));
+			next = next + 1 < probes.size() ? next + 1 : 0;
+		}
+		reportMisses(state, bufMgr);
+		state.SetItemsProcessed(state.iterations());
+	}
+	if (!indexName.empty())
+	{
+		removeBenchFile(indexName);
+	}
+	removeBenchFile(relationName);
+}
+
+BENCHMARK_TEMPLATE(BM_Lookup, BTreeIndex)->ArgsProduct({{10000, 100000}, {256, 4096}});
+BENCHMARK_TEMPLATE(BM_Lookup, ArtIndex)->ArgsProduct({{10000, 100000}, {256}});
+
+// -----------------------------------------------------------------------------
+// Range scans, the third argument being the selectivity in thousandths of the relation
+// -----------------------------------------------------------------------------
+
+template <class Index>
+void BM_RangeScan(benchmark::State &state)
+{
+	const int relationSize = state.range(0);
+	const int width = std::max<int>(1, relationSize * state.range(2) / 1000);
+	createBenchRelation(relationName, makeBenchKeys(relationSize, RANDOM));
+	BufMgr bufMgr(state.range(1));
+	std::string indexName;
+	{
+		std::unique_ptr<Index> index = openIndex<Index>(&bufMgr, indexName);
+		bufMgr.clearBufStats();
+		std::int64_t numEntries = 0;
+		RecordId batch[256];
+		for (auto _ : state)
+		{
+			int lowVal = random() % (relationSize - width + 1);
+			int highVal = lowVal + width;
+			index->startScan(&lowVal, GTE, &highVal, LT);
+			for (std::size_t n; (n = index->scanNextBatch(batch, 256)) > 0; )
+			{
+				numEntries += n;
+			}
+			index->endScan();
+		}
+		reportMisses(state, bufMgr);
+		state.SetItemsProcessed(numEntries);
+	}
+	if (!indexName.empty())
+	{
+		removeBenchFile(indexName);
+	}
+	removeBenchFile(relationName);
+}
+
+BENCHMARK_TEMPLATE(BM_RangeScan, BTreeIndex)->ArgsProduct({{100000}, {256, 4096}, {1, 10, 100}});
+BENCHMARK_TEMPLATE(BM_RangeScan, ArtIndex)->ArgsProduct({{100000}, {256}, {1, 10, 100}});
+
+// -----------------------------------------------------------------------------
+// Buffer manager reads, of pages that stay in the pool or of twice as many pages as it holds
+// -----------------------------------------------------------------------------
+
+void BM_ReadPage(benchmark::State &state, bool hit)
+{
+	const std::uint32_t numBufs = state.range(0);
+	const PageId numPages = hit ? numBufs / 2 : 2 * numBufs;
+	removeBenchFile(pagesName);
+	{
+		PageFile file(pagesName, true);
+		for (PageId i = 0; i < numPages; i++)
+		{
+			PageId pageNo;
+			Page page = file.allocatePage(pageNo);
+			file.writePage(pageNo, page);
+		}
+
+		// the pages are read in turn, which a pool smaller than them misses every time
+		BufMgr bufMgr(numBufs);
+		Page *page;
+		for (PageId pageNo = 1; pageNo <= numPages; pageNo++)
+		{
+			bufMgr.readPage(&file, pageNo, page);
+			bufMgr.unPinPage(&file, pageNo, false);
+		}
+		bufMgr.clearBufStats();
+		PageId pageNo = 1;
+		for (auto _ : state)
+		{
+			bufMgr.readPage(&file, pageNo, page);
+			benchmark::DoNotOptimize(page);
+			bufMgr.unPinPage(&file, pageNo, false);
+			pageNo = pageNo < numPages ? pageNo + 1 : 1;
+		}
+		reportMisses(state, bufMgr);
+		state.SetItemsProcessed(state.iterations());
+		bufMgr.flushFile(&file);
+	}
+	removeBenchFile(pagesName);
+}
+
+BENCHMARK_CAPTURE(BM_ReadPage, hit, true)->Arg(256)->Arg(4096);
+BENCHMARK_CAPTURE(BM_ReadPage, miss, false)->Arg(256)->Arg(4096);
+
+// -----------------------------------------------------------------------------
+// File scans
+// -----------------------------------------------------------------------------
+
+void BM_FileScan(benchmark::State &state)
+{
+	const int relationSize = state.range(0);
+	createBenchRelation(relationName, makeBenchKeys(relationSize, FORWARD));
+	BufMgr bufMgr(state.range(1));
+	for (auto _ : state)
+	{
+		FileScan fscan(relationName, &bufMgr);
+		try
+		{
+			while (true)
+			{
+				RecordId rid;
+				fscan.scanNext(rid);
+				benchmark::DoNotOptimize(fscan.getRecordView().data());
+			}
+		}
+		catch (const EndOfFileException &e)
+		{
+		}
+	}
+	state.SetItemsProcessed(state.iterations() * relationSize);
+	removeBenchFile(relationName);
+}
+
+BENCHMARK(BM_FileScan)->ArgsProduct({{10000, 100000}, {256, 4096}})->Unit(benchmark::kMillisecond);
+
+}
+
+BENCHMARK_MAIN();
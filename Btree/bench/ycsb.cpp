@@ -0,0 +1,384 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+// YCSB-style workload driver, built by "make ycsb": it loads a relation of -n records and bulk loads a
+// BTreeIndex on its INTEGER attribute over a shared BufMgr of -p frames, then runs -o operations of one of
+// the core workloads A to F from -t threads, choosing keys with a Zipfian or uniform distribution (-d).
+// It reports the throughput of the run and the throughput and latency percentiles of each operation type.
+//
+//   A: 50% reads, 50% updates               D: 95% reads of the latest keys, 5% inserts
+//   B: 95% reads, 5% updates                E: 95% scans of 1 to 100 entries, 5% inserts
+//   C: 100% reads                           F: 50% reads, 50% read-modify-writes
+//
+// An update replaces the entry of a key, inserting an entry of a record ID of its thread and deleting it,
+// so that the entries of the relation stay as loaded; an insert adds the entry of a new key.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+#include "bench_relation.h"
+#include "btree.h"
+#include "exceptions/no_such_key_found_exception.h"
+
+using namespace badgerdb;
+
+namespace {
+
+const std::string relationName = "ycsbRel";
+
+/**
+ * Operation types of the workloads.
+ */
+enum OpType
+{
+	READ,
+	UPDATE,
+	INSERT,
+	SCAN,
+	READ_MODIFY_WRITE,
+	NUM_OP_TYPES
+};
+
+const char *const opNames[NUM_OP_TYPES] = {"READ", "UPDATE", "INSERT", "SCAN", "READ-MODIFY-WRITE"};
+
+/**
+ * Mix of a workload, in percent of the operations for each type.
+ */
+struct Workload
+{
+	int percent[NUM_OP_TYPES];
+	bool latest;
+};
+
+Workload makeWorkload(char name)
+{
+	switch (name)
+	{
+	case 'A': return {{50, 50, 0, 0, 0}, false};
+	case 'B': return {{95, 5, 0, 0, 0}, false};
+	case 'C': return {{100, 0, 0, 0, 0}, false};
+	case 'D': return {{95, 0, 5, 0, 0}, true};
+	case 'E': return {{0, 0, 5, 95, 0}, false};
+	case 'F': return {{50, 0, 0, 0, 50}, false};
+	}
+	fprintf(stderr, "unknown workload %c, expected A to F\n", name);
+	exit(2);
+}
+
+/**
+ * @brief Zipfian distribution over [0, n) after Gray et al., "Quickly Generating Billion-Record Synthetic
+ * Databases", as YCSB draws it: item 0 is the most popular. The constants are computed once and shared by
+ * the threads, each drawing with its own generator.
+ */
+class Zipfian
+{
+	std::uint64_t n;
+	double theta;
+	double alpha;
+	double zetan;
+	double eta;
+
+ public:
+	Zipfian(std::uint64_t nIn, double thetaIn)
+		: n(nIn), theta(thetaIn)
+	{
+		zetan = 0;
+		for (std::uint64_t i = 1; i <= n; i++)
+		{
+			zetan += 1 / std::pow((double)i, theta);
+		}
+		double zeta2 = 1 + 1 / std::pow(2.0, theta);
+		alpha = 1 / (1 - theta);
+		eta = (1 - std::pow(2.0 / n, 1 - theta)) / (1 - zeta2 / zetan);
+	}
+
+	std::uint64_t next(std::mt19937_64 &gen) const
+	{
+		double u = std::uniform_real_distribution<double>(0, 1)(gen);
+		double uz = u * zetan;
+		if (uz < 1)
+		{
+			return 0;
+		}
+		if (uz < 1 + std::pow(0.5, theta))
+		{
+			return 1;
+		}
+		return std::min<std::uint64_t>(n - 1, (std::uint64_t)(n * std::pow(eta * u - eta + 1, alpha)));
+	}
+};
+
+/**
+ * FNV-1a hash of a 64 bit value, scattering the popular items of the Zipfian distribution over the keys.
+ */
+std::uint64_t fnvHash(std::uint64_t value)
+{
+	std::uint64_t hash = 0xcbf29ce484222325ULL;
+	for (int i = 0; i < 8; i++)
+	{
+		hash ^= value & 0xff;
+		hash *= 0x100000001b3ULL;
+		value >>= 8;
+	}
+	return hash;
+}
+
+/**
+ * Options of the run.
+ */
+struct Options
+{
+	char workload = 'A';
+	int numThreads = std::max(1u, std::thread::hardware_concurrency());
+	int numRecords = 100000;
+	long numOps = 1000000;
+	std::uint32_t numBufs = 4096;
+	bool zipfian = true;
+};
+
+/**
+ * State shared by the threads of a run.
+ */
+struct Run
+{
+	const Options &options;
+	const Workload workload;
+	const Zipfian zipfian;
+	BTreeIndex &index;
+
+	/**
+	 * Next key to insert; the keys below it are inserted or being inserted
+	 */
+	std::atomic<int> nextKey;
+};
+
+/**
+ * Latencies of the operations of one thread, in nanoseconds, per operation type.
+ */
+struct ThreadResult
+{
+	std::vector<std::uint32_t> latencies[NUM_OP_TYPES];
+};
+
+/**
+ * Choose the key of a read, update or scan among the numKeys keys inserted.
+ */
+int chooseKey(const Run &run, std::mt19937_64 &gen, int numKeys)
+{
+	if (run.workload.latest)
+	{
+		// the most recent keys are the most popular
+		std::uint64_t back = run.options.zipfian ? run.zipfian.next(gen) : gen();
+		return numKeys - 1 - (int)(back % numKeys);
+	}
+	if (run.options.zipfian)
+	{
+		return (int)(fnvHash(run.zipfian.next(gen)) % numKeys);
+	}
+	return (int)(gen() % numKeys);
+}
+
+/**
+ * Replace the entry of a key by an equal one, as an update of its record would: the entry of a record ID
+ * of the thread is inserted and deleted, so that updates of the same key by several threads do not meet.
+ */
+void updateKey(BTreeIndex &index, int key, int threadNo, std::uint16_t &version)
+{
+	RecordId rid = {(PageId)(0x80000000u + threadNo), (SlotId)(++version == 0 ? ++version : version), 0};
+	index.insertEntry(&key, rid);
+	index.deleteEntry(&key, rid);
+}
+
+void runThread(Run &run, int threadNo, long numOps, ThreadResult &result)
+{
+	std::mt19937_64 gen(0x9e3779b97f4a7c15ULL * (threadNo + 1));
+	std::uniform_int_distribution<int> percent(0, 99);
+	std::uniform_int_distribution<int> scanLength(1, 100);
+	BTreeCursor cursor(&run.index);
+	std::vector<RecordId> batch(100);
+	std::uint16_t version = 0;
+	for (int type = 0; type < NUM_OP_TYPES; type++)
+	{
+		result.latencies[type].reserve(numOps * run.workload.percent[type] / 100 + 16);
+	}
+
+	for (long n = 0; n < numOps; n++)
+	{
+		int draw = percent(gen);
+		int type = 0;
+		while (draw >= run.workload.percent[type])
+		{
+			draw -= run.workload.percent[type];
+			type++;
+		}
+		int numKeys = run.nextKey.load(std::memory_order_relaxed);
+		int key = type == INSERT ? run.nextKey.fetch_add(1) : chooseKey(run, gen, numKeys);
+		int length = type == SCAN ? scanLength(gen) : 0;
+
+		auto start = std::chrono::steady_clock::now();
+		switch (type)
+		{
+		case READ:
+		{
+			RecordId rid;
+			run.index.lookup(&key, rid);
+			break;
+		}
+		case UPDATE:
+			updateKey(run.index, key, threadNo, version);
+			break;
+		case INSERT:
+		{
+			RecordId rid = {(PageId)(key / 64 + 1), (SlotId)(key % 64 + 1), 0};
+			run.index.insertEntry(&key, rid);
+			break;
+		}
+		case SCAN:
+		{
+			int highVal = INT_MAX;
+			try
+			{
+				cursor.startScan(&key, GTE, &highVal, LTE);
+				cursor.scanNextBatch(batch.data(), length);
+				cursor.endScan();
+			}
+			catch (const NoSuchKeyFoundException &e)
+			{
+			}
+			break;
+		}
+		case READ_MODIFY_WRITE:
+		{
+			RecordId rid;
+			if (run.index.lookup(&key, rid))
+			{
+				updateKey(run.index, key, threadNo, version);
+			}
+			break;
+		}
+		}
+		auto elapsed = std::chrono::steady_clock::now() - start;
+		result.latencies[type].push_back(
+				(std::uint32_t)std::min<std::int64_t>(UINT32_MAX, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+	}
+}
+
+/**
+ * Latency at a percentile of sorted latencies, in microseconds.
+ */
+double percentile(const std::vector<std::uint32_t> &sorted, double p)
+{
+	std::size_t rank = (std::size_t)std::ceil(p / 100 * sorted.size());
+	return sorted[rank > 0 ? rank - 1 : 0] / 1000.0;
+}
+
+void usage(const char *program)
+{
+	fprintf(stderr, "usage: %s [-w A-F] [-t threads] [-n records] [-o operations] [-p frames] [-d zipfian|uniform]\n",
+			program);
+	exit(2);
+}
+
+Options parseOptions(int argc, char **argv)
+{
+	Options options;
+	for (int c; (c = getopt(argc, argv, "w:t:n:o:p:d:")) != -1; )
+	{
+		switch (c)
+		{
+		case 'w': options.workload = optarg[0] & ~0x20; break;
+		case 't': options.numThreads = atoi(optarg); break;
+		case 'n': options.numRecords = atoi(optarg); break;
+		case 'o': options.numOps = atol(optarg); break;
+		case 'p': options.numBufs = atoi(optarg); break;
+		case 'd':
+			if (std::string(optarg) != "zipfian" && std::string(optarg) != "uniform")
+			{
+				usage(argv[0]);
+			}
+			options.zipfian = std::string(optarg) == "zipfian";
+			break;
+		default: usage(argv[0]);
+		}
+	}
+	if (optind != argc || options.numThreads < 1 || options.numRecords < 1 || options.numOps < 1 || options.numBufs < 16)
+	{
+		usage(argv[0]);
+	}
+	return options;
+}
+
+}
+
+int main(int argc, char **argv)
+{
+	Options options = parseOptions(argc, argv);
+	Workload workload = makeWorkload(options.workload);
+
+	printf("workload %c, %d threads, %d records, %ld operations, %u frames, %s keys\n", options.workload,
+			options.numThreads, options.numRecords, options.numOps, options.numBufs, options.zipfian ? "zipfian" : "uniform");
+	createBenchRelation(relationName, makeBenchKeys(options.numRecords, RANDOM));
+	std::string indexName;
+	{
+		BufMgr bufMgr(options.numBufs);
+		auto loadStart = std::chrono::steady_clock::now();
+		BTreeIndex index(relationName, indexName, &bufMgr, offsetof(BenchRecord, i), INTEGER);
+		printf("load: %.3f s\n", std::chrono::duration<double>(std::chrono::steady_clock::now() - loadStart).count());
+
+		Run run = {options, workload, Zipfian(options.numRecords, 0.99), index, {options.numRecords}};
+		std::vector<ThreadResult> results(options.numThreads);
+		std::vector<std::thread> threads;
+		auto runStart = std::chrono::steady_clock::now();
+		for (int t = 0; t < options.numThreads; t++)
+		{
+			long numOps = options.numOps / options.numThreads + (t < options.numOps % options.numThreads ? 1 : 0);
+			threads.emplace_back(runThread, std::ref(run), t, numOps, std::ref(results[t]));
+		}
+		for (std::thread &thread : threads)
+		{
+			thread.join();
+		}
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - runStart).count();
+		printf("run: %.3f s, %.0f ops/s\n\n", seconds, options.numOps / seconds);
+
+		printf("%-18s %12s %12s %10s %10s %10s\n", "operation", "count", "ops/s", "p50 us", "p99 us", "p999 us");
+		for (int type = 0; type < NUM_OP_TYPES; type++)
+		{
+			std::vector<std::uint32_t> latencies;
+			for (const ThreadResult &result : results)
+			{
+				latencies.insert(latencies.end(), result.latencies[type].begin(), result.latencies[type].end());
+			}
+			if (latencies.empty())
+			{
+				continue;
+			}
+			std::sort(latencies.begin(), latencies.end());
+			printf("%-18s %12zu %12.0f %10.2f %10.2f %10.2f\n", opNames[type], latencies.size(), latencies.size() / seconds,
+					percentile(latencies, 50), percentile(latencies, 99), percentile(latencies, 99.9));
+		}
+
+		BufStats stats = bufMgr.getBufStats();
+		printf("\nbuffer: %lu accesses, hit ratio %.4f, %lu disk reads, %lu disk writes, %lu clean and %lu dirty evictions\n",
+				stats.accesses, stats.hitRatio(), stats.diskreads, stats.diskwrites, stats.cleanevictions, stats.dirtyevictions);
+	}
+	removeBenchFile(indexName);
+	removeBenchFile(relationName);
+	return 0;
+}
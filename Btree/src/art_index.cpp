@@ -0,0 +1,785 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "art_index.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "filescan.h"
+#include "normalized_key.h"
+#include "exceptions/bad_opcodes_exception.h"
+#include "exceptions/bad_scanrange_exception.h"
+#include "exceptions/end_of_file_exception.h"
+#include "exceptions/index_scan_completed_exception.h"
+#include "exceptions/no_such_key_found_exception.h"
+#include "exceptions/scan_not_initialized_exception.h"
+
+namespace badgerdb {
+
+/**
+ * Kinds of the nodes of the tree: a leaf, or an inner node with room for 4, 16, 48 or 256 children.
+ */
+enum ArtNodeType : std::uint8_t
+{
+  ART_LEAF,
+  ART_NODE4,
+  ART_NODE16,
+  ART_NODE48,
+  ART_NODE256
+};
+
+/**
+ * Node of the tree, cast to its kind after its type.
+ */
+struct ArtNode
+{
+  ArtNodeType type;
+
+  explicit ArtNode(ArtNodeType typeIn) : type(typeIn) {}
+};
+
+/**
+ * Leaf: an encoded key and the record IDs of its entries, in order.
+ */
+struct ArtLeaf : ArtNode
+{
+  std::string key;
+  std::vector<RecordId> rids;
+
+  explicit ArtLeaf(const std::string &keyIn) : ArtNode(ART_LEAF), key(keyIn) {}
+};
+
+/**
+ * Inner node: the bytes following the key byte of the node in the keys of all its children, and the
+ * number of children.
+ */
+struct ArtInner : ArtNode
+{
+  std::string prefix;
+  int numChildren;
+
+  ArtInner(ArtNodeType typeIn, const std::string &prefixIn) : ArtNode(typeIn), prefix(prefixIn), numChildren(0) {}
+};
+
+/**
+ * Node4 and Node16 keep the key bytes of their children sorted, each child next to its byte.
+ */
+template <int N, ArtNodeType TYPE>
+struct ArtSortedNode : ArtInner
+{
+  std::uint8_t keys[N];
+  ArtNode *children[N];
+
+  explicit ArtSortedNode(const std::string &prefixIn) : ArtInner(TYPE, prefixIn) {}
+};
+
+typedef ArtSortedNode<4, ART_NODE4> ArtNode4;
+typedef ArtSortedNode<16, ART_NODE16> ArtNode16;
+
+/**
+ * Node48 maps a key byte to one of its 48 children, 0 being no child and i the child i - 1. A free slot
+ * of the children is null.
+ */
+struct ArtNode48 : ArtInner
+{
+  std::uint8_t childIndex[256];
+  ArtNode *children[48];
+
+  explicit ArtNode48(const std::string &prefixIn) : ArtInner(ART_NODE48, prefixIn)
+  {
+    std::memset(childIndex, 0, sizeof(childIndex));
+    std::fill(children, children + 48, nullptr);
+  }
+};
+
+/**
+ * Node256 has a child for every key byte.
+ */
+struct ArtNode256 : ArtInner
+{
+  ArtNode *children[256];
+
+  explicit ArtNode256(const std::string &prefixIn) : ArtInner(ART_NODE256, prefixIn)
+  {
+    std::fill(children, children + 256, nullptr);
+  }
+};
+
+/**
+ * Create an empty inner node of a kind.
+ */
+static ArtInner *newInner(ArtNodeType type, const std::string &prefix)
+{
+  switch (type)
+  {
+  case ART_NODE4:
+    return new ArtNode4(prefix);
+  case ART_NODE16:
+    return new ArtNode16(prefix);
+  case ART_NODE48:
+    return new ArtNode48(prefix);
+  default:
+    return new ArtNode256(prefix);
+  }
+}
+
+/**
+ * Free a node, not its children.
+ */
+static void deleteNode(ArtNode *node)
+{
+  switch (node->type)
+  {
+  case ART_LEAF:
+    delete static_cast<ArtLeaf *>(node);
+    break;
+  case ART_NODE4:
+    delete static_cast<ArtNode4 *>(node);
+    break;
+  case ART_NODE16:
+    delete static_cast<ArtNode16 *>(node);
+    break;
+  case ART_NODE48:
+    delete static_cast<ArtNode48 *>(node);
+    break;
+  case ART_NODE256:
+    delete static_cast<ArtNode256 *>(node);
+    break;
+  }
+}
+
+/**
+ * Number of children an inner node of a kind has room for.
+ */
+static int capacity(ArtNodeType type)
+{
+  return type == ART_NODE4 ? 4 : type == ART_NODE16 ? 16 : type == ART_NODE48 ? 48 : 256;
+}
+
+/**
+ * Find the child of a key byte.
+ *
+ * @return the reference to the child, NULL if there is none
+ */
+template <class Node>
+static ArtNode **findSorted(Node *node, std::uint8_t byte)
+{
+  for (int i = 0; i < node->numChildren; i++)
+  {
+    if (node->keys[i] == byte)
+      return &node->children[i];
+  }
+  return NULL;
+}
+
+static ArtNode **findChild(ArtInner *node, std::uint8_t byte)
+{
+  switch (node->type)
+  {
+  case ART_NODE4:
+    return findSorted(static_cast<ArtNode4 *>(node), byte);
+  case ART_NODE16:
+    return findSorted(static_cast<ArtNode16 *>(node), byte);
+  case ART_NODE48:
+  {
+    auto *node48 = static_cast<ArtNode48 *>(node);
+    return node48->childIndex[byte] != 0 ? &node48->children[node48->childIndex[byte] - 1] : NULL;
+  }
+  default:
+  {
+    auto *node256 = static_cast<ArtNode256 *>(node);
+    return node256->children[byte] != nullptr ? &node256->children[byte] : NULL;
+  }
+  }
+}
+
+/**
+ * Find the child of the smallest key byte greater than a byte.
+ *
+ * @param after 	Byte, -1 for the first child
+ * @param child 	Child returned in this
+ * @return its key byte, -1 if there is none
+ */
+template <class Node>
+static int nextSorted(const Node *node, int after, ArtNode *&child)
+{
+  for (int i = 0; i < node->numChildren; i++)
+  {
+    if (node->keys[i] > after)
+    {
+      child = node->children[i];
+      return node->keys[i];
+    }
+  }
+  return -1;
+}
+
+static int nextChild(const ArtInner *node, int after, ArtNode *&child)
+{
+  switch (node->type)
+  {
+  case ART_NODE4:
+    return nextSorted(static_cast<const ArtNode4 *>(node), after, child);
+  case ART_NODE16:
+    return nextSorted(static_cast<const ArtNode16 *>(node), after, child);
+  case ART_NODE48:
+  {
+    auto *node48 = static_cast<const ArtNode48 *>(node);
+    for (int byte = after + 1; byte < 256; byte++)
+    {
+      if (node48->childIndex[byte] != 0)
+      {
+        child = node48->children[node48->childIndex[byte] - 1];
+        return byte;
+      }
+    }
+    return -1;
+  }
+  default:
+  {
+    auto *node256 = static_cast<const ArtNode256 *>(node);
+    for (int byte = after + 1; byte < 256; byte++)
+    {
+      if (node256->children[byte] != nullptr)
+      {
+        child = node256->children[byte];
+        return byte;
+      }
+    }
+    return -1;
+  }
+  }
+}
+
+/**
+ * Add a child to an inner node which has room for it.
+ */
+template <class Node>
+static void putSorted(Node *node, std::uint8_t byte, ArtNode *child)
+{
+  int i = node->numChildren;
+  for (; i > 0 && node->keys[i - 1] > byte; i--)
+  {
+    node->keys[i] = node->keys[i - 1];
+    node->children[i] = node->children[i - 1];
+  }
+  node->keys[i] = byte;
+  node->children[i] = child;
+  node->numChildren++;
+}
+
+static void putChild(ArtInner *node, std::uint8_t byte, ArtNode *child)
+{
+  switch (node->type)
+  {
+  case ART_NODE4:
+    putSorted(static_cast<ArtNode4 *>(node), byte, child);
+    break;
+  case ART_NODE16:
+    putSorted(static_cast<ArtNode16 *>(node), byte, child);
+    break;
+  case ART_NODE48:
+  {
+    auto *node48 = static_cast<ArtNode48 *>(node);
+    int slot = std::find(node48->children, node48->children + 48, nullptr) - node48->children;
+    node48->children[slot] = child;
+    node48->childIndex[byte] = slot + 1;
+    node48->numChildren++;
+    break;
+  }
+  default:
+    static_cast<ArtNode256 *>(node)->children[byte] = child;
+    node->numChildren++;
+    break;
+  }
+}
+
+/**
+ * Remove the child of a key byte from an inner node.
+ */
+template <class Node>
+static void eraseSorted(Node *node, std::uint8_t byte)
+{
+  int i = 0;
+  while (node->keys[i] != byte)
+    i++;
+  for (; i + 1 < node->numChildren; i++)
+  {
+    node->keys[i] = node->keys[i + 1];
+    node->children[i] = node->children[i + 1];
+  }
+  node->numChildren--;
+}
+
+static void eraseChild(ArtInner *node, std::uint8_t byte)
+{
+  switch (node->type)
+  {
+  case ART_NODE4:
+    eraseSorted(static_cast<ArtNode4 *>(node), byte);
+    break;
+  case ART_NODE16:
+    eraseSorted(static_cast<ArtNode16 *>(node), byte);
+    break;
+  case ART_NODE48:
+  {
+    auto *node48 = static_cast<ArtNode48 *>(node);
+    node48->children[node48->childIndex[byte] - 1] = nullptr;
+    node48->childIndex[byte] = 0;
+    node->numChildren--;
+    break;
+  }
+  default:
+    static_cast<ArtNode256 *>(node)->children[byte] = nullptr;
+    node->numChildren--;
+    break;
+  }
+}
+
+/**
+ * Replace an inner node by one of another kind holding the same children.
+ *
+ * @param ref 	Reference to the node in its parent
+ * @param type 	Kind of the new node
+ */
+static void resize(ArtNode *&ref, ArtNodeType type)
+{
+  auto *node = static_cast<ArtInner *>(ref);
+  ArtInner *resized = newInner(type, node->prefix);
+  ArtNode *child;
+  for (int byte = nextChild(node, -1, child); byte >= 0; byte = nextChild(node, byte, child))
+    putChild(resized, byte, child);
+  deleteNode(node);
+  ref = resized;
+}
+
+/**
+ * Add a child to an inner node, growing the node if it is full.
+ *
+ * @param ref 	Reference to the node in its parent
+ */
+static void addChild(ArtNode *&ref, std::uint8_t byte, ArtNode *child)
+{
+  auto *node = static_cast<ArtInner *>(ref);
+  if (node->numChildren == capacity(node->type))
+    resize(ref, (ArtNodeType)(node->type + 1));
+  putChild(static_cast<ArtInner *>(ref), byte, child);
+}
+
+/**
+ * Remove a child from an inner node, shrinking it to the smaller kind once it holds half as many children
+ * as that kind has room for, and replacing it by its last child, the prefixes joined, once it has a single
+ * one.
+ *
+ * @param ref 	Reference to the node in its parent
+ */
+static void removeChild(ArtNode *&ref, std::uint8_t byte)
+{
+  auto *node = static_cast<ArtInner *>(ref);
+  eraseChild(node, byte);
+  if (node->numChildren == 1)
+  {
+    ArtNode *child;
+    int childByte = nextChild(node, -1, child);
+    if (child->type != ART_LEAF)
+    {
+      auto *inner = static_cast<ArtInner *>(child);
+      inner->prefix = node->prefix + (char)childByte + inner->prefix;
+    }
+    deleteNode(node);
+    ref = child;
+  }
+  else if (node->type != ART_NODE4 && node->numChildren <= capacity((ArtNodeType)(node->type - 1)) / 2)
+  {
+    resize(ref, (ArtNodeType)(node->type - 1));
+  }
+}
+
+/**
+ * Free a subtree.
+ */
+static void deleteTree(ArtNode *node)
+{
+  if (node == nullptr)
+    return;
+  if (node->type != ART_LEAF)
+  {
+    auto *inner = static_cast<ArtInner *>(node);
+    ArtNode *child;
+    for (int byte = nextChild(inner, -1, child); byte >= 0; byte = nextChild(inner, byte, child))
+      deleteTree(child);
+  }
+  deleteNode(node);
+}
+
+/**
+ * Delete an entry from a subtree.
+ *
+ * @param ref 	Reference to the root of the subtree in its parent
+ * @param key 	Encoded key of the entry
+ * @param depth	Number of bytes of the key above the subtree
+ * @param rid 	Record ID of the entry
+ * @return whether the entry was found
+ */
+static bool removeEntry(ArtNode *&ref, const std::string &key, std::size_t depth, const RecordId &rid)
+{
+  if (ref->type == ART_LEAF)
+  {
+    auto *leaf = static_cast<ArtLeaf *>(ref);
+    if (leaf->key != key)
+      return false;
+    auto it = std::lower_bound(leaf->rids.begin(), leaf->rids.end(), rid);
+    if (it == leaf->rids.end() || !(*it == rid))
+      return false;
+    leaf->rids.erase(it);
+    if (leaf->rids.empty())
+    {
+      deleteNode(leaf);
+      ref = nullptr;
+    }
+    return true;
+  }
+
+  auto *inner = static_cast<ArtInner *>(ref);
+  if (key.compare(depth, inner->prefix.size(), inner->prefix) != 0)
+    return false;
+  depth += inner->prefix.size();
+  std::uint8_t byte = key[depth];
+  ArtNode **child = findChild(inner, byte);
+  if (child == NULL || !removeEntry(*child, key, depth + 1, rid))
+    return false;
+  if (*child == nullptr)
+    removeChild(ref, byte);
+  return true;
+}
+
+ArtIndex::ArtIndex(const std::string &relationName, BufMgr *bufMgr, int attrByteOffsetIn, Datatype attrType)
+  : attributeType(attrType), attrByteOffset(attrByteOffsetIn), root(nullptr), numEntries(0),
+    scanExecuting(false), highOp(LTE), currentLeaf(nullptr), nextRid(0), positionStale(false)
+{
+  FileScan fscan(relationName, bufMgr);
+  try
+  {
+    while (true)
+    {
+      RecordId rid;
+      fscan.scanNext(rid);
+      insertEntry(fscan.getRecordView().data() + attrByteOffset, rid);
+    }
+  }
+  catch (const EndOfFileException &e)
+  {
+  }
+}
+
+ArtIndex::~ArtIndex()
+{
+  deleteTree(root);
+}
+
+std::string ArtIndex::encodeKey(const void *key) const
+{
+  char bytes[STRINGSIZE + 1];
+  int length = 0;
+  switch (attributeType)
+  {
+  case INTEGER:
+  {
+    int value;
+    std::memcpy(&value, key, sizeof(value));
+    length = encodeNormalized(value, bytes);
+    break;
+  }
+  case DOUBLE:
+  {
+    double value;
+    std::memcpy(&value, key, sizeof(value));
+    length = encodeNormalized(value, bytes);
+    break;
+  }
+  case STRING:
+    length = encodeNormalized((const char *)key, STRINGSIZE, bytes);
+    break;
+  }
+  return std::string(bytes, length);
+}
+
+void ArtIndex::insertEntry(const void *key, const RecordId rid)
+{
+  std::string encoded = encodeKey(key);
+  savePosition();
+
+  ArtNode **ref = &root;
+  std::size_t depth = 0;
+  while (*ref != nullptr && (*ref)->type != ART_LEAF)
+  {
+    // a key differing within the prefix of a node branches off above it
+    auto *inner = static_cast<ArtInner *>(*ref);
+    std::size_t matched = 0;
+    while (matched < inner->prefix.size() && inner->prefix[matched] == encoded[depth + matched])
+      matched++;
+    if (matched < inner->prefix.size())
+    {
+      ArtInner *parent = newInner(ART_NODE4, inner->prefix.substr(0, matched));
+      std::uint8_t innerByte = inner->prefix[matched];
+      inner->prefix.erase(0, matched + 1);
+      auto *leaf = new ArtLeaf(encoded);
+      leaf->rids.push_back(rid);
+      putChild(parent, innerByte, inner);
+      putChild(parent, encoded[depth + matched], leaf);
+      *ref = parent;
+      numEntries++;
+      return;
+    }
+
+    depth += inner->prefix.size();
+    ArtNode **child = findChild(inner, encoded[depth]);
+    if (child == NULL)
+    {
+      auto *leaf = new ArtLeaf(encoded);
+      leaf->rids.push_back(rid);
+      addChild(*ref, encoded[depth], leaf);
+      numEntries++;
+      return;
+    }
+    ref = child;
+    depth++;
+  }
+
+  if (*ref == nullptr)
+  {
+    auto *leaf = new ArtLeaf(encoded);
+    leaf->rids.push_back(rid);
+    *ref = leaf;
+  }
+  else if (static_cast<ArtLeaf *>(*ref)->key == encoded)
+  {
+    auto *leaf = static_cast<ArtLeaf *>(*ref);
+    leaf->rids.insert(std::upper_bound(leaf->rids.begin(), leaf->rids.end(), rid), rid);
+  }
+  else
+  {
+    // the leaf of another key is replaced by a node for both, the keys differing before either ends
+    auto *other = static_cast<ArtLeaf *>(*ref);
+    std::size_t end = depth;
+    while (other->key[end] == encoded[end])
+      end++;
+    ArtInner *parent = newInner(ART_NODE4, encoded.substr(depth, end - depth));
+    auto *leaf = new ArtLeaf(encoded);
+    leaf->rids.push_back(rid);
+    putChild(parent, other->key[end], other);
+    putChild(parent, encoded[end], leaf);
+    *ref = parent;
+  }
+  numEntries++;
+}
+
+bool ArtIndex::deleteEntry(const void *key, const RecordId rid)
+{
+  std::string encoded = encodeKey(key);
+  savePosition();
+  if (root == nullptr || !removeEntry(root, encoded, 0, rid))
+    return false;
+  numEntries--;
+  return true;
+}
+
+ArtNode *ArtIndex::findLeaf(const std::string &key) const
+{
+  ArtNode *node = root;
+  std::size_t depth = 0;
+  while (node != nullptr && node->type != ART_LEAF)
+  {
+    auto *inner = static_cast<ArtInner *>(node);
+    if (key.compare(depth, inner->prefix.size(), inner->prefix) != 0)
+      return nullptr;
+    depth += inner->prefix.size();
+    ArtNode **child = findChild(inner, key[depth]);
+    node = child != NULL ? *child : nullptr;
+    depth++;
+  }
+  return node != nullptr && static_cast<ArtLeaf *>(node)->key == key ? node : nullptr;
+}
+
+bool ArtIndex::lookup(const void *key, RecordId &outRid) const
+{
+  ArtNode *leaf = findLeaf(encodeKey(key));
+  if (leaf == nullptr)
+    return false;
+  outRid = static_cast<ArtLeaf *>(leaf)->rids.front();
+  return true;
+}
+
+void ArtIndex::seekLeftmost(ArtNode *node)
+{
+  while (node->type != ART_LEAF)
+  {
+    auto *inner = static_cast<ArtInner *>(node);
+    int byte = nextChild(inner, -1, node);
+    path.emplace_back(inner, byte);
+  }
+  currentLeaf = node;
+  nextRid = 0;
+}
+
+void ArtIndex::seekNextLeaf()
+{
+  while (!path.empty())
+  {
+    ArtNode *child;
+    int byte = nextChild(static_cast<ArtInner *>(path.back().first), path.back().second, child);
+    if (byte >= 0)
+    {
+      path.back().second = byte;
+      seekLeftmost(child);
+      return;
+    }
+    path.pop_back();
+  }
+  currentLeaf = nullptr;
+}
+
+void ArtIndex::seek(const std::string &key, const RecordId *rid)
+{
+  path.clear();
+  currentLeaf = nullptr;
+  ArtNode *node = root;
+  std::size_t depth = 0;
+  while (node != nullptr)
+  {
+    if (node->type == ART_LEAF)
+    {
+      auto *leaf = static_cast<ArtLeaf *>(node);
+      int c = leaf->key.compare(key);
+      currentLeaf = leaf;
+      nextRid = c == 0 && rid != NULL ? std::lower_bound(leaf->rids.begin(), leaf->rids.end(), *rid) - leaf->rids.begin() : 0;
+      if (c < 0 || nextRid == leaf->rids.size())
+        seekNextLeaf();
+      return;
+    }
+
+    // a subtree whose prefix differs lies entirely before or after the key
+    auto *inner = static_cast<ArtInner *>(node);
+    int c = depth < key.size() ? inner->prefix.compare(0, inner->prefix.size(), key, depth, inner->prefix.size()) : 1;
+    depth += inner->prefix.size();
+    if (c > 0 || (c == 0 && depth >= key.size()))
+    {
+      seekLeftmost(inner);
+      return;
+    }
+    if (c < 0)
+    {
+      seekNextLeaf();
+      return;
+    }
+
+    // the children of the key bytes after that of the key are all after it
+    std::uint8_t byte = key[depth];
+    path.emplace_back(inner, byte);
+    ArtNode **child = findChild(inner, byte);
+    if (child == NULL)
+    {
+      seekNextLeaf();
+      return;
+    }
+    node = *child;
+    depth++;
+  }
+}
+
+void ArtIndex::checkHighBound()
+{
+  if (currentLeaf == nullptr)
+    return;
+  int c = static_cast<ArtLeaf *>(currentLeaf)->key.compare(highKey);
+  if (highOp == LT ? c >= 0 : c > 0)
+  {
+    currentLeaf = nullptr;
+    path.clear();
+  }
+}
+
+void ArtIndex::savePosition()
+{
+  if (!scanExecuting || positionStale || currentLeaf == nullptr)
+    return;
+  auto *leaf = static_cast<ArtLeaf *>(currentLeaf);
+  resumeKey = leaf->key;
+  resumeRid = leaf->rids[nextRid];
+  positionStale = true;
+}
+
+void ArtIndex::startScan(const void *lowVal, const Operator lowOp, const void *highVal, const Operator highOpIn)
+{
+  if ((lowOp != GT && lowOp != GTE) || (highOpIn != LT && highOpIn != LTE))
+    throw BadOpcodesException();
+  std::string lowKey = encodeKey(lowVal);
+  std::string high = encodeKey(highVal);
+  if (high < lowKey)
+    throw BadScanrangeException();
+
+  if (scanExecuting)
+    endScan();
+  scanExecuting = true;
+  highKey = high;
+  highOp = highOpIn;
+  seek(lowKey, NULL);
+  if (lowOp == GT && currentLeaf != nullptr && static_cast<ArtLeaf *>(currentLeaf)->key == lowKey)
+    seekNextLeaf();
+  checkHighBound();
+  if (currentLeaf == nullptr)
+    throw NoSuchKeyFoundException();
+}
+
+std::size_t ArtIndex::scanNextBatch(RecordId *out, std::size_t max)
+{
+  if (!scanExecuting)
+    throw ScanNotInitializedException();
+
+  // the next entry is found again from its key if the tree has changed, its leaf possibly freed
+  if (positionStale)
+  {
+    seek(resumeKey, &resumeRid);
+    checkHighBound();
+    positionStale = false;
+  }
+
+  std::size_t count = 0;
+  while (count < max && currentLeaf != nullptr)
+  {
+    auto *leaf = static_cast<ArtLeaf *>(currentLeaf);
+    std::size_t n = std::min(leaf->rids.size() - nextRid, max - count);
+    std::copy(leaf->rids.begin() + nextRid, leaf->rids.begin() + nextRid + n, out + count);
+    nextRid += n;
+    count += n;
+    if (nextRid == leaf->rids.size())
+    {
+      seekNextLeaf();
+      checkHighBound();
+    }
+  }
+  return count;
+}
+
+void ArtIndex::scanNext(RecordId &outRid)
+{
+  if (scanNextBatch(&outRid, 1) == 0)
+    throw IndexScanCompletedException();
+}
+
+void ArtIndex::endScan()
+{
+  if (!scanExecuting)
+    throw ScanNotInitializedException();
+  scanExecuting = false;
+  positionStale = false;
+  currentLeaf = nullptr;
+  path.clear();
+}
+
+}
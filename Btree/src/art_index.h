@@ -0,0 +1,240 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "types.h"
+#include "buffer.h"
+#include "btree.h"
+
+namespace badgerdb {
+
+/**
+* @brief Node of an adaptive radix tree, defined with its kinds in art_index.cpp.
+*/
+struct ArtNode;
+
+/**
+* @brief In-memory index engine for fully memory-resident relations: an adaptive radix tree (ART) over the
+* normalized keys of an attribute, with the contract of BTreeIndex for insertions, deletions, lookups and
+* scans, so that a workload chooses the engine per index. Nothing goes through the buffer manager, which is
+* only used to read the relation: an inner node is a Node4, Node16, Node48 or Node256 after the number of
+* its children, grown and shrunk as they come and go, and holds the bytes its children share as a prefix;
+* a leaf holds a key and its record IDs in order.
+*
+* Keys are encoded by encodeNormalized, so that the tree orders them as the B+ tree does; as no encoded key
+* is a prefix of another, keys only end at leaves. The entries of a key are returned in record ID order.
+* The index is used by one thread at a time. A scan survives modifications of the index between its calls,
+* going on from the entry it stopped at.
+*/
+class ArtIndex
+{
+ private:
+	/**
+   * Datatype of the attribute the index is built on
+	 */
+  Datatype attributeType;
+
+	/**
+   * Offset of the attribute in the records
+	 */
+  int attrByteOffset;
+
+	/**
+   * Root of the tree, nullptr if it is empty
+	 */
+  ArtNode *root;
+
+	/**
+   * Number of entries
+	 */
+  std::size_t numEntries;
+
+	/**
+   * Whether a scan has been started
+	 */
+  bool scanExecuting;
+
+	/**
+   * Encoded high bound of the scan, and its operator
+	 */
+  std::string highKey;
+  Operator highOp;
+
+	/**
+   * Inner nodes on the path to the current leaf, each with the key byte of the child followed
+	 */
+  std::vector<std::pair<ArtNode *, int>> path;
+
+	/**
+   * Leaf of the next entry of the scan, nullptr if the scan is completed
+	 */
+  ArtNode *currentLeaf;
+
+	/**
+   * Position of the next entry in the record IDs of that leaf
+	 */
+  std::size_t nextRid;
+
+	/**
+   * Whether the tree has changed since the position was found, which must then be found again
+	 */
+  bool positionStale;
+
+	/**
+   * Encoded key and record ID of the next entry of the scan when the tree was first changed
+	 */
+  std::string resumeKey;
+  RecordId resumeRid;
+
+	/**
+   * Encode a key of the attribute type into the bytes the tree is keyed on.
+	 *
+	 * @param key 	Pointer to integer / double / char string
+	 * @return the encoded key
+	 */
+  std::string encodeKey(const void *key) const;
+
+	/**
+	 * Find the leaf of an encoded key.
+	 *
+	 * @param key 	Encoded key
+	 * @return the leaf, nullptr if the key has no entry
+	 */
+  ArtNode *findLeaf(const std::string &key) const;
+
+	/**
+	 * Position the scan on the first entry whose key is not less than an encoded key, and whose record ID is
+	 * not less than a record ID if the key is equal.
+	 *
+	 * @param key 	Encoded key
+	 * @param rid 	Record ID, NULL for the first entry of the key
+	 */
+  void seek(const std::string &key, const RecordId *rid);
+
+	/**
+	 * Position the scan on the first entry of the leftmost leaf under a node.
+	 *
+	 * @param node 	Node
+	 */
+  void seekLeftmost(ArtNode *node);
+
+	/**
+	 * Position the scan on the first entry of the leaf after those of the path.
+	 */
+  void seekNextLeaf();
+
+	/**
+	 * End the scan if its next entry is past the high bound.
+	 */
+  void checkHighBound();
+
+	/**
+	 * Record the next entry of the scan before the tree changes, unless it is already recorded.
+	 */
+  void savePosition();
+
+ public:
+	/**
+	 * Build the index of an attribute of a relation, inserting the entry of every record.
+	 *
+	 * @param relationName	Name of the relation file
+	 * @param bufMgr 	Buffer manager the relation is read through
+	 * @param attrByteOffset	Offset of the attribute in the records
+	 * @param attrType 	Datatype of the attribute
+	 */
+  ArtIndex(const std::string &relationName, BufMgr *bufMgr, int attrByteOffset, Datatype attrType);
+
+	/**
+	 * Free the nodes of the tree.
+	 */
+  ~ArtIndex();
+
+  ArtIndex(const ArtIndex &) = delete;
+  ArtIndex &operator=(const ArtIndex &) = delete;
+
+	/**
+	 * Insert an entry.
+	 *
+	 * @param key 	Pointer to integer / double / char string
+	 * @param rid 	Record ID of the record the key is taken from
+	 */
+  void insertEntry(const void *key, const RecordId rid);
+
+	/**
+	 * Delete an entry.
+	 *
+	 * @param key 	Pointer to integer / double / char string
+	 * @param rid 	Record ID of the entry
+	 * @return whether the entry was found
+	 */
+  bool deleteEntry(const void *key, const RecordId rid);
+
+	/**
+	 * Find the first entry of a key, in record ID order.
+	 *
+	 * @param key 	Pointer to integer / double / char string
+	 * @param outRid	Record ID of the entry returned in this
+	 * @return whether the key has an entry
+	 */
+  bool lookup(const void *key, RecordId &outRid) const;
+
+	/**
+	 * Begin a filtered scan of the index, ending the one executing if any.
+	 * @see BTreeIndex::startScan
+	 *
+	 * @param lowVal	Low value of range, pointer to integer / double / char string
+	 * @param lowOp		Low operator (GT/GTE)
+	 * @param highVal	High value of range, pointer to integer / double / char string
+	 * @param highOp	High operator (LT/LTE)
+	 * @throws BadOpcodesException If lowOp and highOp do not contain one of their their expected values
+	 * @throws BadScanrangeException If lowVal > highval
+	 * @throws NoSuchKeyFoundException If there is no key in the index that satisfies the scan criteria.
+	 */
+  void startScan(const void *lowVal, const Operator lowOp, const void *highVal, const Operator highOp);
+
+	/**
+	 * Fetch the record id of the next index entry that matches the scan.
+	 *
+	 * @param outRid	RecordId of next record found that satisfies the scan criteria returned in this
+	 * @throws ScanNotInitializedException If no scan has been initialized.
+	 * @throws IndexScanCompletedException If no more records, satisfying the scan criteria, are left to be scanned.
+	 */
+  void scanNext(RecordId &outRid);
+
+	/**
+	 * Fetch the record ids of up to max next index entries that match the scan.
+	 *
+	 * @param out	Array of at least max record ids returned in this
+	 * @param max	Maximum number of record ids to fetch
+	 * @return the number of record ids fetched, 0 if the scan is completed
+	 * @throws ScanNotInitializedException If no scan has been initialized.
+	 */
+  std::size_t scanNextBatch(RecordId *out, std::size_t max);
+
+	/**
+	 * Terminate the scan.
+	 *
+	 * @throws ScanNotInitializedException If no scan has been initialized.
+	 */
+  void endScan();
+
+	/**
+	 * Get the number of entries of the index.
+	 */
+  std::size_t getNumEntries() const
+  {
+		return numEntries;
+  }
+};
+
+}
@@ -5,8 +5,25 @@
  * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
  */
 
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "btree.h"
+#include "string_node.h"
+#include "packed_leaf.h"
+#include "normalized_key.h"
 #include "filescan.h"
+#include "rid_bitmap.h"
 #include "exceptions/bad_index_info_exception.h"
 #include "exceptions/bad_opcodes_exception.h"
 #include "exceptions/bad_scanrange_exception.h"
@@ -15,6 +32,7 @@
 #include "exceptions/index_scan_completed_exception.h"
 #include "exceptions/file_not_found_exception.h"
 #include "exceptions/end_of_file_exception.h"
+#include "exceptions/index_read_only_exception.h"
 
 
 //#define DEBUG
@@ -22,6 +40,85 @@
 namespace badgerdb
 {
 
+/**
+ * Get the offset of the first column of the key of a composite index.
+ * @param columns Columns of the key
+ * @return the offset of the first column
+ * @throws BadIndexInfoException If there are no columns
+ */
+static int firstColumnOffset(const std::vector<KeyColumn> &columns)
+{
+	if (columns.empty())
+	{
+		throw BadIndexInfoException("no key columns");
+	}
+	return columns[0].offset;
+}
+
+/**
+ * Convert a key of the index to a key of its statistics.
+ * @param key Key of the index
+ * @return the key of the statistics
+ */
+static IndexKey statsKey(int key)
+{
+	return IndexKey{INTEGER, std::string((const char *)&key, sizeof(key))};
+}
+
+static IndexKey statsKey(double key)
+{
+	return IndexKey{DOUBLE, std::string((const char *)&key, sizeof(key))};
+}
+
+static IndexKey statsKey(const StringKey &key)
+{
+	return IndexKey{STRING, std::string(key.data, key.length)};
+}
+
+/**
+ * Get the share of the room of a node its entries take.
+ * @param nodePtr Leaf or non leaf node
+ * @param occupancy Number of entries the node holds when full
+ * @return the fill of the node
+ */
+template <class N>
+static double fillOf(const N *nodePtr, int occupancy)
+{
+	return (double)nodePtr->numKeys / occupancy;
+}
+
+static double fillOf(const NonLeafNodeString *nodePtr, int)
+{
+	return (double)slottedUsed(nodePtr) / slottedEnd(nodePtr);
+}
+
+static double fillOf(const LeafNodeString *leafPtr, int)
+{
+	return (double)slottedUsed(leafPtr) / slottedEnd(leafPtr);
+}
+
+/**
+ * Hash a key for the lookup filter, equal keys hashing alike.
+ * @param key Key of the index
+ * @return the hash of the key
+ */
+static std::uint64_t filterHash(int key)
+{
+	return KeyFilter::hash(&key, sizeof(key));
+}
+
+static std::uint64_t filterHash(double key)
+{
+	// -0.0 equals 0.0
+	key = key == 0 ? 0.0 : key;
+	return KeyFilter::hash(&key, sizeof(key));
+}
+
+static std::uint64_t filterHash(const StringKey &key)
+{
+	return KeyFilter::hash(key.data, key.length);
+}
+
 // -----------------------------------------------------------------------------
 // BTreeIndex::BTreeIndex -- Constructor
 // -----------------------------------------------------------------------------
@@ -30,37 +127,141 @@ BTreeIndex::BTreeIndex(const std::string & relationName,
 		std::string & outIndexName,
 		BufMgr *bufMgrIn,
 		const int attrByteOffset,
-		const Datatype attrType)
+		const Datatype attrType,
+		const double fillFactorIn,
+		const IndexOpenMode mode,
+		const std::vector<IncludedAttribute> &included,
+		const int nodeSizeIn)
+		: BTreeIndex(relationName, outIndexName, bufMgrIn, attrByteOffset, attrType, fillFactorIn, mode, nodeSizeIn,
+		             included, std::vector<KeyColumn>())
+{
+}
+
+BTreeIndex::BTreeIndex(const std::string & relationName,
+		std::string & outIndexName,
+		BufMgr *bufMgrIn,
+		const std::vector<KeyColumn> &columns,
+		const double fillFactorIn,
+		const IndexOpenMode mode)
+		: BTreeIndex(relationName, outIndexName, bufMgrIn, firstColumnOffset(columns), STRING, fillFactorIn, mode, 0,
+		             std::vector<IncludedAttribute>(), columns)
+{
+}
+
+BTreeIndex::BTreeIndex(const std::string & relationName,
+		std::string & outIndexName,
+		BufMgr *bufMgrIn,
+		const int attrByteOffset,
+		const Datatype attrType,
+		const double fillFactorIn,
+		const IndexOpenMode mode,
+		const int nodeSizeIn,
+		const std::vector<IncludedAttribute> &included,
+		const std::vector<KeyColumn> &keyColumns)
 		: bufMgr(bufMgrIn)
 		, attributeType(attrType)
 		, attrByteOffset(attrByteOffset)
-		, leafOccupancy(INTARRAYLEAFSIZE)
-		, nodeOccupancy(INTARRAYNONLEAFSIZE)
-		, scanExecuting(false)
-		, nextEntry(-1)
-		, currentPageNum(Page::INVALID_NUMBER)
-		, currentPageData(nullptr)
+		, nodeSize(Page::SIZE)
+		, legacyFormat(false)
+		, includedAttrs(included)
+		, includedWidth(0)
+		, includedOffset(0)
+		, keyColumns(keyColumns)
+		, freePageNum(Page::INVALID_NUMBER)
+		, appendPages(false)
+		, deletePolicy(DELETE_EAGER)
+		, readOnly(mode == INDEX_READ_ONLY_MAPPED)
+		, mapping(nullptr)
+		, mappingSize(0)
+		, cacheNodes(false)
+		, nodeCacheUsers(0)
+		, hasReleasedNodes(false)
+		, numCachedNodes(0)
+		, hotLevelsMisses(0)
+		, appendLeafNum(Page::INVALID_NUMBER)
+		, insertBufferCapacity(0)
+		, deltaMode(false)
+		, metricsEnabled(false)
+		, scanCursor(this)
+		, fillFactor(fillFactorIn)
 {
+	// the node capacities depend on the type of key
+	// the last key slot of a node is kept for its high key
+	switch (attributeType)
+	{
+	case INTEGER:
+		leafOccupancy = INTARRAYLEAFSIZE - 1;
+		nodeOccupancy = INTARRAYNONLEAFSIZE - 1;
+		postingThreshold = INTARRAYLEAFSIZE / POSTING_INLINE_FRACTION;
+		break;
+	case DOUBLE:
+		leafOccupancy = DOUBLEARRAYLEAFSIZE - 1;
+		nodeOccupancy = DOUBLEARRAYNONLEAFSIZE - 1;
+		postingThreshold = DOUBLEARRAYLEAFSIZE / POSTING_INLINE_FRACTION;
+		break;
+	case STRING:
+		leafOccupancy = STRINGARRAYLEAFSIZE;
+		nodeOccupancy = STRINGARRAYNONLEAFSIZE;
+		// equal keys share their bytes, so an entry only takes its record ID and key slot
+		postingThreshold = (Page::SIZE / POSTING_INLINE_FRACTION) / (sizeof(RecordId) + sizeof(KeySlot));
+		break;
+	}
+
+	// the included attributes take the same bytes in every entry of a covering index
+	for (const IncludedAttribute &attr : includedAttrs)
+	{
+		if (attr.size <= 0)
+		{
+			throw BadIndexInfoException("included attribute of no size");
+		}
+		includedWidth += attr.size;
+	}
+	if (!includedAttrs.empty()
+			&& (attributeType == STRING || includedAttrs.size() > (std::size_t)MAX_INCLUDED_ATTRS
+			    || includedWidth > MAX_INCLUDED_WIDTH))
+	{
+		throw BadIndexInfoException("included attributes");
+	}
+	if (includedWidth > 0)
+	{
+		// the record IDs and the included values of the entries share the record ID slots of a leaf
+		// every entry stays in its leaf, since a posting list has no room for the included values
+		int ridSlots = attributeType == INTEGER ? INTARRAYLEAFSIZE : DOUBLEARRAYLEAFSIZE;
+		int ridOffset = attributeType == INTEGER ? offsetof(LeafNode<int>, ridArray) : offsetof(LeafNode<double>, ridArray);
+		leafOccupancy = ridSlots * sizeof(RecordId) / (sizeof(RecordId) + includedWidth);
+		includedOffset = ridOffset + leafOccupancy * sizeof(RecordId);
+		postingThreshold = INT_MAX;
+	}
+	if (keyColumns.size() > (std::size_t)MAX_KEY_COLUMNS)
+	{
+		throw BadIndexInfoException("key columns");
+	}
+
 	std::ostringstream idxStr;
 	idxStr << relationName << '.' << attrByteOffset;
+	for (std::size_t i = 1; i < keyColumns.size(); ++i)
+	{
+		idxStr << ',' << keyColumns[i].offset;
+	}
+	for (const IncludedAttribute &attr : includedAttrs)
+	{
+		idxStr << '+' << attr.offset;
+	}
 	std::string indexName = idxStr.str();  // index file name
 	outIndexName = indexName;  // return the index file name via reference
 
 	Page *headerPage;  // header page
-	Page *rootPage;    // root page
-
-	// the first leaf page
-	PageId leafPageNum;
-	Page *leafPage;
 
 	if (!File::exists(outIndexName))
 	{
+		// the nodes of a new index file fill whole pages unless given a size
+		setNodeSize(nodeSizeIn != 0 ? nodeSizeIn : (int)Page::SIZE);
+
 		// create a new index file if it doesn't exist
 		file = new BlobFile(outIndexName, true);
 
-		// allocate the header page, root page
+		// allocate the header page
 		bufMgr->allocPage(file, headerPageNum, headerPage);
-		bufMgr->allocPage(file, rootPageNum, rootPage);
 
 		// set the index meta information
 		auto *indexMetaInfoPtr = (IndexMetaInfo *)headerPage;
@@ -68,48 +269,51 @@ BTreeIndex::BTreeIndex(const std::string & relationName,
 		outIndexName.copy(indexMetaInfoPtr->relationName, 20);
 		indexMetaInfoPtr->attrByteOffset = attrByteOffset;
 		indexMetaInfoPtr->attrType = attributeType;
-		indexMetaInfoPtr->rootPageNo = rootPageNum;
-
-		// set the root node information
-		auto *rootIntPtr = (NonLeafNodeInt *)rootPage;
-		clearNode(rootIntPtr, 1, 0, nodeOccupancy);
-
-		// allocate the leaf page
-		bufMgr->allocPage(file, leafPageNum, leafPage);
-		auto *leafPagePtr = (LeafNodeInt *)leafPage;
-		clearLeaf(leafPagePtr, Page::INVALID_NUMBER, 0, leafOccupancy);
+		indexMetaInfoPtr->formatVersion = INDEX_FORMAT_VERSION;
+		indexMetaInfoPtr->freePageNo = Page::INVALID_NUMBER;
+		indexMetaInfoPtr->numIncluded = includedAttrs.size();
+		std::copy(includedAttrs.begin(), includedAttrs.end(), indexMetaInfoPtr->included);
+		indexMetaInfoPtr->numKeyColumns = keyColumns.size();
+		std::copy(keyColumns.begin(), keyColumns.end(), indexMetaInfoPtr->keyColumns);
+		indexMetaInfoPtr->pageSize = Page::SIZE;
+		indexMetaInfoPtr->nodeSize = nodeSize;
 
-		rootIntPtr->pageNoArray[0] = leafPageNum;
+		// build the tree bottom-up from the records in the relation
+		// the root page number is set in the meta page once it is known
+		switch (attributeType)
+		{
+		case INTEGER:
+			bulkLoad<int>(relationName, outIndexName, headerPage);
+			break;
+		case DOUBLE:
+			bulkLoad<double>(relationName, outIndexName, headerPage);
+			break;
+		case STRING:
+			bulkLoad<StringKey>(relationName, outIndexName, headerPage);
+			break;
+		}
 
 		// unpin with modification
 		bufMgr->unPinPage(file, headerPageNum, true);
-		bufMgr->unPinPage(file, rootPageNum, true);
-		bufMgr->unPinPage(file, leafPageNum, true);
-
-		// insert the records in the relation
-		FileScan fscan = FileScan(relationName, bufMgr);
-		try
-		{
-			RecordId scanRid;
-			while(1)
-			{
-				fscan.scanNext(scanRid);
-				std::string recordStr = fscan.getRecord();
-				const char *record = recordStr.c_str();
-				const void *key = record + attrByteOffset;
-				insertEntry(key, scanRid);
-			}
-		}
-		catch(const EndOfFileException &e)
-		{}
 
 		// flush the file
 		bufMgr->flushFile(file);
+
+		// the changes are logged from the file as built, the bulk load itself being made durable by a sync
+		if (bufMgr->getLog() != NULL)
+		{
+			file->sync();
+			bufMgr->getLog()->attach(file);
+		}
 	}
 	else
 	{
-		// otherwise, open the existing index file
+		// otherwise, open the existing index file, whose changes are logged from its pages as on disk
 		file = new BlobFile(outIndexName, false);
+		if (bufMgr->getLog() != NULL)
+		{
+			bufMgr->getLog()->attach(file);
+		}
 
 		// retrieve the header page
 		headerPageNum = file->getFirstPageNo();
@@ -117,588 +321,6568 @@ BTreeIndex::BTreeIndex(const std::string & relationName,
 		auto *indexMetaInfoPtr = (IndexMetaInfo *)headerPage;
 
 		// throw an exception if the information doesn't match
+		// or if the file is from a later format version
+		// or if it is a DOUBLE index from before the nodes were typed on the key
+		// or a STRING index from before its nodes were slotted
+		// or if the included attributes or the key columns differ
+		// or if the file has other page or node sizes
+		bool sameIncluded = indexMetaInfoPtr->numIncluded == (int)includedAttrs.size();
+		for (int i = 0; sameIncluded && i < indexMetaInfoPtr->numIncluded; ++i)
+		{
+			sameIncluded = indexMetaInfoPtr->included[i].offset == includedAttrs[i].offset
+			               && indexMetaInfoPtr->included[i].size == includedAttrs[i].size;
+		}
+		int fileNodeSize = indexMetaInfoPtr->nodeSize != 0 ? indexMetaInfoPtr->nodeSize : (int)Page::SIZE;
+		bool sameColumns = indexMetaInfoPtr->numKeyColumns == (int)keyColumns.size();
+		for (int i = 0; sameColumns && i < indexMetaInfoPtr->numKeyColumns; ++i)
+		{
+			sameColumns = indexMetaInfoPtr->keyColumns[i].offset == keyColumns[i].offset
+			              && indexMetaInfoPtr->keyColumns[i].type == keyColumns[i].type;
+		}
 		if (attributeType != indexMetaInfoPtr->attrType
 				|| attrByteOffset != indexMetaInfoPtr->attrByteOffset
-				|| outIndexName.compare(indexMetaInfoPtr->relationName) != 0)
+				|| outIndexName.compare(indexMetaInfoPtr->relationName) != 0
+				|| !sameIncluded
+				|| !sameColumns
+				|| (indexMetaInfoPtr->pageSize != 0 && indexMetaInfoPtr->pageSize != (int)Page::SIZE)
+				|| !validNodeSize(fileNodeSize, attributeType)
+				|| (nodeSizeIn != 0 && nodeSizeIn != fileNodeSize)
+				|| indexMetaInfoPtr->formatVersion > INDEX_FORMAT_VERSION
+				|| (attributeType == DOUBLE && indexMetaInfoPtr->formatVersion < INDEX_FORMAT_V3)
+				|| (attributeType == STRING && indexMetaInfoPtr->formatVersion < INDEX_FORMAT_V4))
 		{
-			// unpin without modification
+			// unpin without modification, and close the file since the destructor is not run
 			bufMgr->unPinPage(file, headerPageNum, false);
-			
+			bufMgr->flushFile(file);
+			if (bufMgr->getLog() != NULL)
+			{
+				bufMgr->getLog()->detach(file);
+			}
+			delete file;
+
 			throw BadIndexInfoException(outIndexName);
 		}
 
-		// get the root page number
+		// the nodes of the file keep the size they were created with
+		setNodeSize(fileNodeSize);
+
+		// get the root page number and the free pages
 		rootPageNum = indexMetaInfoPtr->rootPageNo;
+		freePageNum = indexMetaInfoPtr->freePageNo;
+
+		// the nodes of an old index file are upgraded lazily when they are read
+		legacyFormat = indexMetaInfoPtr->formatVersion < INDEX_FORMAT_V2;
 
 		// unpin without modification
 		bufMgr->unPinPage(file, headerPageNum, false);
 	}
-}
-
-// -----------------------------------------------------------------------------
-// BTreeIndex::~BTreeIndex -- destructor
-// -----------------------------------------------------------------------------
 
-BTreeIndex::~BTreeIndex()
-{
-	// end the last scanning
-  if (scanExecuting)
+	if (readOnly)
 	{
-		endScan();
+		mapFile();
+	}
+	else
+	{
+		// the nodes are cached once the file has been flushed, since their pins would keep it from it
+		cacheNodes = true;
+		bufMgr->addPinHolder(this);
 	}
-
-	// flush the file before the deletion
-	bufMgr->flushFile(file);
-
-	delete file;
-	file = nullptr;
 }
 
 // -----------------------------------------------------------------------------
-// BTreeIndex::insertEntry
+// BTreeIndex::setNodeSize
 // -----------------------------------------------------------------------------
 
-void BTreeIndex::insertEntry(const void *key, const RecordId rid) 
+bool BTreeIndex::validNodeSize(int size, Datatype type)
 {
-	// read the root page
-	Page *rootPage;
-	bufMgr->readPage(file, rootPageNum, rootPage);
-	auto *rootIntPtr = (NonLeafNodeInt *)rootPage;
-
-	// construct the data entry to insert
-	RIDKeyPair<int> inserted;
-	inserted.set(rid, *(int *)key);
-	PageKeyPair<int> pushed;
+	// the bytes of STRING nodes are all used, their keys varying in length
+	return size >= MIN_NODE_SIZE && size <= (int)Page::SIZE && (size & (size - 1)) == 0
+	       && (type != STRING || size == (int)Page::SIZE);
+}
 
-	if (!insertEntryAux(rootIntPtr, inserted, pushed))
+void BTreeIndex::setNodeSize(int size)
+{
+	if (!validNodeSize(size, attributeType))
 	{
-		// insert the pushed up key from the old root in a new root
-		bufMgr->unPinPage(file, rootPageNum, true);
-
-		// update the root
-		PageId oldRootPageNum = rootPageNum;
-		bufMgr->allocPage(file, rootPageNum, rootPage);
-		rootIntPtr = (NonLeafNodeInt *)rootPage;
-		clearNode(rootIntPtr, 0, 0, nodeOccupancy);
-
-		// set the pushed up key and children pages for the new root
-		rootIntPtr->pageNoArray[0] = oldRootPageNum;
-		insertPageKeyPairAux(rootIntPtr, 0, pushed, 0);
+		throw BadIndexInfoException("node size");
 	}
 
-	bufMgr->unPinPage(file, rootPageNum, true);
+	// the nodes keep their whole page layout, fewer of their slots being filled
+	// included values keep their offset, so that it does not depend on the node size
+	leafOccupancy = (int)((long long)leafOccupancy * size / nodeSize);
+	nodeOccupancy = (int)((long long)nodeOccupancy * size / nodeSize);
+	if (postingThreshold != INT_MAX)
+	{
+		postingThreshold = std::max(1, (int)((long long)postingThreshold * size / nodeSize));
+	}
+	nodeSize = size;
 }
 
 // -----------------------------------------------------------------------------
-// BTreeIndex::startScan
+// BTreeIndex::mapFile
 // -----------------------------------------------------------------------------
 
-void BTreeIndex::startScan(const void* lowValParm,
-				   const Operator lowOpParm,
-				   const void* highValParm,
-				   const Operator highOpParm)
+void BTreeIndex::mapFile()
 {
-	// throw an exception if the opcodes are bad
-	if ((lowOpParm != GT && lowOpParm != GTE)
-	    || (highOpParm != LT && highOpParm != LTE))
+	// the nodes of an old index file must be upgraded as they are read
+	if (legacyFormat)
 	{
-		throw BadOpcodesException();
+		return;
 	}
 
-	// throw an exception if the search range is bad
-	if (*(int *)lowValParm > *(int *)highValParm)
+	// the pages changed in the buffer pool are written first, and the file is not written again
+	bufMgr->flushFile(file);
+	int fd = ::open(file->filename().c_str(), O_RDONLY);
+	if (fd < 0)
 	{
-		throw BadScanrangeException();
+		return;
 	}
-
-	// end the last scan
-	if (scanExecuting)
+	struct stat st;
+	void *addr = MAP_FAILED;
+	if (::fstat(fd, &st) == 0 && st.st_size > 0)
 	{
-		endScan();
+		mappingSize = st.st_size;
+		addr = ::mmap(NULL, mappingSize, PROT_READ, MAP_SHARED, fd, 0);
+	}
+	::close(fd);
+	if (addr == MAP_FAILED)
+	{
+		mappingSize = 0;
+		return;
 	}
+	mapping = (const char *)addr;
 
-	// set the scanning information
-	scanExecuting = true;
-	lowValInt = *(int *)lowValParm;
-	lowOp = lowOpParm;
-	highValInt = *(int *)highValParm;
-	highOp = highOpParm;
-	
-	// find the leftmost entry with a key that lies within the search bound
-	currentPageNum = findLeafPageNum(lowValInt, lowOp);
+	// the leaves are reached at random, while the non leaf nodes are all read by the first lookups
+	::madvise(addr, mappingSize, MADV_RANDOM);
+	switch (attributeType)
+	{
+	case INTEGER:
+		adviseNonLeaves<int>();
+		break;
+	case DOUBLE:
+		adviseNonLeaves<double>();
+		break;
+	case STRING:
+		adviseNonLeaves<StringKey>();
+		break;
+	}
+}
 
-	if (currentPageNum != Page::INVALID_NUMBER) {
-		// read the starting page possibly having the first entry
-		bufMgr->readPage(file, currentPageNum, currentPageData);
+// -----------------------------------------------------------------------------
+// BTreeIndex::adviseNonLeaves
+// -----------------------------------------------------------------------------
 
-		// this will be incremented later
-		nextEntry = -1;
+template <class T>
+void BTreeIndex::adviseNonLeaves()
+{
+	// each level is advised as a whole before its nodes are read for the next one
+	std::vector<PageId> level(1, rootPageNum);
+	while (!level.empty())
+	{
+		for (PageId pageNum : level)
+		{
+			::madvise(mappedPage(pageNum), Page::SIZE, MADV_WILLNEED);
+		}
 
-		// find the actual current page and first entry
-		// the starting page will be unpinned unless it is what we found
-		if (updateScanEntry())
+		std::vector<PageId> children;
+		for (PageId pageNum : level)
 		{
-			// return if found
-			return;
+			auto *nodePtr = (const NonLeafNode<T> *)mappedPage(pageNum);
+			if (nodePtr->level == 1)
+			{
+				continue;
+			}
+			for (int i = 0; i <= nodePtr->numKeys; ++i)
+			{
+				children.push_back(nodePtr->pageNoArray[i]);
+			}
 		}
+		level.swap(children);
 	}
-	
-	// throw an exception if no such entry is found
-	throw NoSuchKeyFoundException();
 }
 
 // -----------------------------------------------------------------------------
-// BTreeIndex::scanNext
+// BTreeIndex::checkWritable
 // -----------------------------------------------------------------------------
 
-void BTreeIndex::scanNext(RecordId& outRid) 
+void BTreeIndex::checkWritable() const
 {
-	// throw an exception if no scan has been initialized
-	if (!scanExecuting)
-	{
-		throw ScanNotInitializedException();
-	}
-
-	// throw an exception if no more satisfying record
-	if (nextEntry == -1)
+	if (readOnly)
 	{
-		throw IndexScanCompletedException();
+		throw IndexReadOnlyException();
 	}
-
-	// return the next record ID via reference
-	outRid = ((LeafNodeInt *)currentPageData)->ridArray[nextEntry];
-
-	// update the next record
-	updateScanEntry();
 }
 
 // -----------------------------------------------------------------------------
-// BTreeIndex::endScan
+// BTreeIndex::~BTreeIndex -- destructor
 // -----------------------------------------------------------------------------
-//
-void BTreeIndex::endScan() 
+
+BTreeIndex::~BTreeIndex()
 {
-	// throw an exception if no scan has been initialized.
-	if (!scanExecuting)
+	// end the last scanning
+	if (scanCursor.isExecuting())
 	{
-		throw ScanNotInitializedException();
+		scanCursor.endScan();
 	}
 
-	// unpin without modification
-	if (currentPageNum != Page::INVALID_NUMBER)
+	if (mapping != nullptr)
 	{
-		bufMgr->unPinPage(file, currentPageNum, false);
+		::munmap((void *)mapping, mappingSize);
+		mapping = nullptr;
 	}
 
-	// reset correspondingly
-	scanExecuting = false;
-	nextEntry = -1;
-	currentPageNum = Page::INVALID_NUMBER;
-	currentPageData = nullptr;
+	// flush the file before the deletion, once the buffered entries are applied and the cached nodes unpinned
+	flushInsertBuffer();
+	if (cacheNodes)
+	{
+		bufMgr->removePinHolder(this);
+		clearNodeCache();
+	}
+	bufMgr->flushFile(file);
+
+	// the file no longer needs its log once its pages are synced
+	LogManager *log = bufMgr->getLog();
+	if (log != NULL && log->isAttached(file))
+	{
+		file->sync();
+		log->detach(file);
+	}
+
+	delete file;
+	file = nullptr;
 }
 
 // -----------------------------------------------------------------------------
-// BTreeIndex::clearNode
+// BTreeIndex::commit
 // -----------------------------------------------------------------------------
-//
-void BTreeIndex::clearNode(NonLeafNodeInt *nodeIntPtr, int level, int st, int ed)
+
+void BTreeIndex::commit()
 {
-	nodeIntPtr->level = level;
-	for (int i = st; i < ed; ++i)
-	{
-		nodeIntPtr->keyArray[i] = 0;
-		nodeIntPtr->pageNoArray[i] = Page::INVALID_NUMBER;
-	}
-	nodeIntPtr->pageNoArray[ed] = Page::INVALID_NUMBER;
+	flushInsertBuffer();
+	bufMgr->commit();
 }
 
 // -----------------------------------------------------------------------------
-// BTreeIndex::clearLeaf
+// BTreeIndex::setInsertBuffer
 // -----------------------------------------------------------------------------
-//
-void BTreeIndex::clearLeaf(LeafNodeInt *leafIntPtr, PageId rightSibPageNo, int st, int ed)
+
+void BTreeIndex::setInsertBuffer(std::size_t capacity)
 {
-	leafIntPtr->rightSibPageNo = rightSibPageNo;
-	for (int i = st; i < ed; ++i)
+	checkWritable();
+	flushInsertBuffer();
+	insertBufferCapacity = capacity;
+	deltaMode = false;
+	if (capacity == 0)
+	{
+		insertBuffer.reset();
+		return;
+	}
+	switch (attributeType)
 	{
-		leafIntPtr->keyArray[i] = 0;
-		leafIntPtr->ridArray[i] = {Page::INVALID_NUMBER, Page::INVALID_SLOT, 0};
+	case INTEGER:
+		insertBuffer.reset(new InsertBuffer<int>());
+		break;
+	case DOUBLE:
+		insertBuffer.reset(new InsertBuffer<double>());
+		break;
+	case STRING:
+		insertBuffer.reset(new InsertBuffer<StringKey>());
+		break;
 	}
 }
 
 // -----------------------------------------------------------------------------
-// BTreeIndex::insertPageKeyPairAux
+// BTreeIndex::setDeltaIndex
 // -----------------------------------------------------------------------------
 
-template <class T>
-void BTreeIndex::insertPageKeyPairAux(NonLeafNodeInt *nodeIntPtr, int m, const PageKeyPair<T> &pk, int pos)
+void BTreeIndex::setDeltaIndex(std::size_t capacity)
 {
-	for (int i = m - 1; i >= pos; --i)
+	// the included values of the entries of the delta could not be merged with those of the leaves
+	if (capacity > 0 && includedWidth > 0)
 	{
-		nodeIntPtr->pageNoArray[i + 2] = nodeIntPtr->pageNoArray[i + 1];
-		nodeIntPtr->keyArray[i + 1] = nodeIntPtr->keyArray[i];
+		throw BadIndexInfoException("included attributes");
 	}
-
-	nodeIntPtr->pageNoArray[pos + 1] = pk.pageNo;
-	nodeIntPtr->keyArray[pos] = pk.key;
+	setInsertBuffer(capacity);
+	deltaMode = capacity > 0;
 }
 
 // -----------------------------------------------------------------------------
-// BTreeIndex::insertRIDKeyPairAux
+// BTreeIndex::flushInsertBuffer
 // -----------------------------------------------------------------------------
 
-template <class T>
-void BTreeIndex::insertRIDKeyPairAux(LeafNodeInt *leafIntPtr, int m, const RIDKeyPair<T> &rk, int pos)
+void BTreeIndex::flushInsertBuffer()
 {
-	for (int i = m - 1; i >= pos; --i)
+	if (insertBuffer == nullptr)
 	{
-		leafIntPtr->ridArray[i + 1] = leafIntPtr->ridArray[i];
-		leafIntPtr->keyArray[i + 1] = leafIntPtr->keyArray[i];
+		return;
+	}
+	switch (attributeType)
+	{
+	case INTEGER:
+		flushBuffered<int>(nullptr, nullptr);
+		break;
+	case DOUBLE:
+		flushBuffered<double>(nullptr, nullptr);
+		break;
+	case STRING:
+		flushBuffered<StringKey>(nullptr, nullptr);
+		break;
 	}
-
-	leafIntPtr->ridArray[pos] = rk.rid;
-	leafIntPtr->keyArray[pos] = rk.key;
 }
 
 // -----------------------------------------------------------------------------
-// BTreeIndex::findPageNumInNode
+// BTreeIndex::getNumBufferedEntries
 // -----------------------------------------------------------------------------
 
-PageId BTreeIndex::findPageNumInNode(NonLeafNodeInt *nodeIntPtr, int val, Operator op)
+std::size_t BTreeIndex::getNumBufferedEntries()
 {
-	if (nodeIntPtr->pageNoArray[1] == Page::INVALID_NUMBER)
+	if (insertBuffer == nullptr)
 	{
-		// the node has no key
-		return nodeIntPtr->pageNoArray[0];
+		return 0;
 	}
-	else
+	std::lock_guard<std::mutex> lock(insertBufferMutex);
+	switch (attributeType)
 	{
-		// find the leftmost valid children page
-		for (int i = 0; 
-				i < nodeOccupancy + 1 && nodeIntPtr->pageNoArray[i] != Page::INVALID_NUMBER;
-				++i)
-		{
-			// found if the upper bound doesn't exist or is at least the given value
-			if (i + 1 == nodeOccupancy + 1
-					|| nodeIntPtr->pageNoArray[i + 1] == Page::INVALID_NUMBER
-					|| compareOp(nodeIntPtr->keyArray[i], val, op))
-			{
-				return nodeIntPtr->pageNoArray[i];
-			}
-		}
+	case INTEGER:
+		return static_cast<InsertBuffer<int> *>(insertBuffer.get())->size();
+	case DOUBLE:
+		return static_cast<InsertBuffer<double> *>(insertBuffer.get())->size();
+	case STRING:
+		return static_cast<InsertBuffer<StringKey> *>(insertBuffer.get())->size();
 	}
-
-	return Page::INVALID_NUMBER;
+	return 0;
 }
 
 // -----------------------------------------------------------------------------
-// BTreeIndex::findLeafPageNum
+// BTreeIndex::bufferEntry
 // -----------------------------------------------------------------------------
 
-PageId BTreeIndex::findLeafPageNum(int val, Operator op)
+template <class T>
+void BTreeIndex::bufferEntry(const RIDKeyPair<T> &rk, const char *included)
 {
-	// start from the root page
-	PageId curPageNum = rootPageNum;
-	Page *curPage;
-	bufMgr->readPage(file, curPageNum, curPage);
-
-	int curLevel;       // current level
-	PageId nxtPageNum;  // next page id
-
-	while (true)
+	std::lock_guard<std::mutex> lock(insertBufferMutex);
+	auto *buffer = static_cast<InsertBuffer<T> *>(insertBuffer.get());
+	if (deltaMode)
 	{
-		auto *curNodeIntPtr = (NonLeafNodeInt *)curPage;
-		curLevel = curNodeIntPtr->level;
-
-		// find the child page to go into
-		nxtPageNum = findPageNumInNode(curNodeIntPtr, val, op);
-
-		bufMgr->unPinPage(file, curPageNum, false);
-
-		if (curLevel == 1 || nxtPageNum == Page::INVALID_NUMBER)
+		// the delta holds an entry once, which is inserted again if it was deleted
+		std::size_t pos = findBufferedPair(rk);
+		if (pos < buffer->entries.size())
 		{
-			// directly return if the next page is a leaf
-			// or if the next page is not found
-			return nxtPageNum;
+			buffer->ops[pos] |= DELTA_INSERT;
+			return;
 		}
+	}
+	appendBuffered(rk, DELTA_INSERT, included);
 
-		// change the current page to the next
-		curPageNum = nxtPageNum;
-		bufMgr->readPage(file, nxtPageNum, curPage);
+	// the buffer is applied in key order, each leaf receiving its entries at once
+	if (buffer->size() >= insertBufferCapacity)
+	{
+		mergeBufferRuns<T>(true);
+		applyBuffered<T>(0, buffer->entries.size());
 	}
 }
 
 // -----------------------------------------------------------------------------
-// BTreeIndex::updateScanEntry
+// BTreeIndex::appendBuffered
 // -----------------------------------------------------------------------------
 
-bool BTreeIndex::updateScanEntry()
+template <class T>
+void BTreeIndex::appendBuffered(const RIDKeyPair<T> &rk, std::uint8_t op, const char *included)
 {
-	auto *curLeafIntPtr = (LeafNodeInt *)currentPageData;
-
-	while (true)
+	auto *buffer = static_cast<InsertBuffer<T> *>(insertBuffer.get());
+	buffer->entries.push_back(rk);
+	buffer->ops.push_back(op);
+	if (includedWidth > 0)
+	{
+		buffer->included.insert(buffer->included.end(), included, included + includedWidth);
+	}
+	std::size_t numSorted = buffer->runEnds.empty() ? 0 : buffer->runEnds.back();
+	if (buffer->entries.size() - numSorted >= INSERT_BUFFER_TAIL)
 	{
-		++nextEntry;
+		mergeBufferRuns<T>(false);
+	}
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::mergeBufferRuns
+// -----------------------------------------------------------------------------
+
+template <class T>
+void BTreeIndex::mergeBufferRuns(bool all)
+{
+	auto *buffer = static_cast<InsertBuffer<T> *>(insertBuffer.get());
+	std::vector<RIDKeyPair<T>> &entries = buffer->entries;
+	std::vector<std::uint8_t> &ops = buffer->ops;
+	std::vector<char> &included = buffer->included;
 
-		// check if at the end of the current page
-		if (nextEntry >= leafOccupancy
-				|| curLeafIntPtr->ridArray[nextEntry].page_number == Page::INVALID_NUMBER)
+	// move the entries at the given positions, all of them from the first one on, there in that order
+	// dropping those taken out of the buffer
+	auto gather = [&](std::size_t first, const std::vector<std::size_t> &order) {
+		std::vector<RIDKeyPair<T>> movedEntries;
+		std::vector<std::uint8_t> movedOps;
+		std::vector<char> movedIncluded;
+		movedEntries.reserve(order.size());
+		movedOps.reserve(order.size());
+		movedIncluded.reserve(order.size() * includedWidth);
+		for (std::size_t pos : order)
 		{
-			// break if at the end of all leaves
-			if (curLeafIntPtr->rightSibPageNo == Page::INVALID_NUMBER)
+			if (ops[pos] == 0)
 			{
-				break;
+				buffer->numErased--;
+				continue;
 			}
-
-			// unpin and change the page to the right sibling page
-			bufMgr->unPinPage(file, currentPageNum, false);
-			currentPageNum = curLeafIntPtr->rightSibPageNo;
-			bufMgr->readPage(file, currentPageNum, currentPageData);
-			curLeafIntPtr = (LeafNodeInt *)currentPageData;
-
-			// it should always has at least one entry
-			nextEntry = 0;
+			movedEntries.push_back(entries[pos]);
+			movedOps.push_back(ops[pos]);
+			movedIncluded.insert(movedIncluded.end(), included.begin() + pos * includedWidth,
+			                     included.begin() + (pos + 1) * includedWidth);
 		}
+		entries.resize(first);
+		ops.resize(first);
+		included.resize(first * includedWidth);
+		entries.insert(entries.end(), movedEntries.begin(), movedEntries.end());
+		ops.insert(ops.end(), movedOps.begin(), movedOps.end());
+		included.insert(included.end(), movedIncluded.begin(), movedIncluded.end());
+	};
 
-		// check if the key lies within the bound
-
-		// skip to the next one if the key is too small
-		// this only happens when a scan starts and the first entry is to be initialized
-		if (!compareOp(curLeafIntPtr->keyArray[nextEntry], lowValInt, lowOp))
+	// the unsorted entries become the newest run, equal entries keeping the order they came in
+	std::vector<std::size_t> &runEnds = buffer->runEnds;
+	std::size_t numSorted = runEnds.empty() ? 0 : runEnds.back();
+	if (entries.size() > numSorted)
+	{
+		std::vector<std::size_t> order(entries.size() - numSorted);
+		for (std::size_t i = 0; i < order.size(); ++i)
 		{
-			continue;
+			order[i] = numSorted + i;
 		}
+		std::stable_sort(order.begin(), order.end(),
+				[&entries](std::size_t a, std::size_t b) { return entries[a] < entries[b]; });
+		gather(numSorted, order);
+		runEnds.push_back(entries.size());
+	}
 
-		// break if the key is too large
-		// since it cannot be found later
-		if (!compareOp(curLeafIntPtr->keyArray[nextEntry], highValInt, highOp))
+	// merge the newest run with the one before it, the entries of the older one first among equal ones
+	// a single run is merged with nothing to drop the entries taken out of it
+	while (runEnds.size() > 1 || (all && buffer->numErased > 0))
+	{
+		std::size_t end = runEnds.back();
+		std::size_t middle = runEnds.size() > 1 ? runEnds[runEnds.size() - 2] : end;
+		std::size_t begin = runEnds.size() > 2 ? runEnds[runEnds.size() - 3] : 0;
+		if (!all && middle - begin > end - middle)
 		{
 			break;
 		}
-
-		// found if the key is within the range
-		// return directly without unpinning
-		return true;
+		std::vector<std::size_t> order;
+		order.reserve(end - begin);
+		std::size_t i = begin;
+		std::size_t j = middle;
+		while (i < middle || j < end)
+		{
+			order.push_back(j == end || (i < middle && !(entries[j] < entries[i])) ? i++ : j++);
+		}
+		gather(begin, order);
+		if (runEnds.size() > 1)
+		{
+			runEnds.pop_back();
+		}
+		runEnds.back() = entries.size();
+	}
+	if (entries.empty())
+	{
+		runEnds.clear();
 	}
-
-	// not found
-	// unpin the current page and reset information correspondingly
-	bufMgr->unPinPage(file, currentPageNum, false);
-	currentPageNum = Page::INVALID_NUMBER;
-	currentPageData = nullptr;
-	nextEntry = -1;
-	return false;
 }
 
 // -----------------------------------------------------------------------------
-// BTreeIndex::insertPageKeyPair
+// BTreeIndex::findBufferedPair
 // -----------------------------------------------------------------------------
+
 template <class T>
-bool BTreeIndex::insertPageKeyPair(NonLeafNodeInt *nodeIntPtr, const PageKeyPair<T> &pk1, PageKeyPair<T> &pk2)
+std::size_t BTreeIndex::findBufferedPair(const RIDKeyPair<T> &rk)
 {
-	int m = nodeOccupancy;    // number of pages in the node
-	int pos = nodeOccupancy;  // position to insert
-	for (int i = 0; i < nodeOccupancy; ++i)
+	auto *buffer = static_cast<InsertBuffer<T> *>(insertBuffer.get());
+	const std::vector<RIDKeyPair<T>> &entries = buffer->entries;
+	std::size_t begin = 0;
+	for (std::size_t end : buffer->runEnds)
 	{
-		if (nodeIntPtr->pageNoArray[i + 1] == Page::INVALID_NUMBER)
+		std::size_t pos = std::lower_bound(entries.begin() + begin, entries.begin() + end, rk) - entries.begin();
+		for (; pos < end && !(rk < entries[pos]); ++pos)
 		{
-			m = i;
-			if (pos == nodeOccupancy)
+			if (buffer->ops[pos] != 0)
 			{
-				pos = m;
+				return pos;
 			}
-			break;
 		}
-		if (pos == nodeOccupancy && nodeIntPtr->keyArray[i] > pk1.key)
+		begin = end;
+	}
+	for (std::size_t pos = begin; pos < entries.size(); ++pos)
+	{
+		if (buffer->ops[pos] != 0 && !(rk < entries[pos]) && !(entries[pos] < rk))
 		{
-			pos = i;
+			return pos;
 		}
 	}
+	return entries.size();
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::bufferDeletion
+// -----------------------------------------------------------------------------
 
-	if (m != nodeOccupancy)
+template <class T>
+bool BTreeIndex::bufferDeletion(const RIDKeyPair<T> &rk)
+{
+	std::lock_guard<std::mutex> lock(insertBufferMutex);
+	auto *buffer = static_cast<InsertBuffer<T> *>(insertBuffer.get());
+	std::size_t pos = findBufferedPair(rk);
+	if (pos < buffer->entries.size())
 	{
-		// the non leaf node is not full
-		insertPageKeyPairAux(nodeIntPtr, m, pk1, pos);
+		// an entry inserted in the delta is removed, one of the tree inserted again is deleted only
+		if (!(buffer->ops[pos] & DELTA_INSERT))
+		{
+			return false;
+		}
+		if (buffer->ops[pos] & DELTA_DELETE)
+		{
+			buffer->ops[pos] = DELTA_DELETE;
+		}
+		else
+		{
+			buffer->ops[pos] = 0;
+			buffer->numErased++;
+		}
 		return true;
 	}
-	else
-	{
-		// if full, split the non leaf node
-		int mid = (m + 1) >> 1;  // median position
 
-		// allocate a newly split page
-		PageId splitPageNum;
-		Page *splitPage;
-		bufMgr->allocPage(file, splitPageNum, splitPage);
+	// the entry is assumed to be in the tree, its deletion being a no-op otherwise
+	appendBuffered(rk, DELTA_DELETE, nullptr);
+	if (buffer->size() >= insertBufferCapacity)
+	{
+		mergeBufferRuns<T>(true);
+		applyBuffered<T>(0, buffer->entries.size());
+	}
+	return true;
+}
 
-		auto *splitNodeIntPtr = (NonLeafNodeInt *)splitPage;
-		// set the level of the split non leaf node
-		clearNode(splitNodeIntPtr, nodeIntPtr->level, 0, m);
+// -----------------------------------------------------------------------------
+// BTreeIndex::applyBuffered
+// -----------------------------------------------------------------------------
 
-		// copy the right half to the split node
-		// if inserted in the left, the median will change
-		// the old median will be stored at index 0 in this case
-		// otherwise, skip the median for pushing up
-		int splitIndex = 0;
-		splitNodeIntPtr->pageNoArray[0] = nodeIntPtr->pageNoArray[mid];
-		for (int i = mid + (pos > mid); i < m; ++i)
+template <class T>
+void BTreeIndex::applyBuffered(std::size_t first, std::size_t last)
+{
+	auto *buffer = static_cast<InsertBuffer<T> *>(insertBuffer.get());
+	std::vector<RIDKeyPair<T>> entries(buffer->entries.begin() + first, buffer->entries.begin() + last);
+	std::vector<char> values(buffer->included.begin() + first * includedWidth,
+	                         buffer->included.begin() + last * includedWidth);
+	std::vector<std::uint8_t> ops(buffer->ops.begin() + first, buffer->ops.begin() + last);
+	buffer->entries.erase(buffer->entries.begin() + first, buffer->entries.begin() + last);
+	buffer->included.erase(buffer->included.begin() + first * includedWidth,
+	                       buffer->included.begin() + last * includedWidth);
+	buffer->ops.erase(buffer->ops.begin() + first, buffer->ops.begin() + last);
+	buffer->runEnds.assign(buffer->entries.empty() ? 0 : 1, buffer->entries.size());
+	if (deltaMode)
+	{
+		// the deletions go first, so that an entry deleted and inserted again replaces that of the tree
+		// the delta of a covering index is refused, so there are no included values to filter alongside
+		std::vector<RIDKeyPair<T>> inserted;
+		for (std::size_t i = 0; i < entries.size(); ++i)
 		{
-			splitNodeIntPtr->keyArray[splitIndex] = nodeIntPtr->keyArray[i];
-			splitNodeIntPtr->pageNoArray[splitIndex + 1] = nodeIntPtr->pageNoArray[i + 1];
-			++splitIndex;
+			if (ops[i] & DELTA_DELETE)
+			{
+				deletePair(entries[i]);
+			}
+			if (ops[i] & DELTA_INSERT)
+			{
+				inserted.push_back(entries[i]);
+			}
 		}
+		entries.swap(inserted);
+	}
+	if (!entries.empty())
+	{
+		insertPairs(entries, values.data());
+	}
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::flushBuffered
+// -----------------------------------------------------------------------------
+
+template <class T>
+void BTreeIndex::flushBuffered(const T *lowKey, const T *highKey)
+{
+	std::lock_guard<std::mutex> lock(insertBufferMutex);
+	mergeBufferRuns<T>(true);
+	auto *buffer = static_cast<InsertBuffer<T> *>(insertBuffer.get());
+	auto begin = buffer->entries.begin();
+	auto end = buffer->entries.end();
+	if (lowKey != nullptr)
+	{
+		begin = std::lower_bound(begin, end, *lowKey,
+				[](const RIDKeyPair<T> &entry, const T &key) { return entry.key < key; });
+	}
+	if (highKey != nullptr)
+	{
+		end = std::upper_bound(begin, end, *highKey,
+				[](const T &key, const RIDKeyPair<T> &entry) { return key < entry.key; });
+	}
+	if (begin != end)
+	{
+		applyBuffered<T>(begin - buffer->entries.begin(), end - buffer->entries.begin());
+	}
+}
 
-		if (pos <= mid)
+// -----------------------------------------------------------------------------
+// BTreeIndex::findBuffered
+// -----------------------------------------------------------------------------
+
+template <class T>
+bool BTreeIndex::findBuffered(const T &key, RecordId &outRid, bool &deleted)
+{
+	// the inserted entry of the lowest record ID is found, as in the tree
+	auto *buffer = static_cast<InsertBuffer<T> *>(insertBuffer.get());
+	const std::vector<RIDKeyPair<T>> &entries = buffer->entries;
+	bool found = false;
+	auto probe = [&](std::size_t pos) {
+		if (buffer->ops[pos] & DELTA_INSERT)
 		{
-			// insert in the left half of the original node
-			// after this, the key at index mid will be the new median
-			// which will be later cleared for pushing up
-			insertPageKeyPairAux(nodeIntPtr, mid, pk1, pos);
+			if (!found || entries[pos].rid < outRid)
+			{
+				outRid = entries[pos].rid;
+			}
+			found = true;
 		}
-		else
+		else if (buffer->ops[pos] != 0)
 		{
-			// insert in the split node
-			// due to pushing up, the number of key is one less
-			insertPageKeyPairAux(splitNodeIntPtr, m - mid - 1, pk1, pos - mid - 1);
+			deleted = true;
 		}
+	};
+	std::size_t begin = 0;
+	for (std::size_t end : buffer->runEnds)
+	{
+		auto it = std::lower_bound(entries.begin() + begin, entries.begin() + end, key,
+				[](const RIDKeyPair<T> &entry, const T &k) { return entry.key < k; });
+		for (; it != entries.begin() + end && !(key < it->key); ++it)
+		{
+			probe(it - entries.begin());
+		}
+		begin = end;
+	}
+	for (std::size_t pos = begin; pos < entries.size(); ++pos)
+	{
+		if (!(key < entries[pos].key) && !(entries[pos].key < key))
+		{
+			probe(pos);
+		}
+	}
+	return found;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::lookupMerged
+// -----------------------------------------------------------------------------
 
-		// push up the median
-		pk2 = {splitPageNum, nodeIntPtr->keyArray[mid]};
+bool BTreeIndex::lookupMerged(const void *key, RecordId &outRid)
+{
+	BTreeCursor cursor(this);
+	try
+	{
+		cursor.startScan(key, GTE, key, LTE);
+	}
+	catch (const NoSuchKeyFoundException &)
+	{
+		return false;
+	}
+	cursor.scanNext(outRid);
+	return true;
+}
 
-		// clear the right half (starting from mid) of the original node
-		clearNode(nodeIntPtr, nodeIntPtr->level, mid, m);
+// -----------------------------------------------------------------------------
+// BTreeIndex::eraseBuffered
+// -----------------------------------------------------------------------------
 
-		bufMgr->unPinPage(file, splitPageNum, true);
+template <class T>
+bool BTreeIndex::eraseBuffered(const RIDKeyPair<T> &rk)
+{
+	// the entry stays in its run until the run is merged
+	std::lock_guard<std::mutex> lock(insertBufferMutex);
+	auto *buffer = static_cast<InsertBuffer<T> *>(insertBuffer.get());
+	std::size_t pos = findBufferedPair(rk);
+	if (pos == buffer->entries.size())
+	{
 		return false;
 	}
+	buffer->ops[pos] = 0;
+	buffer->numErased++;
+	return true;
 }
 
 // -----------------------------------------------------------------------------
-// BTreeIndex::insertRIDKeyPair
+// BTreeIndex::insertEntry
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::insertEntry(const void *key, const RecordId rid, const void *included) 
+{
+	checkWritable();
+	OpTimer timer(activeMetrics(), OP_INSERT);
+
+	// the included values of a covering index are taken from the record of the key if not given
+	char values[MAX_INCLUDED_WIDTH];
+	if (includedWidth > 0 && included == NULL)
+	{
+		loadIncluded((const char *)key - attrByteOffset, values);
+		included = values;
+	}
+
+	switch (attributeType)
+	{
+	case INTEGER:
+		insertEntryTyped<int>(key, rid, (const char *)included);
+		break;
+	case DOUBLE:
+		insertEntryTyped<double>(key, rid, (const char *)included);
+		break;
+	case STRING:
+		insertEntryTyped<StringKey>(key, rid, (const char *)included);
+		break;
+	}
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::insertEntryTyped
 // -----------------------------------------------------------------------------
 
 template <class T>
-bool BTreeIndex::insertRIDKeyPair(LeafNodeInt *leafIntPtr, const RIDKeyPair<T> &rk, PageKeyPair<T> &pk)
+void BTreeIndex::insertEntryTyped(const void *key, const RecordId rid, const char *included) 
 {
-	int m = leafOccupancy;    // number of pages in the leaf
-	int pos = leafOccupancy;  // position to insert
-	for (int i = 0; i < leafOccupancy; ++i)
+	// construct the data entry to insert
+	RIDKeyPair<T> inserted;
+	inserted.rid = rid;
+	readKey(key, inserted.key);
+	// the key is in the lookup filter before the entry can be found
+	if (lookupFilter != nullptr)
+	{
+		lookupFilter->add(filterHash(inserted.key));
+	}
+	if (insertBuffer != nullptr)
+	{
+		bufferEntry(inserted, included);
+		return;
+	}
+
+	// splits may run concurrently, but no merge
+	treeLatch.lockShared();
+
+	// latch the leaf to insert into, recording the non leaf nodes the descent went down from
+	// none of them stays pinned, so an insert that does not split pins a single page
+	// an append to the rightmost leaf skips the descent, the parent being found again if the leaf splits
+	DescentStack path;
+	bool bounded;
+	T upperBound;
+	Page *curPage;
+	PageId curPageNum;
+	if (!findAppendLeaf(inserted.key, curPageNum, curPage))
+	{
+		curPageNum = findLeafPageNum<GT>(inserted.key, curPage, bounded, upperBound, true, &path);
+	}
+	bool rightmost = ((LeafNode<T> *)curPage)->rightSibPageNo == Page::INVALID_NUMBER;
+
+	// only the nodes actually changed are unpinned dirty, so that unchanged pages are not written back
+	// the rightmost leaf, or the leaf split off it, is remembered for the next appends
+	PageKeyPair<T> pushed;
+	bool dirty;
+	SplitTimer splitTimer(activeMetrics());
+	if (insertRIDKeyPair((LeafNode<T> *)curPage, inserted, pushed, dirty, included))
 	{
-		if (leafIntPtr->ridArray[i].page_number == Page::INVALID_NUMBER)
+		if (rightmost)
 		{
-			m = i;
-			if (pos == leafOccupancy)
-			{
-				pos = m;
-			}
-			break;
+			appendLeafNum = curPageNum;
 		}
-		if (pos == leafOccupancy && leafIntPtr->keyArray[i] > rk.key)
+		bufMgr->latchOf(curPage).unlockExclusive();
+		bufMgr->unPinPage(file, curPageNum, dirty);
+	}
+	else
+	{
+		if (rightmost)
 		{
-			pos = i;
+			appendLeafNum = pushed.pageNo;
 		}
+		splitTimer.split(0, curPageNum);
+		insertPushedUp(curPageNum, curPage, pushed, path);
 	}
+	treeLatch.unlockShared();
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::findAppendLeaf
+// -----------------------------------------------------------------------------
 
-	if (m != leafOccupancy)
+template <class T>
+bool BTreeIndex::findAppendLeaf(const T &key, PageId &pageNum, Page *&page)
+{
+	pageNum = appendLeafNum;
+	if (pageNum == Page::INVALID_NUMBER)
 	{
-		// the leaf node is not full
-		insertRIDKeyPairAux(leafIntPtr, m, rk, pos);
-		return true;
+		return false;
 	}
-	else
+
+	// the leaf is still in the tree, but may have been split since it was seen
+	// a key past its last one, and so past its separator in the parent, belongs to the rightmost leaf
+	readNode(pageNum, page, true);
+	bufMgr->latchOf(page).lockExclusive();
+	auto *leafPtr = (const LeafNode<T> *)page;
+	if (leafPtr->rightSibPageNo == Page::INVALID_NUMBER && leafPtr->numKeys > 0
+			&& nodeKey(leafPtr, leafPtr->numKeys - 1) < key)
 	{
-		// if full, split the leaf node
-		int mid = (m + 1) >> 1;  // median position
+		return true;
+	}
+	bufMgr->latchOf(page).unlockExclusive();
+	bufMgr->unPinPage(file, pageNum, false);
+	return false;
+}
 
-		// allocate a newly split page
-		PageId splitPageNum;
-		Page *splitPage;
-		bufMgr->allocPage(file, splitPageNum, splitPage);
+// -----------------------------------------------------------------------------
+// BTreeIndex::insertPushedUp
+// -----------------------------------------------------------------------------
 
-		auto *splitLeafIntPtr = (LeafNodeInt *)splitPage;
-		// set the right sibling of the split leaf
-		clearLeaf(splitLeafIntPtr, leafIntPtr->rightSibPageNo, 0, m);
+template <class T>
+void BTreeIndex::insertPushedUp(PageId curPageNum, Page *curPage, PageKeyPair<T> pushed, DescentStack &path)
+{
+	bool bounded;
+	T upperBound;
 
-		// copy the right half to the split leaf
-		// if inserted in the left, the median will change
-		// the old median will shift one position right
-		// index 0 will be left empty in this case to store the new median
-		int splitIndex = pos <= mid;
-		for (int i = mid; i < m; ++i)
+	// the number of levels gone up from the leaf
+	int height = 0;
+	bool ok = false;
+	while (!ok)
+	{
+		if (curPageNum == rootPageNum)
 		{
-			splitLeafIntPtr->keyArray[splitIndex] = leafIntPtr->keyArray[i];
-			splitLeafIntPtr->ridArray[splitIndex] = leafIntPtr->ridArray[i];
-			++splitIndex;
+			// insert the pushed up key from the old root in a new root
+			// the root only changes while it is latched, so it is still the old one
+			PageId newRootNum;
+			Page *newRootPage;
+			allocIndexPage(newRootNum, newRootPage);
+			auto *newRootPtr = (NonLeafNode<T> *)newRootPage;
+			initNode(newRootPtr, 0);
+
+			// set the pushed up key and children pages for the new root
+			newRootPtr->pageNoArray[0] = curPageNum;
+			insertPageKeyPairAux(newRootPtr, pushed, 0);
+			bufMgr->unPinPage(file, newRootNum, true);
+
+			// update the root before the old one is released, so the readers restarting from it find the new one
+			std::lock_guard<std::mutex> guard(metaMutex);
+			rootPageNum = newRootNum;
+			writeMetaInfo();
+			break;
 		}
 
-		if (pos <= mid)
+		// the split node is linked to its new right sibling, so it is released before the parent is latched
+		bufMgr->latchOf(curPage).unlockExclusive();
+		bufMgr->unPinPage(file, curPageNum, true);
+
+		PageId childPageNum = curPageNum;
+		if (path.size == 0)
 		{
-			// insert in the left half of the original leaf
-			// after this, the left half (0 to mid - 1) will be used
-			// the key at index mid will be the new median
-			// which will be copied at index 0 of the split leaf
-			insertRIDKeyPairAux(leafIntPtr, mid, rk, pos);
-			splitLeafIntPtr->keyArray[0] = leafIntPtr->keyArray[mid];
-			splitLeafIntPtr->ridArray[0] = leafIntPtr->ridArray[mid];
+			// the root has been split since the descent, so the parent is found again from the new root
+			// the tree only grows at the root while the tree latch is held shared
+			Page *leafPage;
+			PageId leafPageNum = findLeafPageNum<GT>(pushed.key, leafPage, bounded, upperBound, false, &path);
+			bufMgr->latchOf(leafPage).unlockShared();
+			bufMgr->unPinPage(file, leafPageNum, false);
+			path.size -= height;
 		}
-		else
+
+		// latch the parent, or the node it has been split into that now holds the pushed up key
+		--path.size;
+		curPageNum = path.pageNo[path.size];
+		int slot = path.slot[path.size];
+		++height;
+		readNode(curPageNum, curPage, false);
+		bufMgr->latchOf(curPage).lockExclusive();
+		moveRight<GT, NonLeafNode<T>>(curPageNum, curPage, pushed.key, false, true);
+
+		// the pushed up key goes right after the split child, which is still at its slot unless the node changed
+		auto *nodePtr = (NonLeafNode<T> *)curPage;
+		int pos = slot <= nodePtr->numKeys && nodePtr->pageNoArray[slot] == childPageNum ? slot : -1;
+		PageKeyPair<T> pushedUp;
+		SplitTimer splitTimer(activeMetrics());
+		ok = insertPageKeyPair(nodePtr, pushed, pushedUp, pos);
+		if (!ok)
 		{
-			// insert in the split leaf
-			insertRIDKeyPairAux(splitLeafIntPtr, m - mid, rk, pos - mid);
+			splitTimer.split(height, curPageNum);
 		}
+		pushed = pushedUp;
+	}
 
-		// copy up the median
-		pk = {splitPageNum, leafIntPtr->keyArray[mid]};
+	bufMgr->latchOf(curPage).unlockExclusive();
+	bufMgr->unPinPage(file, curPageNum, true);
+}
 
-		// clear the right half (starting from mid) of the original leaf
-		clearLeaf(leafIntPtr, splitPageNum, mid, m);
+// -----------------------------------------------------------------------------
+// BTreeIndex::insertEntries
+// -----------------------------------------------------------------------------
 
-		bufMgr->unPinPage(file, splitPageNum, true);
-		return false;
+void BTreeIndex::insertEntries(const void *keys, const RecordId *rids, std::size_t n, const void *included)
+{
+	checkWritable();
+
+	// the keys of a batch are not read from records, so the included values must be given
+	if (includedWidth > 0 && included == NULL)
+	{
+		throw BadIndexInfoException("included attributes");
+	}
+
+	switch (attributeType)
+	{
+	case INTEGER:
+		insertEntriesTyped<int>(keys, rids, n, (const char *)included);
+		break;
+	case DOUBLE:
+		insertEntriesTyped<double>(keys, rids, n, (const char *)included);
+		break;
+	case STRING:
+		insertEntriesTyped<StringKey>(keys, rids, n, (const char *)included);
+		break;
 	}
 }
 
 // -----------------------------------------------------------------------------
-// BTreeIndex::insertEntryAux
+// BTreeIndex::insertEntriesTyped
 // -----------------------------------------------------------------------------
 
 template <class T>
-bool BTreeIndex::insertEntryAux(NonLeafNodeInt *nodeIntPtr, const RIDKeyPair<T> &rk, PageKeyPair<T> &pk)
+void BTreeIndex::insertEntriesTyped(const void *keys, const RecordId *rids, std::size_t n, const char *included)
 {
-	// read the child page to go into
-	PageId nxtPageNum = findPageNumInNode(nodeIntPtr, rk.key, GT);
-	Page *nxtPage;
-	bufMgr->readPage(file, nxtPageNum, nxtPage);
+	std::vector<RIDKeyPair<T>> entries(n);
+	for (std::size_t i = 0; i < n; ++i)
+	{
+		entries[i].rid = rids[i];
+		readKey(keyAt<T>(keys, i), entries[i].key);
+		if (lookupFilter != nullptr)
+		{
+			lookupFilter->add(filterHash(entries[i].key));
+		}
+	}
+	insertPairs(entries, included);
+}
 
-	// possible pushed or copied up entry from a full child page
-	PageKeyPair<int> pushedOrCopied;  
+// -----------------------------------------------------------------------------
+// BTreeIndex::insertPairs
+// -----------------------------------------------------------------------------
 
-	bool ok;  // whether the insertion completes
+template <class T>
+void BTreeIndex::insertPairs(const std::vector<RIDKeyPair<T>> &entries, const char *included)
+{
+	// insert the entries in key order, and equal keys in record ID order as a leaf keeps them
+	std::size_t n = entries.size();
+	std::vector<std::size_t> order(n);
+	for (std::size_t i = 0; i < n; ++i)
+	{
+		order[i] = i;
+	}
+	std::sort(order.begin(), order.end(),
+			[&entries](std::size_t a, std::size_t b) { return entries[a] < entries[b]; });
 
-	// check if the child page is a leaf
-	if (nodeIntPtr->level == 1)
+	treeLatch.lockShared();
+	std::size_t k = 0;
+	while (k < n)
 	{
-		// insert the <rid, key> pair in the leaf node
-		auto *nxtLeafIntPtr = (LeafNodeInt *)nxtPage;
-		ok = insertRIDKeyPair(nxtLeafIntPtr, rk, pushedOrCopied);
+		// one descent and one pin of the leaf for the run of entries below its upper bound
+		DescentStack path;
+		bool bounded;
+		T upperBound;
+		Page *leafPage;
+		PageId leafPageNum = findLeafPageNum<GT>(entries[order[k]].key, leafPage, bounded, upperBound, true, &path);
+
+		bool changed = false;
+		while (true)
+		{
+			std::size_t i = order[k++];
+			PageKeyPair<T> pushed;
+			bool dirty;
+			SplitTimer splitTimer(activeMetrics());
+			if (!insertRIDKeyPair((LeafNode<T> *)leafPage, entries[i], pushed, dirty,
+			                      includedWidth > 0 ? included + i * includedWidth : NULL))
+			{
+				// a split ends the run, the next entries descending again to the leaf they now go to
+				splitTimer.split(0, leafPageNum);
+				insertPushedUp(leafPageNum, leafPage, pushed, path);
+				leafPage = nullptr;
+				break;
+			}
+			changed |= dirty;
+			if (k == n || (bounded && !(entries[order[k]].key < upperBound)))
+			{
+				break;
+			}
+		}
+
+		if (leafPage != nullptr)
+		{
+			bufMgr->latchOf(leafPage).unlockExclusive();
+			bufMgr->unPinPage(file, leafPageNum, changed);
+		}
 	}
-	else
+	treeLatch.unlockShared();
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::setLookupFilter
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::setLookupFilter(int bitsPerKey)
+{
+	if (bitsPerKey <= 0)
 	{
-		// insert in the non leaf node recursively
-		auto *nxtNodeIntPtr = (NonLeafNodeInt *)nxtPage;
-		ok = insertEntryAux(nxtNodeIntPtr, rk, pushedOrCopied);
+		lookupFilter.reset();
+		return;
 	}
 
-	bufMgr->unPinPage(file, nxtPageNum, true);
-	if (ok)
+	// the filter is built from the leaves alone
+	flushInsertBuffer();
+	switch (attributeType)
 	{
-		// no need to perform extra insertion in the current node
-		return true;
+	case INTEGER:
+		setLookupFilterTyped<int>(bitsPerKey);
+		break;
+	case DOUBLE:
+		setLookupFilterTyped<double>(bitsPerKey);
+		break;
+	case STRING:
+		setLookupFilterTyped<StringKey>(bitsPerKey);
+		break;
 	}
+}
 
-	// insert the pushed or copied up key in the current node
-	ok = insertPageKeyPair(nodeIntPtr, pushedOrCopied, pk);
-	return ok;
+template <class T>
+void BTreeIndex::setLookupFilterTyped(int bitsPerKey)
+{
+	treeLatch.lockShared();
+
+	// down the first children to the leftmost leaf
+	PageId pageNum = rootPageNum;
+	while (true)
+	{
+		Page *page;
+		readNodeShared(pageNum, page);
+		auto *nodePtr = (const NonLeafNode<T> *)page;
+		PageId childNum = nodePtr->pageNoArray[0];
+		bool lastLevel = nodePtr->level == 1;
+		releaseLeafShared(pageNum, page);
+		pageNum = childNum;
+		if (lastLevel || childNum == Page::INVALID_NUMBER)
+		{
+			break;
+		}
+	}
+
+	// the root of an old empty index has no leaf
+	std::vector<std::uint64_t> hashes;
+	while (pageNum != Page::INVALID_NUMBER)
+	{
+		Page *page;
+		readLeafShared(pageNum, page);
+		auto *leafPtr = (const LeafNode<T> *)page;
+		for (int i = 0; i < leafPtr->numKeys; ++i)
+		{
+			hashes.push_back(filterHash(nodeKey(leafPtr, i)));
+		}
+		PageId nextNum = leafPtr->rightSibPageNo;
+		releaseLeafShared(pageNum, page);
+		pageNum = nextNum;
+	}
+	treeLatch.unlockShared();
+
+	// room for as many keys again before it saturates
+	lookupFilter.reset(new KeyFilter(std::max<std::size_t>(2 * hashes.size(), 1024), bitsPerKey));
+	for (std::uint64_t h : hashes)
+	{
+		lookupFilter->add(h);
+	}
+}
+
+template <class T>
+bool BTreeIndex::filteredOut(const T &key) const
+{
+	return lookupFilter != nullptr && !lookupFilter->saturated() && !lookupFilter->mayContain(filterHash(key));
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::lookup
+// -----------------------------------------------------------------------------
+
+bool BTreeIndex::lookup(const void *key, RecordId &outRid)
+{
+	OpTimer timer(activeMetrics(), OP_LOOKUP);
+	switch (attributeType)
+	{
+	case INTEGER:
+		return lookupTyped<int>(key, outRid);
+	case DOUBLE:
+		return lookupTyped<double>(key, outRid);
+	case STRING:
+		return lookupTyped<StringKey>(key, outRid);
+	}
+	return false;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::lookupTyped
+// -----------------------------------------------------------------------------
+
+template <class T>
+bool BTreeIndex::lookupTyped(const void *key, RecordId &outRid)
+{
+	T keyT;
+	readKey(key, keyT);
+	if (filteredOut(keyT))
+	{
+		return false;
+	}
+
+	// the buffer is looked into first, an entry leaving it being in the tree before the buffer is released
+	bool deleted = false;
+	if (insertBuffer != nullptr)
+	{
+		std::lock_guard<std::mutex> lock(insertBufferMutex);
+		if (findBuffered(keyT, outRid, deleted))
+		{
+			return true;
+		}
+	}
+
+	// the entry found in the tree might be deleted in the delta
+	if (deleted)
+	{
+		return lookupMerged(key, outRid);
+	}
+
+	bool bounded;
+	T upperBound;
+	Page *leafPage;
+	PageId leafPageNum = findLeafPageNum<GT>(keyT, leafPage, bounded, upperBound);
+	if (leafPageNum == Page::INVALID_NUMBER)
+	{
+		return false;
+	}
+
+	bool ok = findInLeaf((LeafNode<T> *)leafPage, keyT, outRid);
+	releaseLeafShared(leafPageNum, leafPage);
+
+	return ok;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::deleteEntry
+// -----------------------------------------------------------------------------
+
+bool BTreeIndex::deleteEntry(const void *key, const RecordId rid)
+{
+	checkWritable();
+	switch (attributeType)
+	{
+	case INTEGER:
+		return deleteEntryTyped<int>(key, rid);
+	case DOUBLE:
+		return deleteEntryTyped<double>(key, rid);
+	case STRING:
+		return deleteEntryTyped<StringKey>(key, rid);
+	}
+	return false;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::deleteEntryTyped
+// -----------------------------------------------------------------------------
+
+template <class T>
+bool BTreeIndex::deleteEntryTyped(const void *key, const RecordId rid)
+{
+	// construct the data entry to delete
+	RIDKeyPair<T> deleted;
+	deleted.rid = rid;
+	readKey(key, deleted.key);
+	if (insertBuffer != nullptr && deltaMode)
+	{
+		return bufferDeletion(deleted);
+	}
+	if (insertBuffer != nullptr && eraseBuffered(deleted))
+	{
+		return true;
+	}
+	return deletePair(deleted);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::deletePair
+// -----------------------------------------------------------------------------
+
+template <class T>
+bool BTreeIndex::deletePair(const RIDKeyPair<T> &deleted)
+{
+	// a deletion that cannot leave its leaf underfull only latches it, as an insertion does
+	treeLatch.lockShared();
+	bool bounded;
+	T upperBound;
+	Page *leafPage;
+	PageId leafPageNum = findLeafPageNum<GT>(deleted.key, leafPage, bounded, upperBound, true);
+	auto *leafPtr = (LeafNode<T> *)leafPage;
+	bool found = isMergeSafe(leafPtr) && eraseRIDKeyPair(leafPtr, deleted);
+	bufMgr->latchOf(leafPage).unlockExclusive();
+	bufMgr->unPinPage(file, leafPageNum, found);
+	treeLatch.unlockShared();
+	if (found)
+	{
+		return true;
+	}
+
+	// otherwise the path is latched from the root, with no split going on
+	// the entries of a key split between leaves may also lie left of the leaf
+	// a merge may free the rightmost leaf, which is looked up again by the next append
+	treeLatch.lockExclusive();
+	appendLeafNum = Page::INVALID_NUMBER;
+	Page *rootPage;
+	PageId rootNum = latchRoot(rootPage);
+
+	// the pages latched on the path, starting from the root
+	// only the root may be left once the children are done
+	std::vector<Page *> latched(1, rootPage);
+	found = deleteEntryAux((NonLeafNode<T> *)rootPage, deleted, latched);
+	bool rootLatched = !latched.empty();
+	latched.clear();
+
+	if (rootLatched)
+	{
+		if (found && deletePolicy == DELETE_EAGER)
+		{
+			// merges may have left the root with a single child
+			collapseRoot<T>(rootNum, rootPage);
+		}
+		bufMgr->latchOf(rootPage).unlockExclusive();
+	}
+
+	bufMgr->unPinPage(file, rootNum, found);
+	treeLatch.unlockExclusive();
+	return found;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::compact
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::compact()
+{
+	checkWritable();
+	switch (attributeType)
+	{
+	case INTEGER:
+		compactTyped<int>();
+		break;
+	case DOUBLE:
+		compactTyped<double>();
+		break;
+	case STRING:
+		compactTyped<StringKey>();
+		break;
+	}
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::compactTyped
+// -----------------------------------------------------------------------------
+
+template <class T>
+void BTreeIndex::compactTyped()
+{
+	// hold the tree latch and the root page for the whole compaction
+	treeLatch.lockExclusive();
+	appendLeafNum = Page::INVALID_NUMBER;
+	Page *rootPage;
+	PageId rootNum = latchRoot(rootPage);
+
+	bool modified = compactAux((NonLeafNode<T> *)rootPage);
+	collapseRoot<T>(rootNum, rootPage);
+
+	bufMgr->latchOf(rootPage).unlockExclusive();
+	bufMgr->unPinPage(file, rootNum, modified);
+	treeLatch.unlockExclusive();
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::rebuild
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::rebuild(const double targetFill)
+{
+	checkWritable();
+
+	// the buffered entries are applied first, so that they are packed as well
+	flushInsertBuffer();
+	switch (attributeType)
+	{
+	case INTEGER:
+		rebuildTyped<int>(targetFill);
+		break;
+	case DOUBLE:
+		rebuildTyped<double>(targetFill);
+		break;
+	case STRING:
+		rebuildTyped<StringKey>(targetFill);
+		break;
+	}
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::rebuildTyped
+// -----------------------------------------------------------------------------
+
+template <class T>
+void BTreeIndex::rebuildTyped(const double targetFill)
+{
+	treeLatch.lockExclusive();
+	appendLeafNum = Page::INVALID_NUMBER;
+
+	// read the pairs of the leaves in key order, level by level from the root down
+	// they are spilled to run files in chunks of the size of the buffer pool, each chunk being a sorted run
+	// a key with a posting list keeps its single entry referring to it
+	std::size_t budget = std::max<std::size_t>(1,
+			(std::size_t)bufMgr->getNumBufs() * Page::SIZE / sizeof(RIDKeyPair<T>));
+	std::vector<std::vector<RIDKeyPair<T>>> runs(1);
+	std::vector<std::string> runNames;
+	std::vector<IncludedValues> included;
+	std::size_t numPairs = 0;
+	std::vector<PageId> oldPages;
+	std::vector<PageId> level(1, rootPageNum);
+	while (!level.empty())
+	{
+		std::vector<PageId> children;
+		for (PageId pageNum : level)
+		{
+			oldPages.push_back(pageNum);
+			Page *page;
+			readNode(pageNum, page, false);
+			auto *nodePtr = (const NonLeafNode<T> *)page;
+			for (int i = 0; i <= nodePtr->numKeys; ++i)
+			{
+				// the root of an old empty index has no leaf
+				PageId childNum = nodePtr->pageNoArray[i];
+				if (childNum == Page::INVALID_NUMBER)
+				{
+					continue;
+				}
+				if (nodePtr->level != 1)
+				{
+					children.push_back(childNum);
+					continue;
+				}
+
+				oldPages.push_back(childNum);
+				Page *leafPage;
+				readNode(childNum, leafPage, true);
+				auto *leafPtr = (const LeafNode<T> *)leafPage;
+				for (int k = 0; k < leafPtr->numKeys; ++k)
+				{
+					RIDKeyPair<T> rk;
+					rk.set(leafRid(leafPtr, k), nodeKey(leafPtr, k));
+					runs[0].push_back(rk);
+					if (includedWidth > 0)
+					{
+						IncludedValues values;
+						values.rid = rk.rid;
+						memcpy(values.values, includedValues(leafPtr, k), includedWidth);
+						included.push_back(values);
+					}
+					++numPairs;
+				}
+				bufMgr->unPinPage(file, childNum, false);
+
+				if (runs[0].size() >= budget)
+				{
+					runNames.push_back(file->filename() + ".rebuild" + std::to_string(runNames.size()));
+					writeRun(runNames.back(), runs[0]);
+					runs[0].clear();
+				}
+			}
+			bufMgr->unPinPage(file, pageNum, false);
+		}
+		level.swap(children);
+	}
+	std::sort(included.begin(), included.end());
+
+	// pack the new tree into pages appended to the file, as the bulk loader does
+	double fillFactorIn = fillFactor;
+	fillFactor = targetFill;
+	appendPages = true;
+	std::vector<PageKeyPair<T>> children;
+	packLeaves(numPairs, runs, runNames, included, children);
+	for (const std::string &runName : runNames)
+	{
+		std::remove(runName.c_str());
+	}
+	PageId newRootNum = packUpperLevels(children);
+	appendPages = false;
+	fillFactor = fillFactorIn;
+
+	// swap the root, and free the old pages, which get new versions so that the readers still on them restart
+	{
+		std::lock_guard<std::mutex> guard(metaMutex);
+		rootPageNum = newRootNum;
+		writeMetaInfo();
+	}
+	for (PageId pageNum : oldPages)
+	{
+		freeIndexPage(pageNum);
+	}
+	treeLatch.unlockExclusive();
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::collectStats
+// -----------------------------------------------------------------------------
+
+IndexStats BTreeIndex::collectStats(int numBuckets)
+{
+	numBuckets = std::max(numBuckets, 1);
+	switch (attributeType)
+	{
+	case INTEGER:
+		return collectStatsTyped<int>(numBuckets);
+	case DOUBLE:
+		return collectStatsTyped<double>(numBuckets);
+	case STRING:
+		return collectStatsTyped<StringKey>(numBuckets);
+	}
+	return IndexStats();
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::collectStatsTyped
+// -----------------------------------------------------------------------------
+
+template <class T>
+IndexStats BTreeIndex::collectStatsTyped(int numBuckets)
+{
+	IndexStats stats = IndexStats();
+	treeLatch.lockShared();
+
+	// the non leaf levels from the root down, each one listing the children of the previous one
+	// the children of the lowest one are the leaves, in key order
+	std::vector<PageId> level(1, rootPageNum);
+	std::vector<PageId> leaves;
+	double nodeFillSum = 0;
+	std::size_t numNodes = 0;
+	while (!level.empty())
+	{
+		std::vector<PageId> children;
+		for (PageId pageNum : level)
+		{
+			Page *page;
+			readNodeShared(pageNum, page);
+			auto *nodePtr = (const NonLeafNode<T> *)page;
+			nodeFillSum += fillOf(nodePtr, nodeOccupancy);
+			std::vector<PageId> &next = nodePtr->level == 1 ? leaves : children;
+			for (int i = 0; i <= nodePtr->numKeys; ++i)
+			{
+				// the root of an old empty index has no leaf
+				if (nodePtr->pageNoArray[i] != Page::INVALID_NUMBER)
+				{
+					next.push_back(nodePtr->pageNoArray[i]);
+				}
+			}
+			releaseLeafShared(pageNum, page);
+		}
+		stats.pagesPerLevel.insert(stats.pagesPerLevel.begin(), level.size());
+		numNodes += level.size();
+		level.swap(children);
+	}
+	stats.pagesPerLevel.insert(stats.pagesPerLevel.begin(), leaves.size());
+	stats.height = stats.pagesPerLevel.size();
+	stats.nodeFill = nodeFillSum / numNodes;
+
+	// the leaves, each entry of a posting list counting as an entry of its key
+	// the sample is a reservoir of the entries, drawn with the default seed for reproducible plans
+	std::mt19937_64 generator;
+	std::vector<T> sample;
+	T minKey = T();
+	T maxKey = T();
+	double leafFillSum = 0;
+	for (PageId pageNum : leaves)
+	{
+		Page *page;
+		readLeafShared(pageNum, page);
+		auto *leafPtr = (const LeafNode<T> *)page;
+		leafFillSum += fillOf(leafPtr, leafOccupancy);
+		for (int i = 0; i < leafPtr->numKeys; ++i)
+		{
+			T key = nodeKey(leafPtr, i);
+			RecordId rid = leafRid(leafPtr, i);
+			std::size_t numRids = 1;
+			if (isPostingRef(rid))
+			{
+				numRids = 0;
+				for (PageId postingNum = rid.page_number; postingNum != Page::INVALID_NUMBER; )
+				{
+					Page *postingPage;
+					readIndexPage(postingNum, postingPage);
+					auto *postingPtr = (const PostingPage *)postingPage;
+					numRids += postingPtr->numRids;
+					PageId nextNum = postingPtr->nextPageNo;
+					releaseIndexPage(postingNum);
+					postingNum = nextNum;
+					stats.postingPages++;
+				}
+			}
+
+			if (stats.numEntries == 0)
+			{
+				minKey = key;
+			}
+			if (stats.numEntries == 0 || key != maxKey)
+			{
+				stats.distinctKeys++;
+			}
+			maxKey = key;
+			for (std::size_t j = 0; j < numRids; ++j, ++stats.numEntries)
+			{
+				if (sample.size() < STATS_SAMPLE_SIZE)
+				{
+					sample.push_back(key);
+					continue;
+				}
+				std::size_t drawn = generator() % (stats.numEntries + 1);
+				if (drawn < STATS_SAMPLE_SIZE)
+				{
+					sample[drawn] = key;
+				}
+			}
+		}
+		releaseLeafShared(pageNum, page);
+	}
+	treeLatch.unlockShared();
+	stats.leafFill = leaves.empty() ? 0 : leafFillSum / leaves.size();
+
+	if (stats.numEntries == 0)
+	{
+		return stats;
+	}
+	stats.minKey = statsKey(minKey);
+	stats.maxKey = statsKey(maxKey);
+
+	// the bounds of the buckets are the quantiles of the sample, between the least and greatest keys
+	std::sort(sample.begin(), sample.end());
+	stats.histogram.push_back(stats.minKey);
+	for (int b = 1; b < numBuckets; ++b)
+	{
+		stats.histogram.push_back(statsKey(sample[(std::size_t)b * sample.size() / numBuckets]));
+	}
+	stats.histogram.push_back(stats.maxKey);
+	return stats;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::estimateRange
+// -----------------------------------------------------------------------------
+
+double BTreeIndex::estimateRange(const void *lowVal, const Operator lowOp, const void *highVal, const Operator highOp)
+{
+	if ((lowOp != GT && lowOp != GTE) || (highOp != LT && highOp != LTE))
+	{
+		throw BadOpcodesException();
+	}
+	switch (attributeType)
+	{
+	case INTEGER:
+		return estimateRangeTyped<int>(lowVal, lowOp, highVal, highOp);
+	case DOUBLE:
+		return estimateRangeTyped<double>(lowVal, lowOp, highVal, highOp);
+	case STRING:
+		return estimateRangeTyped<StringKey>(lowVal, lowOp, highVal, highOp);
+	}
+	return 0;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::countRange
+// -----------------------------------------------------------------------------
+
+std::size_t BTreeIndex::countRange(const void *lowVal, const Operator lowOp, const void *highVal, const Operator highOp)
+{
+	// a cursor of its own leaves the scan of startScan as it is
+	BTreeCursor cursor(this);
+	try
+	{
+		cursor.startScan(lowVal, lowOp, highVal, highOp);
+	}
+	catch (const NoSuchKeyFoundException &)
+	{
+		return 0;
+	}
+	return cursor.scanSkip(SCAN_NO_LIMIT);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::estimateRangeTyped
+// -----------------------------------------------------------------------------
+
+template <class T>
+double BTreeIndex::estimateRangeTyped(const void *lowVal, const Operator lowOp, const void *highVal, const Operator highOp)
+{
+	T lowKey;
+	T highKey;
+	readKey(lowVal, lowKey);
+	readKey(highVal, highKey);
+	if (highKey < lowKey)
+	{
+		return 0;
+	}
+
+	treeLatch.lockShared();
+	double low = lowOp == GT ? estimatePosition<GT>(lowKey) : estimatePosition<GTE>(lowKey);
+	double high = highOp == LT ? estimatePosition<LT>(highKey) : estimatePosition<LTE>(highKey);
+	treeLatch.unlockShared();
+	return std::min(1.0, std::max(0.0, high - low));
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::estimatePosition
+// -----------------------------------------------------------------------------
+
+template <Operator op, class T>
+double BTreeIndex::estimatePosition(const T &val)
+{
+	// the share of the entries below the node reached, and the position of its first entry
+	double width = 1;
+	double position = 0;
+	PageId pageNum = rootPageNum;
+	while (true)
+	{
+		Page *page;
+		readNodeShared(pageNum, page);
+		auto *nodePtr = (const NonLeafNode<T> *)page;
+		int pos = searchBoundKey<op>(nodePtr, val);
+		width /= nodePtr->numKeys + 1;
+		position += width * pos;
+		PageId childNum = nodePtr->pageNoArray[pos];
+		bool leafChild = nodePtr->level == 1;
+		releaseLeafShared(pageNum, page);
+
+		if (childNum == Page::INVALID_NUMBER)
+		{
+			return position;
+		}
+		if (leafChild)
+		{
+			readLeafShared(childNum, page);
+			auto *leafPtr = (const LeafNode<T> *)page;
+			if (leafPtr->numKeys > 0)
+			{
+				position += width * searchBoundKey<op>(leafPtr, val) / leafPtr->numKeys;
+			}
+			releaseLeafShared(childNum, page);
+			return position;
+		}
+		pageNum = childNum;
+	}
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::lookupBatch
+// -----------------------------------------------------------------------------
+
+std::size_t BTreeIndex::lookupBatch(const void *keys, std::size_t n, RecordId *outRids, bool *found)
+{
+	switch (attributeType)
+	{
+	case INTEGER:
+		return lookupBatchTyped<int>(keys, n, outRids, found);
+	case DOUBLE:
+		return lookupBatchTyped<double>(keys, n, outRids, found);
+	case STRING:
+		return lookupBatchTyped<StringKey>(keys, n, outRids, found);
+	}
+	return 0;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::lookupBatchTyped
+// -----------------------------------------------------------------------------
+
+template <class T>
+std::size_t BTreeIndex::lookupBatchTyped(const void *keys, std::size_t n, RecordId *outRids, bool *found)
+{
+	std::vector<T> keyTs(n);
+	for (std::size_t i = 0; i < n; ++i)
+	{
+		readKey(keyAt<T>(keys, i), keyTs[i]);
+	}
+
+	// probe the keys in sorted order
+	std::vector<std::size_t> order(n);
+	for (std::size_t i = 0; i < n; ++i)
+	{
+		order[i] = i;
+	}
+	std::sort(order.begin(), order.end(),
+			[&keyTs](std::size_t a, std::size_t b) { return keyTs[a] < keyTs[b]; });
+
+	// the keys in the insert buffer are found there
+	// those with deletions in the delta are then found by merging it with the tree
+	// the keys the lookup filter rules out are missing, and settled with those found or deleted
+	std::fill(found, found + n, false);
+	std::size_t numFound = 0;
+	std::vector<char> deleted(n, false);
+	std::vector<char> settled(n, false);
+	if (lookupFilter != nullptr)
+	{
+		for (std::size_t i = 0; i < n; ++i)
+		{
+			settled[i] = filteredOut(keyTs[i]);
+		}
+	}
+	if (insertBuffer != nullptr)
+	{
+		std::lock_guard<std::mutex> lock(insertBufferMutex);
+		for (std::size_t i = 0; i < n; ++i)
+		{
+			if (settled[i])
+			{
+				continue;
+			}
+			bool keyDeleted = false;
+			found[i] = findBuffered(keyTs[i], outRids[i], keyDeleted);
+			deleted[i] = keyDeleted && !found[i];
+			numFound += found[i];
+		}
+	}
+	for (std::size_t i = 0; i < n; ++i)
+	{
+		if (deleted[i])
+		{
+			found[i] = lookupMerged(keyAt<T>(keys, i), outRids[i]);
+			numFound += found[i];
+		}
+		settled[i] = settled[i] || deleted[i];
+	}
+
+	// the nodes of a mapped file need no pin, so the keys are simply probed one after the other
+	if (mapping == nullptr)
+	{
+		return numFound + lookupInterleaved(keyTs, order, settled, outRids, found);
+	}
+
+	// the currently pinned leaf and the upper bound of its keys
+	PageId leafPageNum = Page::INVALID_NUMBER;
+	Page *leafPage = nullptr;
+	bool bounded = false;
+	T upperBound = T();
+
+	for (std::size_t i : order)
+	{
+		const T &keyT = keyTs[i];
+		if (found[i] || settled[i])
+		{
+			continue;
+		}
+
+		// descend again only if the key is beyond the current leaf
+		// it is never below the leaf since the keys are sorted
+		// the leaf stays latched shared while it is probed
+		if (leafPageNum == Page::INVALID_NUMBER || (bounded && !(keyT < upperBound)))
+		{
+			if (leafPageNum != Page::INVALID_NUMBER)
+			{
+				releaseLeafShared(leafPageNum, leafPage);
+			}
+			leafPageNum = findLeafPageNum<GT>(keyT, leafPage, bounded, upperBound);
+		}
+
+		found[i] = leafPageNum != Page::INVALID_NUMBER && findInLeaf((LeafNode<T> *)leafPage, keyT, outRids[i]);
+		numFound += found[i];
+	}
+
+	if (leafPageNum != Page::INVALID_NUMBER)
+	{
+		releaseLeafShared(leafPageNum, leafPage);
+	}
+
+	return numFound;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::lookupBatchAll
+// -----------------------------------------------------------------------------
+
+std::size_t BTreeIndex::lookupBatchAll(const void *keys, std::size_t n, std::vector<std::pair<std::size_t, RecordId>> &out)
+{
+	switch (attributeType)
+	{
+	case INTEGER:
+		return lookupBatchAllTyped<int>(keys, n, out);
+	case DOUBLE:
+		return lookupBatchAllTyped<double>(keys, n, out);
+	case STRING:
+		return lookupBatchAllTyped<StringKey>(keys, n, out);
+	}
+	return 0;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::lookupBatchAllTyped
+// -----------------------------------------------------------------------------
+
+template <class T>
+std::size_t BTreeIndex::lookupBatchAllTyped(const void *keys, std::size_t n, std::vector<std::pair<std::size_t, RecordId>> &out)
+{
+	if (n == 0)
+	{
+		return 0;
+	}
+	std::vector<T> keyTs(n);
+	for (std::size_t i = 0; i < n; ++i)
+	{
+		readKey(keyAt<T>(keys, i), keyTs[i]);
+	}
+
+	// probe the keys in sorted order
+	std::vector<std::size_t> order(n);
+	for (std::size_t i = 0; i < n; ++i)
+	{
+		order[i] = i;
+	}
+	std::sort(order.begin(), order.end(),
+			[&keyTs](std::size_t a, std::size_t b) { return keyTs[a] < keyTs[b]; });
+
+	// the buffered entries of the range of the keys are applied, for the tree to hold all of their entries
+	if (insertBuffer != nullptr)
+	{
+		flushBuffered(&keyTs[order.front()], &keyTs[order.back()]);
+	}
+
+	// the currently latched leaf and the upper bound of its keys, if it was descended into
+	PageId leafPageNum = Page::INVALID_NUMBER;
+	Page *leafPage = nullptr;
+	bool bounded = false;
+	T upperBound = T();
+	std::vector<RecordId> packedRids;
+	const std::size_t first = out.size();
+
+	// the previous key and the range of its entries in out, which a repeat of it copies, the leaf latched
+	// having possibly moved past its entries; the range ends where the first repeat of it begins
+	std::size_t prevKey = n;
+	std::size_t prevBegin = first;
+	std::size_t prevEnd = first;
+
+	for (std::size_t i : order)
+	{
+		const T &keyT = keyTs[i];
+		if (prevKey != n && !(keyTs[prevKey] < keyT))
+		{
+			prevEnd = std::min(prevEnd, out.size());
+			for (std::size_t j = prevBegin; j < prevEnd; ++j)
+			{
+				const RecordId rid = out[j].second;
+				out.emplace_back(i, rid);
+			}
+			continue;
+		}
+		prevKey = i;
+		prevBegin = out.size();
+		prevEnd = std::numeric_limits<std::size_t>::max();
+		if (filteredOut(keyT))
+		{
+			continue;
+		}
+
+		// descend again only if the key is beyond the current leaf
+		// the entries before the next key in the leaf are those of smaller keys, the keys being sorted
+		auto *leafPtr = (LeafNode<T> *)leafPage;
+		if (leafPageNum != Page::INVALID_NUMBER
+		    && (bounded ? !(keyT < upperBound) : leafPtr->numKeys == 0 || nodeKey(leafPtr, leafPtr->numKeys - 1) < keyT))
+		{
+			releaseLeafShared(leafPageNum, leafPage);
+			leafPageNum = Page::INVALID_NUMBER;
+		}
+		if (leafPageNum == Page::INVALID_NUMBER)
+		{
+			leafPageNum = findLeafPageNum<GTE>(keyT, leafPage, bounded, upperBound);
+			if (leafPageNum == Page::INVALID_NUMBER)
+			{
+				continue;
+			}
+		}
+
+		// the entries of the key, which go on in the right siblings if they reach the end of the leaf
+		// and the key is not below the upper bound of the leaf
+		leafPtr = (LeafNode<T> *)leafPage;
+		int pos = searchBoundKey<GTE>(leafPtr, keyT);
+		while (true)
+		{
+			const RecordId *ridArray = leafRids(leafPtr, packedRids);
+			for (; pos < leafPtr->numKeys && nodeKey(leafPtr, pos) == keyT; ++pos)
+			{
+				if (!isPostingRef(ridArray[pos]))
+				{
+					out.emplace_back(i, ridArray[pos]);
+					continue;
+				}
+				for (PageId postingNum = ridArray[pos].page_number; postingNum != Page::INVALID_NUMBER; )
+				{
+					Page *postingPage;
+					readIndexPage(postingNum, postingPage);
+					auto *postingPtr = (PostingPage *)postingPage;
+					for (int r = 0; r < postingPtr->numRids; ++r)
+					{
+						out.emplace_back(i, postingPtr->ridArray[r]);
+					}
+					PageId nxtPostingNum = postingPtr->nextPageNo;
+					releaseIndexPage(postingNum);
+					postingNum = nxtPostingNum;
+				}
+			}
+			if (pos < leafPtr->numKeys || leafPtr->rightSibPageNo == Page::INVALID_NUMBER
+			    || (bounded && keyT < upperBound))
+			{
+				break;
+			}
+
+			// the right sibling is latched before the current leaf is released, which keeps it linked
+			// its upper bound is unknown, so the next key beyond it descends again
+			PageId nxtPageNum = leafPtr->rightSibPageNo;
+			Page *nxtPage;
+			readLeafShared(nxtPageNum, nxtPage);
+			releaseLeafShared(leafPageNum, leafPage);
+			leafPageNum = nxtPageNum;
+			leafPage = nxtPage;
+			leafPtr = (LeafNode<T> *)leafPage;
+			bounded = false;
+			pos = 0;
+		}
+	}
+
+	if (leafPageNum != Page::INVALID_NUMBER)
+	{
+		releaseLeafShared(leafPageNum, leafPage);
+	}
+
+	return out.size() - first;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::lookupInterleaved
+// -----------------------------------------------------------------------------
+
+template <class T>
+std::size_t BTreeIndex::lookupInterleaved(const std::vector<T> &keyTs, const std::vector<std::size_t> &order,
+		const std::vector<char> &skip, RecordId *outRids, bool *found)
+{
+	// a descent in flight: the node it read optimistically, and the child it pinned but has not read yet
+	// a node page number of INVALID_NUMBER starts the descent from the root
+	struct Descent
+	{
+		std::size_t key;
+		PageId nodeNum;
+		Page *node;
+		bool nodeCached;
+		std::uint64_t nodeVersion;
+		PageId childNum;
+		Page *child;
+		bool childCached;
+		bool childIsLeaf;
+		bool bounded;
+		T upperBound;
+	};
+
+	// the keys are started in order, skipping those found in the insert buffer
+	std::size_t next = 0;
+	auto peekKey = [&](std::size_t &key) {
+		while (next < order.size() && (skip[order[next]] || found[order[next]]))
+		{
+			++next;
+		}
+		if (next == order.size())
+		{
+			return false;
+		}
+		key = order[next];
+		return true;
+	};
+
+	// take one more step of a descent, returning whether it has reached its leaf
+	std::size_t numFound = 0;
+	auto step = [&](Descent &s) {
+		if (s.nodeNum == Page::INVALID_NUMBER)
+		{
+			threadOpCounters.descents++;
+			s.nodeNum = rootPageNum;
+			s.nodeCached = readCachedNode(s.nodeNum, s.node);
+			s.nodeVersion = bufMgr->latchOf(s.node).readVersion();
+			s.bounded = false;
+			if (s.nodeNum != rootPageNum)
+			{
+				releaseCachedNode(s.nodeNum, s.nodeCached);
+				s.nodeNum = Page::INVALID_NUMBER;
+				return false;
+			}
+		}
+		else
+		{
+			// the child is checked to be still linked once it is latched or its version is read
+			FrameLatch &childLatch = bufMgr->latchOf(s.child);
+			std::uint64_t childVersion = 0;
+			if (s.childIsLeaf)
+			{
+				childLatch.lockShared();
+			}
+			else
+			{
+				childVersion = childLatch.readVersion();
+			}
+			bool valid = bufMgr->latchOf(s.node).validate(s.nodeVersion);
+			releaseCachedNode(s.nodeNum, s.nodeCached);
+			if (!valid)
+			{
+				if (s.childIsLeaf)
+				{
+					releaseLeafShared(s.childNum, s.child);
+				}
+				else
+				{
+					releaseCachedNode(s.childNum, s.childCached);
+				}
+				s.nodeNum = Page::INVALID_NUMBER;
+				return false;
+			}
+
+			if (s.childIsLeaf)
+			{
+				// probe the key in its leaf, or in the right sibling it has been split to
+				// then the next keys of the batch as long as they lie within the leaf
+				moveRight<GT, LeafNode<T>>(s.childNum, s.child, keyTs[s.key], true, false);
+				auto *leafPtr = (LeafNode<T> *)s.child;
+				if (hasHighKey(leafPtr))
+				{
+					s.bounded = true;
+					s.upperBound = highKey(leafPtr);
+				}
+				std::size_t key = s.key;
+				while (true)
+				{
+					found[key] = findInLeaf(leafPtr, keyTs[key], outRids[key]);
+					numFound += found[key];
+					if (!peekKey(key) || (s.bounded && !(keyTs[key] < s.upperBound)))
+					{
+						break;
+					}
+					++next;
+				}
+				releaseLeafShared(s.childNum, s.child);
+				return true;
+			}
+			s.nodeNum = s.childNum;
+			s.node = s.child;
+			s.nodeCached = s.childCached;
+			s.nodeVersion = childVersion;
+		}
+
+		// find the child to go into, or the right sibling
+		int slot;
+		int level;
+		bool right;
+		if (!findChildOptimistic<GT>((NonLeafNode<T> *)s.node, bufMgr->latchOf(s.node), s.nodeVersion, keyTs[s.key],
+				s.childNum, slot, level, right, s.bounded, s.upperBound))
+		{
+			releaseCachedNode(s.nodeNum, s.nodeCached);
+			s.nodeNum = Page::INVALID_NUMBER;
+			return false;
+		}
+		if (s.childNum == Page::INVALID_NUMBER)
+		{
+			// the root of an old empty index has no leaf
+			releaseCachedNode(s.nodeNum, s.nodeCached);
+			return true;
+		}
+		s.childIsLeaf = level == 1 && !right;
+		return false;
+	};
+
+	Descent descents[LOOKUP_INTERLEAVE];
+	int numActive = 0;
+	while (numActive < LOOKUP_INTERLEAVE && peekKey(descents[numActive].key))
+	{
+		++next;
+		descents[numActive++].nodeNum = Page::INVALID_NUMBER;
+	}
+
+	std::vector<PageId> leafNums;
+	while (numActive > 0)
+	{
+		// search the node of each descent, replacing those which are done by the next keys
+		for (int d = 0; d < numActive; )
+		{
+			if (!step(descents[d]))
+			{
+				++d;
+			}
+			else if (peekKey(descents[d].key))
+			{
+				++next;
+				descents[d].nodeNum = Page::INVALID_NUMBER;
+			}
+			else
+			{
+				descents[d] = descents[--numActive];
+			}
+		}
+
+		// read together the leaves missing from the buffer pool
+		leafNums.clear();
+		for (int d = 0; d < numActive; ++d)
+		{
+			if (descents[d].nodeNum != Page::INVALID_NUMBER && descents[d].childIsLeaf)
+			{
+				leafNums.push_back(descents[d].childNum);
+			}
+		}
+		if (leafNums.size() > 1)
+		{
+			bufMgr->prefetchPages(file, leafNums);
+		}
+
+		// pin the children, and fetch the start and the middle of their keys into the cache
+		// while the other descents are taking their steps
+		for (int d = 0; d < numActive; ++d)
+		{
+			Descent &s = descents[d];
+			if (s.nodeNum == Page::INVALID_NUMBER)
+			{
+				continue;
+			}
+			if (s.childIsLeaf)
+			{
+				readNode(s.childNum, s.child, true);
+			}
+			else
+			{
+				s.childCached = readCachedNode(s.childNum, s.child);
+			}
+			const char *data = (const char *)s.child;
+			__builtin_prefetch(data);
+			__builtin_prefetch(data + Page::SIZE / 8);
+			__builtin_prefetch(data + Page::SIZE / 4);
+		}
+	}
+	return numFound;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::startScan
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::startScan(const void* lowValParm,
+				   const Operator lowOpParm,
+				   const void* highValParm,
+				   const Operator highOpParm,
+				   const ScanDirection direction,
+				   std::size_t offset,
+				   std::size_t limit)
+{
+	scanCursor.startScan(lowValParm, lowOpParm, highValParm, highOpParm, direction, offset, limit);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::startPrefixScan
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::startPrefixScan(const void* const* values, int numValues)
+{
+	// every key starting with the prefix lies between it and the prefix followed by 0xFF bytes up to the
+	// longest key, which is not less than any of them
+	StringKey lowKey, highKey;
+	encodeKey(values, numValues, lowKey);
+	highKey.length = STRINGSIZE;
+	memcpy(highKey.data, lowKey.data, lowKey.length);
+	memset(highKey.data + lowKey.length, 0xFF, STRINGSIZE - lowKey.length);
+	startScan(&lowKey, GTE, &highKey, LTE);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::scanNext
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::scanNext(RecordId& outRid) 
+{
+	scanCursor.scanNext(outRid);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::scanNextBatch
+// -----------------------------------------------------------------------------
+
+std::size_t BTreeIndex::scanNextBatch(RecordId* out, std::size_t max)
+{
+	return scanCursor.scanNextBatch(out, max);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::scanNextIncluded
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::scanNextIncluded(RecordId& outRid, void* key, void* included)
+{
+	scanCursor.scanNextIncluded(outRid, key, included);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::scanToBitmap
+// -----------------------------------------------------------------------------
+
+std::size_t BTreeIndex::scanToBitmap(RidBitmap& out)
+{
+	return scanCursor.scanToBitmap(out);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::scanSkip
+// -----------------------------------------------------------------------------
+
+std::size_t BTreeIndex::scanSkip(std::size_t n)
+{
+	return scanCursor.scanSkip(n);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::endScan
+// -----------------------------------------------------------------------------
+//
+void BTreeIndex::endScan() 
+{
+	scanCursor.endScan();
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::initNode
+// -----------------------------------------------------------------------------
+//
+template <class T>
+void BTreeIndex::initNode(NonLeafNode<T> *nodePtr, int level)
+{
+	nodePtr->level = level;
+	nodePtr->format = INDEX_FORMAT_VERSION;
+	nodePtr->numKeys = 0;
+	setRightLink(nodePtr, Page::INVALID_NUMBER, T());
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::initLeaf
+// -----------------------------------------------------------------------------
+//
+template <class T>
+void BTreeIndex::initLeaf(LeafNode<T> *leafPtr, PageId rightSibPageNo)
+{
+	leafPtr->rightSibPageNo = rightSibPageNo;
+	leafPtr->numKeys = 0;
+	leafPtr->hasHighKey = 0;
+	leafPtr->format = INDEX_FORMAT_VERSION;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::readNode
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::readNode(PageId pageNum, Page *&page, bool isLeaf)
+{
+	bufMgr->readPage(file, pageNum, page);
+	threadOpCounters.pins++;
+	if (!isLeaf)
+	{
+		// non leaf nodes are boosted, if the buffer manager is set to, so that they outlive the leaves
+		bufMgr->boostPage(page);
+	}
+	if (!legacyFormat)
+	{
+		return;
+	}
+
+	// the upgrade modifies the page, so it is latched as by any writer
+	FrameLatch &latch = bufMgr->latchOf(page);
+	latch.lockExclusive();
+	bool upgraded = isLeaf
+			? upgradeLeaf((LeafNodeInt *)page)
+			: upgradeNode((NonLeafNodeInt *)page);
+	latch.unlockExclusive();
+	if (upgraded)
+	{
+		// pin once more to mark the page dirty while keeping it pinned for the caller
+		bufMgr->readPage(file, pageNum, page);
+		bufMgr->unPinPage(file, pageNum, true);
+	}
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::readCachedNode
+// -----------------------------------------------------------------------------
+
+bool BTreeIndex::readCachedNode(PageId pageNum, Page *&page)
+{
+	if (!cacheNodes)
+	{
+		readNode(pageNum, page, false);
+		return false;
+	}
+
+	// the caller becomes a user while the cache is latched, so that it cannot be emptied meanwhile
+	nodeCacheLatch.lockShared();
+	auto it = cachedNodes.find(pageNum);
+	if (it != cachedNodes.end())
+	{
+		page = it->second;
+		nodeCacheUsers.fetch_add(1);
+		nodeCacheLatch.unlockShared();
+		return true;
+	}
+	nodeCacheLatch.unlockShared();
+
+	readNode(pageNum, page, false);
+	if (!bufMgr->reservePin())
+	{
+		return false;
+	}
+
+	// the cache takes a pin of its own, the caller still releasing the one of readNode
+	// the page is pinned before the cache is latched, as pinning it may ask the cache for its pins
+	Page *cachedPage;
+	bufMgr->readPage(file, pageNum, cachedPage);
+	nodeCacheLatch.lockExclusive();
+	bool added = cachedNodes.emplace(pageNum, cachedPage).second;
+	nodeCacheLatch.unlockExclusive();
+	if (added)
+	{
+		++numCachedNodes;
+	}
+	else
+	{
+		bufMgr->unPinPage(file, pageNum, false);
+		bufMgr->returnPins(1);
+	}
+	return false;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::clearNodeCache
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::clearNodeCache()
+{
+	nodeCacheLatch.lockExclusive();
+	unpinCachedNodes();
+	nodeCacheLatch.unlockExclusive();
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::releasePins
+// -----------------------------------------------------------------------------
+
+std::uint32_t BTreeIndex::releasePins()
+{
+	// a user may still be reading a cached node, which must stay in its frame
+	nodeCacheLatch.lockExclusive();
+	std::uint32_t numUnpinned = nodeCacheUsers.load() == 0 ? unpinCachedNodes() : 0;
+	nodeCacheLatch.unlockExclusive();
+	return numUnpinned;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::unpinCachedNodes
+// -----------------------------------------------------------------------------
+
+std::uint32_t BTreeIndex::unpinCachedNodes()
+{
+	for (const std::pair<const PageId, Page *> &node : cachedNodes)
+	{
+		bufMgr->unPinPage(file, node.first, false);
+	}
+	for (PageId pageNum : releasedNodes)
+	{
+		bufMgr->unPinPage(file, pageNum, false);
+	}
+	std::uint32_t numUnpinned = cachedNodes.size() + releasedNodes.size();
+	bufMgr->returnPins(numUnpinned);
+	cachedNodes.clear();
+	releasedNodes.clear();
+	hasReleasedNodes = false;
+	numCachedNodes = 0;
+	return numUnpinned;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::unpinReleasedNodes
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::unpinReleasedNodes()
+{
+	nodeCacheLatch.lockExclusive();
+	if (nodeCacheUsers.load() == 0)
+	{
+		for (PageId pageNum : releasedNodes)
+		{
+			bufMgr->unPinPage(file, pageNum, false);
+		}
+		bufMgr->returnPins(releasedNodes.size());
+		releasedNodes.clear();
+		hasReleasedNodes = false;
+	}
+	nodeCacheLatch.unlockExclusive();
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::uncacheNode
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::uncacheNode(PageId pageNum)
+{
+	// a user may still be on the node, and then sees its new version, as it stays in its frame
+	nodeCacheLatch.lockExclusive();
+	auto it = cachedNodes.find(pageNum);
+	if (it != cachedNodes.end())
+	{
+		cachedNodes.erase(it);
+		--numCachedNodes;
+		releasedNodes.push_back(pageNum);
+		hasReleasedNodes = true;
+	}
+	nodeCacheLatch.unlockExclusive();
+	if (hasReleasedNodes.load() && nodeCacheUsers.load() == 0)
+	{
+		unpinReleasedNodes();
+	}
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::readIndexPage
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::readIndexPage(PageId pageNum, Page *&page)
+{
+	if (mapping != nullptr)
+	{
+		page = mappedPage(pageNum);
+		return;
+	}
+	bufMgr->readPage(file, pageNum, page);
+	threadOpCounters.pins++;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::releaseIndexPage
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::releaseIndexPage(PageId pageNum)
+{
+	if (mapping == nullptr)
+	{
+		bufMgr->unPinPage(file, pageNum, false);
+	}
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::readLeafShared
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::readLeafShared(PageId pageNum, Page *&page)
+{
+	if (mapping != nullptr)
+	{
+		page = mappedPage(pageNum);
+		return;
+	}
+	readNode(pageNum, page, true);
+	bufMgr->latchOf(page).lockShared();
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::releaseLeafShared
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::releaseLeafShared(PageId pageNum, Page *page)
+{
+	if (mapping == nullptr)
+	{
+		bufMgr->latchOf(page).unlockShared();
+		bufMgr->unPinPage(file, pageNum, false);
+	}
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::readNodeShared
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::readNodeShared(PageId pageNum, Page *&page)
+{
+	if (mapping != nullptr)
+	{
+		page = mappedPage(pageNum);
+		return;
+	}
+	readNode(pageNum, page, false);
+	bufMgr->latchOf(page).lockShared();
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::upgradeNode
+// -----------------------------------------------------------------------------
+
+bool BTreeIndex::upgradeNode(NonLeafNodeInt *nodeIntPtr)
+{
+	if (nodeIntPtr->format != 0)
+	{
+		return false;
+	}
+
+	// find the first invalid page ID after the first one
+	// a node from before the high keys may fill all key slots
+	int lo = 0;
+	int hi = NodeCapacity<int>::NONLEAF;
+	while (lo < hi)
+	{
+		int mid = (lo + hi) >> 1;
+		if (nodeIntPtr->pageNoArray[mid + 1] != Page::INVALID_NUMBER)
+		{
+			lo = mid + 1;
+		}
+		else
+		{
+			hi = mid;
+		}
+	}
+
+	// the level was stored as an int, so its upper bytes are zero
+	// the page number slots may all be taken, so the node has no right link yet
+	nodeIntPtr->numKeys = lo;
+	nodeIntPtr->format = INDEX_FORMAT_V2;
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::upgradeLeaf
+// -----------------------------------------------------------------------------
+
+bool BTreeIndex::upgradeLeaf(LeafNodeInt *leafIntPtr)
+{
+	if (leafIntPtr->format != 0)
+	{
+		return false;
+	}
+
+	// find the first invalid record ID
+	int lo = 0;
+	int hi = NodeCapacity<int>::LEAF;
+	while (lo < hi)
+	{
+		int mid = (lo + hi) >> 1;
+		if (leafIntPtr->ridArray[mid].page_number != Page::INVALID_NUMBER)
+		{
+			lo = mid + 1;
+		}
+		else
+		{
+			hi = mid;
+		}
+	}
+
+	leafIntPtr->numKeys = lo;
+	leafIntPtr->format = INDEX_FORMAT_V2;
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::insertPageKeyPairAux
+// -----------------------------------------------------------------------------
+
+template <class T>
+void BTreeIndex::insertPageKeyPairAux(NonLeafNode<T> *nodePtr, const PageKeyPair<T> &pk, int pos)
+{
+	int m = nodePtr->numKeys;
+	memmove(&nodePtr->keyArray[pos + 1], &nodePtr->keyArray[pos], (m - pos) * sizeof(T));
+	memmove(&nodePtr->pageNoArray[pos + 2], &nodePtr->pageNoArray[pos + 1], (m - pos) * sizeof(PageId));
+
+	nodePtr->pageNoArray[pos + 1] = pk.pageNo;
+	nodePtr->keyArray[pos] = pk.key;
+	++nodePtr->numKeys;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::insertRIDKeyPairAux
+// -----------------------------------------------------------------------------
+
+template <class T>
+void BTreeIndex::insertRIDKeyPairAux(LeafNode<T> *leafPtr, const RIDKeyPair<T> &rk, int pos, const char *included)
+{
+	int m = leafPtr->numKeys;
+	moveLeafEntries(leafPtr, pos + 1, leafPtr, pos, m - pos);
+
+	leafPtr->ridArray[pos] = rk.rid;
+	leafPtr->keyArray[pos] = rk.key;
+	if (includedWidth > 0)
+	{
+		memcpy(includedValues(leafPtr, pos), included, includedWidth);
+	}
+	++leafPtr->numKeys;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::moveLeafEntries
+// -----------------------------------------------------------------------------
+
+template <class T>
+void BTreeIndex::moveLeafEntries(LeafNode<T> *dstPtr, int dstPos, const LeafNode<T> *srcPtr, int srcPos, int cnt)
+{
+	memmove(&dstPtr->keyArray[dstPos], &srcPtr->keyArray[srcPos], cnt * sizeof(T));
+	memmove(&dstPtr->ridArray[dstPos], &srcPtr->ridArray[srcPos], cnt * sizeof(RecordId));
+	if (includedWidth > 0)
+	{
+		memmove(includedValues(dstPtr, dstPos), includedValues(srcPtr, srcPos), cnt * includedWidth);
+	}
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::loadIncluded
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::loadIncluded(const char *record, char *values) const
+{
+	for (const IncludedAttribute &attr : includedAttrs)
+	{
+		memcpy(values, record + attr.offset, attr.size);
+		values += attr.size;
+	}
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::encodeKey
+// -----------------------------------------------------------------------------
+
+/**
+ * Get the fewest bytes a column of a composite key is encoded into.
+ * @param type Type of the column
+ */
+static int minColumnWidth(Datatype type)
+{
+	switch (type)
+	{
+	case INTEGER:
+		return sizeof(std::uint32_t);
+	case DOUBLE:
+		return sizeof(std::uint64_t);
+	default:
+		// the zero byte ending an empty char string
+		return 1;
+	}
+}
+
+/**
+ * Encode the value of a column of a composite key into the bytes of its normalized key.
+ * @param type Type of the column
+ * @param value Pointer to integer / double / char string
+ * @param out Returned bytes
+ * @param room Number of bytes left for the column, at least minColumnWidth(type)
+ * @return the number of bytes stored
+ */
+static int encodeColumn(Datatype type, const void *value, char *out, int room)
+{
+	switch (type)
+	{
+	case INTEGER:
+	{
+		int intValue;
+		memcpy(&intValue, value, sizeof(intValue));
+		return encodeNormalized(intValue, out);
+	}
+	case DOUBLE:
+	{
+		double doubleValue;
+		memcpy(&doubleValue, value, sizeof(doubleValue));
+		return encodeNormalized(doubleValue, out);
+	}
+	default:
+		return encodeNormalized((const char *)value, room - 1, out);
+	}
+}
+
+void BTreeIndex::encodeKey(const void *const *values, int numValues, StringKey &key) const
+{
+	// the fewest bytes of the columns after the one encoded are kept free
+	int reserved = 0;
+	for (const KeyColumn &column : keyColumns)
+	{
+		reserved += minColumnWidth(column.type);
+	}
+	numValues = std::min(numValues, (int)keyColumns.size());
+	key.length = 0;
+	for (int i = 0; i < numValues; ++i)
+	{
+		reserved -= minColumnWidth(keyColumns[i].type);
+		key.length += encodeColumn(keyColumns[i].type, values[i], key.data + key.length, STRINGSIZE - key.length - reserved);
+	}
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::normalizeKey
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::normalizeKey(const void *key, StringKey &out) const
+{
+	if (!keyColumns.empty())
+	{
+		readKey(key, out);
+		return;
+	}
+	normalizeKey(attributeType, key, out);
+}
+
+void BTreeIndex::normalizeKey(Datatype attrType, const void *key, StringKey &out)
+{
+	out.length = encodeColumn(attrType, key, out.data, STRINGSIZE);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::encodeRecordKey
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::encodeRecordKey(const char *record, StringKey &key) const
+{
+	const void *values[MAX_KEY_COLUMNS];
+	for (std::size_t i = 0; i < keyColumns.size(); ++i)
+	{
+		values[i] = record + keyColumns[i].offset;
+	}
+	encodeKey(values, keyColumns.size(), key);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::eraseRIDKeyPairsAux
+// -----------------------------------------------------------------------------
+
+template <class T>
+void BTreeIndex::eraseRIDKeyPairsAux(LeafNode<T> *leafPtr, int pos, int cnt)
+{
+	int m = leafPtr->numKeys;
+	moveLeafEntries(leafPtr, pos, leafPtr, pos + cnt, m - pos - cnt);
+	leafPtr->numKeys = m - cnt;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::eraseRIDKeyPairsAux -- INTEGER
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::eraseRIDKeyPairsAux(LeafNodeInt *leafPtr, int pos, int cnt)
+{
+	if (isPacked(leafPtr))
+	{
+		erasePackedEntries(leafPtr, pos, cnt);
+		return;
+	}
+	eraseRIDKeyPairsAux<int>(leafPtr, pos, cnt);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::erasePageKeyPairAux
+// -----------------------------------------------------------------------------
+
+template <class T>
+void BTreeIndex::erasePageKeyPairAux(NonLeafNode<T> *nodePtr, int pos)
+{
+	int m = nodePtr->numKeys;
+	memmove(&nodePtr->keyArray[pos], &nodePtr->keyArray[pos + 1], (m - pos - 1) * sizeof(T));
+	memmove(&nodePtr->pageNoArray[pos + 1], &nodePtr->pageNoArray[pos + 2], (m - pos - 1) * sizeof(PageId));
+	--nodePtr->numKeys;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::insertDuplicateRID
+// -----------------------------------------------------------------------------
+
+template <class T>
+bool BTreeIndex::insertDuplicateRID(LeafNode<T> *leafPtr, const RIDKeyPair<T> &rk, int &pos)
+{
+	// the entries with an equal key
+	int first = searchBoundKey<GTE>(leafPtr, rk.key);
+	int last = searchBoundKey<GT>(leafPtr, rk.key);
+	RecordId *rids = leafPtr->ridArray;
+
+	if (last - first == 1 && isPostingRef(rids[first]))
+	{
+		// the key already has a posting list
+		insertPosting(rids[first].page_number, rk.rid);
+		pos = -1;
+		return true;
+	}
+
+	if (last - first < postingThreshold)
+	{
+		// entries with an equal key are kept in record ID order
+		pos = std::lower_bound(rids + first, rids + last, rk.rid) - rids;
+		return false;
+	}
+
+	// move the record IDs of the key to a new posting list
+	std::vector<RecordId> postings(rids + first, rids + last);
+	postings.insert(std::lower_bound(postings.begin(), postings.end(), rk.rid), rk.rid);
+	PageId headPageNum = Page::INVALID_NUMBER;
+	PageId tailPageNum = Page::INVALID_NUMBER;
+	PostingPage *tailPtr = nullptr;
+	for (const RecordId &rid : postings)
+	{
+		appendPosting(tailPageNum, tailPtr, rid);
+		if (headPageNum == Page::INVALID_NUMBER)
+		{
+			headPageNum = tailPageNum;
+		}
+	}
+	bufMgr->unPinPage(file, tailPageNum, true);
+
+	// a single entry of the key refers to the list
+	eraseRIDKeyPairsAux(leafPtr, first + 1, last - first - 1);
+	rids[first] = postingRef(headPageNum);
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+// splitBetweenKeys
+// -----------------------------------------------------------------------------
+
+/**
+ * Find the split of sorted keys nearest to their middle that falls between different keys.
+ * @param keyOf Function returning the i-th key
+ * @param n Number of keys
+ * @param lo Lowest number of keys allowed before the split, at least 1
+ * @param hi Highest number of keys allowed before the split, at most n - 1
+ * @return the number of keys before the split, the middle clamped to [lo, hi] if no allowed split
+ * falls between different keys
+ */
+template <class KeyOf>
+static int splitBetweenKeys(KeyOf keyOf, int n, int lo, int hi)
+{
+	int mid = std::min(hi, std::max(lo, n >> 1));
+	for (int d = 0; mid + d <= hi || mid - d > lo; ++d)
+	{
+		if (mid + d <= hi && keyOf(mid + d - 1) != keyOf(mid + d))
+		{
+			return mid + d;
+		}
+		if (mid - d > lo && keyOf(mid - d - 2) != keyOf(mid - d - 1))
+		{
+			return mid - d - 1;
+		}
+	}
+	return mid;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::chooseLeafSplit
+// -----------------------------------------------------------------------------
+
+template <class T>
+int BTreeIndex::chooseLeafSplit(LeafNode<T> *leafPtr, int pos, const T &key)
+{
+	int m = leafPtr->numKeys;
+
+	// the i-th key counting the inserted one
+	auto keyOf = [&](int i) { return i < pos ? leafPtr->keyArray[i] : i == pos ? key : leafPtr->keyArray[i - 1]; };
+
+	// an append past the last key of the rightmost leaf leaves it full and starts a new rightmost leaf,
+	// so that increasing keys fill the leaves instead of leaving their left halves empty for good
+	if (pos == m && leafPtr->rightSibPageNo == Page::INVALID_NUMBER && keyOf(m - 1) < key)
+	{
+		return std::min(m, leafOccupancy);
+	}
+
+	// the split nearest to the median that falls between different keys
+	// a leaf from before the high keys may hold one more entry than both halves can
+	return splitBetweenKeys(keyOf, m + 1, std::max(1, m + 1 - leafOccupancy), std::min(m, leafOccupancy));
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::findPageNumInNode
+// -----------------------------------------------------------------------------
+
+template <Operator op, class T>
+PageId BTreeIndex::findPageNumInNode(NonLeafNode<T> *nodePtr, const T &val)
+{
+	// the leftmost child whose upper bound is GT/GTE the given value
+	// the last child has no upper bound, which also covers the node having no key
+	int pos = searchBoundKey<op>(nodePtr, val);
+	return nodePtr->pageNoArray[pos];
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::findChildOptimistic
+// -----------------------------------------------------------------------------
+
+template <Operator op, class T>
+bool BTreeIndex::findChildOptimistic(const NonLeafNode<T> *nodePtr, const FrameLatch &latch, std::uint64_t version,
+		const T &val, PageId &child, int &slot, int &level, bool &right, bool &bounded, T &upperBound)
+{
+	// a number of keys read while the node changes may be past the key slots
+	level = nodePtr->level;
+	int n = nodePtr->numKeys < NodeCapacity<T>::NONLEAF ? nodePtr->numKeys : NodeCapacity<T>::NONLEAF;
+
+	// the keys beyond the high key have moved to the right sibling, which has the bound of the node
+	right = pastHighKey<op>(nodePtr, val);
+	if (right)
+	{
+		child = rightLink(nodePtr);
+		return latch.validate(version);
+	}
+
+	// the leftmost child whose upper bound is GT/GTE the given value
+	// the bound of the last child is the high key, or is inherited from the current node
+	int pos = searchBoundKey<op>(nodePtr->keyArray, n, val);
+	if (pos < n)
+	{
+		bounded = true;
+		upperBound = nodePtr->keyArray[pos];
+	}
+	else if (hasHighKey(nodePtr))
+	{
+		bounded = true;
+		upperBound = highKey(nodePtr);
+	}
+	child = nodePtr->pageNoArray[pos];
+	slot = pos;
+	return latch.validate(version);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::findChildOptimistic -- STRING
+// -----------------------------------------------------------------------------
+
+template <Operator op>
+bool BTreeIndex::findChildOptimistic(const NonLeafNodeString *nodePtr, const FrameLatch &latch, std::uint64_t version,
+		const StringKey &val, PageId &child, int &slot, int &level, bool &right, bool &bounded, StringKey &upperBound)
+{
+	// the key slots of a copy validated afterwards are consistent
+	static_assert(alignof(NonLeafNodeString) <= alignof(std::uint64_t), "Node copy must be aligned.");
+	std::uint64_t copy[Page::SIZE / sizeof(std::uint64_t)];
+	memcpy(copy, nodePtr, Page::SIZE);
+	if (!latch.validate(version))
+	{
+		return false;
+	}
+
+	auto *copyPtr = (const NonLeafNodeString *)copy;
+	level = copyPtr->level;
+	right = pastHighKey<op>(copyPtr, val);
+	if (right)
+	{
+		child = rightLink(copyPtr);
+		return true;
+	}
+
+	int pos = searchBoundKey<op>(copyPtr, val);
+	if (pos < copyPtr->numKeys)
+	{
+		bounded = true;
+		upperBound = nodeKey(copyPtr, pos);
+	}
+	else if (hasHighKey(copyPtr))
+	{
+		bounded = true;
+		upperBound = highKey(copyPtr);
+	}
+	child = copyPtr->pageNoArray[pos];
+	slot = pos;
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::findLeafMapped
+// -----------------------------------------------------------------------------
+
+template <Operator op, class T>
+PageId BTreeIndex::findLeafMapped(const T &val, Page *&leafPage, bool &bounded, T &upperBound, DescentStack *path)
+{
+	bounded = false;
+	if (path != nullptr)
+	{
+		path->size = 0;
+	}
+	PageId curPageNum = rootPageNum;
+	while (true)
+	{
+		// the leftmost child whose upper bound is GT/GTE the given value
+		auto *nodePtr = (const NonLeafNode<T> *)mappedPage(curPageNum);
+		int pos = searchBoundKey<op>(nodePtr, val);
+		if (pos < nodePtr->numKeys)
+		{
+			bounded = true;
+			upperBound = nodeKey(nodePtr, pos);
+		}
+		else if (hasHighKey(nodePtr))
+		{
+			bounded = true;
+			upperBound = highKey(nodePtr);
+		}
+		PageId nxtPageNum = nodePtr->pageNoArray[pos];
+		if (path != nullptr)
+		{
+			path->push(curPageNum, pos);
+		}
+
+		if (nxtPageNum == Page::INVALID_NUMBER)
+		{
+			// the root of an old empty index has no leaf
+			leafPage = nullptr;
+			return nxtPageNum;
+		}
+		if (nodePtr->level == 1)
+		{
+			leafPage = mappedPage(nxtPageNum);
+			auto *leafPtr = (const LeafNode<T> *)leafPage;
+			if (hasHighKey(leafPtr))
+			{
+				bounded = true;
+				upperBound = highKey(leafPtr);
+			}
+			return nxtPageNum;
+		}
+		curPageNum = nxtPageNum;
+	}
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::findLeafHot
+// -----------------------------------------------------------------------------
+
+template <Operator op, class T>
+bool BTreeIndex::findLeafHot(const T &val, PageId &leafPageNum, Page *&leafPage, bool &bounded, T &upperBound)
+{
+	// the copies of STRING nodes would be too large, and the nodes of an old index are upgraded as they are read
+	if (std::is_same<T, StringKey>::value || legacyFormat)
+	{
+		return false;
+	}
+	auto hot = std::static_pointer_cast<const HotLevels<T>>(std::atomic_load(&hotLevels));
+	if (hot == nullptr || !treeLatch.validate(hot->version))
+	{
+		if (++hotLevelsMisses >= HOT_LEVELS_REBUILD)
+		{
+			hotLevelsMisses = 0;
+			buildHotLevels<T>();
+		}
+		return false;
+	}
+
+	// the leftmost leaf whose upper bound is GT/GTE the given value
+	int pos = hot->keys.template search<OperatorTraits<op>::orEqual>(val);
+	bounded = pos < hot->keys.size();
+	if (bounded)
+	{
+		upperBound = hot->keys.key(pos);
+	}
+	PageId pageNum = hot->leaves[pos];
+	Page *page;
+	readLeafShared(pageNum, page);
+	if (!treeLatch.validate(hot->version))
+	{
+		// a merge may have freed the leaf
+		releaseLeafShared(pageNum, page);
+		return false;
+	}
+
+	// a leaf split since the copy was made is left through its right link
+	PageId copiedPageNum = pageNum;
+	moveRight<op, LeafNode<T>>(pageNum, page, val, true, false);
+	if (pageNum != copiedPageNum)
+	{
+		++hotLevelsMisses;
+	}
+	auto *leafPtr = (LeafNode<T> *)page;
+	if (hasHighKey(leafPtr))
+	{
+		bounded = true;
+		upperBound = highKey(leafPtr);
+	}
+	leafPageNum = pageNum;
+	leafPage = page;
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::buildHotLevels
+// -----------------------------------------------------------------------------
+
+template <class T>
+void BTreeIndex::buildHotLevels()
+{
+	std::unique_lock<std::mutex> building(hotLevelsMutex, std::try_to_lock);
+	if (!building.owns_lock())
+	{
+		return;
+	}
+	std::vector<T> keys;
+	std::vector<PageId> leaves;
+	std::size_t maxLeaves = HOT_LEVELS_MAX_BYTES / (sizeof(T) + sizeof(PageId));
+	treeLatch.lockShared();
+	std::uint64_t version = treeLatch.sharedVersion();
+
+	// go down the leftmost children to the level above the leaves, then right along it
+	// each node is latched shared while it is copied, as splits may run meanwhile
+	PageId pageNum = rootPageNum;
+	bool complete = false;
+	while (pageNum != Page::INVALID_NUMBER && leaves.size() <= maxLeaves)
+	{
+		Page *page;
+		bool cached = readCachedNode(pageNum, page);
+		auto *nodePtr = (NonLeafNode<T> *)page;
+		FrameLatch &latch = bufMgr->latchOf(page);
+		latch.lockShared();
+		PageId nextPageNum;
+		if (nodePtr->level != 1)
+		{
+			nextPageNum = nodePtr->pageNoArray[0];
+		}
+		else
+		{
+			for (int i = 0; i < nodePtr->numKeys; ++i)
+			{
+				keys.push_back(nodeKey(nodePtr, i));
+				leaves.push_back(nodePtr->pageNoArray[i]);
+			}
+			leaves.push_back(nodePtr->pageNoArray[nodePtr->numKeys]);
+			nextPageNum = rightLink(nodePtr);
+			if (hasHighKey(nodePtr))
+			{
+				keys.push_back(highKey(nodePtr));
+			}
+			complete = nextPageNum == Page::INVALID_NUMBER;
+		}
+		latch.unlockShared();
+		releaseCachedNode(pageNum, cached);
+		pageNum = nextPageNum;
+	}
+	treeLatch.unlockShared();
+
+	// the root of an old empty index has no leaf
+	if (complete && leaves.size() <= maxLeaves && leaves[0] != Page::INVALID_NUMBER)
+	{
+		std::shared_ptr<const HotLevelsBase> hot = std::make_shared<HotLevels<T>>(version, keys, std::move(leaves));
+		std::atomic_store(&hotLevels, hot);
+	}
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::findLeafPageNum
+// -----------------------------------------------------------------------------
+
+template <Operator op, class T>
+PageId BTreeIndex::findLeafPageNum(const T &val, Page *&leafPage, bool &bounded, T &upperBound,
+		bool exclusive, DescentStack *path)
+{
+	if (mapping != nullptr)
+	{
+		threadOpCounters.descents++;
+		return findLeafMapped<op>(val, leafPage, bounded, upperBound, path);
+	}
+
+	// lookups and scans go straight to their leaf through the hot levels
+	PageId hotPageNum;
+	if (!exclusive && path == nullptr && findLeafHot<op>(val, hotPageNum, leafPage, bounded, upperBound))
+	{
+		threadOpCounters.descents++;
+		return hotPageNum;
+	}
+
+	while (true)
+	{
+		threadOpCounters.descents++;
+		// start from the root page, which is replaced before it is released
+		// the non leaf nodes are read from the node cache, with no pin
+		PageId curPageNum = rootPageNum;
+		Page *curPage;
+		bool curCached = readCachedNode(curPageNum, curPage);
+		FrameLatch *curLatch = &bufMgr->latchOf(curPage);
+		std::uint64_t curVersion = curLatch->readVersion();
+		bool valid = curPageNum == rootPageNum;
+
+		bounded = false;
+		if (path != nullptr)
+		{
+			path->size = 0;
+		}
+		while (valid)
+		{
+			// find the child page to go into, or the right sibling
+			PageId nxtPageNum;
+			int slot;
+			int curLevel;
+			bool right;
+			if (!findChildOptimistic<op>((NonLeafNode<T> *)curPage, *curLatch, curVersion, val,
+					nxtPageNum, slot, curLevel, right, bounded, upperBound))
+			{
+				break;
+			}
+
+			if (nxtPageNum == Page::INVALID_NUMBER)
+			{
+				// the root of an old empty index has no leaf
+				releaseCachedNode(curPageNum, curCached);
+				leafPage = nullptr;
+				return nxtPageNum;
+			}
+			bool nxtIsLeaf = curLevel == 1 && !right;
+			if (path != nullptr && !right)
+			{
+				path->push(curPageNum, slot);
+			}
+
+			// the child is checked to be still linked once it is latched or its version is read
+			Page *nxtPage;
+			bool nxtCached = false;
+			if (nxtIsLeaf)
+			{
+				readNode(nxtPageNum, nxtPage, true);
+			}
+			else
+			{
+				nxtCached = readCachedNode(nxtPageNum, nxtPage);
+			}
+			FrameLatch *nxtLatch = &bufMgr->latchOf(nxtPage);
+			std::uint64_t nxtVersion = 0;
+			if (nxtIsLeaf && exclusive)
+			{
+				nxtLatch->lockExclusive();
+			}
+			else if (nxtIsLeaf)
+			{
+				nxtLatch->lockShared();
+			}
+			else
+			{
+				nxtVersion = nxtLatch->readVersion();
+			}
+			valid = curLatch->validate(curVersion);
+			releaseCachedNode(curPageNum, curCached);
+
+			if (valid && nxtIsLeaf)
+			{
+				// return the latched leaf, or its right sibling if it has been split since its parent was read
+				moveRight<op, LeafNode<T>>(nxtPageNum, nxtPage, val, true, exclusive);
+				auto *leafPtr = (LeafNode<T> *)nxtPage;
+				if (hasHighKey(leafPtr))
+				{
+					bounded = true;
+					upperBound = highKey(leafPtr);
+				}
+				leafPage = nxtPage;
+				return nxtPageNum;
+			}
+			if (!valid && nxtIsLeaf && exclusive)
+			{
+				nxtLatch->unlockExclusive();
+			}
+			else if (!valid && nxtIsLeaf)
+			{
+				nxtLatch->unlockShared();
+			}
+
+			// change the current page to the next
+			curPageNum = nxtPageNum;
+			curPage = nxtPage;
+			curCached = nxtCached;
+			curLatch = nxtLatch;
+			curVersion = nxtVersion;
+		}
+
+		// restart from the root
+		releaseCachedNode(curPageNum, curCached);
+	}
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::moveRight
+// -----------------------------------------------------------------------------
+
+template <Operator op, class N, class T>
+void BTreeIndex::moveRight(PageId &pageNum, Page *&page, const T &val, bool isLeaf, bool exclusive)
+{
+	while (pastHighKey<op>((N *)page, val))
+	{
+		PageId rightPageNum = rightLink((N *)page);
+		Page *rightPage;
+		readNode(rightPageNum, rightPage, isLeaf);
+		if (exclusive)
+		{
+			bufMgr->latchOf(rightPage).lockExclusive();
+			bufMgr->latchOf(page).unlockExclusive();
+		}
+		else
+		{
+			bufMgr->latchOf(rightPage).lockShared();
+			bufMgr->latchOf(page).unlockShared();
+		}
+		bufMgr->unPinPage(file, pageNum, false);
+		pageNum = rightPageNum;
+		page = rightPage;
+	}
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::latchRoot
+// -----------------------------------------------------------------------------
+
+PageId BTreeIndex::latchRoot(Page *&rootPage)
+{
+	while (true)
+	{
+		PageId rootNum = rootPageNum;
+		readNode(rootNum, rootPage, false);
+		bufMgr->latchOf(rootPage).lockExclusive();
+		if (rootNum == rootPageNum)
+		{
+			return rootNum;
+		}
+
+		// the root has been replaced while waiting for its latch
+		bufMgr->latchOf(rootPage).unlockExclusive();
+		bufMgr->unPinPage(file, rootNum, false);
+	}
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::unlatchPath
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::unlatchPath(std::vector<Page *> &latched)
+{
+	for (Page *page : latched)
+	{
+		bufMgr->latchOf(page).unlockExclusive();
+	}
+	latched.clear();
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::findInLeaf
+// -----------------------------------------------------------------------------
+
+template <class T>
+bool BTreeIndex::findInLeaf(LeafNode<T> *leafPtr, const T &key, RecordId &outRid)
+{
+	int pos = searchBoundKey<GTE>(leafPtr, key);
+	if (pos < leafPtr->numKeys && nodeKey(leafPtr, pos) == key)
+	{
+		outRid = leafRid(leafPtr, pos);
+		if (isPostingRef(outRid))
+		{
+			outRid = firstPosting(outRid.page_number);
+		}
+		return true;
+	}
+	return false;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::writeMetaInfo
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::writeMetaInfo()
+{
+	Page *headerPage;
+	bufMgr->readPage(file, headerPageNum, headerPage);
+	auto *indexMetaInfoPtr = (IndexMetaInfo *)headerPage;
+	indexMetaInfoPtr->rootPageNo = rootPageNum;
+	indexMetaInfoPtr->freePageNo = freePageNum;
+	bufMgr->unPinPage(file, headerPageNum, true);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::allocIndexPage
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::allocIndexPage(PageId &pageNum, Page *&page)
+{
+	std::lock_guard<std::mutex> guard(metaMutex);
+	threadOpCounters.pins++;
+	if (freePageNum == Page::INVALID_NUMBER || appendPages)
+	{
+		bufMgr->allocPage(file, pageNum, page);
+		return;
+	}
+
+	// take the first free page off the list
+	// the page got a new version when it was freed, so it is initialized without being latched
+	pageNum = freePageNum;
+	bufMgr->readPage(file, pageNum, page);
+	freePageNum = ((FreePage *)page)->nextPageNo;
+	memset((void *)page, 0, Page::SIZE);
+	writeMetaInfo();
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::freeIndexPage
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::freeIndexPage(PageId pageNum)
+{
+	// the page becomes the first of the list
+	std::lock_guard<std::mutex> guard(metaMutex);
+	Page *page;
+	bufMgr->readPage(file, pageNum, page);
+	FrameLatch &latch = bufMgr->latchOf(page);
+	latch.lockExclusive();
+	((FreePage *)page)->nextPageNo = freePageNum;
+	latch.unlockExclusive();
+	bufMgr->unPinPage(file, pageNum, true);
+	freePageNum = pageNum;
+	writeMetaInfo();
+	if (cacheNodes)
+	{
+		uncacheNode(pageNum);
+	}
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::allocPostingPage
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::allocPostingPage(PageId &pageNum, PostingPage *&postingPtr)
+{
+	Page *page;
+	allocIndexPage(pageNum, page);
+	postingPtr = (PostingPage *)page;
+	postingPtr->nextPageNo = Page::INVALID_NUMBER;
+	postingPtr->numRids = 0;
+	postingPtr->reserved = 0;
+	postingPtr->format = INDEX_FORMAT_VERSION;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::appendPosting
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::appendPosting(PageId &tailPageNum, PostingPage *&tailPtr, const RecordId &rid)
+{
+	if (tailPageNum == Page::INVALID_NUMBER || tailPtr->numRids == POSTINGPAGESIZE)
+	{
+		// link a new last page after the full one
+		PageId newPageNum;
+		PostingPage *newPtr;
+		allocPostingPage(newPageNum, newPtr);
+		if (tailPageNum != Page::INVALID_NUMBER)
+		{
+			tailPtr->nextPageNo = newPageNum;
+			bufMgr->unPinPage(file, tailPageNum, true);
+		}
+		tailPageNum = newPageNum;
+		tailPtr = newPtr;
+	}
+	tailPtr->ridArray[tailPtr->numRids++] = rid;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::insertPosting
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::insertPosting(PageId headPageNum, const RecordId &rid)
+{
+	// find the first page whose last record ID is not less than the inserted one, or the last page
+	PageId pageNum = headPageNum;
+	Page *page;
+	bufMgr->readPage(file, pageNum, page);
+	auto *postingPtr = (PostingPage *)page;
+	while (postingPtr->nextPageNo != Page::INVALID_NUMBER && postingPtr->ridArray[postingPtr->numRids - 1] < rid)
+	{
+		PageId nxtPageNum = postingPtr->nextPageNo;
+		bufMgr->unPinPage(file, pageNum, false);
+		pageNum = nxtPageNum;
+		bufMgr->readPage(file, pageNum, page);
+		postingPtr = (PostingPage *)page;
+	}
+
+	int n = postingPtr->numRids;
+	int pos = std::lower_bound(postingPtr->ridArray, postingPtr->ridArray + n, rid) - postingPtr->ridArray;
+	if (n == POSTINGPAGESIZE)
+	{
+		// link a new page after the full one
+		PageId splitPageNum;
+		PostingPage *splitPtr;
+		allocPostingPage(splitPageNum, splitPtr);
+		splitPtr->nextPageNo = postingPtr->nextPageNo;
+		postingPtr->nextPageNo = splitPageNum;
+
+		// record IDs appended in order fill the pages up, otherwise the upper half is moved
+		if (pos < n)
+		{
+			int half = n >> 1;
+			std::copy(postingPtr->ridArray + half, postingPtr->ridArray + n, splitPtr->ridArray);
+			splitPtr->numRids = n - half;
+			postingPtr->numRids = half;
+		}
+
+		// insert in the new page if past the record IDs kept
+		if (pos >= postingPtr->numRids)
+		{
+			pos -= postingPtr->numRids;
+			bufMgr->unPinPage(file, pageNum, true);
+			pageNum = splitPageNum;
+			postingPtr = splitPtr;
+		}
+		else
+		{
+			bufMgr->unPinPage(file, splitPageNum, true);
+		}
+	}
+
+	RecordId *rids = postingPtr->ridArray;
+	memmove(rids + pos + 1, rids + pos, (postingPtr->numRids - pos) * sizeof(RecordId));
+	rids[pos] = rid;
+	++postingPtr->numRids;
+	bufMgr->unPinPage(file, pageNum, true);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::firstPosting
+// -----------------------------------------------------------------------------
+
+RecordId BTreeIndex::firstPosting(PageId headPageNum)
+{
+	Page *page;
+	readIndexPage(headPageNum, page);
+	RecordId rid = ((PostingPage *)page)->ridArray[0];
+	releaseIndexPage(headPageNum);
+	return rid;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::erasePosting
+// -----------------------------------------------------------------------------
+
+bool BTreeIndex::erasePosting(RecordId &ref, const RecordId &rid)
+{
+	// find the first page whose last record ID is not less than the removed one, or the last page
+	// the previous page is kept pinned to unlink the page if it gets empty
+	PageId prevPageNum = Page::INVALID_NUMBER;
+	PostingPage *prevPtr = nullptr;
+	PageId pageNum = ref.page_number;
+	Page *page;
+	bufMgr->readPage(file, pageNum, page);
+	auto *postingPtr = (PostingPage *)page;
+	while (postingPtr->nextPageNo != Page::INVALID_NUMBER && postingPtr->ridArray[postingPtr->numRids - 1] < rid)
+	{
+		if (prevPtr != nullptr)
+		{
+			bufMgr->unPinPage(file, prevPageNum, false);
+		}
+		prevPageNum = pageNum;
+		prevPtr = postingPtr;
+		pageNum = postingPtr->nextPageNo;
+		bufMgr->readPage(file, pageNum, page);
+		postingPtr = (PostingPage *)page;
+	}
+
+	RecordId *rids = postingPtr->ridArray;
+	int n = postingPtr->numRids;
+	int pos = std::lower_bound(rids, rids + n, rid) - rids;
+	if (pos == n || rids[pos] != rid)
+	{
+		if (prevPtr != nullptr)
+		{
+			bufMgr->unPinPage(file, prevPageNum, false);
+		}
+		bufMgr->unPinPage(file, pageNum, false);
+		return false;
+	}
+	memmove(rids + pos, rids + pos + 1, (n - pos - 1) * sizeof(RecordId));
+	--postingPtr->numRids;
+
+	if (postingPtr->numRids == 0 && prevPtr == nullptr)
+	{
+		// the emptied first page takes over the next one, so the list keeps its first page
+		// a list holds at least two record IDs, so the first page is not the last one
+		PageId nxtPageNum = postingPtr->nextPageNo;
+		Page *nxtPage;
+		bufMgr->readPage(file, nxtPageNum, nxtPage);
+		memcpy(postingPtr, nxtPage, sizeof(PostingPage));
+		bufMgr->unPinPage(file, nxtPageNum, false);
+		freeIndexPage(nxtPageNum);
+	}
+	else if (postingPtr->numRids == 0)
+	{
+		// unlink the emptied page
+		prevPtr->nextPageNo = postingPtr->nextPageNo;
+		bufMgr->unPinPage(file, pageNum, false);
+		freeIndexPage(pageNum);
+		pageNum = prevPageNum;
+		postingPtr = prevPtr;
+		prevPtr = nullptr;
+	}
+	if (prevPtr != nullptr)
+	{
+		bufMgr->unPinPage(file, prevPageNum, false);
+	}
+
+	// a list left with a single record ID is folded back into the leaf entry
+	bool folded = pageNum == ref.page_number && postingPtr->nextPageNo == Page::INVALID_NUMBER
+	              && postingPtr->numRids == 1;
+	RecordId onlyRid = postingPtr->ridArray[0];
+	bufMgr->unPinPage(file, pageNum, true);
+	if (folded)
+	{
+		freeIndexPage(pageNum);
+		ref = onlyRid;
+	}
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::insertPageKeyPair
+// -----------------------------------------------------------------------------
+template <class T>
+bool BTreeIndex::insertPageKeyPair(NonLeafNode<T> *nodePtr, const PageKeyPair<T> &pk1, PageKeyPair<T> &pk2, int pos)
+{
+	int m = nodePtr->numKeys;  // number of keys in the node
+	if (pos < 0)
+	{
+		pos = upperBoundKey(nodePtr->keyArray, m, pk1.key);
+	}
+
+	if (m < nodeOccupancy)
+	{
+		// the non leaf node is not full
+		insertPageKeyPairAux(nodePtr, pk1, pos);
+		return true;
+	}
+	else
+	{
+		// if full, split the non leaf node
+		// counting the inserted key, the left node keeps the keys before the median
+		// and the split node the keys after it
+		// a node from before the high keys may fill all key slots, and has no right link
+		// as for the leaves, an append to the rightmost node only pushes up its last key, the split node
+		// starting with the inserted one
+		bool append = pos == m && m > 1 && nodePtr->format >= INDEX_FORMAT_V6 && !hasHighKey(nodePtr);
+		int mid = append ? m - 1 : (m + 1) >> 1;  // median position
+		PageId rightPageNo = rightLink(nodePtr);
+		T oldHighKey = highKey(nodePtr);
+
+		// allocate a newly split page
+		PageId splitPageNum;
+		Page *splitPage;
+		allocIndexPage(splitPageNum, splitPage);
+
+		auto *splitNodePtr = (NonLeafNode<T> *)splitPage;
+		// set the level of the split non leaf node
+		initNode(splitNodePtr, nodePtr->level);
+
+		if (pos < mid)
+		{
+			// the old key at mid - 1 becomes the median
+			// insert in the left half of the original node after moving the rest
+			int cnt = m - mid;
+			memcpy(splitNodePtr->keyArray, &nodePtr->keyArray[mid], cnt * sizeof(T));
+			memcpy(splitNodePtr->pageNoArray, &nodePtr->pageNoArray[mid], (cnt + 1) * sizeof(PageId));
+			splitNodePtr->numKeys = cnt;
+			pk2 = {splitPageNum, nodePtr->keyArray[mid - 1]};
+			nodePtr->numKeys = mid - 1;
+			insertPageKeyPairAux(nodePtr, pk1, pos);
+		}
+		else if (pos == mid)
+		{
+			// the inserted key becomes the median
+			// its page becomes the first child of the split node
+			int cnt = m - mid;
+			memcpy(splitNodePtr->keyArray, &nodePtr->keyArray[mid], cnt * sizeof(T));
+			memcpy(&splitNodePtr->pageNoArray[1], &nodePtr->pageNoArray[mid + 1], cnt * sizeof(PageId));
+			splitNodePtr->pageNoArray[0] = pk1.pageNo;
+			splitNodePtr->numKeys = cnt;
+			pk2 = {splitPageNum, pk1.key};
+			nodePtr->numKeys = mid;
+		}
+		else
+		{
+			// the old key at mid becomes the median
+			// insert in the split node after moving the keys after the median
+			int cnt = m - mid - 1;
+			memcpy(splitNodePtr->keyArray, &nodePtr->keyArray[mid + 1], cnt * sizeof(T));
+			memcpy(splitNodePtr->pageNoArray, &nodePtr->pageNoArray[mid + 1], (cnt + 1) * sizeof(PageId));
+			splitNodePtr->numKeys = cnt;
+			pk2 = {splitPageNum, nodePtr->keyArray[mid]};
+			nodePtr->numKeys = mid;
+			insertPageKeyPairAux(splitNodePtr, pk1, pos - mid - 1);
+		}
+
+		// the split node takes over the right link and high key, and is linked after the original one,
+		// which is bounded by the pushed up key, so the split is complete before the parent is changed
+		setRightLink(splitNodePtr, rightPageNo, oldHighKey);
+		nodePtr->format = INDEX_FORMAT_VERSION;
+		setRightLink(nodePtr, splitPageNum, pk2.key);
+
+		bufMgr->unPinPage(file, splitPageNum, true);
+		return false;
+	}
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::insertRIDKeyPair
+// -----------------------------------------------------------------------------
+
+template <class T>
+bool BTreeIndex::insertRIDKeyPair(LeafNode<T> *leafPtr, const RIDKeyPair<T> &rk, PageKeyPair<T> &pk, bool &dirty,
+		const char *included)
+{
+	if (isPacked(leafPtr))
+	{
+		// a packed leaf holds no posting list
+		dirty = true;
+		return unpackLeaf(leafPtr, rk, pk);
+	}
+
+	int m = leafPtr->numKeys;  // number of entries in the leaf
+	int pos;                   // position to insert
+
+	if (insertDuplicateRID(leafPtr, rk, pos))
+	{
+		// the record ID went to a posting list
+		dirty = pos >= 0;
+		return true;
+	}
+	dirty = true;
+
+	if (m < leafOccupancy)
+	{
+		// the leaf node is not full
+		insertRIDKeyPairAux(leafPtr, rk, pos, included);
+		return true;
+	}
+	else
+	{
+		// if full, split the leaf node
+		// counting the inserted entry, the left leaf keeps the first mid entries
+		int mid = chooseLeafSplit(leafPtr, pos, rk.key);  // split position
+
+		// allocate a newly split page
+		PageId splitPageNum;
+		Page *splitPage;
+		allocIndexPage(splitPageNum, splitPage);
+
+		auto *splitLeafPtr = (LeafNode<T> *)splitPage;
+		// set the right sibling of the split leaf
+		initLeaf(splitLeafPtr, leafPtr->rightSibPageNo);
+
+		// move the entries after the left half to the split leaf
+		// if inserted in the left, one more entry is moved to make room
+		int st = pos < mid ? mid - 1 : mid;
+		moveLeafEntries(splitLeafPtr, 0, leafPtr, st, m - st);
+		splitLeafPtr->numKeys = m - st;
+		leafPtr->numKeys = st;
+
+		if (pos < mid)
+		{
+			// insert in the left half of the original leaf
+			insertRIDKeyPairAux(leafPtr, rk, pos, included);
+		}
+		else
+		{
+			// insert in the split leaf
+			insertRIDKeyPairAux(splitLeafPtr, rk, pos - mid, included);
+		}
+
+		// copy up the first key of the split leaf
+		pk = {splitPageNum, splitLeafPtr->keyArray[0]};
+
+		// the split leaf takes over the high key, and is linked after the original one,
+		// which is bounded by the copied up key, so the split is complete before the parent is changed
+		if (hasHighKey(leafPtr))
+		{
+			setHighKey(splitLeafPtr, highKey(leafPtr));
+		}
+		leafPtr->format = INDEX_FORMAT_VERSION;
+		setHighKey(leafPtr, pk.key);
+		leafPtr->rightSibPageNo = splitPageNum;
+
+		bufMgr->unPinPage(file, splitPageNum, true);
+		return false;
+	}
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::unpackLeaf
+// -----------------------------------------------------------------------------
+
+template <class T>
+bool BTreeIndex::unpackLeaf(LeafNode<T> *leafPtr, const RIDKeyPair<T> &rk, PageKeyPair<T> &pk)
+{
+	// the entries of the leaf and the inserted one, in key and record ID order
+	int n = leafPtr->numKeys;
+	std::vector<RIDKeyPair<T>> entries(n);
+	for (int i = 0; i < n; ++i)
+	{
+		entries[i].set(leafRid(leafPtr, i), nodeKey(leafPtr, i));
+	}
+	entries.insert(std::upper_bound(entries.begin(), entries.end(), rk), rk);
+	++n;
+
+	// the left half is rewritten in place, after the right one is copied out
+	auto keyOf = [&](int i) { return entries[i].key; };
+	int st = n <= leafOccupancy ? n : splitBetweenKeys(keyOf, n, n - leafOccupancy, leafOccupancy);
+	bool split = st < n;
+	if (split)
+	{
+		PageId splitPageNum;
+		Page *splitPage;
+		allocIndexPage(splitPageNum, splitPage);
+
+		// the split leaf takes over the right sibling and the high key
+		auto *splitLeafPtr = (LeafNode<T> *)splitPage;
+		initLeaf(splitLeafPtr, leafPtr->rightSibPageNo);
+		if (hasHighKey(leafPtr))
+		{
+			setHighKey(splitLeafPtr, highKey(leafPtr));
+		}
+		for (int i = st; i < n; ++i)
+		{
+			splitLeafPtr->keyArray[i - st] = entries[i].key;
+			splitLeafPtr->ridArray[i - st] = entries[i].rid;
+		}
+		splitLeafPtr->numKeys = n - st;
+
+		pk = {splitPageNum, entries[st].key};
+		setHighKey(leafPtr, pk.key);
+		leafPtr->rightSibPageNo = splitPageNum;
+		bufMgr->unPinPage(file, splitPageNum, true);
+	}
+
+	for (int i = 0; i < st; ++i)
+	{
+		leafPtr->keyArray[i] = entries[i].key;
+		leafPtr->ridArray[i] = entries[i].rid;
+	}
+	leafPtr->numKeys = st;
+	leafPtr->format = INDEX_FORMAT_VERSION;
+	return !split;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::isUnderfull
+// -----------------------------------------------------------------------------
+
+template <class T>
+bool BTreeIndex::isUnderfull(const LeafNode<T> *leafPtr)
+{
+	return leafPtr->numKeys < leafOccupancy * UNDERFLOW_FILL_FACTOR;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::isUnderfull
+// -----------------------------------------------------------------------------
+
+template <class T>
+bool BTreeIndex::isUnderfull(const NonLeafNode<T> *nodePtr)
+{
+	return nodePtr->numKeys < nodeOccupancy * UNDERFLOW_FILL_FACTOR;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::isMergeSafe
+// -----------------------------------------------------------------------------
+
+template <class T>
+bool BTreeIndex::isMergeSafe(const LeafNode<T> *leafPtr)
+{
+	return deletePolicy == DELETE_LAZY || leafPtr->numKeys - 1 >= leafOccupancy * UNDERFLOW_FILL_FACTOR;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::isMergeSafe
+// -----------------------------------------------------------------------------
+
+template <class T>
+bool BTreeIndex::isMergeSafe(const NonLeafNode<T> *nodePtr)
+{
+	return deletePolicy == DELETE_LAZY || nodePtr->numKeys - 1 >= nodeOccupancy * UNDERFLOW_FILL_FACTOR;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::eraseRIDKeyPair
+// -----------------------------------------------------------------------------
+
+template <class T>
+bool BTreeIndex::eraseRIDKeyPair(LeafNode<T> *leafPtr, const RIDKeyPair<T> &rk)
+{
+	// the entries with an equal key
+	int first = searchBoundKey<GTE>(leafPtr, rk.key);
+	int last = searchBoundKey<GT>(leafPtr, rk.key);
+	RecordId *rids = leafPtr->ridArray;
+
+	if (isPacked(leafPtr))
+	{
+		// a packed leaf holds no posting list
+		for (int pos = first; pos < last; ++pos)
+		{
+			if (leafRid(leafPtr, pos) == rk.rid)
+			{
+				eraseRIDKeyPairsAux(leafPtr, pos, 1);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	if (last - first == 1 && isPostingRef(rids[first]))
+	{
+		// the key has a posting list
+		return erasePosting(rids[first], rk.rid);
+	}
+
+	// files from before INDEX_FORMAT_V5 may hold the entries of a key in insertion order
+	RecordId *found = std::find(rids + first, rids + last, rk.rid);
+	if (found == rids + last)
+	{
+		return false;
+	}
+	eraseRIDKeyPairsAux(leafPtr, found - rids, 1);
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::rebalanceLeaves
+// -----------------------------------------------------------------------------
+
+template <class T>
+bool BTreeIndex::rebalanceLeaves(LeafNode<T> *leftPtr, LeafNode<T> *rightPtr, NonLeafNode<T> *parentPtr, int pos)
+{
+	if (isPacked(leftPtr) || isPacked(rightPtr))
+	{
+		// packed leaves are left as they are, their entries not fitting in a leaf until most are removed
+		return false;
+	}
+
+	int m = leftPtr->numKeys;       // number of entries in the left leaf
+	int n = m + rightPtr->numKeys;  // number of entries in both leaves
+
+	if (n <= leafOccupancy)
+	{
+		// move all entries to the left leaf, which takes over the right sibling and its high key
+		moveLeafEntries(leftPtr, m, rightPtr, 0, n - m);
+		leftPtr->numKeys = n;
+		leftPtr->rightSibPageNo = rightPtr->rightSibPageNo;
+		leftPtr->format = INDEX_FORMAT_VERSION;
+		if (hasHighKey(rightPtr))
+		{
+			setHighKey(leftPtr, highKey(rightPtr));
+		}
+		else
+		{
+			clearHighKey(leftPtr);
+		}
+		rightPtr->numKeys = 0;
+		erasePageKeyPairAux(parentPtr, pos);
+		return true;
+	}
+
+	// the i-th entry of both leaves
+	auto keyOf = [&](int i) { return i < m ? leftPtr->keyArray[i] : rightPtr->keyArray[i - m]; };
+
+	// the left leaf keeps the first st entries, none of the leaves overflowing
+	int st = splitBetweenKeys(keyOf, n, n - leafOccupancy, leafOccupancy);
+	if (st < m)
+	{
+		// move the last entries of the left leaf to the front of the right one
+		int cnt = m - st;
+		moveLeafEntries(rightPtr, cnt, rightPtr, 0, n - m);
+		moveLeafEntries(rightPtr, 0, leftPtr, st, cnt);
+	}
+	else
+	{
+		// move the first entries of the right leaf to the back of the left one
+		int cnt = st - m;
+		moveLeafEntries(leftPtr, m, rightPtr, 0, cnt);
+		moveLeafEntries(rightPtr, 0, rightPtr, cnt, n - st);
+	}
+	leftPtr->numKeys = st;
+	rightPtr->numKeys = n - st;
+
+	// the first key of the right leaf separates it from the left one
+	parentPtr->keyArray[pos] = rightPtr->keyArray[0];
+	leftPtr->format = INDEX_FORMAT_VERSION;
+	setHighKey(leftPtr, rightPtr->keyArray[0]);
+	return false;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::rebalanceNodes
+// -----------------------------------------------------------------------------
+
+template <class T>
+bool BTreeIndex::rebalanceNodes(NonLeafNode<T> *leftPtr, NonLeafNode<T> *rightPtr, NonLeafNode<T> *parentPtr, int pos)
+{
+	// gather the keys and children of both nodes around the separator pulled down
+	int m = leftPtr->numKeys;
+	std::vector<T> keys(leftPtr->keyArray, leftPtr->keyArray + m);
+	keys.push_back(parentPtr->keyArray[pos]);
+	keys.insert(keys.end(), rightPtr->keyArray, rightPtr->keyArray + rightPtr->numKeys);
+	std::vector<PageId> pageNos(leftPtr->pageNoArray, leftPtr->pageNoArray + m + 1);
+	pageNos.insert(pageNos.end(), rightPtr->pageNoArray, rightPtr->pageNoArray + rightPtr->numKeys + 1);
+	int n = keys.size();
+	leftPtr->format = INDEX_FORMAT_VERSION;
+
+	if (n <= nodeOccupancy)
+	{
+		// move all keys and children to the left node, which takes over the right link and high key
+		std::copy(keys.begin(), keys.end(), leftPtr->keyArray);
+		std::copy(pageNos.begin(), pageNos.end(), leftPtr->pageNoArray);
+		leftPtr->numKeys = n;
+		setRightLink(leftPtr, rightLink(rightPtr), highKey(rightPtr));
+		rightPtr->numKeys = 0;
+		erasePageKeyPairAux(parentPtr, pos);
+		return true;
+	}
+
+	// the left node keeps the keys before the median and the right node the keys after it
+	int mid = n >> 1;
+	std::copy(keys.begin(), keys.begin() + mid, leftPtr->keyArray);
+	std::copy(pageNos.begin(), pageNos.begin() + mid + 1, leftPtr->pageNoArray);
+	leftPtr->numKeys = mid;
+	std::copy(keys.begin() + mid + 1, keys.end(), rightPtr->keyArray);
+	std::copy(pageNos.begin() + mid + 1, pageNos.end(), rightPtr->pageNoArray);
+	rightPtr->numKeys = n - mid - 1;
+
+	// the median moves up to separate them
+	parentPtr->keyArray[pos] = keys[mid];
+	setRightLink(leftPtr, parentPtr->pageNoArray[pos + 1], keys[mid]);
+	return false;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::fixUnderflow
+// -----------------------------------------------------------------------------
+
+template <class T>
+bool BTreeIndex::fixUnderflow(NonLeafNode<T> *nodePtr, int pos)
+{
+	// a single child has no sibling
+	if (nodePtr->numKeys == 0)
+	{
+		return false;
+	}
+
+	// the child and its right sibling, or its left sibling if it is the last child
+	int sepPos = pos < nodePtr->numKeys ? pos : pos - 1;
+	PageId leftPageNum = nodePtr->pageNoArray[sepPos];
+	PageId rightPageNum = nodePtr->pageNoArray[sepPos + 1];
+	bool isLeaf = nodePtr->level == 1;
+	Page *leftPage;
+	Page *rightPage;
+	readNode(leftPageNum, leftPage, isLeaf);
+	bufMgr->latchOf(leftPage).lockExclusive();
+	readNode(rightPageNum, rightPage, isLeaf);
+	bufMgr->latchOf(rightPage).lockExclusive();
+
+	bool merged = isLeaf
+			? rebalanceLeaves((LeafNode<T> *)leftPage, (LeafNode<T> *)rightPage, nodePtr, sepPos)
+			: rebalanceNodes((NonLeafNode<T> *)leftPage, (NonLeafNode<T> *)rightPage, nodePtr, sepPos);
+
+	bufMgr->latchOf(leftPage).unlockExclusive();
+	bufMgr->latchOf(rightPage).unlockExclusive();
+	bufMgr->unPinPage(file, leftPageNum, true);
+	bufMgr->unPinPage(file, rightPageNum, true);
+	if (merged)
+	{
+		// the right page is no longer part of the tree
+		freeIndexPage(rightPageNum);
+	}
+	return merged;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::deleteEntryAux
+// -----------------------------------------------------------------------------
+
+template <class T>
+bool BTreeIndex::deleteEntryAux(NonLeafNode<T> *nodePtr, const RIDKeyPair<T> &rk, std::vector<Page *> &latched)
+{
+	// the children that may hold the key, from the one an insertion goes into
+	// the children before it only hold the key if a leaf was split between equal keys
+	int first = searchBoundKey<GTE>(nodePtr, rk.key);
+	int last = searchBoundKey<GT>(nodePtr, rk.key);
+	bool isLeaf = nodePtr->level == 1;
+
+	for (int pos = last; pos >= first; --pos)
+	{
+		PageId nxtPageNum = nodePtr->pageNoArray[pos];
+		Page *nxtPage;
+		readNode(nxtPageNum, nxtPage, isLeaf);
+		bufMgr->latchOf(nxtPage).lockExclusive();
+
+		// the ancestors are released if the child cannot underflow and no other child is left to try
+		bool safe = isLeaf ? isMergeSafe((LeafNode<T> *)nxtPage) : isMergeSafe((NonLeafNode<T> *)nxtPage);
+		if (safe && pos == first)
+		{
+			unlatchPath(latched);
+		}
+		latched.push_back(nxtPage);
+
+		bool found;
+		bool underfull;
+		if (isLeaf)
+		{
+			// remove the <rid, key> pair from the leaf node
+			auto *nxtLeafPtr = (LeafNode<T> *)nxtPage;
+			found = eraseRIDKeyPair(nxtLeafPtr, rk);
+			underfull = found && isUnderfull(nxtLeafPtr);
+		}
+		else
+		{
+			// remove from the non leaf node recursively
+			auto *nxtNodePtr = (NonLeafNode<T> *)nxtPage;
+			found = deleteEntryAux(nxtNodePtr, rk, latched);
+			underfull = found && isUnderfull(nxtNodePtr);
+		}
+
+		// release the child unless a safe descendant has released it already
+		// an underfull child is never safe, so the current node is still latched to fix it
+		if (!latched.empty() && latched.back() == nxtPage)
+		{
+			bufMgr->latchOf(nxtPage).unlockExclusive();
+			latched.pop_back();
+		}
+		bufMgr->unPinPage(file, nxtPageNum, found);
+		if (found)
+		{
+			if (underfull && deletePolicy == DELETE_EAGER)
+			{
+				fixUnderflow(nodePtr, pos);
+			}
+			return true;
+		}
+	}
+	return false;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::compactAux
+// -----------------------------------------------------------------------------
+
+template <class T>
+bool BTreeIndex::compactAux(NonLeafNode<T> *nodePtr)
+{
+	bool isLeaf = nodePtr->level == 1;
+	bool modified = false;
+
+	// compact the subtrees of the children first
+	for (int pos = 0; pos <= nodePtr->numKeys && !isLeaf; ++pos)
+	{
+		PageId nxtPageNum = nodePtr->pageNoArray[pos];
+		Page *nxtPage;
+		readNode(nxtPageNum, nxtPage, false);
+		bufMgr->latchOf(nxtPage).lockExclusive();
+		bool nxtModified = compactAux((NonLeafNode<T> *)nxtPage);
+		bufMgr->latchOf(nxtPage).unlockExclusive();
+		bufMgr->unPinPage(file, nxtPageNum, nxtModified);
+		modified = modified || nxtModified;
+	}
+
+	// whether the child at the position is underfull
+	auto childUnderfull = [&](int pos)
+	{
+		PageId nxtPageNum = nodePtr->pageNoArray[pos];
+		Page *nxtPage;
+		readNode(nxtPageNum, nxtPage, isLeaf);
+		FrameLatch &latch = bufMgr->latchOf(nxtPage);
+		latch.lockShared();
+		bool underfull = isLeaf ? isUnderfull((LeafNode<T> *)nxtPage) : isUnderfull((NonLeafNode<T> *)nxtPage);
+		latch.unlockShared();
+		bufMgr->unPinPage(file, nxtPageNum, false);
+		return underfull;
+	};
+
+	// then fix the underfull children from left to right
+	// a child merged with its right sibling may still be underfull
+	int pos = 0;
+	while (pos <= nodePtr->numKeys)
+	{
+		if (!childUnderfull(pos) || nodePtr->numKeys == 0)
+		{
+			++pos;
+			continue;
+		}
+		modified = true;
+		if (!fixUnderflow(nodePtr, pos))
+		{
+			++pos;
+		}
+	}
+	return modified;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::collapseRoot
+// -----------------------------------------------------------------------------
+
+template <class T>
+void BTreeIndex::collapseRoot(PageId &rootPageNo, Page *&rootPage)
+{
+	auto *rootPtr = (NonLeafNode<T> *)rootPage;
+	while (rootPtr->numKeys == 0 && rootPtr->level == 0)
+	{
+		// the single child becomes the root, which is recorded when the old root is freed
+		PageId oldRootPageNum = rootPageNo;
+		Page *oldRootPage = rootPage;
+		rootPageNo = rootPtr->pageNoArray[0];
+		readNode(rootPageNo, rootPage, false);
+		bufMgr->latchOf(rootPage).lockExclusive();
+		rootPageNum = rootPageNo;
+
+		bufMgr->latchOf(oldRootPage).unlockExclusive();
+		bufMgr->unPinPage(file, oldRootPageNum, false);
+		freeIndexPage(oldRootPageNum);
+		rootPtr = (NonLeafNode<T> *)rootPage;
+	}
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::bulkLoad
+// -----------------------------------------------------------------------------
+
+template <class T>
+void BTreeIndex::bulkLoad(const std::string &relationName, const std::string &indexName, Page *headerPage)
+{
+	// collect and sort the <rid, key> pairs of the relation
+	std::vector<std::vector<RIDKeyPair<T>>> runs;
+	std::vector<std::string> runNames;
+	std::vector<IncludedValues> included;
+	std::size_t numPairs = sortRelation(relationName, indexName, runs, runNames, included);
+
+	// pack the leaves from left to right
+	std::vector<PageKeyPair<T>> children;
+	packLeaves(numPairs, runs, runNames, included, children);
+
+	// the runs are no longer needed
+	for (const std::string &runName : runNames)
+	{
+		std::remove(runName.c_str());
+	}
+	std::vector<std::vector<RIDKeyPair<T>>>().swap(runs);
+	std::vector<IncludedValues>().swap(included);
+
+	// set the root page number in the meta page once
+	rootPageNum = packUpperLevels(children);
+	((IndexMetaInfo *)headerPage)->rootPageNo = rootPageNum;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::packUpperLevels
+// -----------------------------------------------------------------------------
+
+template <class T>
+PageId BTreeIndex::packUpperLevels(std::vector<PageKeyPair<T>> &children)
+{
+	// pack the non leaf levels until a single root is left
+	std::vector<PageKeyPair<T>> parents;
+	int level = 1;
+	while (true)
+	{
+		parents.clear();
+		packNonLeaves(children, level, parents);
+		if (parents.size() == 1)
+		{
+			return parents[0].pageNo;
+		}
+		children.swap(parents);
+		level = 0;
+	}
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::sortRelation
+// -----------------------------------------------------------------------------
+
+static std::atomic<unsigned> bulkLoadThreads(0);
+
+void BTreeIndex::setBulkLoadThreads(unsigned numThreads)
+{
+	bulkLoadThreads = numThreads;
+}
+
+static std::atomic<bool> bulkLoadPacking(false);
+
+void BTreeIndex::setBulkLoadPacking(bool packing)
+{
+	bulkLoadPacking = packing;
+}
+
+template <class T>
+std::size_t BTreeIndex::sortRelation(const std::string &relationName, const std::string &indexName,
+		std::vector<std::vector<RIDKeyPair<T>>> &runs, std::vector<std::string> &runNames,
+		std::vector<IncludedValues> &included)
+{
+	unsigned numThreads = bulkLoadThreads != 0 ? bulkLoadThreads.load()
+			: std::min(std::max(std::thread::hardware_concurrency(), 1u), BULKLOAD_MAX_THREADS);
+
+	// the number of pairs that fit in the buffer pool, shared by the threads
+	std::size_t budget = std::max<std::size_t>(1,
+			(std::size_t)bufMgr->getNumBufs() * Page::SIZE / sizeof(RIDKeyPair<T>) / numThreads);
+	std::vector<std::size_t> numPairs(numThreads, 0);
+	std::mutex runNamesMutex;
+
+	runs.assign(numThreads, std::vector<RIDKeyPair<T>>());
+	std::vector<std::vector<IncludedValues>> includedRuns(numThreads);
+	ParallelFileScan fscan(relationName, bufMgr);
+	fscan.run(numThreads, [&](unsigned thread, const RecordId &rid, std::string_view record) {
+		std::vector<RIDKeyPair<T>> &pairs = runs[thread];
+		RIDKeyPair<T> rk;
+		rk.rid = rid;
+		loadRecordKey(record.data(), rk.key);
+		pairs.push_back(rk);
+		++numPairs[thread];
+
+		// the included values are kept aside, as the pairs are sorted on the key
+		if (includedWidth > 0)
+		{
+			IncludedValues values;
+			values.rid = rid;
+			loadIncluded(record.data(), values.values);
+			includedRuns[thread].push_back(values);
+		}
+
+		// spill a sorted run if the share of the thread is used up
+		if (pairs.size() == budget)
+		{
+			std::sort(pairs.begin(), pairs.end());
+			std::string runName;
+			{
+				std::lock_guard<std::mutex> guard(runNamesMutex);
+				runName = indexName + ".run" + std::to_string(runNames.size());
+				runNames.push_back(runName);
+			}
+			writeRun(runName, pairs);
+			pairs.clear();
+		}
+	});
+
+	for (std::vector<RIDKeyPair<T>> &pairs : runs)
+	{
+		std::sort(pairs.begin(), pairs.end());
+	}
+
+	// the included values are looked up by record ID as the leaves are packed
+	included.clear();
+	for (std::vector<IncludedValues> &values : includedRuns)
+	{
+		included.insert(included.end(), values.begin(), values.end());
+		std::vector<IncludedValues>().swap(values);
+	}
+	std::sort(included.begin(), included.end());
+	return std::accumulate(numPairs.begin(), numPairs.end(), (std::size_t)0);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::writeRun
+// -----------------------------------------------------------------------------
+
+template <class T>
+void BTreeIndex::writeRun(const std::string &runName, const std::vector<RIDKeyPair<T>> &pairs)
+{
+	std::ofstream run(runName, std::ios::binary | std::ios::trunc);
+	run.write(reinterpret_cast<const char *>(pairs.data()), pairs.size() * sizeof(RIDKeyPair<T>));
+}
+
+// -----------------------------------------------------------------------------
+// SortedPairs
+// -----------------------------------------------------------------------------
+
+/**
+ * @brief Sorted <rid, key> pairs produced by sortRelation, taken one at a time by a k-way merge of
+ * the runs in memory and the run files.
+ * The runs are merged by a loser tree: each internal node keeps the run which lost the match played
+ * there, and the winner of the whole tree is the run with the smallest head. Taking a pair replays
+ * only the matches on the path of its run, i.e. log2(k) comparisons against k - 1 for a linear scan
+ * or up to 2 log2(k) for a binary heap.
+ */
+template <class T>
+class SortedPairs
+{
+ public:
+	SortedPairs(const std::vector<std::vector<RIDKeyPair<T>>> &memoryRuns, const std::vector<std::string> &runNames)
+			: memRuns(memoryRuns)
+			, numRuns(memoryRuns.size() + runNames.size())
+			, heads(numRuns)
+			, next(memoryRuns.size(), 0)
+			, exhausted(numRuns, false)
+			, tree(std::max<std::size_t>(numRuns, 1), 0)
+	{
+		for (const std::string &runName : runNames)
+		{
+			files.emplace_back(runName, std::ios::binary);
+		}
+		for (std::size_t r = 0; r < numRuns; ++r)
+		{
+			refill(r);
+		}
+
+		// play the matches bottom-up, the runs being the leaves numRuns to 2 numRuns - 1
+		std::vector<std::size_t> winners(2 * numRuns);
+		for (std::size_t r = 0; r < numRuns; ++r)
+		{
+			winners[numRuns + r] = r;
+		}
+		for (std::size_t node = numRuns - 1; node > 0 && numRuns > 1; --node)
+		{
+			std::size_t a = winners[2 * node], b = winners[2 * node + 1];
+			winners[node] = beats(a, b) ? a : b;
+			tree[node] = beats(a, b) ? b : a;
+		}
+		tree[0] = numRuns > 1 ? winners[1] : 0;
+	}
+
+	/**
+	 * Return whether all pairs have been taken.
+	 */
+	bool empty() const
+	{
+		return numRuns == 0 || exhausted[tree[0]];
+	}
+
+	/**
+	 * Return the smallest pair left.
+	 */
+	const RIDKeyPair<T> &front() const
+	{
+		return heads[tree[0]];
+	}
+
+	/**
+	 * Take the smallest pair left.
+	 */
+	void pop()
+	{
+		// refill the winning run, and replay its matches up to the root
+		std::size_t winner = tree[0];
+		refill(winner);
+		for (std::size_t node = (winner + numRuns) / 2; node > 0; node /= 2)
+		{
+			if (beats(tree[node], winner))
+			{
+				std::swap(tree[node], winner);
+			}
+		}
+		tree[0] = winner;
+	}
+
+ private:
+	/**
+	 * Whether run a wins against run b, an exhausted run losing against all others.
+	 */
+	bool beats(std::size_t a, std::size_t b) const
+	{
+		if (exhausted[a] || exhausted[b])
+		{
+			return !exhausted[a];
+		}
+		return heads[a] < heads[b];
+	}
+
+	void refill(std::size_t r)
+	{
+		if (r < memRuns.size())
+		{
+			if (next[r] < memRuns[r].size())
+			{
+				heads[r] = memRuns[r][next[r]++];
+			}
+			else
+			{
+				exhausted[r] = true;
+			}
+		}
+		else if (!files[r - memRuns.size()].read(reinterpret_cast<char *>(&heads[r]), sizeof(RIDKeyPair<T>)))
+		{
+			exhausted[r] = true;
+		}
+	}
+
+	const std::vector<std::vector<RIDKeyPair<T>>> &memRuns;
+	std::vector<std::ifstream> files;  // the run files, numbered after the runs in memory
+	std::size_t numRuns;
+	std::vector<RIDKeyPair<T>> heads;  // the next pair of each run
+	std::vector<std::size_t> next;  // index of the pair after the head of each run in memory
+	std::vector<bool> exhausted;
+	// the loser of the match at each internal node, and the overall winner at 0
+	std::vector<std::size_t> tree;
+};
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::takeKeyGroup
+// -----------------------------------------------------------------------------
+
+template <class T>
+void BTreeIndex::takeKeyGroup(SortedPairs<T> &sorted, std::vector<RIDKeyPair<T>> &group)
+{
+	group.clear();
+	const T key = sorted.front().key;
+
+	// the posting list, started once the key has too many entries
+	PageId headPageNum = Page::INVALID_NUMBER;
+	PageId tailPageNum = Page::INVALID_NUMBER;
+	PostingPage *tailPtr = nullptr;
+
+	while (!sorted.empty() && sorted.front().key == key)
+	{
+		const RIDKeyPair<T> &rk = sorted.front();
+		if (headPageNum == Page::INVALID_NUMBER && (int)group.size() < postingThreshold)
+		{
+			group.push_back(rk);
+		}
+		else
+		{
+			if (headPageNum == Page::INVALID_NUMBER)
+			{
+				// move the record IDs taken so far to the list
+				for (const RIDKeyPair<T> &taken : group)
+				{
+					appendPosting(tailPageNum, tailPtr, taken.rid);
+				}
+				headPageNum = tailPageNum;
+			}
+			appendPosting(tailPageNum, tailPtr, rk.rid);
+		}
+		sorted.pop();
+	}
+
+	if (headPageNum != Page::INVALID_NUMBER)
+	{
+		bufMgr->unPinPage(file, tailPageNum, true);
+
+		// a single entry of the key refers to the list
+		group.resize(1);
+		group[0].rid = postingRef(headPageNum);
+	}
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::packLeaves
+// -----------------------------------------------------------------------------
+
+template <class T>
+void BTreeIndex::packLeaves(std::size_t numPairs, const std::vector<std::vector<RIDKeyPair<T>>> &runs,
+		const std::vector<std::string> &runNames, const std::vector<IncludedValues> &included,
+		std::vector<PageKeyPair<T>> &children)
+{
+	SortedPairs<T> sorted(runs, runNames);
+	std::size_t numLeaves = numPackedPages(numPairs, leafOccupancy, 1);
+
+	// the previous leaf is kept pinned until its right sibling is known
+	PageId prevPageNum = Page::INVALID_NUMBER;
+	LeafNode<T> *prevLeafPtr = nullptr;
+
+	// the entries of the next key, taken but not packed yet
+	std::vector<RIDKeyPair<T>> group;
+
+	// there is always at least one leaf, possibly empty
+	for (std::size_t j = 0; j == 0 || !group.empty(); ++j)
+	{
+		PageId leafPageNum;
+		Page *leafPage;
+		allocIndexPage(leafPageNum, leafPage);
+		auto *leafPtr = (LeafNode<T> *)leafPage;
+		initLeaf(leafPtr, Page::INVALID_NUMBER);
+
+		// spread the pairs evenly over the leaves, without splitting the entries of a key
+		// a key with a posting list takes a single entry
+		std::size_t target = numPairs / numLeaves + (j < numPairs % numLeaves);
+		std::size_t numEntries = 0;
+		while (true)
+		{
+			if (group.empty() && !sorted.empty())
+			{
+				takeKeyGroup(sorted, group);
+			}
+			if (group.empty()
+					|| (numEntries > 0
+					    && (numEntries >= target || numEntries + group.size() > (std::size_t)leafOccupancy)))
+			{
+				break;
+			}
+			// the entries of a key fill a whole leaf if they do not fit in one
+			std::size_t taken = std::min(group.size(), (std::size_t)leafOccupancy - numEntries);
+			for (std::size_t i = 0; i < taken; ++i)
+			{
+				const RIDKeyPair<T> &rk = group[i];
+				leafPtr->keyArray[numEntries] = rk.key;
+				leafPtr->ridArray[numEntries] = rk.rid;
+				if (includedWidth > 0)
+				{
+					IncludedValues probe;
+					probe.rid = rk.rid;
+					memcpy(includedValues(leafPtr, numEntries),
+					       std::lower_bound(included.begin(), included.end(), probe)->values, includedWidth);
+				}
+				++numEntries;
+			}
+			group.erase(group.begin(), group.begin() + taken);
+		}
+		leafPtr->numKeys = numEntries;
+
+		// the first key of the leaf separates it from the left sibling
+		children.push_back({leafPageNum, leafPtr->keyArray[0]});
+
+		// link the previous leaf to this one, bounded by the separator
+		if (prevLeafPtr != nullptr)
+		{
+			prevLeafPtr->rightSibPageNo = leafPageNum;
+			setHighKey(prevLeafPtr, leafPtr->keyArray[0]);
+			bufMgr->unPinPage(file, prevPageNum, true);
+		}
+
+		prevPageNum = leafPageNum;
+		prevLeafPtr = leafPtr;
+	}
+
+	bufMgr->unPinPage(file, prevPageNum, true);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::packLeaves -- INTEGER
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::packLeaves(std::size_t numPairs, const std::vector<std::vector<RIDKeyPair<int>>> &runs,
+		const std::vector<std::string> &runNames, const std::vector<IncludedValues> &included,
+		std::vector<PageKeyPair<int>> &children)
+{
+	if (!bulkLoadPacking || includedWidth > 0)
+	{
+		packLeaves<int>(numPairs, runs, runNames, included, children);
+		return;
+	}
+
+	SortedPairs<int> sorted(runs, runNames);
+
+	// the number of entries to fill in a packed leaf according to the fill factor
+	int maxPacked = 2 * leafOccupancy - 1;
+	std::size_t target = std::min(maxPacked, std::max(1, (int)(maxPacked * fillFactor)));
+
+	// the previous leaf is kept pinned until its right sibling is known
+	PageId prevPageNum = Page::INVALID_NUMBER;
+	LeafNodeInt *prevLeafPtr = nullptr;
+
+	// the entries of the next key, taken but not packed yet
+	std::vector<RIDKeyPair<int>> group;
+	std::vector<int> keys;
+	std::vector<RecordId> rids;
+
+	// there is always at least one leaf, possibly empty
+	for (std::size_t j = 0; j == 0 || !group.empty(); ++j)
+	{
+		PageId leafPageNum;
+		Page *leafPage;
+		allocIndexPage(leafPageNum, leafPage);
+		auto *leafPtr = (LeafNodeInt *)leafPage;
+		initLeaf(leafPtr, Page::INVALID_NUMBER);
+
+		// take the entries of whole keys while they fit packed, or in a leaf once a posting list is taken
+		keys.clear();
+		rids.clear();
+		bool packable = true;
+		PageId minPage = UINT32_MAX;
+		PageId maxPage = 0;
+		SlotId maxSlot = 0;
+		while (true)
+		{
+			if (group.empty() && !sorted.empty())
+			{
+				takeKeyGroup(sorted, group);
+			}
+			if (group.empty())
+			{
+				break;
+			}
+			std::size_t capacity = leafOccupancy;
+			if (isPostingRef(group[0].rid))
+			{
+				if (!keys.empty() && packable)
+				{
+					break;
+				}
+				packable = false;
+			}
+			if (packable)
+			{
+				// the widths with the entries of the key
+				for (const RIDKeyPair<int> &rk : group)
+				{
+					minPage = std::min(minPage, rk.rid.page_number);
+					maxPage = std::max(maxPage, rk.rid.page_number);
+					maxSlot = std::max(maxSlot, rk.rid.slot_number);
+				}
+				int firstKey = keys.empty() ? group[0].key : keys[0];
+				int packed = packedCapacity(packedWidth((std::uint32_t)group[0].key - (std::uint32_t)firstKey),
+				                            packedWidth(maxPage - minPage), packedWidth(maxSlot));
+				capacity = std::max(leafOccupancy, std::min(maxPacked, packed));
+			}
+			if (!keys.empty() && (keys.size() >= target || keys.size() + group.size() > capacity))
+			{
+				break;
+			}
+			for (const RIDKeyPair<int> &rk : group)
+			{
+				keys.push_back(rk.key);
+				rids.push_back(rk.rid);
+			}
+			group.clear();
+		}
+
+		// a leaf taking no more entries than an unpacked one holds stays unpacked
+		if ((int)keys.size() <= leafOccupancy || !packLeaf(leafPtr, keys.data(), rids.data(), keys.size()))
+		{
+			std::copy(keys.begin(), keys.end(), leafPtr->keyArray);
+			std::copy(rids.begin(), rids.end(), leafPtr->ridArray);
+			leafPtr->numKeys = keys.size();
+		}
+
+		// the first key of the leaf separates it from the left sibling
+		children.push_back({leafPageNum, nodeKey(leafPtr, 0)});
+
+		// link the previous leaf to this one, bounded by the separator
+		if (prevLeafPtr != nullptr)
+		{
+			prevLeafPtr->rightSibPageNo = leafPageNum;
+			setHighKey(prevLeafPtr, nodeKey(leafPtr, 0));
+			bufMgr->unPinPage(file, prevPageNum, true);
+		}
+
+		prevPageNum = leafPageNum;
+		prevLeafPtr = leafPtr;
+	}
+
+	bufMgr->unPinPage(file, prevPageNum, true);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::packNonLeaves
+// -----------------------------------------------------------------------------
+
+template <class T>
+void BTreeIndex::packNonLeaves(const std::vector<PageKeyPair<T>> &children, int level,
+		std::vector<PageKeyPair<T>> &parents)
+{
+	// a non leaf node should have at least two children if possible
+	std::size_t numNodes = numPackedPages(children.size(), nodeOccupancy + 1, 2);
+	std::size_t nextChild = 0;  // index of the next child
+
+	// the previous node is kept pinned until its right link is known
+	PageId prevPageNum = Page::INVALID_NUMBER;
+	NonLeafNode<T> *prevNodePtr = nullptr;
+
+	for (std::size_t j = 0; j < numNodes; ++j)
+	{
+		PageId nodePageNum;
+		Page *nodePage;
+		allocIndexPage(nodePageNum, nodePage);
+		auto *nodePtr = (NonLeafNode<T> *)nodePage;
+		initNode(nodePtr, level);
+
+		// the smallest key in the subtree is that of the first child
+		parents.push_back({nodePageNum, children[nextChild].key});
+
+		// link the previous node to this one, bounded by the key of its first child
+		if (prevNodePtr != nullptr)
+		{
+			setRightLink(prevNodePtr, nodePageNum, children[nextChild].key);
+			bufMgr->unPinPage(file, prevPageNum, true);
+		}
+
+		// spread the children evenly over the nodes
+		// the key of a child (except the first) separates it from the previous one
+		std::size_t numEntries = children.size() / numNodes + (j < children.size() % numNodes);
+		for (std::size_t i = 0; i < numEntries; ++i)
+		{
+			nodePtr->pageNoArray[i] = children[nextChild].pageNo;
+			if (i > 0)
+			{
+				nodePtr->keyArray[i - 1] = children[nextChild].key;
+			}
+			++nextChild;
+		}
+		nodePtr->numKeys = numEntries - 1;
+
+		prevPageNum = nodePageNum;
+		prevNodePtr = nodePtr;
+	}
+
+	bufMgr->unPinPage(file, prevPageNum, true);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::numPackedPages
+// -----------------------------------------------------------------------------
+
+std::size_t BTreeIndex::numPackedPages(std::size_t numEntries, int capacity, int minEntries)
+{
+	// the number of entries to fill in a page according to the fill factor
+	int target = std::min(capacity, std::max(minEntries, (int)(capacity * fillFactor)));
+
+	// there is always at least one page, possibly empty
+	if (numEntries == 0)
+	{
+		return 1;
+	}
+	return (numEntries + target - 1) / target;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::initNode -- STRING
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::initNode(NonLeafNodeString *nodePtr, int level)
+{
+	nodePtr->level = level;
+	nodePtr->format = INDEX_FORMAT_VERSION;
+	initSlotted(nodePtr);
+	setRightLink(nodePtr, Page::INVALID_NUMBER, StringKey());
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::initLeaf -- STRING
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::initLeaf(LeafNodeString *leafPtr, PageId rightSibPageNo)
+{
+	leafPtr->rightSibPageNo = rightSibPageNo;
+	leafPtr->hasHighKey = 0;
+	leafPtr->format = INDEX_FORMAT_VERSION;
+	initSlotted(leafPtr);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::insertPageKeyPairAux -- STRING
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::insertPageKeyPairAux(NonLeafNodeString *nodePtr, const PageKeyPair<StringKey> &pk, int pos)
+{
+	insertSlotted(nodePtr, pos, pk.key, pk.pageNo);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::insertRIDKeyPairAux -- STRING
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::insertRIDKeyPairAux(LeafNodeString *leafPtr, const RIDKeyPair<StringKey> &rk, int pos)
+{
+	insertSlotted(leafPtr, pos, rk.key, rk.rid);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::eraseRIDKeyPairsAux -- STRING
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::eraseRIDKeyPairsAux(LeafNodeString *leafPtr, int pos, int cnt)
+{
+	eraseSlotted(leafPtr, pos, cnt);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::erasePageKeyPairAux -- STRING
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::erasePageKeyPairAux(NonLeafNodeString *nodePtr, int pos)
+{
+	eraseSlotted(nodePtr, pos, 1);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::isUnderfull -- STRING
+// -----------------------------------------------------------------------------
+
+bool BTreeIndex::isUnderfull(const LeafNodeString *leafPtr)
+{
+	return slottedUsed(leafPtr) < slottedEnd(leafPtr) * UNDERFLOW_FILL_FACTOR;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::isUnderfull -- STRING
+// -----------------------------------------------------------------------------
+
+bool BTreeIndex::isUnderfull(const NonLeafNodeString *nodePtr)
+{
+	return slottedUsed(nodePtr) < slottedEnd(nodePtr) * UNDERFLOW_FILL_FACTOR;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::isMergeSafe -- STRING
+// -----------------------------------------------------------------------------
+
+bool BTreeIndex::isMergeSafe(const LeafNodeString *leafPtr)
+{
+	// an entry takes at most its record ID, key slot and STRINGSIZE characters
+	int entryBytes = sizeof(RecordId) + sizeof(KeySlot) + STRINGSIZE;
+	return deletePolicy == DELETE_LAZY || slottedUsed(leafPtr) - entryBytes >= slottedEnd(leafPtr) * UNDERFLOW_FILL_FACTOR;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::isMergeSafe -- STRING
+// -----------------------------------------------------------------------------
+
+bool BTreeIndex::isMergeSafe(const NonLeafNodeString *nodePtr)
+{
+	// a merge removes a page number, key slot and key, a redistribution shortens a key
+	int entryBytes = sizeof(PageId) + sizeof(KeySlot) + STRINGSIZE;
+	return deletePolicy == DELETE_LAZY || slottedUsed(nodePtr) - entryBytes >= slottedEnd(nodePtr) * UNDERFLOW_FILL_FACTOR;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::rebalanceLeaves -- STRING
+// -----------------------------------------------------------------------------
+
+bool BTreeIndex::rebalanceLeaves(LeafNodeString *leftPtr, LeafNodeString *rightPtr,
+		NonLeafNodeString *parentPtr, int pos)
+{
+	// gather the entries of both leaves
+	int m = leftPtr->numKeys;
+	int n = m + rightPtr->numKeys;
+	std::vector<StringKey> keys;
+	keys.reserve(n);
+	for (int i = 0; i < n; ++i)
+	{
+		keys.push_back(i < m ? nodeKey(leftPtr, i) : nodeKey(rightPtr, i - m));
+	}
+	std::vector<RecordId> rids(leftPtr->ridArray, leftPtr->ridArray + m);
+	rids.insert(rids.end(), rightPtr->ridArray, rightPtr->ridArray + n - m);
+
+	// the left leaf is rewritten in the current format whatever it was in
+	if (filledSlottedSize<LeafNodeString>(keys.data(), n) <= slottedCapacity<LeafNodeString>())
+	{
+		// move all entries to the left leaf, which takes over the right sibling and its high key
+		leftPtr->format = INDEX_FORMAT_VERSION;
+		fillSlotted(leftPtr, keys.data(), n);
+		std::copy(rids.begin(), rids.end(), leftPtr->ridArray);
+		leftPtr->rightSibPageNo = rightPtr->rightSibPageNo;
+		if (hasHighKey(rightPtr))
+		{
+			setHighKey(leftPtr, highKey(rightPtr));
+		}
+		else
+		{
+			clearHighKey(leftPtr);
+		}
+		initSlotted(rightPtr);
+		erasePageKeyPairAux(parentPtr, pos);
+		return true;
+	}
+
+	// the shortest separator between the halves replaces the current one if it fits
+	int st = chooseStringSplit(keys, true);
+	StringKey sep = shortestSeparator(keys[st - 1], keys[st]);
+	if (!replaceSlottedKey(parentPtr, pos, sep))
+	{
+		return false;
+	}
+	leftPtr->format = INDEX_FORMAT_VERSION;
+	fillSlotted(leftPtr, keys.data(), st);
+	std::copy(rids.begin(), rids.begin() + st, leftPtr->ridArray);
+	setHighKey(leftPtr, sep);
+	fillSlotted(rightPtr, &keys[st], n - st);
+	std::copy(rids.begin() + st, rids.end(), rightPtr->ridArray);
+	return false;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::rebalanceNodes -- STRING
+// -----------------------------------------------------------------------------
+
+bool BTreeIndex::rebalanceNodes(NonLeafNodeString *leftPtr, NonLeafNodeString *rightPtr,
+		NonLeafNodeString *parentPtr, int pos)
+{
+	// gather the keys and children of both nodes around the separator pulled down
+	int m = leftPtr->numKeys;
+	int n = m + 1 + rightPtr->numKeys;
+	std::vector<StringKey> keys;
+	keys.reserve(n);
+	for (int i = 0; i < n; ++i)
+	{
+		keys.push_back(i < m ? nodeKey(leftPtr, i) : i == m ? nodeKey(parentPtr, pos) : nodeKey(rightPtr, i - m - 1));
+	}
+	std::vector<PageId> pageNos(leftPtr->pageNoArray, leftPtr->pageNoArray + m + 1);
+	pageNos.insert(pageNos.end(), rightPtr->pageNoArray, rightPtr->pageNoArray + n - m);
+
+	// the left node is rewritten in the current format whatever it was in
+	if (filledSlottedSize<NonLeafNodeString>(keys.data(), n) <= slottedCapacity<NonLeafNodeString>())
+	{
+		// move all keys and children to the left node, which takes over the right link and high key
+		leftPtr->format = INDEX_FORMAT_VERSION;
+		fillSlotted(leftPtr, keys.data(), n);
+		std::copy(pageNos.begin(), pageNos.end(), leftPtr->pageNoArray);
+		setRightLink(leftPtr, rightLink(rightPtr), highKey(rightPtr));
+		initSlotted(rightPtr);
+		erasePageKeyPairAux(parentPtr, pos);
+		return true;
+	}
+
+	// the median replaces the current separator if it fits
+	int mid = chooseStringSplit(keys, false);
+	if (!replaceSlottedKey(parentPtr, pos, keys[mid]))
+	{
+		return false;
+	}
+	leftPtr->format = INDEX_FORMAT_VERSION;
+	fillSlotted(leftPtr, keys.data(), mid);
+	std::copy(pageNos.begin(), pageNos.begin() + mid + 1, leftPtr->pageNoArray);
+	setRightLink(leftPtr, parentPtr->pageNoArray[pos + 1], keys[mid]);
+	fillSlotted(rightPtr, &keys[mid + 1], n - mid - 1);
+	std::copy(pageNos.begin() + mid + 1, pageNos.end(), rightPtr->pageNoArray);
+	return false;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::insertPageKeyPair -- STRING
+// -----------------------------------------------------------------------------
+
+bool BTreeIndex::insertPageKeyPair(NonLeafNodeString *nodePtr, const PageKeyPair<StringKey> &pk1,
+		PageKeyPair<StringKey> &pk2, int pos)
+{
+	int m = nodePtr->numKeys;  // number of keys in the node
+	if (pos < 0)
+	{
+		pos = searchBoundKey<GT>(nodePtr, pk1.key);
+	}
+
+	if (slottedFits(nodePtr, pk1.key))
+	{
+		// the non leaf node is not full
+		insertPageKeyPairAux(nodePtr, pk1, pos);
+		return true;
+	}
+
+	// if full, gather the keys and children counting the inserted ones
+	std::vector<StringKey> keys;
+	std::vector<PageId> pageNos(nodePtr->pageNoArray, nodePtr->pageNoArray + m + 1);
+	keys.reserve(m + 1);
+	for (int i = 0; i < m; ++i)
+	{
+		keys.push_back(nodeKey(nodePtr, i));
+	}
+	keys.insert(keys.begin() + pos, pk1.key);
+	pageNos.insert(pageNos.begin() + pos + 1, pk1.pageNo);
+
+	// the left node keeps the keys before the median and the split node the keys after it
+	// an append to the rightmost node only pushes up its last key
+	bool append = pos == m && m > 1 && nodePtr->format >= INDEX_FORMAT_V6 && !hasHighKey(nodePtr);
+	int mid = append ? m - 1 : chooseStringSplit(keys, false);
+
+	// allocate a newly split page
+	PageId splitPageNum;
+	Page *splitPage;
+	allocIndexPage(splitPageNum, splitPage);
+	auto *splitNodePtr = (NonLeafNodeString *)splitPage;
+	initNode(splitNodePtr, nodePtr->level);
+
+	// the split node takes over the right link and high key
+	int cnt = (int)keys.size() - mid - 1;
+	fillSlotted(splitNodePtr, &keys[mid + 1], cnt);
+	std::copy(pageNos.begin() + mid + 1, pageNos.end(), splitNodePtr->pageNoArray);
+	setRightLink(splitNodePtr, rightLink(nodePtr), highKey(nodePtr));
+
+	// the original node is rewritten in the current format, and linked to the split node
+	// it is bounded by the median pushed up, so the split is complete before the parent is changed
+	nodePtr->format = INDEX_FORMAT_VERSION;
+	fillSlotted(nodePtr, keys.data(), mid);
+	std::copy(pageNos.begin(), pageNos.begin() + mid + 1, nodePtr->pageNoArray);
+	setRightLink(nodePtr, splitPageNum, keys[mid]);
+
+	// push up the median
+	pk2 = {splitPageNum, keys[mid]};
+
+	bufMgr->unPinPage(file, splitPageNum, true);
+	return false;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::insertRIDKeyPair -- STRING
+// -----------------------------------------------------------------------------
+
+bool BTreeIndex::insertRIDKeyPair(LeafNodeString *leafPtr, const RIDKeyPair<StringKey> &rk,
+		PageKeyPair<StringKey> &pk, bool &dirty, const char *included)
+{
+	int m = leafPtr->numKeys;  // number of entries in the leaf
+	int pos;                   // position to insert
+
+	if (insertDuplicateRID(leafPtr, rk, pos))
+	{
+		// the record ID went to a posting list
+		dirty = pos >= 0;
+		return true;
+	}
+	dirty = true;
+
+	if (slottedFits(leafPtr, rk.key))
+	{
+		// the leaf node is not full
+		insertRIDKeyPairAux(leafPtr, rk, pos);
+		return true;
+	}
+
+	// if full, gather the entries counting the inserted one
+	std::vector<StringKey> keys;
+	std::vector<RecordId> rids(leafPtr->ridArray, leafPtr->ridArray + m);
+	keys.reserve(m + 1);
+	for (int i = 0; i < m; ++i)
+	{
+		keys.push_back(nodeKey(leafPtr, i));
+	}
+	keys.insert(keys.begin() + pos, rk.key);
+	rids.insert(rids.begin() + pos, rk.rid);
+
+	// the left leaf keeps the entries before the split position
+	// an append past the last key of the rightmost leaf leaves it as it is, the leaf being in the current format
+	bool append = pos == m && m > 0 && leafPtr->rightSibPageNo == Page::INVALID_NUMBER
+	              && leafPtr->format >= INDEX_FORMAT_V6 && keys[m - 1] < rk.key;
+	int st = append ? m : chooseStringSplit(keys, true);
+
+	// allocate a newly split page
+	PageId splitPageNum;
+	Page *splitPage;
+	allocIndexPage(splitPageNum, splitPage);
+	auto *splitLeafPtr = (LeafNodeString *)splitPage;
+	initLeaf(splitLeafPtr, leafPtr->rightSibPageNo);
+
+	// the split leaf takes over the high key
+	fillSlotted(splitLeafPtr, &keys[st], (int)keys.size() - st);
+	std::copy(rids.begin() + st, rids.end(), splitLeafPtr->ridArray);
+	if (hasHighKey(leafPtr))
+	{
+		setHighKey(splitLeafPtr, highKey(leafPtr));
+	}
+
+	// copy up the shortest key separating the halves
+	pk = {splitPageNum, shortestSeparator(keys[st - 1], keys[st])};
+
+	// the original leaf is rewritten in the current format, and linked to the split leaf
+	// it is bounded by the copied up key, so the split is complete before the parent is changed
+	leafPtr->format = INDEX_FORMAT_VERSION;
+	fillSlotted(leafPtr, keys.data(), st);
+	std::copy(rids.begin(), rids.begin() + st, leafPtr->ridArray);
+	setHighKey(leafPtr, pk.key);
+	leafPtr->rightSibPageNo = splitPageNum;
+
+	bufMgr->unPinPage(file, splitPageNum, true);
+	return false;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::chooseStringSplit
+// -----------------------------------------------------------------------------
+
+int BTreeIndex::chooseStringSplit(const std::vector<StringKey> &keys, bool leaf)
+{
+	int n = keys.size();
+
+	// whether each key equals the previous one, sharing its bytes
+	std::vector<bool> shared(n, false);
+	for (int i = 1; i < n; ++i)
+	{
+		shared[i] = keys[i] == keys[i - 1];
+	}
+
+	// prefix sums of the lengths and of the number of the keys having their own bytes
+	std::vector<int> lengths(n + 1, 0);
+	std::vector<int> distinct(n + 1, 0);
+	for (int i = 0; i < n; ++i)
+	{
+		lengths[i + 1] = lengths[i] + (shared[i] ? 0 : keys[i].length);
+		distinct[i + 1] = distinct[i] + !shared[i];
+	}
+
+	// size of a node holding the keys in [first, last), where the first key has its own bytes
+	auto size = [&](int first, int last)
+	{
+		int cnt = last - first;
+		if (cnt == 0)
+		{
+			return leaf ? slottedSize<LeafNodeString>(0, 0) : slottedSize<NonLeafNodeString>(0, 0);
+		}
+		int p = commonPrefixLength(keys[first].data, keys[first].length, keys[last - 1].data, keys[last - 1].length);
+		int own = shared[first];
+		int keyBytes = p + lengths[last] - lengths[first] + own * keys[first].length
+		               - (distinct[last] - distinct[first] + own) * p;
+		return leaf ? slottedSize<LeafNodeString>(cnt, keyBytes) : slottedSize<NonLeafNodeString>(cnt, keyBytes);
+	};
+
+	// the split leaf starts at the split position, while in a non leaf node the key at it moves up
+	// both halves keep at least one key
+	int lo = 1;
+	int hi = leaf ? n - 1 : n - 2;
+	std::vector<int> larger(hi + 1, 0);
+	for (int i = lo; i <= hi; ++i)
+	{
+		larger[i] = std::max(size(0, i), leaf ? size(i, n) : size(i + 1, n));
+	}
+
+	// a leaf is split between different keys if any such split fits
+	// both halves are written in the current format
+	int capacity = leaf ? slottedCapacity<LeafNodeString>() : slottedCapacity<NonLeafNodeString>();
+	bool between = false;
+	for (int i = lo; i <= hi && leaf; ++i)
+	{
+		between = between || (!shared[i] && larger[i] <= capacity);
+	}
+	auto eligible = [&](int i) { return !between || !shared[i]; };
+
+	int best = capacity + 1;
+	for (int i = lo; i <= hi; ++i)
+	{
+		if (eligible(i))
+		{
+			best = std::min(best, larger[i]);
+		}
+	}
+
+	// among the splits nearly as even as the most even one, push up the shortest key
+	int slack = std::min<int>(best + Page::SIZE / 16, capacity);
+	int split = lo;
+	int splitLength = STRINGSIZE + 1;
+	for (int i = lo; i <= hi; ++i)
+	{
+		if (larger[i] > slack || !eligible(i))
+		{
+			continue;
+		}
+		int length = leaf ? shortestSeparator(keys[i - 1], keys[i]).length : keys[i].length;
+		if (length < splitLength || (length == splitLength && larger[i] < larger[split]))
+		{
+			split = i;
+			splitLength = length;
+		}
+	}
+	return split;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::packLeaves -- STRING
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::packLeaves(std::size_t numPairs, const std::vector<std::vector<RIDKeyPair<StringKey>>> &runs,
+		const std::vector<std::string> &runNames, const std::vector<IncludedValues> &included,
+		std::vector<PageKeyPair<StringKey>> &children)
+{
+	SortedPairs<StringKey> sorted(runs, runNames);
+
+	// the number of bytes to fill in a leaf according to the fill factor
+	int capacity = slottedCapacity<LeafNodeString>();
+	int target = std::min<int>(capacity, capacity * fillFactor);
+
+	// the previous leaf is kept pinned until its right sibling is known
+	PageId prevPageNum = Page::INVALID_NUMBER;
+	LeafNodeString *prevLeafPtr = nullptr;
+	StringKey prevKey;  // last key of the previous leaf
+
+	// the entries of the next key, taken but not packed yet
+	std::vector<RIDKeyPair<StringKey>> group;
+
+	std::vector<StringKey> keys;
+	std::vector<RecordId> rids;
+	do
+	{
+		// take the keys while the leaf is within the target, and at least one
+		// the entries of a key are never split, and share the bytes of the key
+		keys.clear();
+		rids.clear();
+		int keyLengths = 0;
+		int numDistinct = 0;
+		while (true)
+		{
+			if (group.empty() && !sorted.empty())
+			{
+				takeKeyGroup(sorted, group);
+			}
+			if (group.empty())
+			{
+				break;
+			}
+			const StringKey &key = group[0].key;
+			int cnt = keys.size() + group.size();
+			int p = keys.empty() ? key.length : commonPrefixLength(keys[0].data, keys[0].length, key.data, key.length);
+			if (!keys.empty()
+					&& slottedSize<LeafNodeString>(cnt, p + keyLengths + key.length - (numDistinct + 1) * p) > target)
+			{
+				break;
+			}
+			for (const RIDKeyPair<StringKey> &rk : group)
+			{
+				keys.push_back(rk.key);
+				rids.push_back(rk.rid);
+			}
+			keyLengths += key.length;
+			++numDistinct;
+			group.clear();
+		}
+
+		PageId leafPageNum;
+		Page *leafPage;
+		allocIndexPage(leafPageNum, leafPage);
+		auto *leafPtr = (LeafNodeString *)leafPage;
+		initLeaf(leafPtr, Page::INVALID_NUMBER);
+
+		fillSlotted(leafPtr, keys.data(), keys.size());
+		std::copy(rids.begin(), rids.end(), leafPtr->ridArray);
+
+		// the shortest key separating the leaf from the left sibling
+		if (keys.empty())
+		{
+			children.push_back({leafPageNum, StringKey()});
+		}
+		else
+		{
+			children.push_back({leafPageNum, children.empty() ? keys[0] : shortestSeparator(prevKey, keys[0])});
+			prevKey = keys.back();
+		}
+
+		// link the previous leaf to this one, bounded by the separator
+		if (prevLeafPtr != nullptr)
+		{
+			prevLeafPtr->rightSibPageNo = leafPageNum;
+			setHighKey(prevLeafPtr, children.back().key);
+			bufMgr->unPinPage(file, prevPageNum, true);
+		}
+
+		prevPageNum = leafPageNum;
+		prevLeafPtr = leafPtr;
+	}
+	while (!group.empty());
+
+	bufMgr->unPinPage(file, prevPageNum, true);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::packNonLeaves -- STRING
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::packNonLeaves(const std::vector<PageKeyPair<StringKey>> &children, int level,
+		std::vector<PageKeyPair<StringKey>> &parents)
+{
+	// the number of bytes to fill in a node according to the fill factor
+	int capacity = slottedCapacity<NonLeafNodeString>();
+	int target = std::min<int>(capacity, capacity * fillFactor);
+
+	// find the first child of each node
+	// the key of a child (except the first) separates it from the previous one
+	std::vector<std::size_t> starts;
+	std::size_t start = 0;
+	while (start < children.size())
+	{
+		std::size_t end = start + 1;
+		int keyLengths = 0;
+		while (end < children.size())
+		{
+			// a non leaf node should have at least two children if possible
+			const StringKey &key = children[end].key;
+			const StringKey &firstKey = children[start + 1].key;
+			int cnt = end - start;
+			int p = commonPrefixLength(firstKey.data, firstKey.length, key.data, key.length);
+			if (cnt > 1 && slottedSize<NonLeafNodeString>(cnt, p + keyLengths + key.length - cnt * p) > target)
+			{
+				break;
+			}
+			keyLengths += key.length;
+			++end;
+		}
+		starts.push_back(start);
+		start = end;
+	}
+
+	// a last node with a single child takes one from the previous node, or joins it if it has only two
+	std::size_t numNodes = starts.size();
+	if (numNodes > 1 && children.size() - starts[numNodes - 1] == 1)
+	{
+		if (starts[numNodes - 1] - starts[numNodes - 2] == 2)
+		{
+			starts.pop_back();
+		}
+		else
+		{
+			--starts.back();
+		}
+	}
+	starts.push_back(children.size());
+
+	// the previous node is kept pinned until its right link is known
+	PageId prevPageNum = Page::INVALID_NUMBER;
+	NonLeafNodeString *prevNodePtr = nullptr;
+
+	std::vector<StringKey> keys;
+	for (std::size_t j = 0; j + 1 < starts.size(); ++j)
+	{
+		PageId nodePageNum;
+		Page *nodePage;
+		allocIndexPage(nodePageNum, nodePage);
+		auto *nodePtr = (NonLeafNodeString *)nodePage;
+		initNode(nodePtr, level);
+
+		// the first key in the subtree is that of the first child
+		parents.push_back({nodePageNum, children[starts[j]].key});
+
+		// link the previous node to this one, bounded by the key of its first child
+		if (prevNodePtr != nullptr)
+		{
+			setRightLink(prevNodePtr, nodePageNum, children[starts[j]].key);
+			bufMgr->unPinPage(file, prevPageNum, true);
+		}
+
+		keys.clear();
+		for (std::size_t i = starts[j]; i < starts[j + 1]; ++i)
+		{
+			nodePtr->pageNoArray[i - starts[j]] = children[i].pageNo;
+			if (i > starts[j])
+			{
+				keys.push_back(children[i].key);
+			}
+		}
+		fillSlotted(nodePtr, keys.data(), keys.size());
+
+		prevPageNum = nodePageNum;
+		prevNodePtr = nodePtr;
+	}
+
+	bufMgr->unPinPage(file, prevPageNum, true);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeCursor::BTreeCursor -- Constructor
+// -----------------------------------------------------------------------------
+
+BTreeCursor::BTreeCursor(BTreeIndex *indexIn)
+		: index(indexIn)
+		, scanExecuting(false)
+		, nextEntry(-1)
+		, endEntry(0)
+		, currentPageNum(Page::INVALID_NUMBER)
+		, currentPageData(nullptr)
+		, currentRidArray(nullptr)
+		, postingPageNum(Page::INVALID_NUMBER)
+		, postingPtr(nullptr)
+		, nextPosting(0)
+		, leafVersion(0)
+		, readAheadPageNum(Page::INVALID_NUMBER)
+		, readAheadSlot(0)
+		, readAheadDepth(READ_AHEAD_MIN_LEAVES)
+		, readAheadPending(0)
+		, deltaPos(0)
+		, hasMerged(false)
+		, nextMergedFn(&BTreeCursor::nextMergedAux<int>)
+		, updateScanEntryFn(&BTreeCursor::updateScanEntryAux<int, LT>)
+		, pauseFn(&BTreeCursor::pauseAux<int>)
+		, reseekFn(&BTreeCursor::reseekAux<int, LT>)
+		, backward(false)
+		, backwardPos(0)
+		, backwardDone(true)
+		, fillBackwardFn(&BTreeCursor::fillBackwardAux<int, GTE>)
+		, scanLimit(SCAN_NO_LIMIT)
+{
+}
+
+// -----------------------------------------------------------------------------
+// BTreeCursor::~BTreeCursor -- destructor
+// -----------------------------------------------------------------------------
+
+BTreeCursor::~BTreeCursor()
+{
+	// end the last scanning
+	if (scanExecuting)
+	{
+		endScan();
+	}
+}
+
+// -----------------------------------------------------------------------------
+// BTreeCursor::startScan
+// -----------------------------------------------------------------------------
+
+void BTreeCursor::startScan(const void* lowValParm,
+				   const Operator lowOpParm,
+				   const void* highValParm,
+				   const Operator highOpParm,
+				   const ScanDirection direction,
+				   std::size_t offset,
+				   std::size_t limit)
+{
+	OpTimer timer(index->activeMetrics(), OP_START_SCAN);
+
+	// throw an exception if the opcodes are bad
+	if ((lowOpParm != GT && lowOpParm != GTE)
+	    || (highOpParm != LT && highOpParm != LTE)
+	    || (direction != SCAN_FORWARD && direction != SCAN_BACKWARD))
+	{
+		throw BadOpcodesException();
+	}
+
+	// specialize the rest of the scan on the key type
+	switch (index->attributeType)
+	{
+	case INTEGER:
+		startScanTyped<int>(lowValParm, lowOpParm, highValParm, highOpParm, direction);
+		break;
+	case DOUBLE:
+		startScanTyped<double>(lowValParm, lowOpParm, highValParm, highOpParm, direction);
+		break;
+	case STRING:
+		startScanTyped<StringKey>(lowValParm, lowOpParm, highValParm, highOpParm, direction);
+		break;
+	}
+
+	// the entries before the offset are skipped a leaf at a time, reading ahead the leaves up to the limit
+	scanLimit = offset > SCAN_NO_LIMIT - limit ? SCAN_NO_LIMIT : offset + limit;
+	if (offset > 0 && nextBatch(nullptr, offset) < offset)
+	{
+		throw NoSuchKeyFoundException();
+	}
+	scanLimit = limit;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeCursor::startScanTyped
+// -----------------------------------------------------------------------------
+
+template <class T>
+void BTreeCursor::startScanTyped(const void* lowValParm,
+				   const Operator lowOpParm,
+				   const void* highValParm,
+				   const Operator highOpParm,
+				   const ScanDirection direction)
+{
+	T lowKey, highKey;
+	index->readKey(lowValParm, lowKey);
+	index->readKey(highValParm, highKey);
+
+	// throw an exception if the search range is bad
+	if (highKey < lowKey)
+	{
+		throw BadScanrangeException();
+	}
+
+	// end the last scan
+	if (scanExecuting)
+	{
+		endScan();
+	}
+
+	// the buffered entries of the range are applied for the scan to see them
+	// while those of a delta index are taken to be merged with the entries of the tree
+	// a backward scan applies those of a delta index as well, the merge only going forward
+	delta.reset();
+	if (index->insertBuffer != nullptr && index->deltaMode && direction == SCAN_FORWARD)
+	{
+		std::lock_guard<std::mutex> lock(index->insertBufferMutex);
+		index->mergeBufferRuns<T>(true);
+		auto *buffer = static_cast<InsertBuffer<T> *>(index->insertBuffer.get());
+		auto *entries = new InsertBuffer<T>();
+		delta.reset(entries);
+		for (std::size_t i = 0; i < buffer->entries.size(); ++i)
+		{
+			const T &key = buffer->entries[i].key;
+			if ((lowOpParm == GT ? lowKey < key : !(key < lowKey))
+			    && (highOpParm == LT ? key < highKey : !(highKey < key)))
+			{
+				entries->entries.push_back(buffer->entries[i]);
+				entries->ops.push_back(buffer->ops[i]);
+			}
+		}
+		deltaPos = 0;
+		nextMergedFn = &BTreeCursor::nextMergedAux<T>;
+	}
+	else if (index->insertBuffer != nullptr)
+	{
+		index->flushBuffered(&lowKey, &highKey);
+	}
+
+	// set the scanning information
+	// the limit is that of the entries skipped and returned, unknown yet
+	scanExecuting = true;
+	scanLimit = SCAN_NO_LIMIT;
+	setScanBounds(lowKey, highKey);
+	lowOp = lowOpParm;
+	highOp = highOpParm;
+	backward = direction == SCAN_BACKWARD;
+
+	// a backward scan reads its first leaf now, so that it fails to start if there is no entry
+	// the entries of the high key are less than the largest record ID, or than none
+	if (backward)
+	{
+		resumeRid = highOp == LTE ? RecordId{(PageId)UINT_MAX, (SlotId)USHRT_MAX, 0} : RecordId{0, 0, 0};
+		fillBackwardFn = lowOp == GT ? &BTreeCursor::fillBackwardAux<T, GT> : &BTreeCursor::fillBackwardAux<T, GTE>;
+		backwardDone = false;
+		(this->*fillBackwardFn)();
+		if (backwardRids.empty())
+		{
+			throw NoSuchKeyFoundException();
+		}
+		return;
+	}
+	
+	// specialize the rest of the scan on the operators
+	// with a delta, the range may hold no entry of the tree and some of the delta
+	try
+	{
+		if (lowOp == GT)
+		{
+			highOp == LT ? startScanAux<T, GT, LT>() : startScanAux<T, GT, LTE>();
+		}
+		else
+		{
+			highOp == LT ? startScanAux<T, GTE, LT>() : startScanAux<T, GTE, LTE>();
+		}
+	}
+	catch (const NoSuchKeyFoundException &)
+	{
+		if (delta == nullptr)
+		{
+			throw;
+		}
+	}
+
+	// the first entry of a merged scan is found ahead, so that the scan fails to start if there is none
+	if (delta != nullptr)
+	{
+		hasMerged = nextMergedAux<T>(mergedRid);
+		if (!hasMerged)
+		{
+			throw NoSuchKeyFoundException();
+		}
+	}
+}
+
+// -----------------------------------------------------------------------------
+// BTreeCursor::startScanAux
+// -----------------------------------------------------------------------------
+
+template <class T, Operator lowOpT, Operator highOpT>
+void BTreeCursor::startScanAux()
+{
+	updateScanEntryFn = &BTreeCursor::updateScanEntryAux<T, highOpT>;
+	pauseFn = &BTreeCursor::pauseAux<T>;
+	reseekFn = &BTreeCursor::reseekAux<T, highOpT>;
+
+	T lowKey, highKey;
+	getScanBounds(lowKey, highKey);
+
+	// find the leftmost entry with a key that lies within the search bound
+	// the starting page possibly having the first entry is latched
+	// the leaves after it are read ahead from its parent
+	bool bounded;
+	T upperBound;
+	DescentStack path;
+	currentPageNum = index->findLeafPageNum<lowOpT>(lowKey, currentPageData, bounded, upperBound, false, &path);
+	readAheadPageNum = path.size > 0 ? path.pageNo[path.size - 1] : Page::INVALID_NUMBER;
+	readAheadSlot = path.size > 0 ? path.slot[path.size - 1] + 1 : 0;
+	readAheadDepth = READ_AHEAD_MIN_LEAVES;
+	readAheadPending = 0;
+
+	if (currentPageNum != Page::INVALID_NUMBER) {
+		auto *curLeafPtr = (LeafNode<T> *)currentPageData;
+		currentRidArray = leafRids(curLeafPtr, packedRids);
+
+		// skip the entries below the low bound, which can only lie in the starting page
+		// since the upper bounds of the pages before it are not within the low bound
+		// this will be incremented later
+		nextEntry = searchBoundKey<lowOpT>(curLeafPtr, lowKey) - 1;
+		endEntry = searchBoundKey<highOpT>(curLeafPtr, highKey);
+
+		// find the actual current page and first entry
+		// the starting page will be unpinned unless it is what we found
+		if (updateScanEntryAux<T, highOpT>())
+		{
+			// return if found
+			openPosting();
+			pause();
+			return;
+		}
+	}
+	
+	// throw an exception if no such entry is found
+	throw NoSuchKeyFoundException();
+}
+
+// -----------------------------------------------------------------------------
+// BTreeCursor::fillBackwardAux
+// -----------------------------------------------------------------------------
+
+template <class T, Operator lowOpT>
+void BTreeCursor::fillBackwardAux()
+{
+	backwardRids.clear();
+	backwardPos = 0;
+	while (backwardRids.empty() && !backwardDone)
+	{
+		T lowKey, highKey;
+		getScanBounds(lowKey, highKey);
+		auto belowHigh = [&](const T &key, const RecordId &rid) {
+			return key < highKey || (key == highKey && rid < resumeRid);
+		};
+
+		// the leftmost leaf that may hold the high key
+		// then the right siblings starting with entries of it less than the cutoff
+		bool bounded;
+		T upperBound;
+		DescentStack path;
+		Page *page;
+		PageId pageNum = index->findLeafPageNum<GTE>(highKey, page, bounded, upperBound, false, &path);
+		if (pageNum == Page::INVALID_NUMBER)
+		{
+			backwardDone = true;
+			return;
+		}
+		const PageId descentPageNum = pageNum;
+		auto *leafPtr = (LeafNode<T> *)page;
+		while (leafPtr->rightSibPageNo != Page::INVALID_NUMBER)
+		{
+			PageId nxtPageNum = leafPtr->rightSibPageNo;
+			Page *nxtPage;
+			index->readLeafShared(nxtPageNum, nxtPage);
+			auto *nxtLeafPtr = (LeafNode<T> *)nxtPage;
+			if (nxtLeafPtr->numKeys == 0 || !belowHigh(nodeKey(nxtLeafPtr, 0), leafRid(nxtLeafPtr, 0)))
+			{
+				index->releaseLeafShared(nxtPageNum, nxtPage);
+				break;
+			}
+			index->releaseLeafShared(pageNum, page);
+			pageNum = nxtPageNum;
+			page = nxtPage;
+			leafPtr = nxtLeafPtr;
+		}
+
+		// the entries less than the cutoff and within the low bound, from the last one
+		const RecordId *ridArray = leafRids(leafPtr, packedRids);
+		int end = searchBoundKey<GTE>(leafPtr, highKey);
+		while (end < leafPtr->numKeys && nodeKey(leafPtr, end) == highKey && ridArray[end] < resumeRid)
+		{
+			++end;
+		}
+		int start = searchBoundKey<lowOpT>(leafPtr, lowKey);
+		for (int i = end - 1; i >= start; --i)
+		{
+			if (!isPostingRef(ridArray[i]))
+			{
+				backwardRids.push_back(ridArray[i]);
+				continue;
+			}
+
+			// a posting list is read forward, and its record IDs taken in reverse
+			std::size_t first = backwardRids.size();
+			for (PageId postingNum = ridArray[i].page_number; postingNum != Page::INVALID_NUMBER; )
+			{
+				Page *postingPage;
+				index->readIndexPage(postingNum, postingPage);
+				auto *postingPtr = (PostingPage *)postingPage;
+				backwardRids.insert(backwardRids.end(), postingPtr->ridArray, postingPtr->ridArray + postingPtr->numRids);
+				PageId nxtPostingNum = postingPtr->nextPageNo;
+				index->releaseIndexPage(postingNum);
+				postingNum = nxtPostingNum;
+			}
+			std::reverse(backwardRids.begin() + first, backwardRids.end());
+		}
+
+		if (start > 0)
+		{
+			// the entries before lie below the low bound, and so do the leaves before
+			backwardDone = true;
+		}
+		else if (end > 0)
+		{
+			// the scan goes on with the entries less than the first one of the leaf
+			setScanBounds(lowKey, nodeKey(leafPtr, 0));
+			resumeRid = ridArray[0];
+		}
+		else
+		{
+			// no entry of the leaf is less, the leaf before it is that of the keys up to the separator key
+			// the descent went right of, in the deepest node it did not take the first child of
+			int d = path.size - 1;
+			while (d >= 0 && path.slot[d] == 0)
+			{
+				--d;
+			}
+			index->releaseLeafShared(pageNum, page);
+			if (d < 0)
+			{
+				backwardDone = true;
+				return;
+			}
+
+			// the separator key is used if the node still links the child the descent went into
+			// which keeps it less than the high key, otherwise the descent is made again
+			Page *nodePage;
+			index->readNodeShared(path.pageNo[d], nodePage);
+			auto *nodePtr = (NonLeafNode<T> *)nodePage;
+			PageId childNum = d + 1 < path.size ? path.pageNo[d + 1] : descentPageNum;
+			int slot = path.slot[d];
+			if (slot <= nodePtr->numKeys && nodePtr->pageNoArray[slot] == childNum)
+			{
+				T sepKey = nodeKey(nodePtr, slot - 1);
+				if (lowOpT == GT ? !(lowKey < sepKey) : sepKey < lowKey)
+				{
+					backwardDone = true;
+				}
+				setScanBounds(lowKey, sepKey);
+				resumeRid = RecordId{(PageId)UINT_MAX, (SlotId)USHRT_MAX, 0};
+			}
+			index->releaseLeafShared(path.pageNo[d], nodePage);
+			continue;
+		}
+		index->releaseLeafShared(pageNum, page);
+	}
+}
+
+// -----------------------------------------------------------------------------
+// BTreeCursor::nextBackward
+// -----------------------------------------------------------------------------
+
+bool BTreeCursor::nextBackward(RecordId &outRid)
+{
+	while (backwardPos == backwardRids.size())
+	{
+		if (backwardDone)
+		{
+			return false;
+		}
+		(this->*fillBackwardFn)();
+	}
+	outRid = backwardRids[backwardPos++];
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeCursor::setScanBounds
+// -----------------------------------------------------------------------------
+
+void BTreeCursor::setScanBounds(const int &lowKey, const int &highKey)
+{
+	lowValInt = lowKey;
+	highValInt = highKey;
+}
+
+void BTreeCursor::setScanBounds(const double &lowKey, const double &highKey)
+{
+	lowValDouble = lowKey;
+	highValDouble = highKey;
+}
+
+void BTreeCursor::setScanBounds(const StringKey &lowKey, const StringKey &highKey)
+{
+	lowValString.assign(lowKey.data, lowKey.length);
+	highValString.assign(highKey.data, highKey.length);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeCursor::getScanBounds
+// -----------------------------------------------------------------------------
+
+void BTreeCursor::getScanBounds(int &lowKey, int &highKey) const
+{
+	lowKey = lowValInt;
+	highKey = highValInt;
+}
+
+void BTreeCursor::getScanBounds(double &lowKey, double &highKey) const
+{
+	lowKey = lowValDouble;
+	highKey = highValDouble;
+}
+
+void BTreeCursor::getScanBounds(StringKey &lowKey, StringKey &highKey) const
+{
+	lowKey.length = lowValString.size();
+	memcpy(lowKey.data, lowValString.data(), lowKey.length);
+	highKey.length = highValString.size();
+	memcpy(highKey.data, highValString.data(), highKey.length);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeCursor::scanNext
+// -----------------------------------------------------------------------------
+
+void BTreeCursor::scanNext(RecordId& outRid) 
+{
+	OpTimer timer(index->activeMetrics(), OP_SCAN_NEXT);
+
+	// throw an exception if no scan has been initialized
+	if (!scanExecuting)
+	{
+		throw ScanNotInitializedException();
+	}
+
+	// the scan is completed once it has returned as many entries as its limit
+	if (scanLimit == 0)
+	{
+		throw IndexScanCompletedException();
+	}
+	--scanLimit;
+
+	// a merged scan returns the entry found ahead and finds the next one
+	if (delta != nullptr)
+	{
+		if (!hasMerged)
+		{
+			throw IndexScanCompletedException();
+		}
+		outRid = mergedRid;
+		hasMerged = (this->*nextMergedFn)(mergedRid);
+		return;
+	}
+	if (backward)
+	{
+		if (!nextBackward(outRid))
+		{
+			throw IndexScanCompletedException();
+		}
+		return;
+	}
+
+	// throw an exception if no more satisfying record
+	// the entries left may have been deleted since the last call
+	resume();
+	if (nextEntry == -1)
+	{
+		throw IndexScanCompletedException();
+	}
+
+	// return the next record ID via reference
+	outRid = postingPageNum != Page::INVALID_NUMBER ? postingPtr->ridArray[nextPosting] : currentRidArray[nextEntry];
+
+	// update the next record
+	advance();
+	pause();
+}
+
+// -----------------------------------------------------------------------------
+// BTreeCursor::scanNextBatch
+// -----------------------------------------------------------------------------
+
+std::size_t BTreeCursor::scanNextBatch(RecordId* out, std::size_t max)
+{
+	// throw an exception if no scan has been initialized
+	if (!scanExecuting)
+	{
+		throw ScanNotInitializedException();
+	}
+
+	std::size_t count = nextBatch(out, std::min(max, scanLimit));
+	scanLimit -= count;
+	return count;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeCursor::scanSkip
+// -----------------------------------------------------------------------------
+
+std::size_t BTreeCursor::scanSkip(std::size_t n)
+{
+	// throw an exception if no scan has been initialized
+	if (!scanExecuting)
+	{
+		throw ScanNotInitializedException();
+	}
+
+	std::size_t count = nextBatch(nullptr, std::min(n, scanLimit));
+	scanLimit -= count;
+	return count;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeCursor::nextBatch
+// -----------------------------------------------------------------------------
+
+std::size_t BTreeCursor::nextBatch(RecordId* out, std::size_t max)
+{
+	std::size_t count = 0;
+	if (delta != nullptr)
+	{
+		for (; count < max && hasMerged; ++count)
+		{
+			if (out != nullptr)
+			{
+				out[count] = mergedRid;
+			}
+			hasMerged = (this->*nextMergedFn)(mergedRid);
+		}
+		return count;
+	}
+	if (backward)
+	{
+		// the record IDs of each leaf read are taken at once
+		while (count < max && (backwardPos < backwardRids.size() || !backwardDone))
+		{
+			if (backwardPos == backwardRids.size())
+			{
+				(this->*fillBackwardFn)();
+				continue;
+			}
+			std::size_t n = std::min(backwardRids.size() - backwardPos, max - count);
+			if (out != nullptr)
+			{
+				std::copy(backwardRids.begin() + backwardPos, backwardRids.begin() + backwardPos + n, out + count);
+			}
+			backwardPos += n;
+			count += n;
+		}
+		return count;
+	}
+
+	resume();
+	while (count < max && nextEntry != -1)
+	{
+		std::size_t n = 0;
+		if (postingPageNum != Page::INVALID_NUMBER)
+		{
+			// the record IDs of the posting page from the next one
+			n = std::min((std::size_t)(postingPtr->numRids - nextPosting), max - count);
+			if (out != nullptr)
+			{
+				std::copy(postingPtr->ridArray + nextPosting, postingPtr->ridArray + nextPosting + n, out + count);
+			}
+			nextPosting += (int)n - 1;
+		}
+		else
+		{
+			// the entries from the next one up to the high bound all qualify
+			// up to an entry referring to a posting list
+			std::size_t limit = std::min((std::size_t)(endEntry - nextEntry), max - count);
+			while (n < limit && !isPostingRef(currentRidArray[nextEntry + n]))
+			{
+				++n;
+			}
+			if (out != nullptr)
+			{
+				std::copy(currentRidArray + nextEntry, currentRidArray + nextEntry + n, out + count);
+			}
+			nextEntry += (int)n - 1;
+		}
+		count += n;
+
+		// move to the last record ID copied, then update to the next one
+		// which either lies in the next posting page, on the right sibling page or ends the scan
+		advance();
+	}
+	pause();
+	return count;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeCursor::scanNextIncluded
+// -----------------------------------------------------------------------------
+
+void BTreeCursor::scanNextIncluded(RecordId& outRid, void* key, void* included)
+{
+	// throw an exception if no scan has been initialized
+	if (!scanExecuting)
+	{
+		throw ScanNotInitializedException();
+	}
+
+	// the leaves read by a backward scan are not kept
+	if (backward)
+	{
+		throw BadOpcodesException();
+	}
+
+	// throw an exception if no more satisfying record
+	if (scanLimit == 0)
+	{
+		throw IndexScanCompletedException();
+	}
+	resume();
+	if (nextEntry == -1)
+	{
+		throw IndexScanCompletedException();
+	}
+	--scanLimit;
+
+	// the key array starts the leaf, and the included values follow the record IDs
+	// the entries of a covering index never refer to a posting list
+	std::size_t keySize = index->attributeType == INTEGER ? sizeof(int) : sizeof(double);
+	memcpy(key, (const char *)currentPageData + nextEntry * keySize, keySize);
+	memcpy(included, index->includedValues(currentPageData, nextEntry), index->includedWidth);
+	outRid = postingPageNum != Page::INVALID_NUMBER ? postingPtr->ridArray[nextPosting] : currentRidArray[nextEntry];
+
+	// update the next record
+	advance();
+	pause();
+}
+
+// -----------------------------------------------------------------------------
+// BTreeCursor::scanNextKey
+// -----------------------------------------------------------------------------
+
+void BTreeCursor::scanNextKey(RecordId& outRid, void* key)
+{
+	// throw an exception if no scan has been initialized
+	if (!scanExecuting)
+	{
+		throw ScanNotInitializedException();
+	}
+
+	// the entries of a backward or merged scan are not read from the current leaf
+	if (backward || delta != nullptr)
+	{
+		throw BadOpcodesException();
+	}
+
+	// throw an exception if no more satisfying record
+	if (scanLimit == 0)
+	{
+		throw IndexScanCompletedException();
+	}
+	resume();
+	if (nextEntry == -1)
+	{
+		throw IndexScanCompletedException();
+	}
+	--scanLimit;
+
+	// an entry referring to a posting list has the key of its records
+	switch (index->attributeType)
+	{
+	case INTEGER:
+	{
+		int keyT = nodeKey((const LeafNode<int> *)currentPageData, nextEntry);
+		memcpy(key, &keyT, sizeof(keyT));
+		break;
+	}
+	case DOUBLE:
+	{
+		double keyT = nodeKey((const LeafNode<double> *)currentPageData, nextEntry);
+		memcpy(key, &keyT, sizeof(keyT));
+		break;
+	}
+	case STRING:
+	{
+		StringKey keyT = nodeKey((const LeafNode<StringKey> *)currentPageData, nextEntry);
+		memcpy(key, keyT.data, keyT.length);
+		((char *)key)[keyT.length] = 0;
+		break;
+	}
+	}
+	outRid = postingPageNum != Page::INVALID_NUMBER ? postingPtr->ridArray[nextPosting] : currentRidArray[nextEntry];
+
+	// update the next record
+	advance();
+	pause();
+}
+
+// -----------------------------------------------------------------------------
+// BTreeCursor::scanToBitmap
+// -----------------------------------------------------------------------------
+
+std::size_t BTreeCursor::scanToBitmap(RidBitmap& out)
+{
+	// the record IDs are taken a batch at a time, in key order
+	RecordId rids[256];
+	std::size_t count = 0;
+	std::size_t n;
+	while ((n = scanNextBatch(rids, 256)) > 0)
+	{
+		for (std::size_t i = 0; i < n; ++i)
+		{
+			out.add(rids[i]);
+		}
+		count += n;
+	}
+	return count;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeCursor::endScan
+// -----------------------------------------------------------------------------
+//
+void BTreeCursor::endScan() 
+{
+	// throw an exception if no scan has been initialized.
+	if (!scanExecuting)
+	{
+		throw ScanNotInitializedException();
+	}
+
+	// unpin without modification
+	// the leaf is not latched between calls
+	if (currentPageNum != Page::INVALID_NUMBER)
+	{
+		index->releaseIndexPage(currentPageNum);
+	}
+	if (postingPageNum != Page::INVALID_NUMBER)
+	{
+		index->releaseIndexPage(postingPageNum);
+	}
+
+	// reset correspondingly
+	scanExecuting = false;
+	delta.reset();
+	hasMerged = false;
+	backward = false;
+	backwardRids.clear();
+	backwardPos = 0;
+	backwardDone = true;
+	nextEntry = -1;
+	currentPageNum = Page::INVALID_NUMBER;
+	currentPageData = nullptr;
+	currentRidArray = nullptr;
+	postingPageNum = Page::INVALID_NUMBER;
+	postingPtr = nullptr;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeCursor::openPosting
+// -----------------------------------------------------------------------------
+
+void BTreeCursor::openPosting()
+{
+	const RecordId &rid = currentRidArray[nextEntry];
+	if (isPostingRef(rid))
+	{
+		Page *page;
+		postingPageNum = rid.page_number;
+		index->readIndexPage(postingPageNum, page);
+		postingPtr = (PostingPage *)page;
+		nextPosting = 0;
+	}
+}
+
+// -----------------------------------------------------------------------------
+// BTreeCursor::advance
+// -----------------------------------------------------------------------------
+
+bool BTreeCursor::advance()
+{
+	// the rest of the posting list comes before the next entry
+	if (postingPageNum != Page::INVALID_NUMBER)
+	{
+		if (++nextPosting < postingPtr->numRids)
+		{
+			return true;
+		}
+
+		// unpin and change the page to the next posting page if any
+		PageId nxtPageNum = postingPtr->nextPageNo;
+		index->releaseIndexPage(postingPageNum);
+		postingPageNum = nxtPageNum;
+		postingPtr = nullptr;
+		if (postingPageNum != Page::INVALID_NUMBER)
+		{
+			Page *page;
+			index->readIndexPage(postingPageNum, page);
+			postingPtr = (PostingPage *)page;
+			nextPosting = 0;
+			return true;
+		}
+	}
+
+	if (!updateScanEntry())
+	{
+		return false;
+	}
+	openPosting();
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeCursor::nextMergedAux
+// -----------------------------------------------------------------------------
+
+template <class T>
+bool BTreeCursor::nextMergedAux(RecordId &outRid)
+{
+	auto *entries = static_cast<InsertBuffer<T> *>(delta.get());
+	while (true)
+	{
+		resume();
+		bool inDelta = deltaPos < entries->entries.size();
+		if (nextEntry == -1 && !inDelta)
+		{
+			return false;
+		}
+
+		// the next entry of the tree, unless the delta has one before it
+		RIDKeyPair<T> current;
+		if (nextEntry != -1)
+		{
+			current.key = nodeKey((LeafNode<T> *)currentPageData, nextEntry);
+			current.rid = postingPageNum != Page::INVALID_NUMBER ? postingPtr->ridArray[nextPosting] : currentRidArray[nextEntry];
+			if (!inDelta || current < entries->entries[deltaPos])
+			{
+				outRid = current.rid;
+				advance();
+				pause();
+				return true;
+			}
+		}
+
+		// the entry of the delta replaces that of the tree if equal, and is skipped if a deletion
+		const RIDKeyPair<T> &entry = entries->entries[deltaPos];
+		std::uint8_t op = entries->ops[deltaPos++];
+		if (nextEntry != -1 && !(entry < current))
+		{
+			advance();
+		}
+		pause();
+		if (op & DELTA_INSERT)
+		{
+			outRid = entry.rid;
+			return true;
+		}
+	}
+}
+
+// -----------------------------------------------------------------------------
+// BTreeCursor::updateScanEntryAux
+// -----------------------------------------------------------------------------
+
+template <class T, Operator highOpT>
+bool BTreeCursor::updateScanEntryAux()
+{
+	auto *curLeafPtr = (LeafNode<T> *)currentPageData;
+
+	++nextEntry;
+
+	// check if past the high bound in the current page
+	while (nextEntry >= endEntry)
+	{
+		// break if the high bound lies within the current page
+		// since the next key is too large, or if at the end of all leaves
+		if (endEntry < curLeafPtr->numKeys || curLeafPtr->rightSibPageNo == Page::INVALID_NUMBER)
+		{
+			// not found
+			// release the current page and reset information correspondingly
+			index->releaseLeafShared(currentPageNum, currentPageData);
+			currentPageNum = Page::INVALID_NUMBER;
+			currentPageData = nullptr;
+			currentRidArray = nullptr;
+			nextEntry = -1;
+			return false;
+		}
+
+		// read the next batch of leaves ahead once the scan has reached those of the last one
+		// and as long as the limit of the scan lies past the next leaf, guessing it to be as full as this one
+		std::size_t leafEntries = std::max<int>(curLeafPtr->numKeys, 1);
+		if (readAheadPending == 0 && scanLimit > leafEntries)
+		{
+			readAheadAux<T, highOpT>(scanLimit / leafEntries + 1);
+		}
+		if (readAheadPending > 0)
+		{
+			--readAheadPending;
+		}
+
+		// change the page to the right sibling page
+		// it is latched before the current page is released, which keeps it linked
+		PageId nxtPageNum = curLeafPtr->rightSibPageNo;
+		Page *nxtPage;
+		index->readLeafShared(nxtPageNum, nxtPage);
+		index->releaseLeafShared(currentPageNum, currentPageData);
+		currentPageNum = nxtPageNum;
+		currentPageData = nxtPage;
+		curLeafPtr = (LeafNode<T> *)currentPageData;
+		currentRidArray = leafRids(curLeafPtr, packedRids);
+
+		// all keys of the right sibling are within the low bound
+		T lowKey, highKey;
+		getScanBounds(lowKey, highKey);
+		nextEntry = 0;
+		endEntry = searchBoundKey<highOpT>(curLeafPtr, highKey);
+	}
+
+	// found if the key is within the range
+	// return directly without unpinning
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeCursor::readAheadAux
+// -----------------------------------------------------------------------------
+
+template <class T, Operator highOpT>
+void BTreeCursor::readAheadAux(std::size_t maxLeaves)
+{
+	if (readAheadPageNum == Page::INVALID_NUMBER || index->mapping != nullptr)
+	{
+		return;
+	}
+
+	// the parent is copied without latching it, and the copy is used if it was consistent
+	// a writer may hold the parent while waiting for the latched leaf, so its release is not waited for
+	Page *page;
+	index->readNode(readAheadPageNum, page, false);
+	FrameLatch &latch = index->bufMgr->latchOf(page);
+	std::uint64_t version = latch.sharedVersion();
+	static_assert(alignof(NonLeafNode<T>) <= alignof(std::uint64_t), "Node copy must be aligned.");
+	std::uint64_t copy[Page::SIZE / sizeof(std::uint64_t)];
+	memcpy(copy, page, Page::SIZE);
+	bool valid = latch.validate(version);
+	index->bufMgr->unPinPage(index->file, readAheadPageNum, false);
+	auto *nodePtr = (const NonLeafNode<T> *)copy;
+	if (!valid || nodePtr->level != 1)
+	{
+		readAheadPageNum = Page::INVALID_NUMBER;
+		return;
+	}
+
+	// the keys of a child are not less than the key before it, so the children from the first one whose
+	// key before is past the high bound have no key within it
+	T lowKey, highKey;
+	getScanBounds(lowKey, highKey);
+	std::vector<PageId> &pageNos = readAheadPages;
+	pageNos.clear();
+	while (pageNos.size() < std::min((std::size_t)readAheadDepth, maxLeaves))
+	{
+		if (readAheadSlot > nodePtr->numKeys)
+		{
+			// go on from the first child of the right sibling with the next batch
+			readAheadPageNum = rightLink(nodePtr);
+			readAheadSlot = 0;
+			break;
+		}
+		if (readAheadSlot > 0)
+		{
+			T key = nodeKey(nodePtr, readAheadSlot - 1);
+			if (OperatorTraits<highOpT>::orEqual ? highKey < key : !(key < highKey))
+			{
+				readAheadPageNum = Page::INVALID_NUMBER;
+				break;
+			}
+		}
+		pageNos.push_back(nodePtr->pageNoArray[readAheadSlot]);
+		++readAheadSlot;
+	}
+
+	index->bufMgr->prefetchPages(index->file, pageNos);
+	readAheadPending = pageNos.size();
+	readAheadDepth = std::min(2 * readAheadDepth, READ_AHEAD_MAX_LEAVES);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeCursor::pause
+// -----------------------------------------------------------------------------
+
+void BTreeCursor::pause()
+{
+	// a mapped leaf never changes, so the cursor holds no latch and keeps its position as is
+	if (nextEntry != -1 && index->mapping == nullptr)
+	{
+		(this->*pauseFn)();
+	}
+}
+
+// -----------------------------------------------------------------------------
+// BTreeCursor::resume
+// -----------------------------------------------------------------------------
+
+void BTreeCursor::resume()
+{
+	if (nextEntry == -1 || index->mapping != nullptr)
+	{
+		return;
+	}
+
+	// the position is still valid if no writer has latched the leaf meanwhile
+	FrameLatch &latch = index->bufMgr->latchOf(currentPageData);
+	latch.lockShared();
+	if (latch.sharedVersion() == leafVersion)
+	{
+		return;
+	}
+	latch.unlockShared();
+	(this->*reseekFn)();
+}
+
+// -----------------------------------------------------------------------------
+// BTreeCursor::pauseAux
+// -----------------------------------------------------------------------------
+
+template <class T>
+void BTreeCursor::pauseAux()
+{
+	// the scan goes on from the next entry
+	auto *curLeafPtr = (LeafNode<T> *)currentPageData;
+	T lowKey, highKey;
+	getScanBounds(lowKey, highKey);
+	setScanBounds(nodeKey(curLeafPtr, nextEntry), highKey);
+	resumeRid = postingPageNum != Page::INVALID_NUMBER ? postingPtr->ridArray[nextPosting] : currentRidArray[nextEntry];
+
+	FrameLatch &latch = index->bufMgr->latchOf(currentPageData);
+	leafVersion = latch.sharedVersion();
+	latch.unlockShared();
+}
+
+// -----------------------------------------------------------------------------
+// BTreeCursor::reseekAux
+// -----------------------------------------------------------------------------
+
+template <class T, Operator highOpT>
+void BTreeCursor::reseekAux()
+{
+	// the pages pinned are no longer those of the next entry
+	index->bufMgr->unPinPage(index->file, currentPageNum, false);
+	if (postingPageNum != Page::INVALID_NUMBER)
+	{
+		index->bufMgr->unPinPage(index->file, postingPageNum, false);
+		postingPageNum = Page::INVALID_NUMBER;
+		postingPtr = nullptr;
+	}
+
+	// find the leftmost entry with the key of the next entry, as when the scan starts
+	T lowKey, highKey;
+	getScanBounds(lowKey, highKey);
+	bool bounded;
+	T upperBound;
+	currentPageNum = index->findLeafPageNum<GTE>(lowKey, currentPageData, bounded, upperBound);
+	auto *curLeafPtr = (LeafNode<T> *)currentPageData;
+	currentRidArray = leafRids(curLeafPtr, packedRids);
+	nextEntry = searchBoundKey<GTE>(curLeafPtr, lowKey) - 1;
+	endEntry = searchBoundKey<highOpT>(curLeafPtr, highKey);
+	if (!updateScanEntryAux<T, highOpT>())
+	{
+		return;
+	}
+
+	// skip the record IDs of the key less than that of the next entry
+	curLeafPtr = (LeafNode<T> *)currentPageData;
+	if (nodeKey(curLeafPtr, nextEntry) == lowKey)
+	{
+		if (isPostingRef(currentRidArray[nextEntry]))
+		{
+			// skip the posting pages before the record ID, then the record IDs before it in the page
+			openPosting();
+			while (postingPtr->nextPageNo != Page::INVALID_NUMBER
+			       && postingPtr->ridArray[postingPtr->numRids - 1] < resumeRid)
+			{
+				PageId nxtPageNum = postingPtr->nextPageNo;
+				Page *page;
+				index->bufMgr->unPinPage(index->file, postingPageNum, false);
+				postingPageNum = nxtPageNum;
+				index->bufMgr->readPage(index->file, postingPageNum, page);
+				postingPtr = (PostingPage *)page;
+			}
+			nextPosting = std::lower_bound(postingPtr->ridArray, postingPtr->ridArray + postingPtr->numRids, resumeRid)
+			              - postingPtr->ridArray;
+			if (nextPosting == postingPtr->numRids)
+			{
+				// all of them are less, move past the last one
+				--nextPosting;
+				advance();
+			}
+			return;
+		}
+
+		// the entries of a key are in record ID order
+		int last = std::min(searchBoundKey<GT>(curLeafPtr, lowKey), endEntry);
+		nextEntry = std::lower_bound(currentRidArray + nextEntry, currentRidArray + last, resumeRid) - currentRidArray;
+		if (nextEntry == endEntry)
+		{
+			// the high bound is reached in the page, move past it
+			--nextEntry;
+			if (!updateScanEntryAux<T, highOpT>())
+			{
+				return;
+			}
+		}
+	}
+	openPosting();
 }
 
 }
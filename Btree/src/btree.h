@@ -7,15 +7,25 @@
 
 #pragma once
 
+#include <atomic>
+#include <cstdint>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <string>
 #include "string.h"
 #include <sstream>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "types.h"
 #include "page.h"
 #include "file.h"
 #include "buffer.h"
+#include "key_search.h"
+#include "key_filter.h"
+#include "index_metrics.h"
 
 namespace badgerdb
 {
@@ -66,384 +76,3069 @@ inline bool compareOp(int x, int y, Operator op)
 }
 
 /**
- * @brief Number of key slots in B+Tree leaf for INTEGER key.
+ * @brief Compile time properties of an operator, for specializing the loops that compare keys against a bound.
  */
-//                                                  sibling ptr             key               rid
-const  int INTARRAYLEAFSIZE = ( Page::SIZE - sizeof( PageId ) ) / ( sizeof( int ) + sizeof( RecordId ) );
+template <Operator op>
+struct OperatorTraits
+{
+  /**
+   * Whether the keys equal to the bound lie on the lower side of the cutoff between the keys outside
+   * and inside the range, i.e. they are excluded by GT and included by LTE.
+   */
+  static const bool orEqual = op == GT || op == LTE;
+};
 
 /**
- * @brief Number of key slots in B+Tree non-leaf for INTEGER key.
+ * Find the cutoff of the given bound in the sorted keys. For a low operator (GT/GTE) it is the position
+ * of the first key satisfying key op val, for a high operator (LT/LTE) that of the first key not satisfying it.
+ * @tparam op Operator (LT/LTE/GTE/GT)
+ * @param keys Sorted keys to search in
+ * @param n Number of keys
+ * @param val A given key value
+ * @return the position, between 0 and n
  */
-//                                                     level     extra pageNo                  key       pageNo
-const  int INTARRAYNONLEAFSIZE = ( Page::SIZE - sizeof( int ) - sizeof( PageId ) ) / ( sizeof( int ) + sizeof( PageId ) );
+template <Operator op, class T>
+inline int searchBoundKey(const T *keys, int n, const T &val)
+{
+  return searchKeys<OperatorTraits<op>::orEqual>(keys, n, val);
+}
 
 /**
- * @brief Structure to store a key-rid pair. It is used to pass the pair to functions that 
- * add to or make changes to the leaf node pages of the tree. Is templated for the key member.
+ * @brief Maximum number of characters of a STRING attribute stored as its key.
  */
-template <class T>
-class RIDKeyPair{
-public:
-	RecordId rid;
-	T key;
-	void set( RecordId r, T k)
-	{
-		rid = r;
-		key = k;
-	}
+const int STRINGSIZE = 255;
+
+/**
+ * Compare two byte strings lexicographically, a proper prefix being the smaller.
+ * @param a First bytes
+ * @param aLen Length of the first bytes
+ * @param b Second bytes
+ * @param bLen Length of the second bytes
+ * @return negative, zero or positive if a is less than, equal to or greater than b
+ */
+inline int compareBytes(const char *a, int aLen, const char *b, int bLen)
+{
+	int c = memcmp(a, b, aLen < bLen ? aLen : bLen);
+	return c != 0 ? c : aLen - bLen;
+}
+
+/**
+ * @brief Key of a STRING attribute: its characters up to the null terminator, at most STRINGSIZE of them.
+ * Keys compare bytewise, so entries sharing the first STRINGSIZE characters are told apart by their record IDs only.
+ */
+struct StringKey{
+  /**
+   * Number of valid characters.
+   */
+	std::uint16_t length;
+
+  /**
+   * Characters of the key, not null terminated.
+   */
+	char data[ STRINGSIZE ];
+
+	bool operator<( const StringKey& rhs ) const { return compareBytes(data, length, rhs.data, rhs.length) < 0; }
+	bool operator==( const StringKey& rhs ) const { return length == rhs.length && memcmp(data, rhs.data, length) == 0; }
+	bool operator!=( const StringKey& rhs ) const { return !(*this == rhs); }
 };
 
 /**
- * @brief Structure to store a key page pair which is used to pass the key and page to functions that make 
- * any modifications to the non leaf pages of the tree.
-*/
+ * Read a key of the attribute type from a pointer to integer / double.
+ * @param ptr Pointer to the attribute value
+ * @param key Returned key
+ */
 template <class T>
-class PageKeyPair{
-public:
-	PageId pageNo;
-	T key;
-	void set( int p, T k)
-	{
-		pageNo = p;
-		key = k;
-	}
-};
+inline void loadKey(const void *ptr, T &key)
+{
+	memcpy(&key, ptr, sizeof(T));
+}
 
 /**
- * @brief Overloaded operator to compare the key values of two rid-key pairs
- * and if they are the same compares to see if the first pair has
- * a smaller rid.pageNo value.
-*/
+ * Read a STRING key from a pointer to a char string, keeping at most its first STRINGSIZE characters.
+ * @param ptr Pointer to the attribute value
+ * @param key Returned key
+ */
+inline void loadKey(const void *ptr, StringKey &key)
+{
+	key.length = strnlen((const char *)ptr, STRINGSIZE);
+	memcpy(key.data, ptr, key.length);
+}
+
+/**
+ * Find the i-th key of an array of keys passed to the index: integers / doubles are
+ * stored contiguously, char strings are passed as an array of pointers to them.
+ * @param keys Array of keys
+ * @param i Index of the key
+ * @return pointer to the attribute value
+ */
 template <class T>
-bool operator<( const RIDKeyPair<T>& r1, const RIDKeyPair<T>& r2 )
+inline const void *keyAt(const void *keys, std::size_t i)
 {
-	if( r1.key != r2.key )
-		return r1.key < r2.key;
-	else
-		return r1.rid.page_number < r2.rid.page_number;
+	return (const T *)keys + i;
+}
+
+template <>
+inline const void *keyAt<StringKey>(const void *keys, std::size_t i)
+{
+	return ((const char * const *)keys)[i];
 }
 
 /**
- * @brief The meta page, which holds metadata for Index file, is always first page of the btree index file and is cast
- * to the following structure to store or retrieve information from it.
- * Contains the relation name for which the index is created, the byte offset
- * of the key value on which the index is made, the type of the key and the page no
- * of the root page. Root page starts as page 2 but since a split can occur
- * at the root the root page may get moved up and get a new page no.
+ * @brief Number of key slots in B+Tree nodes, computed at compile time for each key type.
+ * A leaf keeps a header of the same size after the record IDs for all key types. The header of
+ * a non leaf node is padded so the keys that follow it are aligned.
+ * From INDEX_FORMAT_V6 on, the last key slot of a node holds its high key, and the last page number
+ * slot of a non leaf node its right link, so one key less is stored.
 */
-struct IndexMetaInfo{
-  /**
-   * Name of base relation.
-   */
-	char relationName[20];
+template <class T>
+struct NodeCapacity{
+	//                                  sibling ptr         header                key               rid
+	static const int LEAF = ( Page::SIZE - sizeof( PageId ) - sizeof( int ) ) / ( sizeof( T ) + sizeof( RecordId ) );
 
-  /**
-   * Offset of attribute, over which index is built, inside the record stored in pages.
-   */
-	int attrByteOffset;
+	//                                     header (aligned)                                extra pageNo                  key       pageNo
+	static const int NONLEAF = ( Page::SIZE - ( alignof( T ) > sizeof( int ) ? alignof( T ) : sizeof( int ) ) - sizeof( PageId ) )
+	                           / ( sizeof( T ) + sizeof( PageId ) );
+};
 
-  /**
-   * Type of the attribute over which index is built.
-   */
-	Datatype attrType;
+/**
+ * @brief Slotted STRING nodes store variable length keys, so their capacities are those of keys of
+ * STRINGSIZE characters, each taking a key slot besides the record ID / page number.
+ * The bytes reserved for the high key and the right link are not counted.
+ */
+template <>
+struct NodeCapacity<StringKey>{
+	//                                   header       high key                   rid                key slot               key
+	static const int LEAF = ( Page::SIZE - 12 - sizeof( StringKey ) ) / ( sizeof( RecordId ) + 2 * sizeof( std::uint16_t ) + STRINGSIZE );
 
-  /**
-   * Page number of root page of the B+ Tree inside the file index file.
-   */
-	PageId rootPageNo;
+	//                                      header    extra pageNo        high key and right link                          pageNo              key slot               key
+	static const int NONLEAF = ( Page::SIZE - 8 - sizeof( PageId ) - sizeof( StringKey ) - sizeof( PageId ) ) / ( sizeof( PageId ) + 2 * sizeof( std::uint16_t ) + STRINGSIZE );
 };
 
-/*
-Each node is a page, so once we read the page in we just cast the pointer to the page to this struct and use it to access the parts
-These structures basically are the format in which the information is stored in the pages for the index file depending on what kind of 
-node they are. The level memeber of each non leaf structure seen below is set to 1 if the nodes 
-at this level are just above the leaf nodes. Otherwise set to 0.
-*/
+/**
+ * @brief Number of key slots in B+Tree leaf for INTEGER key.
+ */
+const  int INTARRAYLEAFSIZE = NodeCapacity<int>::LEAF;
 
 /**
- * @brief Structure for all non-leaf nodes when the key is of INTEGER type.
-*/
-struct NonLeafNodeInt{
-  /**
-   * Level of the node in the tree.
-   */
-	int level;
+ * @brief Number of key slots in B+Tree non-leaf for INTEGER key.
+ */
+const  int INTARRAYNONLEAFSIZE = NodeCapacity<int>::NONLEAF;
+
+/**
+ * @brief Number of key slots in B+Tree leaf for DOUBLE key.
+ */
+const  int DOUBLEARRAYLEAFSIZE = NodeCapacity<double>::LEAF;
+
+/**
+ * @brief Number of key slots in B+Tree non-leaf for DOUBLE key.
+ */
+const  int DOUBLEARRAYNONLEAFSIZE = NodeCapacity<double>::NONLEAF;
+
+/**
+ * @brief Number of keys of STRINGSIZE characters that a B+Tree leaf for STRING key always holds.
+ * Shorter keys and prefixes shared within the leaf let it hold more.
+ */
+const  int STRINGARRAYLEAFSIZE = NodeCapacity<StringKey>::LEAF;
+
+/**
+ * @brief Number of keys of STRINGSIZE characters that a B+Tree non-leaf for STRING key always holds.
+ */
+const  int STRINGARRAYNONLEAFSIZE = NodeCapacity<StringKey>::NONLEAF;
+
+/**
+ * @brief On-page format of index files created before nodes kept their number of keys.
+ * Their nodes are sized by the INVALID_NUMBER sentinels and are upgraded when they are read.
+ */
+const int INDEX_FORMAT_V1 = 1;
+
+/**
+ * @brief On-page format with the number of keys stored in each node.
+ */
+const int INDEX_FORMAT_V2 = 2;
+
+/**
+ * @brief On-page format with node layouts typed on the key, so DOUBLE and STRING indexes no longer
+ * use the INTEGER layout. INTEGER nodes are the same as in INDEX_FORMAT_V2.
+ */
+const int INDEX_FORMAT_V3 = 3;
+
+/**
+ * @brief On-page format with slotted STRING nodes holding variable length keys behind a prefix
+ * shared by the node. Other nodes are the same as in INDEX_FORMAT_V3.
+ */
+const int INDEX_FORMAT_V4 = 4;
+
+/**
+ * @brief On-page format with the record IDs of frequent keys moved to posting lists, and equal keys
+ * of a STRING leaf sharing their bytes. Nodes are otherwise the same as in INDEX_FORMAT_V4.
+ */
+const int INDEX_FORMAT_V5 = 5;
+
+/**
+ * @brief On-page format with a high key bounding the keys of each node split since, and a right link
+ * from each non leaf node to its right sibling, as leaves have. The nodes of earlier formats have neither
+ * until they are split, merged or redistributed.
+ */
+const int INDEX_FORMAT_V6 = 6;
+
+/**
+ * @brief On-page format in which INTEGER leaves written by the bulk loader may be packed, their keys and
+ * record IDs stored as offsets in fewer bytes. Other nodes are the same as in INDEX_FORMAT_V6.
+ */
+const int INDEX_FORMAT_V7 = 7;
+
+/**
+ * @brief On-page format of the index files created by this version.
+ */
+const int INDEX_FORMAT_VERSION = INDEX_FORMAT_V7;
+
+/**
+ * @brief Default fill factor of the leaf and non leaf pages packed by the bulk loader.
+ */
+const double BULKLOAD_FILL_FACTOR = 1.0;
+
+/**
+ * @brief Smallest number of bytes of the nodes of an index. An index may fill less than a page in its
+ * nodes, for fewer keys to search in each node; its node size is a power of two from this to Page::SIZE.
+ */
+const int MIN_NODE_SIZE = 1024;
+
+/**
+ * @brief Maximum number of threads scanning and sorting the base relation in the bulk loader. It uses one
+ * per hardware thread up to this number.
+ */
+const unsigned BULKLOAD_MAX_THREADS = 8;
+
+/**
+ * @brief A node left with less than this fraction of its key slots (of its bytes for STRING nodes)
+ * by a deletion is underfull, and is merged with or takes entries from a sibling.
+ */
+const double UNDERFLOW_FILL_FACTOR = 0.5;
+
+/**
+ * @brief Handling of the nodes left underfull by deletions. Passed to BTreeIndex::setDeletePolicy() method.
+ */
+enum DeletePolicy
+{
+	DELETE_EAGER,	/* Merge with or redistribute from a sibling as soon as a node underflows */
+	DELETE_LAZY		/* Only remove the entry, underfull nodes being left to BTreeIndex::compact() */
+};
+
+/**
+ * @brief How an index is opened. Passed to BTreeIndex constructor.
+ */
+enum IndexOpenMode
+{
+	INDEX_READ_WRITE,				/* Nodes are read through the buffer manager, and may be changed */
+	INDEX_READ_ONLY_MAPPED	/* The file is mapped in memory and nodes are read in the mapping, without pinning them */
+};
+
+/**
+ * @brief Order in which a scan returns the entries of its range. Passed to BTreeIndex::startScan() method.
+ */
+enum ScanDirection
+{
+	SCAN_FORWARD,		/* In increasing key order, and record ID order within a key */
+	SCAN_BACKWARD		/* In decreasing key order, and decreasing record ID order within a key */
+};
+
+/**
+ * @brief Limit of a scan which returns all the entries of its range. Passed to BTreeIndex::startScan() method.
+ */
+const std::size_t SCAN_NO_LIMIT = SIZE_MAX;
+
+/**
+ * @brief The entries of a key may take up to 1 / POSTING_INLINE_FRACTION of the record IDs of a leaf
+ * before they are moved to a posting list.
+ */
+const int POSTING_INLINE_FRACTION = 8;
+
+/**
+ * @brief A range scan reads the leaves ahead of it in batches, the first one of READ_AHEAD_MIN_LEAVES once
+ * it leaves its starting leaf, each next one twice as large up to READ_AHEAD_MAX_LEAVES.
+ */
+const int READ_AHEAD_MIN_LEAVES = 2;
+const int READ_AHEAD_MAX_LEAVES = 16;
+
+/**
+ * @brief A batch of lookups keeps up to LOOKUP_INTERLEAVE descents in flight, each going down one level per
+ * round while the nodes of the others are fetched into the cache.
+ */
+const int LOOKUP_INTERLEAVE = 16;
+
+/**
+ * @brief The level of the non leaf nodes right above the leaves is copied into the hot levels of the index
+ * once HOT_LEVELS_REBUILD descents have gone without them, as long as the copy takes at most
+ * HOT_LEVELS_MAX_BYTES.
+ */
+const int HOT_LEVELS_REBUILD = 64;
+const std::size_t HOT_LEVELS_MAX_BYTES = 1 << 20;
+
+/**
+ * @brief Number of entries sampled by BTreeIndex::collectStats to build the histogram of the keys.
+ */
+const std::size_t STATS_SAMPLE_SIZE = 10000;
+
+/**
+ * @brief A covering index stores up to MAX_INCLUDED_ATTRS fixed width attributes of each record next to
+ * its record ID in the leaves, taking up to MAX_INCLUDED_WIDTH bytes per entry.
+ */
+const int MAX_INCLUDED_ATTRS = 4;
+const int MAX_INCLUDED_WIDTH = 16;
 
+/**
+ * @brief Fixed width attribute of the records included in the leaves of a covering index.
+ * Passed to BTreeIndex constructor.
+ */
+struct IncludedAttribute{
   /**
-   * Stores keys.
+   * Offset of the attribute inside the record.
    */
-	int keyArray[ INTARRAYNONLEAFSIZE ];
+	int offset;
 
   /**
-   * Stores page numbers of child pages which themselves are other non-leaf/leaf nodes in the tree.
+   * Number of bytes of the attribute.
    */
-	PageId pageNoArray[ INTARRAYNONLEAFSIZE + 1 ];
+	int size;
 };
 
+/**
+ * @brief Included values of a record, collected by the bulk loader of a covering index.
+ * The values are packed in the order of the included attributes.
+ */
+struct IncludedValues{
+	RecordId rid;
+	char values[ MAX_INCLUDED_WIDTH ];
+
+	bool operator<( const IncludedValues &rhs ) const
+	{
+		return rid < rhs.rid;
+	}
+};
 
 /**
- * @brief Structure for all leaf nodes when the key is of INTEGER type.
-*/
-struct LeafNodeInt{
-  /**
-   * Stores keys.
-   */
-	int keyArray[ INTARRAYLEAFSIZE ];
+ * @brief A composite index is keyed on up to MAX_KEY_COLUMNS attributes of the records.
+ */
+const int MAX_KEY_COLUMNS = 4;
 
+/**
+ * @brief Attribute of the records making a column of the key of a composite index.
+ * Passed to BTreeIndex constructor.
+ */
+struct KeyColumn{
   /**
-   * Stores RecordIds.
+   * Offset of the attribute inside the record.
    */
-	RecordId ridArray[ INTARRAYLEAFSIZE ];
+	int offset;
 
   /**
-   * Page number of the leaf on the right side.
-	 * This linking of leaves allows to easily move from one leaf to the next leaf during index scan.
+   * Type of the attribute.
    */
-	PageId rightSibPageNo;
+	Datatype type;
 };
 
-
 /**
- * @brief BTreeIndex class. It implements a B+ Tree index on a single attribute of a
- * relation. This index supports only one scan at a time.
-*/
-class BTreeIndex {
+ * @brief Key value of an index in statistics, in the form startScan and estimateRange take it.
+ */
+struct IndexKey{
+  /**
+   * Datatype of the key.
+   */
+	Datatype type;
 
- private:
+  /**
+   * Bytes of the key: those of an int or a double, or the characters of a char string.
+   */
+	std::string bytes;
 
   /**
-   * File object for the index file.
+   * Get a pointer to the key as an integer / double / char string, to pass to startScan or estimateRange.
    */
-	File		*file;
+	const void* data() const { return bytes.c_str(); }
 
   /**
-   * Buffer Manager Instance.
+   * Get the value of an INTEGER or DOUBLE key, 0 for a STRING key.
    */
-	BufMgr	*bufMgr;
+	double number() const
+	{
+		int i;
+		double d;
+		switch (type)
+		{
+		case INTEGER:
+			memcpy(&i, bytes.data(), sizeof(i));
+			return i;
+		case DOUBLE:
+			memcpy(&d, bytes.data(), sizeof(d));
+			return d;
+		default:
+			return 0;
+		}
+	}
+};
 
+/**
+ * @brief Statistics of an index for a query planner, collected by BTreeIndex::collectStats.
+ */
+struct IndexStats{
   /**
-   * Page number of meta page.
+   * Number of levels, the leaves included.
    */
-	PageId	headerPageNum;
+	int height;
 
   /**
-   * page number of root page of B+ tree inside index file.
+   * Number of nodes of each level, from the leaves at 0 to the root.
    */
-	PageId	rootPageNum;
+	std::vector<std::size_t> pagesPerLevel;
 
   /**
-   * Datatype of attribute over which index is built.
+   * Number of pages of the posting lists of the keys with many entries.
    */
-	Datatype	attributeType;
+	std::size_t postingPages;
 
   /**
-   * Offset of attribute, over which index is built, inside records. 
+   * Number of entries and of distinct keys.
    */
-	int 		attrByteOffset;
+	std::size_t numEntries;
+	std::size_t distinctKeys;
 
   /**
-   * Number of keys in leaf node, depending upon the type of key.
+   * Average share of the room of a leaf its entries take, which may exceed 1 for the packed leaves of the
+   * bulk loader; and the same for the non leaf nodes.
    */
-	int			leafOccupancy;
+	double leafFill;
+	double nodeFill;
 
   /**
-   * Number of keys in non-leaf node, depending upon the type of key.
+   * Least and greatest keys, meaningless if the index is empty.
    */
-	int			nodeOccupancy;
+	IndexKey minKey;
+	IndexKey maxKey;
 
+  /**
+   * Bounds of an equi-depth histogram of the keys: bucket i lies between bounds i and i + 1 and holds about
+   * the same share of the entries as any other. The first bound is minKey and the last one maxKey. Empty if
+   * the index is.
+   */
+	std::vector<IndexKey> histogram;
+};
 
-	// MEMBERS SPECIFIC TO SCANNING
+/**
+ * @brief Structure to store a key-rid pair. It is used to pass the pair to functions that 
+ * add to or make changes to the leaf node pages of the tree. Is templated for the key member.
+ */
+template <class T>
+class RIDKeyPair{
+public:
+	RecordId rid;
+	T key;
+	void set( RecordId r, T k)
+	{
+		rid = r;
+		key = k;
+	}
+};
+
+/**
+ * @brief Structure to store a key page pair which is used to pass the key and page to functions that make 
+ * any modifications to the non leaf pages of the tree.
+*/
+template <class T>
+class PageKeyPair{
+public:
+	PageId pageNo;
+	T key;
+	void set( int p, T k)
+	{
+		pageNo = p;
+		key = k;
+	}
+};
+
+/**
+ * @brief Maximum number of non leaf levels of a tree. The non leaf nodes other than the root have at least
+ * two children, so a tree of 2^32 pages has fewer levels.
+*/
+const int MAX_TREE_HEIGHT = 40;
+
+/**
+ * @brief Stack of the non leaf nodes a descent went down from, and of the slot of the child taken in each.
+ * It is kept in place so that recording the path neither allocates nor keeps the nodes pinned.
+*/
+class DescentStack{
+public:
+  /**
+   * Page numbers of the nodes, from the root.
+   */
+	PageId pageNo[MAX_TREE_HEIGHT];
+
+  /**
+   * Position of the child taken in each node.
+   */
+	int slot[MAX_TREE_HEIGHT];
+
+  /**
+   * Number of nodes recorded.
+   */
+	int size;
+
+	DescentStack() : size(0) {}
+	void push( PageId p, int s)
+	{
+		pageNo[size] = p;
+		slot[size] = s;
+		++size;
+	}
+};
+
+/**
+ * @brief Part of the hot levels of an index that does not depend on the key type.
+*/
+struct HotLevelsBase{
+  /**
+   * Version of the tree latch when the copy was made. The copy holds as long as the tree latch is not taken
+   * exclusively, i.e. no node is merged or freed: a leaf split since then only moves keys to its right,
+   * where a lookup reaching the leaf follows them.
+   */
+	std::uint64_t version;
+};
+
+/**
+ * @brief Copy of the non leaf nodes right above the leaves, their keys and high keys packed in one sorted
+ * array laid out in cache lines, so that a lookup finds its leaf with a single search touching a few of them,
+ * out of the buffer pool.
+*/
+template <class T>
+struct HotLevels : HotLevelsBase{
+  /**
+   * Separator keys of the leaves, in order.
+   */
+	KeyDirectory<T> keys;
+
+  /**
+   * Page numbers of the leaves, one more than the keys: the i-th leaf holds the keys below the i-th separator.
+   */
+	std::vector<PageId> leaves;
+
+	HotLevels( std::uint64_t versionIn, const std::vector<T> &keysIn, std::vector<PageId> &&leavesIn )
+		: keys(keysIn), leaves(std::move(leavesIn))
+	{
+		version = versionIn;
+	}
+};
+
+/**
+ * @brief Entries inserted in the write-optimized mode and not applied to the leaves yet, of any key type.
+*/
+struct InsertBufferBase{
+	virtual ~InsertBufferBase() {}
+};
+
+/**
+ * @brief Operations of the entries of the delta index: an insertion, a deletion of an entry of the tree,
+ * or both for an entry of the tree deleted and inserted again.
+*/
+const std::uint8_t DELTA_INSERT = 1;
+const std::uint8_t DELTA_DELETE = 2;
+
+/**
+ * @brief Largest number of the most recent entries of an insert buffer left unsorted, in the order they came
+ * in, before they are sorted into a run.
+*/
+const std::size_t INSERT_BUFFER_TAIL = 64;
+
+/**
+ * @brief Pending insertions of an index, and the included values of each. In the delta index mode, pending
+ * deletions as well. An entry is appended to the most recent entries, which are left unsorted until there
+ * are INSERT_BUFFER_TAIL of them and then sorted by key and record ID into a run. A run is merged with the
+ * one before it as long as it is as large, so that the runs double in size from the newest to the oldest
+ * and an entry is moved a logarithmic number of times. A lookup probes each run and the unsorted entries,
+ * and the runs are merged into one before the entries are applied or scanned.
+*/
+template <class T>
+struct InsertBuffer : InsertBufferBase{
+  /**
+   * Entries: the runs, from the oldest, then the unsorted entries.
+   */
+	std::vector<RIDKeyPair<T>> entries;
+
+  /**
+   * Positions past the last entry of each run.
+   */
+	std::vector<std::size_t> runEnds;
+
+  /**
+   * Included values of the entries of a covering index, packed one entry after the other.
+   */
+	std::vector<char> included;
+
+  /**
+   * Operations of the entries, in the order of the entries: DELTA_INSERT in the write-optimized mode,
+   * DELTA_INSERT, DELTA_DELETE or both in the delta index mode. 0 for an entry taken out of the buffer,
+   * which stays in its run until the run is merged.
+   */
+	std::vector<std::uint8_t> ops;
+
+  /**
+   * Number of entries taken out of the buffer and left in their runs.
+   */
+	std::size_t numErased;
+
+	InsertBuffer() : numErased(0) {}
+
+  /**
+   * Number of entries in the buffer.
+   */
+	std::size_t size() const
+	{
+		return entries.size() - numErased;
+	}
+};
+
+/**
+ * @brief Overloaded operator to compare the key values of two rid-key pairs
+ * and if they are the same compares to see if the first pair has
+ * a smaller rid.
+*/
+template <class T>
+bool operator<( const RIDKeyPair<T>& r1, const RIDKeyPair<T>& r2 )
+{
+	if( r1.key != r2.key )
+		return r1.key < r2.key;
+	else
+		return r1.rid < r2.rid;
+}
+
+/**
+ * @brief The meta page, which holds metadata for Index file, is always first page of the btree index file and is cast
+ * to the following structure to store or retrieve information from it.
+ * Contains the relation name for which the index is created, the byte offset
+ * of the key value on which the index is made, the type of the key and the page no
+ * of the root page. Root page starts as page 2 but since a split can occur
+ * at the root the root page may get moved up and get a new page no.
+*/
+struct IndexMetaInfo{
+  /**
+   * Name of base relation.
+   */
+	char relationName[20];
+
+  /**
+   * Offset of attribute, over which index is built, inside the record stored in pages.
+   */
+	int attrByteOffset;
+
+  /**
+   * Type of the attribute over which index is built.
+   */
+	Datatype attrType;
+
+  /**
+   * Page number of root page of the B+ Tree inside the file index file.
+   */
+	PageId rootPageNo;
+
+  /**
+   * On-page format version of the index file. Files created in INDEX_FORMAT_V1 have 0 here.
+   */
+	int formatVersion;
+
+  /**
+   * Page number of the first page of the list of free pages, INVALID_NUMBER if there is none.
+   * The meta page is zeroed when allocated, so files created before pages were freed have no list.
+   */
+	PageId freePageNo;
+
+  /**
+   * Number of attributes included in the leaves, 0 if the index is not covering.
+   * Files created before covering indexes have 0 here.
+   */
+	int numIncluded;
+
+  /**
+   * Offsets and sizes of the included attributes.
+   */
+	IncludedAttribute included[ MAX_INCLUDED_ATTRS ];
+
+  /**
+   * Number of columns of the key of a composite index, 0 if the index is on a single attribute.
+   * Files created before composite indexes have 0 here.
+   */
+	int numKeyColumns;
+
+  /**
+   * Offsets and types of the key columns.
+   */
+	KeyColumn keyColumns[ MAX_KEY_COLUMNS ];
+
+  /**
+   * Page::SIZE of the binary that created the index file. Files created before it was recorded have 0 here.
+   */
+	int pageSize;
+
+  /**
+   * Number of bytes of a node the index fills. Files created before it was recorded have 0 here,
+   * their nodes filling whole pages.
+   */
+	int nodeSize;
+};
+
+/*
+Each node is a page, so once we read the page in we just cast the pointer to the page to this struct and use it to access the parts
+These structures basically are the format in which the information is stored in the pages for the index file depending on what kind of 
+node they are. The level memeber of each non leaf structure seen below is set to 1 if the nodes 
+at this level are just above the leaf nodes. Otherwise set to 0.
+The header fields (format, numKeys) take the bytes that INDEX_FORMAT_V1 pages always left zero,
+so a zero format identifies a page that has not been upgraded yet.
+A node split in INDEX_FORMAT_V6 keeps the high key separating it from its right sibling, and a non leaf
+node a right link to that sibling. A key not less than the high key of a node has moved right, so a
+descent reaching the node before its parent learns of the split follows the right link.
+*/
+
+/**
+ * @brief Structure for all non-leaf nodes, templated for the key type.
+*/
+template <class T>
+struct NonLeafNode{
+  /**
+   * Level of the node in the tree.
+   */
+	std::uint8_t level;
+
+  /**
+   * On-page format version of the node, 0 if not upgraded from INDEX_FORMAT_V1.
+   */
+	std::uint8_t format;
+
+  /**
+   * Number of valid keys. There is one more valid page number.
+   */
+	std::uint16_t numKeys;
+
+  /**
+   * Stores keys. The last slot holds the high key from INDEX_FORMAT_V6 on.
+   */
+	T keyArray[ NodeCapacity<T>::NONLEAF ];
+
+  /**
+   * Stores page numbers of child pages which themselves are other non-leaf/leaf nodes in the tree.
+   * The last slot holds the right link from INDEX_FORMAT_V6 on, INVALID_NUMBER if the node has no high key.
+   */
+	PageId pageNoArray[ NodeCapacity<T>::NONLEAF + 1 ];
+};
+
+
+/**
+ * @brief Structure for all leaf nodes, templated for the key type.
+*/
+template <class T>
+struct LeafNode{
+  /**
+   * Stores keys.
+   */
+	T keyArray[ NodeCapacity<T>::LEAF ];
+
+  /**
+   * Stores RecordIds. The leaves of a covering index hold fewer entries, and the included values of
+   * their entries follow the record IDs in this array.
+   */
+	RecordId ridArray[ NodeCapacity<T>::LEAF ];
+
+  /**
+   * Page number of the leaf on the right side.
+	 * This linking of leaves allows to easily move from one leaf to the next leaf during index scan.
+   */
+	PageId rightSibPageNo;
+
+  /**
+   * Number of valid keys and record IDs.
+   */
+	std::uint16_t numKeys;
+
+  /**
+   * Whether the last key slot holds the high key of the leaf. Always 0 before INDEX_FORMAT_V6.
+   */
+	std::uint8_t hasHighKey;
+
+  /**
+   * On-page format version of the leaf, 0 if not upgraded from INDEX_FORMAT_V1.
+   */
+	std::uint8_t format;
+};
+
+/**
+ * @brief Entry of the key directory of a slotted STRING node, locating the rest of a key after the prefix
+ * shared by all keys of the node.
+*/
+struct KeySlot{
+  /**
+   * Offset of the rest of the key from the start of the page.
+   */
+	std::uint16_t offset;
+
+  /**
+   * Number of characters of the rest of the key.
+   */
+	std::uint16_t length;
+};
+
+/*
+STRING nodes are slotted, since their keys are of variable length. The page numbers / record IDs are kept
+contiguous right after the header, and are followed by a directory of numKeys key slots. The prefix shared by
+all keys of the node is stored once at the end of the page, and the rest of each key in the bytes below it,
+down to heapOffset. The bytes between the key slots and heapOffset are free.
+From INDEX_FORMAT_V6 on, the end of the page is reserved for the high key, and the right link of a non
+leaf node, the prefix being stored right below them.
+*/
+
+/**
+ * @brief Structure for all non-leaf nodes when the key is of STRING type.
+*/
+template <>
+struct NonLeafNode<StringKey>{
+  /**
+   * Level of the node in the tree.
+   */
+	std::uint8_t level;
+
+  /**
+   * On-page format version of the node.
+   */
+	std::uint8_t format;
+
+  /**
+   * Number of valid keys. There is one more valid page number.
+   */
+	std::uint16_t numKeys;
+
+  /**
+   * Number of characters of the prefix shared by all keys, stored at the end of the page.
+   */
+	std::uint16_t prefixLength;
+
+  /**
+   * Offset of the lowest byte used by the keys from the start of the page.
+   */
+	std::uint16_t heapOffset;
+
+  /**
+   * Stores page numbers of child pages, followed by the key slots.
+   */
+	PageId pageNoArray[ ( Page::SIZE - 4 * sizeof( std::uint16_t ) ) / sizeof( PageId ) ];
+};
+
+/**
+ * @brief Structure for all leaf nodes when the key is of STRING type.
+*/
+template <>
+struct LeafNode<StringKey>{
+  /**
+   * Page number of the leaf on the right side.
+   */
+	PageId rightSibPageNo;
+
+  /**
+   * Number of valid keys and record IDs.
+   */
+	std::uint16_t numKeys;
+
+  /**
+   * Whether the end of the page holds the high key of the leaf. Always 0 before INDEX_FORMAT_V6.
+   */
+	std::uint8_t hasHighKey;
+
+  /**
+   * On-page format version of the leaf.
+   */
+	std::uint8_t format;
+
+  /**
+   * Number of characters of the prefix shared by all keys, stored at the end of the page.
+   */
+	std::uint16_t prefixLength;
+
+  /**
+   * Offset of the lowest byte used by the keys from the start of the page.
+   */
+	std::uint16_t heapOffset;
+
+  /**
+   * Stores RecordIds, followed by the key slots.
+   */
+	RecordId ridArray[ ( Page::SIZE - sizeof( PageId ) - 4 * sizeof( std::uint16_t ) ) / sizeof( RecordId ) ];
+};
+
+/**
+ * @brief Structure for all non-leaf nodes when the key is of INTEGER type.
+*/
+typedef NonLeafNode<int> NonLeafNodeInt;
+
+/**
+ * @brief Structure for all leaf nodes when the key is of INTEGER type.
+*/
+typedef LeafNode<int> LeafNodeInt;
+
+/**
+ * @brief Structure for all non-leaf nodes when the key is of DOUBLE type.
+*/
+typedef NonLeafNode<double> NonLeafNodeDouble;
+
+/**
+ * @brief Structure for all leaf nodes when the key is of DOUBLE type.
+*/
+typedef LeafNode<double> LeafNodeDouble;
+
+/**
+ * @brief Structure for all non-leaf nodes when the key is of STRING type.
+*/
+typedef NonLeafNode<StringKey> NonLeafNodeString;
+
+/**
+ * @brief Structure for all leaf nodes when the key is of STRING type.
+*/
+typedef LeafNode<StringKey> LeafNodeString;
+
+static_assert(sizeof(NonLeafNodeInt) <= Page::SIZE && sizeof(NonLeafNodeDouble) <= Page::SIZE
+              && sizeof(NonLeafNodeString) <= Page::SIZE,
+              "Non leaf node must fit in a page.");
+static_assert(sizeof(LeafNodeInt) <= Page::SIZE && sizeof(LeafNodeDouble) <= Page::SIZE
+              && sizeof(LeafNodeString) <= Page::SIZE,
+              "Leaf node must fit in a page.");
+
+/**
+ * @brief Number of record IDs in a posting page.
+ */
+const int POSTINGPAGESIZE = ( Page::SIZE - sizeof( PageId ) - sizeof( int ) ) / sizeof( RecordId );
+
+/**
+ * @brief Structure for the pages of a posting list, which holds the record IDs of a key having too many
+ * entries to be kept in its leaf. The list is sorted by record ID across its linked pages, none of which is empty.
+ * The leaf keeps a single entry for the key, whose record ID refers to the first page of the list.
+*/
+struct PostingPage{
+  /**
+   * Page number of the next page of the list, INVALID_NUMBER for the last one.
+   */
+	PageId nextPageNo;
+
+  /**
+   * Number of valid record IDs.
+   */
+	std::uint16_t numRids;
+
+  /**
+   * Unused.
+   */
+	std::uint8_t reserved;
+
+  /**
+   * On-page format version of the page.
+   */
+	std::uint8_t format;
+
+  /**
+   * Stores RecordIds in increasing order.
+   */
+	RecordId ridArray[ POSTINGPAGESIZE ];
+};
+
+static_assert(sizeof(PostingPage) <= Page::SIZE, "Posting page must fit in a page.");
+
+/**
+ * @brief Structure for the pages freed by deletions, which are linked from the meta page until they are reused.
+*/
+struct FreePage{
+  /**
+   * Page number of the next free page, INVALID_NUMBER for the last one.
+   */
+	PageId nextPageNo;
+};
+
+/**
+ * Check whether the record ID of a leaf entry refers to the posting list of its key.
+ * Such a record ID has an invalid slot, and the page number of the first page of the list.
+ * @param rid Record ID of the entry
+ * @return whether it refers to a posting list or not
+ */
+inline bool isPostingRef(const RecordId &rid)
+{
+	return rid.slot_number == Page::INVALID_SLOT;
+}
+
+/**
+ * Make the record ID of a leaf entry referring to a posting list.
+ * @param headPageNo Page number of the first page of the list
+ * @return the record ID
+ */
+inline RecordId postingRef(PageId headPageNo)
+{
+	RecordId rid;
+	rid.page_number = headPageNo;
+	rid.slot_number = Page::INVALID_SLOT;
+	rid.padding = 0;
+	return rid;
+}
+
+/**
+ * Find the cutoff of the given bound in the sorted keys of a node.
+ * @see searchBoundKey
+ * @tparam op Operator (LT/LTE/GTE/GT)
+ * @param nodePtr Non leaf node to search in
+ * @param val A given key value
+ * @return the position, between 0 and the number of keys
+ */
+template <Operator op, class T>
+inline int searchBoundKey(const NonLeafNode<T> *nodePtr, const T &val)
+{
+	return searchBoundKey<op>(nodePtr->keyArray, nodePtr->numKeys, val);
+}
+
+/**
+ * Find the cutoff of the given bound in the sorted keys of a leaf.
+ * @see searchBoundKey
+ * @tparam op Operator (LT/LTE/GTE/GT)
+ * @param leafPtr Leaf node to search in
+ * @param val A given key value
+ * @return the position, between 0 and the number of keys
+ */
+template <Operator op, class T>
+inline int searchBoundKey(const LeafNode<T> *leafPtr, const T &val)
+{
+	return searchBoundKey<op>(leafPtr->keyArray, leafPtr->numKeys, val);
+}
+
+/**
+ * Get the i-th key of a node.
+ * @param nodePtr Non leaf node
+ * @param i Index of the key
+ * @return the key
+ */
+template <class T>
+inline T nodeKey(const NonLeafNode<T> *nodePtr, int i)
+{
+	return nodePtr->keyArray[i];
+}
+
+/**
+ * Get the i-th key of a leaf.
+ * @param leafPtr Leaf node
+ * @param i Index of the key
+ * @return the key
+ */
+template <class T>
+inline T nodeKey(const LeafNode<T> *leafPtr, int i)
+{
+	return leafPtr->keyArray[i];
+}
+
+/**
+ * Check whether a leaf has a high key, i.e. whether it has been split, merged or redistributed in INDEX_FORMAT_V6.
+ * A leaf without one has the bound given by its parent.
+ * @param leafPtr Leaf node
+ * @return whether it has a high key or not
+ */
+template <class T>
+inline bool hasHighKey(const LeafNode<T> *leafPtr)
+{
+	return leafPtr->hasHighKey != 0;
+}
+
+/**
+ * Get the high key of a leaf, the exclusive upper bound of its keys.
+ * @param leafPtr Leaf node having a high key
+ * @return the high key
+ */
+template <class T>
+inline T highKey(const LeafNode<T> *leafPtr)
+{
+	return leafPtr->keyArray[NodeCapacity<T>::LEAF - 1];
+}
+
+/**
+ * Set the high key of a leaf, which holds less than NodeCapacity<T>::LEAF entries.
+ * @param leafPtr Leaf node
+ * @param key High key
+ */
+template <class T>
+inline void setHighKey(LeafNode<T> *leafPtr, const T &key)
+{
+	leafPtr->keyArray[NodeCapacity<T>::LEAF - 1] = key;
+	leafPtr->hasHighKey = 1;
+}
+
+/**
+ * Remove the high key of a leaf, which becomes bounded by its parent only.
+ * @param leafPtr Leaf node
+ */
+template <class T>
+inline void clearHighKey(LeafNode<T> *leafPtr)
+{
+	leafPtr->hasHighKey = 0;
+}
+
+/**
+ * Get the page number of the right sibling of a leaf.
+ * @param leafPtr Leaf node
+ * @return the right sibling page ID, INVALID_NUMBER for the last leaf
+ */
+template <class T>
+inline PageId rightLink(const LeafNode<T> *leafPtr)
+{
+	return leafPtr->rightSibPageNo;
+}
+
+/**
+ * Get the right link of a non leaf node. Nodes from before INDEX_FORMAT_V6 have none, since the slot
+ * may hold their last child.
+ * @param nodePtr Non leaf node
+ * @return the right sibling page ID, INVALID_NUMBER if the node has no high key
+ */
+template <class T>
+inline PageId rightLink(const NonLeafNode<T> *nodePtr)
+{
+	return nodePtr->format >= INDEX_FORMAT_V6 ? nodePtr->pageNoArray[NodeCapacity<T>::NONLEAF] : Page::INVALID_NUMBER;
+}
+
+/**
+ * Check whether a non leaf node has a high key, which it has along with a right link.
+ * @param nodePtr Non leaf node
+ * @return whether it has a high key or not
+ */
+template <class T>
+inline bool hasHighKey(const NonLeafNode<T> *nodePtr)
+{
+	return rightLink(nodePtr) != Page::INVALID_NUMBER;
+}
+
+/**
+ * Get the high key of a non leaf node, the exclusive upper bound of the keys in its subtree.
+ * @param nodePtr Non leaf node having a high key
+ * @return the high key
+ */
+template <class T>
+inline T highKey(const NonLeafNode<T> *nodePtr)
+{
+	return nodePtr->keyArray[NodeCapacity<T>::NONLEAF - 1];
+}
+
+/**
+ * Set the right link and the high key of an INDEX_FORMAT_V6 non leaf node, which holds less
+ * than NodeCapacity<T>::NONLEAF keys.
+ * @param nodePtr Non leaf node
+ * @param rightPageNo Right sibling page ID, INVALID_NUMBER to remove the high key
+ * @param key High key
+ */
+template <class T>
+inline void setRightLink(NonLeafNode<T> *nodePtr, PageId rightPageNo, const T &key)
+{
+	nodePtr->pageNoArray[NodeCapacity<T>::NONLEAF] = rightPageNo;
+	nodePtr->keyArray[NodeCapacity<T>::NONLEAF - 1] = key;
+}
+
+/**
+ * Check whether the keys GT/GTE the given value lie right of a node, i.e. whether the node has been
+ * split since its parent was read. A node without a high key has not been split since it was reached.
+ * @tparam op Operator (GT/GTE)
+ * @param nodePtr Leaf or non leaf node
+ * @param val A given key value
+ * @return whether to follow the right link or not
+ */
+template <Operator op, class N, class T>
+inline bool pastHighKey(const N *nodePtr, const T &val)
+{
+	if (!hasHighKey(nodePtr))
+	{
+		return false;
+	}
+	T key = highKey(nodePtr);
+	return OperatorTraits<op>::orEqual ? !(val < key) : key < val;
+}
+
+
+class BTreeIndex;
+class RidBitmap;
+
+template <class T>
+class SortedPairs;
+
+/**
+ * @brief BTreeCursor class. It is a range scan over a BTreeIndex holding its own pinned leaf
+ * and position, so that any number of cursors can be open over the same index at once.
+ * A cursor must be ended or destroyed before the index it scans.
+ * A cursor is used by one thread at a time, while other threads may modify the index. It latches its leaf
+ * shared during each call only, so it never blocks writers between calls. If the leaf has changed since
+ * the last call, the cursor descends again to the entry it stopped at, which gives the entries inserted
+ * after it and not those deleted meanwhile.
+*/
+class BTreeCursor {
+
+ private:
+
+  /**
+   * Index being scanned.
+   */
+	BTreeIndex	*index;
+
+  /**
+   * True if an index scan has been started.
+   */
+	bool		scanExecuting;
+
+  /**
+   * Index of next entry to be scanned in current leaf being scanned.
+   */
+	int			nextEntry;
+
+  /**
+   * Index past the last entry within the high bound in current leaf being scanned.
+   */
+	int			endEntry;
+
+  /**
+   * Page number of current page being scanned.
+   */
+	PageId	currentPageNum;
+
+  /**
+   * Current Page being scanned.
+   */
+	Page		*currentPageData;
+
+  /**
+   * Record IDs of current leaf being scanned.
+   */
+	const RecordId	*currentRidArray;
+
+  /**
+   * Record IDs of the current leaf decoded, if it is packed.
+   */
+	std::vector<RecordId>	packedRids;
+
+  /**
+   * Page number of the posting page being scanned, if the next entry refers to a posting list.
+   * INVALID_NUMBER otherwise.
+   */
+	PageId	postingPageNum;
+
+  /**
+   * Posting page being scanned.
+   */
+	PostingPage	*postingPtr;
+
+  /**
+   * Index of next record ID to be scanned in the posting page.
+   */
+	int			nextPosting;
+
+  /**
+   * Low INTEGER value for scan.
+   * The low value is moved up to the key of the next entry each time the cursor releases its leaf.
+   */
+	int			lowValInt;
+
+  /**
+   * Low DOUBLE value for scan.
+   */
+	double	lowValDouble;
+
+  /**
+   * Low STRING value for scan.
+   */
+	std::string	lowValString;
+
+  /**
+   * High INTEGER value for scan.
+   */
+	int			highValInt;
+
+  /**
+   * High DOUBLE value for scan.
+   */
+	double	highValDouble;
+
+  /**
+   * High STRING value for scan.
+   */
+	std::string highValString;
+	
+  /**
+   * Low Operator. Can only be GT(>) or GTE(>=).
+   */
+	Operator	lowOp;
+
+  /**
+   * High Operator. Can only be LT(<) or LTE(<=).
+   */
+	Operator	highOp;
+
+  /**
+   * Record ID of the next entry when the cursor released its leaf.
+   */
+	RecordId	resumeRid;
+
+  /**
+   * Version of the current leaf when the cursor released it.
+   */
+	std::uint64_t	leafVersion;
+
+  /**
+   * Page number of the level 1 node whose children are read ahead of the scan, INVALID_NUMBER if none.
+   */
+	PageId	readAheadPageNum;
+
+  /**
+   * Position in that node of the next child to read ahead.
+   */
+	int			readAheadSlot;
+
+  /**
+   * Number of leaves to read ahead in the next batch.
+   */
+	int			readAheadDepth;
+
+  /**
+   * Number of leaves read ahead which the scan has not reached yet.
+   */
+	int			readAheadPending;
+
+  /**
+   * Page numbers of the last batch of leaves read ahead, kept so that a batch does not allocate.
+   */
+	std::vector<PageId>	readAheadPages;
+
+  /**
+   * Entries of the delta index within the range, taken when the scan starts, an InsertBuffer of the key
+   * type. nullptr if the index is not in the delta index mode.
+   */
+	std::unique_ptr<InsertBufferBase>	delta;
+
+  /**
+   * Position in the delta of the next entry to merge.
+   */
+	std::size_t	deltaPos;
+
+  /**
+   * Whether the next entry of a merged scan has been found, and its record ID.
+   */
+	bool			hasMerged;
+	RecordId	mergedRid;
+
+  /**
+   * Instantiation of nextMergedAux for the key type of the scan, chosen when the scan starts.
+   */
+	bool (BTreeCursor::*nextMergedFn)(RecordId &);
+
+  /**
+   * Instantiation of updateScanEntryAux for the key type and high operator of the scan, chosen when the scan starts.
+   */
+	bool (BTreeCursor::*updateScanEntryFn)();
+
+  /**
+   * Instantiation of pauseAux for the key type of the scan, chosen when the scan starts.
+   */
+	void (BTreeCursor::*pauseFn)();
+
+  /**
+   * Instantiation of reseekAux for the key type and high operator of the scan, chosen when the scan starts.
+   */
+	void (BTreeCursor::*reseekFn)();
+
+  /**
+   * Whether the scan goes from the high bound down to the low bound.
+   * The high value and resumeRid are then moved down to the first entry of each leaf the cursor has read:
+   * the entries left are those less than them, in key then record ID order.
+   */
+	bool		backward;
+
+  /**
+   * Record IDs of the entries of the last leaf read by a backward scan, in the order they are returned,
+   * the posting lists being expanded. The cursor holds no page between calls.
+   */
+	std::vector<RecordId>	backwardRids;
+
+  /**
+   * Position in backwardRids of the next record ID to return.
+   */
+	std::size_t	backwardPos;
+
+  /**
+   * Whether a backward scan has read the leaf of its last entries.
+   */
+	bool		backwardDone;
+
+  /**
+   * Instantiation of fillBackwardAux for the key type and low operator of the scan, chosen when the scan starts.
+   */
+	void (BTreeCursor::*fillBackwardFn)();
+
+  /**
+   * Number of entries the scan may still return, or skip while it starts. The scan reads no leaf ahead
+   * that it would not reach within it.
+   */
+	std::size_t	scanLimit;
+
+  /**
+   * Set the bounds of the scan from keys of the attribute type.
+   * @param lowKey Low key of range
+   * @param highKey High key of range
+   */
+	void setScanBounds(const int &lowKey, const int &highKey);
+	void setScanBounds(const double &lowKey, const double &highKey);
+	void setScanBounds(const StringKey &lowKey, const StringKey &highKey);
+
+  /**
+   * Get the bounds of the scan as keys of the attribute type.
+   * @param lowKey Returned low key of range
+   * @param highKey Returned high key of range
+   */
+	void getScanBounds(int &lowKey, int &highKey) const;
+	void getScanBounds(double &lowKey, double &highKey) const;
+	void getScanBounds(StringKey &lowKey, StringKey &highKey) const;
+
+  /**
+   * Auxiliary method of startScan, specialized on the key type once the opcodes have been checked.
+   * Check the range, set the scanning information and dispatch on the operators.
+   * @param lowValParm	Low value of range, pointer to integer / double / char string
+   * @param lowOpParm		Low operator (GT/GTE)
+   * @param highValParm	High value of range, pointer to integer / double / char string
+   * @param highOpParm	High operator (LT/LTE)
+   * @param direction		Order of the entries returned
+   * @throws  BadScanrangeException If lowVal > highval
+	 * @throws  NoSuchKeyFoundException If there is no key in the B+ tree that satisfies the scan criteria.
+   */
+	template <class T>
+	void startScanTyped(const void* lowValParm, const Operator lowOpParm, const void* highValParm, const Operator highOpParm,
+	                    const ScanDirection direction);
+
+  /**
+   * Auxiliary method of startScan, specialized on the key type and the operators once the range has been checked.
+   * Find the leaf and the positions of the first entry and of the high bound cutoff in it.
+   * @throws  NoSuchKeyFoundException If there is no key in the B+ tree that satisfies the scan criteria.
+   */
+	template <class T, Operator lowOpT, Operator highOpT>
+	void startScanAux();
+
+  /**
+   * Read the entries of the next leaf of a backward scan into backwardRids, those of the leaf holding the
+   * greatest entry less than the high value and resumeRid, down to the low bound.
+   * Leaves have no left link, so the leaf is found from the root: it is the leftmost leaf that may hold the
+   * high value, or one of its right siblings if the entries of that key span several leaves. If none of its
+   * entries is less, the leaf before it is that of the separator key the descent went right of, and the
+   * descent starts again with that key and all its record IDs. The non leaf nodes being the cached part
+   * of the tree, each leaf costs about one leaf read.
+   * @tparam T Key type of the index
+   * @tparam lowOpT Low operator of the scan
+   */
+	template <class T, Operator lowOpT>
+	void fillBackwardAux();
+
+  /**
+   * Get the next record ID of a backward scan, reading the next leaf once those of the last one are returned.
+   * @param outRid	RecordId of next record found returned in this
+   * @return whether such record ID exist or not.
+   */
+	bool nextBackward(RecordId &outRid);
+
+  /**
+   * Update the next entry with a key that lies within the search bound.
+   * The corresponding current page and page ID will be updated as well, together with the end entry
+   * which is found by a single search within each new page. The entries before the next one that are
+   * below the low bound should already be skipped, which is only needed in the starting page.
+   * The current page will be set to invalid if such entry does not exist.
+   * For convenience, the invalid next entry has an index -1.
+   * @tparam T Key type of the index
+   * @tparam highOpT High operator of the scan
+   * @return whether such entry exist or not.
+   */
+	template <class T, Operator highOpT>
+	bool updateScanEntryAux();
+
+  /**
+   * Update the next entry with a key that lies within the search bound.
+   * @see updateScanEntryAux
+   * @return whether such entry exist or not.
+   */
+	bool updateScanEntry() { return (this->*updateScanEntryFn)(); }
+
+  /**
+   * Read the next batch of leaves ahead of the scan into the buffer pool. Their page numbers are taken from
+   * a copy of their parent, up to the first child whose keys are all past the high bound, and the batch
+   * is twice as large as the previous one up to READ_AHEAD_MAX_LEAVES. Children split since the parent
+   * was read are missed, the pages read only being a hint.
+   * @tparam T Key type of the index
+   * @tparam highOpT High operator of the scan
+   * @param maxLeaves Maximum number of leaves to read, those the limit of the scan may reach
+   */
+	template <class T, Operator highOpT>
+	void readAheadAux(std::size_t maxLeaves);
+
+  /**
+   * Fetch or skip the record ids of up to max next index entries, regardless of the limit of the scan.
+   * The entries up to the high bound or to a posting list in a leaf, and the record ids of a posting page,
+   * are taken at once.
+   * @param out	Array of at least max record ids returned in this, nullptr to skip them
+   * @param max	Maximum number of record ids to fetch
+   * @return the number of record ids fetched, less than max only once the scan is completed
+   */
+	std::size_t nextBatch(RecordId* out, std::size_t max);
+
+  /**
+   * Start scanning the posting list of the next entry if it refers to one.
+   */
+	void openPosting();
+
+  /**
+   * Release the current leaf at the end of a call, recording the key and record ID of the next entry
+   * as the low bound of the scan, and the version of the leaf.
+   * @tparam T Key type of the index
+   */
+	template <class T>
+	void pauseAux();
+
+  /**
+   * Find the next entry again from the root, as the first one not less than the key and record ID
+   * recorded by pauseAux. The pinned pages are released first.
+   * Files from before INDEX_FORMAT_V5 may hold the entries of a key in insertion order, of which
+   * some may then be skipped or returned again.
+   * @tparam T Key type of the index
+   * @tparam highOpT High operator of the scan
+   */
+	template <class T, Operator highOpT>
+	void reseekAux();
+
+  /**
+   * Release the current leaf at the end of a call, if the scan is not completed.
+   * @see pauseAux
+   */
+	void pause();
+
+  /**
+   * Latch the current leaf again at the start of a call, if the scan is not completed.
+   * The next entry is found again if the leaf has changed since the cursor released it.
+   * @see reseekAux
+   */
+	void resume();
+
+  /**
+   * Move to the next record ID of the scan, going through the posting list of the next entry
+   * before the entries that follow it.
+   * @return whether such record ID exist or not.
+   */
+	bool advance();
+
+  /**
+   * Find the next entry of a scan which merges the tree with the entries of the delta index. An entry of
+   * the delta replaces the equal entry of the tree, and hides it if it is a deletion.
+   * @tparam T Key type of the index
+   * @param outRid	RecordId of the entry found returned in this
+   * @return whether such entry exist or not.
+   */
+	template <class T>
+	bool nextMergedAux(RecordId &outRid);
+
+ public:
+
+  /**
+   * BTreeCursor Constructor. The cursor is not positioned until startScan is called.
+   * @param indexIn	Index to scan
+   */
+	explicit BTreeCursor(BTreeIndex *indexIn);
+
+  /**
+   * BTreeCursor Destructor. End the scan if it is executing.
+   */
+	~BTreeCursor();
+
+	BTreeCursor(const BTreeCursor &) = delete;
+	BTreeCursor &operator=(const BTreeCursor &) = delete;
+
+  /**
+	 * Begin a filtered scan of the index. If a scan is already executing on this cursor, it is ended here.
+	 * @see BTreeIndex::startScan
+   * @param lowVal	Low value of range, pointer to integer / double / char string
+   * @param lowOp		Low operator (GT/GTE)
+   * @param highVal	High value of range, pointer to integer / double / char string
+   * @param highOp	High operator (LT/LTE)
+   * @param direction	Order of the entries returned
+   * @param offset	Number of entries to skip first
+   * @param limit		Maximum number of entries to return after them
+   * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values 
+   * @throws  BadScanrangeException If lowVal > highval
+	 * @throws  NoSuchKeyFoundException If there is no key in the B+ tree that satisfies the scan criteria.
+	**/
+	void startScan(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp,
+	               const ScanDirection direction = SCAN_FORWARD, std::size_t offset = 0,
+	               std::size_t limit = SCAN_NO_LIMIT);
+
+  /**
+	 * Fetch the record id of the next index entry that matches the scan.
+	 * @see BTreeIndex::scanNext
+   * @param outRid	RecordId of next record found that satisfies the scan criteria returned in this
+	 * @throws ScanNotInitializedException If no scan has been initialized.
+	 * @throws IndexScanCompletedException If no more records, satisfying the scan criteria, are left to be scanned.
+	**/
+	void scanNext(RecordId& outRid);
+
+  /**
+	 * Fetch the record ids of up to max next index entries that match the scan.
+	 * @see BTreeIndex::scanNextBatch
+   * @param out	Array of at least max record ids returned in this
+   * @param max	Maximum number of record ids to fetch
+   * @return the number of record ids fetched, 0 if the scan is completed
+	 * @throws ScanNotInitializedException If no scan has been initialized.
+	**/
+	std::size_t scanNextBatch(RecordId* out, std::size_t max);
+
+  /**
+	 * Fetch the next index entry that matches the scan with its key and included values, which are read
+	 * from the leaf so that a covering index answers the scan without reading the base relation.
+	 * Only for INTEGER and DOUBLE indexes; an index which is not covering returns no included values.
+	 * Only for forward scans.
+   * @param outRid		RecordId of next record found that satisfies the scan criteria returned in this
+   * @param key				Returned key, an integer / double
+   * @param included	Returned values of the included attributes packed in their order, getIncludedWidth() bytes
+	 * @throws ScanNotInitializedException If no scan has been initialized.
+	 * @throws IndexScanCompletedException If no more records, satisfying the scan criteria, are left to be scanned.
+	 * @throws BadOpcodesException If the scan is a backward one.
+	**/
+	void scanNextIncluded(RecordId& outRid, void* key, void* included);
+
+  /**
+	 * Fetch the next index entry that matches the scan with its key, read from the leaf, so that the entries
+	 * of several scans are merged in key order. Only for forward scans.
+   * @param outRid		RecordId of next record found that satisfies the scan criteria returned in this
+   * @param key				Returned key, an integer / double, or a char string of at most STRINGSIZE characters
+   *									followed by a zero byte
+	 * @throws ScanNotInitializedException If no scan has been initialized.
+	 * @throws IndexScanCompletedException If no more records, satisfying the scan criteria, are left to be scanned.
+	 * @throws BadOpcodesException If the scan is a backward one, or merges a delta index.
+	**/
+	void scanNextKey(RecordId& outRid, void* key);
+
+  /**
+	 * Collect the record ids of all the index entries left in the scan into a bitmap grouped by page, so
+	 * that the records are then fetched in page order by a BitmapHeapScan, each page being read once.
+	 * The scan is completed on return. The bitmaps of several scans may be intersected or united.
+   * @param out	Bitmap the record ids are added to
+   * @return the number of record ids collected
+	 * @throws ScanNotInitializedException If no scan has been initialized.
+	**/
+	std::size_t scanToBitmap(RidBitmap& out);
+
+  /**
+	 * Skip up to n next index entries of the scan, which count against its limit. Every leaf and posting
+	 * page of the entries skipped is read, its entries being counted at once rather than copied.
+   * @param n	Maximum number of entries to skip
+   * @return the number of entries skipped, less than n only once the scan is completed
+	 * @throws ScanNotInitializedException If no scan has been initialized.
+	**/
+	std::size_t scanSkip(std::size_t n);
+
+  /**
+	 * Terminate the scan of this cursor. Unpin any pinned pages. Reset scan specific variables.
+	 * @throws ScanNotInitializedException If no scan has been initialized.
+	**/
+	void endScan();
+
+  /**
+	 * Return whether a scan has been started and not ended on this cursor.
+	**/
+	bool isExecuting() const { return scanExecuting; }
+};
+
+/**
+ * @brief BTreeIndex class. It implements a B+ Tree index on a single attribute of a
+ * relation. The startScan, scanNext and endScan methods run one scan at a time,
+ * and more scans can be open at once through BTreeCursor objects.
+ * Insertions, deletions, lookups and cursors may be used from several threads at once, each node
+ * being protected by the latch of its buffer frame. Lookups and scans descend with optimistic lock
+ * coupling: the non leaf nodes are read without latching them and the descent restarts if one has
+ * changed, the leaf only being latched shared. The tree is a B-link tree: a split links the new node
+ * to the right of the split one and gives the latter a high key before the parent learns of it, so a
+ * descent finding its key beyond the high key of a node follows the right link. Insertions thus descend
+ * like lookups and latch a single node at a time, going up to the parents one by one after a split.
+ * Deletions only latch their leaf as well, unless it may underflow: the path is then latched exclusively
+ * from the root, releasing the ancestors as soon as the child is known not to underflow.
+ * The index is opened and closed by a single thread, and the scan of startScan is used by one thread at a time.
+ * An index built once and then only queried may be opened in INDEX_READ_ONLY_MAPPED mode: its file is mapped
+ * in memory, and lookups and scans read the nodes in the mapping, with no pin, hash lookup or latch.
+ * The non leaf nodes reached by descents are kept pinned in the node cache of the index, whose pins come out
+ * of the budget the pin holders of the buffer manager share, and are given back when the pool runs out of
+ * frames.
+*/
+class BTreeIndex : public PinHolder {
+
+	friend class BTreeCursor;
+
+ private:
+
+  /**
+   * File object for the index file.
+   */
+	File		*file;
+
+  /**
+   * Buffer Manager Instance.
+   */
+	BufMgr	*bufMgr;
+
+  /**
+   * Page number of meta page.
+   */
+	PageId	headerPageNum;
+
+  /**
+   * page number of root page of B+ tree inside index file.
+   * It only changes while the old root is latched exclusively.
+   */
+	std::atomic<PageId>	rootPageNum;
+
+  /**
+   * Datatype of attribute over which index is built.
+   */
+	Datatype	attributeType;
+
+  /**
+   * Offset of attribute, over which index is built, inside records. 
+   */
+	int 		attrByteOffset;
+
+  /**
+   * Number of keys in leaf node, depending upon the type of key.
+   */
+	int			leafOccupancy;
+
+  /**
+   * Number of keys in non-leaf node, depending upon the type of key.
+   */
+	int			nodeOccupancy;
+
+  /**
+   * Number of bytes of a node the index fills, which the occupancies are scaled to.
+   */
+	int			nodeSize;
+
+  /**
+   * True if the index file may still contain INDEX_FORMAT_V1 nodes.
+   */
+	bool		legacyFormat;
+
+  /**
+   * Maximum number of entries of a key kept in a leaf, depending upon the type of key.
+   * The record IDs of a key with more are moved to a posting list.
+   */
+	int			postingThreshold;
+
+  /**
+   * Attributes included in the leaves, empty if the index is not covering.
+   */
+	std::vector<IncludedAttribute>	includedAttrs;
+
+  /**
+   * Number of bytes of the included values of an entry, 0 if the index is not covering.
+   */
+	int			includedWidth;
+
+  /**
+   * Offset from the start of a leaf of the included values of its first entry, right after the
+   * leafOccupancy record IDs.
+   */
+	int			includedOffset;
+
+  /**
+   * Columns of the key of a composite index, empty if the index is on a single attribute.
+   * The key of a composite index is a STRING key holding the columns encoded by encodeKey.
+   */
+	std::vector<KeyColumn>	keyColumns;
+
+  /**
+   * Page number of the first free page of the index file, INVALID_NUMBER if there is none.
+   */
+	PageId	freePageNum;
+
+  /**
+   * Whether allocIndexPage appends pages to the file instead of reusing the free ones, set while rebuild
+   * packs the new tree so that its pages are contiguous.
+   */
+	bool	appendPages;
+
+  /**
+   * Handling of the nodes left underfull by deleteEntry.
+   */
+	DeletePolicy	deletePolicy;
+
+  /**
+   * Serializes the changes to the meta page and to the list of free pages.
+   */
+	std::mutex	metaMutex;
+
+  /**
+   * Latch of the structure of the tree. Insertions and the deletions that only latch their leaf hold it shared,
+   * the deletions that may merge nodes and compactions exclusively, so that splits are never concurrent with
+   * merges, and a node is never freed while an insertion may still follow a link to it. Lookups and scans do
+   * not take it.
+   */
+	FrameLatch	treeLatch;
+
+  /**
+   * True if the index is opened in INDEX_READ_ONLY_MAPPED mode.
+   */
+	bool		readOnly;
+
+  /**
+   * Mapping of the index file in INDEX_READ_ONLY_MAPPED mode, nullptr if the nodes are read through the
+   * buffer manager.
+   */
+	const char	*mapping;
+
+  /**
+   * Size of the mapping in bytes.
+   */
+	std::size_t	mappingSize;
+
+  /**
+   * Whether the non leaf nodes are cached, i.e. the index is not mapped.
+   */
+	bool	cacheNodes;
+
+  /**
+   * Node cache: the frames of the cached non leaf nodes by page number, latched by nodeCacheLatch. A cached
+   * node stays pinned by the cache, so a descent reads it without a pin. The descents holding cached nodes
+   * are counted in nodeCacheUsers, and the cache only unpins nodes while it has no user, so that a node
+   * read through the cache stays in its frame until the descent is done with it.
+   */
+	std::unordered_map<PageId, Page *>	cachedNodes;
+	FrameLatch	nodeCacheLatch;
+	std::atomic<std::uint32_t>	nodeCacheUsers;
+
+  /**
+   * Freed nodes taken out of the cache, still pinned until the cache has no user.
+   */
+	std::vector<PageId>	releasedNodes;
+	std::atomic<bool>	hasReleasedNodes;
+
+  /**
+   * Number of cached nodes.
+   */
+	std::atomic<std::size_t>	numCachedNodes;
+
+  /**
+   * Hot levels of an INTEGER or DOUBLE index, a HotLevels of its key type, nullptr until they are first built.
+   * They are replaced as a whole, and a lookup keeps those it started with alive.
+   */
+	std::shared_ptr<const HotLevelsBase>	hotLevels;
+
+  /**
+   * Number of descents made without the hot levels, or through them to a leaf split since they were built.
+   */
+	std::atomic<int>	hotLevelsMisses;
+
+  /**
+   * Held by the thread building the hot levels.
+   */
+	std::mutex	hotLevelsMutex;
+
+  /**
+   * Rightmost leaf as last seen by an insertion, INVALID_NUMBER if unknown. An insertion of a key past its
+   * last one goes straight to it without descending the tree. It is set while the tree latch is held shared,
+   * and reset whenever the latch is taken exclusively, since leaves are only freed then.
+   */
+	std::atomic<PageId>	appendLeafNum;
+
+  /**
+   * Insert buffer of the write-optimized mode, an InsertBuffer of the key type, nullptr if the mode is off.
+   */
+	std::unique_ptr<InsertBufferBase>	insertBuffer;
+
+  /**
+   * Number of entries the insert buffer holds before they are applied to the leaves.
+   */
+	std::size_t	insertBufferCapacity;
+
+  /**
+   * Whether the insert buffer is a delta index, which also holds deletions and is merged with the tree by scans.
+   */
+	bool	deltaMode;
+
+  /**
+   * Serializes the changes of the insert buffer. It is held while entries taken out of the buffer are
+   * applied, so that a lookup finds an entry in the buffer or in the tree.
+   */
+	std::mutex	insertBufferMutex;
+
+  /**
+   * Bloom filter of the keys of the index, which lookups check before reading any page, nullptr if none.
+   */
+	std::unique_ptr<KeyFilter>	lookupFilter;
+
+  /**
+   * Whether the operations are measured into metrics.
+   */
+	std::atomic<bool>	metricsEnabled;
+
+  /**
+   * Latency histograms and counters of the operations, recorded while metricsEnabled is set.
+   */
+	IndexMetrics	metrics;
+
+  /**
+   * Get the metrics to record an operation in, NULL if they are disabled.
+   */
+	IndexMetrics* activeMetrics()
+	{
+		return metricsEnabled.load(std::memory_order_relaxed) ? &metrics : NULL;
+	}
+
+
+	// MEMBERS SPECIFIC TO SCANNING
+
+  /**
+   * Cursor used by startScan, scanNext and endScan.
+   */
+	BTreeCursor	scanCursor;
+
+
+	// MEMBERS SPECIFIC TO BULK LOADING
+
+  /**
+   * Fraction of slots filled in each leaf and non leaf page packed by the bulk loader.
+   */
+	double	fillFactor;
+
+  /**
+   * Build the index bottom-up from the records of the base relation.
+   * The <rid, key> pairs are collected by a ParallelFileScan and sorted by each of its threads, spilling
+   * sorted runs to temporary files when they do not fit in the buffer pool. The runs are merged by a
+   * loser tree as the leaves are packed left to right, and each level of non leaf nodes is packed on top of the previous one
+   * until a single root is left. The meta page is updated once at the end.
+   * @param relationName Name of the base relation
+   * @param indexName Name of the index file, used to name the temporary run files
+   * @param headerPage Pinned meta page of the index file
+   */
+  template <class T>
+  void bulkLoad(const std::string &relationName, const std::string &indexName, Page *headerPage);
+
+  /**
+   * Scan the base relation with several threads and produce sorted runs of <rid, key> pairs.
+   * Each thread collects the pairs of the pages it scans, up to its share of the buffer pool budget.
+   * A thread whose share is used up sorts its pairs and writes them to a temporary file whose name
+   * is returned in runNames. The pairs left at the end are sorted and returned in memory, one run per
+   * thread. The included values of a covering index are collected in memory for all records.
+   * @param relationName Name of the base relation
+   * @param indexName Name of the index file
+   * @param runs Sorted runs kept in memory
+   * @param runNames Names of the spilled run files
+   * @param included Returned included values of the records in record ID order, empty if the index is not covering
+   * @return the total number of pairs
+   */
+  template <class T>
+  std::size_t sortRelation(const std::string &relationName, const std::string &indexName,
+                           std::vector<std::vector<RIDKeyPair<T>>> &runs, std::vector<std::string> &runNames,
+                           std::vector<IncludedValues> &included);
+
+  /**
+   * Write a sorted run to a temporary file.
+   * @param runName Name of the run file
+   * @param pairs Sorted pairs to write
+   */
+  template <class T>
+  void writeRun(const std::string &runName, const std::vector<RIDKeyPair<T>> &pairs);
+
+  /**
+   * Pack the sorted <rid, key> pairs into linked leaf pages.
+   * The pairs are k-way merged from the runs in memory and the run files.
+   * The entries of a key are never split between leaves, unless they do not fit in one, which only
+   * happens in a covering index.
+   * @param numPairs Total number of pairs
+   * @param runs Sorted runs kept in memory
+   * @param runNames Names of the spilled run files
+   * @param included Included values of the records in record ID order, empty if the index is not covering
+   * @param children Returned <pid, key> pairs of the leaves, the key being the first key of the leaf
+   */
+  template <class T>
+  void packLeaves(std::size_t numPairs, const std::vector<std::vector<RIDKeyPair<T>>> &runs,
+                  const std::vector<std::string> &runNames, const std::vector<IncludedValues> &included,
+                  std::vector<PageKeyPair<T>> &children);
+
+  /**
+   * Take the pairs of the next key from the sorted pairs for the bulk loader.
+   * Up to postingThreshold of them are returned as they are. The record IDs of a key with more are
+   * written to a posting list instead, and a single pair referring to it is returned.
+   * @param sorted Sorted pairs, not empty
+   * @param group Returned pairs of the key
+   */
+  template <class T>
+  void takeKeyGroup(SortedPairs<T> &sorted, std::vector<RIDKeyPair<T>> &group);
+
+  /**
+   * Pack one level of non leaf nodes on top of the given children.
+   * The key of each returned pair is the smallest key in the subtree of the node.
+   * @param children <pid, key> pairs of the level below
+   * @param level Level of the nodes to pack
+   * @param parents Returned <pid, key> pairs of the packed nodes
+   */
+  template <class T>
+  void packNonLeaves(const std::vector<PageKeyPair<T>> &children, int level,
+                     std::vector<PageKeyPair<T>> &parents);
+
+  /**
+   * Pack the levels of non leaf nodes on top of the leaves until a single root is left.
+   * The root is always a non leaf node, even if there is only one leaf.
+   * @param children <pid, key> pairs of the leaves, overwritten
+   * @return the page number of the root
+   */
+  template <class T>
+  PageId packUpperLevels(std::vector<PageKeyPair<T>> &children);
+
+  /**
+   * Number of entries to put in each of the pages when spreading entries evenly over them.
+   * @param numEntries Total number of entries
+   * @param capacity Maximum number of entries in a page
+   * @param minEntries Lower bound of the number of entries targeted in a page
+   * @return the number of pages
+   */
+  std::size_t numPackedPages(std::size_t numEntries, int capacity, int minEntries);
+
+  /**
+   * Initialize the header of an empty non leaf node.
+   * The key and page arrays are left untouched.
+   * @param nodePtr Non leaf node to initialize
+   * @param level Level of the node
+   */
+  template <class T>
+  void initNode(NonLeafNode<T> *nodePtr, int level);
+
+  /**
+   * Initialize the header of an empty leaf node.
+   * The key and record ID arrays are left untouched.
+   * @param leafPtr Leaf node to initialize
+   * @param rightSibPageNo Right sibling page ID
+   */
+  template <class T>
+  void initLeaf(LeafNode<T> *leafPtr, PageId rightSibPageNo);
+
+  /**
+   * Read a node page of the index, upgrading it in place if it is still in INDEX_FORMAT_V1.
+   * Only INTEGER indexes exist in INDEX_FORMAT_V1.
+   * An upgraded page is marked dirty, so callers may still unpin it as unmodified.
+   * @param pageNum Page ID of the node
+   * @param page Returned pinned page
+   * @param isLeaf Whether the page is a leaf node
+   */
+  void readNode(PageId pageNum, Page *&page, bool isLeaf);
+
+  /**
+   * Read a non leaf node for a descent from the node cache, or else pin it with readNode and add it to
+   * the cache if the buffer manager grants it a pin.
+   * @param pageNum Page ID of the node
+   * @param page Returned page
+   * @return whether the node is cached, in which case it is not pinned for the caller, who becomes a user of
+   * the cache until it releases the node
+   */
+  bool readCachedNode(PageId pageNum, Page *&page);
+
+  /**
+   * Release a node read by readCachedNode, unpinning it if it is not cached.
+   * @param pageNum Page ID of the node
+   * @param cached Whether the node is cached
+   */
+  void releaseCachedNode(PageId pageNum, bool cached)
+  {
+		if (!cached)
+		{
+			bufMgr->unPinPage(file, pageNum, false);
+		}
+		else if (nodeCacheUsers.fetch_sub(1) == 1 && hasReleasedNodes.load())
+		{
+			unpinReleasedNodes();
+		}
+  }
+
+  /**
+   * Unpin the nodes of the node cache and empty it.
+   */
+  void clearNodeCache();
+
+  /**
+   * Unpin the cached nodes and the released ones, the node cache being latched exclusively.
+   * @return number of nodes unpinned
+   */
+  std::uint32_t unpinCachedNodes();
+
+  /**
+   * Unpin the freed nodes taken out of the node cache, if it has no user.
+   */
+  void unpinReleasedNodes();
+
+  /**
+   * Take a node being freed out of the node cache, unpinning it once the cache has no user.
+   * @param pageNum Page ID of the node
+   */
+  void uncacheNode(PageId pageNum);
+
+  /**
+   * Read a page for a lookup or a scan, pinned in the buffer pool or in the mapping.
+   * @param pageNum Page number
+   * @param page Returned page
+   */
+  void readIndexPage(PageId pageNum, Page *&page);
+
+  /**
+   * Release a page read by readIndexPage, unpinning it if it is in the buffer pool.
+   * @param pageNum Page number
+   */
+  void releaseIndexPage(PageId pageNum);
+
+  /**
+   * Read a leaf for a lookup or a scan and latch it shared, unless it is in the mapping, which never changes.
+   * @param pageNum Page number
+   * @param page Returned page
+   */
+  void readLeafShared(PageId pageNum, Page *&page);
+
+  /**
+   * Release a leaf returned by readLeafShared or findLeafPageNum, latched shared.
+   * @param pageNum Page number
+   * @param page Leaf page
+   */
+  void releaseLeafShared(PageId pageNum, Page *page);
+
+  /**
+   * Read a non leaf node and latch it shared, unless it is in the mapping. It is released by releaseLeafShared.
+   * @param pageNum Page number
+   * @param page Returned page
+   */
+  void readNodeShared(PageId pageNum, Page *&page);
+
+  /**
+   * Auxiliary method of collectStats, specialized on the key type.
+   * @see collectStats
+   */
+  template <class T>
+  IndexStats collectStatsTyped(int numBuckets);
+
+  /**
+   * Auxiliary method of estimateRange, specialized on the key type.
+   * @see estimateRange
+   */
+  template <class T>
+  double estimateRangeTyped(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp);
+
+  /**
+   * Estimate the position of the cutoff of a bound among the entries of the index, descending to the leaf
+   * holding it: the share of the entries before the cutoff, each node on the path sharing its part evenly
+   * among its children.
+   * @tparam op Operator of the bound (LT/LTE/GTE/GT)
+   * @param val A given key value
+   * @return the position, from 0 to 1
+   */
+  template <Operator op, class T>
+  double estimatePosition(const T &val);
+
+  /**
+   * Get a page of the mapped index file.
+   * @param pageNum Page number
+   * @return the page in the mapping
+   */
+  Page *mappedPage(PageId pageNum) const
+  {
+		return (Page *)(mapping + (std::size_t)pageNum * Page::SIZE);
+  }
+
+  /**
+   * Map the index file in memory for INDEX_READ_ONLY_MAPPED mode, once its pages have been flushed by the
+   * buffer manager. The leaves are advised to be read randomly, and the non leaf nodes to be read ahead.
+   * An index from before INDEX_FORMAT_V2, whose nodes must be upgraded as they are read, is left unmapped,
+   * as is an index the system fails to map.
+   */
+  void mapFile();
+
+  /**
+   * Advise the kernel to read ahead the non leaf nodes of the mapped index, level by level from the root.
+   */
+  template <class T>
+  void adviseNonLeaves();
+
+  /**
+   * Throw if the index is opened read-only.
+   * @throws IndexReadOnlyException If the index is opened in INDEX_READ_ONLY_MAPPED mode
+   */
+  void checkWritable() const;
+
+  /**
+   * Upgrade an INDEX_FORMAT_V1 non leaf node by counting its keys up to the INVALID_NUMBER sentinel.
+   * @param nodeIntPtr Non leaf node to upgrade
+   * @return whether the node has been modified or not
+   */
+  bool upgradeNode(NonLeafNodeInt *nodeIntPtr);
+
+  /**
+   * Upgrade an INDEX_FORMAT_V1 leaf node by counting its entries up to the INVALID_NUMBER sentinel.
+   * @param leafIntPtr Leaf node to upgrade
+   * @return whether the leaf has been modified or not
+   */
+  bool upgradeLeaf(LeafNodeInt *leafIntPtr);
+
+  /**
+   * Find the page ID for the leftmost page with keys possibly GT/GTE the given value.
+   * This happens if the upper bound of the page is GT/GTE the given value.
+   * In the special case when the node has no key, the first page ID is returned.
+   * @tparam op Operator (GT/GTE)
+   * @param nodePtr Non leaf node to find in
+   * @param val A given key value
+   * @return the satisfying page ID
+   */
+  template <Operator op, class T>
+  PageId findPageNumInNode(NonLeafNode<T> *nodePtr, const T &val);
+
+  /**
+   * Find the child to descend into from a non leaf node read optimistically, i.e. without latching it.
+   * The keys are searched in place, their number being clamped to the key slots, so a concurrent change
+   * can only give a wrong child, which is told by validating the version of the node.
+   * If the node has been split since its parent was read, its right sibling is returned instead.
+   * @see findPageNumInNode
+   * @tparam op Operator (GT/GTE)
+   * @param nodePtr Non leaf node to find in
+   * @param latch Latch of the node
+   * @param version Version of the node read before the node
+   * @param val A given key value
+   * @param child Returned child page ID, or right sibling page ID
+   * @param slot Returned position of the child in the node
+   * @param level Returned level of the node
+   * @param right Returned whether the right sibling is returned
+   * @param bounded Set if the child is bounded above
+   * @param upperBound Returned upper bound of the child if bounded
+   * @return whether the node is unchanged, or the descent must restart
+   */
+  template <Operator op, class T>
+  bool findChildOptimistic(const NonLeafNode<T> *nodePtr, const FrameLatch &latch, std::uint64_t version,
+                           const T &val, PageId &child, int &slot, int &level, bool &right, bool &bounded,
+                           T &upperBound);
+
+  /**
+   * Overload for the slotted STRING nodes, whose key slots cannot be trusted while the node changes.
+   * The node is copied and validated before it is searched.
+   * @see findChildOptimistic
+   */
+  template <Operator op>
+  bool findChildOptimistic(const NonLeafNodeString *nodePtr, const FrameLatch &latch, std::uint64_t version,
+                           const StringKey &val, PageId &child, int &slot, int &level, bool &right,
+                           bool &bounded, StringKey &upperBound);
+
+  /**
+   * Find the leftmost leaf page with keys possibly GT/GTE the given value in the mapped index file.
+   * The mapped tree never changes, so the nodes are searched in place, without latching them or
+   * following right links.
+   * @see findLeafPageNum
+   * @tparam op Operator (GT/GTE)
+   * @param val A given key value
+   * @param leafPage Returned leaf page in the mapping
+   * @param bounded Returned whether the leaf is bounded above or is the rightmost leaf
+   * @param upperBound Returned (exclusive) upper bound of the leaf if bounded
+   * @param path If given, returned non leaf nodes the descent went down from, with the slots of their children
+   * @return the satisfying leaf page ID, INVALID_NUMBER if the root has no leaf
+   */
+  template <Operator op, class T>
+  PageId findLeafMapped(const T &val, Page *&leafPage, bool &bounded, T &upperBound, DescentStack *path = nullptr);
+
+  /**
+   * Find the leftmost leaf page with keys possibly GT/GTE the given value through the hot levels, latched shared.
+   * A lookup or a scan goes straight to its leaf, which is the only page it reads from the buffer pool. The
+   * leaf is checked against the version of the hot levels once it is latched, so no merge can have emptied it.
+   * Once enough descents have gone without valid hot levels, they are rebuilt.
+   * @see findLeafPageNum
+   * @param leafPageNum Returned leaf page ID
+   * @return whether the leaf was found, false if the hot levels are not valid
+   */
+  template <Operator op, class T>
+  bool findLeafHot(const T &val, PageId &leafPageNum, Page *&leafPage, bool &bounded, T &upperBound);
+
+  /**
+   * Copy the level of the non leaf nodes right above the leaves into the hot levels, following their right
+   * links from the leftmost one. The tree latch is held shared, so no node is merged meanwhile.
+   * Nothing is done if another thread is building them, or if they would take more than HOT_LEVELS_MAX_BYTES.
+   */
+  template <class T>
+  void buildHotLevels();
+
+  /**
+   * Find the leftmost leaf page with keys possibly GT/GTE the given value, i.e. descend from the root into
+   * the leftmost pages whose upper bounds are GT/GTE the given value.
+   * In the special case when the root has no key, the first leaf page ID is returned.
+   * The non leaf nodes are read optimistically. The version of a child is read before its parent is
+   * validated once more, so the child was still linked when it started to be read. The descent restarts
+   * from the root on any change. A node split since its parent was read is left through its right link,
+   * latching the right sibling of a leaf before releasing it.
+   * The upper bound of the keys that can be found in the leaf is returned as well.
+   * In INDEX_READ_ONLY_MAPPED mode, the descent is that of findLeafMapped.
+   * @tparam op Operator (GT/GTE)
+   * @param val A given key value
+   * @param leafPage Returned pinned leaf page latched shared, or exclusively
+   * @param bounded Returned whether the leaf is bounded above or is the rightmost leaf
+   * @param upperBound Returned (exclusive) upper bound of the leaf if bounded
+   * @param exclusive Whether to latch the leaf exclusively
+   * @param path If given, returned non leaf nodes the descent went down from, with the slots of their children
+   * @return the satisfying leaf page ID, INVALID_NUMBER if the root has no leaf
+   */
+  template <Operator op, class T>
+  PageId findLeafPageNum(const T &val, Page *&leafPage, bool &bounded, T &upperBound,
+                         bool exclusive = false, DescentStack *path = nullptr);
+
+  /**
+   * Follow the right links from a latched node as long as the keys GT/GTE the given value lie right of it.
+   * Each right sibling is latched before the node is released, so a merge, which latches the left node
+   * first, cannot free it meanwhile.
+   * @tparam op Operator (GT/GTE)
+   * @tparam N Leaf or non leaf node type
+   * @param pageNum Page ID of the node. Returned page ID of the node reached
+   * @param page Pinned and latched page of the node. Returned pinned and latched page of the node reached
+   * @param val A given key value
+   * @param isLeaf Whether the node is a leaf
+   * @param exclusive Whether the node is latched exclusively or shared
+   */
+  template <Operator op, class N, class T>
+  void moveRight(PageId &pageNum, Page *&page, const T &val, bool isLeaf, bool exclusive);
+
+  /**
+   * Pin the root page and latch it exclusively, trying again if the root has been replaced meanwhile.
+   * @param rootPage Returned pinned root page
+   * @return the root page ID
+   */
+  PageId latchRoot(Page *&rootPage);
+
+  /**
+   * Release the latches of the pages latched exclusively on a path from the root, and clear it.
+   * The pages stay pinned.
+   * @param latched Latched pages, from the top
+   */
+  void unlatchPath(std::vector<Page *> &latched);
+
+  /**
+   * Find the record ID of the given key in the leaf node.
+   * @param leafPtr Leaf node to find in
+   * @param key A given key value
+   * @param outRid Returned record ID if found
+   * @return whether the key is found or not
+   */
+  template <class T>
+  bool findInLeaf(LeafNode<T> *leafPtr, const T &key, RecordId &outRid);
+
+  /**
+   * Write the root page number and the first free page number to the meta page.
+   * The caller holds metaMutex.
+   */
+  void writeMetaInfo();
+
+  /**
+   * Allocate a page for a node or a posting list, reusing a free page if any.
+   * A reused page is zeroed like a newly allocated one.
+   * @param pageNum Returned page ID
+   * @param page Returned pinned page
+   */
+  void allocIndexPage(PageId &pageNum, Page *&page);
+
+  /**
+   * Add an unpinned page that is no longer part of the tree to the list of free pages.
+   * The page is latched while its link is written, so that readers still holding it pinned see a new version.
+   * @param pageNum Page ID of the freed page
+   */
+  void freeIndexPage(PageId pageNum);
+
+  /**
+   * Allocate and initialize an empty posting page, left pinned.
+   * @param pageNum Returned page ID
+   * @param postingPtr Returned posting page
+   */
+  void allocPostingPage(PageId &pageNum, PostingPage *&postingPtr);
+
+  /**
+   * Append a record ID to the posting list being built, whose last page is kept pinned.
+   * A new last page is allocated when the list is empty or its last page is full.
+   * @param tailPageNum Page ID of the last page, INVALID_NUMBER for an empty list. Updated
+   * @param tailPtr Last page. Updated
+   * @param rid Record ID, not less than those in the list
+   */
+  void appendPosting(PageId &tailPageNum, PostingPage *&tailPtr, const RecordId &rid);
+
+  /**
+   * Insert a record ID in a posting list, in record ID order.
+   * A full page is split in halves, except when appending past its last record ID, which starts a new page.
+   * The first page of the list never changes.
+   * @param headPageNum Page ID of the first page of the list
+   * @param rid Record ID to insert
+   */
+  void insertPosting(PageId headPageNum, const RecordId &rid);
+
+  /**
+   * Get the first record ID of a posting list.
+   * @param headPageNum Page ID of the first page of the list
+   * @return the smallest record ID of the list
+   */
+  RecordId firstPosting(PageId headPageNum);
+
+  /**
+   * Remove a record ID from the posting list referred to by a leaf entry.
+   * An emptied page is freed. A list left with a single record ID is freed as well,
+   * that record ID being folded back into the leaf entry.
+   * @param ref Record ID of the leaf entry referring to the list. Updated
+   * @param rid Record ID to remove
+   * @return whether the record ID has been found or not
+   */
+  bool erasePosting(RecordId &ref, const RecordId &rid);
+
+  /**
+   * Auxiliary method of insertPageKeyPair.
+   * Insert the specified <pid, key> pair into the non leaf node at the position.
+   * It assumes the non leaf node to have enough space.
+   * Note that the key corresponds to the lower bound of the page.
+   * @param nodePtr Non leaf node to insert into
+   * @param pk <pid, key> pair to insert
+   * @param pos Insert position
+   */
+  template<class T>
+  void insertPageKeyPairAux(NonLeafNode<T> *nodePtr, const PageKeyPair<T> &pk, int pos);
+
+  /**
+   * Auxiliary method of insertRIDKeyPair.
+   * Insert the specified <rid, key> pair into the leaf node at the postion.
+   * It assumes the leaf node to have enough space.
+   * @param leafPtr Leaf node to insert into
+   * @param rk <rid, key> pair to insert
+   * @param pos Insert position
+   * @param included Included values of the entry in a covering index
+   */
+  template <class T>
+  void insertRIDKeyPairAux(LeafNode<T> *leafPtr, const RIDKeyPair<T> &rk, int pos, const char *included);
+
+  /**
+   * Move consecutive entries, with their included values, within a leaf or to another leaf.
+   * The source and destination entries may overlap.
+   * @param dstPtr Leaf node to move to
+   * @param dstPos Position of the first entry moved in dstPtr
+   * @param srcPtr Leaf node to move from
+   * @param srcPos Position of the first entry to move in srcPtr
+   * @param cnt Number of entries to move
+   */
+  template <class T>
+  void moveLeafEntries(LeafNode<T> *dstPtr, int dstPos, const LeafNode<T> *srcPtr, int srcPos, int cnt);
+
+  /**
+   * Get the included values of an entry of a leaf of a covering index.
+   * @param leafPtr Leaf node
+   * @param pos Position of the entry
+   * @return the includedWidth bytes of the values
+   */
+  char *includedValues(const void *leafPtr, int pos) const
+  {
+		return (char *)leafPtr + includedOffset + pos * includedWidth;
+  }
+
+  /**
+   * Copy the included attributes of a record, packed in their order.
+   * @param record Record of the base relation
+   * @param values Returned includedWidth bytes of the values
+   */
+  void loadIncluded(const char *record, char *values) const;
+
+  /**
+   * Read a key passed to the index: a pointer to integer / double / char string, or to an encoded
+   * StringKey for a composite index.
+   * @param ptr Pointer to the key
+   * @param key Returned key
+   */
+  template <class T>
+  void readKey(const void *ptr, T &key) const
+  {
+		loadKey(ptr, key);
+  }
+
+  void readKey(const void *ptr, StringKey &key) const
+  {
+		if (keyColumns.empty())
+		{
+			loadKey(ptr, key);
+			return;
+		}
+		const auto *encoded = (const StringKey *)ptr;
+		key.length = encoded->length;
+		memcpy(key.data, encoded->data, key.length);
+  }
+
+  /**
+   * Read the key of a record of the base relation.
+   * @param record Record of the base relation
+   * @param key Returned key
+   */
+  template <class T>
+  void loadRecordKey(const char *record, T &key) const
+  {
+		loadKey(record + attrByteOffset, key);
+  }
+
+  void loadRecordKey(const char *record, StringKey &key) const
+  {
+		if (keyColumns.empty())
+		{
+			loadKey(record + attrByteOffset, key);
+			return;
+		}
+		encodeRecordKey(record, key);
+  }
+
+  /**
+   * Remove consecutive entries from the leaf node.
+   * @param leafPtr Leaf node to remove from
+   * @param pos Position of the first entry to remove
+   * @param cnt Number of entries to remove
+   */
+  template <class T>
+  void eraseRIDKeyPairsAux(LeafNode<T> *leafPtr, int pos, int cnt);
+
+  /**
+   * Remove consecutive entries from the INTEGER leaf node, which stays packed if it is.
+   * @see eraseRIDKeyPairsAux
+   */
+  void eraseRIDKeyPairsAux(LeafNodeInt *leafPtr, int pos, int cnt);
+
+  /**
+   * Auxiliary method of insertRIDKeyPair.
+   * Find where to insert the <rid, key> pair among the entries of an equal key, in record ID order.
+   * If the key already has a posting list, or would have more than postingThreshold entries,
+   * the record ID goes to its posting list instead and the leaf does not grow.
+   * @param leafPtr Leaf node to insert into
+   * @param rk <rid, key> pair to insert
+   * @param pos Returned insert position in the leaf, or -1 if the record ID went to an existing posting
+   * list and the leaf is unchanged
+   * @return whether the record ID has been inserted in a posting list
+   */
+  template <class T>
+  bool insertDuplicateRID(LeafNode<T> *leafPtr, const RIDKeyPair<T> &rk, int &pos);
+
+  /**
+   * Auxiliary method of insertRIDKeyPair.
+   * Choose where to split a full leaf, so that the entries of a key stay in the same leaf if possible.
+   * @param leafPtr Full leaf node
+   * @param pos Insert position of the new entry
+   * @param key Key of the new entry
+   * @return the number of entries, counting the new one, kept in the original leaf
+   */
+  template <class T>
+  int chooseLeafSplit(LeafNode<T> *leafPtr, int pos, const T &key);
+
+  /**
+   * Auxiliary method of insertEntry.
+   * Latch exclusively the rightmost leaf seen by the last insertions, if the given key goes past its last key.
+   * @param key Key to insert
+   * @param pageNum Returned page number of the leaf
+   * @param page Returned pinned page of the leaf, latched exclusively
+   * @return whether the key goes to the leaf or not, the tree then being descended
+   */
+  template <class T>
+  bool findAppendLeaf(const T &key, PageId &pageNum, Page *&page);
+
+  /**
+   * Insert the specified <pid, key> pair into the non leaf node.
+   * If the non leaf node is full, it will be split with a retrned pushed up <pid, key> pair.
+   * @param nodePtr Non leaf node to insert into
+   * @param pk1 <pid, key> pair to insert
+   * @param pk2 <pid, key> pair to copy up
+   * @param pos Position to insert if known from the descent, or -1 to search it
+   * @return whether the insertion completes without split or not
+   */
+  template <class T>
+  bool insertPageKeyPair(NonLeafNode<T> *nodePtr, const PageKeyPair<T> &pk1, PageKeyPair<T> &pk2, int pos);
+
+  /**
+   * Insert the specified <rid, key> pair into the leaf node.
+   * Entries with equal keys are kept in record ID order.
+   * If the leaf node is full, it will be split with a retrned copied up <pid, key> pair.
+   * @param leafPtr Leaf node to insert into
+   * @param rk <rid, key> pair to insert
+   * @param pk <pid, key> pair to copy up
+   * @param dirty Returned whether the leaf has changed, which it has not if only a posting list has
+   * @param included Included values of the entry in a covering index
+   * @return whether the insertion completes without split or not
+   */
+  template <class T>
+  bool insertRIDKeyPair(LeafNode<T> *leafPtr, const RIDKeyPair<T> &rk, PageKeyPair<T> &pk, bool &dirty,
+                        const char *included);
+
+  /**
+   * Insert a <rid, key> pair into a packed leaf, rewriting its entries unpacked.
+   * Those that do not fit in it are moved to a new split leaf, as a leaf split does.
+   * @param leafPtr Packed leaf node to insert into
+   * @param rk <rid, key> pair to insert
+   * @param pk Returned <pid, key> pair of the split leaf, if any
+   * @return whether the insertion completes without split or not
+   */
+  template <class T>
+  bool unpackLeaf(LeafNode<T> *leafPtr, const RIDKeyPair<T> &rk, PageKeyPair<T> &pk);
+
+  /**
+   * Remove the key pos and the page number that follows it from the non leaf node.
+   * @param nodePtr Non leaf node to remove from
+   * @param pos Position of the key
+   */
+  template <class T>
+  void erasePageKeyPairAux(NonLeafNode<T> *nodePtr, int pos);
+
+  /**
+   * Check whether a leaf node holds less than UNDERFLOW_FILL_FACTOR of its key slots.
+   * @param leafPtr Leaf node
+   * @return whether it is underfull or not
+   */
+  template <class T>
+  bool isUnderfull(const LeafNode<T> *leafPtr);
+
+  /**
+   * Check whether a non leaf node holds less than UNDERFLOW_FILL_FACTOR of its key slots.
+   * @param nodePtr Non leaf node
+   * @return whether it is underfull or not
+   */
+  template <class T>
+  bool isUnderfull(const NonLeafNode<T> *nodePtr);
+
+  /**
+   * Check whether removing an entry from a leaf node cannot leave it underfull, or does not matter
+   * with DELETE_LAZY.
+   * @param leafPtr Leaf node
+   * @return whether the leaf is safe or not
+   */
+  template <class T>
+  bool isMergeSafe(const LeafNode<T> *leafPtr);
+
+  /**
+   * Check whether a merge of two children of a non leaf node cannot leave it underfull,
+   * or does not matter with DELETE_LAZY.
+   * @param nodePtr Non leaf node
+   * @return whether the node is safe or not
+   */
+  template <class T>
+  bool isMergeSafe(const NonLeafNode<T> *nodePtr);
+
+  /**
+   * Remove the specified <rid, key> pair from the leaf node, or from the posting list of the key.
+   * @param leafPtr Leaf node to remove from
+   * @param rk <rid, key> pair to remove
+   * @return whether the pair has been found or not
+   */
+  template <class T>
+  bool eraseRIDKeyPair(LeafNode<T> *leafPtr, const RIDKeyPair<T> &rk);
+
+  /**
+   * Merge two adjacent leaves if their entries fit in one, or otherwise spread the entries evenly
+   * between them without splitting the entries of a key if possible.
+   * The right leaf of a merge is left empty, and its key and page number are removed from the parent.
+   * @param leftPtr Left leaf
+   * @param rightPtr Right leaf
+   * @param parentPtr Parent non leaf node
+   * @param pos Position of the key separating the leaves in the parent
+   * @return whether the leaves have been merged or not
+   */
+  template <class T>
+  bool rebalanceLeaves(LeafNode<T> *leftPtr, LeafNode<T> *rightPtr, NonLeafNode<T> *parentPtr, int pos);
+
+  /**
+   * Merge two adjacent non leaf nodes, pulling down the key separating them, if their keys fit in one.
+   * Otherwise spread the keys evenly between them through the parent.
+   * @see rebalanceLeaves
+   * @param leftPtr Left non leaf node
+   * @param rightPtr Right non leaf node
+   * @param parentPtr Parent non leaf node
+   * @param pos Position of the key separating the nodes in the parent
+   * @return whether the nodes have been merged or not
+   */
+  template <class T>
+  bool rebalanceNodes(NonLeafNode<T> *leftPtr, NonLeafNode<T> *rightPtr, NonLeafNode<T> *parentPtr, int pos);
+
+  /**
+   * Fix an underfull child of the non leaf node with its right sibling, or its left sibling if it is the
+   * last child. A page emptied by a merge is freed. Both siblings are latched exclusively, the left one first.
+   * @param nodePtr Non leaf node, latched exclusively
+   * @param pos Position of the underfull child
+   * @return whether the child has been merged with its sibling or not
+   */
+  template <class T>
+  bool fixUnderflow(NonLeafNode<T> *nodePtr, int pos);
+
+  /**
+   * Auxiliary method of deleteEntry.
+   * Remove the specified <rid, key> pair recursively starting from the non leaf node.
+   * The children that may hold the key are tried from the one an insertion goes into, leftwards.
+   * With DELETE_EAGER, a child left underfull is fixed on the way back up.
+   * The child is latched exclusively before it is modified. The latches of the ancestors, which it cannot
+   * modify, are released once the child is safe and is the last one to try.
+   * @param nodePtr Non leaf node to start from, latched exclusively unless an ancestor of it is safe
+   * @param rk <rid, key> pair to remove
+   * @param latched Pages latched exclusively on the path from the root
+   * @return whether the pair has been found or not
+   */
+  template <class T>
+  bool deleteEntryAux(NonLeafNode<T> *nodePtr, const RIDKeyPair<T> &rk, std::vector<Page *> &latched);
+
+  /**
+   * Auxiliary method of compact.
+   * Fix the underfull nodes of the subtree rooted at the non leaf node, bottom-up.
+   * The children are latched exclusively while their subtrees are compacted.
+   * @param nodePtr Non leaf node to start from, latched exclusively
+   * @return whether the node has been modified or not
+   */
+  template <class T>
+  bool compactAux(NonLeafNode<T> *nodePtr);
+
+  /**
+   * Replace the root by its child as long as it has a single non leaf child. The old roots are freed.
+   * The child is latched before the root is replaced, and the old root released after.
+   * @param rootPageNo Page ID of the root page. Returned page ID of the new root page
+   * @param rootPage Pinned root page latched exclusively, which is unpinned. Returned pinned new root page latched exclusively
+   */
+  template <class T>
+  void collapseRoot(PageId &rootPageNo, Page *&rootPage);
+
+  /**
+   * Overloads of the node methods above for the slotted STRING nodes.
+   * A node is full when the key does not fit in its free bytes instead of its key slots. A split divides
+   * the bytes of the entries evenly, preferring the shortest key to push up among nearly even splits.
+   * A leaf split copies up the shortest separator between the halves instead of the first key of the split leaf.
+   * Equal keys of a leaf share their bytes, so their entries take only the record IDs and key slots.
+   * A node is underfull when it uses less than UNDERFLOW_FILL_FACTOR of its bytes. Redistributing between
+   * siblings is given up if the new separator does not fit in the parent. A node is safe for a
+   * deletion when it uses enough bytes for any entry to be removed from it without underflowing.
+   * The bulk loader fills the pages up to the fill factor of their bytes.
+   */
+  void initNode(NonLeafNodeString *nodePtr, int level);
+  void initLeaf(LeafNodeString *leafPtr, PageId rightSibPageNo);
+  void insertPageKeyPairAux(NonLeafNodeString *nodePtr, const PageKeyPair<StringKey> &pk, int pos);
+  void insertRIDKeyPairAux(LeafNodeString *leafPtr, const RIDKeyPair<StringKey> &rk, int pos);
+  void eraseRIDKeyPairsAux(LeafNodeString *leafPtr, int pos, int cnt);
+  void erasePageKeyPairAux(NonLeafNodeString *nodePtr, int pos);
+  bool isUnderfull(const LeafNodeString *leafPtr);
+  bool isUnderfull(const NonLeafNodeString *nodePtr);
+  bool isMergeSafe(const LeafNodeString *leafPtr);
+  bool isMergeSafe(const NonLeafNodeString *nodePtr);
+  bool rebalanceLeaves(LeafNodeString *leftPtr, LeafNodeString *rightPtr, NonLeafNodeString *parentPtr, int pos);
+  bool rebalanceNodes(NonLeafNodeString *leftPtr, NonLeafNodeString *rightPtr, NonLeafNodeString *parentPtr, int pos);
+  bool insertPageKeyPair(NonLeafNodeString *nodePtr, const PageKeyPair<StringKey> &pk1, PageKeyPair<StringKey> &pk2,
+                         int pos);
+  bool insertRIDKeyPair(LeafNodeString *leafPtr, const RIDKeyPair<StringKey> &rk, PageKeyPair<StringKey> &pk,
+                        bool &dirty, const char *included);
+  void packLeaves(std::size_t numPairs, const std::vector<std::vector<RIDKeyPair<StringKey>>> &runs,
+                  const std::vector<std::string> &runNames, const std::vector<IncludedValues> &included,
+                  std::vector<PageKeyPair<StringKey>> &children);
+  void packNonLeaves(const std::vector<PageKeyPair<StringKey>> &children, int level,
+                     std::vector<PageKeyPair<StringKey>> &parents);
+
+  /**
+   * Overload of packLeaves for INTEGER indexes, packing the leaves if setBulkLoadPacking is on
+   * and the index is not covering. Each leaf takes the entries of whole keys as long as they fit packed,
+   * up to the fill factor of one entry less than two leaves, so that unpacking it never overflows
+   * the two leaves of its split. A leaf starting with a posting list, or holding no more entries than
+   * a leaf, is left unpacked.
+   * @see packLeaves
+   */
+  void packLeaves(std::size_t numPairs, const std::vector<std::vector<RIDKeyPair<int>>> &runs,
+                  const std::vector<std::string> &runNames, const std::vector<IncludedValues> &included,
+                  std::vector<PageKeyPair<int>> &children);
+
+  /**
+   * Choose where to split the entries of a slotted STRING node.
+   * @param keys Sorted keys of the node, including the one being inserted
+   * @param leaf Whether the node is a leaf, the keys from the split position on going to the split leaf.
+   *             Otherwise the key at the split position is pushed up, the keys after it going to the split node.
+   *             A leaf is split between different keys if possible
+   * @return the split position
+   */
+  int chooseStringSplit(const std::vector<StringKey> &keys, bool leaf);
+
+  /**
+   * Auxiliary method of insertEntry, specialized on the key type.
+   * @param key			Key to insert, pointer to integer/double/char string
+   * @param rid			Record ID of a record whose entry is getting inserted into the index.
+   * @param included	Included values of the entry in a covering index
+   */
+  template <class T>
+  void insertEntryTyped(const void* key, const RecordId rid, const char* included);
+
+  /**
+   * Insert the key pushed up by the split of a node into its parent, splitting the parent in turn up to
+   * the root if it is full. The split node is released before its parent is latched.
+   * @param curPageNum	Page number of the split node, latched exclusively and pinned
+   * @param curPage			Page of the split node
+   * @param pushed			<pid, key> pair pushed up by the split
+   * @param path				Non leaf nodes the descent to the split node went down from
+   */
+  template <class T>
+  void insertPushedUp(PageId curPageNum, Page *curPage, PageKeyPair<T> pushed, DescentStack &path);
+
+  /**
+   * Auxiliary method of insertEntries, specialized on the key type.
+   * @see insertEntries
+   */
+  template <class T>
+  void insertEntriesTyped(const void* keys, const RecordId* rids, std::size_t n, const char* included);
+
+  /**
+   * Insert entries in key order, the run of entries of a leaf sharing a descent. Used by insertEntries and
+   * by the insert buffer.
+   * @param entries		Entries to insert
+   * @param included	Included values of the entries in a covering index, packed in the order of the entries
+   */
+  template <class T>
+  void insertPairs(const std::vector<RIDKeyPair<T>> &entries, const char* included);
+
+  /**
+   * Add an entry to the insert buffer, applying the whole buffer to the leaves once it is full.
+   * @param rk				<rid, key> pair to insert
+   * @param included	Included values of the entry in a covering index
+   */
+  template <class T>
+  void bufferEntry(const RIDKeyPair<T> &rk, const char* included);
 
   /**
-   * True if an index scan has been started.
+   * Record the deletion of an entry in the delta index, removing its insertion if it is buffered, applying
+   * the whole delta to the tree once it is full.
+   * @param rk				<rid, key> pair to delete
+	 * @return false if the entry is already deleted in the delta, true otherwise
    */
-	bool		scanExecuting;
+  template <class T>
+  bool bufferDeletion(const RIDKeyPair<T> &rk);
 
   /**
-   * Index of next entry to be scanned in current leaf being scanned.
+   * Append an entry to the insert buffer, sorting the unsorted entries into a run once there are
+   * INSERT_BUFFER_TAIL of them. The caller holds insertBufferMutex.
+   * @param rk				<rid, key> pair of the entry
+   * @param op				Operation of the entry
+   * @param included	Included values of the entry in a covering index
    */
-	int			nextEntry;
+  template <class T>
+  void appendBuffered(const RIDKeyPair<T> &rk, std::uint8_t op, const char* included);
 
   /**
-   * Page number of current page being scanned.
+   * Sort the unsorted entries of the insert buffer into a run, then merge the runs from the newest as long
+   * as a run is as large as the one before it, or all of them into one. The entries taken out of the buffer
+   * are dropped from the runs merged. The caller holds insertBufferMutex.
+   * @param all			Whether to merge all the runs into one
    */
-	PageId	currentPageNum;
+  template <class T>
+  void mergeBufferRuns(bool all);
 
   /**
-   * Current Page being scanned.
+   * Find an entry of the insert buffer, probing each run and the unsorted entries. The caller holds
+   * insertBufferMutex.
+   * @param rk			<rid, key> pair of the entry
+	 * @return the position of the entry, the number of entries of the buffer if it is not there
    */
-	Page		*currentPageData;
+  template <class T>
+  std::size_t findBufferedPair(const RIDKeyPair<T> &rk);
 
   /**
-   * Low INTEGER value for scan.
+   * Take the entries of the insert buffer between two positions out of it and apply them to the tree,
+   * the deletions first. The buffer is merged into one run, and the caller holds insertBufferMutex.
+   * @param first		Position of the first entry
+   * @param last		Position past the last entry
    */
-	int			lowValInt;
+  template <class T>
+  void applyBuffered(std::size_t first, std::size_t last);
 
   /**
-   * Low DOUBLE value for scan.
+   * Apply the entries of the insert buffer between two keys to the leaves, removing them from the buffer.
+   * @param lowKey		Lowest key applied, nullptr for no bound
+   * @param highKey		Highest key applied, nullptr for no bound
    */
-	double	lowValDouble;
+  template <class T>
+  void flushBuffered(const T* lowKey, const T* highKey);
 
   /**
-   * Low STRING value for scan.
+   * Find an entry with the given key in the insert buffer. The caller holds insertBufferMutex.
+   * @param key			Key to find
+   * @param outRid	RecordId of the entry found returned in this
+   * @param deleted	Set if the delta index holds the deletion of an entry of the tree with the key
+	 * @return whether such entry is buffered
    */
-	std::string	lowValString;
+  template <class T>
+  bool findBuffered(const T &key, RecordId &outRid, bool &deleted);
 
   /**
-   * High INTEGER value for scan.
+   * Find an entry with the given key by a scan, which merges the tree with the delta index.
+   * @param key			Key to find
+   * @param outRid	RecordId of the entry found returned in this
+	 * @return whether such entry exists
    */
-	int			highValInt;
+  bool lookupMerged(const void *key, RecordId &outRid);
 
   /**
-   * High DOUBLE value for scan.
+   * Delete an entry from the tree, bypassing the insert buffer.
+   * @param rk			<rid, key> pair to delete
+	 * @return whether the entry was found
    */
-	double	highValDouble;
+  template <class T>
+  bool deletePair(const RIDKeyPair<T> &rk);
 
   /**
-   * High STRING value for scan.
+   * Remove an entry from the insert buffer.
+   * @param rk			<rid, key> pair to remove
+	 * @return whether the entry was buffered
    */
-	std::string highValString;
-	
+  template <class T>
+  bool eraseBuffered(const RIDKeyPair<T> &rk);
+
   /**
-   * Low Operator. Can only be GT(>) or GTE(>=).
+   * Auxiliary method of lookup, specialized on the key type.
+   * @param key			Key to find, pointer to integer/double/char string
+   * @param outRid	RecordId of the entry found returned in this
+	 * @return whether such entry exists or not
    */
-	Operator	lowOp;
+  template <class T>
+  bool lookupTyped(const void* key, RecordId& outRid);
 
   /**
-   * High Operator. Can only be LT(<) or LTE(<=).
+   * Auxiliary method of deleteEntry, specialized on the key type.
+   * @see deleteEntry
    */
-	Operator	highOp;
+  template <class T>
+  bool deleteEntryTyped(const void* key, const RecordId rid);
 
   /**
-   * Clear the non leaf node with the specified information.
-   * It resets the level, keys, and the pages.
-   * Keys will be cleared from index st to ed - 1.
-   * Pages will be cleared from index st to ed.
-   * @param nodeIntPtr Non leaf node to clear
-   * @param level Level to reset
-   * @param st (Inclusive) lower bound to clear
-   * @param ed (Exclusive) upper bound to clear 
+   * Auxiliary method of compact, specialized on the key type.
    */
-  void clearNode(NonLeafNodeInt *nodeIntPtr, int level, int st, int ed);
+  template <class T>
+  void compactTyped();
 
   /**
-   * Clear the leaf node with the specified information.
-   * It resets the right sibling page ID, keys, and the record IDs.
-   * Keys will be cleared from index st to ed - 1.
-   * Record IDs will be cleared from index st to ed - 1.
-   * @param leafIntPtr Leaf node to clear
-   * @param rightSibPageNo Right sibling page ID to reset
-   * @param st (Inclusive) lower bound to clear
-   * @param ed (Exclusive) upper bound to clear 
+   * Auxiliary method of rebuild, specialized on the key type.
    */
-  void clearLeaf(LeafNodeInt *leafIntPtr, PageId rightSibPageNo, int st, int ed);
+  template <class T>
+  void rebuildTyped(const double targetFill);
 
   /**
-   * Find the page ID for the leftmost page with keys possibly GT/GTE the given value.
-   * This happens if the upper bound of the page is GT/GTE the given value.
-   * In the special case when the node has no key, the first page ID is returned.
-   * @param nodeIntPtr Non leaf node to find in
-   * @param val A given key value
-   * @param op Operator (GT/GTE)
-   * @return the satisfying page ID
+   * Auxiliary method of lookupBatch, specialized on the key type.
+   * @see lookupBatch
    */
-  PageId findPageNumInNode(NonLeafNodeInt *nodeIntPtr, int val, Operator op);
+  template <class T>
+  std::size_t lookupBatchTyped(const void* keys, std::size_t n, RecordId* outRids, bool* found);
 
   /**
-   * Find the page ID for the leftmost leaf page with keys possibly GT/GTE the given value.
-   * This happens if the upper bounds of the recursively found pages are GT/GTE the given value.
-   * In the special case when the root has no key, the first leaf page ID is returned.
-   * @param val A given key value
-   * @param op Operator (GT/GTE)
-   * @return the satisfying leaf page ID
+   * Auxiliary method of lookupBatchAll, specialized on the key type.
+   * @see lookupBatchAll
    */
-  PageId findLeafPageNum(int val, Operator op);
+  template <class T>
+  std::size_t lookupBatchAllTyped(const void* keys, std::size_t n, std::vector<std::pair<std::size_t, RecordId>>& out);
 
   /**
-   * Update the next entry with a key that lies within the search bound.
-   * The corresponding current page and page ID will be updated as well.
-   * A starting current page should possibly contain keys satisfying the lower search bound.
-   * The current page will be set to invalid if such entry does not exist.
-   * For convenience, the invalid next entry has an index -1.
-   * @return whether such entry exist or not.
+   * Auxiliary method of setLookupFilter, specialized on the key type: add the keys of the leaves, from the
+   * leftmost one along the right links, to a new filter.
+   * @see setLookupFilter
    */
-	bool updateScanEntry();
+  template <class T>
+  void setLookupFilterTyped(int bitsPerKey);
 
   /**
-   * Auxiliary method of insertPageKeyPair.
-   * Insert the specified <pid, key> pair into the non leaf node at the position.
-   * It assumes the non leaf node to have enough space.
-   * Note that the key corresponds to the upper bound of the page.
-   * @param nodeIntPtr Non leaf node to insert into
-   * @param m Number of valid keys
-   * @param pk <pid, key> pair to insert
-   * @param pos Insert position
+   * Check whether the lookup filter rules a key out.
+   * @param key			Key
+   * @return true if the index has a lookup filter, not saturated, which never had the key added
    */
-  template<class T>
-  void insertPageKeyPairAux(NonLeafNodeInt *nodeIntPtr, int m, const PageKeyPair<T> &pk, int pos);
+  template <class T>
+  bool filteredOut(const T &key) const;
 
   /**
-   * Auxiliary method of insertRIDKeyPair.
-   * Insert the specified <rid, key> pair into the leaf node at the postion.
-   * It assumes the leaf node to have enough space.
-   * @param leafIntPtr Leaf node to insert into
-   * @param m Number of valid keys
-   * @param rk <rid, key> pair to insert
-   * @param pos Insert position
+   * Find the keys of a batch in the tree by interleaved descents, LOOKUP_INTERLEAVE of them in flight.
+   * Each round, every descent searches the node it pinned in the previous round and pins the child to go
+   * into, prefetching it into the cache. The leaves missing from the buffer pool are read together first,
+   * so their reads overlap. A descent reads its nodes optimistically as findLeafPageNum does, and starts
+   * again from the root if one has changed. Once at its leaf, it probes the next keys of the batch which
+   * fall into it as well.
+   * @param keyTs Keys of the batch
+   * @param order Positions of the keys, in key order
+   * @param skip Whether each key is already settled
+   * @param outRids Array of record IDs, the i-th being set to that of the i-th key if found
+   * @param found Array of flags, the i-th being set to whether the i-th key is found or not
+   * @return the number of keys found
    */
   template <class T>
-  void insertRIDKeyPairAux(LeafNodeInt *leafIntPtr, int m, const RIDKeyPair<T> &rk, int pos);
+  std::size_t lookupInterleaved(const std::vector<T> &keyTs, const std::vector<std::size_t> &order,
+                                const std::vector<char> &skip, RecordId* outRids, bool* found);
 
   /**
-   * Insert the specified <pid, key> pair into the non leaf node.
-   * If the non leaf node is full, it will be split with a retrned pushed up <pid, key> pair.
-   * @param nodeIntPtr Non leaf node to insert into
-   * @param pk1 <pid, key> pair to insert
-   * @param pk2 <pid, key> pair to copy up
-   * @return whether the insertion completes without split or not
+   * Constructor both public constructors delegate to.
+   * @param nodeSizeIn Number of bytes of a node, 0 for the node size of an existing file or Page::SIZE.
+   * @param keyColumns Columns of the key of a composite index, whose attrType is STRING and attrByteOffset
+   *									that of its first column; empty for an index on a single attribute.
+   * @see BTreeIndex::BTreeIndex
    */
-  template <class T>
-  bool insertPageKeyPair(NonLeafNodeInt *nodeIntPtr, const PageKeyPair<T> &pk1, PageKeyPair<T> &pk2);
+	BTreeIndex(const std::string & relationName, std::string & outIndexName,
+						BufMgr *bufMgrIn,	const int attrByteOffset,	const Datatype attrType,
+						const double fillFactorIn, const IndexOpenMode mode, const int nodeSizeIn,
+						const std::vector<IncludedAttribute> &included, const std::vector<KeyColumn> &keyColumns);
 
   /**
-   * Insert the specified <rid, key> pair into the leaf node.
-   * If the leaf node is full, it will be split with a retrned copied up <pid, key> pair.
-   * @param leafIntPtr Leaf node to insert into
-   * @param rk <rid, key> pair to insert
-   * @param pk <pid, key> pair to copy up
-   * @return whether the insertion completes without split or not
+   * Check whether an index on a type of key may have nodes of a size.
+   * @param size Number of bytes of a node
+   * @param type Type of the key
+   * @return whether it is a power of two from MIN_NODE_SIZE to Page::SIZE, and Page::SIZE for a STRING key
    */
-  template <class T>
-  bool insertRIDKeyPair(LeafNodeInt *leafIntPtr, const RIDKeyPair<T> &rk, PageKeyPair<T> &pk);
+	static bool validNodeSize(int size, Datatype type);
 
   /**
-   * Auxiliary method of insertEntry.
-   * Insert the specified <rid, key> pair recursively starting from the non leaf node.
-   * If the non leaf node is full, it will be split with a retrned pushed up <pid, key> pair.
-   * @param nodeIntrPtr	non leaf node to start from
-   * @param rk <rid, key> pair to insert
-   * @param pk <pid, key> pair to pushed up
+   * Scale the occupancies of the nodes, computed for whole pages, to a node size.
+   * @param size Number of bytes of a node
+   * @throws BadIndexInfoException If the size is not valid
+   * @see validNodeSize
    */
-  template <class T>
-  bool insertEntryAux(NonLeafNodeInt *nodeIntrPtr, const RIDKeyPair<T> &rk, PageKeyPair<T> &pk);
+	void setNodeSize(int size);
 
  public:
 
   /**
    * BTreeIndex Constructor. 
 	 * Check to see if the corresponding index file exists. If so, open the file.
-	 * If not, create it and insert entries for every tuple in the base relation using FileScan class.
+	 * If not, create it and bulk load the entries for every tuple in the base relation using FileScan class.
    *
    * @param relationName        Name of file.
    * @param outIndexName        Return the name of index file.
    * @param bufMgrIn						Buffer Manager Instance
    * @param attrByteOffset			Offset of attribute, over which index is to be built, in the record
    * @param attrType						Datatype of attribute over which index is built
+   * @param fillFactorIn				Fraction (0, 1] of slots filled in the pages packed by the bulk loader
+   * @param mode								INDEX_READ_ONLY_MAPPED to map the index file and only look up and scan it
+   * @param included						Fixed width attributes stored next to the record IDs in the leaves, making a
+   *													covering index whose scans return them with scanNextIncluded. Only INTEGER and DOUBLE
+   *													indexes may be covering. The name of a covering index file is followed by their offsets.
+   * @param nodeSizeIn					Number of bytes of a node the index fills, a power of two from MIN_NODE_SIZE to
+   *													Page::SIZE, recorded in the meta page: smaller nodes hold fewer keys to search.
+   *													0 opens an existing file with its node size, or creates one filling whole pages.
    * @throws  BadIndexInfoException     If the index file already exists for the corresponding attribute, but values in metapage(relationName, attribute byte offset, attribute type etc.) do not match with values received through constructor parameters.
+   *														Or if more than MAX_INCLUDED_ATTRS attributes of more than MAX_INCLUDED_WIDTH bytes are included, or the key is a STRING.
+   *														Or if the node size is not valid, or the file was created with another Page::SIZE.
    */
 	BTreeIndex(const std::string & relationName, std::string & outIndexName,
-						BufMgr *bufMgrIn,	const int attrByteOffset,	const Datatype attrType);
-	
+						BufMgr *bufMgrIn,	const int attrByteOffset,	const Datatype attrType,
+						const double fillFactorIn = BULKLOAD_FILL_FACTOR,
+						const IndexOpenMode mode = INDEX_READ_WRITE,
+						const std::vector<IncludedAttribute> &included = std::vector<IncludedAttribute>(),
+						const int nodeSizeIn = 0);
+
+
+  /**
+   * BTreeIndex Constructor of a composite index, keyed on several attributes compared in order.
+	 * The columns of a key are encoded into a STRING key so that its bytes compare as the columns do:
+	 * the keys passed to the index are StringKeys built by encodeKey or encodeRecordKey, and a scan
+	 * of the keys starting with given values of the first columns is run by startPrefixScan.
+	 * The name of the index file is the relation name followed by the offsets of the columns.
+   *
+   * @param relationName        Name of file.
+   * @param outIndexName        Return the name of index file.
+   * @param bufMgrIn						Buffer Manager Instance
+   * @param columns							Attributes making the key, most significant first
+   * @param fillFactorIn				Fraction (0, 1] of slots filled in the pages packed by the bulk loader
+   * @param mode								INDEX_READ_ONLY_MAPPED to map the index file and only look up and scan it
+   * @throws  BadIndexInfoException     If the index file already exists but its columns differ,
+   *														or if there are no columns or more than MAX_KEY_COLUMNS.
+   */
+	BTreeIndex(const std::string & relationName, std::string & outIndexName,
+						BufMgr *bufMgrIn,	const std::vector<KeyColumn> &columns,
+						const double fillFactorIn = BULKLOAD_FILL_FACTOR,
+						const IndexOpenMode mode = INDEX_READ_WRITE);
+
 
   /**
    * BTreeIndex Destructor. 
@@ -454,16 +3149,197 @@ class BTreeIndex {
 	~BTreeIndex();
 
 
+  /**
+	 * Set the number of threads scanning and sorting the base relation when an index is created.
+	 * @param numThreads	Number of threads, 0 for one per hardware thread up to BULKLOAD_MAX_THREADS
+	**/
+	static void setBulkLoadThreads(unsigned numThreads);
+
+
+  /**
+	 * Set whether the INTEGER indexes created from then on pack their leaves, storing their keys and
+	 * record IDs as offsets in fewer bytes. Off by default.
+	 * @param packing	Whether to pack the leaves
+	**/
+	static void setBulkLoadPacking(bool packing);
+
+
   /**
 	 * Insert a new entry using the pair <value,rid>. 
 	 * Start from root to recursively find out the leaf to insert the entry in. The insertion may cause splitting of leaf node.
 	 * This splitting will require addition of new leaf page number entry into the parent non-leaf, which may in-turn get split.
 	 * This may continue all the way upto the root causing the root to get split. If root gets split, metapage needs to be changed accordingly.
+	 * A single node is latched at a time: a split node is released before its parent is latched, the lookups
+	 * reaching it meanwhile following its right link.
 	 * Make sure to unpin pages as soon as you can.
    * @param key			Key to insert, pointer to integer/double/char string
    * @param rid			Record ID of a record whose entry is getting inserted into the index.
+   * @param included	Values of the included attributes of a covering index, packed in their order.
+   *								If NULL, they are copied from the record, which must start key - attrByteOffset
+	 * @throws IndexReadOnlyException If the index is opened read-only
+	**/
+	void insertEntry(const void* key, const RecordId rid, const void* included = NULL);
+
+
+  /**
+	 * Insert a batch of entries. The entries are inserted in key order, so consecutive entries that fall in
+	 * the same leaf share a single descent, a single pin of the leaf and a single dirty unpin. A split ends
+	 * the run of entries of its leaf, the next ones descending again.
+   * @param keys		Array of n keys to insert, integers/doubles or pointers to char strings
+   * @param rids		Array of the n record IDs of the entries
+   * @param n				Number of entries
+   * @param included	Values of the included attributes of the n entries of a covering index, packed in their
+   *								order one entry after the other. Required by a covering index, since the keys are not
+   *								read from the records
+	 * @throws IndexReadOnlyException If the index is opened read-only
+	 * @throws BadIndexInfoException If the index is covering and no included values are given
+	**/
+	void insertEntries(const void* keys, const RecordId* rids, std::size_t n, const void* included = NULL);
+
+
+  /**
+	 * Set the write-optimized mode, for indexes whose insertions land at random across the key space.
+	 * insertEntry then adds the entries to an insert buffer, sorted in memory, and applies the whole buffer
+	 * to the leaves once it holds the given number of entries: each leaf receiving entries is then read and
+	 * written once for all of them, rather than once each. Lookups and deletions look into the buffer first,
+	 * and a scan applies the buffered entries of its range before it starts. commit and the destructor apply
+	 * the whole buffer. Off by default; it is to be set while no other thread uses the index.
+   * @param capacity	Number of entries buffered at most, 0 to turn the mode off, applying the buffer
+	**/
+	void setInsertBuffer(std::size_t capacity);
+
+
+  /**
+	 * Set the delta index mode, an LSM-style alternative to the write-optimized mode for ingest spikes of
+	 * insertions and deletions. The insert buffer then becomes a delta of the tree, sorted in memory, which
+	 * holds deletions of entries of the tree as well as insertions; the whole delta is merged into the tree
+	 * once it holds the given number of entries, deletions first, then insertions by insertEntries' path.
+	 * Scans do not apply the delta, but merge its entries of their range, taken when the scan starts, with
+	 * those of the tree. A deletion of an entry which is not in the delta is recorded without reading the
+	 * tree, and is true even if the tree does not hold it. An entry inserted twice is held once.
+	 * Not for covering indexes. Off by default; it is to be set while no other thread uses the index.
+   * @param capacity	Number of entries held at most, 0 to turn the mode off, merging the delta
+	 * @throws BadIndexInfoException If the index is covering
+	**/
+	void setDeltaIndex(std::size_t capacity);
+
+
+  /**
+	 * Apply the entries of the insert buffer to the leaves, which merges the delta index into the tree.
+	**/
+	void flushInsertBuffer();
+
+
+  /**
+	 * Get the number of entries in the insert buffer.
+	**/
+	std::size_t getNumBufferedEntries();
+
+
+  /**
+	 * Delete the entry of the pair <value,rid>.
+	 * Start from root to recursively find out the leaf holding the entry, or the posting list of its key.
+	 * With DELETE_EAGER, a node left underfull is merged with or takes entries from a sibling, which may
+	 * in-turn leave the parent underfull up to the root. A root left with a single non leaf child is replaced
+	 * by it. The pages emptied are added to the list of free pages, from which new pages are taken first.
+	 * With DELETE_LAZY, only the entry is removed, so the cost of a deletion stays that of finding the entry,
+	 * and it only latches its leaf as an insertion does.
+   * @param key			Key to delete, pointer to integer/double/char string
+   * @param rid			Record ID of the entry to delete
+	 * @return whether such entry existed or not
+	 * @throws IndexReadOnlyException If the index is opened read-only
+	**/
+	bool deleteEntry(const void* key, const RecordId rid);
+
+
+  /**
+	 * Make the insertions and deletions done so far durable, when the buffer manager logs the changes of the
+	 * pages of the index: the index file is attached to its log when opened, or once built. Only the log is
+	 * synced, once for the threads committing together, the pages being written back later.
+	 * The entries of the insert buffer are applied first.
+	**/
+	void commit();
+
+
+  /**
+	 * Set how the nodes left underfull by deleteEntry are handled. An index starts with DELETE_EAGER.
+   * @param policy	DELETE_EAGER or DELETE_LAZY
+	**/
+	void setDeletePolicy(const DeletePolicy policy) { deletePolicy = policy; }
+
+
+  /**
+	 * Merge or redistribute all underfull nodes of the tree bottom-up, freeing the emptied pages,
+	 * as eager deletions would have done. Meant to be run in the background of lazy deletions.
+	 * The tree latch is held exclusively during the whole compaction, which blocks the other writers.
+	 * @throws IndexReadOnlyException If the index is opened read-only
+	**/
+	void compact();
+
+
+  /**
+	 * Rebuild the tree online, as the bulk loader builds it: the entries are read from the leaves in key order
+	 * and packed at the given fill factor into new leaves and non leaf nodes, appended to the file so that the
+	 * leaves are contiguous and linked in page order, and a range scan reads them sequentially. The root is
+	 * then swapped in the meta page, and the pages of the old tree are freed. The posting lists are kept as
+	 * they are. The tree latch is held exclusively meanwhile, so the other writers wait, while lookups and
+	 * scans go on in the old tree until they restart in the new one.
+   * @param targetFill	Fraction (0, 1] of slots filled in the new pages
+	 * @throws IndexReadOnlyException If the index is opened read-only
+	**/
+	void rebuild(const double targetFill = BULKLOAD_FILL_FACTOR);
+
+
+  /**
+	 * Find the record ID of an entry with the given key.
+	 * It descends from the root to the leaf that may hold the key, without touching the scan state,
+	 * so it may be called while a scan is executing. A miss is reported through the return value.
+	 * A key the lookup filter rules out is reported missing without reading any page.
+   * @param key			Key to find, pointer to integer/double/char string
+   * @param outRid	RecordId of the entry found returned in this
+	 * @return whether such entry exists or not
+	**/
+	bool lookup(const void* key, RecordId& outRid);
+
+
+  /**
+	 * Find the record IDs of the entries with the given keys.
+	 * The keys are probed in sorted order, so consecutive keys that fall in the same leaf
+	 * share a single descent and a single pin of the leaf. The descents of up to LOOKUP_INTERLEAVE keys
+	 * are interleaved, so that the cache misses and the reads of their nodes overlap.
+   * @param keys		Array of n keys to find, pointer to integers/doubles or to pointers to char strings
+   * @param n				Number of keys
+   * @param outRids	Array of n RecordIds, the i-th being set to that of the i-th key if found
+   * @param found		Array of n flags, the i-th being set to whether the i-th key is found or not
+	 * @return the number of keys found
+	**/
+	std::size_t lookupBatch(const void* keys, std::size_t n, RecordId* outRids, bool* found);
+
+
+  /**
+	 * Find the record IDs of all the entries with the given keys, as a join probing the index needs them.
+	 * The keys are probed in sorted order, a leaf staying latched for the next keys as long as they lie in
+	 * it, so that a batch of close keys is a sweep along the leaves with a descent for each gap between them.
+	 * The entries of a key are followed into the right siblings and through its posting list. The insert
+	 * buffer is applied for the range of the keys first, as a scan of it does.
+   * @param keys		Array of n keys to find, pointer to integers/doubles or to pointers to char strings
+   * @param n				Number of keys
+   * @param out			Pairs of the position of a key in keys and of the record ID of one of its entries appended to
+	 * 							this, in key order and then in record ID order
+	 * @return the number of entries found
+	**/
+	std::size_t lookupBatchAll(const void* keys, std::size_t n, std::vector<std::pair<std::size_t, RecordId>>& out);
+
+
+  /**
+	 * Keep a Bloom filter of the keys of the index in memory, which lookup and lookupBatch check before
+	 * reading any page, so that a key missing from the index mostly costs no page access. The filter is built
+	 * from the leaves, sized for twice their keys, and the keys inserted from then on are added to it. Deleted
+	 * keys stay in it. Once it holds more keys than it is sized for, lookups stop checking it until it is set
+	 * again. It is to be set while no other thread uses the index; the insert buffer is applied first.
+   * @param bitsPerKey	Number of bits of the filter per key, 10 giving about 1% false positives, 0 to drop it
 	**/
-	void insertEntry(const void* key, const RecordId rid);
+	void setLookupFilter(int bitsPerKey = 10);
 
 
   /**
@@ -473,15 +3349,26 @@ class BTreeIndex {
 	 * If another scan is already executing, that needs to be ended here.
 	 * Set up all the variables for scan. Start from root to find out the leaf page that contains the first RecordID
 	 * that satisfies the scan parameters. Keep that page pinned in the buffer pool.
+	 * A backward scan starts from the high bound and returns the entries in decreasing order, so that the
+	 * greatest few entries of a range are read from its last leaves only.
+	 * The first offset entries are skipped as the scan starts, and it completes once it has returned limit
+	 * entries, the leaves past them not being read ahead. The leaves of the skipped entries are read as by
+	 * scanSkip().
    * @param lowVal	Low value of range, pointer to integer / double / char string
    * @param lowOp		Low operator (GT/GTE)
    * @param highVal	High value of range, pointer to integer / double / char string
    * @param highOp	High operator (LT/LTE)
+   * @param direction	Order of the entries returned, SCAN_FORWARD or SCAN_BACKWARD
+   * @param offset	Number of entries to skip first
+   * @param limit		Maximum number of entries to return after them, SCAN_NO_LIMIT for all of them
    * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values 
    * @throws  BadScanrangeException If lowVal > highval
-	 * @throws  NoSuchKeyFoundException If there is no key in the B+ tree that satisfies the scan criteria.
+	 * @throws  NoSuchKeyFoundException If there is no key in the B+ tree that satisfies the scan criteria,
+	 *          or none after the offset.
 	**/
-	void startScan(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp);
+	void startScan(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp,
+	               const ScanDirection direction = SCAN_FORWARD, std::size_t offset = 0,
+	               std::size_t limit = SCAN_NO_LIMIT);
 
 
   /**
@@ -494,6 +3381,204 @@ class BTreeIndex {
 	void scanNext(RecordId& outRid);  // returned record id
 
 
+  /**
+	 * Fetch the record ids of up to max next index entries that match the scan.
+	 * The qualifying entries of each leaf are copied at once, the end of them found by a single search
+	 * for the high bound. Unlike scanNext, the end of the scan is not an exception: fewer than max
+	 * record ids are returned only once the scan is completed, and 0 after that.
+   * @param out	Array of at least max record ids returned in this
+   * @param max	Maximum number of record ids to fetch
+   * @return the number of record ids fetched
+	 * @throws ScanNotInitializedException If no scan has been initialized.
+	**/
+	std::size_t scanNextBatch(RecordId* out, std::size_t max);
+
+
+  /**
+	 * Fetch the next index entry that matches the scan with its key and included values, without reading
+	 * the base relation.
+	 * @see BTreeCursor::scanNextIncluded
+	**/
+	void scanNextIncluded(RecordId& outRid, void* key, void* included);
+
+
+  /**
+	 * Collect the record ids of all the index entries left in the scan into a bitmap grouped by page.
+	 * @see BTreeCursor::scanToBitmap
+	**/
+	std::size_t scanToBitmap(RidBitmap& out);
+
+
+  /**
+	 * Skip up to n next index entries of the scan.
+	 * @see BTreeCursor::scanSkip
+	**/
+	std::size_t scanSkip(std::size_t n);
+
+
+  /**
+	 * Get the number of bytes of the included values of an entry, 0 if the index is not covering.
+	**/
+	int getIncludedWidth() const { return includedWidth; }
+
+
+  /**
+	 * Get the datatype of the attribute the index is built on.
+	**/
+	Datatype getAttributeType() const { return attributeType; }
+
+
+  /**
+	 * Get the number of bytes of a node the index fills.
+	**/
+	int getNodeSize() const { return nodeSize; }
+
+
+  /**
+	 * Get the number of non leaf nodes kept pinned in the node cache.
+	**/
+	std::size_t getNumCachedNodes() const { return numCachedNodes; }
+
+  /**
+	 * Unpin the cached nodes, unless a descent is using the node cache, and give their pins back to the
+	 * buffer manager, which calls this when its pool runs out of frames.
+	 *
+	 * @return number of nodes unpinned
+	**/
+	std::uint32_t releasePins() override;
+
+
+  /**
+	 * Enable or disable the measure of the operations: the latencies of insertEntry, lookup, startScan,
+	 * scanNext and of the splits, with the descents, index pages pinned and disk reads of each operation,
+	 * and the number of splits of each level. They are off by default, and cost two clock reads per operation
+	 * when on. The tracepoints of index_metrics.h fire either way when they are built.
+   * @param enabled	Whether to measure the operations from now on
+	**/
+	void setMetricsEnabled(bool enabled) { metricsEnabled = enabled; }
+
+
+  /**
+	 * Get the measures of a type of operation since the metrics were last cleared.
+   * @param op	Operation
+	**/
+	IndexOpStats getOpStats(IndexOp op) const { return metrics.opStats(op); }
+
+
+  /**
+	 * Get the number of splits of each level since the metrics were last cleared, from the leaves, at level 0,
+	 * up to the highest level split.
+	**/
+	std::vector<std::uint64_t> getSplitsPerLevel() const { return metrics.splitsPerLevel(); }
+
+
+  /**
+	 * Forget the operations measured so far.
+	**/
+	void clearMetrics() { metrics.clear(); }
+
+
+  /**
+	 * Collect the statistics of the index for a query planner, reading every node once: the leaves in key
+	 * order with their posting lists, and the non leaf nodes level by level. The histogram is built from a
+	 * sample of STATS_SAMPLE_SIZE entries. The entries still held by the insert buffer are not counted.
+	 * Other threads may modify the index meanwhile, the statistics then being approximate.
+   * @param numBuckets	Number of buckets of the histogram, at least 1
+   * @return the statistics
+	**/
+	IndexStats collectStats(int numBuckets = 32);
+
+
+  /**
+	 * Estimate the share of the entries of the index in a range without scanning it: the two bounds are
+	 * located by descending the tree along the separator keys, as a lookup does, and the share of the
+	 * entries between them is inferred from the fanout of the nodes on the paths. It is exact for a tree
+	 * whose nodes hold as many entries, and reads the pages of two lookups.
+   * @param lowVal	Low value of range, pointer to integer / double / char string
+   * @param lowOp		Low operator (GT/GTE)
+   * @param highVal	High value of range, pointer to integer / double / char string
+   * @param highOp	High operator (LT/LTE)
+   * @return the estimated share, from 0 to 1, 0 if the range is empty
+	 * @throws BadOpcodesException If lowOp and highOp do not contain one of their their expected values
+	**/
+	double estimateRange(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp);
+
+
+  /**
+	 * Count the entries of the index in a range exactly, by skipping them as scanSkip() does: every leaf of
+	 * the range is read, its entries being counted at once, and the record ids of a posting list a page at
+	 * a time.
+   * @param lowVal	Low value of range, pointer to integer / double / char string
+   * @param lowOp		Low operator (GT/GTE)
+   * @param highVal	High value of range, pointer to integer / double / char string
+   * @param highOp	High operator (LT/LTE)
+   * @return the number of entries, 0 if the range is empty
+	 * @throws BadOpcodesException If lowOp and highOp do not contain one of their their expected values
+	 * @throws BadScanrangeException If lowVal > highval
+	**/
+	std::size_t countRange(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp);
+
+
+  /**
+	 * Check whether lookups currently find their leaves through the hot levels.
+	**/
+	bool hasHotLevels() const
+	{
+		std::shared_ptr<const HotLevelsBase> hot = std::atomic_load(&hotLevels);
+		return hot != nullptr && treeLatch.validate(hot->version);
+	}
+
+
+  /**
+	 * Encode values of the first columns of a composite index into a key, each one as the bytes of its
+	 * normalized key (see normalized_key.h), so that the keys compare bytewise as the columns do and the
+	 * encoding of a prefix of the columns is a prefix of the key. A char string is cut so that
+	 * the columns after it always fit in the STRINGSIZE bytes of the key.
+   * @param values		Pointers to the values of the first numValues columns, integer / double / char string
+   * @param numValues	Number of values, at most the number of columns
+   * @param key				Returned key
+	**/
+	void encodeKey(const void* const* values, int numValues, StringKey& key) const;
+
+
+  /**
+	 * Encode a key of the index into the bytes of its normalized key, which compare with memcmp as the
+	 * keys do: the key of an INTEGER / DOUBLE / STRING index is encoded as a composite key of one column,
+	 * that of a composite index is copied.
+   * @param key		Key, pointer to integer / double / char string, or to the StringKey of a composite index
+   * @param out		Returned normalized key
+	**/
+	void normalizeKey(const void* key, StringKey& out) const;
+
+
+  /**
+	 * Encode a key of an index on a single attribute into the bytes of its normalized key, as normalizeKey
+	 * does, without the index, e.g. to spread keys over indexes not opened yet.
+   * @param attrType	Datatype of the attribute
+   * @param key		Key, pointer to integer / double / char string
+   * @param out		Returned normalized key
+	**/
+	static void normalizeKey(Datatype attrType, const void* key, StringKey& out);
+
+
+  /**
+	 * Encode the key of a record of the base relation of a composite index.
+   * @param record	Record of the base relation
+   * @param key			Returned key
+	**/
+	void encodeRecordKey(const char* record, StringKey& key) const;
+
+
+  /**
+	 * Begin a scan of the entries of a composite index whose first columns have the given values,
+	 * in key order. With fewer values than columns, the scan covers all values of the columns left.
+   * @param values		Pointers to the values of the first numValues columns
+   * @param numValues	Number of values, at most the number of columns
+	 * @throws  NoSuchKeyFoundException If there is no key in the B+ tree that starts with the values.
+	**/
+	void startPrefixScan(const void* const* values, int numValues);
+
+
   /**
 	 * Terminate the current scan. Unpin any pinned pages. Reset scan specific variables.
 	 * @throws ScanNotInitializedException If no scan has been initialized.
@@ -5,7 +5,10 @@
  * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
  */
 
+#include <cstdlib>
+#include <cstring>
 #include <memory>
+#include <new>
 #include <iostream>
 #include "buffer.h"
 #include "bufHashTbl.h"
@@ -15,100 +18,171 @@
 
 namespace badgerdb {
 
-int BufHashTbl::hash(const File* file, const PageId pageNo)
+/**
+ * Allocate memory aligned to a cache line.
+ *
+ * @param size  Number of bytes
+ * @return  		The memory, to be released with free.
+ * @throws HashTableException if the memory cannot be allocated
+ */
+static void *allocAligned(std::size_t size)
+{
+  void *ptr;
+  if (posix_memalign(&ptr, CACHE_LINE_SIZE, size) != 0)
+    throw HashTableException();
+  return ptr;
+}
+
+/**
+ * Allocate the empty slots of a shard.
+ *
+ * @param numSlots  Number of slots
+ * @return  				The slots, to be released with free.
+ */
+static hashBucket *allocSlots(std::uint32_t numSlots)
+{
+  auto *slots = (hashBucket *)allocAligned(numSlots * sizeof(hashBucket));
+  memset((void *)slots, 0, numSlots * sizeof(hashBucket));
+  return slots;
+}
+
+std::uint64_t BufHashTbl::hash(const File* file, const PageId pageNo)
+{
+  // combine the file object and page number, then mix all the bits (splitmix64 finalizer)
+  std::uint64_t value = (std::uint64_t)(std::uintptr_t)file * 0x9e3779b97f4a7c15ULL + pageNo;
+  value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+  return value ^ (value >> 31);
+}
+
+hashShard &BufHashTbl::shardOf(std::uint64_t h)
+{
+  // the shard is taken from the high bits, the slot in it from the low bits
+  return ht[(h >> 32) & (NUM_SHARDS - 1)];
+}
+
+std::uint32_t BufHashTbl::probe(const hashShard &shard, std::uint64_t h, const File* file, const PageId pageNo)
 {
-  int tmp, value;
-  tmp = (long)file;  // cast of pointer to the file object to an integer
-  value = (tmp + pageNo) % HTSIZE;
-  return value;
+  std::uint32_t i = h & shard.mask;
+  while (shard.slots[i].file != NULL
+         && (shard.slots[i].file != file || shard.slots[i].pageNo != pageNo))
+    i = (i + 1) & shard.mask;
+  return i;
+}
+
+void BufHashTbl::grow(hashShard &shard)
+{
+  hashBucket *oldSlots = shard.slots;
+  std::uint32_t oldSize = shard.mask + 1;
+
+  shard.slots = allocSlots(2 * oldSize);
+  shard.mask = 2 * oldSize - 1;
+  for (std::uint32_t i = 0; i < oldSize; i++)
+  {
+    const hashBucket &entry = oldSlots[i];
+    if (entry.file != NULL)
+      shard.slots[probe(shard, hash(entry.file, entry.pageNo), entry.file, entry.pageNo)] = entry;
+  }
+  free(oldSlots);
 }
 
 BufHashTbl::BufHashTbl(int htSize)
 	: HTSIZE(htSize)
 {
-  // allocate an array of pointers to hashBuckets
-  ht = new hashBucket* [htSize];
-  for(int i=0; i < HTSIZE; i++)
-    ht[i] = NULL;
+  // each shard starts with twice the slots of its share of the entries, and at least a cache line of them
+  std::uint32_t numSlots = CACHE_LINE_SIZE / sizeof(hashBucket);
+  while (numSlots * NUM_SHARDS < 2 * (std::uint32_t)htSize)
+    numSlots *= 2;
+
+  ht = (hashShard *)allocAligned(NUM_SHARDS * sizeof(hashShard));
+  for (int i = 0; i < NUM_SHARDS; i++)
+  {
+    new (&ht[i]) hashShard();
+    ht[i].slots = allocSlots(numSlots);
+    ht[i].mask = numSlots - 1;
+    ht[i].count = 0;
+  }
 }
 
 BufHashTbl::~BufHashTbl()
 {
-  for(int i = 0; i < HTSIZE; i++) {
-    hashBucket* tmpBuf = ht[i];
-    while (ht[i]) {
-      tmpBuf = ht[i];
-      ht[i] = ht[i]->next;
-      delete tmpBuf;
-    }
+  for (int i = 0; i < NUM_SHARDS; i++)
+  {
+    free(ht[i].slots);
+    ht[i].~hashShard();
   }
-  delete [] ht;
+  free(ht);
 }
 
 void BufHashTbl::insert(const File* file, const PageId pageNo, const FrameId frameNo)
 {
-  int index = hash(file, pageNo);
-
-  hashBucket* tmpBuc = ht[index];
-  while (tmpBuc) {
-    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
-  		throw HashAlreadyPresentException(tmpBuc->file->filename(), tmpBuc->pageNo, tmpBuc->frameNo);
-    tmpBuc = tmpBuc->next;
+  std::uint64_t h = hash(file, pageNo);
+  hashShard &shard = shardOf(h);
+  std::lock_guard<std::mutex> guard(shard.mutex);
+
+  std::uint32_t i = probe(shard, h, file, pageNo);
+  if (shard.slots[i].file != NULL)
+    throw HashAlreadyPresentException(file->filename(), pageNo, shard.slots[i].frameNo);
+
+  // keep the shard at most 3/4 full, so that probe sequences stay short
+  if (4 * (shard.count + 1) > 3 * (shard.mask + 1))
+  {
+    grow(shard);
+    i = probe(shard, h, file, pageNo);
   }
-
-  tmpBuc = new hashBucket;
-  if (!tmpBuc)
-  	throw HashTableException();
-
-  tmpBuc->file = (File*) file;
-  tmpBuc->pageNo = pageNo;
-  tmpBuc->frameNo = frameNo;
-  tmpBuc->next = ht[index];
-  ht[index] = tmpBuc;
+  shard.slots[i].file = file;
+  shard.slots[i].pageNo = pageNo;
+  shard.slots[i].frameNo = frameNo;
+  shard.count++;
 }
 
-void BufHashTbl::lookup(const File* file, const PageId pageNo, FrameId &frameNo) 
+bool BufHashTbl::find(const File* file, const PageId pageNo, FrameId &frameNo)
 {
-  int index = hash(file, pageNo);
-  hashBucket* tmpBuc = ht[index];
-  while (tmpBuc) {
-    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
-    {
-      frameNo = tmpBuc->frameNo; // return frameNo by reference
-      return;
-    }
-    tmpBuc = tmpBuc->next;
-  }
+  std::uint64_t h = hash(file, pageNo);
+  hashShard &shard = shardOf(h);
+  std::lock_guard<std::mutex> guard(shard.mutex);
+
+  std::uint32_t i = probe(shard, h, file, pageNo);
+  if (shard.slots[i].file == NULL)
+    return false;
+  frameNo = shard.slots[i].frameNo; // return frameNo by reference
+  return true;
+}
 
-  throw HashNotFoundException(file->filename(), pageNo);
+void BufHashTbl::lookup(const File* file, const PageId pageNo, FrameId &frameNo)
+{
+  if (!find(file, pageNo, frameNo))
+    throw HashNotFoundException(file->filename(), pageNo);
 }
 
 void BufHashTbl::remove(const File* file, const PageId pageNo) {
 
-  int index = hash(file, pageNo);
-  hashBucket* tmpBuc = ht[index];
-  hashBucket* prevBuc = NULL;
+  std::uint64_t h = hash(file, pageNo);
+  hashShard &shard = shardOf(h);
+  std::lock_guard<std::mutex> guard(shard.mutex);
 
-  while (tmpBuc)
-	{
-    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
-		{
-      if(prevBuc) 
-				prevBuc->next = tmpBuc->next;
-      else
-				ht[index] = tmpBuc->next;
+  std::uint32_t i = probe(shard, h, file, pageNo);
+  if (shard.slots[i].file == NULL)
+    throw HashNotFoundException(file->filename(), pageNo);
 
-      delete tmpBuc;
-      return;
-    }
-		else
+  // shift back the entries after the removed one that would be cut off from their hash slot
+  std::uint32_t j = i;
+  while (true)
+	{
+    j = (j + 1) & shard.mask;
+    const hashBucket &entry = shard.slots[j];
+    if (entry.file == NULL)
+      break;
+    std::uint32_t k = hash(entry.file, entry.pageNo) & shard.mask;
+    bool between = i <= j ? (i < k && k <= j) : (i < k || k <= j);
+    if (!between)
 		{
-      prevBuc = tmpBuc;
-      tmpBuc = tmpBuc->next;
+      shard.slots[i] = entry;
+      i = j;
     }
   }
-
-  throw HashNotFoundException(file->filename(), pageNo);
+  shard.slots[i].file = NULL;
+  shard.count--;
 }
 
 }
@@ -7,18 +7,21 @@
 
 #pragma once
 
+#include <cstdint>
+#include <mutex>
 #include "file.h"
 
 namespace badgerdb {
 
 /**
 * @brief Declarations for buffer pool hash table
+* An entry of the table, stored in place in the slots of a shard. A slot is empty if its file is null.
 */
 struct hashBucket {
 	/**
 	 * pointer a file object (more on this below)
 	 */
-	File *file;
+	const File *file;
 
 	/**
 	 * page number within a file
@@ -29,43 +32,106 @@ struct hashBucket {
 	 * frame number of page in the buffer pool
 	 */
 	FrameId frameNo;
+};
+
+/**
+* @brief Size of a cache line, which the shards and their slots are aligned to.
+*/
+const std::size_t CACHE_LINE_SIZE = 64;
+
+/**
+* @brief A part of the hash table with its own latch, holding the entries whose hash falls to it.
+* Its slots are probed linearly from the hash of an entry, and are shifted back on removal so
+* that no entry is ever separated from its hash by an empty slot.
+*/
+struct alignas(CACHE_LINE_SIZE) hashShard {
+	/**
+	 * Serializes the accesses to the shard
+	 */
+	std::mutex mutex;
+
+	/**
+	 * Slots of the shard, whose number is a power of 2
+	 */
+	hashBucket *slots;
+
+	/**
+	 * Number of slots minus 1
+	 */
+	std::uint32_t mask;
 
 	/**
-	 * Next node in the hash table
+	 * Number of entries in the shard
 	 */
-	hashBucket*   next;
+	std::uint32_t count;
 };
 
 
 /**
 * @brief Hash table class to keep track of pages in the buffer pool
-*
-* @warning This class is not threadsafe.
+* The table is open addressed, so an entry takes no allocation once the table is big enough, and it is
+* split in shards latched separately, so that the methods may be called from several threads at once.
 */
 class BufHashTbl
 {
  private:
+	/**
+	 *	Number of shards, a power of 2
+	 */
+  static const int NUM_SHARDS = 16;
+
 	/**
 	 *	Size of Hash Table
 	 */
   int HTSIZE;
+
 	/**
 	 * Actual Hash table object
 	 */
-  hashBucket**  ht;
+  hashShard *ht;
+
+	/**
+	 * Find the shard of a hash value.
+	 *
+	 * @param h  			Hash value
+	 * @return  			Shard holding the entries of that hash value.
+	 */
+  hashShard &shardOf(std::uint64_t h);
 
 	/**
-	 * returns hash value between 0 and HTSIZE-1 computed using file and pageNo
+	 * Find the slot of an entry in a latched shard, or the empty slot ending its probe sequence.
 	 *
+	 * @param shard  	Latched shard
+	 * @param h  			Hash value of the entry
 	 * @param file   	File object
 	 * @param pageNo  Page number in the file
-	 * @return  			Hash value.
+	 * @return  			Position of the slot.
+	 */
+  static std::uint32_t probe(const hashShard &shard, std::uint64_t h, const File* file, const PageId pageNo);
+
+	/**
+	 * Double the number of slots of a latched shard, moving its entries.
+	 *
+	 * @param shard  	Latched shard
 	 */
-  int	 hash(const File* file, const PageId pageNo);
+  static void grow(hashShard &shard);
 
  public:
 	/**
+	 * returns hash value computed using file and pageNo
+	 * The bits are mixed, so that sequential page numbers spread over the shards and slots, and over the
+	 * partitions of the buffer pool, which take the bits from 40 on.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 * @return  			Hash value.
+	 */
+  static std::uint64_t hash(const File* file, const PageId pageNo);
+
+	/**
    * Constructor of BufHashTbl class
+	 *
+	 * @param htSize  Expected number of entries, which the table holds without growing
 	 */
 	BufHashTbl(const int htSize);  // constructor
 
@@ -73,7 +139,7 @@ class BufHashTbl
    * Destructor of BufHashTbl class
 	 */
   ~BufHashTbl(); // destructor
-	
+
 	/**
    * Insert entry into hash table mapping (file, pageNo) to frameNo.
 	 *
@@ -81,18 +147,28 @@ class BufHashTbl
 	 * @param pageNo 	Page number in the file
 	 * @param frameNo Frame number assigned to that page of the file
    * @throws  HashAlreadyPresentException	if the corresponding page already exists in the hash table
-   * @throws  HashTableException (optional) if could not create a new bucket as running of memory
 	 */
   void insert(const File* file, const PageId pageNo, const FrameId frameNo);
 
 	/**
    * Check if (file, pageNo) is currently in the buffer pool (ie. in
+   * the hash table), a miss being an expected outcome.
+	 *
+	 * @param file  	File object
+	 * @param pageNo	Page number in the file
+	 * @param frameNo Returned frame number if found
+   * @return  			Whether the page entry is found.
+	 */
+  bool find(const File* file, const PageId pageNo, FrameId &frameNo);
+
+	/**
+   * Check if (file, pageNo) is currently in the buffer pool (ie. in
    * the hash table).
 	 *
 	 * @param file  	File object
 	 * @param pageNo	Page number in the file
 	 * @param frameNo Frame number reference
-   * @throws HashNotFoundException if the page entry is not found in the hash table 
+   * @throws HashNotFoundException if the page entry is not found in the hash table
 	 */
   void lookup(const File* file, const PageId pageNo, FrameId &frameNo);
 
@@ -101,9 +177,9 @@ class BufHashTbl
 	 *
 	 * @param file   	File object
 	 * @param pageNo  Page number in the file
-   * @throws HashNotFoundException if the page entry is not found in the hash table 
+   * @throws HashNotFoundException if the page entry is not found in the hash table
 	 */
-  void remove(const File* file, const PageId pageNo);  
+  void remove(const File* file, const PageId pageNo);
 };
 
 }
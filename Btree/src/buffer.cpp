@@ -5,23 +5,66 @@
  * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
  */
 
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
 #include <memory>
 #include <iostream>
+#include <new>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 #include "buffer.h"
 #include "exceptions/buffer_exceeded_exception.h"
 #include "exceptions/page_not_pinned_exception.h"
 #include "exceptions/page_pinned_exception.h"
 #include "exceptions/bad_buffer_exception.h"
 #include "exceptions/hash_not_found_exception.h"
+#include "exceptions/hash_already_present_exception.h"
+#include "exceptions/invalid_page_exception.h"
 
 namespace badgerdb { 
 
+const int BufStats::SWEEP_BUCKETS;
+
+// number of pages read from disk by each thread
+static thread_local std::uint64_t threadReads = 0;
+const std::uint32_t BufMgr::MIN_PARTITION_BUFS;
+const int BufMgr::WRITER_INTERVAL_MS;
+const std::uint32_t BufMgr::WRITER_BATCH;
+const std::size_t BufMgr::HUGE_PAGE_SIZE;
+const std::uint32_t BufMgr::HELD_PIN_FRACTION;
+
+// memory policy of mbind() binding pages to a set of nodes, as numaif.h defines it
+static const int NUMA_POLICY_BIND = 2;
+
+// read a list of CPUs or nodes as the kernel prints them, such as "0-3,8-11", empty if the file is missing
+static std::vector<std::uint32_t> readIdList(const std::string &path)
+{
+  std::vector<std::uint32_t> ids;
+  std::ifstream in(path);
+  std::string range;
+  while (std::getline(in, range, ','))
+  {
+    std::uint32_t first, last;
+    int n = sscanf(range.c_str(), "%u-%u", &first, &last);
+    if (n < 1)
+      continue;
+    for (std::uint32_t id = first; id <= (n == 2 ? last : first); id++)
+      ids.push_back(id);
+  }
+  return ids;
+}
+
 //----------------------------------------
 // Constructor of the class BufMgr
 //----------------------------------------
 
-BufMgr::BufMgr(std::uint32_t bufs)
-	: numBufs(bufs) {
+BufMgr::BufMgr(std::uint32_t bufs, ReplacementPolicy *policy, std::uint32_t parts, bool hugePages, bool numa)
+	: numBufs(bufs), numNodes(1), boostRounds(0), log(NULL), logPool(NULL), heldPins(0), writerStop(false),
+	  highWater(1), lowWater(1), readerStop(false) {
 	bufDescTable = new BufDesc[bufs];
 
   for (FrameId i = 0; i < bufs; i++) 
@@ -30,185 +73,881 @@ BufMgr::BufMgr(std::uint32_t bufs)
   	bufDescTable[i].valid = false;
   }
 
-  bufPool = new Page[bufs];
+  // the pool is mapped, hence aligned for direct I/O, on huge pages if asked and the system has some reserved
+  poolSize = (std::size_t)bufs * Page::SIZE;
+  void *pool = MAP_FAILED;
+  if (hugePages)
+  {
+    std::size_t hugeSize = (poolSize + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    pool = mmap(NULL, hugeSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (pool != MAP_FAILED)
+      poolSize = hugeSize;
+  }
+  if (pool == MAP_FAILED)
+  {
+    pool = mmap(NULL, poolSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (pool == MAP_FAILED)
+      throw std::bad_alloc();
+    // otherwise have the kernel back the pool with transparent huge pages
+    if (hugePages)
+      madvise(pool, poolSize, MADV_HUGEPAGE);
+  }
+  bufPool = static_cast<Page*>(pool);
 
   int htsize = ((((int) (bufs * 1.2))*2)/2)+1;
   hashTable = new BufHashTbl (htsize);  // allocate the buffer hash table
 
-  clockHand = bufs - 1;
+  // by default one partition per hardware thread, each with enough frames to choose a victim among
+  if (parts == 0)
+  {
+    parts = std::min(std::max(std::thread::hardware_concurrency(), 1u), std::max(bufs / MIN_PARTITION_BUFS, 1u));
+  }
+  parts = std::max(std::min(parts, bufs), 1u);
+  numPartitions = 1;
+  while (numPartitions * 2 <= parts)
+    numPartitions *= 2;
+
+  // each node takes at least one partition
+  std::vector<std::uint32_t> nodeIds;
+  if (numa)
+  {
+    nodeIds = readIdList("/sys/devices/system/node/has_memory");
+    while (numPartitions < nodeIds.size() && numPartitions * 2 <= bufs)
+      numPartitions *= 2;
+  }
+
+  if (policy == NULL)
+    policy = new ClockPolicy();
+
+  // the frames are split evenly, the first partitions taking one more if they do not divide
+  partitions = new BufPartition[numPartitions];
+  FrameId base = 0;
+  for (std::uint32_t p = 0; p < numPartitions; p++)
+  {
+    BufPartition &part = partitions[p];
+    part.base = base;
+    part.numBufs = bufs / numPartitions + (p < bufs % numPartitions ? 1 : 0);
+    part.policy = p == 0 ? policy : policy->clone();
+    part.policy->init(part.numBufs);
+
+    // frames are handed out in increasing order
+    for (FrameId i = part.numBufs; i > 0; i--)
+      part.freeFrames.push_back(base + i - 1);
+    base += part.numBufs;
+  }
+
+  // the pages are first touched once bound to their node
+  nodePartitions = {0, numPartitions};
+  if (nodeIds.size() > 1)
+    placeNodes(nodeIds);
+  for (FrameId i = 0; i < bufs; i++)
+    new (&bufPool[i]) Page();
+}
+
+void BufMgr::placeNodes(const std::vector<std::uint32_t> &nodeIds)
+{
+  numNodes = std::min<std::uint32_t>(nodeIds.size(), numPartitions);
+  cpuNodes.clear();
+  for (std::uint32_t node = 0; node < numNodes; node++)
+  {
+    for (std::uint32_t cpu : readIdList("/sys/devices/system/node/node" + std::to_string(nodeIds[node]) + "/cpulist"))
+    {
+      if (cpu >= cpuNodes.size())
+        cpuNodes.resize(cpu + 1, 0);
+      cpuNodes[cpu] = node;
+    }
+  }
+
+  // the partitions of a node are consecutive, and so are their frames
+  for (std::uint32_t p = 0; p < numPartitions; p++)
+    partitions[p].node = (std::uint64_t)p * numNodes / numPartitions;
+  std::uint32_t first = 0;
+  nodePartitions.clear();
+  for (std::uint32_t node = 0; node < numNodes; node++)
+  {
+    std::uint32_t last = first;
+    while (last < numPartitions && partitions[last].node == node)
+      last++;
+    nodePartitions.push_back(first);
+    FrameId begin = partitions[first].base;
+    FrameId end = partitions[last - 1].base + partitions[last - 1].numBufs;
+    first = last;
+
+    // a failed binding, such as on huge pages not aligned on the sub-pool, leaves the pages to first touch
+    std::uint32_t id = nodeIds[node];
+    std::vector<unsigned long> mask(id / (8 * sizeof(unsigned long)) + 1, 0);
+    mask[id / (8 * sizeof(unsigned long))] |= 1ul << (id % (8 * sizeof(unsigned long)));
+    syscall(SYS_mbind, &bufPool[begin], (std::size_t)(end - begin) * Page::SIZE, NUMA_POLICY_BIND, mask.data(),
+            mask.size() * 8 * sizeof(unsigned long) + 1, 0);
+  }
+  nodePartitions.push_back(numPartitions);
+}
+
+std::uint32_t BufMgr::threadNode() const
+{
+  int cpu = sched_getcpu();
+  return cpu >= 0 && (std::size_t)cpu < cpuNodes.size() ? cpuNodes[cpu] : 0;
 }
 
 
 BufMgr::~BufMgr() {
+  // the prefetches still queued are run, before their frames go away
+  if (readerThread.joinable())
+  {
+    {
+      std::lock_guard<std::mutex> lock(readerMutex);
+      readerStop = true;
+    }
+    readerWakeup.notify_one();
+    readerThread.join();
+  }
+  stopBackgroundWriter();
+
+  // the records of the pages are synced before the pages
+  if (log != NULL)
+  {
+    for (FrameId i = 0; i < numBufs; i++)
+    {
+      if (bufDescTable[i].valid && bufDescTable[i].dirty)
+        logBuf(i);
+    }
+    log->flush(log->getEndLsn());
+  }
+
   //Flush out all unwritten pages
   for (std::uint32_t i = 0; i < numBufs; i++) 
   {
   	BufDesc* tmpbuf = &(bufDescTable[i]);
   	if (tmpbuf->valid == true && tmpbuf->dirty == true)
 		{
-			tmpbuf->file->writePage(tmpbuf->pageNo, bufPool[i]);
+			tmpbuf->file->writePageFrom(tmpbuf->pageNo, bufPool[i]);
   	}
   }
 
+  for (std::uint32_t p = 0; p < numPartitions; p++)
+    delete partitions[p].policy;
+  delete [] partitions;
 	delete hashTable;
   delete [] bufDescTable;
-  delete [] bufPool;
+  munmap(bufPool, poolSize);
+  if (logPool != NULL)
+    munmap(logPool, (std::size_t)numBufs * Page::SIZE);
 }
 
-void BufMgr::allocBuf(FrameId & frame) 
+BufPartition & BufMgr::localPartition(const File* file, const PageId pageNo)
 {
-  // perform first part of clock algorithm to search for 
-  // open buffer frame
-  // Assumes non-concurrent access to buffer manager
-  std::uint32_t numScanned = 0;
-  bool found = 0;
+  std::uint32_t node = numNodes > 1 ? threadNode() : 0;
+  std::uint32_t first = nodePartitions[node];
+  return partitions[first + (BufHashTbl::hash(file, pageNo) >> 40) % (nodePartitions[node + 1] - first)];
+}
+
+bool BufMgr::latchPage(const File* file, const PageId pageNo, FrameId &frame, std::unique_lock<std::mutex> &lock)
+{
+  // the page may be evicted between the lookup and the latching of its partition
+  while (hashTable->find(file, pageNo, frame))
+  {
+    BufPartition &part = partitionOf(frame);
+    lock = std::unique_lock<std::mutex>(part.mutex);
+    const BufDesc &desc = bufDescTable[frame];
+    // a page still being read is waited for; if the read fails, it is gone from the hash table
+    part.ioDone.wait(lock, [&desc, file, pageNo]() {
+      return !(desc.reading && desc.file == file && desc.pageNo == pageNo);
+    });
+    if (desc.valid && desc.file == file && desc.pageNo == pageNo)
+      return true;
+    lock.unlock();
+    std::this_thread::yield();
+  }
+  return false;
+}
+
+BufPartition & BufMgr::partitionOf(FrameId frame)
+{
+  // the partitions that take one more frame come first
+  std::uint32_t size = numBufs / numPartitions;
+  std::uint32_t larger = numBufs % numPartitions;
+  if (frame < larger * (size + 1))
+    return partitions[frame / (size + 1)];
+  return partitions[larger + (frame - larger * (size + 1)) / size];
+}
 
-  while (numScanned < 2*numBufs)	//Need to scn twice
+BufStatus BufMgr::allocBuf(BufPartition & part, const File* file, const PageId pageNo, FrameId & frame) 
+{
+  // the caller holds the mutex of the partition
+  if (!part.freeFrames.empty())
   {
-    // advance the clock
-    advanceClock();
-    numScanned++;
+    frame = part.freeFrames.back();
+    part.freeFrames.pop_back();
+    return BufStatus::OK;
+  }
 
-    // if invalid, use frame
-    if (! bufDescTable[clockHand].valid)
+  // ask the policy for a page to evict, sparing the boosted ones
+  BufDesc *descs = &bufDescTable[part.base];
+  FrameId victim;
+  std::uint32_t numScanned = 0;
+  while (true)
+  {
+    bool found = part.policy->victim(descs, file, pageNo, victim);
+    numScanned += part.policy->lastScanned();
+    if (!found)
+    {
+      part.count(file, &BufStats::bufferexceeded);
+      return BufStatus::BUFFER_EXCEEDED;
+    }
+    if (descs[victim].boost == 0)
     {
       break;
     }
+    descs[victim].boost--;
+    part.policy->spared(victim);
+  }
+  part.bufStats.addSweep(numScanned);
+  part.statsOf(file).addSweep(numScanned);
+  part.policy->evicted(victim);
+  frame = part.base + victim;
+  evictBuf(part, frame);
+  return BufStatus::OK;
+} // end allocBuf
+
+BufStatus BufMgr::allocRingBuf(BufPartition & part, BufRing* ring, const File* file, const PageId pageNo, FrameId & frame)
+{
+  if (ring->parts.size() != numPartitions)
+    ring->parts.assign(numPartitions, BufRing::Part());
+  BufRing::Part &ringPart = ring->parts[&part - partitions];
+
+  if (ringPart.frames.size() < ringShare(part, *ring))
+  {
+    BufStatus status = allocBuf(part, file, pageNo, frame);
+    if (status == BufStatus::OK)
+    {
+      ringPart.frames.push_back(frame);
+      ringPart.pages.push_back(PageKey{file, pageNo});
+    }
+    return status;
+  }
+
+  std::uint32_t slot = ringPart.next;
+  ringPart.next = (ringPart.next + 1) % ringPart.frames.size();
+
+  // recycle the frame if it still holds the page the ring read in it, and nobody uses or boosted it
+  frame = ringPart.frames[slot];
+  BufDesc &desc = bufDescTable[frame];
+  if (desc.valid && desc.file == ringPart.pages[slot].file && desc.pageNo == ringPart.pages[slot].pageNo
+      && desc.pinCnt == 0 && desc.boost == 0)
+  {
+    part.policy->removed(frame - part.base);
+    evictBuf(part, frame);
+  }
+  else
+  {
+    BufStatus status = allocBuf(part, file, pageNo, frame);
+    if (status != BufStatus::OK)
+      return status;
+    ringPart.frames[slot] = frame;
+  }
+  ringPart.pages[slot] = PageKey{file, pageNo};
+  return BufStatus::OK;
+}
+
+std::uint32_t BufMgr::ringShare(const BufPartition & part, const BufRing &ring) const
+{
+  // the ring takes its share in each partition, and at most 1/8 of it
+  return std::min(std::max(ring.capacity / numPartitions, 1u), std::max(part.numBufs / 8, 1u));
+}
+
+std::uint32_t BufMgr::ringSize(const BufRing &ring) const
+{
+  std::uint32_t size = 0;
+  for (std::uint32_t p = 0; p < numPartitions; p++)
+    size += ringShare(partitions[p], ring);
+  return size;
+}
+
+void BufMgr::evictBuf(BufPartition & part, FrameId frame)
+{
+  // flush any existing changes to disk if necessary, before the page can be read again into another partition
+  part.count(bufDescTable[frame].file, bufDescTable[frame].dirty ? &BufStats::dirtyevictions : &BufStats::cleanevictions);
+  if (bufDescTable[frame].dirty)
+  {
+    writeBuf(part, frame);
+  }
+
+  // remove previous entry from hash table
+  hashTable->remove(bufDescTable[frame].file, bufDescTable[frame].pageNo);
+
+	//Reset all the BufDesc entry for the frame before returning the frame
+  bufDescTable[frame].Clear();
+}
+
+void BufMgr::writeBuf(BufPartition & part, FrameId frame)
+{
+  // write-ahead: the records of the page reach the log before the page reaches its file
+  BufDesc &desc = bufDescTable[frame];
+  if (desc.logged)
+  {
+    logBuf(frame);
+    log->flush(desc.pageLsn);
+  }
+  desc.recLsn = 0;
+
+  part.count(desc.file, &BufStats::diskwrites);
+  bufDescTable[frame].file->writePageFrom(bufDescTable[frame].pageNo, bufPool[frame]);
+  part.count(desc.file, &BufStats::byteswritten, (std::uint64_t)Page::SIZE);
+  bufDescTable[frame].dirty = false;
+  part.numDirty--;
+}
+
+void BufMgr::cleanPartition(BufPartition & part)
+{
+  FrameId start;
+  {
+    std::lock_guard<std::mutex> guard(part.mutex);
+    if (part.numDirty <= highWater * part.numBufs)
+      return;
+    start = part.policy->sweepStart();
+  }
+
+  // sweep ahead of the eviction, so that the next victims are clean when they are reached
+  IoBatch batch;
+  std::vector<FrameId> frames;
+  std::uint32_t n = 0;
+  while (n < part.numBufs)
+  {
+    std::lock_guard<std::mutex> guard(part.mutex);
+    if (part.numDirty <= lowWater * part.numBufs)
+      break;
+
+    // the pages are unpinned, and cannot be pinned again and changed while the partition is latched
+    std::uint32_t excess = part.numDirty - (std::uint32_t)(lowWater * part.numBufs);
+    batch.clear();
+    frames.clear();
+    Lsn batchLsn = 0;
+    for (; n < part.numBufs && frames.size() < std::min(excess, WRITER_BATCH); n++)
+    {
+      FrameId frame = part.base + (start + n) % part.numBufs;
+      BufDesc &desc = bufDescTable[frame];
+      if (desc.valid && desc.dirty && desc.pinCnt == 0)
+      {
+        if (desc.logged)
+        {
+          logBuf(frame);
+          batchLsn = std::max(batchLsn, desc.pageLsn);
+        }
+        desc.file->queueWrite(batch, desc.pageNo, bufPool[frame]);
+        frames.push_back(frame);
+      }
+    }
+
+    // one sync of the log covers the records of the whole batch
+    if (batchLsn != 0)
+      log->flush(batchLsn);
+    batch.submit();
 
-    // is valid, check referenced bit
-    if (! bufDescTable[clockHand].refbit)
+    for (std::size_t i = 0; i < frames.size(); i++)
     {
-      // check to see if someone has it pinned
-      if (bufDescTable[clockHand].pinCnt == 0)
+      const File *file = bufDescTable[frames[i]].file;
+      part.count(file, &BufStats::diskwrites);
+      if (batch.ok(i))
       {
-        // hasn't been referenced and is not pinned, use it
-        // remove previous entry from hash table
-        hashTable->remove(bufDescTable[clockHand].file, bufDescTable[clockHand].pageNo);
-        found = true;
-        break;
+        part.count(file, &BufStats::cleanwrites);
+        part.count(file, &BufStats::byteswritten, (std::uint64_t)Page::SIZE);
+        bufDescTable[frames[i]].dirty = false;
+        bufDescTable[frames[i]].recLsn = 0;
+        part.numDirty--;
       }
     }
-    else
+  }
+}
+
+void BufMgr::writerLoop()
+{
+  std::unique_lock<std::mutex> lock(writerMutex);
+  while (!writerStop)
+  {
+    lock.unlock();
+    for (std::uint32_t p = 0; p < numPartitions; p++)
+      cleanPartition(partitions[p]);
+    lock.lock();
+    writerWakeup.wait_for(lock, std::chrono::milliseconds(WRITER_INTERVAL_MS));
+  }
+}
+
+void BufMgr::startBackgroundWriter(double low, double high)
+{
+  stopBackgroundWriter();
+  lowWater = low;
+  highWater = std::max(low, high);
+  writerStop = false;
+  writerThread = std::thread(&BufMgr::writerLoop, this);
+}
+
+void BufMgr::stopBackgroundWriter()
+{
+  if (!writerThread.joinable())
+    return;
+
+  {
+    std::lock_guard<std::mutex> lock(writerMutex);
+    writerStop = true;
+  }
+  writerWakeup.notify_one();
+  writerThread.join();
+  highWater = lowWater = 1;
+}
+
+int BufMgr::checkpoint()
+{
+  // recovery will replay the log from the first change of the pages dirty now, and the pages changed later
+  Lsn redoLsn = log != NULL ? log->getEndLsn() : 0;
+
+  // collect the dirty pages, then write them in file and page order
+  std::vector<std::pair<PageKey, FrameId>> dirtyPages;
+  for (std::uint32_t p = 0; p < numPartitions; p++)
+  {
+    BufPartition &part = partitions[p];
+    std::lock_guard<std::mutex> guard(part.mutex);
+    for (FrameId i = part.base; i < part.base + part.numBufs; i++)
     {
-      // has been referenced, clear the bit
-      bufStats.accesses++;
-      bufDescTable[clockHand].refbit = false;
+      if (bufDescTable[i].valid && bufDescTable[i].dirty && bufDescTable[i].logged)
+        redoLsn = std::min(redoLsn, bufDescTable[i].recLsn);
+      if (bufDescTable[i].valid && bufDescTable[i].dirty && bufDescTable[i].pinCnt == 0)
+        dirtyPages.push_back({PageKey{bufDescTable[i].file, bufDescTable[i].pageNo}, i});
     }
   }
-  
-  // check for full buffer pool
-  if (!found && numScanned >= 2*numBufs)
+  std::sort(dirtyPages.begin(), dirtyPages.end(),
+      [](const std::pair<PageKey, FrameId> &a, const std::pair<PageKey, FrameId> &b)
+      {
+        return a.first.file != b.first.file ? a.first.file < b.first.file : a.first.pageNo < b.first.pageNo;
+      });
+
+  // a page may have been evicted, cleaned or pinned since it was collected
+  int numWritten = 0;
+  std::vector<File*> files;
+  for (const std::pair<PageKey, FrameId> &dirtyPage : dirtyPages)
   {
-    throw BufferExceededException();
+    BufPartition &part = partitionOf(dirtyPage.second);
+    std::lock_guard<std::mutex> guard(part.mutex);
+    BufDesc &desc = bufDescTable[dirtyPage.second];
+    if (desc.valid && desc.dirty && desc.pinCnt == 0
+        && desc.file == dirtyPage.first.file && desc.pageNo == dirtyPage.first.pageNo)
+    {
+      if (files.empty() || files.back() != desc.file)
+        files.push_back(desc.file);
+      part.count(desc.file, &BufStats::cleanwrites);
+      writeBuf(part, dirtyPage.second);
+      numWritten++;
+    }
   }
-  
-  // flush any existing changes to disk if necessary
-  if (bufDescTable[clockHand].dirty)
+
+  // make the pages written durable, along with the headers of their files
+  for (File *file : files)
+    file->sync();
+
+  // the pages of the attached files written back by evictions since the last checkpoint are made durable too
+  if (log != NULL)
   {
-    bufStats.diskwrites++;
-    //status = bufDescTable[clockHand].file->writePage(bufDescTable[clockHand].pageNo,
-    bufDescTable[clockHand].file->writePage(bufDescTable[clockHand].pageNo, bufPool[clockHand]);
+    for (File *file : log->attachedFiles())
+    {
+      if (std::find(files.begin(), files.end(), file) == files.end())
+        file->sync();
+    }
+    log->checkpoint(redoLsn);
   }
+  return numWritten;
+}
 
-	//Reset all the BufDesc entry for the frame before returning the frame
-  bufDescTable[clockHand].Clear();
+void BufMgr::freeBuf(BufPartition & part, FrameId frame)
+{
+  part.policy->removed(frame - part.base);
+  if (bufDescTable[frame].dirty)
+    part.numDirty--;
+  bufDescTable[frame].Clear();
+  part.freeFrames.push_back(frame);
+}
 
-  // return new frame number
-  frame = clockHand;
-} // end allocBuf
+void BufMgr::throwStatus(BufStatus status, const File* file, const PageId pageNo)
+{
+  switch (status)
+  {
+    case BufStatus::BUFFER_EXCEEDED:
+      throw BufferExceededException();
+    case BufStatus::PAGE_NOT_FOUND:
+      throw HashNotFoundException(file->filename(), pageNo);
+    case BufStatus::PAGE_NOT_PINNED:
+    {
+      FrameId frameNo = 0;
+      hashTable->find(file, pageNo, frameNo);
+      throw PageNotPinnedException(file->filename(), pageNo, frameNo);
+    }
+    case BufStatus::OK:
+      break;
+  }
+}
 
 	
-void BufMgr::readPage(File* file, const PageId pageNo, Page*& page)
+void BufMgr::readPage(File* file, const PageId pageNo, Page*& page, BufRing* ring)
+{
+  BufStatus status = tryReadPage(file, pageNo, page, ring);
+  if (status != BufStatus::OK)
+    throwStatus(status, file, pageNo);
+}
+
+BufStatus BufMgr::tryReadPage(File* file, const PageId pageNo, Page*& page, BufRing* ring)
+{
+  // a full pool takes back the pages the holders keep pinned
+  BufStatus status = tryReadPageOnce(file, pageNo, page, ring);
+  if (status == BufStatus::BUFFER_EXCEEDED && releaseHeldPins())
+    status = tryReadPageOnce(file, pageNo, page, ring);
+  return status;
+}
+
+BufStatus BufMgr::tryReadPageOnce(File* file, const PageId pageNo, Page*& page, BufRing* ring)
 {
   // check to see if it is already in the buffer pool
   // std::cout << "readPage called on file.page " << file << "." << pageNo << endl;
   FrameId frameNo = 0;
-	try
-	{
-  	hashTable->lookup(file, pageNo, frameNo);
+  std::unique_lock<std::mutex> lock;
+  while (true)
+  {
+    if (latchPage(file, pageNo, frameNo, lock))
+    {
+      BufPartition &part = partitionOf(frameNo);
+      part.count(file, &BufStats::accesses);
+      if (numNodes > 1 && threadNode() != part.node)
+        part.count(file, &BufStats::remoteaccesses);
+      part.count(file, &BufStats::hits);
+      // set the referenced bit
+      bufDescTable[frameNo].refbit = true;
+      bufDescTable[frameNo].pinCnt++;
+      part.policy->accessed(frameNo - part.base);
+      page = &bufPool[frameNo];
+      return BufStatus::OK;
+    }
+
+    //not in the buffer pool, must allocate a new page of the node of the thread
+    BufPartition &part = localPartition(file, pageNo);
+    lock = std::unique_lock<std::mutex>(part.mutex);
+    BufStatus status = ring != NULL
+        ? allocRingBuf(part, ring, file, pageNo, frameNo)
+        : allocBuf(part, file, pageNo, frameNo);
+    if (status != BufStatus::OK)
+    {
+      part.count(file, &BufStats::accesses);
+      part.count(file, &BufStats::misses);
+      return status;
+    }
+
+    // the page is entered before it is read, so that another thread missing it meanwhile waits for it
+    try
+    {
+      hashTable->insert(file, pageNo, frameNo);
+    }
+    catch (const HashAlreadyPresentException &)
+    {
+      part.freeFrames.push_back(frameNo);
+      lock.unlock();
+      continue;
+    }
+    part.count(file, &BufStats::accesses);
+    part.count(file, &BufStats::misses);
+
+    // read the page into the new frame, the partition serving its other pages meanwhile
+    BufDesc &desc = bufDescTable[frameNo];
+    desc.file = file;
+    desc.pageNo = pageNo;
+    desc.reading = true;
+    part.count(file, &BufStats::diskreads);
+    threadReads++;
+    lock.unlock();
+    try
+    {
+      file->readPageInto(pageNo, bufPool[frameNo]);
+    }
+    catch (...)
+    {
+      lock.lock();
+      hashTable->remove(file, pageNo);
+      desc.Clear();
+      part.freeFrames.push_back(frameNo);
+      part.ioDone.notify_all();
+      throw;
+    }
+    lock.lock();
+    part.count(file, &BufStats::bytesread, (std::uint64_t)Page::SIZE);
 
-    // set the referenced bit
-    bufDescTable[frameNo].refbit = true;
-    bufDescTable[frameNo].pinCnt++;
+    // set up the entry properly
+    desc.Set(file, pageNo);
+    loadedBuf(frameNo, false);
+    part.policy->loaded(frameNo - part.base, file, pageNo);
+    part.ioDone.notify_all();
     page = &bufPool[frameNo];
+    return BufStatus::OK;
   }
-  catch(const HashNotFoundException &e) //not in the buffer pool, must allocate a new page
+}
+
+
+std::uint32_t BufMgr::prefetchPages(File* file, const std::vector<PageId> &pageNos, BufRing* ring)
+{
+  // take a frame for each page missing from the pool; the frames are out of the free lists and of the
+  // policies, hence owned by the batch, until the reads complete
+  PrefetchBatch prefetch;
+  prefetch.file = file;
+  const PageId numPages = file->numPages();
+  for (PageId pageNo : pageNos)
   {
-    // alloc a new frame
-    allocBuf(frameNo);
+    if (pageNo >= numPages)
+      continue;
+    BufPartition &part = localPartition(file, pageNo);
+    std::lock_guard<std::mutex> guard(part.mutex);
+    FrameId frameNo;
+    if (hashTable->find(file, pageNo, frameNo))
+      continue;
+    BufStatus status = ring != NULL
+        ? allocRingBuf(part, ring, file, pageNo, frameNo)
+        : allocBuf(part, file, pageNo, frameNo);
+    if (status != BufStatus::OK)
+      continue;
 
-    // read the page into the new frame
-    bufStats.diskreads++;
-    //status = file->readPage(pageNo, &bufPool[frameNo]);
-    bufPool[frameNo] = file->readPage(pageNo);
+    // the page is entered before it is read, so that readPage() waits for it rather than reading it again
+    try
+    {
+      hashTable->insert(file, pageNo, frameNo);
+    }
+    catch (const HashAlreadyPresentException &)
+    {
+      part.freeFrames.push_back(frameNo);
+      continue;
+    }
+    bufDescTable[frameNo].file = file;
+    bufDescTable[frameNo].pageNo = pageNo;
+    bufDescTable[frameNo].reading = true;
+    part.count(file, &BufStats::diskreads);
+    file->queueRead(prefetch.batch, pageNo, bufPool[frameNo]);
+    prefetch.reads.push_back({pageNo, frameNo});
+  }
+  if (prefetch.reads.empty())
+    return 0;
 
-    // set up the entry properly
-    bufDescTable[frameNo].Set(file, pageNo);
-    page = &bufPool[frameNo];
+  // the reads count as those of the thread asking for them, though the reader runs them
+  std::uint32_t numIssued = prefetch.reads.size();
+  threadReads += numIssued;
+  {
+    std::lock_guard<std::mutex> lock(readerMutex);
+    if (!readerThread.joinable())
+      readerThread = std::thread(&BufMgr::readerLoop, this);
+    readerQueue.push_back(std::move(prefetch));
+  }
+  readerWakeup.notify_one();
+  return numIssued;
+}
 
-    // insert in the hash table
-    hashTable->insert(file, pageNo, frameNo);
+bool BufMgr::prefetchPage(File* file, const PageId pageNo, BufRing* ring)
+{
+  return prefetchPages(file, std::vector<PageId>(1, pageNo), ring) > 0;
+}
+
+void BufMgr::readerLoop()
+{
+  std::unique_lock<std::mutex> lock(readerMutex);
+  while (true)
+  {
+    readerWakeup.wait(lock, [this]() { return readerStop || !readerQueue.empty(); });
+    if (readerQueue.empty())
+      return;
+    PrefetchBatch prefetch = std::move(readerQueue.front());
+    readerQueue.pop_front();
+    lock.unlock();
+    prefetch.batch.submit();
+    completePrefetch(prefetch);
+    lock.lock();
   }
 }
 
+void BufMgr::completePrefetch(PrefetchBatch &prefetch)
+{
+  File *file = prefetch.file;
+  for (std::size_t i = 0; i < prefetch.reads.size(); i++)
+  {
+    PageId pageNo = prefetch.reads[i].first;
+    FrameId frameNo = prefetch.reads[i].second;
+    BufPartition &part = partitionOf(frameNo);
+    std::lock_guard<std::mutex> guard(part.mutex);
+    part.ioDone.notify_all();
+    if (!prefetch.batch.ok(i))
+    {
+      hashTable->remove(file, pageNo);
+      bufDescTable[frameNo].Clear();
+      part.freeFrames.push_back(frameNo);
+      continue;
+    }
+    part.count(file, &BufStats::bytesread, (std::uint64_t)Page::SIZE);
+
+    bufDescTable[frameNo].Set(file, pageNo);
+    bufDescTable[frameNo].pinCnt = 0;
+    loadedBuf(frameNo, false);
+    part.policy->loaded(frameNo - part.base, file, pageNo);
+  }
+}
 
 void BufMgr::unPinPage(File* file, const PageId pageNo, const bool dirty) 
+{
+  BufStatus status = tryUnPinPage(file, pageNo, dirty);
+  if (status != BufStatus::OK)
+    throwStatus(status, file, pageNo);
+}
+
+BufStatus BufMgr::tryUnPinPage(File* file, const PageId pageNo, const bool dirty) 
 {
   // lookup in hashtable
   FrameId frameNo = 0;
-  hashTable->lookup(file, pageNo, frameNo);
+  std::unique_lock<std::mutex> lock;
+  if (!latchPage(file, pageNo, frameNo, lock))
+    return BufStatus::PAGE_NOT_FOUND;
+  BufPartition &part = partitionOf(frameNo);
+
+  if (dirty == true)
+  {
+    part.count(file, &BufStats::dirtyunpins);
+    if (!bufDescTable[frameNo].dirty)
+    {
+      part.numDirty++;
+      // wake up the background writer, if running, once the partition passes its high water mark
+      if (part.numDirty > highWater * part.numBufs)
+        writerWakeup.notify_one();
+      if (bufDescTable[frameNo].logged)
+        bufDescTable[frameNo].recLsn = log->getEndLsn();
+    }
+    bufDescTable[frameNo].dirty = dirty;
 
-  if (dirty == true) bufDescTable[frameNo].dirty = dirty;
+    // a writer still changing the page leaves its changes to be logged by the next commit
+    if (!logBuf(frameNo))
+      part.unlogged.push_back(frameNo);
+  }
 
   // make sure the page is actually pinned
   if (bufDescTable[frameNo].pinCnt == 0)
-  {
-  	throw PageNotPinnedException(file->filename(), pageNo, frameNo);
-  }
-  else bufDescTable[frameNo].pinCnt--;
+    return BufStatus::PAGE_NOT_PINNED;
+
+  bufDescTable[frameNo].pinCnt--;
+  return BufStatus::OK;
 }
 
 void BufMgr::allocPage(File* file, PageId &pageNo, Page*& page) 
 {
+  BufStatus status = tryAllocPage(file, pageNo, page);
+  if (status != BufStatus::OK)
+    throwStatus(status, file, pageNo);
+}
+
+BufStatus BufMgr::tryAllocPage(File* file, PageId &pageNo, Page*& page) 
+{
+  BufStatus status = tryAllocPageOnce(file, pageNo, page);
+  if (status == BufStatus::BUFFER_EXCEEDED && releaseHeldPins())
+    status = tryAllocPageOnce(file, pageNo, page);
+  return status;
+}
+
+BufStatus BufMgr::tryAllocPageOnce(File* file, PageId &pageNo, Page*& page) 
+{
+  // allocate a new page in the file first, since its number gives its partition among those of the node
+  Page newPage = file->allocatePage(pageNo);
+
+  BufPartition &part = localPartition(file, pageNo);
+  std::lock_guard<std::mutex> guard(part.mutex);
+
   FrameId frameNo;
+  part.count(file, &BufStats::accesses);
 
   // alloc a new frame
-  allocBuf(frameNo);
+  BufStatus status = allocBuf(part, file, pageNo, frameNo);
+  if (status != BufStatus::OK)
+  {
+    // give the page back to the file, if it supports deleting pages
+    try
+    {
+      file->deletePage(pageNo);
+    }
+    catch (const InvalidPageException &)
+    {
+    }
+    return status;
+  }
 
-  // allocate a new page in the file
 	//std::cerr << "buffer data size:" << bufPool[frameNo].data_.length() << "\n";
-  bufPool[frameNo] = file->allocatePage(pageNo);
+  bufPool[frameNo] = newPage;
   page = &bufPool[frameNo];
 
   // set up the entry properly
   bufDescTable[frameNo].Set(file, pageNo);
+  loadedBuf(frameNo, true);
+  part.policy->loaded(frameNo - part.base, file, pageNo);
 
   // insert in the hash table
   hashTable->insert(file, pageNo, frameNo);
+  return BufStatus::OK;
+}
+
+void BufMgr::addPinHolder(PinHolder* holder)
+{
+  std::lock_guard<std::mutex> guard(holdersMutex);
+  pinHolders.push_back(holder);
+}
+
+void BufMgr::removePinHolder(PinHolder* holder)
+{
+  std::lock_guard<std::mutex> guard(holdersMutex);
+  pinHolders.erase(std::remove(pinHolders.begin(), pinHolders.end(), holder), pinHolders.end());
+}
+
+bool BufMgr::reservePin()
+{
+  std::uint32_t n = heldPins.load();
+  do
+  {
+    if (n >= numBufs / HELD_PIN_FRACTION)
+      return false;
+  } while (!heldPins.compare_exchange_weak(n, n + 1));
+  return true;
+}
+
+bool BufMgr::releaseHeldPins()
+{
+  std::lock_guard<std::mutex> guard(holdersMutex);
+  std::uint32_t released = 0;
+  for (PinHolder* holder : pinHolders)
+    released += holder->releasePins();
+  return released > 0;
 }
 
 void BufMgr::flushFile(const File* file) 
 {
-  for (std::uint32_t i = 0; i < numBufs; i++)
-	{
-  	BufDesc* tmpbuf = &(bufDescTable[i]);
-  	if(tmpbuf->file && tmpbuf->valid == true && tmpbuf->file == file)
-		{
-	    if (tmpbuf->pinCnt > 0)
-  			throw PagePinnedException(file->filename(), tmpbuf->pageNo, tmpbuf->frameNo);
-
-	    if (tmpbuf->dirty == true)
-			{
-				//if ((status = tmpbuf->file->writePage(tmpbuf->pageNo, &(bufPool[i]))) != OK)
-				tmpbuf->file->writePage(tmpbuf->pageNo, bufPool[i]);
-				tmpbuf->dirty = false;
-    	}
-
-    	hashTable->remove(file,tmpbuf->pageNo);
-    	tmpbuf->Clear();
-  	}
-		else if (tmpbuf->valid == false && tmpbuf->file == file)
-  		throw BadBufferException(tmpbuf->frameNo, tmpbuf->dirty, tmpbuf->valid, tmpbuf->refbit);
+  for (std::uint32_t p = 0; p < numPartitions; p++)
+  {
+    BufPartition &part = partitions[p];
+    std::unique_lock<std::mutex> lock(part.mutex);
+
+    for (FrameId i = part.base; i < part.base + part.numBufs; i++)
+    {
+      BufDesc* tmpbuf = &(bufDescTable[i]);
+      // a page of the file being read is flushed once it is in
+      part.ioDone.wait(lock, [tmpbuf, file]() { return !(tmpbuf->reading && tmpbuf->file == file); });
+      if(tmpbuf->file && tmpbuf->valid == true && tmpbuf->file == file)
+      {
+        if (tmpbuf->pinCnt > 0)
+          throw PagePinnedException(file->filename(), tmpbuf->pageNo, tmpbuf->frameNo);
+
+        if (tmpbuf->dirty == true)
+        {
+          //if ((status = tmpbuf->file->writePage(tmpbuf->pageNo, &(bufPool[i]))) != OK)
+          writeBuf(part, i);
+        }
+
+        hashTable->remove(file,tmpbuf->pageNo);
+        freeBuf(part, i);
+      }
+      else if (tmpbuf->valid == false && tmpbuf->file == file)
+        throw BadBufferException(tmpbuf->frameNo, tmpbuf->dirty, tmpbuf->valid, tmpbuf->refbit);
+    }
   }
 }
 
@@ -217,17 +956,176 @@ void BufMgr::disposePage(File* file, const PageId pageNo)
 	//Deallocate from file altogether
   //See if it is in the buffer pool
   FrameId frameNo = 0;
-  hashTable->lookup(file, pageNo, frameNo);
-
-	// clear the page
-	bufDescTable[frameNo].Clear();
+  std::unique_lock<std::mutex> lock;
+  if (latchPage(file, pageNo, frameNo, lock))
+  {
+    BufPartition &part = partitionOf(frameNo);
+    if (bufDescTable[frameNo].pinCnt > 0)
+      throw PagePinnedException(file->filename(), pageNo, frameNo);
 
-	hashTable->remove(file, pageNo);
+    // clear the page
+    freeBuf(part, frameNo);
+    hashTable->remove(file, pageNo);
+  }
 
   // deallocate it in the file	
   file->deletePage(pageNo);
 }
 
+void BufMgr::setLog(LogManager *newLog)
+{
+  if (newLog != NULL && logPool == NULL)
+  {
+    void *pool = mmap(NULL, (std::size_t)numBufs * Page::SIZE, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (pool == MAP_FAILED)
+      throw std::bad_alloc();
+    logPool = static_cast<Page*>(pool);
+  }
+  log = newLog;
+}
+
+void BufMgr::loadedBuf(FrameId frame, bool whole)
+{
+  BufDesc &desc = bufDescTable[frame];
+  if (log == NULL || !log->isAttached(desc.file))
+    return;
+  desc.logged = true;
+  desc.logWhole = whole;
+  std::memcpy(&logPool[frame], &bufPool[frame], Page::SIZE);
+}
+
+bool BufMgr::logBuf(FrameId frame)
+{
+  BufDesc &desc = bufDescTable[frame];
+  if (!desc.logged)
+    return true;
+  if (!desc.latch.tryLockShared())
+    return false;
+  Lsn lsn = log->logPage(desc.file, desc.pageNo, logPool[frame], bufPool[frame], desc.logWhole);
+  desc.latch.unlockShared();
+  if (lsn != 0)
+  {
+    desc.pageLsn = lsn;
+    desc.logWhole = false;
+  }
+  return true;
+}
+
+void BufMgr::commit()
+{
+  if (log == NULL)
+    return;
+
+  // the frames left unlogged are waited for until their writers release them
+  for (std::uint32_t p = 0; p < numPartitions; p++)
+  {
+    BufPartition &part = partitions[p];
+    std::unique_lock<std::mutex> lock(part.mutex);
+    while (!part.unlogged.empty())
+    {
+      if (!logBuf(part.unlogged.back()))
+      {
+        lock.unlock();
+        std::this_thread::yield();
+        lock.lock();
+        continue;
+      }
+      part.unlogged.pop_back();
+    }
+  }
+  log->flush(log->getEndLsn());
+}
+
+void BufMgr::boostPage(const Page* page)
+{
+  if (boostRounds == 0)
+    return;
+
+  FrameId frameNo = page - bufPool;
+  std::lock_guard<std::mutex> guard(partitionOf(frameNo).mutex);
+  bufDescTable[frameNo].boost = boostRounds;
+}
+
+void BufStats::add(const BufStats &other)
+{
+  accesses += other.accesses;
+  hits += other.hits;
+  misses += other.misses;
+  diskreads += other.diskreads;
+  diskwrites += other.diskwrites;
+  dirtyunpins += other.dirtyunpins;
+  cleanwrites += other.cleanwrites;
+  cleanevictions += other.cleanevictions;
+  dirtyevictions += other.dirtyevictions;
+  bufferexceeded += other.bufferexceeded;
+  remoteaccesses += other.remoteaccesses;
+  bytesread += other.bytesread;
+  byteswritten += other.byteswritten;
+  for (int i = 0; i < SWEEP_BUCKETS; i++)
+    sweeplengths[i] += other.sweeplengths[i];
+}
+
+void BufStats::addSweep(std::uint32_t numScanned)
+{
+  // bucket i > 0 holds the lengths in (2^(i-1), 2^i]
+  int bucket = 0;
+  while (bucket < SWEEP_BUCKETS - 1 && (1u << bucket) < numScanned)
+    bucket++;
+  sweeplengths[bucket]++;
+}
+
+BufStats BufMgr::getBufStats()
+{
+  BufStats total;
+  for (std::uint32_t p = 0; p < numPartitions; p++)
+  {
+    std::lock_guard<std::mutex> guard(partitions[p].mutex);
+    total.add(partitions[p].bufStats);
+  }
+  return total;
+}
+
+BufStats BufMgr::getNodeStats(std::uint32_t node)
+{
+  BufStats total;
+  for (std::uint32_t p = 0; p < numPartitions; p++)
+  {
+    if (partitions[p].node != node)
+      continue;
+    std::lock_guard<std::mutex> guard(partitions[p].mutex);
+    total.add(partitions[p].bufStats);
+  }
+  return total;
+}
+
+BufStats BufMgr::getBufStats(const File* file)
+{
+  BufStats total;
+  for (std::uint32_t p = 0; p < numPartitions; p++)
+  {
+    std::lock_guard<std::mutex> guard(partitions[p].mutex);
+    std::unordered_map<const File*, BufStats>::const_iterator stats = partitions[p].fileStats.find(file);
+    if (stats != partitions[p].fileStats.end())
+      total.add(stats->second);
+  }
+  return total;
+}
+
+std::uint64_t BufMgr::threadDiskReads()
+{
+  return threadReads;
+}
+
+void BufMgr::clearBufStats()
+{
+  for (std::uint32_t p = 0; p < numPartitions; p++)
+  {
+    std::lock_guard<std::mutex> guard(partitions[p].mutex);
+    partitions[p].clearStats();
+  }
+}
+
 void BufMgr::printSelf(void) 
 {
   BufDesc* tmpbuf;
@@ -9,7 +9,17 @@
 
 #include "file.h"
 #include "bufHashTbl.h"
+#include "log_manager.h"
+#include "replacement.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <iostream>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 namespace badgerdb {
 
@@ -18,12 +28,144 @@ namespace badgerdb {
 */
 class BufMgr;
 
+/**
+* @brief Latch of a buffer frame, protecting the page held in it against concurrent changes.
+* A writer holds it exclusively, a reader either shared or not at all: an optimistic reader reads the version,
+* reads the page without latching it, and validates afterwards that the version has not changed.
+* The version is odd while a writer holds the latch, and is never reset, even when the frame is reused.
+* Waiting for the latch spins, yielding the processor, since it is only held for the time of a node operation.
+*/
+class FrameLatch {
+
+ private:
+	/**
+   * Version of the page, incremented when a writer acquires and when it releases the latch
+	 */
+  std::atomic<std::uint64_t> version;
+
+	/**
+   * Number of readers holding the latch shared
+	 */
+  std::atomic<int> readers;
+
+ public:
+	/**
+   * Constructor of FrameLatch class
+	 */
+  FrameLatch() : version(0), readers(0) {}
+
+	/**
+	 * Wait until no writer holds the latch, and return the version of the page to read it optimistically.
+	 *
+	 * @return the version
+	 */
+  std::uint64_t readVersion() const
+  {
+		std::uint64_t v;
+		while ((v = version.load()) & 1)
+		{
+			std::this_thread::yield();
+		}
+		return v;
+  }
+
+	/**
+	 * Return the version of a page latched shared by the caller. A writer waiting for the latch
+	 * has already made the version odd, but changes nothing until the latch is released.
+	 *
+	 * @return the version
+	 */
+  std::uint64_t sharedVersion() const
+  {
+		return version.load() & ~(std::uint64_t)1;
+  }
+
+	/**
+	 * Check that no writer has latched the page since its version was read.
+	 *
+	 * @param v	Version returned by readVersion
+	 * @return whether the reads of the page made in between are consistent
+	 */
+  bool validate(std::uint64_t v) const
+  {
+		std::atomic_thread_fence(std::memory_order_acquire);
+		return version.load(std::memory_order_relaxed) == v;
+  }
+
+	/**
+	 * Acquire the latch shared, waiting for any writer holding or waiting for it.
+	 */
+  void lockShared()
+  {
+		while (true)
+		{
+			readers.fetch_add(1);
+			if (!(version.load() & 1))
+			{
+				return;
+			}
+			readers.fetch_sub(1);
+			readVersion();
+		}
+  }
+
+	/**
+	 * Acquire the latch shared unless a writer holds or waits for it.
+	 *
+	 * @return whether the latch was acquired
+	 */
+  bool tryLockShared()
+  {
+		readers.fetch_add(1);
+		if (!(version.load() & 1))
+		{
+			return true;
+		}
+		readers.fetch_sub(1);
+		return false;
+  }
+
+	/**
+	 * Release the latch held shared.
+	 */
+  void unlockShared()
+  {
+		readers.fetch_sub(1, std::memory_order_release);
+  }
+
+	/**
+	 * Acquire the latch exclusively, waiting for the other writers and then for the readers holding it.
+	 * Readers arriving meanwhile wait for the writer.
+	 */
+  void lockExclusive()
+  {
+		std::uint64_t v = readVersion();
+		while (!version.compare_exchange_weak(v, v + 1))
+		{
+			v = readVersion();
+		}
+		while (readers.load() != 0)
+		{
+			std::this_thread::yield();
+		}
+  }
+
+	/**
+	 * Release the latch held exclusively, giving the page a new version.
+	 */
+  void unlockExclusive()
+  {
+		version.fetch_add(1, std::memory_order_release);
+  }
+};
+
 /**
 * @brief Class for maintaining information about buffer pool frames
 */
 class BufDesc {
 
 	friend class BufMgr;
+	friend class ReplacementPolicy;
 
  private:
 	/**
@@ -56,11 +198,48 @@ class BufDesc {
 	 */
   bool valid;
 
+	/**
+   * True while the page is read into the frame, the latch of its partition being released meanwhile. The frame is
+   * in the hash table, but neither valid nor known to the policy, and the threads asking for the page wait on the
+   * ioDone condition of the partition until the read completes
+	 */
+  bool reading;
+
 	/**
    * Has this buffer frame been reference recently
 	 */
   bool refbit;
 
+	/**
+   * Number of times the page may still be spared when chosen for eviction, set by BufMgr::boostPage
+	 */
+  std::uint8_t boost;
+
+	/**
+   * Latch of the page held in this frame. It is left untouched when the frame is cleared or reassigned
+	 */
+  FrameLatch latch;
+
+	/**
+   * Whether the changes of the page are logged, its file being attached to the log of the buffer manager
+	 */
+  bool logged;
+
+	/**
+   * Whether the next record of the page logs all its bytes, its image on disk being unknown
+	 */
+  bool logWhole;
+
+	/**
+   * LSN of the last record of the page, which must be synced before the page is written back
+	 */
+  Lsn pageLsn;
+
+	/**
+   * End of the log when the page became dirty, 0 while it is clean: its records all follow it
+	 */
+  Lsn recLsn;
+
 	/**
    * Initialize buffer frame for a new user
 	 */
@@ -72,6 +251,10 @@ class BufDesc {
     dirty = false;
     refbit = false;
 		valid = false;
+		reading = false;
+		boost = 0;
+		logged = logWhole = false;
+		pageLsn = recLsn = 0;
   };
 
 	/**
@@ -88,7 +271,11 @@ class BufDesc {
     pinCnt = 1;
     dirty = false;
     valid = true;
+    reading = false;
     refbit = true;
+    boost = 0;
+    logged = logWhole = false;
+    pageLsn = recLsn = 0;
   }
 
   void Print()
@@ -104,7 +291,8 @@ class BufDesc {
 		std::cout << "valid:" << valid << " ";
 		std::cout << "pinCnt:" << pinCnt << " ";
 		std::cout << "dirty:" << dirty << " ";
-		std::cout << "refbit:" << refbit << "\n";
+		std::cout << "refbit:" << refbit << " ";
+		std::cout << "boost:" << (int)boost << "\n";
   }
 
 	/**
@@ -123,26 +311,113 @@ class BufDesc {
 struct BufStats
 {
 	/**
-   * Total number of accesses to buffer pool
+   * Number of buckets of the histogram of the eviction sweep lengths
+	 */
+  static const int SWEEP_BUCKETS = 16;
+
+	/**
+   * Total number of accesses to buffer pool, i.e. of pages read or allocated
+	 */
+  std::uint64_t accesses;
+
+	/**
+   * Number of pages read which were found in the buffer pool
 	 */
-  int accesses;
+  std::uint64_t hits;
+
+	/**
+   * Number of pages read which were not in the buffer pool, and were read from disk unless no frame was free
+	 */
+  std::uint64_t misses;
 
 	/**
    * Number of pages read from disk (including allocs)
 	 */
-  int diskreads;
+  std::uint64_t diskreads;
 
 	/**
    * Number of pages written back to disk
 	 */
-  int diskwrites;
+  std::uint64_t diskwrites;
+
+	/**
+   * Number of unpins marking a page dirty, i.e. of page updates. Divided by the number of updates
+   * made through the pages, it gives the number of pages each one changes
+	 */
+  std::uint64_t dirtyunpins;
+
+	/**
+   * Number of pages written back ahead of their eviction, by the background writer or a checkpoint. They are
+   * counted in diskwrites too
+	 */
+  std::uint64_t cleanwrites;
+
+	/**
+   * Number of pages evicted while clean, i.e. without being written
+	 */
+  std::uint64_t cleanevictions;
+
+	/**
+   * Number of pages evicted while dirty, i.e. written back to make room. A high share of them means the
+   * background writer falls behind
+	 */
+  std::uint64_t dirtyevictions;
+
+	/**
+   * Number of frame allocations which failed because every frame was pinned (BufferExceededException)
+	 */
+  std::uint64_t bufferexceeded;
+
+	/**
+   * Number of accesses from a thread running on another NUMA node than the one holding the frame of the page,
+   * counted in NUMA mode only
+	 */
+  std::uint64_t remoteaccesses;
+
+	/**
+   * Number of bytes read from and written to disk
+	 */
+  std::uint64_t bytesread;
+  std::uint64_t byteswritten;
+
+	/**
+   * Histogram of the number of frames the eviction policy looked at to choose a victim: bucket 0 counts the
+   * evictions which looked at one frame, bucket i > 0 those which looked at more than 2^(i-1) and at most 2^i,
+   * and the last bucket all the longer ones. Long sweeps mean that the pool holds mostly pinned or hot pages
+	 */
+  std::uint64_t sweeplengths[SWEEP_BUCKETS];
 
 	/**
    * Clear all values 
 	 */
   void clear()
   {
-		accesses = diskreads = diskwrites = 0;
+		accesses = hits = misses = diskreads = diskwrites = dirtyunpins = cleanwrites = 0;
+		cleanevictions = dirtyevictions = bufferexceeded = remoteaccesses = 0;
+		bytesread = byteswritten = 0;
+		std::fill(sweeplengths, sweeplengths + SWEEP_BUCKETS, 0);
+  }
+
+	/**
+   * Add the values of other statistics to these
+	 *
+   * @param other 	Statistics to add
+	 */
+  void add(const BufStats &other);
+
+	/**
+   * Count an eviction whose policy looked at a number of frames in the histogram of sweep lengths
+	 *
+   * @param numScanned 	Number of frames looked at, at least 1
+	 */
+  void addSweep(std::uint32_t numScanned);
+
+	/**
+   * Share of the pages read which were found in the buffer pool, 0 if no page was read
+	 */
+  double hitRatio() const
+  {
+		return hits + misses > 0 ? (double)hits / (hits + misses) : 0;
   }
       
 	/**
@@ -156,139 +431,901 @@ struct BufStats
 
 
 /**
-* @brief The central class which manages the buffer pool including frame allocation and deallocation to pages in the file 
+* @brief A holder of pages it keeps pinned in the buffer pool for its own use, such as the node cache of a
+* BTreeIndex. The holders of a buffer manager share a budget of pins, and are asked to give them back when
+* the pool runs out of frames.
 */
-class BufMgr 
+class PinHolder
+{
+ public:
+  virtual ~PinHolder() {}
+
+	/**
+	 * Unpin the pages held, except those in use, and return their pins to the budget.
+	 *
+	 * @return number of pages unpinned
+	 */
+  virtual std::uint32_t releasePins() = 0;
+};
+
+
+/**
+* @brief A small ring of frames private to a sequential scan, which recycles its own frames rather than
+* evicting pages of the shared pool. Pages read through a ring are in the pool like any other, and may be
+* found there by other readers, but a scan of any length only takes the frames of its ring.
+* A ring may only be used by one thread at a time.
+*/
+class BufRing
 {
+	friend class BufMgr;
+
+ public:
+	/**
+   * Default number of frames of a ring, i.e. 256KB of pages
+	 */
+  static const std::uint32_t DEFAULT_SIZE = 32;
+
+	/**
+   * Constructor of BufRing class
+	 *
+	 * @param size  	Number of frames of the ring, split between the partitions of the pool. The buffer manager
+	 * 								takes at most 1/8 of each partition
+	 */
+  BufRing(std::uint32_t size = DEFAULT_SIZE)
+		: capacity(size)
+  {
+  }
+
  private:
 	/**
-   * Current position of clockhand in our buffer pool
+   * Maximum number of frames of the ring
 	 */
-  FrameId clockHand;
+  std::uint32_t capacity;
 
 	/**
-   * Number of frames in the buffer pool
+   * Frames taken by the ring in a partition of the pool so far, with the pages read in them, and the position of
+   * the next one to recycle once they are all taken
 	 */
-  std::uint32_t numBufs;
-	
+  struct Part {
+    std::vector<FrameId> frames;
+    std::vector<PageKey> pages;
+    std::uint32_t next;
+  };
+
 	/**
-   * Hash table mapping (File, page) to frame
+   * Frames taken in each partition, the pages of a partition being read in its own frames
 	 */
-  BufHashTbl *hashTable;
+  std::vector<Part> parts;
+};
+
 
+/**
+* @brief Outcome of the non-throwing methods of BufMgr, each error matching the exception thrown by the
+* corresponding throwing method.
+*/
+enum class BufStatus
+{
 	/**
-   * Array of BufDesc objects to hold information corresponding to every frame allocation from 'bufPool' (the buffer pool)
+   * The call succeeded
 	 */
-  BufDesc *bufDescTable;
+  OK,
 
 	/**
-   * Maintains Buffer pool usage statistics 
+   * Every frame is pinned, so no frame can be allocated (BufferExceededException)
 	 */
-  BufStats bufStats;
+  BUFFER_EXCEEDED,
 
 	/**
-   * Advance clock to next frame in the buffer pool
+   * The page is not in the buffer pool (HashNotFoundException)
 	 */
-  void advanceClock()
-  {
-		clockHand = (clockHand + 1) % numBufs;
-  }
+  PAGE_NOT_FOUND,
 
 	/**
-	 * Allocate a free frame.  
-	 *
-	 * @param frame   	Frame reference, frame ID of allocated frame returned via this variable
-	 * @throws BufferExceededException If no such buffer is found which can be allocated
+   * The page is not pinned (PageNotPinnedException)
 	 */
-  void allocBuf(FrameId & frame);
+  PAGE_NOT_PINNED
+};
 
- public:
+
+/**
+* @brief A partition of the buffer pool: a range of frames with its own latch, free frames, eviction policy and
+* statistics. A page missing from the pool is read into the partition its file and page number hash to among
+* the partitions of the node of the thread asking for it, all of them but in NUMA mode, and stays in that frame
+* until it is evicted. The hash table locates the frame, hence the partition, of a page in the pool, whose latch
+* protects the page's descriptor. So the calls for pages of different partitions run in parallel, and an
+* eviction only looks at the frames of one partition.
+*/
+struct BufPartition
+{
 	/**
-   * Actual buffer pool from which frames are allocated
+   * Serializes the calls to the partition
 	 */
-  Page* bufPool;
+  std::mutex mutex;
 
 	/**
-   * Constructor of BufMgr class
+   * Signalled when a read into a frame of the partition completes, for the threads waiting for its page
 	 */
-  BufMgr(std::uint32_t bufs);
-	
+  std::condition_variable ioDone;
+
 	/**
-   * Destructor of BufMgr class
+   * First frame of the partition. The policy numbers the frames from it
 	 */
-  ~BufMgr();
+  FrameId base;
 
 	/**
-	 * Reads the given page from the file into a frame and returns the pointer to page.
-	 * If the requested page is already present in the buffer pool pointer to that frame is returned
-	 * otherwise a new frame is allocated from the buffer pool for reading the page.
-	 *
-	 * @param file   	File object
-	 * @param PageNo  Page number in the file to be read
-	 * @param page  	Reference to page pointer. Used to fetch the Page object in which requested page from file is read in.
+   * Number of frames in the partition
 	 */
-  void readPage(File* file, const PageId PageNo, Page*& page);
+  std::uint32_t numBufs;
 
 	/**
-	 * Unpin a page from memory since it is no longer required for it to remain in memory.
-	 *
-	 * @param file   	File object
-	 * @param PageNo  Page number
-	 * @param dirty		True if the page to be unpinned needs to be marked dirty	
-   * @throws  PageNotPinnedException If the page is not already pinned
+   * Sub-pool of the NUMA node the frames of the partition are allocated on, 0 unless in NUMA mode
 	 */
-  void unPinPage(File* file, const PageId PageNo, const bool dirty);
+  std::uint32_t node;
 
 	/**
-	 * Allocates a new, empty page in the file and returns the Page object.
-	 * The newly allocated page is also assigned a frame in the buffer pool.
-	 *
-	 * @param file   	File object
-	 * @param PageNo  Page number. The number assigned to the page in the file is returned via this reference.
-	 * @param page  	Reference to page pointer. The newly allocated in-memory Page object is returned via this reference.
+   * Policy choosing the pages to evict
 	 */
-  void allocPage(File* file, PageId &PageNo, Page*& page); 
+  ReplacementPolicy *policy;
 
 	/**
-	 * Writes out all dirty pages of the file to disk.
-	 * All the frames assigned to the file need to be unpinned from buffer pool before this function can be successfully called.
-	 * Otherwise Error returned.
-	 *
-	 * @param file   	File object
-   * @throws  PagePinnedException If any page of the file is pinned in the buffer pool 
-   * @throws BadBufferException If any frame allocated to the file is found to be invalid
+   * Frames holding no page, taken before any page is evicted
 	 */
-  void flushFile(const File* file);
+  std::vector<FrameId> freeFrames;
 
 	/**
-	 * Delete page from file and also from buffer pool if present.
-	 * Since the page is entirely deleted from file, its unnecessary to see if the page is dirty.
-	 *
-	 * @param file   	File object
-	 * @param PageNo  Page number
+   * Number of dirty frames in the partition
 	 */
-  void disposePage(File* file, const PageId PageNo);
+  std::uint32_t numDirty;
 
 	/**
-   * Print member variable values. 
+   * Buffer usage statistics of the partition
 	 */
-  void  printSelf();
+  BufStats bufStats;
+
+	/**
+   * Buffer usage statistics of the partition broken down by file, kept until they are cleared
+	 */
+  std::unordered_map<const File*, BufStats> fileStats;
+
+	/**
+   * File whose statistics were last counted, and its entry in fileStats, sparing a hash lookup for runs of
+   * pages of the same file
+	 */
+  const File *lastFile;
+  BufStats *lastFileStats;
+
+	/**
+   * Frames whose changes could not be logged when they were unpinned, a writer holding their latch, and which
+   * BufMgr::commit() logs
+	 */
+  std::vector<FrameId> unlogged;
 
 	/**
-   * Get buffer pool usage statistics
+   * Count an event of a page of a file in the statistics of the partition and of the file.
+	 *
+   * @param file  	File of the page
+   * @param counter	Counter of the event
+   * @param n 		Amount to count
+	 */
+  template <class C>
+  void count(const File *file, C BufStats::*counter, C n = 1)
+  {
+		bufStats.*counter += n;
+		statsOf(file).*counter += n;
+  }
+
+	/**
+   * Get the statistics of the pages of a file in the partition.
+	 *
+   * @param file  	File
+   * @return the statistics of the file, created if it has none
 	 */
-  BufStats & getBufStats()
+  BufStats &statsOf(const File *file)
   {
-		return bufStats;
+		if (file != lastFile)
+		{
+			lastFileStats = &fileStats[file];
+			lastFile = file;
+		}
+		return *lastFileStats;
   }
 
 	/**
-   * Clear buffer pool usage statistics
+   * Clear the statistics of the partition
 	 */
-  void clearBufStats() 
+  void clearStats()
   {
 		bufStats.clear();
+		fileStats.clear();
+		lastFile = NULL;
+		lastFileStats = NULL;
   }
+
+	/**
+   * Constructor of BufPartition class
+	 */
+  BufPartition() : node(0), numDirty(0), lastFile(NULL), lastFileStats(NULL) {}
+};
+
+
+/**
+* @brief The central class which manages the buffer pool including frame allocation and deallocation to pages in the file 
+* Its methods may be called from several threads at once, and only latch the partition of the page they are called for.
+* The pages themselves are protected by the latches of their frames.
+*/
+class BufMgr 
+{
+ public:
+	/**
+   * Smallest number of frames of a partition when the number of partitions is chosen by the buffer manager
+	 */
+  static const std::uint32_t MIN_PARTITION_BUFS = 64;
+
+	/**
+   * Time between two rounds of the background writer, in milliseconds
+	 */
+  static const int WRITER_INTERVAL_MS = 10;
+
+	/**
+   * Largest number of pages the background writer submits as one batch, keeping the device busy enough
+	 */
+  static const std::uint32_t WRITER_BATCH = 32;
+
+	/**
+   * Size of the huge pages the buffer pool may be mapped on
+	 */
+  static const std::size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+	/**
+   * The pin holders of a buffer manager together hold at most 1 / HELD_PIN_FRACTION of its frames
+	 */
+  static const std::uint32_t HELD_PIN_FRACTION = 8;
+
+ private:
+	/**
+   * Number of frames in the buffer pool
+	 */
+  std::uint32_t numBufs;
+	
+	/**
+   * Hash table mapping (File, page) to frame
+	 */
+  BufHashTbl *hashTable;
+
+	/**
+   * Array of BufDesc objects to hold information corresponding to every frame allocation from 'bufPool' (the buffer pool)
+	 */
+  BufDesc *bufDescTable;
+
+	/**
+   * Partitions of the buffer pool
+	 */
+  BufPartition *partitions;
+
+	/**
+   * Size of the memory mapped for the buffer pool
+	 */
+  std::size_t poolSize;
+
+	/**
+   * Number of partitions
+	 */
+  std::uint32_t numPartitions;
+
+	/**
+   * Number of NUMA nodes the pool is split between, one sub-pool each, 1 unless in NUMA mode
+	 */
+  std::uint32_t numNodes;
+
+	/**
+   * Sub-pool of the node of each CPU, by CPU number, in NUMA mode
+	 */
+  std::vector<std::uint32_t> cpuNodes;
+
+	/**
+   * First partition of each sub-pool, and the number of partitions after those of the last one
+	 */
+  std::vector<std::uint32_t> nodePartitions;
+
+	/**
+	 * Split the partitions into one sub-pool per NUMA node of the system having memory, a run of consecutive
+	 * partitions each, and bind the frames of each sub-pool to its node before they are first touched. The
+	 * pool is left as one sub-pool if the system has a single node or its topology cannot be read.
+	 *
+	 * @param nodeIds Numbers of the nodes having memory
+	 */
+  void placeNodes(const std::vector<std::uint32_t> &nodeIds);
+
+	/**
+	 * Find the sub-pool of the node the calling thread runs on.
+	 *
+	 * @return the sub-pool, 0 unless in NUMA mode
+	 */
+  std::uint32_t threadNode() const;
+
+	/**
+   * Number of times a boosted page is spared by eviction
+	 */
+  std::uint8_t boostRounds;
+
+	/**
+   * Log of the changes of the pages of its attached files, NULL if none is logged
+	 */
+  LogManager *log;
+
+	/**
+   * Images of the pages of the frames as last logged, allocated along with the log
+	 */
+  Page *logPool;
+
+	/**
+	 * Start logging the page loaded in a frame, if its file is attached to the log, from its image as loaded.
+	 *
+	 * @param frame   	Frame number
+	 * @param whole   	Whether the image on disk of the page is unknown, for a page just allocated
+	 */
+  void loadedBuf(FrameId frame, bool whole);
+
+	/**
+   * Pin holders registered with the buffer manager, under holdersMutex
+	 */
+  std::vector<PinHolder*> pinHolders;
+  std::mutex holdersMutex;
+
+	/**
+   * Number of pins taken by the holders out of their budget
+	 */
+  std::atomic<std::uint32_t> heldPins;
+
+	/**
+	 * Ask the pin holders to give back their pins, once the pool has run out of frames.
+	 * Called without the latch of any partition, since the holders unpin their pages.
+	 *
+	 * @return whether a page was unpinned
+	 */
+  bool releaseHeldPins();
+
+	/**
+	 * Same as tryReadPage(), without asking the pin holders for frames.
+	 */
+  BufStatus tryReadPageOnce(File* file, const PageId PageNo, Page*& page, BufRing* ring);
+
+	/**
+	 * Same as tryAllocPage(), without asking the pin holders for frames.
+	 */
+  BufStatus tryAllocPageOnce(File* file, PageId &PageNo, Page*& page);
+
+	/**
+	 * Log the changes of the page held in a frame since it was last logged, if it is logged. A writer changing
+	 * the page may hold its latch, in which case nothing is logged; an unpinned page is never latched.
+	 *
+	 * @param frame   	Frame number
+	 * @return whether the changes were logged, false if a writer holds the latch
+	 */
+  bool logBuf(FrameId frame);
+
+	/**
+	 * Find the partition a page missing from the pool is read into, among those of the node of the calling thread.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number in the file
+	 * @return  			The partition the page goes to.
+	 */
+  BufPartition & localPartition(const File* file, const PageId PageNo);
+
+	/**
+	 * Find a page in the buffer pool and latch the partition of its frame. A page is entered in the hash table
+	 * before it is read, so a page still being read by another thread is waited for.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number in the file
+	 * @param frame  	Returned frame of the page
+	 * @param lock  	Returned holding the latch of the partition of the frame, if the page is found
+	 * @return  			Whether the page is in the pool.
+	 */
+  bool latchPage(const File* file, const PageId PageNo, FrameId &frame, std::unique_lock<std::mutex> &lock);
+
+	/**
+	 * Find the partition of a frame.
+	 *
+	 * @param frame   	Frame number
+	 * @return  			The partition holding the frame.
+	 */
+  BufPartition & partitionOf(FrameId frame);
+
+	/**
+	 * Allocate a free frame of a latched partition, evicting a page if none is free.
+	 *
+	 * @param part   	Partition
+	 * @param file   	File of the page to load in the frame
+	 * @param PageNo  Page number of the page to load, Page::INVALID_NUMBER for a newly allocated page
+	 * @param frame   	Frame reference, frame ID of allocated frame returned via this variable
+	 * @return BufStatus::BUFFER_EXCEEDED if no such buffer is found which can be allocated
+	 */
+  BufStatus allocBuf(BufPartition & part, const File* file, const PageId PageNo, FrameId & frame);
+
+	/**
+	 * Allocate a frame of a latched partition for a page read through a ring. While the ring has not taken its
+	 * share of the partition, a frame is allocated as by allocBuf() and added to the ring. Then the frames of
+	 * the ring are recycled in turn, unless the page read in one is pinned or was evicted meanwhile, in which
+	 * case a frame allocated by allocBuf() replaces it.
+	 *
+	 * @param part   	Partition
+	 * @param ring   	Ring of the scan
+	 * @param file   	File of the page to load in the frame
+	 * @param PageNo  Page number of the page to load
+	 * @param frame   	Frame reference, frame ID of allocated frame returned via this variable
+	 * @return BufStatus::BUFFER_EXCEEDED if no such buffer is found which can be allocated
+	 */
+  BufStatus allocRingBuf(BufPartition & part, BufRing* ring, const File* file, const PageId PageNo, FrameId & frame);
+
+	/**
+	 * Get the number of frames a ring takes in a partition: its share of the partitions, and at most 1/8 of it.
+	 *
+	 * @param part   	Partition
+	 * @param ring   	Ring of the scan
+	 * @return the number of frames
+	 */
+  std::uint32_t ringShare(const BufPartition & part, const BufRing &ring) const;
+
+	/**
+	 * Remove the page held in a frame of a latched partition from the pool, writing it back if it is dirty.
+	 *
+	 * @param part   	Partition
+	 * @param frame   	Frame number
+	 */
+  void evictBuf(BufPartition & part, FrameId frame);
+
+	/**
+	 * Write back the dirty page held in a frame of a latched partition, which becomes clean.
+	 *
+	 * @param part   	Partition
+	 * @param frame   	Frame number
+	 */
+  void writeBuf(BufPartition & part, FrameId frame);
+
+	/**
+	 * Write back dirty unpinned pages of a partition if more than the high water mark of its frames are dirty,
+	 * until no more than the low water mark are. The frames are swept from the next victim hinted by the
+	 * policy, and the pages are submitted in batches of WRITER_BATCH, the partition being latched for one
+	 * batch at a time.
+	 *
+	 * @param part   	Partition
+	 */
+  void cleanPartition(BufPartition & part);
+
+	/**
+	 * Body of the background writer thread, cleaning the partitions every WRITER_INTERVAL_MS milliseconds
+	 * or when woken up, until stopped.
+	 */
+  void writerLoop();
+
+	/**
+   * Background writer thread, if started
+	 */
+  std::thread writerThread;
+
+	/**
+   * Protects writerStop, and lets the writer be woken up through writerWakeup
+	 */
+  std::mutex writerMutex;
+  std::condition_variable writerWakeup;
+
+	/**
+   * Whether the background writer should stop
+	 */
+  bool writerStop;
+
+	/**
+   * Fractions of the frames of a partition above which the background writer starts writing back pages, and
+   * down to which it writes them
+	 */
+  double highWater, lowWater;
+
+	/**
+   * @brief Reads of prefetchPages() left to the background reader: the batch, and the page and frame of each read
+	 */
+  struct PrefetchBatch
+  {
+    File* file;
+    IoBatch batch;
+    std::vector<std::pair<PageId, FrameId>> reads;
+  };
+
+	/**
+	 * Body of the background reader thread, running the batches of prefetchPages() in the order they are queued
+	 * until stopped, once its queue is empty.
+	 */
+  void readerLoop();
+
+	/**
+	 * Set up the frames of a batch of prefetchPages() once it is run, or free them for the reads which failed,
+	 * and wake up the threads waiting for their pages.
+	 *
+	 * @param prefetch 	Batch run
+	 */
+  void completePrefetch(PrefetchBatch &prefetch);
+
+	/**
+   * Background reader thread, started by the first prefetchPages()
+	 */
+  std::thread readerThread;
+
+	/**
+   * Protects readerQueue and readerStop, and lets the reader be woken up through readerWakeup
+	 */
+  std::mutex readerMutex;
+  std::condition_variable readerWakeup;
+
+	/**
+   * Batches of prefetchPages() not run yet
+	 */
+  std::deque<PrefetchBatch> readerQueue;
+
+	/**
+   * Whether the background reader should stop
+	 */
+  bool readerStop;
+
+	/**
+	 * Return a frame of a latched partition to its free frames, telling the policy its page left the pool.
+	 *
+	 * @param part   	Partition
+	 * @param frame   	Frame number
+	 */
+  void freeBuf(BufPartition & part, FrameId frame);
+
+	/**
+	 * Throw the exception matching the status of a failed call to a non-throwing method.
+	 *
+	 * @param status 	Status returned by the call
+	 * @param file   	File object passed to the call
+	 * @param PageNo  Page number passed to the call
+	 */
+  void throwStatus(BufStatus status, const File* file, const PageId PageNo);
+
+ public:
+	/**
+   * Actual buffer pool from which frames are allocated, aligned on a memory page for direct I/O
+	 */
+  Page* bufPool;
+
+	/**
+   * Constructor of BufMgr class
+	 *
+	 * @param bufs  	Number of frames in the buffer pool
+	 * @param policy 	Eviction policy, owned by the buffer manager from then on, and cloned for each partition.
+	 * 							The clock algorithm if NULL
+	 * @param parts 	Number of partitions, rounded down to a power of 2. If 0, one per hardware thread, as long as
+	 * 							each partition has at least MIN_PARTITION_BUFS frames
+	 * @param hugePages Whether to map the pool on huge pages of HUGE_PAGE_SIZE, to save TLB misses on a large
+	 * 							pool. Huge pages reserved by the system are used if any, transparent huge pages otherwise
+	 * @param numa 	Whether to split the pool into one sub-pool per NUMA node, with at least one partition each,
+	 * 							the frames of a sub-pool being allocated on its node. A page missing from the pool is read into
+	 * 							the sub-pool of the node of the thread asking for it, and the accesses of threads of other
+	 * 							nodes to it are counted in remoteaccesses
+	 */
+  BufMgr(std::uint32_t bufs, ReplacementPolicy *policy = NULL, std::uint32_t parts = 0, bool hugePages = false,
+         bool numa = false);
+	
+	/**
+   * Destructor of BufMgr class
+	 */
+  ~BufMgr();
+
+	/**
+	 * Reads the given page from the file into a frame and returns the pointer to page.
+	 * If the requested page is already present in the buffer pool pointer to that frame is returned
+	 * otherwise a new frame is allocated from the buffer pool for reading the page.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number in the file to be read
+	 * @param page  	Reference to page pointer. Used to fetch the Page object in which requested page from file is read in.
+	 * @param ring  	Ring of a sequential scan to read the page in if it is not in the pool, NULL for the shared pool
+	 */
+  void readPage(File* file, const PageId PageNo, Page*& page, BufRing* ring = NULL);
+
+	/**
+	 * Same as readPage(), reporting a full buffer pool through the returned status rather than an exception.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number in the file to be read
+	 * @param page  	Reference to page pointer, set if the call succeeds
+	 * @param ring  	Ring of a sequential scan to read the page in if it is not in the pool, NULL for the shared pool
+	 * @return BufStatus::OK, or BufStatus::BUFFER_EXCEEDED if every frame is pinned
+	 */
+  BufStatus tryReadPage(File* file, const PageId PageNo, Page*& page, BufRing* ring = NULL);
+
+	/**
+	 * Unpin a page from memory since it is no longer required for it to remain in memory.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number
+	 * @param dirty		True if the page to be unpinned needs to be marked dirty	
+   * @throws  PageNotPinnedException If the page is not already pinned
+	 */
+  void unPinPage(File* file, const PageId PageNo, const bool dirty);
+
+	/**
+	 * Same as unPinPage(), reporting errors through the returned status rather than exceptions.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number
+	 * @param dirty		True if the page to be unpinned needs to be marked dirty	
+	 * @return BufStatus::OK, BufStatus::PAGE_NOT_FOUND if the page is not in the buffer pool,
+	 * 				 or BufStatus::PAGE_NOT_PINNED if it is not pinned
+	 */
+  BufStatus tryUnPinPage(File* file, const PageId PageNo, const bool dirty);
+
+	/**
+	 * Reads pages of a file into the buffer pool ahead of their use, without waiting for them. The pages are
+	 * entered in the pool, and their reads are submitted as one batch by a background reader thread; the first
+	 * readPage() of a page still being read waits for its read. The pages are left unpinned. Pages already in the
+	 * pool, pages past the end of the file, and pages for which no frame is free or evictable are skipped; a page
+	 * which cannot be read is dropped from the pool, for readPage() to report the error. The file must stay open
+	 * until its reads complete, as flushFile() waits for them.
+	 *
+	 * @param file   	File object
+	 * @param pageNos Page numbers in the file
+	 * @param ring  	Ring of a sequential scan to read the pages in, NULL for the shared pool
+	 * @return the number of pages whose reads are issued
+	 */
+  std::uint32_t prefetchPages(File* file, const std::vector<PageId> &pageNos, BufRing* ring = NULL);
+
+	/**
+	 * Reads a page of a file into the buffer pool ahead of its use, without waiting for it, as prefetchPages()
+	 * does.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number in the file
+	 * @param ring  	Ring of a sequential scan to read the page in, NULL for the shared pool
+	 * @return whether the read is issued
+	 */
+  bool prefetchPage(File* file, const PageId PageNo, BufRing* ring = NULL);
+
+	/**
+	 * Get the number of frames a ring takes in the pool once it has taken its share of each partition.
+	 *
+	 * @param ring  	Ring of a sequential scan
+	 * @return the number of frames
+	 */
+  std::uint32_t ringSize(const BufRing &ring) const;
+
+	/**
+	 * Allocates a new, empty page in the file and returns the Page object.
+	 * The newly allocated page is also assigned a frame in the buffer pool.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number. The number assigned to the page in the file is returned via this reference.
+	 * @param page  	Reference to page pointer. The newly allocated in-memory Page object is returned via this reference.
+	 */
+  void allocPage(File* file, PageId &PageNo, Page*& page); 
+
+	/**
+	 * Same as allocPage(), reporting a full buffer pool through the returned status rather than an exception.
+	 * The page is then not allocated in the file.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number. The number assigned to the page in the file is returned via this reference.
+	 * @param page  	Reference to page pointer, set if the call succeeds
+	 * @return BufStatus::OK, or BufStatus::BUFFER_EXCEEDED if every frame is pinned
+	 */
+  BufStatus tryAllocPage(File* file, PageId &PageNo, Page*& page); 
+
+	/**
+	 * Writes out all dirty pages of the file to disk.
+	 * All the frames assigned to the file need to be unpinned from buffer pool before this function can be successfully called.
+	 * Otherwise Error returned.
+	 *
+	 * @param file   	File object
+   * @throws  PagePinnedException If any page of the file is pinned in the buffer pool 
+   * @throws BadBufferException If any frame allocated to the file is found to be invalid
+	 */
+  void flushFile(const File* file);
+
+	/**
+	 * Delete page from file and also from buffer pool if present.
+	 * Since the page is entirely deleted from file, its unnecessary to see if the page is dirty.
+	 * The file reuses the page for a later allocation.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number
+	 * @throws  PagePinnedException If the page is pinned in the buffer pool
+	 */
+  void disposePage(File* file, const PageId PageNo);
+
+	/**
+	 * Start a background thread writing back dirty, unpinned pages ahead of their eviction, so that a page
+	 * evicted in the foreground is most often clean. Once more than highWater of the frames of a partition
+	 * are dirty, pages of the partition are written back until no more than lowWater are.
+	 * The thread is stopped by stopBackgroundWriter() or by the destructor.
+	 *
+	 * @param lowWater  	Fraction of dirty frames the writer goes down to
+	 * @param highWater 	Fraction of dirty frames above which the writer starts
+	 */
+  void startBackgroundWriter(double lowWater = 0.1, double highWater = 0.25);
+
+	/**
+	 * Stop the background writer thread, if started, and wait for it to finish.
+	 */
+  void stopBackgroundWriter();
+
+	/**
+	 * Write back all dirty, unpinned pages of the pool, sorted by file and page number so that they are written
+	 * in order, and leave them clean in the pool. The files written are then synced to disk. Pinned pages may be
+	 * in the middle of a change, and are left to the next checkpoint. With a log, the files attached are synced
+	 * too, and the log is then replayed from the first change of the pages still dirty, and emptied if none is.
+	 *
+	 * @return the number of pages written
+	 */
+  int checkpoint();
+
+	/**
+	 * Log the changes of the pages of the files attached to a log from now on: the bytes of a page changed since
+	 * it was last logged are logged when it is unpinned dirty, and the log is synced up to the last record of a
+	 * page before the page is written back. The files must be attached before their pages are read into the pool.
+	 * The log must outlive the buffer manager, or be unset first.
+	 *
+	 * @param newLog 	Log, NULL to stop logging
+	 */
+  void setLog(LogManager *newLog);
+
+	/**
+   * Get the log of the changes of the pages, NULL if none
+	 */
+  LogManager *getLog() const
+  {
+		return log;
+  }
+
+	/**
+	 * Make the changes of the pages unpinned so far durable by syncing the log, once those whose latch was held
+	 * by a writer at the time are logged. The log is synced once for the threads committing together.
+	 */
+  void commit();
+
+	/**
+   * Print member variable values. 
+	 */
+  void  printSelf();
+
+	/**
+	 * Boost a page pinned in the buffer pool, so that it is spared the next times the policy chooses it for
+	 * eviction, their number being set by setBoostRounds(). BTreeIndex boosts its non leaf nodes, so that they
+	 * outlive the leaves and the heap pages read by scans.
+	 *
+	 * @param page  	Pointer to the page, as returned by readPage() or allocPage()
+	 */
+  void boostPage(const Page* page);
+
+	/**
+	 * Set the number of times a boosted page is spared by eviction, 0 (the default) to disable boosting.
+	 *
+	 * @param rounds 	Number of times
+	 */
+  void setBoostRounds(std::uint8_t rounds)
+  {
+		boostRounds = rounds;
+  }
+
+	/**
+	 * Register a pin holder, which is asked to give back its pins whenever a page finds no frame, before the
+	 * buffer pool is reported full.
+	 *
+	 * @param holder 	Pin holder, registered until removePinHolder() is called for it
+	 */
+  void addPinHolder(PinHolder* holder);
+
+	/**
+	 * Unregister a pin holder, which must not hold pins from then on.
+	 *
+	 * @param holder 	Pin holder
+	 */
+  void removePinHolder(PinHolder* holder);
+
+	/**
+	 * Take a pin out of the budget of the pin holders, for a page a holder is about to keep pinned.
+	 *
+	 * @return false if the holders already hold 1 / HELD_PIN_FRACTION of the frames
+	 */
+  bool reservePin();
+
+	/**
+	 * Return pins to the budget of the pin holders, once their pages are unpinned.
+	 *
+	 * @param n 	Number of pins
+	 */
+  void returnPins(std::uint32_t n)
+  {
+		heldPins.fetch_sub(n);
+  }
+
+	/**
+   * Get the number of pins the pin holders take out of their budget
+	 */
+  std::uint32_t getNumHeldPins() const
+  {
+		return heldPins.load();
+  }
+
+	/**
+	 * Get the latch of a page pinned in the buffer pool.
+	 *
+	 * @param page  	Pointer to the page, as returned by readPage() or allocPage()
+	 * @return the latch of the frame holding the page
+	 */
+  FrameLatch & latchOf(const Page* page)
+  {
+		return bufDescTable[page - bufPool].latch;
+  }
+
+	/**
+   * Get number of frames in the buffer pool
+	 */
+  std::uint32_t getNumBufs() const
+  {
+		return numBufs;
+  }
+
+	/**
+   * Get number of partitions of the buffer pool
+	 */
+  std::uint32_t getNumPartitions() const
+  {
+		return numPartitions;
+  }
+
+	/**
+   * Get number of NUMA nodes the buffer pool is split between, 1 unless in NUMA mode
+	 */
+  std::uint32_t getNumNodes() const
+  {
+		return numNodes;
+  }
+
+	/**
+	 * Find the NUMA node sub-pool of a frame.
+	 *
+	 * @param page  	Pointer to the page held in the frame
+	 * @return the sub-pool, from 0 to getNumNodes() - 1
+	 */
+  std::uint32_t nodeOf(const Page* page)
+  {
+		return partitionOf(page - bufPool).node;
+  }
+
+	/**
+   * Get buffer pool usage statistics of the pages held in the sub-pool of a NUMA node, summed over its partitions
+	 *
+	 * @param node  	Sub-pool, from 0 to getNumNodes() - 1
+	 */
+  BufStats getNodeStats(std::uint32_t node);
+
+	/**
+   * Get buffer pool usage statistics, summed over the partitions. Each partition counts its pages under its
+   * own latch, so that the counting adds no contention, and is latched in turn while its counts are summed
+	 */
+  BufStats getBufStats();
+
+	/**
+   * Get buffer pool usage statistics of the pages of a file, summed over the partitions. A failed allocation
+   * and the sweep of an eviction are counted for the file of the page which needed the frame. The
+   * statistics of a file are kept after it is closed, until they are cleared
+	 *
+	 * @param file  	File
+	 */
+  BufStats getBufStats(const File* file);
+
+	/**
+   * Clear buffer pool usage statistics, of the pool and of every file
+	 */
+  void clearBufStats();
+
+	/**
+   * Get the number of pages the calling thread has read from disk through any buffer manager, which an
+   * operation takes the difference of to count its buffer misses
+	 */
+  static std::uint64_t threadDiskReads();
 };
 
 }
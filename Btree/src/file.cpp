@@ -7,14 +7,22 @@
 
 #include "file.h"
 
-#include <fstream>
 #include <iostream>
 #include <memory>
 #include <string>
 #include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <new>
 #include <cassert>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
 
 #include "exceptions/file_exists_exception.h"
+#include "exceptions/file_io_exception.h"
 #include "exceptions/file_not_found_exception.h"
 #include "exceptions/file_open_exception.h"
 #include "exceptions/invalid_page_exception.h"
@@ -23,8 +31,38 @@
 
 namespace badgerdb {
 
+static_assert(sizeof(Page) == Page::SIZE, "Pages are read and written as laid out in memory.");
+
 File::StreamMap File::open_streams_;
 File::CountMap File::open_counts_;
+bool File::direct_io_ = false;
+const std::size_t File::DIRECT_IO_ALIGNMENT;
+const std::size_t File::LEGACY_HEADER_SIZE;
+const std::size_t PageFile::FREE_SPACE_BUCKET_SIZE;
+const std::uint8_t PageFile::NO_FREE_SPACE_BUCKET;
+
+namespace {
+
+/**
+ * Memory aligned for direct I/O, freed when going out of scope.
+ */
+struct AlignedBuffer {
+  char* data;
+
+  explicit AlignedBuffer(std::size_t size) : data(NULL) {
+    if (::posix_memalign(reinterpret_cast<void**>(&data), File::DIRECT_IO_ALIGNMENT, size) != 0) {
+      throw std::bad_alloc();
+    }
+  }
+
+  ~AlignedBuffer() { std::free(data); }
+};
+
+}
+
+OpenFile::~OpenFile() {
+  ::close(fd);
+}
 
 void File::remove(const std::string& filename) {
   if (!exists(filename)) {
@@ -44,18 +82,17 @@ bool File::isOpen(const std::string& filename) {
 }
 
 bool File::exists(const std::string& filename) {
-	std::fstream file(filename);
-	if(file)
-	{
-		file.close();
-		return true;
-	}
-
-	return false;
+	return ::access(filename.c_str(), F_OK) == 0;
 }
 
 File::~File() {
-  close();
+  // a destructor cannot throw, so a header that fails to be written back is
+  // only reported
+  try {
+    close();
+  } catch (const FileIoException& e) {
+    std::cerr << e.message() << std::endl;
+  }
 }
 
 
@@ -70,7 +107,9 @@ File::File(const std::string& name, const bool create_new) : filename_(name) {
   if (create_new) {
     // File starts with 1 page (the header).
     FileHeader header = {1 /* num_pages */, 0 /* first_used_page */,
-                         0 /* num_free_pages */, 0 /* first_free_page */};
+                         0 /* num_free_pages */, 0 /* first_free_page */,
+                         0 /* last_used_page */, FILE_MAGIC,
+                         FILE_LAYOUT_VERSION};
     writeHeader(header);
   }
 }
@@ -78,10 +117,9 @@ File::File(const std::string& name, const bool create_new) : filename_(name) {
 void File::openIfNeeded(const bool create_new) {
   if (open_counts_.find(filename_) != open_counts_.end()) {	//exists an entry already
     ++open_counts_[filename_];
-    stream_ = open_streams_[filename_];
+    open_ = open_streams_[filename_];
   } else {
-    std::ios_base::openmode mode =
-        std::fstream::in | std::fstream::out | std::fstream::binary;
+    int flags = O_RDWR;
     const bool already_exists = exists(filename_);
     if (create_new) {
       // Error if we try to overwrite an existing file.
@@ -89,15 +127,41 @@ void File::openIfNeeded(const bool create_new) {
         throw FileExistsException(filename_);
       }
       // New files have to be truncated on open.
-      mode = mode | std::fstream::trunc;
+      flags = flags | O_CREAT | O_TRUNC;
     } else {
       // Error if we try to open a file that doesn't exist.
       if (!already_exists) {
         throw FileNotFoundException(filename_);
       }
     }
-    stream_.reset(new std::fstream(filename_, mode));
-    open_streams_[filename_] = stream_;
+    open_.reset(new OpenFile());
+    open_->direct = direct_io_;
+    open_->fd = ::open(filename_.c_str(), flags | (open_->direct ? O_DIRECT : 0), 0644);
+    if (open_->fd < 0 && open_->direct && errno == EINVAL) {
+      // the filesystem does not support direct I/O
+      open_->direct = false;
+      open_->fd = ::open(filename_.c_str(), flags, 0644);
+    }
+    if (open_->fd < 0) {
+      throw FileIoException(filename_, "open", errno);
+    }
+    open_->header_dirty = false;
+    open_->legacy_layout = false;
+    open_->used_pages_built = false;
+    open_->free_space_built = false;
+    open_->free_pages_built = false;
+    if (!create_new) {
+      readAt(&open_->header, sizeof(FileHeader), 0 /* pos */);
+      if (open_->header.magic != FILE_MAGIC) {
+        // the original layout, whose header ends where page 1 starts
+        // the tail of the used list is recomputed when first needed
+        open_->legacy_layout = true;
+        open_->header.last_used_page = Page::INVALID_NUMBER;
+        open_->header.magic = 0;
+        open_->header.layout_version = FILE_LAYOUT_V1;
+      }
+    }
+    open_streams_[filename_] = open_;
     open_counts_[filename_] = 1;
   }
 }
@@ -106,26 +170,137 @@ void File::close() {
 	if(open_counts_[filename_] > 0)
   	--open_counts_[filename_];
 
-  stream_.reset();
-	assert(open_counts_[filename_] >= 0);
+  // the file is closed even if its header fails to be written back
+  auto release = [this]() {
+    open_.reset();
+    assert(open_counts_[filename_] >= 0);
 
-  if (open_counts_[filename_] == 0) {
-    open_streams_.erase(filename_);
-    open_counts_.erase(filename_);
+    if (open_counts_[filename_] == 0) {
+      open_streams_.erase(filename_);
+      open_counts_.erase(filename_);
+    }
+  };
+  if (open_counts_[filename_] == 0 && open_) {
+    try {
+      flushHeader();
+    } catch (const FileIoException&) {
+      release();
+      throw;
+    }
   }
+  release();
 }
 
 FileHeader File::readHeader() const {
-  FileHeader header;
-  stream_->seekg(0 /* pos */, std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&header), sizeof(FileHeader));
-  return header;
+  std::lock_guard<std::recursive_mutex> guard(open_->mutex);
+  return open_->header;
 }
 
 void File::writeHeader(const FileHeader& header) {
-  stream_->seekp(0 /* pos */, std::ios::beg);
-  stream_->write(reinterpret_cast<const char*>(&header), sizeof(FileHeader));
-  stream_->flush();
+  std::lock_guard<std::recursive_mutex> guard(open_->mutex);
+  open_->header = header;
+  open_->header_dirty = true;
+}
+
+void File::flushHeader() {
+  std::lock_guard<std::recursive_mutex> guard(open_->mutex);
+  if (!open_->header_dirty) {
+    return;
+  }
+  writeAt(&open_->header, open_->legacy_layout ? LEGACY_HEADER_SIZE : sizeof(FileHeader), 0 /* pos */);
+  open_->header_dirty = false;
+}
+
+PageId File::numPages() const {
+  return readHeader().num_pages;
+}
+
+void File::sync() {
+  flushHeader();
+  if (::fdatasync(open_->fd) != 0) {
+    throw FileIoException(filename_, "fdatasync", errno);
+  }
+}
+
+std::size_t File::queueRead(IoBatch& batch, const PageId page_number,
+                            Page& dst) const {
+  try {
+    readPageInto(page_number, dst);
+  } catch (const InvalidPageException&) {
+    return batch.addDone(false);
+  }
+  return batch.addDone(true);
+}
+
+std::size_t File::queueWrite(IoBatch& batch, const PageId page_number,
+                             const Page& src) {
+  writePageFrom(page_number, src);
+  return batch.addDone(true);
+}
+
+bool File::needsBounce(const void* buffer, std::size_t size, off_t position) const {
+  const std::size_t mask = DIRECT_IO_ALIGNMENT - 1;
+  return open_->direct && ((reinterpret_cast<std::uintptr_t>(buffer) & mask) != 0 ||
+                           (size & mask) != 0 || (position & mask) != 0);
+}
+
+void File::readAt(void* buffer, std::size_t size, off_t position) const {
+  if (needsBounce(buffer, size, position)) {
+    // read the aligned blocks covering the range
+    off_t start = position & ~(off_t)(DIRECT_IO_ALIGNMENT - 1);
+    std::size_t length = (position + size - start + DIRECT_IO_ALIGNMENT - 1) & ~(DIRECT_IO_ALIGNMENT - 1);
+    AlignedBuffer blocks(length);
+    readAt(blocks.data, length, start);
+    std::memcpy(buffer, blocks.data + (position - start), size);
+    return;
+  }
+
+  char* bytes = static_cast<char*>(buffer);
+  while (size > 0) {
+    ssize_t n = ::pread(open_->fd, bytes, size, position);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0) {
+      throw FileIoException(filename_, "pread", errno);
+    }
+    if (n == 0) {
+      // past the end of the file
+      std::memset(bytes, 0, size);
+      return;
+    }
+    bytes += n;
+    size -= n;
+    position += n;
+  }
+}
+
+void File::writeAt(const void* buffer, std::size_t size, off_t position) {
+  if (needsBounce(buffer, size, position)) {
+    // update the range in the aligned blocks covering it
+    off_t start = position & ~(off_t)(DIRECT_IO_ALIGNMENT - 1);
+    std::size_t length = (position + size - start + DIRECT_IO_ALIGNMENT - 1) & ~(DIRECT_IO_ALIGNMENT - 1);
+    AlignedBuffer blocks(length);
+    readAt(blocks.data, length, start);
+    std::memcpy(blocks.data + (position - start), buffer, size);
+    writeAt(blocks.data, length, start);
+    return;
+  }
+
+  const char* bytes = static_cast<const char*>(buffer);
+  while (size > 0) {
+    ssize_t n = ::pwrite(open_->fd, bytes, size, position);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      // a write of no byte leaves the rest unwritten, as a full device would
+      throw FileIoException(filename_, "pwrite", n < 0 ? errno : ENOSPC);
+    }
+    bytes += n;
+    size -= n;
+    position += n;
+  }
 }
 
 
@@ -163,9 +338,11 @@ PageFile& PageFile::operator=(const PageFile& rhs) {
 }
 
 Page PageFile::allocatePage(PageId &new_page_number) {
+  std::lock_guard<std::recursive_mutex> guard(open_->mutex);
   FileHeader header = readHeader();
   Page new_page;
-  Page existing_page;
+  // Used page whose next page number now is the new page, if any.
+  PageId previous_page_number = Page::INVALID_NUMBER;
   if (header.num_free_pages > 0) {
     new_page = readPage(header.first_free_page, true /* allow_free */);
     new_page.set_page_number(header.first_free_page);
@@ -173,28 +350,19 @@ Page PageFile::allocatePage(PageId &new_page_number) {
     header.first_free_page = new_page.next_page_number();
     --header.num_free_pages;
 
-    if (header.first_used_page == Page::INVALID_NUMBER ||
-        header.first_used_page > new_page.page_number()) {
-      // Either have no pages used or the head of the used list is a page later
-      // than the one we just allocated, so add the new page to the head.
-      if (header.first_used_page > new_page.page_number()) {
-        new_page.set_next_page_number(header.first_used_page);
-      }
-      header.first_used_page = new_page.page_number();
+    // The used list is in page number order, so the new page goes after the
+    // last used page before it, found in the bitmap rather than by a walk.
+    loadUsedPages(header);
+    previous_page_number = previousUsedPage(new_page_number);
+    if (previous_page_number == Page::INVALID_NUMBER) {
+      new_page.set_next_page_number(header.first_used_page);
+      header.first_used_page = new_page_number;
     } else {
-      // New page is reused from somewhere after the beginning, so we need to
-      // find where in the used list to insert it.
-      PageId next_page_number = Page::INVALID_NUMBER;
-      for (FileIterator iter = begin(); iter != end(); ++iter) {
-        next_page_number = (*iter).next_page_number();
-        if (next_page_number > new_page.page_number() ||
-            next_page_number == Page::INVALID_NUMBER) {
-          existing_page = *iter;
-          break;
-        }
-      }
-      existing_page.set_next_page_number(new_page.page_number());
-      new_page.set_next_page_number(next_page_number);
+      new_page.set_next_page_number(
+          readPageHeader(previous_page_number).next_page_number);
+    }
+    if (new_page.next_page_number() == Page::INVALID_NUMBER) {
+      header.last_used_page = new_page_number;
     }
 
     assert((header.num_free_pages == 0) ==
@@ -211,53 +379,80 @@ Page PageFile::allocatePage(PageId &new_page_number) {
     }
 		else
 		{
-      // If we have pages allocated, we need to add the new page to the tail
+      // If we have pages allocated, the new page is appended after the tail
       // of the linked list.
-      for (FileIterator iter = begin(); iter != end(); ++iter) {
-        if ((*iter).next_page_number() == Page::INVALID_NUMBER) {
-          existing_page = *iter;
-          break;
-        }
+      if (header.last_used_page == Page::INVALID_NUMBER) {
+        loadUsedPages(header);
       }
-      assert(existing_page.isUsed());
-      existing_page.set_next_page_number(new_page.page_number());
+      previous_page_number = header.last_used_page;
     }
+    header.last_used_page = new_page_number;
     ++header.num_pages;
   }
   writePage(new_page_number, new_page.header_, new_page);
-  if (existing_page.page_number() != Page::INVALID_NUMBER) {
-    // If we updated an existing page by inserting the new page into the
-    // used list, we need to write it out.
-    writePage(existing_page.page_number(), existing_page.header_, existing_page);
+  if (previous_page_number != Page::INVALID_NUMBER) {
+    // The page before the new one in the used list now points to it.
+    writeNextPageNumber(previous_page_number, new_page_number);
   }
+  markUsed(new_page_number, true);
+  noteFreeSpace(new_page_number, new_page.header_);
   writeHeader(header);
 
   return new_page;
 }
 
 Page PageFile::readPage(const PageId page_number) const {
+  Page page;
+  readPageInto(page_number, page);
+  return page;
+}
+
+void PageFile::readPageInto(const PageId page_number, Page& dst) const {
   FileHeader header = readHeader();
 
 	if (page_number >= header.num_pages)
 	{
 		throw InvalidPageException(page_number, filename_);
 	}
-	return readPage(page_number, false /* allow_free */);
+	readPageInto(page_number, false /* allow_free */, dst);
+}
+
+std::size_t PageFile::queueRead(IoBatch& batch, const PageId page_number,
+                                Page& dst) const {
+  FileHeader header = readHeader();
+
+  if (page_number >= header.num_pages) {
+    return batch.addDone(false);
+  }
+  if (needsBounce(&dst, Page::SIZE, pagePosition(page_number))) {
+    return File::queueRead(batch, page_number, dst);
+  }
+  return batch.add(open_->fd, &dst, Page::SIZE, pagePosition(page_number),
+                   false /* write */, true /* usedPage */);
 }
 
 Page PageFile::readPage(const PageId page_number, const bool allow_free) const {
   Page page;
-  stream_->seekg(pagePosition(page_number), std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&page.header_), sizeof(PageHeader));
-  stream_->read(&page.data_[0], Page::DATA_SIZE);
-  if (!allow_free && !page.isUsed()) {
+  readPageInto(page_number, allow_free, page);
+  return page;
+}
+
+void PageFile::readPageInto(const PageId page_number, const bool allow_free,
+                            Page& dst) const {
+  // the header and the data are laid out in the page as on disk
+  readAt(&dst, Page::SIZE, pagePosition(page_number));
+  if (!allow_free && !dst.isUsed()) {
     throw InvalidPageException(page_number, filename_);
   }
-
-  return page;
 }
 
 void PageFile::writePage(const PageId new_page_number, const Page& new_page) {
+  writePageFrom(new_page_number, new_page);
+}
+
+void PageFile::writePageFrom(const PageId new_page_number, const Page& new_page) {
+	// the next page pointer on disk must not change between reading and writing it
+	std::lock_guard<std::recursive_mutex> guard(open_->mutex);
 	PageHeader header = readPageHeader(new_page_number);
 	if (header.current_page_number == Page::INVALID_NUMBER)
 	{
@@ -271,39 +466,98 @@ void PageFile::writePage(const PageId new_page_number, const Page& new_page) {
 	header = new_page.header_;
 	header.next_page_number = next_page_number;
 	writePage(new_page_number, header, new_page);
+	noteFreeSpace(new_page_number, header);
 }
 
 void PageFile::deletePage(const PageId page_number) {
+  std::lock_guard<std::recursive_mutex> guard(open_->mutex);
   FileHeader header = readHeader();
 
   Page existing_page = readPage(page_number);
-  Page previous_page;
+  loadUsedPages(header);
+  const PageId previous_page_number = previousUsedPage(page_number);
   // If this page is the head of the used list, update the header to point to
-  // the next page in line.
-  if (page_number == header.first_used_page) {
+  // the next page in line, otherwise the page before it in the used list.
+  if (previous_page_number == Page::INVALID_NUMBER) {
     header.first_used_page = existing_page.next_page_number();
   } else {
-    // Walk the used list so we can update the page that points to this one.
-    for (FileIterator iter = begin(); iter != end(); ++iter) {
-      previous_page = *iter;
-      if (previous_page.next_page_number() == existing_page.page_number()) {
-        previous_page.set_next_page_number(existing_page.next_page_number());
-        break;
-      }
-    }
+    writeNextPageNumber(previous_page_number, existing_page.next_page_number());
+  }
+  if (page_number == header.last_used_page) {
+    header.last_used_page = previous_page_number;
   }
   // Clear the page and add it to the head of the free list.
   existing_page.initialize();
   existing_page.set_next_page_number(header.first_free_page);
   header.first_free_page = page_number;
   ++header.num_free_pages;
-  if (previous_page.isUsed()) {
-    writePage(previous_page.page_number(), previous_page.header_, previous_page);
-  }
   writePage(page_number, existing_page.header_, existing_page);
+  markUsed(page_number, false);
+  forgetFreeSpace(page_number);
   writeHeader(header);
 }
 
+RecordId PageFile::insertRecord(std::string_view record_data) {
+  std::lock_guard<std::recursive_mutex> guard(open_->mutex);
+  loadFreeSpace();
+  PageId page_number = findPageWithRoom(record_data.length());
+  Page page;
+  if (page_number == Page::INVALID_NUMBER) {
+    page = allocatePage(page_number);
+  } else {
+    readPageInto(page_number, false /* allow_free */, page);
+  }
+  const RecordId record_id = page.insertRecord(record_data);
+  writePageFrom(page_number, page);
+  return record_id;
+}
+
+void PageFile::deleteRecord(const RecordId& record_id) {
+  std::lock_guard<std::recursive_mutex> guard(open_->mutex);
+  Page page = readPage(record_id.page_number);
+  page.deleteRecord(record_id);
+  writePageFrom(record_id.page_number, page);
+}
+
+void PageFile::readAheadPages(const PageId page_number, const std::size_t max,
+                              std::vector<PageId>& page_numbers) const {
+  std::lock_guard<std::recursive_mutex> guard(open_->mutex);
+  const FileHeader header = readHeader();
+  const std::vector<std::uint64_t>& bits = open_->used_pages;
+  std::size_t count = 0;
+  for (PageId next = page_number + 1; next < header.num_pages && count < max;
+       ++next) {
+    if (open_->used_pages_built &&
+        (next / 64 >= bits.size() || !(bits[next / 64] >> (next % 64) & 1))) {
+      continue;
+    }
+    page_numbers.push_back(next);
+    ++count;
+  }
+}
+
+FileIterator PageFile::beginAt(const PageId page_number) {
+  std::lock_guard<std::recursive_mutex> guard(open_->mutex);
+  FileHeader header = readHeader();
+  loadUsedPages(header);
+  const std::vector<std::uint64_t>& bits = open_->used_pages;
+  std::size_t word = page_number / 64;
+  if (word >= bits.size()) {
+    return end();
+  }
+  // scan the words up from the one of the page, masking the bits below it
+  // in the first one
+  for (std::uint64_t w = bits[word] & (~(std::uint64_t)0 << (page_number % 64));
+       ; w = bits[word]) {
+    if (w != 0) {
+      return FileIterator(this, word * 64 + __builtin_ctzll(w));
+    }
+    if (++word == bits.size()) {
+      return end();
+    }
+  }
+}
+
 FileIterator PageFile::begin() {
   const FileHeader& header = readHeader();
   return FileIterator(this, header.first_used_page);
@@ -315,19 +569,170 @@ FileIterator PageFile::end() {
 
 void PageFile::writePage(const PageId page_number, const PageHeader& header,
                      const Page& new_page) {
-  stream_->seekp(pagePosition(page_number), std::ios::beg);
-  stream_->write(reinterpret_cast<const char*>(&header), sizeof(PageHeader));
-  stream_->write(&new_page.data_[0], Page::DATA_SIZE);
-  stream_->flush();
+  if (open_->direct) {
+    // a direct write takes the whole page from aligned memory
+    AlignedBuffer page(Page::SIZE);
+    std::memcpy(page.data, &header, sizeof(PageHeader));
+    std::memcpy(page.data + sizeof(PageHeader), &new_page.data_[0], Page::DATA_SIZE);
+    writeAt(page.data, Page::SIZE, pagePosition(page_number));
+    return;
+  }
+
+  struct iovec parts[2];
+  parts[0].iov_base = const_cast<PageHeader*>(&header);
+  parts[0].iov_len = sizeof(PageHeader);
+  parts[1].iov_base = const_cast<char*>(&new_page.data_[0]);
+  parts[1].iov_len = Page::DATA_SIZE;
+
+  // the header is given apart from the page, so both go in a single gathered write
+  ssize_t n;
+  do {
+    n = ::pwritev(open_->fd, parts, 2, pagePosition(page_number));
+  } while (n < 0 && errno == EINTR);
+  if (n < 0) {
+    throw FileIoException(filename_, "pwritev", errno);
+  }
+  if ((std::size_t)n < sizeof(PageHeader)) {
+    writeAt(reinterpret_cast<const char*>(&header) + n, sizeof(PageHeader) - n,
+            pagePosition(page_number) + n);
+    n = sizeof(PageHeader);
+  }
+  if ((std::size_t)n < Page::SIZE) {
+    writeAt(&new_page.data_[n - sizeof(PageHeader)], Page::SIZE - n,
+            pagePosition(page_number) + n);
+  }
 }
 
 PageHeader PageFile::readPageHeader(PageId page_number) const {
   PageHeader header;
-  stream_->seekg(pagePosition(page_number), std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&header), sizeof(PageHeader));
+  readAt(&header, sizeof(PageHeader), pagePosition(page_number));
   return header;
 }
 
+void PageFile::writeNextPageNumber(const PageId page_number,
+                                   const PageId next_page_number) {
+  PageHeader header = readPageHeader(page_number);
+  header.next_page_number = next_page_number;
+  writeAt(&header, sizeof(PageHeader), pagePosition(page_number));
+}
+
+void PageFile::loadUsedPages(FileHeader& header) {
+  if (open_->used_pages_built) {
+    return;
+  }
+  open_->used_pages.assign((header.num_pages + 63) / 64, 0);
+  open_->used_pages_built = true;
+  PageId last_page_number = Page::INVALID_NUMBER;
+  for (PageId page_number = header.first_used_page;
+       page_number != Page::INVALID_NUMBER;
+       page_number = readPageHeader(page_number).next_page_number) {
+    markUsed(page_number, true);
+    last_page_number = page_number;
+  }
+  header.last_used_page = last_page_number;
+}
+
+void PageFile::markUsed(const PageId page_number, const bool used) {
+  if (!open_->used_pages_built) {
+    return;
+  }
+  std::vector<std::uint64_t>& bits = open_->used_pages;
+  if (page_number / 64 >= bits.size()) {
+    bits.resize(page_number / 64 + 1, 0);
+  }
+  const std::uint64_t mask = (std::uint64_t)1 << (page_number % 64);
+  if (used) {
+    bits[page_number / 64] |= mask;
+  } else {
+    bits[page_number / 64] &= ~mask;
+  }
+}
+
+void PageFile::loadFreeSpace() {
+  if (open_->free_space_built) {
+    return;
+  }
+  const FileHeader header = readHeader();
+  open_->free_space_bucket.assign(header.num_pages, NO_FREE_SPACE_BUCKET);
+  open_->free_space_pages.assign(Page::SIZE / FREE_SPACE_BUCKET_SIZE + 1,
+                                 std::set<PageId>());
+  open_->free_space_built = true;
+  for (PageId page_number = header.first_used_page;
+       page_number != Page::INVALID_NUMBER;) {
+    const PageHeader page_header = readPageHeader(page_number);
+    noteFreeSpace(page_number, page_header);
+    page_number = page_header.next_page_number;
+  }
+}
+
+void PageFile::noteFreeSpace(const PageId page_number,
+                             const PageHeader& header) {
+  if (!open_->free_space_built) {
+    return;
+  }
+  // the largest record fitting in the page, which needs a new slot if none
+  // is free
+  std::size_t room = header.free_space_upper_bound - header.free_space_lower_bound;
+  if (header.num_free_slots == 0) {
+    room = room > sizeof(PageSlot) ? room - sizeof(PageSlot) : 0;
+  }
+  const std::uint8_t bucket = room / FREE_SPACE_BUCKET_SIZE;
+  forgetFreeSpace(page_number);
+  open_->free_space_bucket[page_number] = bucket;
+  open_->free_space_pages[bucket].insert(page_number);
+}
+
+void PageFile::forgetFreeSpace(const PageId page_number) {
+  if (!open_->free_space_built) {
+    return;
+  }
+  std::vector<std::uint8_t>& buckets = open_->free_space_bucket;
+  if (page_number >= buckets.size()) {
+    buckets.resize(page_number + 1, NO_FREE_SPACE_BUCKET);
+  }
+  if (buckets[page_number] != NO_FREE_SPACE_BUCKET) {
+    open_->free_space_pages[buckets[page_number]].erase(page_number);
+    buckets[page_number] = NO_FREE_SPACE_BUCKET;
+  }
+}
+
+PageId PageFile::findPageWithRoom(const std::size_t record_size) const {
+  // a page has at least the lower bound of its bucket free, so the buckets
+  // from the one whose lower bound covers the record all have room
+  const std::vector<std::set<PageId> >& pages = open_->free_space_pages;
+  for (std::size_t bucket = (record_size + FREE_SPACE_BUCKET_SIZE - 1) / FREE_SPACE_BUCKET_SIZE;
+       bucket < pages.size(); ++bucket) {
+    if (!pages[bucket].empty()) {
+      return *pages[bucket].begin();
+    }
+  }
+  return Page::INVALID_NUMBER;
+}
+
+PageId PageFile::previousUsedPage(const PageId page_number) const {
+  const std::vector<std::uint64_t>& bits = open_->used_pages;
+  if (page_number <= 1 || bits.empty()) {
+    return Page::INVALID_NUMBER;
+  }
+  // scan the words down from the one of the page before, masking the bits
+  // of the page and above in the first one
+  std::size_t word = (page_number - 1) / 64;
+  std::uint64_t below = ((page_number - 1) % 64 == 63)
+      ? ~(std::uint64_t)0 : ((std::uint64_t)1 << ((page_number - 1) % 64 + 1)) - 1;
+  if (word >= bits.size()) {
+    word = bits.size() - 1;
+    below = ~(std::uint64_t)0;
+  }
+  for (std::uint64_t w = bits[word] & below; ; w = bits[--word]) {
+    if (w != 0) {
+      return word * 64 + 63 - __builtin_clzll(w);
+    }
+    if (word == 0) {
+      return Page::INVALID_NUMBER;
+    }
+  }
+}
+
 
 
 
@@ -361,16 +766,25 @@ BlobFile& BlobFile::operator=(const BlobFile& rhs) {
 }
 
 Page BlobFile::allocatePage(PageId &new_page_number) {
+  std::lock_guard<std::recursive_mutex> guard(open_->mutex);
   FileHeader header = readHeader();
 	Page new_page;
 
-	new_page_number = header.num_pages;
+	if (header.num_free_pages > 0) {
+		// take the head of the free chain, whose next page is linked from its first bytes
+		new_page_number = header.first_free_page;
+		readAt(&header.first_free_page, sizeof(PageId), pagePosition(new_page_number));
+		--header.num_free_pages;
+		open_->free_pages.erase(new_page_number);
+	} else {
+		new_page_number = header.num_pages;
 
-	if (header.first_used_page == Page::INVALID_NUMBER) {
-		header.first_used_page = header.num_pages;
-	}
+		if (header.first_used_page == Page::INVALID_NUMBER) {
+			header.first_used_page = header.num_pages;
+		}
 
-	++header.num_pages;
+		++header.num_pages;
+	}
 
 	writePage(new_page_number, new_page);
 	writeHeader(header);
@@ -380,20 +794,113 @@ Page BlobFile::allocatePage(PageId &new_page_number) {
 
 Page BlobFile::readPage(const PageId page_number) const {
 	Page page;
-	stream_->seekg(pagePosition(page_number), std::ios::beg);
-	stream_->read(reinterpret_cast<char*>(&page), Page::SIZE);
+	readPageInto(page_number, page);
 	return page;
 }
 
+void BlobFile::readPageInto(const PageId page_number, Page& dst) const {
+	readAt(&dst, Page::SIZE, pagePosition(page_number));
+}
+
 void BlobFile::writePage(const PageId new_page_number, const Page& new_page) {
-	stream_->seekp(pagePosition(new_page_number), std::ios::beg);
-	stream_->write(reinterpret_cast<const char*>(&new_page), Page::SIZE);
-	stream_->flush();
+	writePageFrom(new_page_number, new_page);
+}
+
+void BlobFile::writePageFrom(const PageId new_page_number, const Page& new_page) {
+	writeAt(&new_page, Page::SIZE, pagePosition(new_page_number));
+}
+
+std::size_t BlobFile::queueRead(IoBatch& batch, const PageId page_number,
+                                Page& dst) const {
+	if (needsBounce(&dst, Page::SIZE, pagePosition(page_number))) {
+		return File::queueRead(batch, page_number, dst);
+	}
+	return batch.add(open_->fd, &dst, Page::SIZE, pagePosition(page_number), false /* write */);
+}
+
+std::size_t BlobFile::queueWrite(IoBatch& batch, const PageId page_number,
+                                 const Page& src) {
+	if (needsBounce(&src, Page::SIZE, pagePosition(page_number))) {
+		return File::queueWrite(batch, page_number, src);
+	}
+	return batch.add(open_->fd, const_cast<Page*>(&src), Page::SIZE, pagePosition(page_number), true /* write */);
 }
 
-//delePage should not be called for a blob_file, not supported
 void BlobFile::deletePage(const PageId page_number) {
-	throw InvalidPageException(page_number, filename_);
+	std::lock_guard<std::recursive_mutex> guard(open_->mutex);
+	FileHeader header = readHeader();
+	if (page_number == Page::INVALID_NUMBER || page_number >= header.num_pages) {
+		throw InvalidPageException(page_number, filename_);
+	}
+	// a page deleted twice would be linked into the chain twice, and allocated twice
+	loadFreePages(header);
+	if (open_->free_pages.count(page_number) != 0) {
+		throw InvalidPageException(page_number, filename_);
+	}
+
+	// the page becomes the head of the free chain
+	writeAt(&header.first_free_page, sizeof(PageId), pagePosition(page_number));
+	header.first_free_page = page_number;
+	++header.num_free_pages;
+	writeHeader(header);
+	open_->free_pages.insert(page_number);
+}
+
+void BlobFile::loadFreePages(const FileHeader& header) {
+	if (open_->free_pages_built) {
+		return;
+	}
+	open_->free_pages.clear();
+	PageId next = header.first_free_page;
+	for (PageId i = 0; i < header.num_free_pages; i++) {
+		open_->free_pages.insert(next);
+		readAt(&next, sizeof(PageId), pagePosition(next));
+	}
+	open_->free_pages_built = true;
+}
+
+void BlobFile::recoverHeader(const std::set<PageId>& written_pages) {
+	std::lock_guard<std::recursive_mutex> guard(open_->mutex);
+	FileHeader header = readHeader();
+
+	// the pages of the chain on disk, which ends early at a link out of the file or back into the chain
+	std::vector<PageId> free_pages;
+	std::set<PageId> chained;
+	PageId next = header.first_free_page;
+	for (PageId i = 0; i < header.num_free_pages; i++) {
+		if (next == Page::INVALID_NUMBER || next >= header.num_pages || !chained.insert(next).second) {
+			break;
+		}
+		if (written_pages.count(next) == 0) {
+			free_pages.push_back(next);
+		}
+		readAt(&next, sizeof(PageId), pagePosition(next));
+	}
+
+	// and the pages the file is extended by
+	PageId num_pages = written_pages.empty() ? 0 : *written_pages.rbegin() + 1;
+	if (num_pages > header.num_pages) {
+		if (header.first_used_page == Page::INVALID_NUMBER) {
+			header.first_used_page = header.num_pages;
+		}
+		for (PageId page_number = header.num_pages; page_number < num_pages; page_number++) {
+			if (written_pages.count(page_number) == 0) {
+				free_pages.push_back(page_number);
+			}
+		}
+		header.num_pages = num_pages;
+	}
+
+	// the chain is linked again through the pages kept
+	header.first_free_page = Page::INVALID_NUMBER;
+	header.num_free_pages = free_pages.size();
+	for (auto page = free_pages.rbegin(); page != free_pages.rend(); ++page) {
+		writeAt(&header.first_free_page, sizeof(PageId), pagePosition(*page));
+		header.first_free_page = *page;
+	}
+	writeHeader(header);
+	open_->free_pages = std::set<PageId>(free_pages.begin(), free_pages.end());
+	open_->free_pages_built = true;
 }
 
 }
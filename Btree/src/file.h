@@ -7,17 +7,47 @@
 
 #pragma once
 
-#include <fstream>
+#include <cstdint>
 #include <string>
 #include <map>
+#include <vector>
 #include <memory>
+#include <mutex>
+#include <set>
+#include <sys/types.h>
 
+#include "io_engine.h"
 #include "page.h"
 
 namespace badgerdb {
 
 class FileIterator;
 
+/**
+ * @brief Value of FileHeader::magic in the files laid out with their header in
+ * the slot of page 0.  Its two 16-bit halves are above any slot count of a page,
+ * so that the bytes of page 1 a file of the original layout has there never
+ * match it.
+ */
+const std::uint32_t FILE_MAGIC = 0xBADB8E5D;
+
+/**
+ * @brief Original layout of the files, whose 16-byte header is followed right
+ * by page 1.  Such files keep their layout, their pages being unaligned.
+ */
+const std::uint32_t FILE_LAYOUT_V1 = 1;
+
+/**
+ * @brief Layout in which the header takes the slot of page 0, so that page n
+ * is at n * Page::SIZE and every page is aligned for direct I/O.
+ */
+const std::uint32_t FILE_LAYOUT_V2 = 2;
+
+/**
+ * @brief Layout of the files created by this version.
+ */
+const std::uint32_t FILE_LAYOUT_VERSION = FILE_LAYOUT_V2;
+
 /**
  * @brief Header metadata for files on disk which contain pages.
  */
@@ -42,6 +72,25 @@ struct FileHeader {
    */
   PageId first_free_page;
 
+  /**
+   * Page number of the last used page in the file, to append to the used list
+   * without walking it.  Files written before it was kept read it as 0, and
+   * have it recomputed when first needed.
+   */
+  PageId last_used_page;
+
+  /**
+   * FILE_MAGIC in files of FILE_LAYOUT_V2 on.  Files of FILE_LAYOUT_V1 have
+   * the first bytes of page 1 from last_used_page on, which are not read as
+   * header fields.
+   */
+  std::uint32_t magic;
+
+  /**
+   * Layout of the file.
+   */
+  std::uint32_t layout_version;
+
   /**
    * Returns true if this file header is equal to the other.
    *
@@ -52,23 +101,108 @@ struct FileHeader {
     return num_pages == rhs.num_pages &&
         num_free_pages == rhs.num_free_pages &&
         first_used_page == rhs.first_used_page &&
-        first_free_page == rhs.first_free_page;
+        first_free_page == rhs.first_free_page &&
+        last_used_page == rhs.last_used_page &&
+        magic == rhs.magic &&
+        layout_version == rhs.layout_version;
   }
 };
 
+/**
+ * @brief State shared by the File objects opened on the same file.
+ */
+struct OpenFile {
+  /**
+   * Descriptor of the underlying filesystem object, read and written at
+   * explicit positions so that it can be used from several threads at once.
+   */
+  int fd;
+
+  /**
+   * Latches the header, serializing the page allocations and deletions.
+   * Recursive since they read pages through the file's own iterator.
+   */
+  std::recursive_mutex mutex;
+
+  /**
+   * Header of the file, kept in memory and written back on sync or close.
+   */
+  FileHeader header;
+
+  /**
+   * Whether the header has changed since it was last written.
+   */
+  bool header_dirty;
+
+  /**
+   * Whether the file is opened with O_DIRECT, bypassing the kernel page cache.
+   */
+  bool direct;
+
+  /**
+   * Whether the file has FILE_LAYOUT_V1, whose pages follow the 16 bytes of
+   * the header and whose header is written back in those 16 bytes.
+   */
+  bool legacy_layout;
+
+  /**
+   * Bitmap of the used pages of a PageFile, one bit per page number, giving
+   * the neighbours of a page in the used list without reading it.  Built on
+   * the first allocation or deletion needing it.
+   */
+  std::vector<std::uint64_t> used_pages;
+
+  /**
+   * Whether used_pages is built.
+   */
+  bool used_pages_built;
+
+  /**
+   * Free space map of a PageFile: the free space bucket of each used page,
+   * PageFile::NO_FREE_SPACE_BUCKET for a page not in the map, and the pages
+   * of each bucket.  Built on the first record insertion.
+   */
+  std::vector<std::uint8_t> free_space_bucket;
+  std::vector<std::set<PageId> > free_space_pages;
+
+  /**
+   * Whether the free space map is built.
+   */
+  bool free_space_built;
+
+  /**
+   * Pages of the chain of free pages of a BlobFile, telling a page deleted
+   * twice without walking the chain.  Built on the first deletion.
+   */
+  std::set<PageId> free_pages;
+
+  /**
+   * Whether free_pages is built.
+   */
+  bool free_pages_built;
+
+  /**
+   * Closes the descriptor.
+   */
+  ~OpenFile();
+};
+
 /**
  * @brief Class which represents a file in the filesystem containing database
  *        pages.
  *
- * The File class wraps a stream to an underlying file on disk.  Files contain
+ * The File class wraps a descriptor of an underlying file on disk.  Files contain
  * fixed-sized pages, and they never deallocate space (though they do reuse
  * deleted pages if possible).  If multiple File objects refer to the same
- * underlying file, they will share the stream in memory.
+ * underlying file, they will share the descriptor and the file header in memory.
+ * Writes are not made durable until sync() is called or the file is closed.
  * If a file that has already been opened (possibly by another query), then the File class
  * detects this (by looking in the open_streams_ map) and just returns a file object with
- * the already created stream for the file without actually opening the UNIX file again. 
+ * the already created descriptor for the file without actually opening the UNIX file again. 
  *
- * @warning This class is not threadsafe.
+ * Pages are read and written with pread and pwrite, so that page I/O from
+ * several threads needs no latch. Allocating and deleting pages latch the
+ * file header. Opening and closing files are not threadsafe.
  */
 
 
@@ -111,6 +245,22 @@ class File {
    */
   static bool exists(const std::string& filename);
 
+  /**
+   * Sets whether the files opened from now on bypass the kernel page cache
+   * with O_DIRECT, where the filesystem supports it.  Off by default.  Pages
+   * are then best read into and written from memory aligned on
+   * DIRECT_IO_ALIGNMENT, as the buffer pool is; other transfers go through an
+   * aligned copy.
+   *
+   * @param enabled  Whether to open files with O_DIRECT.
+   */
+  static void setDirectIo(const bool enabled) { direct_io_ = enabled; }
+
+  /**
+   * Alignment of the memory, positions and sizes of direct transfers.
+   */
+  static const std::size_t DIRECT_IO_ALIGNMENT = 4096;
+
   /**
    * Destructor that automatically closes the underlying file if no other
    * File objects are using it.
@@ -134,6 +284,17 @@ class File {
    */
   virtual Page readPage(const PageId page_number) const = 0;
 
+  /**
+   * Reads an existing page from the file straight into the given page, e.g.
+   * a buffer frame, without a temporary copy.
+   *
+   * @param page_number   Number of page to read.
+   * @param dst           Page to read into.
+   * @throws  InvalidPageException  If the page doesn't exist in the file or is
+   *                                not currently used.
+   */
+  virtual void readPageInto(const PageId page_number, Page& dst) const = 0;
+
   /**
    * Writes a page into the file at the given page number.
    * No bounds checking is performed.
@@ -143,6 +304,41 @@ class File {
    */
   virtual void writePage(const PageId page_number, const Page& new_page) = 0;
 
+  /**
+   * Writes a page into the file at the given page number straight from the
+   * given page, e.g. a buffer frame, in a single system call.
+   * No bounds checking is performed.
+   *
+   * @param page_number Number of page whose contents to replace.
+   * @param src         Page to write.
+   */
+  virtual void writePageFrom(const PageId page_number, const Page& src) = 0;
+
+  /**
+   * Queues a read of an existing page into the given page to a batch, to be
+   * run when the batch is submitted.  By default the page is read at once.
+   *
+   * @param batch         Batch of requests.
+   * @param page_number   Number of page to read.
+   * @param dst           Page to read into, left untouched until submission.
+   * @return  Index of the request in the batch, which fails if the page
+   *          doesn't exist in the file or is not currently used.
+   */
+  virtual std::size_t queueRead(IoBatch& batch, const PageId page_number,
+                                Page& dst) const;
+
+  /**
+   * Queues a write of a page to a batch, to be run when the batch is
+   * submitted.  By default the page is written at once.
+   *
+   * @param batch         Batch of requests.
+   * @param page_number   Number of page whose contents to replace.
+   * @param src           Page to write, left unchanged until submission.
+   * @return  Index of the request in the batch.
+   */
+  virtual std::size_t queueWrite(IoBatch& batch, const PageId page_number,
+                                 const Page& src);
+
   /**
    * Deletes a page from the file.
    *
@@ -150,6 +346,16 @@ class File {
    */
   virtual void deletePage(const PageId page_number) = 0;
 
+  /**
+   * Makes the pages written so far and the file header durable: the header is
+   * written back if it changed, and the file data is synced to disk with
+   * fdatasync.
+   *
+   * @throws  FileIoException   If the header fails to be written or the sync
+   *                            fails.
+   */
+  void sync();
+
   /**
    * Returns the name of the file this object represents.
    *
@@ -157,6 +363,20 @@ class File {
    */
   const std::string& filename() const { return filename_; }
 
+  /**
+   * Returns the layout of the file, FILE_LAYOUT_V1 for a file created before
+   * the header took the slot of page 0.
+   */
+  std::uint32_t layoutVersion() const { return readHeader().layout_version; }
+
+  /**
+   * Returns the number of pages of the file, including the header page and
+   * the free pages, i.e. one past the highest page number.
+   *
+   * @return  Number of pages.
+   */
+  PageId numPages() const;
+
  	/**
    * Returns pageid of first page in the file.
    *
@@ -165,21 +385,61 @@ class File {
 	PageId getFirstPageNo();
 
  protected:
+  /**
+   * Number of bytes of the header of a file of FILE_LAYOUT_V1, before page 1.
+   */
+  static const std::size_t LEGACY_HEADER_SIZE = 4 * sizeof(PageId);
+
   /**
    * Returns the position of the page with the given number in the file (as an
-   * offset from the beginning of the file).
+   * offset from the beginning of the file).  The header takes the place of
+   * page 0, so that the pages are aligned for direct I/O, unless the file has
+   * FILE_LAYOUT_V1.
    *
    * @param page_number   Number of page.
    * @return  Position of page in file.
    */
-  static std::streampos pagePosition(const PageId page_number) {
-    return sizeof(FileHeader) + ((page_number - 1) * Page::SIZE);
+  off_t pagePosition(const PageId page_number) const {
+    return open_->legacy_layout
+        ? (off_t)LEGACY_HEADER_SIZE + (off_t)(page_number - 1) * Page::SIZE
+        : (off_t)page_number * Page::SIZE;
   }
 
+  /**
+   * Returns whether a transfer must go through an aligned copy, because the
+   * file is opened with O_DIRECT and the transfer is not aligned.
+   *
+   * @param buffer    Memory to read into or write from.
+   * @param size      Number of bytes.
+   * @param position  Position in the file.
+   */
+  bool needsBounce(const void* buffer, std::size_t size, off_t position) const;
+
+  /**
+   * Reads bytes of the file at the given position. Bytes past the end of the
+   * file read as zeros.
+   *
+   * @param buffer    Buffer to read into.
+   * @param size      Number of bytes.
+   * @param position  Position in the file.
+   * @throws  FileIoException   If the read fails.
+   */
+  void readAt(void* buffer, std::size_t size, off_t position) const;
+
+  /**
+   * Writes bytes to the file at the given position.
+   *
+   * @param buffer    Bytes to write.
+   * @param size      Number of bytes.
+   * @param position  Position in the file.
+   * @throws  FileIoException   If the write fails, e.g. on a full device.
+   */
+  void writeAt(const void* buffer, std::size_t size, off_t position);
+
   /**
    * Opens the underlying file named in filename_.
    * This method only opens the file if no other File objects exist that access
-   * the same filesystem file; otherwise, it reuses the existing stream.
+   * the same filesystem file; otherwise, it reuses the existing descriptor.
    *
    * @param create_new  Whether to create a new file.
    * @throws  FileExistsException     If the underlying file exists and
@@ -190,31 +450,42 @@ class File {
   void openIfNeeded(const bool create_new);
 
   /**
-   * Closes the underlying file stream in <stream_>.
+   * Closes the underlying file descriptor in <open_>.
    * This method only closes the file if no other File objects exist that access
-   * the same file.
+   * the same file, writing back its header first.
    */
   void close();
 
   /**
-   * Reads the header for this file from disk.
+   * Returns a copy of the header for this file, as cached in memory.
    *
    * @return  The file header.
    */
   FileHeader readHeader() const;
 
   /**
-   * Writes the given header to the disk as the header for this file.
+   * Sets the given header as the header for this file. It is written to the
+   * disk on sync or close.
    *
    * @param header  File header to write.
    */
   void writeHeader(const FileHeader& header);
 
-  typedef std::map<std::string, std::shared_ptr<std::fstream> > StreamMap;
+  /**
+   * Writes the cached header to the disk if it changed.
+   */
+  void flushHeader();
+
+  typedef std::map<std::string, std::shared_ptr<OpenFile> > StreamMap;
   typedef std::map<std::string, int> CountMap;
 
   /**
-   * Streams for opened files.
+   * Whether the files opened from now on use O_DIRECT.
+   */
+  static bool direct_io_;
+
+  /**
+   * Descriptors and headers of opened files.
    */
   static StreamMap open_streams_;
 
@@ -229,15 +500,25 @@ class File {
   std::string filename_;
 
   /**
-   * Stream for underlying filesystem object.
+   * Descriptor and header of the underlying filesystem object.
    */
-  std::shared_ptr<std::fstream> stream_;
+  std::shared_ptr<OpenFile> open_;
 
   friend class FileIterator;
 };
 
 class PageFile : public File {
  public:
+  /**
+   * Number of bytes of free space per bucket of the free space map, 64 for
+   * pages of 8 KB, so that the buckets of a page always fit in a byte.
+   */
+  static const std::size_t FREE_SPACE_BUCKET_SIZE = Page::SIZE / 128;
+
+  /**
+   * Bucket of the pages which are not in the free space map.
+   */
+  static const std::uint8_t NO_FREE_SPACE_BUCKET = 0xFF;
 
   /**
    * Creates a new file.
@@ -249,9 +530,9 @@ class PageFile : public File {
 
   /**
    * Opens the file named fileName and returns the corresponding File object.
-	 * It first checks if the file is already open. If so, then the new File object created uses the same input-output stream to read to or write fom
+	 * It first checks if the file is already open. If so, then the new File object created uses the same descriptor to read to or write fom
 	 * that already open file. Reference count (open_counts_ static variable inside the File object) is incremented whenever an already open file is
-	 * opened again. Otherwise the UNIX file is actually opened. The fileName and the stream associated with this File object are inserted into the
+	 * opened again. Otherwise the UNIX file is actually opened. The fileName and the descriptor associated with this File object are inserted into the
 	 * open_streams_ map.
    *
    * @param filename  Name of the file.
@@ -310,6 +591,16 @@ class PageFile : public File {
    */
   Page readPage(const PageId page_number) const override;
 
+  /**
+   * Reads an existing page from the file straight into the given page.
+   *
+   * @param page_number   Number of page to read.
+   * @param dst           Page to read into.
+   * @throws  InvalidPageException  If the page doesn't exist in the file or is
+   *                                not currently used.
+   */
+  void readPageInto(const PageId page_number, Page& dst) const override;
+
   /**
    * Writes a page into the file at the given page number.
    * No bounds checking is performed.
@@ -319,6 +610,27 @@ class PageFile : public File {
    */
   void writePage(const PageId page_number, const Page& new_page) override;
 
+  /**
+   * Writes a page into the file at the given page number straight from the
+   * given page.  No bounds checking is performed.
+   *
+   * @param page_number Number of page whose contents to replace.
+   * @param src         Page to write.
+   */
+  void writePageFrom(const PageId page_number, const Page& src) override;
+
+  /**
+   * Queues a read of an existing page to a batch.  The page is written
+   * without a batch, since its next page pointer on disk must be kept.
+   *
+   * @param batch         Batch of requests.
+   * @param page_number   Number of page to read.
+   * @param dst           Page to read into.
+   * @return  Index of the request in the batch.
+   */
+  std::size_t queueRead(IoBatch& batch, const PageId page_number,
+                        Page& dst) const override;
+
   /**
    * Deletes a page from the file.
    *
@@ -326,6 +638,42 @@ class PageFile : public File {
    */
   void deletePage(const PageId page_number) override;
 
+  /**
+   * Inserts a record into a used page with enough free space, allocating a
+   * new page only if none has room.  The page is found in the free space map,
+   * which buckets the free space of each page as last written, so that the
+   * space freed by deleted records is reused.  Like writePage, this bypasses
+   * the buffer manager.
+   *
+   * @param record_data   Bytes of the record.
+   * @return  ID of the record inserted.
+   * @throws  InsufficientSpaceException  If the record does not fit in an
+   *                                      empty page.
+   */
+  RecordId insertRecord(std::string_view record_data);
+
+  /**
+   * Deletes a record from its page, making its space available to the next
+   * insertions.  Like writePage, this bypasses the buffer manager.
+   *
+   * @param record_id   ID of the record to delete.
+   * @throws  InvalidPageException  If the page of the record is not in use.
+   */
+  void deleteRecord(const RecordId& record_id);
+
+  /**
+   * Returns the page numbers likely to follow a page in the used list, to
+   * read them ahead of a sequential scan.  They are exact if the bitmap of the
+   * used pages is built, and otherwise the next page numbers of the file, the
+   * used list being in page number order.  No page is read.
+   *
+   * @param page_number   Number of page.
+   * @param max           Maximum number of page numbers.
+   * @param page_numbers  Vector the page numbers are appended to.
+   */
+  void readAheadPages(const PageId page_number, const std::size_t max,
+                      std::vector<PageId>& page_numbers) const;
+
   /**
    * Returns an iterator at the first page in the file.
    *
@@ -333,6 +681,16 @@ class PageFile : public File {
    */
   FileIterator begin();
 
+  /**
+   * Returns an iterator at the first used page whose number is at least the
+   * given one, to scan a range of the file.  The bitmap of the used pages is
+   * built on the first call.
+   *
+   * @param page_number   Number of page.
+   * @return  Iterator at the page, end() if there is none.
+   */
+  FileIterator beginAt(const PageId page_number);
+
   /**
    * Returns an iterator representing the page after the last page in the file.
    * This iterator should not be dereferenced.
@@ -344,18 +702,29 @@ class PageFile : public File {
  private:
 
   /**
-   * Reads a page from the file.  If <allow_free> is not set, an exception
-   * will be thrown if the page read from disk is not currently in use.
+   * Reads a page from the file into the given page.  If <allow_free> is not
+   * set, an exception will be thrown if the page read from disk is not
+   * currently in use.
    *
-   * No bounds checking is performed; the underlying file stream will throw
-   * an exception if the page is past the end of the file.
+   * No bounds checking is performed; a page past the end of the file reads
+   * as zeros.
    *
    * @param page_number   Number of page to read.
    * @param allow_free    Whether to allow reading a free (unused) page.
-   * @return  The page.
+   * @param dst           Page to read into.
    * @throws  InvalidPageException  If the page is free (unused) and
    *                                allow_free is false.
    */
+  void readPageInto(const PageId page_number, const bool allow_free,
+                    Page& dst) const;
+
+  /**
+   * Reads a page from the file, as readPageInto.
+   *
+   * @param page_number   Number of page to read.
+   * @param allow_free    Whether to allow reading a free (unused) page.
+   * @return  The page.
+   */
   Page readPage(const PageId page_number, const bool allow_free) const;
 
   /**
@@ -379,6 +748,74 @@ class PageFile : public File {
    */
   PageHeader readPageHeader(const PageId page_number) const;
 
+  /**
+   * Sets the next page number of the given page on disk, writing only its
+   * header.
+   *
+   * @param page_number       Number of page to update.
+   * @param next_page_number  Page number of the next used page.
+   */
+  void writeNextPageNumber(const PageId page_number,
+                           const PageId next_page_number);
+
+  /**
+   * Builds the bitmap of the used pages with one walk of the used list,
+   * reading only the page headers, and sets the last used page in the header
+   * if the file predates it.  Does nothing if the bitmap is already built.
+   *
+   * @param header  Header of the file, updated in place.
+   */
+  void loadUsedPages(FileHeader& header);
+
+  /**
+   * Marks a page used or free in the bitmap of the used pages, if it is built.
+   *
+   * @param page_number   Number of page.
+   * @param used          Whether the page is used.
+   */
+  void markUsed(const PageId page_number, const bool used);
+
+  /**
+   * Finds the used page preceding the given page number in the used list,
+   * from the bitmap of the used pages, which must be built.
+   *
+   * @param page_number   Number of page.
+   * @return  The last used page below page_number, Page::INVALID_NUMBER if
+   *          none.
+   */
+  PageId previousUsedPage(const PageId page_number) const;
+
+  /**
+   * Builds the free space map with one walk of the used list, reading only
+   * the page headers.  Does nothing if the map is already built.
+   */
+  void loadFreeSpace();
+
+  /**
+   * Files a page in the bucket of the free space map matching its header, if
+   * the map is built.
+   *
+   * @param page_number   Number of page.
+   * @param header        Header of the page as written.
+   */
+  void noteFreeSpace(const PageId page_number, const PageHeader& header);
+
+  /**
+   * Removes a page from the free space map, if the map is built.
+   *
+   * @param page_number   Number of page.
+   */
+  void forgetFreeSpace(const PageId page_number);
+
+  /**
+   * Finds a page of the free space map with room for a record.
+   *
+   * @param record_size   Number of bytes of the record.
+   * @return  The lowest numbered page of the least bucket holding such pages,
+   *          Page::INVALID_NUMBER if none.
+   */
+  PageId findPageWithRoom(const std::size_t record_size) const;
+
   friend class FileIterator;
 };
 
@@ -395,9 +832,9 @@ class BlobFile : public File {
 
   /**
    * Opens the file named fileName and returns the corresponding File object.
-	 * It first checks if the file is already open. If so, then the new File object created uses the same input-output stream to read to or write fom
+	 * It first checks if the file is already open. If so, then the new File object created uses the same descriptor to read to or write fom
 	 * that already open file. Reference count (open_counts_ static variable inside the File object) is incremented whenever an already open file is
-	 * opened again. Otherwise the UNIX file is actually opened. The fileName and the stream associated with this File object are inserted into the
+	 * opened again. Otherwise the UNIX file is actually opened. The fileName and the descriptor associated with this File object are inserted into the
 	 * open_streams_ map.
    *
    * @param filename  Name of the file.
@@ -442,8 +879,11 @@ class BlobFile : public File {
   ~BlobFile();
 
   /**
-   * Allocates a new page in the file.
+   * Allocates a page in the file, reusing the last deleted one if any, and
+   * extending the file otherwise.  The page is zeroed.
    *
+   * @param new_page_number   Number of the page allocated, returned via this
+   *                          variable.
    * @return The new page.
    */
   Page allocatePage(PageId &new_page_number) override;
@@ -458,6 +898,16 @@ class BlobFile : public File {
    */
   Page readPage(const PageId page_number) const override;
 
+  /**
+   * Reads an existing page from the file straight into the given page.
+   *
+   * @param page_number   Number of page to read.
+   * @param dst           Page to read into.
+   * @throws  InvalidPageException  If the page doesn't exist in the file or is
+   *                                not currently used.
+   */
+  void readPageInto(const PageId page_number, Page& dst) const override;
+
   /**
    * Writes a page into the file at the given page number.
    * No bounds checking is performed.
@@ -468,11 +918,68 @@ class BlobFile : public File {
   void writePage(const PageId page_number, const Page& new_page) override;
 
   /**
-   * Deletes a page from the file.
+   * Writes a page into the file at the given page number straight from the
+   * given page.  No bounds checking is performed.
+   *
+   * @param page_number Number of page whose contents to replace.
+   * @param src         Page to write.
+   */
+  void writePageFrom(const PageId page_number, const Page& src) override;
+
+  /**
+   * Queues a read of a page to a batch.
+   *
+   * @param batch         Batch of requests.
+   * @param page_number   Number of page to read.
+   * @param dst           Page to read into.
+   * @return  Index of the request in the batch.
+   */
+  std::size_t queueRead(IoBatch& batch, const PageId page_number,
+                        Page& dst) const override;
+
+  /**
+   * Queues a write of a page to a batch.
+   *
+   * @param batch         Batch of requests.
+   * @param page_number   Number of page whose contents to replace.
+   * @param src           Page to write.
+   * @return  Index of the request in the batch.
+   */
+  std::size_t queueWrite(IoBatch& batch, const PageId page_number,
+                         const Page& src) override;
+
+  /**
+   * Deletes a page from the file, adding it to the head of the chain of free
+   * pages linked from the file header.  The first bytes of a free page hold
+   * the number of the next one.
    *
    * @param page_number   Number of page to delete.
+   * @throws  InvalidPageException  If the page is the header, past the end
+   *                                of the file, or already free.
    */
   void deletePage(const PageId page_number) override;
+
+  /**
+   * Makes the header consistent with pages about to be written back by log
+   * recovery, whose allocations and deletions may postdate the header on
+   * disk: the file is extended to hold the pages, and the chain of free
+   * pages is rebuilt from the pages of the chain on disk and the pages the
+   * file is extended by, leaving out the pages written back, so that none
+   * of them is allocated again.  It is called before the pages are written,
+   * the links of the chain being in the first bytes of its pages.
+   *
+   * @param written_pages   Numbers of the pages written back.
+   */
+  void recoverHeader(const std::set<PageId>& written_pages);
+
+ private:
+  /**
+   * Builds the set of the free pages from the chain of free pages, if it is
+   * not built yet.
+   *
+   * @param header  Header of the file.
+   */
+  void loadFreePages(const FileHeader& header);
 };
 
 }
@@ -5,18 +5,45 @@
  * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
  */
 
+#include <algorithm>
+#include <limits>
+#include <thread>
 #include "filescan.h"
 #include "exceptions/end_of_file_exception.h"
+#include "exceptions/bad_opcodes_exception.h"
+#include "exceptions/bad_scanrange_exception.h"
 
 namespace badgerdb { 
 
+const std::uint32_t FileScan::RING_SIZE;
+
+const std::uint32_t ParallelFileScan::MORSEL_PAGES;
+
 FileScan::FileScan(const std::string &name, BufMgr *bufferMgr)
+  : ring(RING_SIZE)
 {
   file = new PageFile(name, false);	//dont create new file
 	bufMgr = bufferMgr;
 	curDirtyFlag = false;
   curPage = NULL;
 	filePageIter = file->begin();
+  ownsFile = true;
+  rangeFirst = Page::INVALID_NUMBER;
+  rangeEnd = std::numeric_limits<PageId>::max();
+  readAheadEnd = readAheadMark = Page::INVALID_NUMBER;
+  filtered = pageFiltered = false;
+}
+
+FileScan::FileScan(PageFile *pageFile, BufMgr *bufferMgr, PageId first, PageId end)
+  : ring(RING_SIZE)
+{
+  file = pageFile;
+	bufMgr = bufferMgr;
+	curDirtyFlag = false;
+  curPage = NULL;
+  ownsFile = false;
+  filtered = pageFiltered = false;
+  setRange(first, end);
 }
 
 FileScan::~FileScan()
@@ -24,84 +51,223 @@ FileScan::~FileScan()
   // generally must unpin last page of the scan
   if (curPage != NULL)
   {
-    bufMgr->unPinPage(file, (*filePageIter).page_number(), curDirtyFlag);
+    bufMgr->unPinPage(file, filePageIter.pageNumber(), curDirtyFlag);
     curPage = NULL;
 		curDirtyFlag = false;
-    filePageIter = file->begin();
   }
-  bufMgr->flushFile(file);
-  delete file;
+  if (ownsFile)
+  {
+    bufMgr->flushFile(file);
+    delete file;
+  }
 }
 
-void FileScan::scanNext(RecordId& outRid)
+void FileScan::setRange(PageId first, PageId end)
 {
-  std::string rec;
+  if (curPage != NULL)
+  {
+    bufMgr->unPinPage(file, filePageIter.pageNumber(), curDirtyFlag);
+    curPage = NULL;
+		curDirtyFlag = false;
+  }
+  rangeFirst = std::max(first, (PageId)1);
+  rangeEnd = end;
+  filePageIter = file->beginAt(rangeFirst);
+  readAheadEnd = readAheadMark = Page::INVALID_NUMBER;
+}
 
-  if (filePageIter == file->end())
+void FileScan::scanNext(RecordId& outRid)
+{
+  if (pastEnd())
 	{
+    filePageIter = file->end();
 		throw EndOfFileException();
 	}
 
   // special case of the first record of the first page of the file
   if (curPage == NULL)
   {
-    // need to get the first page of the file
-		filePageIter = file->begin();
-    if(filePageIter == file->end())
+    // need to get the first page of the file, or of the range
+		filePageIter = rangeFirst == Page::INVALID_NUMBER ? file->begin() : file->beginAt(rangeFirst);
+    if(pastEnd())
 		{
+      filePageIter = file->end();
 			throw EndOfFileException();
 		}
-	 
-		// read the first page of the file
-    bufMgr->readPage(file, (*filePageIter).page_number(), curPage); 
-		curDirtyFlag = false;
-
-		// get the first record off the page
-    pageRecordIter = curPage->begin(); 
-
-		if(pageRecordIter != curPage->end()) 
-		{
-		  // get pointer to record
-		  rec = *pageRecordIter;
-
-			outRid = pageRecordIter.getCurrentRecord();
-			return;
-		}
+    loadPage();
+  }
+  else
+  {
+    // first try and get the next record off the current page
+    nextRecord();
   }
 
-	// Loop, looking for a record that satisfied the predicate.
-	// First try and get the next record off the current page
-	pageRecordIter++;
-
-  while (pageRecordIter == curPage->end())
+  while (atPageEnd())
   {
     // unpin the current page
-    bufMgr->unPinPage(file, (*filePageIter).page_number(), curDirtyFlag);
+    bufMgr->unPinPage(file, filePageIter.pageNumber(), curDirtyFlag);
     curPage = NULL;
     curDirtyFlag = false;
 
     filePageIter++;
-    if (filePageIter == file->end())
+    if (pastEnd())
     {
-      curPage = NULL;
+      filePageIter = file->end();
 			throw EndOfFileException();
     }
+    loadPage();
+  }
+
+	// return rid of the record
+	outRid = pageRecordIter.getCurrentRecord();
+}
+
+void FileScan::loadPage()
+{
+  readAhead(filePageIter.pageNumber());
+  bufMgr->readPage(file, filePageIter.pageNumber(), curPage, &ring);
+	curDirtyFlag = false;
+
+  pageFiltered = filtered;
+  if (!pageFiltered)
+  {
+    pageRecordIter = curPage->begin();
+    return;
+  }
+  matchPage();
+  nextMatch = 0;
+  if (!matches.empty())
+    pageRecordIter = PageIterator(curPage, matches[0]);
+}
+
+void FileScan::nextRecord()
+{
+  if (!pageFiltered)
+  {
+    pageRecordIter++;
+    return;
+  }
+  if (++nextMatch < matches.size())
+    pageRecordIter = PageIterator(curPage, matches[nextMatch]);
+}
+
+void FileScan::matchPage()
+{
+  matches.clear();
+  candidates.clear();
+  intKeys.clear();
+  doubleKeys.clear();
+  std::size_t width = filterType == INTEGER ? sizeof(int) : filterType == DOUBLE ? sizeof(double) : 1;
+
+  // gather the attributes of the records, through their slots
+  for (PageIterator iter = curPage->begin(); iter != curPage->end(); ++iter)
+  {
+    std::string_view record = iter.view();
+    if (record.size() < filterOffset + width)
+      continue;
+    const char *attr = record.data() + filterOffset;
+    if (filterType == INTEGER)
+    {
+      candidates.push_back(iter.getCurrentRecord());
+      intKeys.push_back(0);
+      loadKey(attr, intKeys.back());
+    }
+    else if (filterType == DOUBLE)
+    {
+      candidates.push_back(iter.getCurrentRecord());
+      doubleKeys.push_back(0);
+      loadKey(attr, doubleKeys.back());
+    }
+    else
+    {
+      // a string is compared on its characters up to the end of the record
+      int length = strnlen(attr, std::min<std::size_t>(STRINGSIZE, record.size() - filterOffset));
+      int low = compareBytes(attr, length, stringBounds[0].data, stringBounds[0].length);
+      int high = compareBytes(attr, length, stringBounds[1].data, stringBounds[1].length);
+      if ((lowOrEqual ? low >= 0 : low > 0) && (highOrEqual ? high <= 0 : high < 0))
+        matches.push_back(iter.getCurrentRecord());
+    }
+  }
 
-    // read the next page of the file
-    bufMgr->readPage(file, (*filePageIter).page_number(), curPage);
+  // compare the fixed size attributes all at once
+  if (filterType != STRING)
+  {
+    selected.resize(candidates.size());
+    int numSelected = filterType == INTEGER
+        ? selectKeysInRange(intKeys.data(), intKeys.size(), intBounds[0], lowOrEqual, intBounds[1],
+                            highOrEqual, selected.data())
+        : selectKeysInRange(doubleKeys.data(), doubleKeys.size(), doubleBounds[0], lowOrEqual,
+                            doubleBounds[1], highOrEqual, selected.data());
+    for (int i = 0; i < numSelected; i++)
+      matches.push_back(candidates[selected[i]]);
+  }
+}
+
+void FileScan::setFilter(int attrByteOffset, Datatype attrType, const void *lowVal, Operator lowOp,
+                         const void *highVal, Operator highOp)
+{
+  if ((lowOp != GT && lowOp != GTE) || (highOp != LT && highOp != LTE))
+    throw BadOpcodesException();
 
-    // get the first record off the page
-    pageRecordIter = curPage->begin(); 
+  bool badRange;
+  switch (attrType)
+  {
+  case INTEGER:
+    loadKey(lowVal, intBounds[0]);
+    loadKey(highVal, intBounds[1]);
+    badRange = intBounds[1] < intBounds[0];
+    break;
+  case DOUBLE:
+    loadKey(lowVal, doubleBounds[0]);
+    loadKey(highVal, doubleBounds[1]);
+    badRange = doubleBounds[1] < doubleBounds[0];
+    break;
+  default:
+    loadKey(lowVal, stringBounds[0]);
+    loadKey(highVal, stringBounds[1]);
+    badRange = stringBounds[1] < stringBounds[0];
+    break;
   }
+  if (badRange)
+    throw BadScanrangeException();
 
-  // curRec points at a valid record
-  // see if the record satisfies the scan's predicate 
-  // get a pointer to the record
-  rec = *pageRecordIter;
+  filterOffset = attrByteOffset;
+  filterType = attrType;
+  lowOrEqual = lowOp == GTE;
+  highOrEqual = highOp == LTE;
+  filtered = true;
+}
 
-	// return rid of the record
-	outRid = pageRecordIter.getCurrentRecord();
-	return;
+void FileScan::clearFilter()
+{
+  filtered = false;
+}
+
+void FileScan::readAhead(PageId pageNo)
+{
+  bool restart = readAheadEnd == Page::INVALID_NUMBER || pageNo > readAheadEnd || pageNo < readAheadMark;
+  if (!restart && pageNo != readAheadMark)
+    return;
+
+  // a batch takes at most half the ring, so that the pages of the last one are not recycled before
+  // the scan reaches them
+  std::uint32_t window = std::max(bufMgr->ringSize(ring) / 2, 1u);
+  std::vector<PageId> pageNos;
+  if (restart)
+    pageNos.push_back(pageNo);
+  file->readAheadPages(restart ? pageNo : readAheadEnd, window - pageNos.size(), pageNos);
+  // the pages past the range are left to the scan of the next one
+  while (!pageNos.empty() && pageNos.back() >= rangeEnd)
+    pageNos.pop_back();
+  if (pageNos.empty())
+  {
+    readAheadMark = Page::INVALID_NUMBER;
+    return;
+  }
+
+  bufMgr->prefetchPages(file, pageNos, &ring);
+  readAheadEnd = pageNos.back();
+  readAheadMark = pageNos[pageNos.size() / 2];
 }
 
 // returns pointer to the current record.  page is left pinned
@@ -111,10 +277,160 @@ std::string FileScan::getRecord()
   return *pageRecordIter;
 }
 
+std::string_view FileScan::getRecordView()
+{
+  return pageRecordIter.view();
+}
+
+ParallelFileScan::ParallelFileScan(const std::string &name, BufMgr *bufferMgr, std::uint32_t pages)
+  : morselPages(std::max(pages, 1u)), nextMorsel(1), failed(false)
+{
+  file = new PageFile(name, false);	//dont create new file
+  bufMgr = bufferMgr;
+}
+
+ParallelFileScan::~ParallelFileScan()
+{
+  bufMgr->flushFile(file);
+  delete file;
+}
+
+void ParallelFileScan::run(unsigned numThreads, const RecordFunction &fn)
+{
+  nextMorsel = 1;
+  failed = false;
+  error = std::exception_ptr();
+
+  std::vector<std::thread> threads;
+  for (unsigned t = 1; t < numThreads; t++)
+    threads.push_back(std::thread(&ParallelFileScan::work, this, t, std::cref(fn)));
+  work(0, fn);
+  for (std::thread &thread : threads)
+    thread.join();
+
+  if (error)
+    std::rethrow_exception(error);
+}
+
+void ParallelFileScan::work(unsigned thread, const RecordFunction &fn)
+{
+  try
+  {
+    FileScan scan(file, bufMgr, Page::INVALID_NUMBER, Page::INVALID_NUMBER);
+    PageId numPages = file->numPages();
+    while (!failed)
+    {
+      PageId first = nextMorsel.fetch_add(morselPages);
+      if (first >= numPages)
+        break;
+      scan.setRange(first, std::min(first + morselPages, numPages));
+      RecordId rid;
+      while (!failed)
+      {
+        try
+        {
+          scan.scanNext(rid);
+        }
+        catch(const EndOfFileException &e)
+        {
+          break;
+        }
+        fn(thread, rid, scan.getRecordView());
+      }
+    }
+  }
+  catch(...)
+  {
+    std::lock_guard<std::mutex> guard(errorMutex);
+    if (!error)
+      error = std::current_exception();
+    failed = true;
+  }
+}
+
 // mark current page of scan dirty
 void FileScan::markDirty()
 {
   curDirtyFlag = true;
 }
 
+BitmapHeapScan::BitmapHeapScan(const std::string &name, BufMgr *bufferMgr, const RidBitmap &rids)
+  : ring(FileScan::RING_SIZE), bitmap(rids)
+{
+  file = new PageFile(name, false);	//dont create new file
+  bufMgr = bufferMgr;
+  for (const RidBitmap::PageMap::value_type &page : bitmap.pages())
+    pageNos.push_back(page.first);
+  curIndex = 0;
+  curPage = NULL;
+  nextSlot = 0;
+  readAheadEnd = readAheadMark = 0;
+}
+
+BitmapHeapScan::~BitmapHeapScan()
+{
+  if (curPage != NULL)
+    bufMgr->unPinPage(file, pageNos[curIndex], false);
+  bufMgr->flushFile(file);
+  delete file;
+}
+
+void BitmapHeapScan::scanNext(RecordId& outRid)
+{
+  if (curPage != NULL)
+    nextSlot++;
+
+  while (curPage == NULL || nextSlot >= slots.size())
+  {
+    // move to the next page of the set, each page being read once
+    if (curPage != NULL)
+    {
+      bufMgr->unPinPage(file, pageNos[curIndex], false);
+      curPage = NULL;
+      curIndex++;
+    }
+    if (curIndex >= pageNos.size())
+      throw EndOfFileException();
+
+    readAhead();
+    bufMgr->readPage(file, pageNos[curIndex], curPage, &ring);
+    bitmap.pageSlots(pageNos[curIndex], slots);
+    nextSlot = 0;
+  }
+
+  outRid.page_number = pageNos[curIndex];
+  outRid.slot_number = slots[nextSlot];
+  outRid.padding = 0;
+}
+
+void BitmapHeapScan::readAhead()
+{
+  if (curIndex < readAheadMark)
+    return;
+
+  // as in FileScan, a batch takes at most half the ring
+  std::size_t window = std::max(bufMgr->ringSize(ring) / 2, 1u);
+  std::size_t begin = std::max(curIndex, readAheadEnd);
+  std::size_t end = std::min(begin + window, pageNos.size());
+  readAheadMark = pageNos.size();
+  if (begin >= end)
+    return;
+
+  std::vector<PageId> batch(pageNos.begin() + begin, pageNos.begin() + end);
+  bufMgr->prefetchPages(file, batch, &ring);
+  readAheadEnd = end;
+  readAheadMark = begin + (end - begin) / 2;
+}
+
+std::string BitmapHeapScan::getRecord()
+{
+  return std::string(getRecordView());
+}
+
+std::string_view BitmapHeapScan::getRecordView()
+{
+  RecordId rid = {pageNos[curIndex], slots[nextSlot], 0};
+  return curPage->getRecordView(rid);
+}
+
 }
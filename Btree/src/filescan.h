@@ -8,32 +8,84 @@
 
 #pragma once
 
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <mutex>
 #include <string>
+#include <string_view>
 #include "types.h"
 #include "page.h"
 #include "buffer.h"
+#include "btree.h"
 #include "file_iterator.h"
 #include "page_iterator.h"
+#include "rid_bitmap.h"
 
 namespace badgerdb {
 
 /**
  * @brief This class is used to sequentially scan records in a relation.
+ * Its pages are read through a private ring of frames, so that a scan neither evicts the pages of
+ * the shared pool nor sweeps it for a victim at every page. They are read ahead in batches of half
+ * the ring, the next batch being read once the scan is half way through the last one.
  */
 class FileScan
 {
  public:
+  /**
+   * Number of frames of the ring of a scan, i.e. 512KB of pages, read ahead 256KB at a time
+   */
+  static const std::uint32_t RING_SIZE = 64;
 
   FileScan(const std::string &name, BufMgr *bufMgr);
 
+  /**
+   * Constructor of a scan of a range of pages of an open file, which it shares with other scans. The file
+   * is neither flushed nor closed by the scan.
+   *
+   * @param file   	File to scan
+   * @param bufMgr 	Buffer manager
+   * @param first  	First page of the range
+   * @param end    	Page past the range
+   */
+  FileScan(PageFile *file, BufMgr *bufMgr, PageId first, PageId end);
+
   ~FileScan();
 
+  //restart the scan on the used pages numbered from first up to end excluded, unpinning the current page
+  void setRange(PageId first, PageId end);
+
   //return RecordId of next record that satisfies the scan 
   void scanNext(RecordId& outRid);
 
   //read current record, returning pointer and length
   std::string getRecord();
 
+  //view current record without copying it, valid until the scan moves to the next page
+  std::string_view getRecordView();
+
+  /**
+   * Only return the records whose attribute lies in a range. The attribute is compared in place in the
+   * pinned page, the records which do not match being skipped without being copied. INTEGER and DOUBLE
+   * attributes are compared a page at a time by a vectorized kernel. A record too short to hold the
+   * attribute does not match. The filter applies from the next page the scan reads.
+   *
+   * @param attrByteOffset	Offset of the attribute in the records
+   * @param attrType      	Datatype of the attribute
+   * @param lowVal        	Low value of the range, pointer to integer / double / char string
+   * @param lowOp         	Operator for the low value, GT or GTE
+   * @param highVal       	High value of the range, pointer to integer / double / char string
+   * @param highOp        	Operator for the high value, LT or LTE
+   * @throws BadOpcodesException If lowOp or highOp do not contain the ones listed above
+   * @throws BadScanrangeException If lowVal > highVal
+   */
+  void setFilter(int attrByteOffset, Datatype attrType, const void *lowVal, Operator lowOp,
+                 const void *highVal, Operator highOp);
+
+  //return all the records again, from the next page the scan reads
+  void clearFilter();
+
   //marks current page of scan dirty
   void markDirty();
 
@@ -48,6 +100,11 @@ class FileScan
    */
 	BufMgr				*bufMgr;
 
+  /**
+   * Frames the pages of the file are read in.
+   */
+  BufRing       ring;
+
   /**
    * Current page being scanned.
    */
@@ -60,6 +117,257 @@ class FileScan
    * True if page has been updated
    */
   bool  	      curDirtyFlag;
+
+  /**
+   * True if the scan opened the file, and closes it
+   */
+  bool          ownsFile;
+
+  /**
+   * First page of the range scanned, INVALID_NUMBER for the whole file, and page past the range
+   */
+  PageId        rangeFirst;
+  PageId        rangeEnd;
+
+  /**
+   * True if the scan has a filter, and if the current page was read with it
+   */
+  bool          filtered;
+  bool          pageFiltered;
+
+  /**
+   * Offset and type of the attribute of the filter
+   */
+  int           filterOffset;
+  Datatype      filterType;
+
+  /**
+   * Bounds of the filter, of its attribute type, and whether the records equal to them match
+   */
+  int           intBounds[2];
+  double        doubleBounds[2];
+  StringKey     stringBounds[2];
+  bool          lowOrEqual;
+  bool          highOrEqual;
+
+  /**
+   * Records of the current page matching the filter, and position of the current one
+   */
+  std::vector<RecordId> matches;
+  std::size_t   nextMatch;
+
+  /**
+   * Records of the current page holding the attribute, their attributes, and the positions of those which
+   * match, for the vectorized comparison
+   */
+  std::vector<RecordId> candidates;
+  std::vector<int> intKeys;
+  std::vector<double> doubleKeys;
+  std::vector<int> selected;
+
+  /**
+   * Last page read ahead, and page from which the next batch is read ahead. INVALID_NUMBER before the
+   * first batch
+   */
+  PageId        readAheadEnd;
+  PageId        readAheadMark;
+
+  /**
+   * Read the pages ahead of the scan, if it has reached the mark of the last batch or moved past it.
+   *
+   * @param pageNo 	Page the scan moves to
+   */
+  void readAhead(PageId pageNo);
+
+  /**
+   * Read the page the scan moved to, and position the scan at its first record or first match.
+   */
+  void loadPage();
+
+  /**
+   * Move the scan to the next record, or the next match, of the current page.
+   */
+  void nextRecord();
+
+  /**
+   * Check whether the scan is past the last record, or the last match, of the current page.
+   */
+  bool atPageEnd() const
+  {
+    return pageFiltered ? nextMatch >= matches.size() : pageRecordIter == curPage->end();
+  }
+
+  /**
+   * Collect the records of the current page matching the filter.
+   */
+  void matchPage();
+
+  /**
+   * Check whether the scan has gone past the pages of its range.
+   */
+  bool pastEnd() const
+  {
+    return filePageIter == file->end() || filePageIter.pageNumber() >= rangeEnd;
+  }
+};
+
+/**
+ * @brief This class is used to scan the records of a relation with several threads.
+ * The pages are split in ranges of MORSEL_PAGES pages, handed out to the threads one at a time through an
+ * atomic counter, so that a thread done with its range takes the next one and the threads finish together
+ * however the records are spread. Each thread scans its ranges with its own FileScan, on the file shared by
+ * the threads.
+ */
+class ParallelFileScan
+{
+ public:
+  /**
+   * Number of pages of a range handed out to a thread, i.e. 512KB
+   */
+  static const std::uint32_t MORSEL_PAGES = 64;
+
+  /**
+   * Function called on each record, with the number of the thread, the id of the record and a view of the
+   * record valid during the call
+   */
+  typedef std::function<void(unsigned, const RecordId &, std::string_view)> RecordFunction;
+
+  /**
+   * Constructor of ParallelFileScan class
+   *
+   * @param name      	Name of the relation
+   * @param bufMgr    	Buffer manager
+   * @param morselPages	Number of pages of a range
+   */
+  ParallelFileScan(const std::string &name, BufMgr *bufMgr, std::uint32_t morselPages = MORSEL_PAGES);
+
+  ~ParallelFileScan();
+
+  /**
+   * Scan all the records of the relation. The function is called concurrently by the threads, and must
+   * synchronize what they share. If it throws, the threads stop at their next record and the first
+   * exception is thrown again once all have stopped.
+   *
+   * @param numThreads	Number of threads, at least 1
+   * @param fn        	Function called on each record
+   */
+  void run(unsigned numThreads, const RecordFunction &fn);
+
+ private:
+  /**
+   * File which is being scanned.
+   */
+  PageFile      *file;
+
+  /**
+   * Buffer Manager instance used to read pages into the buffer pool.
+   */
+  BufMgr        *bufMgr;
+
+  /**
+   * Number of pages of a range
+   */
+  std::uint32_t morselPages;
+
+  /**
+   * First page of the next range to hand out
+   */
+  std::atomic<PageId> nextMorsel;
+
+  /**
+   * Whether a thread failed, and its exception
+   */
+  std::atomic<bool> failed;
+  std::exception_ptr error;
+  std::mutex    errorMutex;
+
+  /**
+   * Scan ranges until there is none left.
+   *
+   * @param thread 	Number of the thread
+   * @param fn     	Function called on each record
+   */
+  void work(unsigned thread, const RecordFunction &fn);
+};
+
+/**
+ * @brief This class is used to fetch the records of a set of record IDs, such as those collected by an index
+ * range scan, in page order rather than in key order. Each page holding some of them is read once, through a
+ * private ring of frames, and the pages are read ahead in batches of half the ring.
+ */
+class BitmapHeapScan
+{
+ public:
+  /**
+   * Constructor of BitmapHeapScan class
+   *
+   * @param name   	Name of the relation
+   * @param bufMgr 	Buffer manager
+   * @param rids   	Record IDs of the records to fetch, which must outlive the scan
+   */
+  BitmapHeapScan(const std::string &name, BufMgr *bufMgr, const RidBitmap &rids);
+
+  ~BitmapHeapScan();
+
+  //return the next RecordId of the set, in page and slot order
+  void scanNext(RecordId& outRid);
+
+  //read current record
+  std::string getRecord();
+
+  //view current record without copying it, valid until the scan moves to the next page
+  std::string_view getRecordView();
+
+  //number of pages read so far
+  std::size_t pagesRead() const
+  {
+    return curPage != NULL ? curIndex + 1 : curIndex;
+  }
+
+ private:
+  /**
+   * File whose records are fetched.
+   */
+  PageFile      *file;
+
+  /**
+   * Buffer Manager instance used to read pages into the buffer pool.
+   */
+  BufMgr        *bufMgr;
+
+  /**
+   * Frames the pages of the file are read in.
+   */
+  BufRing       ring;
+
+  /**
+   * Record IDs to fetch, and the pages holding them in order
+   */
+  const RidBitmap &bitmap;
+  std::vector<PageId> pageNos;
+
+  /**
+   * Position in pageNos of the current page, and the page if it is pinned
+   */
+  std::size_t   curIndex;
+  Page*         curPage;
+
+  /**
+   * Slots of the current page in the set, and position of the current one
+   */
+  std::vector<SlotId> slots;
+  std::size_t   nextSlot;
+
+  /**
+   * Position in pageNos past the last page read ahead, and position from which the next batch is read ahead
+   */
+  std::size_t   readAheadEnd;
+  std::size_t   readAheadMark;
+
+  /**
+   * Read the pages ahead of the scan, if it has reached the mark of the last batch.
+   */
+  void readAhead();
 };
 
 }
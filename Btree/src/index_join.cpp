@@ -0,0 +1,108 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#include "index_join.h"
+#include "exceptions/end_of_file_exception.h"
+
+namespace badgerdb {
+
+const std::size_t IndexJoin::JOIN_BATCH;
+
+IndexJoin::IndexJoin(const std::string &outerRelationName, BufMgr *bufMgr, int outerAttrByteOffset,
+                     BTreeIndex *innerIndex, std::size_t batchSizeIn)
+  : outerScan(outerRelationName, bufMgr), index(innerIndex), attrByteOffset(outerAttrByteOffset),
+    batchSize(std::max<std::size_t>(batchSizeIn, 1)), exhausted(false), numOuter(0)
+{
+}
+
+bool IndexJoin::nextBatch(std::vector<JoinPair> &out)
+{
+  out.clear();
+  while (out.empty() && !exhausted)
+    joinBatch(out);
+  return !out.empty();
+}
+
+void IndexJoin::joinBatch(std::vector<JoinPair> &out)
+{
+  // the keys of the batch, a char string with its terminator, and the record IDs of their records
+  const Datatype attrType = index->getAttributeType();
+  const std::size_t keyWidth = attrType == INTEGER ? sizeof(int)
+      : attrType == DOUBLE ? sizeof(double) : STRINGSIZE + 1;
+  std::vector<char> keys;
+  std::vector<RecordId> rids;
+  keys.reserve(batchSize * keyWidth);
+  try
+  {
+    while (rids.size() < batchSize)
+    {
+      RecordId rid;
+      outerScan.scanNext(rid);
+      const char *key = outerScan.getRecordView().data() + attrByteOffset;
+      keys.resize(keys.size() + keyWidth, 0);
+      memcpy(&keys[keys.size() - keyWidth], key, attrType == STRING ? strnlen(key, STRINGSIZE) : keyWidth);
+      rids.push_back(rid);
+    }
+  }
+  catch (const EndOfFileException &e)
+  {
+    exhausted = true;
+  }
+  numOuter += rids.size();
+
+  // the records are sorted by the normalized encoding of their key, which orders them as the index does
+  std::vector<std::string> encoded(rids.size());
+  for (std::size_t i = 0; i < rids.size(); i++)
+  {
+    StringKey normalized;
+    index->normalizeKey(&keys[i * keyWidth], normalized);
+    encoded[i].assign(normalized.data, normalized.length);
+  }
+  std::vector<std::size_t> order(rids.size());
+  for (std::size_t i = 0; i < order.size(); i++)
+    order[i] = i;
+  std::sort(order.begin(), order.end(),
+            [&encoded](std::size_t a, std::size_t b) { return encoded[a] < encoded[b]; });
+
+  // each distinct key is probed once, for the run of records that have it; the keys are compared in full too,
+  // since the encoding of a char string keeps STRINGSIZE - 1 characters
+  std::vector<std::size_t> runs;
+  std::vector<char> probeKeys;
+  std::vector<const char *> probeStrings;
+  for (std::size_t j = 0; j < order.size(); j++)
+  {
+    if (j > 0 && encoded[order[j]] == encoded[order[j - 1]]
+        && std::memcmp(&keys[order[j] * keyWidth], &keys[order[j - 1] * keyWidth], keyWidth) == 0)
+      continue;
+    runs.push_back(j);
+    const char *key = &keys[order[j] * keyWidth];
+    if (attrType == STRING)
+      probeStrings.push_back(key);
+    else
+      probeKeys.insert(probeKeys.end(), key, key + keyWidth);
+  }
+  runs.push_back(order.size());
+  std::vector<std::pair<std::size_t, RecordId>> matches;
+  index->lookupBatchAll(attrType == STRING ? (const void *)probeStrings.data() : probeKeys.data(), runs.size() - 1,
+                        matches);
+
+  // every record of a run is paired with every entry of its key, and the pairs are ordered by inner record
+  for (const std::pair<std::size_t, RecordId> &match : matches)
+  {
+    for (std::size_t j = runs[match.first]; j < runs[match.first + 1]; j++)
+      out.push_back(JoinPair{rids[order[j]], match.second});
+  }
+  std::sort(out.begin(), out.end(), [](const JoinPair &a, const JoinPair &b) {
+    return a.inner != b.inner ? a.inner < b.inner : a.outer < b.outer;
+  });
+}
+
+}
@@ -0,0 +1,125 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "types.h"
+#include "buffer.h"
+#include "btree.h"
+#include "filescan.h"
+
+namespace badgerdb {
+
+/**
+ * @brief A record of the outer relation of a join and a record of the inner relation with the same key.
+ */
+struct JoinPair
+{
+	/**
+	 * Record ID of the outer record
+	 */
+	RecordId outer;
+
+	/**
+	 * Record ID of the inner record
+	 */
+	RecordId inner;
+};
+
+/**
+* @brief Index nested loop join of an outer relation, read by a FileScan, with an inner relation through a
+* BTreeIndex on its join attribute. Instead of a lookup per outer record, the outer records are read a batch
+* at a time and sorted by their key, and the distinct keys of the batch are probed at once by
+* BTreeIndex::lookupBatchAll, which sweeps along the leaves and shares a descent between the keys that lie in
+* the same leaf. The pairs of a batch are returned ordered by the record ID of their inner record, so that
+* the pages of the inner relation are read one after the other, each once per batch.
+*
+* The outer attribute is read as the datatype of the index.
+*/
+class IndexJoin
+{
+ public:
+	/**
+   * Number of outer records a batch holds by default
+	 */
+  static const std::size_t JOIN_BATCH = 4096;
+
+	/**
+	 * Start a join, scanning the outer relation from its first record.
+	 *
+	 * @param outerRelationName	Name of the outer relation file
+	 * @param bufMgr 	Buffer manager the outer relation is read through
+	 * @param outerAttrByteOffset	Offset of the join attribute in the outer records
+	 * @param innerIndex	Index of the inner relation on its join attribute
+	 * @param batchSize	Number of outer records read and probed at a time
+	 */
+  IndexJoin(const std::string &outerRelationName, BufMgr *bufMgr, int outerAttrByteOffset, BTreeIndex *innerIndex,
+            std::size_t batchSize = JOIN_BATCH);
+
+  IndexJoin(const IndexJoin &) = delete;
+  IndexJoin &operator=(const IndexJoin &) = delete;
+
+	/**
+	 * Join the next batch of outer records that has a match.
+	 *
+	 * @param out 	Pairs of the batch returned in this, ordered by the record ID of their inner record
+	 * @return false if the outer relation is exhausted, out being empty then
+	 */
+  bool nextBatch(std::vector<JoinPair> &out);
+
+	/**
+	 * Get the number of outer records read so far.
+	 */
+  std::size_t getNumOuter() const
+  {
+		return numOuter;
+  }
+
+ private:
+	/**
+   * Scan of the outer relation
+	 */
+  FileScan outerScan;
+
+	/**
+   * Index of the inner relation
+	 */
+  BTreeIndex *index;
+
+	/**
+   * Offset of the join attribute in the outer records
+	 */
+  int attrByteOffset;
+
+	/**
+   * Number of outer records read at a time
+	 */
+  std::size_t batchSize;
+
+	/**
+   * Whether the scan of the outer relation is completed
+	 */
+  bool exhausted;
+
+	/**
+   * Number of outer records read so far
+	 */
+  std::size_t numOuter;
+
+	/**
+	 * Read the next batch of outer records, and find their pairs.
+	 *
+	 * @param out 	Pairs of the batch returned in this
+	 */
+  void joinBatch(std::vector<JoinPair> &out);
+};
+
+}
@@ -0,0 +1,440 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+#include "types.h"
+#include "buffer.h"
+
+// Tracepoints of the index operations, for perf or bpftrace: "make USDT=1" builds them as USDT probes of the
+// provider badgerdb, which needs <sys/sdt.h>, and they compile to nothing otherwise.
+//   op__start(op)              an operation of IndexOp op begins
+//   op__done(op, descents)     it ends, having descended the tree that many times
+//   split(level, pageNo)       a node of a level, 0 for the leaves, is split
+#ifdef BADGERDB_USDT
+#include <sys/sdt.h>
+#define BADGERDB_TRACE1(name, a) DTRACE_PROBE1(badgerdb, name, a)
+#define BADGERDB_TRACE2(name, a, b) DTRACE_PROBE2(badgerdb, name, a, b)
+#else
+#define BADGERDB_TRACE1(name, a) ((void)0)
+#define BADGERDB_TRACE2(name, a, b) ((void)0)
+#endif
+
+namespace badgerdb {
+
+/**
+* @brief Operations of an index whose latencies are measured.
+*/
+enum IndexOp
+{
+	OP_INSERT = 0,
+	OP_LOOKUP,
+	OP_START_SCAN,
+	OP_SCAN_NEXT,
+	OP_SPLIT,
+	NUM_INDEX_OPS
+};
+
+/**
+* @brief Counts of the work done by the operations of the calling thread, which the index increments as it goes;
+* an operation takes the difference between its end and its start.
+*/
+struct OpCounters
+{
+	/**
+	 * Number of descents from the root, restarts included
+	 */
+  std::uint64_t descents;
+
+	/**
+	 * Number of index pages pinned
+	 */
+  std::uint64_t pins;
+};
+
+inline thread_local OpCounters threadOpCounters = {0, 0};
+
+/**
+* @brief Latency histogram in the manner of HdrHistogram: the values are counted in buckets whose width grows with
+* them, SUB_BUCKETS buckets per power of two, so that any value is known within 1/SUB_BUCKETS of it with a fixed
+* array of counters. Values may be recorded by several threads at once.
+*/
+class LatencyHistogram
+{
+ public:
+	/**
+	 * Number of buckets for each power of two, and its logarithm
+	 */
+  static const int SUB_BITS = 4;
+  static const int SUB_BUCKETS = 1 << SUB_BITS;
+
+	/**
+	 * Values are counted up to 2^MAX_BITS - 1, i.e. 18 minutes in nanoseconds; larger ones are counted as that
+	 */
+  static const int MAX_BITS = 40;
+
+	/**
+	 * Number of buckets
+	 */
+  static const int NUM_BUCKETS = (MAX_BITS - SUB_BITS + 1) * SUB_BUCKETS;
+
+	/**
+	 * @brief Copy of the counts of a histogram at one time.
+	 */
+  struct Snapshot
+  {
+		/**
+		 * Number of values, their sum and the largest one
+		 */
+    std::uint64_t count = 0;
+    std::uint64_t sum = 0;
+    std::uint64_t max = 0;
+
+		/**
+		 * Number of values of each bucket
+		 */
+    std::vector<std::uint64_t> buckets;
+
+		/**
+		 * Get the value below which a percentage of the values are, within the precision of the buckets.
+		 *
+		 * @param percent 	Percentage, from 0 to 100
+		 * @return the highest value of the bucket of that rank, at most the largest value, 0 if there is none
+		 */
+    std::uint64_t percentile(double percent) const
+    {
+			std::uint64_t rank = std::max<std::uint64_t>(1, (std::uint64_t)(percent / 100 * count + 0.5));
+			std::uint64_t seen = 0;
+			for (int bucket = 0; bucket < (int)buckets.size(); bucket++)
+			{
+				seen += buckets[bucket];
+				if (seen >= rank)
+				{
+					return std::min(bucketHigh(bucket), max);
+				}
+			}
+			return max;
+    }
+
+		/**
+		 * Get the mean of the values, 0 if there is none
+		 */
+    double mean() const
+    {
+			return count > 0 ? (double)sum / count : 0;
+    }
+  };
+
+	/**
+	 * Get the bucket of a value.
+	 */
+  static int bucketOf(std::uint64_t value)
+  {
+		value = std::min<std::uint64_t>(value, (1ULL << MAX_BITS) - 1);
+		if (value < (std::uint64_t)SUB_BUCKETS)
+		{
+			return (int)value;
+		}
+		int shift = 63 - __builtin_clzll(value) - SUB_BITS;
+		return (shift + 1) * SUB_BUCKETS + (int)((value >> shift) & (SUB_BUCKETS - 1));
+  }
+
+	/**
+	 * Get the highest value counted in a bucket.
+	 */
+  static std::uint64_t bucketHigh(int bucket)
+  {
+		if (bucket < SUB_BUCKETS)
+		{
+			return bucket;
+		}
+		int shift = bucket / SUB_BUCKETS - 1;
+		return ((std::uint64_t)(SUB_BUCKETS + bucket % SUB_BUCKETS + 1) << shift) - 1;
+  }
+
+  LatencyHistogram()
+  {
+		clear();
+  }
+
+	/**
+	 * Count a value.
+	 */
+  void record(std::uint64_t value)
+  {
+		buckets[bucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+		count.fetch_add(1, std::memory_order_relaxed);
+		sum.fetch_add(value, std::memory_order_relaxed);
+		std::uint64_t oldMax = max.load(std::memory_order_relaxed);
+		while (value > oldMax && !max.compare_exchange_weak(oldMax, value, std::memory_order_relaxed))
+		{
+		}
+  }
+
+	/**
+	 * Copy the counts. Values recorded meanwhile may be in some counts and not in others.
+	 */
+  Snapshot snapshot() const
+  {
+		Snapshot copy;
+		copy.count = count.load(std::memory_order_relaxed);
+		copy.sum = sum.load(std::memory_order_relaxed);
+		copy.max = max.load(std::memory_order_relaxed);
+		copy.buckets.resize(NUM_BUCKETS);
+		for (int bucket = 0; bucket < NUM_BUCKETS; bucket++)
+		{
+			copy.buckets[bucket] = buckets[bucket].load(std::memory_order_relaxed);
+		}
+		return copy;
+  }
+
+	/**
+	 * Forget the values counted.
+	 */
+  void clear()
+  {
+		for (std::atomic<std::uint64_t> &bucket : buckets)
+		{
+			bucket.store(0, std::memory_order_relaxed);
+		}
+		count.store(0, std::memory_order_relaxed);
+		sum.store(0, std::memory_order_relaxed);
+		max.store(0, std::memory_order_relaxed);
+  }
+
+ private:
+  std::atomic<std::uint64_t> buckets[NUM_BUCKETS];
+  std::atomic<std::uint64_t> count;
+  std::atomic<std::uint64_t> sum;
+  std::atomic<std::uint64_t> max;
+};
+
+/**
+* @brief Measures of one type of operation of an index.
+*/
+struct IndexOpStats
+{
+	/**
+	 * Latencies of the operations, in nanoseconds
+	 */
+  LatencyHistogram::Snapshot latency;
+
+	/**
+	 * Total number of descents from the root the operations made, restarts included
+	 */
+  std::uint64_t descents;
+
+	/**
+	 * Total number of index pages they pinned
+	 */
+  std::uint64_t pagesPinned;
+
+	/**
+	 * Total number of pages they read from disk, of the index or not, through any buffer manager
+	 */
+  std::uint64_t diskReads;
+};
+
+/**
+* @brief Latency histograms and counters of the operations of an index, recorded by several threads at once.
+* Splits are timed on their own, and counted per level of the split node.
+*/
+class IndexMetrics
+{
+ public:
+	/**
+	 * Number of levels whose splits are counted: the leaves and the non leaf levels. A split of a higher
+	 * level is counted in the last one
+	 */
+  static const int MAX_LEVELS = 41;
+
+  IndexMetrics()
+  {
+		clear();
+  }
+
+	/**
+	 * Record an operation.
+	 *
+	 * @param op  			Operation
+	 * @param nanos 		Latency in nanoseconds
+	 * @param work 			Descents and pins of the operation
+	 * @param diskReads	Number of pages it read from disk
+	 */
+  void recordOp(IndexOp op, std::uint64_t nanos, const OpCounters &work, std::uint64_t diskReads)
+  {
+		latency[op].record(nanos);
+		descents[op].fetch_add(work.descents, std::memory_order_relaxed);
+		pins[op].fetch_add(work.pins, std::memory_order_relaxed);
+		reads[op].fetch_add(diskReads, std::memory_order_relaxed);
+  }
+
+	/**
+	 * Record the split of a node.
+	 *
+	 * @param level 		Level of the node, 0 for a leaf
+	 * @param nanos 		Latency of the split in nanoseconds
+	 */
+  void recordSplit(int level, std::uint64_t nanos)
+  {
+		latency[OP_SPLIT].record(nanos);
+		splits[std::min(level, MAX_LEVELS - 1)].fetch_add(1, std::memory_order_relaxed);
+  }
+
+	/**
+	 * Get the measures of a type of operation.
+	 */
+  IndexOpStats opStats(IndexOp op) const
+  {
+		IndexOpStats stats;
+		stats.latency = latency[op].snapshot();
+		stats.descents = descents[op].load(std::memory_order_relaxed);
+		stats.pagesPinned = pins[op].load(std::memory_order_relaxed);
+		stats.diskReads = reads[op].load(std::memory_order_relaxed);
+		return stats;
+  }
+
+	/**
+	 * Get the number of splits of each level, from the leaves up to the highest level split.
+	 */
+  std::vector<std::uint64_t> splitsPerLevel() const
+  {
+		std::vector<std::uint64_t> counts;
+		for (int level = 0; level < MAX_LEVELS; level++)
+		{
+			std::uint64_t n = splits[level].load(std::memory_order_relaxed);
+			if (n > 0)
+			{
+				counts.resize(level + 1);
+				counts[level] = n;
+			}
+		}
+		return counts;
+  }
+
+	/**
+	 * Forget the operations recorded.
+	 */
+  void clear()
+  {
+		for (int op = 0; op < NUM_INDEX_OPS; op++)
+		{
+			latency[op].clear();
+			descents[op].store(0, std::memory_order_relaxed);
+			pins[op].store(0, std::memory_order_relaxed);
+			reads[op].store(0, std::memory_order_relaxed);
+		}
+		for (std::atomic<std::uint64_t> &n : splits)
+		{
+			n.store(0, std::memory_order_relaxed);
+		}
+  }
+
+ private:
+  LatencyHistogram latency[NUM_INDEX_OPS];
+  std::atomic<std::uint64_t> descents[NUM_INDEX_OPS];
+  std::atomic<std::uint64_t> pins[NUM_INDEX_OPS];
+  std::atomic<std::uint64_t> reads[NUM_INDEX_OPS];
+  std::atomic<std::uint64_t> splits[MAX_LEVELS];
+};
+
+/**
+* @brief Measures an operation from its construction to its destruction into the metrics of an index, if they
+* are given, and fires its tracepoints.
+*/
+class OpTimer
+{
+ public:
+	/**
+	 * @param metricsIn 	Metrics to record the operation in, NULL if they are disabled
+	 * @param opIn 			Operation
+	 */
+  OpTimer(IndexMetrics *metricsIn, IndexOp opIn)
+		: metrics(metricsIn), op(opIn)
+  {
+		BADGERDB_TRACE1(op__start, (int)op);
+		if (metrics != NULL)
+		{
+			start = threadOpCounters;
+			startReads = BufMgr::threadDiskReads();
+			startTime = std::chrono::steady_clock::now();
+		}
+  }
+
+  ~OpTimer()
+  {
+		BADGERDB_TRACE2(op__done, (int)op, threadOpCounters.descents - (metrics != NULL ? start.descents : 0));
+		if (metrics != NULL)
+		{
+			OpCounters work = {threadOpCounters.descents - start.descents, threadOpCounters.pins - start.pins};
+			metrics->recordOp(op, nanosSince(startTime), work, BufMgr::threadDiskReads() - startReads);
+		}
+  }
+
+  OpTimer(const OpTimer &) = delete;
+  OpTimer &operator=(const OpTimer &) = delete;
+
+	/**
+	 * Get the time elapsed since a time point, in nanoseconds.
+	 */
+  static std::uint64_t nanosSince(std::chrono::steady_clock::time_point from)
+  {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - from).count();
+  }
+
+ private:
+  IndexMetrics *metrics;
+  IndexOp op;
+  OpCounters start;
+  std::uint64_t startReads;
+  std::chrono::steady_clock::time_point startTime;
+};
+
+/**
+* @brief Measures the split of a node, from its construction to the call of split(), if the metrics are given.
+*/
+class SplitTimer
+{
+ public:
+	/**
+	 * @param metricsIn 	Metrics to record the split in, NULL if they are disabled
+	 */
+  explicit SplitTimer(IndexMetrics *metricsIn)
+		: metrics(metricsIn)
+  {
+		if (metrics != NULL)
+		{
+			startTime = std::chrono::steady_clock::now();
+		}
+  }
+
+	/**
+	 * Record the split, which has just completed.
+	 *
+	 * @param level 		Level of the split node, 0 for a leaf
+	 * @param pageNo 		Page number of the split node
+	 */
+  void split(int level, PageId pageNo)
+  {
+		BADGERDB_TRACE2(split, level, pageNo);
+		if (metrics != NULL)
+		{
+			metrics->recordSplit(level, OpTimer::nanosSince(startTime));
+		}
+  }
+
+ private:
+  IndexMetrics *metrics;
+  std::chrono::steady_clock::time_point startTime;
+};
+
+}
@@ -0,0 +1,321 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "io_engine.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "page.h"
+
+namespace badgerdb {
+
+const unsigned IoEngine::QUEUE_DEPTH;
+
+static std::atomic<bool> uringEnabled(true);
+
+bool IoEngine::finish(IoRequest &request, std::size_t done)
+{
+  char *bytes = static_cast<char *>(request.buf);
+  while (done < request.size)
+  {
+    ssize_t n = request.write
+        ? ::pwrite(request.fd, bytes + done, request.size - done, request.offset + done)
+        : ::pread(request.fd, bytes + done, request.size - done, request.offset + done);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0 || (n == 0 && request.write))
+      return false;
+    if (n == 0)
+    {
+      // past the end of the file
+      std::memset(bytes + done, 0, request.size - done);
+      break;
+    }
+    done += n;
+  }
+  return true;
+}
+
+/**
+* @brief Engine running the requests one after the other.
+*/
+class SyncEngine : public IoEngine
+{
+ public:
+  void submit(std::vector<IoRequest> &requests)
+  {
+    for (IoRequest &request : requests)
+    {
+      if (request.done)
+        continue;
+      request.ok = finish(request, 0);
+      request.done = true;
+    }
+  }
+};
+
+/**
+* @brief Engine queueing the requests to an io_uring instance, through the raw system calls.
+*/
+class UringEngine : public IoEngine
+{
+ private:
+  /**
+   * Descriptor of the ring
+   */
+  int ringFd;
+
+  /**
+   * Mapped submission and completion rings, and submission entries
+   */
+  void *sqRing, *cqRing;
+  io_uring_sqe *sqes;
+  std::size_t sqRingSize, cqRingSize, sqesSize;
+
+  /**
+   * Fields of the submission ring
+   */
+  unsigned *sqTail, *sqMask, *sqArray;
+  unsigned sqEntries;
+
+  /**
+   * Fields of the completion ring
+   */
+  unsigned *cqHead, *cqTail, *cqMask;
+  io_uring_cqe *cqes;
+
+  static int enter(int fd, unsigned toSubmit, unsigned minComplete)
+  {
+    return ::syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, IORING_ENTER_GETEVENTS, NULL, 0);
+  }
+
+ public:
+  UringEngine() : ringFd(-1), sqRing(MAP_FAILED), cqRing(MAP_FAILED), sqes((io_uring_sqe *)MAP_FAILED) {}
+
+  ~UringEngine()
+  {
+    if (sqes != MAP_FAILED)
+      ::munmap(sqes, sqesSize);
+    if (cqRing != MAP_FAILED && cqRing != sqRing)
+      ::munmap(cqRing, cqRingSize);
+    if (sqRing != MAP_FAILED)
+      ::munmap(sqRing, sqRingSize);
+    if (ringFd >= 0)
+      ::close(ringFd);
+  }
+
+  /**
+   * Set up the ring.
+   *
+   * @return  			Whether the kernel supports io_uring
+   */
+  bool init()
+  {
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    ringFd = ::syscall(__NR_io_uring_setup, QUEUE_DEPTH, &params);
+    if (ringFd < 0)
+      return false;
+
+    sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool singleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (singleMmap)
+      sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+
+    sqRing = ::mmap(NULL, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+    if (sqRing == MAP_FAILED)
+      return false;
+    cqRing = singleMmap ? sqRing
+        : ::mmap(NULL, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+    if (cqRing == MAP_FAILED)
+      return false;
+    sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    sqes = (io_uring_sqe *)::mmap(NULL, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED)
+      return false;
+
+    char *sq = static_cast<char *>(sqRing);
+    sqTail = (unsigned *)(sq + params.sq_off.tail);
+    sqMask = (unsigned *)(sq + params.sq_off.ring_mask);
+    sqArray = (unsigned *)(sq + params.sq_off.array);
+    sqEntries = params.sq_entries;
+    char *cq = static_cast<char *>(cqRing);
+    cqHead = (unsigned *)(cq + params.cq_off.head);
+    cqTail = (unsigned *)(cq + params.cq_off.tail);
+    cqMask = (unsigned *)(cq + params.cq_off.ring_mask);
+    cqes = (io_uring_cqe *)(cq + params.cq_off.cqes);
+
+    // the submission entries are used in ring order
+    for (unsigned i = 0; i < sqEntries; i++)
+      sqArray[i] = i;
+    return true;
+  }
+
+  void submit(std::vector<IoRequest> &requests)
+  {
+    std::size_t next = 0;
+    while (true)
+    {
+      // fill the submission ring with up to a ring of requests
+      unsigned tail = *sqTail;
+      unsigned queued = 0;
+      for (; next < requests.size() && queued < sqEntries; next++)
+      {
+        IoRequest &request = requests[next];
+        if (request.done)
+          continue;
+        io_uring_sqe *sqe = &sqes[tail & *sqMask];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = request.write ? IORING_OP_WRITE : IORING_OP_READ;
+        sqe->fd = request.fd;
+        sqe->addr = (unsigned long)request.buf;
+        sqe->len = request.size;
+        sqe->off = request.offset;
+        sqe->user_data = next;
+        tail++;
+        queued++;
+      }
+      if (queued == 0)
+        return;
+      __atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+
+      // submit them all and wait for their completions with one call
+      int submitted;
+      do
+      {
+        submitted = enter(ringFd, queued, queued);
+      } while (submitted < 0 && errno == EINTR);
+      unsigned unsubmitted = submitted >= 0 ? queued - submitted : 0;
+      if (submitted < 0)
+      {
+        // the ring is unusable, e.g. limited by the locked memory; run the requests synchronously
+        __atomic_store_n(sqTail, tail - queued, __ATOMIC_RELEASE);
+        for (std::size_t i = 0; i < next; i++)
+        {
+          if (!requests[i].done)
+          {
+            requests[i].ok = finish(requests[i], 0);
+            requests[i].done = true;
+          }
+        }
+        continue;
+      }
+
+      // reap the completions from the ring, entering the kernel only to wait for more
+      unsigned reaped = 0;
+      bool withdrawn = false;
+      while (reaped < queued)
+      {
+        unsigned head = *cqHead;
+        unsigned ready = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+        if (head == ready)
+        {
+          int n = enter(ringFd, unsubmitted, 1);
+          if (n > 0)
+          {
+            unsubmitted -= n;
+          }
+          else if (n < 0 && errno != EINTR)
+          {
+            // the kernel still transfers into the buffers of the requests it took, so their completions are
+            // polled for; the others are withdrawn from the ring and run synchronously
+            if (unsubmitted > 0)
+            {
+              __atomic_store_n(sqTail, tail - unsubmitted, __ATOMIC_RELEASE);
+              queued -= unsubmitted;
+              unsubmitted = 0;
+              withdrawn = true;
+            }
+            std::this_thread::yield();
+          }
+          continue;
+        }
+        for (; head != ready; head++, reaped++)
+        {
+          const io_uring_cqe &cqe = cqes[head & *cqMask];
+          IoRequest &request = requests[cqe.user_data];
+          // a short or interrupted transfer is finished synchronously
+          request.ok = cqe.res >= 0 ? finish(request, cqe.res) : (cqe.res == -EINTR || cqe.res == -EAGAIN) && finish(request, 0);
+          request.done = true;
+        }
+        __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+      }
+      if (withdrawn)
+      {
+        for (std::size_t i = 0; i < next; i++)
+        {
+          if (!requests[i].done)
+          {
+            requests[i].ok = finish(requests[i], 0);
+            requests[i].done = true;
+          }
+        }
+      }
+    }
+  }
+};
+
+IoEngine &IoEngine::forThread()
+{
+  static thread_local std::unique_ptr<IoEngine> engine;
+  if (!engine)
+  {
+    if (uringEnabled)
+    {
+      UringEngine *uring = new UringEngine();
+      engine.reset(uring);
+      if (!uring->init())
+        engine.reset();
+    }
+    if (!engine)
+      engine.reset(new SyncEngine());
+  }
+  return *engine;
+}
+
+void IoEngine::setUringEnabled(bool enabled)
+{
+  uringEnabled = enabled;
+}
+
+std::size_t IoBatch::add(int fd, void *buf, std::size_t size, off_t offset, bool write, bool usedPage)
+{
+  IoRequest request = {fd, buf, size, offset, write, usedPage, false, false};
+  requests.push_back(request);
+  return requests.size() - 1;
+}
+
+std::size_t IoBatch::addDone(bool ok)
+{
+  IoRequest request = {-1, NULL, 0, 0, false, false, true, ok};
+  requests.push_back(request);
+  return requests.size() - 1;
+}
+
+void IoBatch::submit()
+{
+  IoEngine::forThread().submit(requests);
+
+  for (IoRequest &request : requests)
+  {
+    if (request.ok && request.usedPage && !request.write
+        && static_cast<const Page *>(request.buf)->page_number() == Page::INVALID_NUMBER)
+      request.ok = false;
+  }
+}
+
+}
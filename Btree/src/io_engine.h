@@ -0,0 +1,176 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <sys/types.h>
+
+namespace badgerdb {
+
+/**
+* @brief A read or a write of a range of bytes of a file descriptor, submitted in a batch.
+*/
+struct IoRequest {
+	/**
+	 * Descriptor of the file
+	 */
+  int fd;
+
+	/**
+	 * Memory to read into or write from
+	 */
+  void *buf;
+
+	/**
+	 * Number of bytes
+	 */
+  std::size_t size;
+
+	/**
+	 * Position in the file
+	 */
+  off_t offset;
+
+	/**
+	 * Whether the request writes
+	 */
+  bool write;
+
+	/**
+	 * Whether a read must give a page in use, as the pages of a PageFile. A free page fails the request
+	 */
+  bool usedPage;
+
+	/**
+	 * Whether the request is complete, e.g. because it was done when queued
+	 */
+  bool done;
+
+	/**
+	 * Whether the request succeeded, once complete
+	 */
+  bool ok;
+};
+
+/**
+* @brief Engine running batches of I/O requests. The io_uring engine queues a whole batch with one system call
+* and reaps the completions from the shared ring without a system call each, so that the device sees up to
+* QUEUE_DEPTH requests at once. Where io_uring is not available, the synchronous engine runs the requests
+* one after the other with pread and pwrite.
+* An engine is used by a single thread; forThread() gives the calling thread its own.
+*/
+class IoEngine
+{
+ public:
+	/**
+	 * Number of requests an engine keeps in flight at most
+	 */
+  static const unsigned QUEUE_DEPTH = 64;
+
+  virtual ~IoEngine() {}
+
+	/**
+	 * Run the requests of a batch which are not complete yet, and wait for all of them. A read past the end
+	 * of the file gives zeros.
+	 *
+	 * @param requests	Requests, marked complete with their outcome on return
+	 */
+  virtual void submit(std::vector<IoRequest> &requests) = 0;
+
+	/**
+	 * Get the engine of the calling thread, created on the first call: io_uring if the kernel supports it,
+	 * synchronous otherwise.
+	 *
+	 * @return  			The engine
+	 */
+  static IoEngine &forThread();
+
+	/**
+	 * Whether the engines created from now on use io_uring when the kernel supports it. True by default.
+	 *
+	 * @param enabled	Whether to use io_uring
+	 */
+  static void setUringEnabled(bool enabled);
+
+	/**
+	 * Run the remaining part of a request synchronously.
+	 *
+	 * @param request	Request
+	 * @param done  	Number of bytes already transferred
+	 * @return  			Whether the request succeeded
+	 */
+  static bool finish(IoRequest &request, std::size_t done);
+};
+
+/**
+* @brief Batch of page reads and writes, filled through the files and run by the engine of the calling thread.
+*/
+class IoBatch
+{
+ private:
+	/**
+	 * Requests queued so far
+	 */
+  std::vector<IoRequest> requests;
+
+ public:
+	/**
+	 * Queue a request.
+	 *
+	 * @param fd      	Descriptor of the file
+	 * @param buf     	Memory to read into or write from
+	 * @param size    	Number of bytes
+	 * @param offset  	Position in the file
+	 * @param write   	Whether the request writes
+	 * @param usedPage	Whether a read must give a page in use
+	 * @return  				Index of the request in the batch
+	 */
+  std::size_t add(int fd, void *buf, std::size_t size, off_t offset, bool write, bool usedPage = false);
+
+	/**
+	 * Queue a request already done, e.g. by a file which cannot defer it.
+	 *
+	 * @param ok  		Whether it succeeded
+	 * @return  			Index of the request in the batch
+	 */
+  std::size_t addDone(bool ok);
+
+	/**
+	 * Run the queued requests and wait for them.
+	 */
+  void submit();
+
+	/**
+	 * Check whether a request succeeded, once the batch is submitted.
+	 *
+	 * @param i  			Index of the request
+	 */
+  bool ok(std::size_t i) const
+  {
+		return requests[i].ok;
+  }
+
+	/**
+	 * Get the number of requests queued.
+	 */
+  std::size_t size() const
+  {
+		return requests.size();
+  }
+
+	/**
+	 * Remove all the requests, to fill the batch again.
+	 */
+  void clear()
+  {
+		requests.clear();
+  }
+};
+
+}
@@ -0,0 +1,169 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace badgerdb {
+
+/**
+* @brief Blocked Bloom filter of the hashes of keys, which tells the keys surely absent from a set without
+* looking at it. The bits of a key all lie in one block of a cache line, so a probe misses the cache once.
+* Keys are added by several threads at once, and never removed: a key deleted from the set stays a false
+* positive. Once more keys are added than the filter is sized for, its false positive rate rises quickly,
+* and it reports itself saturated.
+*/
+class KeyFilter
+{
+ public:
+	/**
+	 * Number of 64-bit words of a block, a cache line
+	 */
+  static constexpr std::size_t BLOCK_WORDS = 8;
+
+	/**
+	 * Constructor of KeyFilter class
+	 *
+	 * @param numKeys 	Number of keys the filter is sized for
+	 * @param bitsPerKey Number of bits per key, 10 giving about 1% false positives
+	 */
+  KeyFilter(std::size_t numKeys, int bitsPerKey)
+    : numBlocks(std::max<std::size_t>(1, (std::max<std::size_t>(numKeys, 1) * bitsPerKey + BLOCK_WORDS * 64 - 1)
+                                         / (BLOCK_WORDS * 64))),
+      numProbes(std::min(std::max(bitsPerKey * 69 / 100, 1), 16)),
+      capacity(numKeys),
+      words(new std::atomic<std::uint64_t>[numBlocks * BLOCK_WORDS]),
+      numAdded(0)
+  {
+		for (std::size_t i = 0; i < numBlocks * BLOCK_WORDS; i++)
+		{
+			words[i].store(0, std::memory_order_relaxed);
+		}
+  }
+
+	/**
+	 * Hash the bytes of a key, with FNV-1a mixed by the finalizer of splitmix64.
+	 *
+	 * @param data  	Bytes of the key
+	 * @param length 	Number of bytes
+	 * @return the hash of the key
+	 */
+  static std::uint64_t hash(const void *data, std::size_t length)
+  {
+		std::uint64_t h = 14695981039346656037ull;
+		for (std::size_t i = 0; i < length; i++)
+		{
+			h = (h ^ ((const unsigned char *)data)[i]) * 1099511628211ull;
+		}
+		h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ull;
+		h = (h ^ (h >> 27)) * 0x94d049bb133111ebull;
+		return h ^ (h >> 31);
+  }
+
+	/**
+	 * Add the hash of a key.
+	 *
+	 * @param h  		Hash of the key
+	 */
+  void add(std::uint64_t h)
+  {
+		std::atomic<std::uint64_t> *block = blockOf(h);
+		for (int i = 0; i < numProbes; i++)
+		{
+			std::uint32_t bit = probe(h, i);
+			block[bit / 64].fetch_or(1ull << (bit % 64), std::memory_order_relaxed);
+		}
+		numAdded.fetch_add(1, std::memory_order_relaxed);
+  }
+
+	/**
+	 * Check whether a key may have been added.
+	 *
+	 * @param h  		Hash of the key
+	 * @return false if the key was surely not added
+	 */
+  bool mayContain(std::uint64_t h) const
+  {
+		const std::atomic<std::uint64_t> *block = blockOf(h);
+		for (int i = 0; i < numProbes; i++)
+		{
+			std::uint32_t bit = probe(h, i);
+			if ((block[bit / 64].load(std::memory_order_relaxed) & (1ull << (bit % 64))) == 0)
+			{
+				return false;
+			}
+		}
+		return true;
+  }
+
+	/**
+	 * Check whether more keys were added than the filter is sized for, which makes it worth rebuilding.
+	 */
+  bool saturated() const
+  {
+		return numAdded.load(std::memory_order_relaxed) > capacity;
+  }
+
+	/**
+	 * Get the number of keys added, counting a key added twice twice.
+	 */
+  std::size_t size() const
+  {
+		return numAdded.load(std::memory_order_relaxed);
+  }
+
+ private:
+	/**
+	 * Find the block of a key, from the high half of its hash.
+	 */
+  std::atomic<std::uint64_t> *blockOf(std::uint64_t h) const
+  {
+		return &words[((h >> 32) * numBlocks >> 32) * BLOCK_WORDS];
+  }
+
+	/**
+	 * Find the i-th bit of a key in its block, by double hashing of the low half of its hash.
+	 */
+  std::uint32_t probe(std::uint64_t h, int i) const
+  {
+		std::uint32_t h1 = (std::uint32_t)h;
+		std::uint32_t h2 = (h1 >> 16 | h1 << 16) | 1;
+		return (h1 + i * h2) % (BLOCK_WORDS * 64);
+  }
+
+	/**
+	 * Number of blocks
+	 */
+  std::size_t numBlocks;
+
+	/**
+	 * Number of bits set per key
+	 */
+  int numProbes;
+
+	/**
+	 * Number of keys the filter is sized for
+	 */
+  std::size_t capacity;
+
+	/**
+	 * Bits of the blocks
+	 */
+  std::unique_ptr<std::atomic<std::uint64_t>[]> words;
+
+	/**
+	 * Number of keys added
+	 */
+  std::atomic<std::size_t> numAdded;
+};
+
+}
@@ -0,0 +1,470 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "bufHashTbl.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace badgerdb
+{
+
+/**
+ * @brief Number of remaining keys at which the binary search hands over to the vectorized count.
+ */
+const int KEYSEARCH_BLOCK = 32;
+
+/**
+ * Count the keys less than (or, if orEqual, less than or equal to) the given value.
+ * Only operator< is required of the key type.
+ * @tparam orEqual Whether to count the keys equal to the value as well
+ * @param keys Keys to count in
+ * @param n Number of keys
+ * @param val A given key value
+ * @return the number of satisfying keys
+ */
+template <bool orEqual, class T>
+inline int countKeysBelow(const T *keys, int n, const T &val)
+{
+  int count = 0;
+  for (int i = 0; i < n; ++i)
+  {
+    count += orEqual ? !(val < keys[i]) : keys[i] < val;
+  }
+  return count;
+}
+
+/**
+ * Count the INTEGER keys less than (or, if orEqual, less than or equal to) the given value.
+ * The loop is vectorized with AVX2 or SSE2 when the compiler targets them.
+ * @tparam orEqual Whether to count the keys equal to the value as well
+ * @param keys Keys to count in
+ * @param n Number of keys
+ * @param val A given key value
+ * @return the number of satisfying keys
+ */
+template <bool orEqual>
+inline int countKeysBelow(const int *keys, int n, const int &val)
+{
+  int count = 0;
+  int i = 0;
+#if defined(__AVX2__)
+  const __m256i v = _mm256_set1_epi32(val);
+  for (; i + 8 <= n; i += 8)
+  {
+    __m256i k = _mm256_loadu_si256((const __m256i *)(keys + i));
+    // keys greater than the value are never counted
+    int gt = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(k, v)));
+    int eq = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(k, v)));
+    count += 8 - __builtin_popcount(gt) - (orEqual ? 0 : __builtin_popcount(eq));
+  }
+#elif defined(__SSE2__)
+  const __m128i v = _mm_set1_epi32(val);
+  for (; i + 4 <= n; i += 4)
+  {
+    __m128i k = _mm_loadu_si128((const __m128i *)(keys + i));
+    // keys greater than the value are never counted
+    int gt = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(k, v)));
+    int eq = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(k, v)));
+    count += 4 - __builtin_popcount(gt) - (orEqual ? 0 : __builtin_popcount(eq));
+  }
+#endif
+  for (; i < n; ++i)
+  {
+    count += orEqual ? keys[i] <= val : keys[i] < val;
+  }
+  return count;
+}
+
+/**
+ * Count the unsigned 16-bit keys less than (or, if orEqual, less than or equal to) the given value,
+ * as the key offsets of packed leaves are. The loop is vectorized with AVX2 or SSE2 when the compiler
+ * targets them, flipping the top bit of the keys to compare them as signed ones.
+ * @tparam orEqual Whether to count the keys equal to the value as well
+ * @param keys Keys to count in
+ * @param n Number of keys
+ * @param val A given key value
+ * @return the number of satisfying keys
+ */
+template <bool orEqual>
+inline int countKeysBelow(const std::uint16_t *keys, int n, const std::uint16_t &val)
+{
+  int count = 0;
+  int i = 0;
+#if defined(__AVX2__)
+  const __m256i flip = _mm256_set1_epi16((short)0x8000);
+  const __m256i v = _mm256_xor_si256(_mm256_set1_epi16((short)val), flip);
+  for (; i + 16 <= n; i += 16)
+  {
+    __m256i k = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(keys + i)), flip);
+    // two mask bits per key
+    int gt = _mm256_movemask_epi8(_mm256_cmpgt_epi16(k, v));
+    int eq = _mm256_movemask_epi8(_mm256_cmpeq_epi16(k, v));
+    count += 16 - (__builtin_popcount(gt) + (orEqual ? 0 : __builtin_popcount(eq))) / 2;
+  }
+#elif defined(__SSE2__)
+  const __m128i flip = _mm_set1_epi16((short)0x8000);
+  const __m128i v = _mm_xor_si128(_mm_set1_epi16((short)val), flip);
+  for (; i + 8 <= n; i += 8)
+  {
+    __m128i k = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(keys + i)), flip);
+    // two mask bits per key
+    int gt = _mm_movemask_epi8(_mm_cmpgt_epi16(k, v));
+    int eq = _mm_movemask_epi8(_mm_cmpeq_epi16(k, v));
+    count += 8 - (__builtin_popcount(gt) + (orEqual ? 0 : __builtin_popcount(eq))) / 2;
+  }
+#endif
+  for (; i < n; ++i)
+  {
+    count += orEqual ? keys[i] <= val : keys[i] < val;
+  }
+  return count;
+}
+
+/**
+ * Count the DOUBLE keys less than (or, if orEqual, less than or equal to) the given value.
+ * The loop is vectorized with AVX2 or SSE2 when the compiler targets them. The ordered comparisons
+ * of doubles agree with those of their normalized keys, negative zero included.
+ * @tparam orEqual Whether to count the keys equal to the value as well
+ * @param keys Keys to count in
+ * @param n Number of keys
+ * @param val A given key value
+ * @return the number of satisfying keys
+ */
+template <bool orEqual>
+inline int countKeysBelow(const double *keys, int n, const double &val)
+{
+  int count = 0;
+  int i = 0;
+#if defined(__AVX2__)
+  const __m256d v = _mm256_set1_pd(val);
+  for (; i + 4 <= n; i += 4)
+  {
+    __m256d k = _mm256_loadu_pd(keys + i);
+    __m256d below = orEqual ? _mm256_cmp_pd(k, v, _CMP_LE_OQ) : _mm256_cmp_pd(k, v, _CMP_LT_OQ);
+    count += __builtin_popcount(_mm256_movemask_pd(below));
+  }
+#elif defined(__SSE2__)
+  const __m128d v = _mm_set1_pd(val);
+  for (; i + 2 <= n; i += 2)
+  {
+    __m128d k = _mm_loadu_pd(keys + i);
+    __m128d below = orEqual ? _mm_cmple_pd(k, v) : _mm_cmplt_pd(k, v);
+    count += __builtin_popcount(_mm_movemask_pd(below));
+  }
+#endif
+  for (; i < n; ++i)
+  {
+    count += orEqual ? keys[i] <= val : keys[i] < val;
+  }
+  return count;
+}
+
+/**
+ * Select the keys within a range, i.e. greater than (or, if lowOrEqual, equal to) the low value and less
+ * than (or, if highOrEqual, equal to) the high value. The positions are written without branching on the
+ * outcome of each key.
+ * @param keys Keys to select from, in any order
+ * @param n Number of keys
+ * @param low Low value
+ * @param lowOrEqual Whether the keys equal to the low value are selected
+ * @param high High value
+ * @param highOrEqual Whether the keys equal to the high value are selected
+ * @param sel Returned positions of the selected keys, in increasing order, room for n of them
+ * @return the number of selected keys
+ */
+template <class T>
+inline int selectKeysInRange(const T *keys, int n, const T &low, bool lowOrEqual, const T &high,
+                             bool highOrEqual, int *sel)
+{
+  int count = 0;
+  for (int i = 0; i < n; ++i)
+  {
+    bool aboveLow = lowOrEqual ? keys[i] >= low : keys[i] > low;
+    bool belowHigh = highOrEqual ? keys[i] <= high : keys[i] < high;
+    sel[count] = i;
+    count += aboveLow && belowHigh;
+  }
+  return count;
+}
+
+/**
+ * Append the positions of the set bits of a mask of compared keys to the selected positions.
+ * @param mask One bit per key, the lowest for the first
+ * @param base Position of the first key
+ * @param sel Selected positions
+ * @param count Number of selected positions, updated
+ */
+inline void appendSelected(unsigned mask, int base, int *sel, int &count)
+{
+  for (; mask != 0; mask &= mask - 1)
+  {
+    sel[count++] = base + __builtin_ctz(mask);
+  }
+}
+
+/**
+ * Select the INTEGER keys within a range.
+ * The comparisons are vectorized with AVX2 or SSE2 when the compiler targets them.
+ * @see selectKeysInRange
+ */
+template <>
+inline int selectKeysInRange<int>(const int *keys, int n, const int &low, bool lowOrEqual, const int &high,
+                                  bool highOrEqual, int *sel)
+{
+  int count = 0;
+  int i = 0;
+#if defined(__AVX2__)
+  // the inclusive bounds are made exclusive by moving them out by one, unless that overflows
+  if ((!lowOrEqual || low != INT_MIN) && (!highOrEqual || high != INT_MAX))
+  {
+    const __m256i lo = _mm256_set1_epi32(lowOrEqual ? low - 1 : low);
+    const __m256i hi = _mm256_set1_epi32(highOrEqual ? high + 1 : high);
+    for (; i + 8 <= n; i += 8)
+    {
+      __m256i k = _mm256_loadu_si256((const __m256i *)(keys + i));
+      __m256i in = _mm256_and_si256(_mm256_cmpgt_epi32(k, lo), _mm256_cmpgt_epi32(hi, k));
+      appendSelected(_mm256_movemask_ps(_mm256_castsi256_ps(in)), i, sel, count);
+    }
+  }
+#elif defined(__SSE2__)
+  // the inclusive bounds are made exclusive by moving them out by one, unless that overflows
+  if ((!lowOrEqual || low != INT_MIN) && (!highOrEqual || high != INT_MAX))
+  {
+    const __m128i lo = _mm_set1_epi32(lowOrEqual ? low - 1 : low);
+    const __m128i hi = _mm_set1_epi32(highOrEqual ? high + 1 : high);
+    for (; i + 4 <= n; i += 4)
+    {
+      __m128i k = _mm_loadu_si128((const __m128i *)(keys + i));
+      __m128i in = _mm_and_si128(_mm_cmpgt_epi32(k, lo), _mm_cmplt_epi32(k, hi));
+      appendSelected(_mm_movemask_ps(_mm_castsi128_ps(in)), i, sel, count);
+    }
+  }
+#endif
+  for (; i < n; ++i)
+  {
+    bool aboveLow = lowOrEqual ? keys[i] >= low : keys[i] > low;
+    bool belowHigh = highOrEqual ? keys[i] <= high : keys[i] < high;
+    sel[count] = i;
+    count += aboveLow && belowHigh;
+  }
+  return count;
+}
+
+/**
+ * Select the DOUBLE keys within a range.
+ * The comparisons are vectorized with AVX2 or SSE2 when the compiler targets them.
+ * @see selectKeysInRange
+ */
+template <>
+inline int selectKeysInRange<double>(const double *keys, int n, const double &low, bool lowOrEqual,
+                                     const double &high, bool highOrEqual, int *sel)
+{
+  int count = 0;
+  int i = 0;
+#if defined(__AVX2__)
+  const __m256d lo = _mm256_set1_pd(low);
+  const __m256d hi = _mm256_set1_pd(high);
+  for (; i + 4 <= n; i += 4)
+  {
+    __m256d k = _mm256_loadu_pd(keys + i);
+    __m256d aboveLow = lowOrEqual ? _mm256_cmp_pd(k, lo, _CMP_GE_OQ) : _mm256_cmp_pd(k, lo, _CMP_GT_OQ);
+    __m256d belowHigh = highOrEqual ? _mm256_cmp_pd(k, hi, _CMP_LE_OQ) : _mm256_cmp_pd(k, hi, _CMP_LT_OQ);
+    appendSelected(_mm256_movemask_pd(_mm256_and_pd(aboveLow, belowHigh)), i, sel, count);
+  }
+#elif defined(__SSE2__)
+  const __m128d lo = _mm_set1_pd(low);
+  const __m128d hi = _mm_set1_pd(high);
+  for (; i + 2 <= n; i += 2)
+  {
+    __m128d k = _mm_loadu_pd(keys + i);
+    __m128d aboveLow = lowOrEqual ? _mm_cmpge_pd(k, lo) : _mm_cmpgt_pd(k, lo);
+    __m128d belowHigh = highOrEqual ? _mm_cmple_pd(k, hi) : _mm_cmplt_pd(k, hi);
+    appendSelected(_mm_movemask_pd(_mm_and_pd(aboveLow, belowHigh)), i, sel, count);
+  }
+#endif
+  for (; i < n; ++i)
+  {
+    bool aboveLow = lowOrEqual ? keys[i] >= low : keys[i] > low;
+    bool belowHigh = highOrEqual ? keys[i] <= high : keys[i] < high;
+    sel[count] = i;
+    count += aboveLow && belowHigh;
+  }
+  return count;
+}
+
+/**
+ * Find the position of the first key not satisfying key < val (or key <= val if orEqual)
+ * in the sorted keys. A branch-free binary search narrows the range down to
+ * KEYSEARCH_BLOCK keys, which are then counted by countKeysBelow.
+ * @tparam orEqual Whether to skip the keys equal to the value as well
+ * @param keys Sorted keys to search in
+ * @param n Number of keys
+ * @param val A given key value
+ * @return the position, between 0 and n
+ */
+template <bool orEqual, class T>
+inline int searchKeys(const T *keys, int n, const T &val)
+{
+  // the position always lies within [base, base + n]
+  const T *base = keys;
+  while (n > KEYSEARCH_BLOCK)
+  {
+    int half = n >> 1;
+    base += (orEqual ? !(val < base[half]) : base[half] < val) ? half : 0;
+    n -= half;
+  }
+  return (int)(base - keys) + countKeysBelow<orEqual>(base, n, val);
+}
+
+/**
+ * @brief Keys filling a cache line, aligned on it.
+ */
+template <class T>
+struct alignas(CACHE_LINE_SIZE) KeyLine
+{
+  static const int NUM_KEYS = CACHE_LINE_SIZE / sizeof(T) > 0 ? (int)(CACHE_LINE_SIZE / sizeof(T)) : 1;
+
+  T keys[NUM_KEYS];
+};
+
+/**
+ * @brief Sorted array of INTEGER or DOUBLE keys laid out for searching it a cache line at a time.
+ * The keys are stored in cache lines, and each level of the directory above them holds the last key of
+ * every line of the level below, up to a top level that fits a single line. A search counts the keys below
+ * the value in one line per level, so it touches a few cache lines of a large array, where a binary search
+ * would touch one per halving, scattered over the array.
+ */
+template <class T>
+class KeyDirectory
+{
+ public:
+  static const int LINE_KEYS = KeyLine<T>::NUM_KEYS;
+
+  /**
+   * Lay out sorted keys.
+   * @param keys Sorted keys
+   */
+  explicit KeyDirectory(const std::vector<T> &keys)
+  {
+    sizes.push_back((int)keys.size());
+    levels.emplace_back((keys.size() + LINE_KEYS - 1) / LINE_KEYS);
+    for (std::size_t i = 0; i < keys.size(); ++i)
+    {
+      levels[0][i / LINE_KEYS].keys[i % LINE_KEYS] = keys[i];
+    }
+    while (sizes.back() > LINE_KEYS)
+    {
+      // the last key of each line of the level below
+      const std::vector<KeyLine<T>> &below = levels.back();
+      int numLines = (int)below.size();
+      int size = sizes.back();
+      std::vector<KeyLine<T>> level((numLines + LINE_KEYS - 1) / LINE_KEYS);
+      for (int i = 0; i < numLines; ++i)
+      {
+        int last = std::min((i + 1) * LINE_KEYS, size) - 1;
+        level[i / LINE_KEYS].keys[i % LINE_KEYS] = below[last / LINE_KEYS].keys[last % LINE_KEYS];
+      }
+      levels.push_back(std::move(level));
+      sizes.push_back(numLines);
+    }
+  }
+
+  /**
+   * Get the number of keys.
+   */
+  int size() const
+  {
+    return sizes[0];
+  }
+
+  /**
+   * Get the i-th key.
+   * @param i Position of the key
+   */
+  const T &key(int i) const
+  {
+    return levels[0][i / LINE_KEYS].keys[i % LINE_KEYS];
+  }
+
+  /**
+   * Find the position of the first key not satisfying key < val (or key <= val if orEqual), as searchKeys does.
+   * @tparam orEqual Whether to skip the keys equal to the value as well
+   * @param val A given key value
+   * @return the position, between 0 and size()
+   */
+  template <bool orEqual>
+  int search(const T &val) const
+  {
+    if (sizes[0] == 0)
+    {
+      return 0;
+    }
+    // the number of lines of a level below the value is that of their last keys in the level above
+    int top = (int)levels.size() - 1;
+    int pos = countKeysBelow<orEqual>(levels[top][0].keys, sizes[top], val);
+    for (int l = top - 1; l >= 0; --l)
+    {
+      int first = pos * LINE_KEYS;
+      pos = first >= sizes[l] ? sizes[l]
+          : first + countKeysBelow<orEqual>(levels[l][pos].keys, std::min(LINE_KEYS, sizes[l] - first), val);
+    }
+    return pos;
+  }
+
+ private:
+  /**
+   * Levels of lines, the keys first and the top level last.
+   */
+  std::vector<std::vector<KeyLine<T>>> levels;
+
+  /**
+   * Number of keys of each level.
+   */
+  std::vector<int> sizes;
+};
+
+template <class T>
+const int KeyDirectory<T>::LINE_KEYS;
+
+/**
+ * Find the position of the first key at least (GTE) the given value in the sorted keys.
+ * @param keys Sorted keys to search in
+ * @param n Number of keys
+ * @param val A given key value
+ * @return the position, between 0 and n
+ */
+template <class T>
+inline int lowerBoundKey(const T *keys, int n, const T &val)
+{
+  return searchKeys<false>(keys, n, val);
+}
+
+/**
+ * Find the position of the first key greater than (GT) the given value in the sorted keys.
+ * @param keys Sorted keys to search in
+ * @param n Number of keys
+ * @param val A given key value
+ * @return the position, between 0 and n
+ */
+template <class T>
+inline int upperBoundKey(const T *keys, int n, const T &val)
+{
+  return searchKeys<true>(keys, n, val);
+}
+
+}
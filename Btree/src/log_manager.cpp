@@ -0,0 +1,342 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "log_manager.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <fcntl.h>
+#include <map>
+#include <memory>
+#include <set>
+#include <unistd.h>
+
+#include "exceptions/file_io_exception.h"
+#include "exceptions/file_open_exception.h"
+
+namespace badgerdb {
+
+const std::uint64_t LogManager::MAGIC;
+const std::size_t LogManager::HEADER_SIZE;
+const std::uint8_t LogManager::PAGE_DELTA;
+const std::size_t LogManager::MERGE_WORDS;
+const std::size_t LogManager::MAX_NAME_LENGTH;
+
+/**
+ * FNV-1a hash of bytes, the checksum of the log records.
+ */
+static std::uint32_t checksum(const char *bytes, std::size_t size)
+{
+  std::uint32_t hash = 2166136261u;
+  for (std::size_t i = 0; i < size; i++)
+    hash = (hash ^ (std::uint8_t)bytes[i]) * 16777619u;
+  return hash;
+}
+
+/**
+ * Write bytes at a position of a file, retrying short writes.
+ */
+static bool writeFully(int fd, const char *bytes, std::size_t size, off_t offset)
+{
+  while (size > 0)
+  {
+    ssize_t n = ::pwrite(fd, bytes, size, offset);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    bytes += n;
+    size -= n;
+    offset += n;
+  }
+  return true;
+}
+
+LogManager::LogManager(const std::string &logName)
+  : name(logName), flushing(false), numSyncs(0), numRecovered(0)
+{
+  fd = ::open(name.c_str(), O_RDWR | O_CREAT, 0644);
+  if (fd < 0)
+    throw FileOpenException(name);
+
+  if (::pread(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header) || header.magic != MAGIC)
+  {
+    // a new log
+    header.magic = MAGIC;
+    header.startLsn = header.redoLsn = 1;
+    if (::ftruncate(fd, HEADER_SIZE) != 0)
+      throw FileOpenException(name);
+    writeHeader();
+  }
+  endLsn = flushedLsn = header.startLsn;
+  numRecovered = recover();
+}
+
+LogManager::~LogManager()
+{
+  flush(getEndLsn());
+  ::close(fd);
+}
+
+void LogManager::writeHeader()
+{
+  writeFully(fd, reinterpret_cast<const char *>(&header), sizeof(header), 0);
+  ::fdatasync(fd);
+}
+
+int LogManager::recover()
+{
+  off_t size = ::lseek(fd, 0, SEEK_END);
+  std::vector<char> bytes(size > position(header.redoLsn) ? size - position(header.redoLsn) : 0);
+  std::size_t numRead = 0;
+  while (numRead < bytes.size())
+  {
+    ssize_t n = ::pread(fd, bytes.data() + numRead, bytes.size() - numRead, position(header.redoLsn) + numRead);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      break;
+    numRead += n;
+  }
+
+  // the pages are rebuilt in memory, from their images on disk, and written back once all are replayed
+  std::map<std::string, std::unique_ptr<BlobFile>> openFiles;
+  std::map<std::pair<File*, PageId>, Page> pages;
+  int numReplayed = 0;
+  std::size_t pos = 0;
+  while (pos + sizeof(LogRecordHeader) <= numRead)
+  {
+    // the log ends at the first record torn by a crash
+    LogRecordHeader recordHeader;
+    std::memcpy(&recordHeader, bytes.data() + pos, sizeof(recordHeader));
+    if (recordHeader.length < sizeof(recordHeader) || recordHeader.length > numRead - pos
+        || recordHeader.type != PAGE_DELTA
+        || recordHeader.checksum != checksum(bytes.data() + pos + offsetof(LogRecordHeader, type),
+                                             recordHeader.length - offsetof(LogRecordHeader, type)))
+      break;
+
+    const char *record = bytes.data() + pos;
+    const char *end = record + recordHeader.length;
+    pos += recordHeader.length;
+    std::string fileName(record + sizeof(recordHeader), recordHeader.nameLength);
+    const char *range = record + sizeof(recordHeader) + recordHeader.nameLength;
+
+    auto found = openFiles.find(fileName);
+    if (found == openFiles.end())
+    {
+      std::unique_ptr<BlobFile> file;
+      if (File::exists(fileName))
+        file.reset(new BlobFile(fileName, false));
+      found = openFiles.emplace(fileName, std::move(file)).first;
+    }
+    if (found->second == nullptr)
+      continue;
+
+    std::pair<File*, PageId> key(found->second.get(), recordHeader.pageNo);
+    auto page = pages.find(key);
+    if (page == pages.end())
+    {
+      page = pages.emplace(key, Page()).first;
+      found->second->readPageInto(recordHeader.pageNo, page->second);
+    }
+    char *pageBytes = reinterpret_cast<char *>(&page->second);
+    for (std::uint16_t i = 0; i < recordHeader.numRanges && range + sizeof(LogRange) <= end; i++)
+    {
+      LogRange logRange;
+      std::memcpy(&logRange, range, sizeof(logRange));
+      range += sizeof(logRange);
+      std::memcpy(pageBytes + logRange.offset, range, logRange.length);
+      range += logRange.length;
+    }
+    numReplayed++;
+  }
+
+  // the headers are made consistent with the pages written while the free chains are still intact on disk,
+  // then the files are extended to the pages written, and synced along with their headers
+  std::map<File*, std::set<PageId>> written;
+  for (auto &page : pages)
+    written[page.first.first].insert(page.first.second);
+  for (auto &file : openFiles)
+  {
+    if (file.second != nullptr && written.count(file.second.get()) != 0)
+      file.second->recoverHeader(written[file.second.get()]);
+  }
+  for (auto &page : pages)
+    page.first.first->writePageFrom(page.first.second, page.second);
+  for (auto &file : openFiles)
+  {
+    if (file.second != nullptr)
+      file.second->sync();
+  }
+
+  // the log is emptied, its records being reflected in their files
+  header.startLsn = header.redoLsn = header.redoLsn + pos;
+  endLsn = flushedLsn = header.startLsn;
+  if (::ftruncate(fd, HEADER_SIZE) != 0)
+    throw FileOpenException(name);
+  writeHeader();
+  return numReplayed;
+}
+
+void LogManager::attach(File *file)
+{
+  if (file->filename().size() > MAX_NAME_LENGTH)
+    throw FileIoException(file->filename(), "attach", ENAMETOOLONG);
+  std::lock_guard<std::mutex> lock(mutex);
+  files.insert(file);
+}
+
+void LogManager::detach(File *file)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  files.erase(file);
+}
+
+bool LogManager::isAttached(const File *file) const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return files.count(const_cast<File*>(file)) != 0;
+}
+
+std::vector<File*> LogManager::attachedFiles() const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return std::vector<File*>(files.begin(), files.end());
+}
+
+Lsn LogManager::logPage(const File *file, PageId pageNo, Page &logged, const Page &page, bool whole)
+{
+  // find the ranges of changed 8-byte words, merging those a few unchanged words apart
+  char *before = reinterpret_cast<char *>(&logged);
+  const char *after = reinterpret_cast<const char *>(&page);
+  const std::size_t numWords = Page::SIZE / sizeof(std::uint64_t);
+  auto changed = [&](std::size_t w)
+  {
+    return whole || std::memcmp(before + w * sizeof(std::uint64_t), after + w * sizeof(std::uint64_t),
+                                sizeof(std::uint64_t)) != 0;
+  };
+  std::vector<LogRange> ranges;
+  std::size_t size = 0;
+  for (std::size_t w = 0; w < numWords; w++)
+  {
+    if (!changed(w))
+      continue;
+    std::size_t last = w;
+    for (std::size_t v = w + 1; v < numWords && v - last <= MERGE_WORDS; v++)
+    {
+      if (changed(v))
+        last = v;
+    }
+    ranges.push_back(LogRange{(std::uint16_t)(w * sizeof(std::uint64_t)),
+                              (std::uint16_t)((last + 1 - w) * sizeof(std::uint64_t))});
+    size += sizeof(LogRange) + ranges.back().length;
+    w = last;
+  }
+  if (ranges.empty())
+    return 0;
+
+  // the record is built, and the logged image brought up to date
+  const std::string &fileName = file->filename();
+  LogRecordHeader recordHeader;
+  recordHeader.nameLength = (std::uint8_t)fileName.size();
+  recordHeader.length = sizeof(recordHeader) + recordHeader.nameLength + size;
+  recordHeader.type = PAGE_DELTA;
+  recordHeader.numRanges = ranges.size();
+  recordHeader.pageNo = pageNo;
+  std::vector<char> record(recordHeader.length);
+  char *out = record.data() + sizeof(recordHeader);
+  std::memcpy(out, fileName.data(), recordHeader.nameLength);
+  out += recordHeader.nameLength;
+  for (const LogRange &range : ranges)
+  {
+    std::memcpy(out, &range, sizeof(range));
+    out += sizeof(range);
+    std::memcpy(out, after + range.offset, range.length);
+    std::memcpy(before + range.offset, after + range.offset, range.length);
+    out += range.length;
+  }
+  std::memcpy(record.data(), &recordHeader, sizeof(recordHeader));
+  recordHeader.checksum = checksum(record.data() + offsetof(LogRecordHeader, type),
+                                   recordHeader.length - offsetof(LogRecordHeader, type));
+  std::memcpy(record.data(), &recordHeader, sizeof(recordHeader));
+
+  std::lock_guard<std::mutex> lock(mutex);
+  buffer.insert(buffer.end(), record.begin(), record.end());
+  endLsn += record.size();
+  return endLsn;
+}
+
+void LogManager::flush(Lsn lsn)
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  while (flushedLsn < std::min(lsn, endLsn))
+  {
+    if (flushing)
+    {
+      flushDone.wait(lock);
+      continue;
+    }
+
+    // this thread writes the records appended so far, those of the threads waiting for it included
+    flushing = true;
+    std::vector<char> records;
+    records.swap(buffer);
+    Lsn end = endLsn;
+    off_t offset = position(end - records.size());
+    lock.unlock();
+    bool written = writeFully(fd, records.data(), records.size(), offset) && ::fdatasync(fd) == 0;
+    lock.lock();
+    flushing = false;
+    if (written)
+    {
+      flushedLsn = end;
+      numSyncs++;
+    }
+    else
+    {
+      // the records are appended again, ahead of those appended meanwhile, for the next flush to retry
+      buffer.insert(buffer.begin(), records.begin(), records.end());
+    }
+    flushDone.notify_all();
+    if (!written)
+      throw FileOpenException(name);
+  }
+}
+
+void LogManager::checkpoint(Lsn redoLsn)
+{
+  flush(getEndLsn());
+
+  // no record is appended while the header is written, so that emptying the log loses none
+  std::lock_guard<std::mutex> lock(mutex);
+  header.redoLsn = std::min(redoLsn, endLsn);
+  if (header.redoLsn == endLsn && buffer.empty() && !flushing && ::ftruncate(fd, HEADER_SIZE) == 0)
+    header.startLsn = endLsn;
+  writeHeader();
+}
+
+Lsn LogManager::getEndLsn() const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return endLsn;
+}
+
+Lsn LogManager::getFlushedLsn() const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return flushedLsn;
+}
+
+std::uint64_t LogManager::getNumSyncs() const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return numSyncs;
+}
+
+}
@@ -0,0 +1,321 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "file.h"
+
+namespace badgerdb {
+
+/**
+* @brief Log sequence number: the position in the log of the end of a record, counted in bytes from 1 when the log
+* was created. 0 is no record.
+*/
+typedef std::uint64_t Lsn;
+
+/**
+* @brief Header of the log file, in its first bytes.
+*/
+struct LogHeader
+{
+	/**
+   * LogManager::MAGIC, telling a log file
+	 */
+  std::uint64_t magic;
+
+	/**
+   * Number of the first byte of the records in the file, kept in the file after the header
+	 */
+  Lsn startLsn;
+
+	/**
+   * Number of the first byte of the records that recovery replays. The pages changed by the records before it
+   * were synced to their files by the last checkpoint
+	 */
+  Lsn redoLsn;
+};
+
+/**
+* @brief Header of a log record. The header is followed by the name of the file of the page, and by the ranges
+* of bytes of the page the record changes, each a LogRange followed by the bytes.
+*/
+struct LogRecordHeader
+{
+	/**
+   * Number of bytes of the record, header included
+	 */
+  std::uint32_t length;
+
+	/**
+   * Checksum of the bytes of the record after it, telling a record torn by a crash
+	 */
+  std::uint32_t checksum;
+
+	/**
+   * Type of the record, LogManager::PAGE_DELTA
+	 */
+  std::uint8_t type;
+
+	/**
+   * Number of bytes of the file name
+	 */
+  std::uint8_t nameLength;
+
+	/**
+   * Number of ranges of bytes
+	 */
+  std::uint16_t numRanges;
+
+	/**
+   * Number of the page in the file
+	 */
+  PageId pageNo;
+};
+
+/**
+* @brief Range of bytes of a page changed by a log record.
+*/
+struct LogRange
+{
+	/**
+   * Position of the first byte in the page
+	 */
+  std::uint16_t offset;
+
+	/**
+   * Number of bytes
+	 */
+  std::uint16_t length;
+};
+
+/**
+* @brief Write-ahead log of the changes of the pages of the files attached to it. The buffer manager logs
+* the bytes of a page that changed since it was last logged, as the after-image of a page delta record,
+* and forces the log up to the last record of a page before the page is written to its file. A commit
+* then only forces the log, and the records of the threads committing meanwhile are written and synced
+* together, by the first of them. Opening a log replays the records since the last checkpoint into their
+* files, which redoes the changes lost with the pool by a crash.
+*
+* Page delta records are after-images, so replaying them again is harmless, and pages need no LSN of
+* their own: the nodes of an index fill their whole pages.
+*/
+class LogManager
+{
+ public:
+	/**
+   * Magic number of a log file
+	 */
+  static const std::uint64_t MAGIC = 0x4c4f475245444f31ull;
+
+	/**
+   * Size of the log file header, the records being appended after it
+	 */
+  static const std::size_t HEADER_SIZE = 4096;
+
+	/**
+   * Type of the records of the changed bytes of a page
+	 */
+  static const std::uint8_t PAGE_DELTA = 1;
+
+	/**
+   * Number of unchanged 8-byte words below which two ranges of changed bytes are logged as one, since a
+   * range costs a LogRange
+	 */
+  static const std::size_t MERGE_WORDS = 2;
+
+	/**
+   * Maximum number of bytes of the name of a file attached, which its records hold in full
+	 */
+  static const std::size_t MAX_NAME_LENGTH = 255;
+
+ private:
+	/**
+   * Name of the log file
+	 */
+  std::string name;
+
+	/**
+   * Descriptor of the log file
+	 */
+  int fd;
+
+	/**
+   * Header of the log file, as last written
+	 */
+  LogHeader header;
+
+	/**
+   * Serializes the appends, the flushes and the attachments
+	 */
+  mutable std::mutex mutex;
+
+	/**
+   * Signals the end of a flush to the threads waiting for it
+	 */
+  std::condition_variable flushDone;
+
+	/**
+   * Records appended and not written yet, ending at endLsn
+	 */
+  std::vector<char> buffer;
+
+	/**
+   * End of the last record appended, and of the last one written and synced
+	 */
+  Lsn endLsn, flushedLsn;
+
+	/**
+   * Whether a thread is writing records, the others waiting for it
+	 */
+  bool flushing;
+
+	/**
+   * Number of times records were synced to the log file
+	 */
+  std::uint64_t numSyncs;
+
+	/**
+   * Number of page delta records replayed when the log was opened
+	 */
+  int numRecovered;
+
+	/**
+   * Files whose pages are logged
+	 */
+  std::set<File*> files;
+
+	/**
+	 * Get the position in the log file of a byte of the records.
+	 *
+	 * @param lsn 	Number of the byte
+	 * @return the position
+	 */
+  off_t position(Lsn lsn) const
+  {
+		return HEADER_SIZE + (lsn - header.startLsn);
+  }
+
+	/**
+	 * Write the header of the log file and sync the file.
+	 */
+  void writeHeader();
+
+	/**
+	 * Replay the records since the last checkpoint into their files, sync the files and empty the log.
+	 *
+	 * @return the number of records replayed
+	 */
+  int recover();
+
+ public:
+	/**
+	 * Open a log file, creating it if it does not exist, and replay its records since the last checkpoint into
+	 * their files, which must not be opened yet. The records of a file which no longer exists are skipped.
+	 *
+	 * @param logName	Name of the log file
+	 */
+  explicit LogManager(const std::string &logName);
+
+	/**
+	 * Write and sync the records not synced yet, and close the log file.
+	 */
+  ~LogManager();
+
+	/**
+	 * Log the changes of the pages of a file from now on. The file must have been synced, so that its pages on
+	 * disk are those the records are replayed onto.
+	 *
+	 * @param file 	File
+	 * @throws FileIoException with ENAMETOOLONG If the name of the file is longer than MAX_NAME_LENGTH, as
+	 * 							recovery would not find the file again
+	 */
+  void attach(File *file);
+
+	/**
+	 * Stop logging the changes of the pages of a file, once it has been flushed and synced.
+	 *
+	 * @param file 	File
+	 */
+  void detach(File *file);
+
+	/**
+	 * Check whether the changes of the pages of a file are logged.
+	 *
+	 * @param file 	File
+	 * @return whether it is attached
+	 */
+  bool isAttached(const File *file) const;
+
+	/**
+	 * Get the files attached.
+	 *
+	 * @return the files
+	 */
+  std::vector<File*> attachedFiles() const;
+
+	/**
+	 * Append a page delta record of the bytes of a page which differ from its image as last logged, and update
+	 * that image. Nothing is appended if no byte differs.
+	 *
+	 * @param file 	File of the page
+	 * @param pageNo	Number of the page in the file
+	 * @param logged	Image of the page as last logged, or as on disk when loaded
+	 * @param page 	Page
+	 * @param whole 	Whether to log all the bytes of the page, whose image on disk is unknown
+	 * @return the LSN of the record, 0 if none was appended
+	 */
+  Lsn logPage(const File *file, PageId pageNo, Page &logged, const Page &page, bool whole);
+
+	/**
+	 * Write and sync the records up to a LSN, unless they already are. If another thread is writing records,
+	 * the caller waits for it, and then writes all those appended meanwhile, its own and those of other
+	 * threads waiting: a single sync commits them all.
+	 *
+	 * @param lsn 	LSN of the last record to sync, beyond the end to sync them all
+	 */
+  void flush(Lsn lsn);
+
+	/**
+	 * Record a checkpoint: the pages changed by the records before a LSN are synced to their files, and
+	 * recovery starts from it. The log file is emptied if no record follows it.
+	 *
+	 * @param redoLsn	LSN of the first byte to replay
+	 */
+  void checkpoint(Lsn redoLsn);
+
+	/**
+	 * Get the LSN of the end of the last record appended.
+	 */
+  Lsn getEndLsn() const;
+
+	/**
+	 * Get the LSN of the end of the last record synced.
+	 */
+  Lsn getFlushedLsn() const;
+
+	/**
+	 * Get the number of times records were synced to the log file.
+	 */
+  std::uint64_t getNumSyncs() const;
+
+	/**
+	 * Get the number of page delta records replayed when the log was opened.
+	 */
+  int getNumRecovered() const
+  {
+		return numRecovered;
+  }
+};
+
+}
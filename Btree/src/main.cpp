@@ -5,8 +5,21 @@
  * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
  */
 
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 #include "btree.h"
+#include "art_index.h"
+#include "partitioned_index.h"
+#include "index_join.h"
+#include "normalized_key.h"
 #include "page.h"
 #include "filescan.h"
 #include "page_iterator.h"
@@ -17,8 +30,16 @@
 #include "exceptions/no_such_key_found_exception.h"
 #include "exceptions/bad_scanrange_exception.h"
 #include "exceptions/bad_opcodes_exception.h"
+#include "exceptions/bad_index_info_exception.h"
 #include "exceptions/scan_not_initialized_exception.h"
 #include "exceptions/end_of_file_exception.h"
+#include "exceptions/index_read_only_exception.h"
+#include "exceptions/page_pinned_exception.h"
+#include "exceptions/buffer_exceeded_exception.h"
+#include "exceptions/file_io_exception.h"
+#include "exceptions/hash_already_present_exception.h"
+#include "exceptions/hash_not_found_exception.h"
+#include "exceptions/invalid_page_exception.h"
 
 #define checkPassFail(a, b) 																				\
 {																																		\
@@ -70,6 +91,11 @@ void createRelationNegative();//Forward
 void createRelationForwardSize(int size);
 void createRelationBackwardGap(int size);
 void createRelationForwardRange(int lower, int upper);
+void downgradeLayout(const std::string &fileName);
+void createLegacyIndex(const std::string &indexName, int attrByteOffset);
+void insertRelationRandom(BTreeIndex *index, int size, int attrByteOffset = offsetof(tuple,i));
+void insertPathsRandom(BTreeIndex *index, const char *table, int size);
+void insertHotKeysRandom(BTreeIndex *index, int size, int numKeys, int attrByteOffset = offsetof(tuple,i));
 void intTests();
 void intTest1();
 void intTest2();
@@ -77,7 +103,33 @@ void intTest3();
 void intTest4();
 void intTest5();
 void intTest6();
+void intTest7();
+void intTest8();
+void intTest9();
+void intTest10();
+void intTest11();
+void intTest12();
+void intTest13();
+void intTest14();
 int intScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp);
+int hotKeyScan(BTreeIndex *index, const void *lowVal, const void *highVal, int attrByteOffset);
+int deleteEntries(BTreeIndex *index, const void *lowVal, const void *highVal, int step, int attrByteOffset);
+int concurrentEntries(BTreeIndex *index, Datatype type, int numEntries);
+int concurrentScan(BTreeCursor *cursor, Datatype type, int numEntries, int &numKept);
+void doubleTests();
+int doubleScan(BTreeIndex *index, double lowVal, Operator lowOp, double highVal, Operator highOp);
+void stringTests();
+void doubleTest1();
+void stringTest1();
+int stringScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp);
+int stringLookup(BTreeIndex *index, int lowVal, int highVal);
+void stringTest2();
+void stringTest3();
+void stringTest4();
+void stringTest5();
+std::string pathKey(const char *table, int i);
+int pathScan(BTreeIndex *index, const std::string &lowVal, Operator lowOp, const std::string &highVal, Operator highOp);
+int pathLookup(BTreeIndex *index, const char *table, int lowVal, int highVal);
 void indexTests();
 void indexTest1();
 void indexTest2();
@@ -85,6 +137,17 @@ void indexTest3();
 void indexTest4();
 void indexTest5();
 void indexTest6();
+void indexTest7();
+void indexTest8();
+void indexTest9();
+void indexTest10();
+void indexTest11();
+void indexTest12();
+void indexTest13();
+void indexTest14();
+void indexTest15();
+void indexTest16();
+void indexTest17();
 void test1();
 void test2();
 void test3();
@@ -94,6 +157,84 @@ void test6();
 void test7();
 void test8();
 void test9();
+void test10();
+void test11();
+void test12();
+void test13();
+void test14();
+void test15();
+void test16();
+void test17();
+void test18();
+void test19();
+void test20();
+void test21();
+void test22();
+void test23();
+void test24();
+void test25();
+void test26();
+void test27();
+void test28();
+void test29();
+int coldScanReads(int highVal, int &numFound);
+void test30();
+void test31();
+void test32();
+void test33();
+void test34();
+int filteredScan(Datatype type, const void *lowVal, Operator lowOp, const void *highVal, Operator highOp);
+void test35();
+int coveringScan(BTreeIndex *index, Datatype type);
+void test36();
+int bitmapFetch(const RidBitmap &rids, int lowVal, int highVal);
+void test37();
+void createRelationComposite();
+int compositeScan(BTreeIndex *index, const void *const *values, int numValues);
+void test38();
+template <class T>
+bool normalizedOrder(const T *values, int n);
+void test39();
+void test40();
+void test41();
+template <class T>
+bool directorySearch(int numKeys);
+void test42();
+void test43();
+void test44();
+void copyFile(const std::string &from, const std::string &to);
+long fileSize(const std::string &name);
+void test45();
+void test46();
+void test47();
+void test48();
+void test49();
+void test50();
+void test51();
+void test52();
+void test53();
+void test54();
+void test55();
+void test56();
+void test57();
+void test58();
+void test59();
+void test60();
+void test61();
+void test62();
+void test63();
+void test64();
+void test65();
+void test66();
+void test67();
+void test68();
+void test69();
+void test70();
+void test71();
+void test72();
+void test73();
+void test74();
+void test75();
 void errorTests();
 void deleteRelation();
 
@@ -165,6 +306,72 @@ int main(int argc, char **argv)
 	test7();
 	test8();
 	test9();
+	test10();
+	test11();
+	test12();
+	test13();
+	test14();
+	test15();
+	test16();
+	test17();
+	test18();
+	test19();
+	test20();
+	test21();
+	test22();
+	test23();
+	test24();
+	test25();
+	test26();
+	test27();
+	test28();
+	test29();
+	test30();
+	test31();
+	test32();
+	test33();
+	test34();
+	test35();
+	test36();
+	test37();
+	test38();
+	test39();
+	test40();
+	test41();
+	test42();
+	test43();
+	test44();
+	test45();
+	test46();
+	test47();
+	test48();
+	test49();
+	test50();
+	test51();
+	test52();
+	test53();
+	test54();
+	test55();
+	test56();
+	test57();
+	test58();
+	test59();
+	test60();
+	test61();
+	test62();
+	test63();
+	test64();
+	test65();
+	test66();
+	test67();
+	test68();
+	test69();
+	test70();
+	test71();
+	test72();
+	test73();
+	test74();
+	test75();
 	errorTests();
 
 	delete bufMgr;
@@ -260,554 +467,5441 @@ void test9()
     deleteRelation();
 }
 
+void test10()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Bulk load half full" << std::endl;
+    createRelationRandom();
+    indexTest7();
+    deleteRelation();
+}
+
+void test11()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Insert into empty index" << std::endl;
+    createRelationForwardSize(0);
+    indexTest8();
+    deleteRelation();
+}
+
+void test12()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Point lookups" << std::endl;
+    createRelationRandom();
+    indexTest9();
+    deleteRelation();
+}
+
+void test13()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Concurrent scan cursors" << std::endl;
+    createRelationRandom();
+    indexTest10();
+    deleteRelation();
+}
+
+void test14()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Batched scans" << std::endl;
+    createRelationRandom();
+    indexTest11();
+    deleteRelation();
+}
+
+void test15()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Insert into empty double index" << std::endl;
+    createRelationForwardSize(0);
+    indexTest12();
+    deleteRelation();
+}
+
+void test16()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Insert into empty string index" << std::endl;
+    createRelationForwardSize(0);
+    indexTest13();
+    deleteRelation();
+}
+
+void test17()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Long string keys sharing prefixes" << std::endl;
+    createRelationForwardSize(0);
+    insertPathsRandom(nullptr, "events", 5000);
+    indexTest14();
+    deleteRelation();
+}
+
+void test18()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Hot duplicate keys" << std::endl;
+    createRelationForwardSize(0);
+    insertHotKeysRandom(nullptr, 20000, 4);
+    indexTest15();
+    deleteRelation();
+}
+
+void test19()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Deleting entries" << std::endl;
+    createRelationForward();
+    insertHotKeysRandom(nullptr, 10000, 4);
+    indexTest16();
+    deleteRelation();
+}
+
+void test20()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Concurrent inserts, deletes and scans" << std::endl;
+    createRelationForwardSize(0);
+    indexTest17();
+    deleteRelation();
+}
+
+void test21()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Replacement policies with boosted non leaf nodes" << std::endl;
+    ReplacementPolicy *policies[] = {new LruKPolicy(), new TwoQPolicy(), new ArcPolicy()};
+    BufMgr *sharedBufMgr = bufMgr;
+    for (ReplacementPolicy *policy : policies)
+    {
+        bufMgr = new BufMgr(100, policy);
+        bufMgr->setBoostRounds(2);
+        createRelationRandom();
+        indexTests();
+        deleteRelation();
+        delete bufMgr;
+    }
+    bufMgr = sharedBufMgr;
+}
+
+void test22()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Partitioned buffer pool" << std::endl;
+    BufMgr *sharedBufMgr = bufMgr;
+    bufMgr = new BufMgr(400, NULL, 8);
+    checkPassFail((int)bufMgr->getNumPartitions(), 8)
+    createRelationRandom();
+    indexTests();
+    deleteRelation();
+    createRelationForwardSize(0);
+    indexTest17();
+    deleteRelation();
+    delete bufMgr;
+    bufMgr = sharedBufMgr;
+}
+
+void test23()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Background writer and checkpoints" << std::endl;
+    BufMgr *sharedBufMgr = bufMgr;
+    bufMgr = new BufMgr(400, NULL, 4);
+    bufMgr->startBackgroundWriter(0.0, 0.05);
+    createRelationForwardSize(0);
+    indexTest17();
+    deleteRelation();
+    bufMgr->stopBackgroundWriter();
+
+    // a checkpoint leaves no dirty unpinned page behind
+    createRelationForwardSize(0);
+    {
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+        insertRelationRandom(&index, 2000);
+        bufMgr->checkpoint();
+        checkPassFail(bufMgr->checkpoint(), 0)
+        checkPassFail(intScan(&index,25,GT,40,LT), 14)
+    }
+    File::remove(intIndexName);
+    deleteRelation();
+    delete bufMgr;
+    bufMgr = sharedBufMgr;
+}
+
+void test24()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Batched prefetch and background writes" << std::endl;
+    BufMgr *sharedBufMgr = bufMgr;
+    for (bool uring : {true, false})
+    {
+        // a thread picks its I/O engine when it first submits a batch, so each engine is run by a new thread
+        std::thread run([uring]()
+        {
+            IoEngine::setUringEnabled(uring);
+            bufMgr = new BufMgr(400, NULL, 4);
+            createRelationForwardSize(0);
+            std::vector<PageId> pageNos;
+            for (FileIterator iter = file1->begin(); iter != file1->end(); ++iter)
+                pageNos.push_back((*iter).page_number());
+
+            // the prefetched pages are then read without a disk read, and pages past the end are skipped
+            checkPassFail((int)bufMgr->prefetchPages(file1, pageNos), (int)pageNos.size())
+            checkPassFail((int)bufMgr->prefetchPages(file1, {pageNos.back() + 1}), 0)
+            bufMgr->clearBufStats();
+            for (PageId pageNo : pageNos)
+            {
+                Page *page;
+                bufMgr->readPage(file1, pageNo, page);
+                bufMgr->unPinPage(file1, pageNo, false);
+            }
+            checkPassFail((int)bufMgr->getBufStats().diskreads, 0)
+            checkPassFail((int)bufMgr->prefetchPages(file1, pageNos), 0)
+            deleteRelation();
+
+            bufMgr->startBackgroundWriter(0.0, 0.05);
+            createRelationRandom();
+            indexTests();
+            deleteRelation();
+            delete bufMgr;
+        });
+        run.join();
+    }
+    IoEngine::setUringEnabled(true);
+    bufMgr = sharedBufMgr;
+}
+
+void test25()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Direct I/O on an aligned pool" << std::endl;
+    BufMgr *sharedBufMgr = bufMgr;
+    bufMgr = new BufMgr(400, NULL, 0, true);
+    checkPassFail((int)((std::uintptr_t)bufMgr->bufPool % File::DIRECT_IO_ALIGNMENT), 0)
+    File::setDirectIo(true);
+    createRelationRandom();
+    indexTests();
+    deleteRelation();
+    File::setDirectIo(false);
+    delete bufMgr;
+    bufMgr = sharedBufMgr;
+}
+
+void test26()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Memory-mapped read-only index" << std::endl;
+    createRelationRandom();
+    {
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+    }
+    {
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER,
+                         BULKLOAD_FILL_FACTOR, INDEX_READ_ONLY_MAPPED);
+        checkPassFail(intScan(&index,25,GT,40,LT), 14)
+        checkPassFail(intScan(&index,-3,GT,3,LT), 3)
+        checkPassFail(intScan(&index,996,GT,1001,LT), 4)
+        checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+
+        int key = 1234;
+        RecordId outRid;
+        checkPassFail(index.lookup(&key, outRid), true)
+        key = relationSize;
+        checkPassFail(index.lookup(&key, outRid), false)
+
+        bool thrown = false;
+        try
+        {
+            index.insertEntry(&key, outRid);
+        }
+        catch(const IndexReadOnlyException &e)
+        {
+            thrown = true;
+        }
+        checkPassFail(thrown, true)
+    }
+    File::remove(intIndexName);
+    deleteRelation();
+}
+
+void test27()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Page allocation and deletion in the middle of a file" << std::endl;
+    {
+        PageFile file = PageFile::create(relationName);
+        PageId pageNo;
+        for (int i = 0; i < 1000; i++)
+            file.allocatePage(pageNo);
+        checkPassFail((int)pageNo, 1000)
+
+        // the pages deleted are reused, the last deleted first
+        for (PageId i = 1; i <= 1000; i += 3)
+            file.deletePage(i);
+        for (int i = 0; i < 100; i++)
+            file.allocatePage(pageNo);
+        checkPassFail((int)pageNo, 703)
+    }
+    {
+        // the used list stays in page number order, and a reopened file appends after its last used page
+        PageFile file = PageFile::open(relationName);
+        PageId pageNo;
+        file.allocatePage(pageNo);
+        checkPassFail((int)pageNo, 700)
+        for (int i = 0; i < 233; i++)
+            file.allocatePage(pageNo);
+        checkPassFail((int)pageNo, 1)
+        file.allocatePage(pageNo);
+        checkPassFail((int)pageNo, 1001)
+
+        int numPages = 0;
+        PageId lastPageNo = Page::INVALID_NUMBER;
+        bool ordered = true;
+        for (FileIterator iter = file.begin(); iter != file.end(); ++iter, numPages++)
+        {
+            ordered = ordered && (*iter).page_number() > lastPageNo;
+            lastPageNo = (*iter).page_number();
+        }
+        checkPassFail(ordered, true)
+        checkPassFail(numPages, 1001)
+        checkPassFail((int)lastPageNo, 1001)
+    }
+    File::remove(relationName);
+}
+
+void test28()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Record insertion through the free space map" << std::endl;
+    memset(record1.s, ' ', sizeof(record1.s));
+    std::string recordData(reinterpret_cast<char*>(&record1), sizeof(record1));
+    std::vector<RecordId> rids;
+    PageId numPages;
+    {
+        PageFile file = PageFile::create(relationName);
+        for (int i = 0; i < 2000; i++)
+            rids.push_back(file.insertRecord(recordData));
+        numPages = rids.back().page_number;
+
+        // the records deleted leave room which the next insertions take, before any new page
+        for (std::size_t i = 0; i < rids.size(); i += 4)
+            file.deleteRecord(rids[i]);
+        PageId maxPageNo = Page::INVALID_NUMBER;
+        for (std::size_t i = 0; i < rids.size(); i += 4)
+            maxPageNo = std::max(maxPageNo, file.insertRecord(recordData).page_number);
+        checkPassFail((int)maxPageNo, (int)numPages)
+
+        for (std::size_t i = 1; i < rids.size(); i += 4)
+            file.deleteRecord(rids[i]);
+    }
+    {
+        // a reopened file maps the free space of its pages again
+        PageFile file = PageFile::open(relationName);
+        checkPassFail((file.insertRecord(recordData).page_number < numPages), true)
+    }
+    File::remove(relationName);
+}
+
+void test29()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Page recycling in a blob file" << std::endl;
+    const std::string blobName = "blobA";
+    try
+    {
+        File::remove(blobName);
+    }
+    catch(const FileNotFoundException &e)
+    {
+    }
+    {
+        BlobFile file = BlobFile::create(blobName);
+        PageId pageNos[5];
+        Page *page;
+        for (PageId &pageNo : pageNos)
+        {
+            bufMgr->allocPage(&file, pageNo, page);
+            bufMgr->unPinPage(&file, pageNo, true);
+        }
+
+        // a pinned page is not disposed of
+        bufMgr->readPage(&file, pageNos[1], page);
+        bool thrown = false;
+        try
+        {
+            bufMgr->disposePage(&file, pageNos[1]);
+        }
+        catch(const PagePinnedException &e)
+        {
+            thrown = true;
+        }
+        checkPassFail(thrown, true)
+        bufMgr->unPinPage(&file, pageNos[1], false);
+
+        // the pages disposed of are reused, the last one first, whether in the pool or not
+        bufMgr->disposePage(&file, pageNos[1]);
+        bufMgr->flushFile(&file);
+        bufMgr->disposePage(&file, pageNos[3]);
+        bufMgr->disposePage(&file, pageNos[2]);
+
+        // a free page is not deleted again, which would link it into the chain twice
+        thrown = false;
+        try
+        {
+            file.deletePage(pageNos[3]);
+        }
+        catch(const InvalidPageException &e)
+        {
+            thrown = true;
+        }
+        checkPassFail(thrown, true)
+        PageId pageNo;
+        bufMgr->allocPage(&file, pageNo, page);
+        checkPassFail((int)pageNo, (int)pageNos[2])
+        bufMgr->unPinPage(&file, pageNo, true);
+        bufMgr->flushFile(&file);
+    }
+    {
+        // the free pages are kept in the file
+        BlobFile file = BlobFile::open(blobName);
+
+        // nor once the file is opened again, the free pages being read from the chain
+        bool thrown = false;
+        try
+        {
+            file.deletePage(4);
+        }
+        catch(const InvalidPageException &e)
+        {
+            thrown = true;
+        }
+        checkPassFail(thrown, true)
+        PageId pageNo;
+        Page *page;
+        bufMgr->allocPage(&file, pageNo, page);
+        checkPassFail((int)pageNo, 4)
+        bufMgr->unPinPage(&file, pageNo, true);
+        bufMgr->allocPage(&file, pageNo, page);
+        checkPassFail((int)pageNo, 2)
+        bufMgr->unPinPage(&file, pageNo, true);
+        bufMgr->allocPage(&file, pageNo, page);
+        checkPassFail((int)pageNo, 6)
+        bufMgr->unPinPage(&file, pageNo, true);
+        bufMgr->flushFile(&file);
+    }
+    File::remove(blobName);
+}
+
+int coldScanReads(int highVal, int &numFound)
+{
+    // pages read by a scan of an index opened with an empty buffer pool, once it has left its starting leaf
+    BufMgr *sharedBufMgr = bufMgr;
+    bufMgr = new BufMgr(100);
+    int numRead;
+    {
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+        BTreeCursor cursor(&index);
+        int lowVal = 0;
+        cursor.startScan(&lowVal, GTE, &highVal, LT);
+        numRead = bufMgr->getBufStats().diskreads;
+        RecordId rid;
+        numFound = 0;
+        for (; numFound < NodeCapacity<int>::LEAF; numFound++)
+            cursor.scanNext(rid);
+        numRead = bufMgr->getBufStats().diskreads - numRead;
+        try
+        {
+            while (true)
+            {
+                cursor.scanNext(rid);
+                numFound++;
+            }
+        }
+        catch(const IndexScanCompletedException &e)
+        {
+        }
+        cursor.endScan();
+    }
+    delete bufMgr;
+    bufMgr = sharedBufMgr;
+    return numRead;
+}
+
+void test30()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Leaf read-ahead of range scans" << std::endl;
+    createRelationForward();
+    {
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+    }
+
+    // the leaves after the starting one are read in a batch, up to those past the high bound
+    int numFound;
+    checkPassFail((coldScanReads(relationSize, numFound) >= READ_AHEAD_MIN_LEAVES), true)
+    checkPassFail(numFound, relationSize)
+    checkPassFail(coldScanReads(NodeCapacity<int>::LEAF + 10, numFound), 1)
+    checkPassFail(numFound, NodeCapacity<int>::LEAF + 10)
+
+    File::remove(intIndexName);
+    deleteRelation();
+}
+
+void test31()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Read-ahead of file scans" << std::endl;
+    createRelationForward();
+    int numPages = 0;
+    {
+        PageFile file = PageFile::open(relationName);
+        for (FileIterator iter = file.begin(); iter != file.end(); ++iter)
+            numPages++;
+    }
+
+    BufMgr *sharedBufMgr = bufMgr;
+    bufMgr = new BufMgr(100);
+    {
+        FileScan scan(relationName, bufMgr);
+        RecordId rid;
+        int numFound = 0;
+        try
+        {
+            // the first page is read with the pages following it
+            scan.scanNext(rid);
+            numFound++;
+            checkPassFail((bufMgr->getBufStats().diskreads > 1), true)
+            while (true)
+            {
+                scan.scanNext(rid);
+                numFound++;
+            }
+        }
+        catch(const EndOfFileException &e)
+        {
+        }
+        checkPassFail(numFound, relationSize)
+        // no page is read twice, i.e. evicted from the ring before the scan reaches it
+        checkPassFail((int)bufMgr->getBufStats().diskreads, numPages)
+    }
+    delete bufMgr;
+    bufMgr = sharedBufMgr;
+    deleteRelation();
+}
+
+void test32()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Record views" << std::endl;
+    {
+        // a view points into the page, and a record can be inserted or updated from a view
+        Page page;
+        RecordId rid = page.insertRecord(std::string("first record"));
+        std::string_view view = page.getRecordView(rid);
+        checkPassFail((view == "first record"), true)
+        checkPassFail((view.data() > (const char *)&page && view.data() < (const char *)(&page + 1)), true)
+        RecordId copyRid = page.insertRecord(view.substr(0, 5));
+        checkPassFail(page.getRecord(copyRid), std::string("first"))
+        page.updateRecord(copyRid, std::string_view("other"));
+        checkPassFail((page.getRecordView(copyRid) == "other"), true)
+    }
+
+    // a scan gives views of the records in its pinned page
+    createRelationForward();
+    {
+        FileScan scan(relationName, bufMgr);
+        RecordId rid;
+        int numMatched = 0;
+        try
+        {
+            while (true)
+            {
+                scan.scanNext(rid);
+                std::string_view view = scan.getRecordView();
+                if (view == scan.getRecord() && *(const int *)(view.data() + offsetof(tuple, i)) == numMatched)
+                    numMatched++;
+            }
+        }
+        catch(const EndOfFileException &e)
+        {
+        }
+        checkPassFail(numMatched, relationSize)
+    }
+    deleteRelation();
+}
+
+void test33()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Parallel file scans" << std::endl;
+    createRelationForward();
+    for (std::uint32_t morselPages : {1u, ParallelFileScan::MORSEL_PAGES})
+    {
+        // every record is seen exactly once, whichever thread scans its page
+        ParallelFileScan scan(relationName, bufMgr, morselPages);
+        std::vector<int> seen(relationSize, 0);
+        std::mutex seenMutex;
+        scan.run(4, [&](unsigned thread, const RecordId &rid, std::string_view record) {
+            int key = *(const int *)(record.data() + offsetof(tuple, i));
+            std::lock_guard<std::mutex> guard(seenMutex);
+            seen[key]++;
+        });
+        checkPassFail((std::count(seen.begin(), seen.end(), 1) == relationSize), true)
+    }
+    {
+        // an exception thrown by a thread stops the scan and is thrown again by run
+        ParallelFileScan scan(relationName, bufMgr, 1);
+        bool thrown = false;
+        try
+        {
+            scan.run(4, [&](unsigned thread, const RecordId &rid, std::string_view record) {
+                if (*(const int *)(record.data() + offsetof(tuple, i)) == relationSize / 2)
+                    throw EndOfFileException();
+            });
+        }
+        catch(const EndOfFileException &e)
+        {
+            thrown = true;
+        }
+        checkPassFail(thrown, true)
+    }
+    deleteRelation();
+}
+
+void test34()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Parallel bulk load" << std::endl;
+    BTreeIndex::setBulkLoadThreads(4);
+    createRelationRandom();
+
+    // the runs of the threads are merged in memory
+    indexTests();
+
+    // with 6 frames, fewer pairs than the relation has fit in memory, so that runs are spilled
+    BufMgr *sharedBufMgr = bufMgr;
+    bufMgr = new BufMgr(6);
+    {
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+        checkPassFail(intScan(&index,0,GTE,relationSize,LT), relationSize)
+        checkPassFail(intScan(&index,25,GT,40,LT), 14)
+    }
+    checkPassFail(File::exists(intIndexName + ".run0"), false)
+    File::remove(intIndexName);
+    delete bufMgr;
+    bufMgr = sharedBufMgr;
+
+    BTreeIndex::setBulkLoadThreads(0);
+    deleteRelation();
+}
+
+int filteredScan(Datatype type, const void *lowVal, Operator lowOp, const void *highVal, Operator highOp)
+{
+    // number of records returned by a scan filtered on an attribute, -1 if one is outside the range
+    int offset = type == INTEGER ? offsetof(tuple, i) : type == DOUBLE ? offsetof(tuple, d) : offsetof(tuple, s);
+    FileScan scan(relationName, bufMgr);
+    scan.setFilter(offset, type, lowVal, lowOp, highVal, highOp);
+    int numFound = 0;
+    try
+    {
+        RecordId rid;
+        while (true)
+        {
+            scan.scanNext(rid);
+            int i = *(const int *)(scan.getRecordView().data() + offsetof(tuple, i));
+            char s[64];
+            sprintf(s, "%05d string record", i);
+            bool inRange = type == STRING
+                ? (lowOp == GTE ? strcmp(s, (const char *)lowVal) >= 0 : strcmp(s, (const char *)lowVal) > 0)
+                  && (highOp == LTE ? strcmp(s, (const char *)highVal) <= 0 : strcmp(s, (const char *)highVal) < 0)
+                : compareOp(i, *(const int *)lowVal, lowOp) && compareOp(i, *(const int *)highVal, highOp);
+            if (type == DOUBLE)
+                inRange = (lowOp == GTE ? i >= *(const double *)lowVal : i > *(const double *)lowVal)
+                    && (highOp == LTE ? i <= *(const double *)highVal : i < *(const double *)highVal);
+            if (!inRange)
+                return -1;
+            numFound++;
+        }
+    }
+    catch(const EndOfFileException &e)
+    {
+    }
+    return numFound;
+}
+
+void test35()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Filtered file scans" << std::endl;
+    createRelationRandom();
+
+    int lowInt = 25, highInt = 40, maxInt = INT_MAX;
+    checkPassFail(filteredScan(INTEGER, &lowInt, GT, &highInt, LT), 14)
+    checkPassFail(filteredScan(INTEGER, &lowInt, GTE, &highInt, LTE), 16)
+    checkPassFail(filteredScan(INTEGER, &highInt, GT, &highInt, LT), 0)
+    int lastInt = relationSize - 10;
+    checkPassFail(filteredScan(INTEGER, &lastInt, GTE, &maxInt, LTE), 10)
+
+    double lowDouble = 24.5, highDouble = 40;
+    checkPassFail(filteredScan(DOUBLE, &lowDouble, GT, &highDouble, LTE), 16)
+    checkPassFail(filteredScan(DOUBLE, &lowDouble, GTE, &highDouble, LT), 15)
+
+    const char *lowString = "00100", *highString = "00200";
+    checkPassFail(filteredScan(STRING, lowString, GTE, highString, LT), 100)
+
+    {
+        FileScan scan(relationName, bufMgr);
+        bool thrown = false;
+        try
+        {
+            scan.setFilter(offsetof(tuple, i), INTEGER, &lowInt, LT, &highInt, LT);
+        }
+        catch(const BadOpcodesException &e)
+        {
+            thrown = true;
+        }
+        checkPassFail(thrown, true)
+        thrown = false;
+        try
+        {
+            scan.setFilter(offsetof(tuple, i), INTEGER, &highInt, GT, &lowInt, LT);
+        }
+        catch(const BadScanrangeException &e)
+        {
+            thrown = true;
+        }
+        checkPassFail(thrown, true)
+    }
+    deleteRelation();
+}
+
+int coveringScan(BTreeIndex *index, Datatype type)
+{
+    // number of entries of a covering index on i including d, or on d including i, -1 if an included
+    // value differs from the key or the keys are out of order
+    int lowInt = INT_MIN, highInt = INT_MAX;
+    double lowDouble = -1e300, highDouble = 1e300;
+    if (type == INTEGER)
+        index->startScan(&lowInt, GTE, &highInt, LTE);
+    else
+        index->startScan(&lowDouble, GTE, &highDouble, LTE);
+    int numFound = 0;
+    bool ok = true;
+    double last = -1e300;
+    try
+    {
+        RecordId rid;
+        while (true)
+        {
+            double key, value;
+            if (type == INTEGER)
+            {
+                int intKey;
+                index->scanNextIncluded(rid, &intKey, &value);
+                key = intKey;
+            }
+            else
+            {
+                int intValue;
+                index->scanNextIncluded(rid, &key, &intValue);
+                value = intValue;
+            }
+            ok = ok && key == value && key >= last;
+            last = key;
+            numFound++;
+        }
+    }
+    catch(const IndexScanCompletedException &e)
+    {
+    }
+    index->endScan();
+    return ok ? numFound : -1;
+}
+
+void test36()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Covering index scans" << std::endl;
+    createRelationRandom();
+
+    std::vector<IncludedAttribute> includeD(1, IncludedAttribute{(int)offsetof(tuple, d), (int)sizeof(double)});
+    std::vector<IncludedAttribute> includeI(1, IncludedAttribute{(int)offsetof(tuple, i), (int)sizeof(int)});
+    {
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, BULKLOAD_FILL_FACTOR,
+                         INDEX_READ_WRITE, includeD);
+        checkPassFail((intIndexName == relationName + ".0+8"), true)
+        checkPassFail(index.getIncludedWidth(), (int)sizeof(double))
+        checkPassFail(coveringScan(&index, INTEGER), relationSize)
+        checkPassFail(intScan(&index,25,GT,40,LT), 14)
+
+        // keys with more entries than a leaf holds, which stay in the leaves with their values
+        insertHotKeysRandom(&index, 3000, 5);
+        checkPassFail(coveringScan(&index, INTEGER), relationSize + 3000)
+
+        // values given apart from the record
+        int key = relationSize;
+        double value = relationSize;
+        RecordId valueRid = {1000000, 1, 0};
+        index.insertEntry(&key, valueRid, &value);
+        checkPassFail(coveringScan(&index, INTEGER), relationSize + 3001)
+        checkPassFail(index.deleteEntry(&key, valueRid), true)
+
+        // the bulk loader spreads the entries of a hot key over leaves as well
+        {
+            BTreeIndex doubleIndex(relationName, doubleIndexName, bufMgr, offsetof(tuple,d), DOUBLE,
+                                   BULKLOAD_FILL_FACTOR, INDEX_READ_WRITE, includeI);
+            checkPassFail(coveringScan(&doubleIndex, DOUBLE), relationSize + 3000)
+        }
+        File::remove(doubleIndexName);
+
+        // merges and redistributions move the included values along
+        int lowVal = 0, highVal = relationSize;
+        int numDeleted = deleteEntries(&index, &lowVal, &highVal, 2, offsetof(tuple,i));
+        checkPassFail((numDeleted > 0), true)
+
+        // the scan does not read the relation, which is gone
+        deleteRelation();
+        checkPassFail(coveringScan(&index, INTEGER), relationSize + 3000 - numDeleted)
+    }
+    {
+        // the index is opened with its included attributes only
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, BULKLOAD_FILL_FACTOR,
+                         INDEX_READ_WRITE, includeD);
+        checkPassFail((coveringScan(&index, INTEGER) > 0), true)
+    }
+    bool thrown = false;
+    try
+    {
+        std::vector<IncludedAttribute> includeHalfD(1, IncludedAttribute{(int)offsetof(tuple, d), 4});
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, BULKLOAD_FILL_FACTOR,
+                         INDEX_READ_WRITE, includeHalfD);
+    }
+    catch(const BadIndexInfoException &e)
+    {
+        thrown = true;
+    }
+    checkPassFail(thrown, true)
+    File::remove(intIndexName);
+
+    thrown = false;
+    try
+    {
+        BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING, BULKLOAD_FILL_FACTOR,
+                         INDEX_READ_WRITE, includeI);
+    }
+    catch(const BadIndexInfoException &e)
+    {
+        thrown = true;
+    }
+    checkPassFail(thrown, true)
+}
+
+int bitmapFetch(const RidBitmap &rids, int lowVal, int highVal)
+{
+    // number of records fetched by a bitmap heap scan, -1 if one is outside [lowVal, highVal), if they are
+    // not in record ID order or if a page is not read once
+    BitmapHeapScan scan(relationName, bufMgr, rids);
+    int numFound = 0;
+    RecordId last = {Page::INVALID_NUMBER, Page::INVALID_SLOT, 0};
+    try
+    {
+        RecordId rid;
+        while (true)
+        {
+            scan.scanNext(rid);
+            int i = *(const int *)(scan.getRecordView().data() + offsetof(tuple, i));
+            if (!(last < rid) || i < lowVal || i >= highVal)
+                return -1;
+            last = rid;
+            numFound++;
+        }
+    }
+    catch(const EndOfFileException &e)
+    {
+    }
+    return scan.pagesRead() == rids.numPages() ? numFound : -1;
+}
+
+void test37()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Bitmap heap scans" << std::endl;
+    createRelationRandom();
+    {
+        BTreeIndex intIndex(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+        BTreeIndex doubleIndex(relationName, doubleIndexName, bufMgr, offsetof(tuple,d), DOUBLE);
+
+        RidBitmap lowInts, midDoubles;
+        int lowInt = 0, highInt = 2500;
+        intIndex.startScan(&lowInt, GTE, &highInt, LT);
+        checkPassFail((int)intIndex.scanToBitmap(lowInts), 2500)
+        intIndex.endScan();
+        double lowDouble = 1000, highDouble = 4000;
+        doubleIndex.startScan(&lowDouble, GTE, &highDouble, LT);
+        checkPassFail((int)doubleIndex.scanToBitmap(midDoubles), 3000)
+        doubleIndex.endScan();
+        checkPassFail((int)lowInts.size(), 2500)
+        checkPassFail(bitmapFetch(lowInts, 0, 2500), 2500)
+
+        // a record with both predicates, and one with either
+        RidBitmap both = lowInts;
+        both &= midDoubles;
+        RidBitmap either = lowInts;
+        either |= midDoubles;
+        checkPassFail((int)both.size(), 1500)
+        checkPassFail((int)either.size(), 4000)
+        checkPassFail(bitmapFetch(both, 1000, 2500), 1500)
+        checkPassFail(bitmapFetch(either, 0, 4000), 4000)
+
+        std::vector<RecordId> rids;
+        both.toRids(rids);
+        checkPassFail((rids.size() == both.size() && std::is_sorted(rids.begin(), rids.end())), true)
+        checkPassFail((lowInts.contains(rids[0]) && midDoubles.contains(rids[0])), true)
+        checkPassFail((either.numPages() < either.size() / 10), true)
+    }
+    File::remove(intIndexName);
+    File::remove(doubleIndexName);
+    deleteRelation();
+}
+
+void createRelationComposite()
+{
+  // destroy any old copies of relation file
+	try
+	{
+		File::remove(relationName);
+	}
+	catch(const FileNotFoundException &e)
+	{
+	}
+  file1 = new PageFile(relationName, true);
+  memset(record1.s, ' ', sizeof(record1.s));
+
+  // 100 integers from -50 repeated, each time with a lower double, and 7 strings
+  for(int k = 0; k < relationSize; k++ )
+	{
+    sprintf(record1.s, "%d", k % 7);
+    record1.i = k % 100 - 50;
+    record1.d = 10.0 - 1.5 * (k / 100);
+    std::string new_data(reinterpret_cast<char*>(&record1), sizeof(record1));
+		file1->insertRecord(new_data);
+  }
+}
+
+int compositeScan(BTreeIndex *index, const void *const *values, int numValues)
+{
+    // number of entries of an (i, d) index starting with the values, -1 if a record is out of order
+    // or its i is not the first value
+    int numFound = 0;
+    try
+    {
+        index->startPrefixScan(values, numValues);
+    }
+    catch(const NoSuchKeyFoundException &e)
+    {
+        return 0;
+    }
+    int lastI = INT_MIN;
+    double lastD = 0;
+    try
+    {
+        RecordId rid;
+        while (true)
+        {
+            index->scanNext(rid);
+            Page page = file1->readPage(rid.page_number);
+            const char *record = page.getRecordView(rid).data();
+            int i = *(const int *)(record + offsetof(tuple, i));
+            double d = *(const double *)(record + offsetof(tuple, d));
+            if (i < lastI || (i == lastI && d < lastD) || (numValues > 0 && i != *(const int *)values[0]))
+                return -1;
+            lastI = i;
+            lastD = d;
+            numFound++;
+        }
+    }
+    catch(const IndexScanCompletedException &e)
+    {
+    }
+    index->endScan();
+    return numFound;
+}
+
+void test38()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Composite keys" << std::endl;
+    createRelationComposite();
+    std::string compositeIndexName;
+    std::vector<KeyColumn> columns = {{(int)offsetof(tuple, i), INTEGER}, {(int)offsetof(tuple, d), DOUBLE}};
+    {
+        BTreeIndex index(relationName, compositeIndexName, bufMgr, columns);
+        checkPassFail(compositeIndexName, relationName + ".0,8")
+
+        // negative integers and doubles order before the positive ones
+        int i = -3;
+        const void *prefix[2] = {&i, NULL};
+        checkPassFail(compositeScan(&index, prefix, 0), relationSize)
+        checkPassFail(compositeScan(&index, prefix, 1), relationSize / 100)
+        i = 60;
+        checkPassFail(compositeScan(&index, prefix, 1), 0)
+
+        // an entry is found, inserted and deleted by its full key
+        i = 49;
+        double d = -15.5;
+        prefix[1] = &d;
+        StringKey key;
+        index.encodeKey(prefix, 2, key);
+        RecordId rid;
+        checkPassFail(index.lookup(&key, rid), true)
+        RecordId newRid = {1000000, 1, 0};
+        d = -1e300;
+        index.encodeKey(prefix, 2, key);
+        checkPassFail(index.lookup(&key, rid), false)
+        index.insertEntry(&key, newRid);
+        checkPassFail(index.lookup(&key, rid), true)
+        checkPassFail((rid == newRid), true)
+        checkPassFail(index.deleteEntry(&key, newRid), true)
+        checkPassFail(compositeScan(&index, prefix, 1), relationSize / 100)
+    }
+    {
+        // the file is opened with the same columns only
+        BTreeIndex index(relationName, compositeIndexName, bufMgr, columns);
+        int i = 0;
+        const void *prefix[1] = {&i};
+        checkPassFail(compositeScan(&index, prefix, 1), relationSize / 100)
+    }
+    bool thrown = false;
+    try
+    {
+        std::vector<KeyColumn> otherColumns = {{(int)offsetof(tuple, i), INTEGER}, {(int)offsetof(tuple, d), INTEGER}};
+        BTreeIndex index(relationName, compositeIndexName, bufMgr, otherColumns);
+    }
+    catch(const BadIndexInfoException &e)
+    {
+        thrown = true;
+    }
+    checkPassFail(thrown, true)
+    File::remove(compositeIndexName);
+
+    {
+        // a char string column is ended so that a shorter string orders first
+        std::vector<KeyColumn> stringColumns = {{(int)offsetof(tuple, s), STRING}, {(int)offsetof(tuple, i), INTEGER}};
+        BTreeIndex index(relationName, compositeIndexName, bufMgr, stringColumns);
+        const char *s = "3";
+        int i = -47;
+        const void *prefix[2] = {s, &i};
+        int numFound = 0;
+        index.startPrefixScan(prefix, 2);
+        try
+        {
+            RecordId rid;
+            while (true)
+            {
+                index.scanNext(rid);
+                numFound++;
+            }
+        }
+        catch(const IndexScanCompletedException &e)
+        {
+        }
+        index.endScan();
+        // k % 7 == 3 and k % 100 == 3 when k % 700 == 3
+        checkPassFail(numFound, (relationSize + 696) / 700)
+        bool none = false;
+        try
+        {
+            const char *longer = "33";
+            index.startPrefixScan((const void *const *)&longer, 1);
+        }
+        catch(const NoSuchKeyFoundException &e)
+        {
+            none = true;
+        }
+        checkPassFail(none, true)
+    }
+    File::remove(compositeIndexName);
+    deleteRelation();
+}
+
+template <class T>
+bool normalizedOrder(const T *values, int n)
+{
+    // whether the normalized keys of every pair of values compare with memcmp as the values do
+    for (int a = 0; a < n; a++)
+    {
+        for (int b = 0; b < n; b++)
+        {
+            char encodedA[sizeof(T)], encodedB[sizeof(T)];
+            encodeNormalized(values[a], encodedA);
+            encodeNormalized(values[b], encodedB);
+            int c = memcmp(encodedA, encodedB, sizeof(T));
+            if ((c < 0) != (values[a] < values[b]) || (c == 0) != (values[a] == values[b]))
+                return false;
+        }
+    }
+    return true;
+}
+
+void test39()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Normalized keys" << std::endl;
+    const int ints[] = {INT_MIN, -65536, -256, -1, 0, 1, 255, 256, 65536, INT_MAX};
+    checkPassFail(normalizedOrder(ints, 10), true)
+    const double doubles[] = {-HUGE_VAL, -1e300, -2.5, -1e-300, -0.0, 0.0, 1e-300, 0.5, 2.5, 1e300, HUGE_VAL};
+    checkPassFail(normalizedOrder(doubles, 11), true)
+
+    // a string orders before its extensions whatever the bytes following it
+    char shorter[8], longer[8];
+    int n = encodeNormalized("ab", STRINGSIZE, shorter);
+    encodeNormalized(INT_MAX, shorter + n);
+    n = encodeNormalized("abc", STRINGSIZE, longer);
+    encodeNormalized(INT_MIN, longer + n);
+    checkPassFail((memcmp(shorter, longer, 7) < 0), true)
+
+    createRelationForward();
+    {
+        BTreeIndex index(relationName, doubleIndexName, bufMgr, offsetof(tuple,d), DOUBLE);
+        double zero = 0.0, negativeZero = -0.0, last = relationSize - 1;
+        StringKey zeroKey, negativeZeroKey, lastKey;
+        index.normalizeKey(&zero, zeroKey);
+        index.normalizeKey(&negativeZero, negativeZeroKey);
+        index.normalizeKey(&last, lastKey);
+        checkPassFail((zeroKey == negativeZeroKey && zeroKey < lastKey), true)
+        RecordId rid;
+        checkPassFail(index.lookup(&negativeZero, rid), true)
+        checkPassFail(doubleScan(&index, -0.0, GTE, 100, LT), 100)
+    }
+    File::remove(doubleIndexName);
+    deleteRelation();
+}
+
+void test40()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Node cache" << std::endl;
+    createRelationForward();
+    // number of entries in [lowVal, highVal), the inserted record IDs pointing to no record
+    auto countEntries = [](BTreeIndex &index, int lowVal, int highVal) {
+        RecordId rids[256];
+        int numFound = 0;
+        index.startScan(&lowVal, GTE, &highVal, LT);
+        for (std::size_t n; (n = index.scanNextBatch(rids, 256)) > 0; )
+            numFound += n;
+        index.endScan();
+        return numFound;
+    };
+    {
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+        RecordId rid;
+        int key = 0;
+        checkPassFail(index.lookup(&key, rid), true)
+        checkPassFail((index.getNumCachedNodes() > 0), true)
+
+        // once the root is cached, a lookup only reads its leaf from the buffer pool
+        bufMgr->clearBufStats();
+        for (key = 0; key < relationSize; key += 10)
+        {
+            index.lookup(&key, rid);
+        }
+        checkPassFail(bufMgr->getBufStats().accesses, relationSize / 10)
+
+        // the cached nodes split in place, as they stay in their frames
+        for (int i = 0; i < 4 * relationSize; i++)
+        {
+            key = relationSize + i;
+            RecordId newRid = {(PageId)(1000 + i), 1, 0};
+            index.insertEntry(&key, newRid);
+        }
+        int numFound = 0;
+        for (key = 0; key < 5 * relationSize; key++)
+        {
+            numFound += index.lookup(&key, rid);
+        }
+        checkPassFail(numFound, 5 * relationSize)
+        checkPassFail((index.getNumCachedNodes() > 0
+                       && index.getNumCachedNodes() <= bufMgr->getNumBufs() / BufMgr::HELD_PIN_FRACTION), true)
+        checkPassFail(countEntries(index, relationSize - 5, relationSize + 5), 10)
+    }
+    {
+        // the cached nodes are unpinned when the index is closed, so the file is flushed and reopened
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+        checkPassFail(countEntries(index, 0, 5 * relationSize), 5 * relationSize)
+    }
+    File::remove(intIndexName);
+    deleteRelation();
+}
+
+void test41()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Hot levels" << std::endl;
+    createRelationForward();
+    {
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+        RecordId rid;
+        int key;
+        for (key = 0; key < HOT_LEVELS_REBUILD; key++)
+        {
+            index.lookup(&key, rid);
+        }
+        checkPassFail(index.hasHotLevels(), true)
+
+        // the hot levels stay valid across splits, the keys moved right being followed from the leaves
+        for (int i = 0; i < 4 * relationSize; i++)
+        {
+            key = relationSize + i;
+            RecordId newRid = {(PageId)(1000 + i), 1, 0};
+            index.insertEntry(&key, newRid);
+        }
+        checkPassFail(index.hasHotLevels(), true)
+        int numFound = 0;
+        for (key = 0; key < 5 * relationSize; key++)
+        {
+            numFound += index.lookup(&key, rid);
+        }
+        checkPassFail(numFound, 5 * relationSize)
+
+        // merges invalidate them
+        for (int i = 0; i < 2 * relationSize; i++)
+        {
+            key = relationSize + i;
+            RecordId newRid = {(PageId)(1000 + i), 1, 0};
+            index.deleteEntry(&key, newRid);
+        }
+        checkPassFail(index.hasHotLevels(), false)
+
+        // lookups running along merges go down from the root whenever the hot levels they read are no longer valid
+        std::atomic<int> numMissed(0);
+        std::atomic<bool> deleting(true);
+        std::vector<std::thread> readers;
+        for (int t = 0; t < 4; t++)
+        {
+            readers.emplace_back([&index, &numMissed, &deleting, t]() {
+                RecordId found;
+                do
+                {
+                    for (int k = t; k < relationSize; k += 4)
+                    {
+                        numMissed += !index.lookup(&k, found);
+                    }
+                } while (deleting);
+            });
+        }
+        for (int i = 2 * relationSize; i < 4 * relationSize; i++)
+        {
+            key = relationSize + i;
+            RecordId newRid = {(PageId)(1000 + i), 1, 0};
+            index.deleteEntry(&key, newRid);
+        }
+        deleting = false;
+        for (std::thread &reader : readers)
+        {
+            reader.join();
+        }
+        checkPassFail(numMissed.load(), 0)
+
+        // and they are rebuilt
+        numFound = 0;
+        for (key = 0; key < 5 * relationSize; key++)
+        {
+            numFound += index.lookup(&key, rid);
+        }
+        checkPassFail(numFound, relationSize)
+        checkPassFail(index.hasHotLevels(), true)
+        checkPassFail(intScan(&index, 100, GTE, 200, LT), 100)
+    }
+    File::remove(intIndexName);
+    deleteRelation();
+}
+
+template <class T>
+bool directorySearch(int numKeys)
+{
+    // whether a key directory over keys with duplicates finds the positions the binary searches do
+    std::vector<T> keys(numKeys);
+    for (int i = 0; i < numKeys; i++)
+    {
+        keys[i] = (T)(i / 3 * 2);
+    }
+    KeyDirectory<T> directory(keys);
+    if (directory.size() != numKeys)
+        return false;
+    for (int v = -1; v <= numKeys + 1; v++)
+    {
+        T val = (T)v;
+        int lower = std::lower_bound(keys.begin(), keys.end(), val) - keys.begin();
+        int upper = std::upper_bound(keys.begin(), keys.end(), val) - keys.begin();
+        if (directory.template search<false>(val) != lower || directory.template search<true>(val) != upper)
+            return false;
+        if (lower < numKeys && directory.key(lower) != keys[lower])
+            return false;
+    }
+    return true;
+}
+
+void test42()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Key directories" << std::endl;
+    const int sizes[] = {0, 1, 15, 16, 17, 255, 256, 257, 4097, 20000};
+    bool intsFound = true, doublesFound = true;
+    for (int numKeys : sizes)
+    {
+        intsFound = intsFound && directorySearch<int>(numKeys);
+        doublesFound = doublesFound && directorySearch<double>(numKeys);
+    }
+    checkPassFail(intsFound, true)
+    checkPassFail(doublesFound, true)
+
+    // the keys and every level above them are aligned on cache lines
+    std::vector<int> keys(1000, 7);
+    KeyDirectory<int> directory(keys);
+    checkPassFail(((std::uintptr_t)&directory.key(0) % CACHE_LINE_SIZE), 0)
+    checkPassFail(directory.search<true>(7), 1000)
+}
+
+void test43()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Node size" << std::endl;
+    createRelationForward();
+    // number of pages read by a scan of every entry
+    auto scanAccesses = [](BTreeIndex &index) {
+        RecordId rids[256];
+        int lowVal = INT_MIN, highVal = INT_MAX;
+        bufMgr->clearBufStats();
+        index.startScan(&lowVal, GTE, &highVal, LTE);
+        while (index.scanNextBatch(rids, 256) > 0)
+            ;
+        index.endScan();
+        return bufMgr->getBufStats().accesses;
+    };
+    std::uint64_t pageAccesses;
+    {
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+        checkPassFail(index.getNodeSize(), (int)Page::SIZE)
+        pageAccesses = scanAccesses(index);
+    }
+    File::remove(intIndexName);
+    {
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, BULKLOAD_FILL_FACTOR,
+                         INDEX_READ_WRITE, std::vector<IncludedAttribute>(), MIN_NODE_SIZE);
+        checkPassFail(index.getNodeSize(), MIN_NODE_SIZE)
+        // the nodes hold a few times fewer entries, so there are a few times more leaves to read
+        checkPassFail((scanAccesses(index) > 4 * pageAccesses), true)
+
+        for (int i = 0; i < 4 * relationSize; i++)
+        {
+            int key = relationSize + i;
+            RecordId newRid = {(PageId)(1000 + i), 1, 0};
+            index.insertEntry(&key, newRid);
+        }
+        RecordId rid;
+        int numFound = 0;
+        for (int key = 0; key < 5 * relationSize; key++)
+        {
+            numFound += index.lookup(&key, rid);
+        }
+        checkPassFail(numFound, 5 * relationSize)
+    }
+    {
+        // the file keeps its node size when reopened, and may not be opened with another one
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+        checkPassFail(index.getNodeSize(), MIN_NODE_SIZE)
+    }
+    bool thrown = false;
+    try
+    {
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, BULKLOAD_FILL_FACTOR,
+                         INDEX_READ_WRITE, std::vector<IncludedAttribute>(), 2 * MIN_NODE_SIZE);
+    }
+    catch (const BadIndexInfoException &)
+    {
+        thrown = true;
+    }
+    checkPassFail(thrown, true)
+    File::remove(intIndexName);
+
+    // sizes which are no power of two, and STRING nodes smaller than a page, are refused
+    thrown = false;
+    try
+    {
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, BULKLOAD_FILL_FACTOR,
+                         INDEX_READ_WRITE, std::vector<IncludedAttribute>(), 3000);
+    }
+    catch (const BadIndexInfoException &)
+    {
+        thrown = true;
+    }
+    checkPassFail(thrown, true)
+    checkPassFail(File::exists(intIndexName), false)
+    thrown = false;
+    try
+    {
+        BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING, BULKLOAD_FILL_FACTOR,
+                         INDEX_READ_WRITE, std::vector<IncludedAttribute>(), MIN_NODE_SIZE);
+    }
+    catch (const BadIndexInfoException &)
+    {
+        thrown = true;
+    }
+    checkPassFail(thrown, true)
+    deleteRelation();
+}
+
+void test44()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Packed leaves" << std::endl;
+    createRelationForward();
+    // record IDs returned by a scan of every entry, and the number of pages read by it
+    auto scanAll = [](BTreeIndex &index, std::vector<RecordId> &rids) {
+        RecordId batch[256];
+        int n;
+        int lowVal = INT_MIN, highVal = INT_MAX;
+        rids.clear();
+        bufMgr->clearBufStats();
+        index.startScan(&lowVal, GTE, &highVal, LTE);
+        while ((n = index.scanNextBatch(batch, 256)) > 0)
+            rids.insert(rids.end(), batch, batch + n);
+        index.endScan();
+        return bufMgr->getBufStats().accesses;
+    };
+    std::vector<RecordId> expected, rids;
+    std::uint64_t pageAccesses;
+    {
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+        pageAccesses = scanAll(index, expected);
+    }
+    File::remove(intIndexName);
+
+    BTreeIndex::setBulkLoadPacking(true);
+    {
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+        // the packed leaves hold nearly twice the entries, and decode to the same record IDs
+        checkPassFail((scanAll(index, rids) < pageAccesses), true)
+        checkPassFail((rids == expected), true)
+        int lowVal = 100, highVal = 2000;
+        checkPassFail(intScan(&index, lowVal, GT, highVal, LT), 1899)
+
+        // removing entries keeps the leaves packed
+        for (int key = 0; key < relationSize; key += 3)
+        {
+            index.deleteEntry(&key, expected[key]);
+        }
+        RecordId rid;
+        int numFound = 0;
+        for (int key = 0; key < relationSize; key++)
+        {
+            numFound += index.lookup(&key, rid) && rid == expected[key];
+        }
+        checkPassFail(numFound, relationSize - (relationSize + 2) / 3)
+        checkPassFail((scanAll(index, rids) < pageAccesses), true)
+
+        // inserting unpacks the leaves
+        for (int key = 0; key < relationSize; key += 3)
+        {
+            index.insertEntry(&key, expected[key]);
+        }
+        for (int i = 0; i < relationSize; i++)
+        {
+            int key = relationSize + i;
+            RecordId newRid = {(PageId)(1000 + i), 1, 0};
+            index.insertEntry(&key, newRid);
+        }
+        scanAll(index, rids);
+        checkPassFail((int)rids.size(), 2 * relationSize)
+        checkPassFail((std::equal(expected.begin(), expected.end(), rids.begin())), true)
+    }
+    BTreeIndex::setBulkLoadPacking(false);
+    {
+        // the leaves left packed are read back from the file
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+        RecordId rid;
+        int numFound = 0;
+        for (int key = 0; key < 2 * relationSize; key++)
+        {
+            numFound += index.lookup(&key, rid);
+        }
+        checkPassFail(numFound, 2 * relationSize)
+    }
+    File::remove(intIndexName);
+    deleteRelation();
+}
+
+void copyFile(const std::string &from, const std::string &to)
+{
+    std::ifstream in(from, std::ios::binary);
+    std::ofstream out(to, std::ios::binary | std::ios::trunc);
+    out << in.rdbuf();
+}
+
+long fileSize(const std::string &name)
+{
+    std::ifstream in(name, std::ios::binary | std::ios::ate);
+    return (long)in.tellg();
+}
+
+void test45()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Write-ahead log and recovery" << std::endl;
+    createRelationForward();
+    const std::string logName = relationName + ".log";
+    std::remove(logName.c_str());
+
+    // a small pool writes pages of the index back while it changes, each once its records are synced
+    BufMgr *sharedBufMgr = bufMgr;
+    bufMgr = new BufMgr(40);
+    LogManager *log = new LogManager(logName);
+    checkPassFail(log->getNumRecovered(), 0)
+    bufMgr->setLog(log);
+    {
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+        for (int i = 0; i < 2 * relationSize; i++)
+        {
+            int key = relationSize + i;
+            RecordId newRid = {(PageId)(1000 + i), 1, 0};
+            index.insertEntry(&key, newRid);
+        }
+        std::uint64_t numSyncs = log->getNumSyncs();
+        index.commit();
+        checkPassFail((log->getNumSyncs() > numSyncs), true)
+        checkPassFail((log->getFlushedLsn() == log->getEndLsn()), true)
+
+        // a commit with nothing new to log syncs nothing
+        numSyncs = log->getNumSyncs();
+        index.commit();
+        checkPassFail((log->getNumSyncs() == numSyncs), true)
+
+        // a crash would leave the files as they are on disk, the pages dirty in the pool being lost
+        copyFile(intIndexName, intIndexName + ".crash");
+        copyFile(logName, logName + ".crash");
+    }
+    // once the index is closed, a checkpoint empties the log
+    bufMgr->checkpoint();
+    checkPassFail(fileSize(logName), (long)LogManager::HEADER_SIZE)
+    bufMgr->setLog(NULL);
+    delete log;
+    delete bufMgr;
+    bufMgr = sharedBufMgr;
+
+    // opening the log left by the crash replays the committed changes into the index file
+    copyFile(intIndexName + ".crash", intIndexName);
+    copyFile(logName + ".crash", logName);
+    log = new LogManager(logName);
+    checkPassFail((log->getNumRecovered() > 0), true)
+    delete log;
+    {
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+        RecordId rid;
+        int numFound = 0;
+        for (int key = 0; key < 3 * relationSize; key++)
+        {
+            numFound += index.lookup(&key, rid)
+                        && (key < relationSize || rid.page_number == (PageId)(1000 + key - relationSize));
+        }
+        checkPassFail(numFound, 3 * relationSize)
+    }
+    File::remove(intIndexName);
+    std::remove((intIndexName + ".crash").c_str());
+    std::remove((logName + ".crash").c_str());
+    std::remove(logName.c_str());
+    deleteRelation();
+}
+
+void test46()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Batched insertions" << std::endl;
+    createRelationForward();
+
+    // micro-batches of shuffled keys, each key twice with different record IDs
+    const int numKeys = 2 * relationSize;
+    const int batchSize = 1000;
+    std::vector<int> keys;
+    std::vector<RecordId> rids;
+    for (int i = 0; i < numKeys; i++)
+    {
+        for (PageId copy = 0; copy < 2; copy++)
+        {
+            keys.push_back(relationSize + i);
+            RecordId rid = {(PageId)(1000 + copy), (SlotId)(1 + i % 100), 0};
+            rids.push_back(rid);
+        }
+    }
+    std::vector<int> shuffledKeys(keys);
+    std::vector<RecordId> shuffledRids(rids);
+    for (std::size_t i = keys.size() - 1; i > 0; i--)
+    {
+        std::size_t pos = random() % (i + 1);
+        std::swap(shuffledKeys[i], shuffledKeys[pos]);
+        std::swap(shuffledRids[i], shuffledRids[pos]);
+    }
+
+    std::uint64_t singleAccesses, singleUnpins;
+    {
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+        bufMgr->clearBufStats();
+        for (std::size_t i = 0; i < shuffledKeys.size(); i++)
+            index.insertEntry(&shuffledKeys[i], shuffledRids[i]);
+        singleAccesses = bufMgr->getBufStats().accesses;
+        singleUnpins = bufMgr->getBufStats().dirtyunpins;
+    }
+    File::remove(intIndexName);
+
+    {
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+        bufMgr->clearBufStats();
+        for (std::size_t i = 0; i < shuffledKeys.size(); i += batchSize)
+        {
+            std::size_t n = std::min((std::size_t)batchSize, shuffledKeys.size() - i);
+            index.insertEntries(&shuffledKeys[i], &shuffledRids[i], n);
+        }
+        // the entries of a batch falling in a leaf share a descent and a dirty unpin
+        checkPassFail((bufMgr->getBufStats().accesses < singleAccesses), true)
+        checkPassFail((bufMgr->getBufStats().dirtyunpins < singleUnpins), true)
+
+        // every entry is found, equal keys in record ID order
+        RecordId batch[256];
+        int n, numEntries = 0;
+        int lowVal = INT_MIN, highVal = INT_MAX;
+        index.startScan(&lowVal, GTE, &highVal, LTE);
+        while ((n = index.scanNextBatch(batch, 256)) > 0)
+            numEntries += n;
+        index.endScan();
+        checkPassFail(numEntries, 5 * relationSize)
+        lowVal = relationSize;
+        highVal = relationSize + 9;
+        index.startScan(&lowVal, GTE, &highVal, LTE);
+        RecordId prev = {0, 0, 0}, rid;
+        int numSorted = 0;
+        for (int i = 0; i < 20; i++)
+        {
+            index.scanNext(rid);
+            numSorted += i % 2 == 0 ? rid.page_number == 1000 : prev.page_number == 1000 && rid.page_number == 1001;
+            prev = rid;
+        }
+        index.endScan();
+        checkPassFail(numSorted, 20)
+    }
+    File::remove(intIndexName);
+    deleteRelation();
+}
+
+void test47()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Write-optimized insert buffer" << std::endl;
+    createRelationForward();
+    const int numKeys = 2 * relationSize;
+    std::vector<int> keys;
+    for (int i = 0; i < numKeys; i++)
+        keys.push_back(relationSize + i);
+    for (int i = numKeys - 1; i > 0; i--)
+        std::swap(keys[i], keys[random() % (i + 1)]);
+
+    std::uint64_t plainAccesses;
+    {
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+        bufMgr->clearBufStats();
+        for (int key : keys)
+        {
+            RecordId rid = {(PageId)(1000 + key), 1, 0};
+            index.insertEntry(&key, rid);
+        }
+        plainAccesses = bufMgr->getBufStats().accesses;
+    }
+    File::remove(intIndexName);
+
+    {
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+        index.setInsertBuffer(3000);
+        bufMgr->clearBufStats();
+        for (int key : keys)
+        {
+            RecordId rid = {(PageId)(1000 + key), 1, 0};
+            index.insertEntry(&key, rid);
+        }
+        // the leaves are read once per application of the buffer rather than once per entry
+        checkPassFail((bufMgr->getBufStats().accesses * 10 < plainAccesses), true)
+        checkPassFail((int)index.getNumBufferedEntries(), numKeys % 3000)
+
+        // lookups find the buffered entries
+        RecordId rid;
+        int numFound = 0;
+        for (int key = relationSize; key < 3 * relationSize; key++)
+            numFound += index.lookup(&key, rid) && rid.page_number == (PageId)(1000 + key);
+        checkPassFail(numFound, numKeys)
+
+        // a buffered entry is deleted from the buffer
+        int key = keys.back();
+        RecordId deleted = {(PageId)(1000 + key), 1, 0};
+        checkPassFail(index.deleteEntry(&key, deleted), true)
+        checkPassFail(index.lookup(&key, rid), false)
+        checkPassFail((int)index.getNumBufferedEntries(), numKeys % 3000 - 1)
+
+        // a scan applies the buffered entries of its range
+        RecordId batch[256];
+        int n, numEntries = 0;
+        int lowVal = 2 * relationSize, highVal = 3 * relationSize;
+        index.startScan(&lowVal, GTE, &highVal, LT);
+        while ((n = index.scanNextBatch(batch, 256)) > 0)
+            numEntries += n;
+        index.endScan();
+        checkPassFail(numEntries, relationSize - (key >= lowVal ? 1 : 0))
+        index.commit();
+        checkPassFail((int)index.getNumBufferedEntries(), 0)
+    }
+    {
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+        RecordId rid;
+        int numFound = 0;
+        for (int key = relationSize; key < 3 * relationSize; key++)
+            numFound += index.lookup(&key, rid);
+        checkPassFail(numFound, numKeys - 1)
+    }
+    File::remove(intIndexName);
+    deleteRelation();
+}
+
+void test48()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Delta index" << std::endl;
+    createRelationForward();
+    const int numInserted = 1000, numDeleted = 100;
+    std::vector<int> keys;
+    for (int i = 0; i < numInserted; i++)
+        keys.push_back(relationSize + i);
+    for (int i = numInserted - 1; i > 0; i--)
+        std::swap(keys[i], keys[random() % (i + 1)]);
+    // number of entries in [lowVal, highVal), the inserted record IDs pointing to no record
+    auto countEntries = [](BTreeIndex &index, int lowVal, int highVal) {
+        RecordId rids[256];
+        int numFound = 0;
+        index.startScan(&lowVal, GTE, &highVal, LT);
+        for (std::size_t n; (n = index.scanNextBatch(rids, 256)) > 0; )
+            numFound += n;
+        index.endScan();
+        return numFound;
+    };
+    const int numEntries = relationSize - numDeleted + 1 + numInserted;
+    {
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+        std::vector<RecordId> rids(numDeleted);
+        for (int key = 0; key < numDeleted; key++)
+            index.lookup(&key, rids[key]);
+        index.setDeltaIndex(4 * numInserted);
+
+        // insertions and deletions of entries of the tree are absorbed without reading a page
+        bufMgr->clearBufStats();
+        for (int key : keys)
+        {
+            RecordId rid = {(PageId)(1000 + key), 1, 0};
+            index.insertEntry(&key, rid);
+        }
+        int numRemoved = 0;
+        for (int key = 0; key < numDeleted; key++)
+            numRemoved += index.deleteEntry(&key, rids[key]);
+        checkPassFail(numRemoved, numDeleted)
+        checkPassFail((int)bufMgr->getBufStats().accesses, 0)
+        checkPassFail((int)index.getNumBufferedEntries(), numInserted + numDeleted)
+
+        // a deletion already in the delta fails, an entry inserted again replaces the deleted one
+        int key = 0;
+        checkPassFail(index.deleteEntry(&key, rids[key]), false)
+        key = 5;
+        index.insertEntry(&key, rids[key]);
+
+        // lookups see the delta over the tree
+        RecordId rid;
+        int numFound = 0;
+        for (key = 0; key < relationSize + numInserted; key++)
+            numFound += index.lookup(&key, rid);
+        checkPassFail(numFound, numEntries)
+        std::vector<int> probes;
+        for (key = 0; key < 2 * numDeleted; key++)
+            probes.push_back(key);
+        std::unique_ptr<bool[]> found(new bool[probes.size()]);
+        std::vector<RecordId> outRids(probes.size());
+        checkPassFail((int)index.lookupBatch(probes.data(), probes.size(), outRids.data(), found.get()), numDeleted + 1)
+        checkPassFail((found[5] && outRids[5] == rids[5]), true)
+
+        // scans merge the delta with the tree, and fail to start on a range it deletes entirely
+        checkPassFail(countEntries(index, 0, relationSize + numInserted), numEntries)
+        checkPassFail(countEntries(index, relationSize - 10, relationSize + 10), 20)
+        bool thrown = false;
+        try
+        {
+            countEntries(index, 0, 5);
+        }
+        catch(const NoSuchKeyFoundException &e)
+        {
+            thrown = true;
+        }
+        checkPassFail(thrown, true)
+
+        // merging the delta leaves the same entries
+        index.flushInsertBuffer();
+        checkPassFail((int)index.getNumBufferedEntries(), 0)
+        checkPassFail(countEntries(index, 0, relationSize + numInserted), numEntries)
+        checkPassFail(countEntries(index, 0, numDeleted), 1)
+    }
+    {
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+        checkPassFail(countEntries(index, 0, relationSize + numInserted), numEntries)
+    }
+    File::remove(intIndexName);
+    deleteRelation();
+}
+
+void test49()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "ART index engine" << std::endl;
+    createRelationForward();
+    // record IDs of the entries in a range of either engine, in scan order
+    auto scanAll = [](auto &index, const void *lowVal, Operator lowOp, const void *highVal, Operator highOp) {
+        std::vector<RecordId> rids;
+        RecordId batch[256];
+        try
+        {
+            index.startScan(lowVal, lowOp, highVal, highOp);
+        }
+        catch(const NoSuchKeyFoundException &e)
+        {
+            return rids;
+        }
+        for (std::size_t n; (n = index.scanNextBatch(batch, 256)) > 0; )
+            rids.insert(rids.end(), batch, batch + n);
+        index.endScan();
+        return rids;
+    };
+    {
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+        ArtIndex art(relationName, bufMgr, offsetof(tuple,i), INTEGER);
+        checkPassFail((int)art.getNumEntries(), relationSize)
+        int lowVal = 100, highVal = 3000;
+        checkPassFail((scanAll(art, &lowVal, GT, &highVal, LT) == scanAll(index, &lowVal, GT, &highVal, LT)), true)
+
+        // keys over whole bytes grow the nodes up to Node256, and deletions shrink and collapse them
+        std::vector<int> keys;
+        for (int i = 0; i < 20000; i++)
+            keys.push_back(i < 10000 ? -1 - i : relationSize + 3 * i);
+        for (int i = 0; i < 3; i++)
+            keys.push_back(7);
+        for (int i = (int)keys.size() - 1; i > 0; i--)
+            std::swap(keys[i], keys[random() % (i + 1)]);
+        for (std::size_t i = 0; i < keys.size(); i++)
+        {
+            RecordId rid = {(PageId)(1000 + i), 1, 0};
+            index.insertEntry(&keys[i], rid);
+            art.insertEntry(&keys[i], rid);
+        }
+        checkPassFail((int)art.getNumEntries(), relationSize + (int)keys.size())
+        int minVal = INT_MIN, maxVal = INT_MAX;
+        checkPassFail((scanAll(art, &minVal, GTE, &maxVal, LTE) == scanAll(index, &minVal, GTE, &maxVal, LTE)), true)
+        int numDeleted = 0;
+        for (std::size_t i = 0; i < keys.size(); i += 3)
+        {
+            RecordId rid = {(PageId)(1000 + i), 1, 0};
+            index.deleteEntry(&keys[i], rid);
+            numDeleted += art.deleteEntry(&keys[i], rid);
+        }
+        checkPassFail(numDeleted, ((int)keys.size() + 2) / 3)
+        checkPassFail((scanAll(art, &minVal, GTE, &maxVal, LTE) == scanAll(index, &minVal, GTE, &maxVal, LTE)), true)
+        int numAgreed = 0;
+        for (std::size_t i = 0; i < keys.size(); i++)
+        {
+            RecordId artRid, treeRid;
+            bool artFound = art.lookup(&keys[i], artRid);
+            numAgreed += artFound == index.lookup(&keys[i], treeRid) && (!artFound || artRid == treeRid);
+        }
+        checkPassFail(numAgreed, (int)keys.size())
+
+        // a scan goes on from where it stopped after the tree changes
+        lowVal = 20;
+        highVal = 120;
+        RecordId rid, deleted, next;
+        art.startScan(&lowVal, GTE, &highVal, LTE);
+        for (int i = 0; i < 10; i++)
+            art.scanNext(rid);
+        int key = 30;
+        art.lookup(&key, deleted);
+        art.deleteEntry(&key, deleted);
+        key = 31;
+        art.lookup(&key, next);
+        key = 50;
+        RecordId inserted = {999999, 1, 0};
+        art.insertEntry(&key, inserted);
+        art.scanNext(rid);
+        checkPassFail((rid == next), true)
+        int numScanned = 11;
+        RecordId batch[256];
+        for (std::size_t n; (n = art.scanNextBatch(batch, 256)) > 0; )
+            numScanned += n;
+        art.endScan();
+        checkPassFail(numScanned, 101)
+    }
+    {
+        BTreeIndex index(relationName, doubleIndexName, bufMgr, offsetof(tuple,d), DOUBLE);
+        ArtIndex art(relationName, bufMgr, offsetof(tuple,d), DOUBLE);
+        for (int i = 1; i <= 100; i++)
+        {
+            double key = -0.5 * i;
+            RecordId rid = {(PageId)(1000 + i), 1, 0};
+            index.insertEntry(&key, rid);
+            art.insertEntry(&key, rid);
+        }
+        double lowVal = -1000, highVal = 1000, zero = -0.0;
+        checkPassFail((scanAll(art, &lowVal, GTE, &highVal, LTE) == scanAll(index, &lowVal, GTE, &highVal, LTE)), true)
+        RecordId artRid, treeRid;
+        checkPassFail((art.lookup(&zero, artRid) && index.lookup(&zero, treeRid) && artRid == treeRid), true)
+    }
+    {
+        BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING);
+        ArtIndex art(relationName, bufMgr, offsetof(tuple,s), STRING);
+        const char *lowVal = "00100", *highVal = "00200";
+        checkPassFail((scanAll(art, lowVal, GTE, highVal, LTE) == scanAll(index, lowVal, GTE, highVal, LTE)), true)
+        checkPassFail((int)scanAll(art, lowVal, GT, highVal, LT).size(), 100)
+    }
+    File::remove(intIndexName);
+    File::remove(doubleIndexName);
+    File::remove(stringIndexName);
+    deleteRelation();
+}
+
+void test50()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Buffer statistics" << std::endl;
+    const std::string otherName = relationName + ".b";
+    {
+        PageFile fileA = PageFile::create(relationName);
+        PageFile fileB = PageFile::create(otherName);
+        for (int i = 0; i < 20; i++)
+        {
+            PageId pageNo;
+            fileA.writePage(pageNo, fileA.allocatePage(pageNo));
+            fileB.writePage(pageNo, fileB.allocatePage(pageNo));
+        }
+
+        BufMgr *statsBufMgr = new BufMgr(10, NULL, 1);
+        Page *page;
+        auto readPages = [&](PageFile &file, PageId first, PageId last, bool dirty) {
+            for (PageId pageNo = first; pageNo <= last; pageNo++)
+            {
+                statsBufMgr->readPage(&file, pageNo, page);
+                statsBufMgr->unPinPage(&file, pageNo, dirty);
+            }
+        };
+
+        // pages of A are read, then read again from the pool
+        readPages(fileA, 1, 5, false);
+        readPages(fileA, 1, 5, false);
+        BufStats statsA = statsBufMgr->getBufStats(&fileA);
+        checkPassFail(statsA.accesses, 10)
+        checkPassFail(statsA.misses, 5)
+        checkPassFail(statsA.hits, 5)
+        checkPassFail((int)statsA.bytesread, 5 * (int)Page::SIZE)
+        checkPassFail((statsA.hitRatio() == 0.5), true)
+
+        // changed pages of B take the free frames then evict the clean pages of A, and are evicted dirty in turn
+        readPages(fileB, 1, 10, true);
+        readPages(fileA, 6, 15, false);
+        statsA = statsBufMgr->getBufStats(&fileA);
+        BufStats statsB = statsBufMgr->getBufStats(&fileB);
+        checkPassFail(statsA.cleanevictions, 5)
+        checkPassFail(statsA.dirtyevictions, 0)
+        checkPassFail(statsB.dirtyevictions, 10)
+        checkPassFail(statsB.diskwrites, 10)
+        checkPassFail((int)statsB.byteswritten, 10 * (int)Page::SIZE)
+        checkPassFail(statsB.dirtyunpins, 10)
+        checkPassFail(statsA.diskwrites, 0)
+
+        // the pool sums the files, and every eviction has its sweep length
+        BufStats stats = statsBufMgr->getBufStats();
+        checkPassFail(stats.accesses, statsA.accesses + statsB.accesses)
+        checkPassFail(stats.cleanevictions + stats.dirtyevictions, 15)
+        int numSweeps = 0;
+        for (int i = 0; i < BufStats::SWEEP_BUCKETS; i++)
+            numSweeps += stats.sweeplengths[i];
+        checkPassFail(numSweeps, 15)
+
+        // with every frame pinned the next read fails
+        for (PageId pageNo = 1; pageNo <= 10; pageNo++)
+            statsBufMgr->readPage(&fileA, pageNo, page);
+        bool thrown = false;
+        try
+        {
+            statsBufMgr->readPage(&fileB, 20, page);
+        }
+        catch(const BufferExceededException &e)
+        {
+            thrown = true;
+        }
+        checkPassFail(thrown, true)
+        for (PageId pageNo = 1; pageNo <= 10; pageNo++)
+            statsBufMgr->unPinPage(&fileA, pageNo, false);
+        checkPassFail(statsBufMgr->getBufStats(&fileB).bufferexceeded, 1)
+        checkPassFail(statsBufMgr->getBufStats(&fileA).bufferexceeded, 0)
+
+        statsBufMgr->clearBufStats();
+        checkPassFail(statsBufMgr->getBufStats().accesses, 0)
+        checkPassFail(statsBufMgr->getBufStats(&fileA).hits, 0)
+        statsBufMgr->flushFile(&fileA);
+        statsBufMgr->flushFile(&fileB);
+        delete statsBufMgr;
+
+        // the sweep lengths of the other policies: LRU-K looks at every frame, 2Q and ARC at the pages of a
+        // list up to the first unpinned one, here past the pinned first page
+        ReplacementPolicy *policies[] = {new LruKPolicy(), new TwoQPolicy(), new ArcPolicy()};
+        const int buckets[] = {4, 1, 1};
+        for (int i = 0; i < 3; i++)
+        {
+            statsBufMgr = new BufMgr(10, policies[i], 1);
+            statsBufMgr->readPage(&fileA, 1, page);
+            readPages(fileA, 2, 10, false);
+            readPages(fileB, 1, 1, false);
+            checkPassFail(statsBufMgr->getBufStats().sweeplengths[buckets[i]], 1)
+            statsBufMgr->unPinPage(&fileA, 1, false);
+            statsBufMgr->flushFile(&fileA);
+            statsBufMgr->flushFile(&fileB);
+            delete statsBufMgr;
+        }
+    }
+    File::remove(relationName);
+    File::remove(otherName);
+}
+
+void test51()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Index operation metrics" << std::endl;
+    // the histogram knows any value within 1/16 of it
+    {
+        LatencyHistogram histogram;
+        for (int value = 1; value <= 1000; value++)
+            histogram.record(value);
+        LatencyHistogram::Snapshot snapshot = histogram.snapshot();
+        checkPassFail((int)snapshot.count, 1000)
+        checkPassFail((snapshot.percentile(50) >= 500 && snapshot.percentile(50) <= 500 + 500 / 16), true)
+        checkPassFail((snapshot.percentile(99) >= 990 && snapshot.percentile(99) <= 990 + 990 / 16), true)
+        checkPassFail((int)snapshot.percentile(100), 1000)
+        checkPassFail((snapshot.mean() == 500.5), true)
+    }
+
+    createRelationForward();
+    const int numInserted = 2000, numLookups = 100;
+    {
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+        index.setMetricsEnabled(true);
+        for (int i = 0; i < numInserted; i++)
+        {
+            int key = relationSize + i;
+            RecordId rid = {(PageId)(1000 + key), 1, 0};
+            index.insertEntry(&key, rid);
+        }
+        for (int key = 0; key < numLookups; key++)
+        {
+            RecordId rid;
+            index.lookup(&key, rid);
+        }
+        int lowVal = 0, highVal = 10, numFound = 0;
+        index.startScan(&lowVal, GTE, &highVal, LT);
+        try
+        {
+            while (true)
+            {
+                RecordId rid;
+                index.scanNext(rid);
+                numFound++;
+            }
+        }
+        catch(const IndexScanCompletedException &e)
+        {
+        }
+        index.endScan();
+
+        // every operation is counted, a lookup descending the tree once and pinning its leaf at least
+        // the appended keys go to the rightmost leaf without descending, but when it splits
+        IndexOpStats inserts = index.getOpStats(OP_INSERT);
+        IndexOpStats lookups = index.getOpStats(OP_LOOKUP);
+        checkPassFail((int)inserts.latency.count, numInserted)
+        checkPassFail((inserts.descents > 0 && inserts.descents < (std::uint64_t)numInserted / 10), true)
+        checkPassFail((int)lookups.latency.count, numLookups)
+        checkPassFail((int)lookups.descents, numLookups)
+        checkPassFail((lookups.pagesPinned >= (std::uint64_t)numLookups), true)
+        checkPassFail((int)index.getOpStats(OP_START_SCAN).latency.count, 1)
+        checkPassFail((int)index.getOpStats(OP_SCAN_NEXT).latency.count, numFound + 1)
+        checkPassFail((inserts.latency.percentile(50) <= inserts.latency.percentile(99)), true)
+        checkPassFail((inserts.latency.percentile(99) <= inserts.latency.max), true)
+
+        // appending keys splits the last leaf, each split being timed
+        std::vector<std::uint64_t> splits = index.getSplitsPerLevel();
+        checkPassFail((splits.size() >= 1 && splits[0] > 0), true)
+        std::uint64_t numSplits = 0;
+        for (std::uint64_t n : splits)
+            numSplits += n;
+        checkPassFail((index.getOpStats(OP_SPLIT).latency.count == numSplits), true)
+
+        // nothing is recorded once disabled, and clearing forgets everything
+        index.setMetricsEnabled(false);
+        RecordId rid;
+        index.lookup(&lowVal, rid);
+        checkPassFail((int)index.getOpStats(OP_LOOKUP).latency.count, numLookups)
+        index.clearMetrics();
+        checkPassFail((int)index.getOpStats(OP_INSERT).latency.count, 0)
+        checkPassFail((int)index.getSplitsPerLevel().size(), 0)
+    }
+    File::remove(intIndexName);
+    deleteRelation();
+}
+
+void test52()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Index statistics" << std::endl;
+    createRelationForward();
+    {
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+        const int numDuplicates = 3;
+        for (int n = 0; n < numDuplicates; n++)
+        {
+            int key = 7;
+            RecordId rid = {(PageId)(100000 + n), 1, 0};
+            index.insertEntry(&key, rid);
+        }
+
+        // every entry is counted, and the histogram is sorted between the least and greatest keys
+        const int numBuckets = 16;
+        IndexStats stats = index.collectStats(numBuckets);
+        checkPassFail((int)stats.numEntries, relationSize + numDuplicates)
+        checkPassFail((int)stats.distinctKeys, relationSize)
+        checkPassFail((int)stats.minKey.number(), 0)
+        checkPassFail((int)stats.maxKey.number(), relationSize - 1)
+        checkPassFail((int)stats.pagesPerLevel.size(), stats.height)
+        checkPassFail((stats.height >= 2 && stats.pagesPerLevel[0] > 1 && stats.pagesPerLevel.back() == 1), true)
+        checkPassFail((stats.leafFill > 0 && stats.nodeFill > 0), true)
+        checkPassFail((int)stats.histogram.size(), numBuckets + 1)
+        bool sorted = true;
+        for (int b = 0; b < numBuckets; b++)
+            sorted = sorted && stats.histogram[b].number() <= stats.histogram[b + 1].number();
+        checkPassFail(sorted, true)
+        double median = stats.histogram[numBuckets / 2].number();
+        checkPassFail((median > relationSize * 0.4 && median < relationSize * 0.6), true)
+
+        // the estimates follow the separator keys
+        int lowVal = 0, midVal = relationSize / 2, highVal = relationSize;
+        double half = index.estimateRange(&lowVal, GTE, &midVal, LT);
+        checkPassFail((half > 0.45 && half < 0.55), true)
+        double all = index.estimateRange(&lowVal, GTE, &highVal, LT);
+        checkPassFail((all > 0.99), true)
+        checkPassFail((index.estimateRange(&midVal, GT, &midVal, LT) == 0), true)
+        checkPassFail((index.estimateRange(&highVal, GTE, &lowVal, LTE) == 0), true)
+        bool thrown = false;
+        try
+        {
+            index.estimateRange(&lowVal, LT, &highVal, LT);
+        }
+        catch(const BadOpcodesException &e)
+        {
+            thrown = true;
+        }
+        checkPassFail(thrown, true)
+    }
+    File::remove(intIndexName);
+    deleteRelation();
+}
+
+void test53()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Online rebuild" << std::endl;
+    createRelationForwardSize(0);
+    const int numInserted = 20000;
+    {
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+        insertRelationRandom(&index, numInserted);
+        IndexStats before = index.collectStats();
+
+        // the leaves left half full by the random insertions are packed again
+        index.rebuild();
+        IndexStats after = index.collectStats();
+        checkPassFail((int)after.numEntries, numInserted)
+        checkPassFail((after.leafFill > 0.95 && after.leafFill > before.leafFill), true)
+        checkPassFail((after.pagesPerLevel[0] < before.pagesPerLevel[0]), true)
+        checkPassFail(intScan(&index,25,GT,40,LT), 14)
+        checkPassFail(intScan(&index,-3,GTE,numInserted,LT), numInserted)
+
+        // a lower fill factor leaves room for the next insertions, which reuse the freed pages
+        index.rebuild(0.5);
+        IndexStats half = index.collectStats();
+        checkPassFail((half.leafFill > 0.45 && half.leafFill < 0.55), true)
+        insertRelationRandom(&index, numInserted);
+        checkPassFail(intScan(&index,25,GT,40,LT), 28)
+        checkPassFail(intScan(&index,-3,GTE,numInserted,LT), 2 * numInserted)
+    }
+    {
+        // the new root is recorded in the meta page
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+        checkPassFail(intScan(&index,-3,GTE,numInserted,LT), 2 * numInserted)
+    }
+    File::remove(intIndexName);
+    deleteRelation();
+}
+
+void test54()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Append splits" << std::endl;
+    createRelationForwardSize(0);
+    const int numInserted = 100000;
+    {
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+        index.setMetricsEnabled(true);
+        for (int key = 0; key < numInserted; key++)
+        {
+            RecordId rid = {(PageId)(key / 64 + 1), (SlotId)(key % 64 + 1), 0};
+            index.insertEntry(&key, rid);
+        }
+
+        // increasing keys leave the leaves full, and only descend the tree when the rightmost leaf splits
+        IndexStats stats = index.collectStats();
+        checkPassFail((int)stats.numEntries, numInserted)
+        checkPassFail((stats.leafFill > 0.95), true)
+        IndexOpStats inserts = index.getOpStats(OP_INSERT);
+        checkPassFail((inserts.descents <= stats.pagesPerLevel[0] + 1), true)
+
+        // the keys inside the range are inserted as usual
+        int key = numInserted / 2;
+        RecordId rid = {(PageId)(numInserted + 1), 1, 0};
+        index.insertEntry(&key, rid);
+        bool found = true;
+        for (int k = 0; k < numInserted; k += 97)
+        {
+            RecordId foundRid;
+            found = found && index.lookup(&k, foundRid) && foundRid.page_number == (PageId)(k / 64 + 1)
+                    && foundRid.slot_number == (SlotId)(k % 64 + 1);
+        }
+        checkPassFail(found, true)
+        checkPassFail((int)index.collectStats().numEntries, numInserted + 1)
+    }
+    File::remove(intIndexName);
+    deleteRelation();
+}
+
+void test55()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Backward scans" << std::endl;
+    const int numRecords = 20000;
+    createRelationForwardSize(numRecords);
+    auto scanRids = [](BTreeIndex &index, const void *lowVal, Operator lowOp, const void *highVal, Operator highOp,
+                       ScanDirection direction) {
+        std::vector<RecordId> rids;
+        RecordId batch[100];
+        index.startScan(lowVal, lowOp, highVal, highOp, direction);
+        for (std::size_t n; (n = index.scanNextBatch(batch, 100)) > 0; )
+        {
+            rids.insert(rids.end(), batch, batch + n);
+        }
+        index.endScan();
+        return rids;
+    };
+    auto reversed = [](std::vector<RecordId> rids) {
+        std::reverse(rids.begin(), rids.end());
+        return rids;
+    };
+    {
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+
+        // the duplicates of a key span several leaves, or fill a posting list
+        for (int n = 0; n < 3000; n++)
+        {
+            int key = 777;
+            RecordId rid = {(PageId)(100000 + n / 64), (SlotId)(n % 64 + 1), 0};
+            index.insertEntry(&key, rid);
+        }
+
+        // the entries come in the reverse order of a forward scan, with each bound
+        int bounds[][2] = {{-1, numRecords}, {500, 1000}, {776, 778}, {777, 777}, {776, 777}, {0, 0}};
+        bool same = true;
+        for (auto &b : bounds)
+        {
+            for (Operator lowOp : {GT, GTE})
+            {
+                for (Operator highOp : {LT, LTE})
+                {
+                    std::vector<RecordId> forward, backward;
+                    try
+                    {
+                        forward = scanRids(index, &b[0], lowOp, &b[1], highOp, SCAN_FORWARD);
+                    }
+                    catch (const NoSuchKeyFoundException &e)
+                    {
+                    }
+                    try
+                    {
+                        backward = scanRids(index, &b[0], lowOp, &b[1], highOp, SCAN_BACKWARD);
+                    }
+                    catch (const NoSuchKeyFoundException &e)
+                    {
+                    }
+                    same = same && backward == reversed(forward);
+                }
+            }
+        }
+        checkPassFail(same, true)
+        int low = -1, high = numRecords;
+        checkPassFail((int)scanRids(index, &low, GT, &high, LT, SCAN_BACKWARD).size(), numRecords + 3000)
+
+        // the latest entries are read from the last leaf, one at a time
+        bufMgr->clearBufStats();
+        RecordId rid;
+        index.startScan(&low, GT, &high, LT, SCAN_BACKWARD);
+        for (int n = 0; n < 10; n++)
+        {
+            index.scanNext(rid);
+        }
+        index.endScan();
+        checkPassFail((bufMgr->getBufStats().accesses < 10), true)
+
+        // a range with no entry does not start
+        low = numRecords;
+        high = 2 * numRecords;
+        bool thrown = false;
+        try
+        {
+            index.startScan(&low, GTE, &high, LTE, SCAN_BACKWARD);
+        }
+        catch (const NoSuchKeyFoundException &e)
+        {
+            thrown = true;
+        }
+        checkPassFail(thrown, true)
+    }
+    {
+        BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING);
+        char lowVal[100], highVal[100];
+        sprintf(lowVal, "%05d string record", 1234);
+        sprintf(highVal, "%05d string record", 5678);
+        std::vector<RecordId> backward = scanRids(index, lowVal, GTE, highVal, LT, SCAN_BACKWARD);
+        checkPassFail((int)backward.size(), 5678 - 1234)
+        checkPassFail((backward == reversed(scanRids(index, lowVal, GTE, highVal, LT, SCAN_FORWARD))), true)
+    }
+    File::remove(intIndexName);
+    File::remove(stringIndexName);
+    deleteRelation();
+}
+
+void test56()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Limit and offset scans" << std::endl;
+    const int numRecords = 20000;
+    createRelationForwardSize(numRecords);
+    auto scanRids = [](BTreeIndex &index, int low, int high, ScanDirection direction, std::size_t offset,
+                       std::size_t limit) {
+        std::vector<RecordId> rids;
+        RecordId batch[100];
+        try
+        {
+            index.startScan(&low, GTE, &high, LT, direction, offset, limit);
+        }
+        catch (const NoSuchKeyFoundException &e)
+        {
+            return rids;
+        }
+        for (std::size_t n; (n = index.scanNextBatch(batch, 100)) > 0; )
+        {
+            rids.insert(rids.end(), batch, batch + n);
+        }
+        index.endScan();
+        return rids;
+    };
+    {
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+        for (int n = 0; n < 3000; n++)
+        {
+            int key = 777;
+            RecordId rid = {(PageId)(100000 + n / 64), (SlotId)(n % 64 + 1), 0};
+            index.insertEntry(&key, rid);
+        }
+
+        // each page of a scan is the slice of the whole scan after the offset, in both directions
+        bool same = true;
+        for (ScanDirection direction : {SCAN_FORWARD, SCAN_BACKWARD})
+        {
+            std::vector<RecordId> all = scanRids(index, 100, 15000, direction, 0, SCAN_NO_LIMIT);
+            for (std::size_t offset : {0, 1, 500, 677, 3700, 17800, 17899, 17900})
+            {
+                for (std::size_t limit : {1, 10, 1000, 5000})
+                {
+                    std::vector<RecordId> page = scanRids(index, 100, 15000, direction, offset, limit);
+                    std::size_t end = std::min(all.size(), offset + limit);
+                    same = same && page == std::vector<RecordId>(all.begin() + std::min(offset, end), all.begin() + end);
+                }
+            }
+            same = same && all.size() == 17900;
+        }
+        checkPassFail(same, true)
+
+        // a scan stops at its limit, a record at a time as well
+        int low = 0, high = numRecords;
+        std::vector<RecordId> first = scanRids(index, low, high, SCAN_FORWARD, 0, 12);
+        index.startScan(&low, GTE, &high, LT, SCAN_FORWARD, 10, 2);
+        RecordId rid;
+        index.scanNext(rid);
+        index.scanNext(rid);
+        checkPassFail((rid == first[11]), true)
+        bool completed = false;
+        try
+        {
+            index.scanNext(rid);
+        }
+        catch (const IndexScanCompletedException &e)
+        {
+            completed = true;
+        }
+        checkPassFail(completed, true)
+        checkPassFail((int)index.scanSkip(5), 0)
+        index.endScan();
+
+        // the leaves past the limit are not read ahead
+        bufMgr->clearBufStats();
+        checkPassFail((int)scanRids(index, 0, numRecords, SCAN_FORWARD, 0, 10).size(), 10)
+        checkPassFail((bufMgr->getBufStats().accesses < 10), true)
+
+        // the counts of ranges match their scans
+        checkPassFail((int)index.countRange(&low, GTE, &high, LT), numRecords + 3000)
+        low = 700;
+        high = 800;
+        checkPassFail((int)index.countRange(&low, GT, &high, LTE), 100 + 3000)
+        low = 777;
+        high = 777;
+        checkPassFail((int)index.countRange(&low, GTE, &high, LTE), 3001)
+        checkPassFail((int)index.countRange(&low, GT, &high, LTE), 0)
+    }
+    File::remove(intIndexName);
+    deleteRelation();
+}
+
+void test57()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Ghost lists and record deletion" << std::endl;
+    int files[2];
+    auto keyOf = [&](int n) { return PageKey{reinterpret_cast<const File *>(&files[n % 2]), (PageId)(n / 2 + 1)}; };
+
+    // a full list forgets its least recent page
+    GhostList ghosts;
+    ghosts.init(4);
+    for (int n = 0; n < 6; n++)
+    {
+        ghosts.pushBack(keyOf(n));
+    }
+    checkPassFail((int)ghosts.size(), 4)
+    checkPassFail((ghosts.contains(keyOf(1)) || !ghosts.contains(keyOf(2)) || !ghosts.contains(keyOf(5))), false)
+    checkPassFail((ghosts.erase(keyOf(3)) && !ghosts.erase(keyOf(3)) && !ghosts.contains(keyOf(3))), true)
+    ghosts.popFront();
+    checkPassFail((ghosts.contains(keyOf(2)) || (int)ghosts.size() != 2), false)
+
+    // the list keeps the order of a plain FIFO under pushes, removals from the middle and pops
+    ghosts.init(100);
+    std::vector<PageKey> model;
+    bool same = true;
+    for (int n = 0; n < 20000; n++)
+    {
+        if (n % 3 == 0 && !model.empty())
+        {
+            std::size_t i = (n * 7919) % model.size();
+            same = same && ghosts.erase(model[i]);
+            model.erase(model.begin() + i);
+        }
+        else if (n % 5 == 0 && !model.empty())
+        {
+            ghosts.popFront();
+            model.erase(model.begin());
+        }
+        ghosts.pushBack(keyOf(n));
+        model.push_back(keyOf(n));
+        if (model.size() > 100)
+        {
+            model.erase(model.begin());
+        }
+        same = same && ghosts.size() == model.size() && ghosts.contains(model.front()) && !ghosts.contains(keyOf(n + 1));
+    }
+    while (!model.empty())
+    {
+        same = same && ghosts.contains(model.front());
+        ghosts.popFront();
+        same = same && !ghosts.contains(model.front());
+        model.erase(model.begin());
+    }
+    checkPassFail((same && ghosts.size() == 0), true)
+
+    // the records before a deleted one are moved over it
+    Page page;
+    RecordId first = page.insertRecord(std::string(100, 'a'));
+    RecordId second = page.insertRecord(std::string(200, 'b'));
+    RecordId third = page.insertRecord(std::string(300, 'c'));
+    page.deleteRecord(second);
+    checkPassFail((page.getRecord(first) == std::string(100, 'a') && page.getRecord(third) == std::string(300, 'c')), true)
+}
+
+void test58()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Interleaved batch lookups" << std::endl;
+    createRelationRandom();
+    {
+        // a tree of several levels, with keys beyond the relation inserted one by one
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+        const int numKeys = 60000;
+        for (int key = relationSize; key < numKeys; key++)
+        {
+            RecordId rid = {(PageId)(key / 64 + 1), (SlotId)(key % 64 + 1), 0};
+            index.insertEntry(&key, rid);
+        }
+
+        // random keys, with misses and repeats, agree with single lookups
+        std::vector<int> keys;
+        for (int n = 0; n < 20000; n++)
+        {
+            keys.push_back((int)(random() % (numKeys + 2000)) - 1000);
+        }
+        keys.insert(keys.end(), keys.begin(), keys.begin() + 100);
+        std::vector<RecordId> outRids(keys.size());
+        std::unique_ptr<bool[]> found(new bool[keys.size()]);
+        int numResults = index.lookupBatch(keys.data(), keys.size(), outRids.data(), found.get());
+        int numExpected = 0;
+        bool same = true;
+        for (std::size_t i = 0; i < keys.size(); i++)
+        {
+            RecordId outRid;
+            bool hit = index.lookup(&keys[i], outRid);
+            same = same && found[i] == hit && (!hit || outRid == outRids[i]);
+            numExpected += keys[i] >= 0 && keys[i] < numKeys;
+        }
+        checkPassFail(same, true)
+        checkPassFail(numResults, numExpected)
+
+        // batches smaller than the number of descents in flight
+        numResults = index.lookupBatch(keys.data(), 3, outRids.data(), found.get());
+        checkPassFail((numResults == found[0] + found[1] + found[2]), true)
+    }
+    File::remove(intIndexName);
+
+    {
+        // string keys, half of them missing
+        BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING);
+        std::vector<std::string> strings;
+        for (int n = 0; n < 2000; n++)
+        {
+            char s[64];
+            sprintf(s, "%05d string record", (int)(random() % (2 * relationSize)));
+            strings.push_back(s);
+        }
+        std::vector<const char *> keys;
+        for (const std::string &s : strings)
+        {
+            keys.push_back(s.c_str());
+        }
+        std::vector<RecordId> outRids(keys.size());
+        std::unique_ptr<bool[]> found(new bool[keys.size()]);
+        int numResults = index.lookupBatch(keys.data(), keys.size(), outRids.data(), found.get());
+        int numFlagged = 0;
+        bool same = true;
+        for (std::size_t i = 0; i < keys.size(); i++)
+        {
+            RecordId outRid;
+            bool hit = index.lookup(keys[i], outRid);
+            same = same && found[i] == hit && (!hit || outRid == outRids[i]);
+            numFlagged += found[i];
+        }
+        checkPassFail(same, true)
+        checkPassFail((numResults == numFlagged && numResults > 0 && numResults < (int)keys.size()), true)
+    }
+    File::remove(stringIndexName);
+    deleteRelation();
+}
+
+void test59()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "NUMA sub-pools" << std::endl;
+    BufMgr *sharedBufMgr = bufMgr;
+    bufMgr = new BufMgr(400, NULL, 0, false, true);
+    std::uint32_t numNodes = bufMgr->getNumNodes();
+    checkPassFail((numNodes >= 1 && numNodes <= bufMgr->getNumPartitions()), true)
+
+    // the frames of a node are consecutive, the first node holding the first frame and the last the last one
+    bool ordered = bufMgr->nodeOf(&bufMgr->bufPool[0]) == 0
+        && bufMgr->nodeOf(&bufMgr->bufPool[bufMgr->getNumBufs() - 1]) == numNodes - 1;
+    for (std::uint32_t i = 1; i < bufMgr->getNumBufs(); i++)
+    {
+        ordered = ordered && bufMgr->nodeOf(&bufMgr->bufPool[i]) >= bufMgr->nodeOf(&bufMgr->bufPool[i - 1]);
+    }
+    checkPassFail(ordered, true)
+
+    // the statistics of the nodes add up to those of the pool
+    createRelationRandom();
+    bufMgr->clearBufStats();
+    indexTests();
+    BufStats total = bufMgr->getBufStats();
+    BufStats nodes;
+    for (std::uint32_t node = 0; node < numNodes; node++)
+    {
+        nodes.add(bufMgr->getNodeStats(node));
+    }
+    checkPassFail((nodes.accesses == total.accesses && nodes.diskreads == total.diskreads && total.accesses > 0), true)
+    checkPassFail((total.remoteaccesses <= total.accesses && (numNodes > 1 || total.remoteaccesses == 0)), true)
+    deleteRelation();
+    delete bufMgr;
+    bufMgr = sharedBufMgr;
+}
+
+void test60()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Lookup filter" << std::endl;
+    createRelationRandom();
+    {
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+        index.setLookupFilter(10);
+
+        // the keys of the index are all found, and most missing ones read no page
+        RecordId rid;
+        int numFound = 0;
+        for (int key = 0; key < relationSize; key++)
+        {
+            numFound += index.lookup(&key, rid);
+        }
+        checkPassFail(numFound, relationSize)
+        bufMgr->clearBufStats();
+        numFound = 0;
+        for (int key = relationSize; key < 3 * relationSize; key++)
+        {
+            numFound += index.lookup(&key, rid);
+        }
+        checkPassFail(numFound, 0)
+        checkPassFail((bufMgr->getBufStats().accesses < relationSize / 10), true)
+
+        // inserted keys are added to the filter, deleted ones stay in it but are not found
+        int key = 3 * relationSize;
+        RecordId inserted = {1, 1, 0};
+        index.insertEntry(&key, inserted);
+        checkPassFail((index.lookup(&key, rid) && rid == inserted), true)
+        std::vector<int> keys = {key + 1, 7, key, -5};
+        index.insertEntries(&keys[0], &inserted, 1);
+        checkPassFail(index.lookup(&keys[0], rid), true)
+        checkPassFail(index.deleteEntry(&key, inserted), true)
+        checkPassFail(index.lookup(&key, rid), false)
+
+        // batch lookups skip the keys ruled out
+        std::vector<RecordId> outRids(keys.size());
+        std::unique_ptr<bool[]> found(new bool[keys.size()]);
+        checkPassFail((int)index.lookupBatch(keys.data(), keys.size(), outRids.data(), found.get()), 2)
+        checkPassFail((found[0] && found[1] && !found[2] && !found[3]), true)
+
+        // with the filter dropped, a missing key reads pages again
+        index.setLookupFilter(0);
+        bufMgr->clearBufStats();
+        key = 4 * relationSize;
+        checkPassFail(index.lookup(&key, rid), false)
+        checkPassFail((bufMgr->getBufStats().accesses > 0), true)
+    }
+    File::remove(intIndexName);
+
+    {
+        // string keys, with the insert buffer applied when the filter is set
+        BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING);
+        index.setInsertBuffer(64);
+        const char *added = "zz added";
+        RecordId inserted = {1, 2, 0};
+        index.insertEntry(added, inserted);
+        index.setLookupFilter(10);
+        checkPassFail((int)index.getNumBufferedEntries(), 0)
+        RecordId rid;
+        checkPassFail((index.lookup(added, rid) && rid == inserted), true)
+        checkPassFail(index.lookup("00042 string record", rid), true)
+        checkPassFail(index.lookup("zz missing", rid), false)
+        index.setInsertBuffer(0);
+    }
+    File::remove(stringIndexName);
+    deleteRelation();
+}
+
+void test61()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Partitioned index" << std::endl;
+    createRelationRandom();
+    const int attrOffset = offsetof(tuple,i);
+    const std::vector<std::string> hashNames = {relationName + ".h0", relationName + ".h1", relationName + ".h2"};
+    const std::vector<std::string> rangeNames = {relationName + ".r0", relationName + ".r1", relationName + ".r2"};
+
+    // count the entries of a scan, checking that they come in key order
+    auto scanCount = [&](PartitionedIndex &index, int lowVal, int highVal) {
+        try
+        {
+            index.startScan(&lowVal, GTE, &highVal, LT);
+        }
+        catch(const NoSuchKeyFoundException &e)
+        {
+            return 0;
+        }
+        int numResults = 0;
+        int lastKey = INT_MIN;
+        bool ordered = true;
+        try
+        {
+            while (true)
+            {
+                RecordId rid;
+                index.scanNext(rid);
+                Page *page;
+                bufMgr->readPage(file1, rid.page_number, page);
+                int key = reinterpret_cast<const RECORD*>(page->getRecord(rid).data())->i;
+                bufMgr->unPinPage(file1, rid.page_number, false);
+                ordered = ordered && key >= lastKey && key >= lowVal && key < highVal;
+                lastKey = key;
+                numResults++;
+            }
+        }
+        catch(const IndexScanCompletedException &e)
+        {
+        }
+        index.endScan();
+        return ordered ? numResults : -1;
+    };
+
+    {
+        // the keys spread over the partitions by hash, each found in its own
+        PartitionedIndex index(relationName, bufMgr, attrOffset, INTEGER, hashNames);
+        checkPassFail((int)index.getNumPartitions(), 3)
+        int numFound = 0;
+        for (int key = 0; key < relationSize; key++)
+        {
+            RecordId rid;
+            numFound += index.lookup(&key, rid) && index.getPartition(index.partitionOf(&key)).lookup(&key, rid);
+        }
+        checkPassFail(numFound, relationSize)
+        bool balanced = true;
+        for (std::size_t p = 0; p < index.getNumPartitions(); p++)
+        {
+            int lowVal = 0, highVal = relationSize;
+            BTreeCursor cursor(&index.getPartition(p));
+            cursor.startScan(&lowVal, GTE, &highVal, LT);
+            std::size_t size = cursor.scanSkip(relationSize);
+            balanced = balanced && size > relationSize / 4 && size < relationSize / 2;
+        }
+        checkPassFail(balanced, true)
+
+        // scans merge the partitions in key order
+        checkPassFail(scanCount(index, 25, 40), 15)
+        checkPassFail(scanCount(index, 0, relationSize), relationSize)
+        checkPassFail(scanCount(index, relationSize + 10, relationSize + 20), 0)
+
+        // insertions and deletions go to the partition of their key
+        int key = relationSize + 15;
+        RecordId rid = {1, 1, 0};
+        index.insertEntry(&key, rid);
+        RecordId outRid;
+        checkPassFail((index.getPartition(index.partitionOf(&key)).lookup(&key, outRid) && outRid.page_number == rid.page_number && outRid.slot_number == rid.slot_number), true)
+        checkPassFail(index.deleteEntry(&key, rid), true)
+        checkPassFail(index.lookup(&key, rid), false)
+    }
+    {
+        // the partitions are opened again from their files
+        PartitionedIndex index(relationName, bufMgr, attrOffset, INTEGER, hashNames);
+        checkPassFail(scanCount(index, 1000, 3000), 2000)
+    }
+
+    // but not under another scheme or number of partitions, which the manifest records
+    auto openThrows = [&](const std::vector<std::string> &names, PartitionScheme scheme, const int *splitKeys) {
+        try
+        {
+            PartitionedIndex index(relationName, bufMgr, attrOffset, INTEGER, names, scheme, splitKeys);
+        }
+        catch(const BadIndexInfoException &e)
+        {
+            return true;
+        }
+        return false;
+    };
+    const int hashSplits[] = {1000, 3000};
+    checkPassFail(openThrows(hashNames, PARTITION_RANGE, hashSplits), true)
+    checkPassFail(openThrows({hashNames[0], hashNames[1]}, PARTITION_HASH, NULL), true)
+    File::remove(hashNames[0] + ".0.parts");
+    checkPassFail(openThrows(hashNames, PARTITION_HASH, NULL), true)
+    for (const std::string &name : hashNames)
+    {
+        File::remove(name + ".0");
+    }
+
+    {
+        // range partitions hold the keys between their split keys, and scans only read those they overlap
+        const int splitKeys[] = {1000, 3000};
+        PartitionedIndex index(relationName, bufMgr, attrOffset, INTEGER, rangeNames, PARTITION_RANGE, splitKeys);
+        int key = 999;
+        checkPassFail((int)index.partitionOf(&key), 0)
+        key = 1000;
+        checkPassFail((int)index.partitionOf(&key), 1)
+        key = 4999;
+        checkPassFail((int)index.partitionOf(&key), 2)
+        checkPassFail(scanCount(index, 500, 3500), 3000)
+        checkPassFail(scanCount(index, 1200, 1300), 100)
+        checkPassFail(scanCount(index, -100, relationSize + 100), relationSize)
+        RecordId rid;
+        key = 2500;
+        checkPassFail(index.getPartition(1).lookup(&key, rid), true)
+        checkPassFail(index.getPartition(0).lookup(&key, rid), false)
+    }
+    {
+        // nor with other split keys
+        const int splitKeys[] = {1000, 3000};
+        const int otherSplits[] = {1000, 2000};
+        checkPassFail(openThrows(rangeNames, PARTITION_RANGE, otherSplits), true)
+        PartitionedIndex index(relationName, bufMgr, attrOffset, INTEGER, rangeNames, PARTITION_RANGE, splitKeys);
+        checkPassFail(scanCount(index, 500, 3500), 3000)
+    }
+    File::remove(rangeNames[0] + ".0.parts");
+    for (const std::string &name : rangeNames)
+    {
+        File::remove(name + ".0");
+    }
+
+    // split keys must increase
+    bool thrown = false;
+    try
+    {
+        const int splitKeys[] = {3000, 1000};
+        PartitionedIndex index(relationName, bufMgr, attrOffset, INTEGER, rangeNames, PARTITION_RANGE, splitKeys);
+    }
+    catch(const BadIndexInfoException &e)
+    {
+        thrown = true;
+    }
+    checkPassFail(thrown, true)
+    deleteRelation();
+}
+
+void test62()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Batched index join" << std::endl;
+    createRelationRandom();
+
+    // the key of a record of the relation
+    auto keyOf = [&](const RecordId &rid) {
+        Page *page;
+        bufMgr->readPage(file1, rid.page_number, page);
+        int key = reinterpret_cast<const RECORD*>(page->getRecord(rid).data())->i;
+        bufMgr->unPinPage(file1, rid.page_number, false);
+        return key;
+    };
+
+    {
+        // a self join pairs every record with itself, each batch ordered by inner record
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+        IndexJoin join(relationName, bufMgr, offsetof(tuple,i), &index, 300);
+        std::vector<JoinPair> pairs;
+        int numPairs = 0;
+        int numBatches = 0;
+        bool matching = true;
+        bool ordered = true;
+        while (join.nextBatch(pairs))
+        {
+            numBatches++;
+            for (std::size_t j = 0; j < pairs.size(); j++)
+            {
+                numPairs++;
+                matching = matching && pairs[j].inner == pairs[j].outer && keyOf(pairs[j].inner) == keyOf(pairs[j].outer);
+                ordered = ordered && (j == 0 || pairs[j - 1].inner < pairs[j].inner);
+            }
+        }
+        checkPassFail(numPairs, relationSize)
+        checkPassFail(numBatches, (relationSize + 299) / 300)
+        checkPassFail((int)join.getNumOuter(), relationSize)
+        checkPassFail(matching, true)
+        checkPassFail(ordered, true)
+        checkPassFail(join.nextBatch(pairs), false)
+
+        // all the entries of a key are found, across leaves and posting lists, in key order
+        for (int n = 0; n < 2000; n++)
+        {
+            int key = 7;
+            RecordId rid = {(PageId)(100000 + n / 100), (SlotId)(n % 100 + 1), 0};
+            index.insertEntry(&key, rid);
+        }
+        std::vector<int> keys = {relationSize + 1, 8, 7, -1, 8};
+        std::vector<std::pair<std::size_t, RecordId>> matches;
+        checkPassFail((int)index.lookupBatchAll(&keys[0], keys.size(), matches), 2003)
+        checkPassFail((int)matches.size(), 2003)
+        bool sorted = true;
+        int numSeven = 0;
+        for (std::size_t j = 0; j < matches.size(); j++)
+        {
+            numSeven += matches[j].first == 2;
+            sorted = sorted && (j == 0 || keys[matches[j - 1].first] < keys[matches[j].first]
+                    || (keys[matches[j - 1].first] == keys[matches[j].first] && !(matches[j].second < matches[j - 1].second)));
+        }
+        checkPassFail(numSeven, 2001)
+        checkPassFail(sorted, true)
+
+        // each record of key 7 now pairs with all of them
+        IndexJoin dupJoin(relationName, bufMgr, offsetof(tuple,i), &index);
+        numPairs = 0;
+        while (dupJoin.nextBatch(pairs))
+        {
+            numPairs += pairs.size();
+        }
+        checkPassFail(numPairs, relationSize + 2000)
+    }
+    File::remove(intIndexName);
+
+    {
+        // the keys of a string index are probed as char strings
+        BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING);
+        IndexJoin join(relationName, bufMgr, offsetof(tuple,s), &index, 1000);
+        std::vector<JoinPair> pairs;
+        int numPairs = 0;
+        bool matching = true;
+        while (join.nextBatch(pairs))
+        {
+            for (const JoinPair &pair : pairs)
+            {
+                numPairs++;
+                matching = matching && pair.inner == pair.outer;
+            }
+        }
+        checkPassFail(numPairs, relationSize)
+        checkPassFail(matching, true)
+    }
+    File::remove(stringIndexName);
+    deleteRelation();
+}
+
+void test63()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Files of the original layout" << std::endl;
+    createRelationForward();
+    bufMgr->flushFile(file1);
+    delete file1;
+    downgradeLayout(relationName);
+
+    // the records are read where the original layout has them
+    file1 = new PageFile(relationName, false);
+    checkPassFail((int)file1->layoutVersion(), (int)FILE_LAYOUT_V1)
+    auto countRecords = [&]() {
+        FileScan fscan(relationName, bufMgr);
+        int numRecords = 0;
+        bool ordered = true;
+        try
+        {
+            while (true)
+            {
+                RecordId rid;
+                fscan.scanNext(rid);
+                ordered = ordered && reinterpret_cast<const RECORD*>(fscan.getRecordView().data())->i == numRecords;
+                numRecords++;
+            }
+        }
+        catch(const EndOfFileException &e)
+        {
+        }
+        return ordered ? numRecords : -1;
+    };
+    checkPassFail(countRecords(), relationSize)
+
+    // the pages appended keep the layout, the header being written back in its 16 bytes
+    for (int i = relationSize; i < relationSize + 500; i++)
+    {
+        sprintf(record1.s, "%05d string record", i);
+        record1.i = i;
+        record1.d = (double)i;
+        file1->insertRecord(std::string(reinterpret_cast<char*>(&record1), sizeof(record1)));
+    }
+    bufMgr->flushFile(file1);
+    delete file1;
+    file1 = new PageFile(relationName, false);
+    checkPassFail((int)file1->layoutVersion(), (int)FILE_LAYOUT_V1)
+    checkPassFail(countRecords(), relationSize + 500)
+    PageId lastPage = 0;
+    for (FileIterator iter = file1->begin(); iter != file1->end(); ++iter)
+    {
+        lastPage = std::max(lastPage, (*iter).page_number());
+    }
+    std::ifstream raw(relationName, std::ios::binary | std::ios::ate);
+    checkPassFail(((std::size_t)raw.tellg() == 4 * sizeof(PageId) + lastPage * Page::SIZE), true)
+
+    // an index is built from the relation, in the current layout
+    {
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+        checkPassFail(intScan(&index, 25, GT, 40, LT), 14)
+        checkPassFail(intScan(&index, relationSize + 100, GTE, relationSize + 200, LT), 100)
+    }
+    {
+        BlobFile indexFile = BlobFile::open(intIndexName);
+        checkPassFail((int)indexFile.layoutVersion(), (int)FILE_LAYOUT_VERSION)
+    }
+    File::remove(intIndexName);
+    deleteRelation();
+}
+
+void test64()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Indexes of format version 1" << std::endl;
+    createRelationRandom();
+    const std::string indexName = relationName + "." + std::to_string(offsetof(tuple,i));
+    createLegacyIndex(indexName, offsetof(tuple,i));
+    downgradeLayout(indexName);
+    {
+        // the nodes are upgraded as they are read, the scans and lookups finding the entries of the file
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+        checkPassFail(intScan(&index, 25, GT, 40, LT), 14)
+        checkPassFail(intScan(&index, 3000, GTE, 4000, LT), 1000)
+        checkPassFail(intScan(&index, relationSize - 10, GT, relationSize, LT), 9)
+        int numFound = 0;
+        for (int key = 0; key < relationSize; key++)
+        {
+            RecordId rid;
+            numFound += index.lookup(&key, rid);
+        }
+        checkPassFail(numFound, relationSize)
+
+        // the full upgraded leaves split as entries are inserted in them
+        index.setMetricsEnabled(true);
+        index.clearMetrics();
+        for (int key = 1000; key < 4000; key++)
+        {
+            RecordId rid = {(PageId)(100000 + key / 100), (SlotId)(key % 100 + 1), 0};
+            index.insertEntry(&key, rid);
+        }
+        checkPassFail((index.getSplitsPerLevel().size() > 0 && index.getSplitsPerLevel()[0] >= 4), true)
+        int low = 0, high = relationSize;
+        checkPassFail((int)index.countRange(&low, GTE, &high, LT), relationSize + 3000)
+        checkPassFail(intScan(&index, 25, GT, 40, LT), 14)
+        checkPassFail(intScan(&index, 4000, GTE, 4500, LT), 500)
+    }
+    {
+        // the file keeps its layout, and its upgraded nodes open again
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+        int low = 1000, high = 4000;
+        checkPassFail((int)index.countRange(&low, GTE, &high, LT), 6000)
+        checkPassFail(intScan(&index, relationSize - 10, GT, relationSize, LT), 9)
+    }
+    {
+        BlobFile indexFile = BlobFile::open(indexName);
+        checkPassFail((int)indexFile.layoutVersion(), (int)FILE_LAYOUT_V1)
+    }
+    File::remove(indexName);
+    deleteRelation();
+}
+
+void test65()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "File I/O errors" << std::endl;
+
+    // a file that cannot be opened for writing is not taken as an empty one
+    int error = 0;
+    try
+    {
+        BlobFile directory = BlobFile::open(".");
+    }
+    catch(const FileIoException &e)
+    {
+        error = e.error();
+    }
+    checkPassFail(error, EISDIR)
+
+    // writes to a full device fail instead of being dropped, and so does their sync
+    BlobFile full = BlobFile::open("/dev/full");
+    Page page;
+    error = 0;
+    try
+    {
+        full.writePage(1, page);
+    }
+    catch(const FileIoException &e)
+    {
+        error = e.error();
+    }
+    checkPassFail(error, ENOSPC)
+    bool thrown = false;
+    try
+    {
+        full.sync();
+    }
+    catch(const FileIoException &e)
+    {
+        thrown = true;
+    }
+    checkPassFail(thrown, true)
+}
+
+void test66()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Node cache budget" << std::endl;
+    BufMgr *sharedBufMgr = bufMgr;
+    bufMgr = new BufMgr(16);
+    createRelationForward();
+    {
+        // the indexes of a buffer manager share the pins of their node caches
+        BTreeIndex intIndex(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+        BTreeIndex doubleIndex(relationName, doubleIndexName, bufMgr, offsetof(tuple,d), DOUBLE);
+        BTreeIndex stringIndex(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING);
+        RecordId rid;
+        int intKey = 7;
+        double doubleKey = 7;
+        char stringKey[STRINGSIZE + 1];
+        sprintf(stringKey, "%05d string record", 7);
+        checkPassFail((intIndex.lookup(&intKey, rid) && doubleIndex.lookup(&doubleKey, rid)
+                       && stringIndex.lookup(stringKey, rid)), true)
+        std::size_t numCached = intIndex.getNumCachedNodes() + doubleIndex.getNumCachedNodes()
+                                + stringIndex.getNumCachedNodes();
+        checkPassFail(numCached, 16 / BufMgr::HELD_PIN_FRACTION)
+        checkPassFail(bufMgr->getNumHeldPins(), numCached)
+
+        // a pool with every other frame pinned takes back the pins of the caches
+        PageFile file = PageFile::open(relationName);
+        std::vector<PageId> pageNums;
+        bool thrown = false;
+        try
+        {
+            for (PageId pageNum = 1; pageNum <= 16 - numCached + 1; pageNum++)
+            {
+                Page *page;
+                bufMgr->readPage(&file, pageNum, page);
+                pageNums.push_back(pageNum);
+            }
+        }
+        catch(const BufferExceededException &e)
+        {
+            thrown = true;
+        }
+        checkPassFail(thrown, false)
+        checkPassFail(bufMgr->getNumHeldPins(), 0)
+        checkPassFail((intIndex.getNumCachedNodes() + doubleIndex.getNumCachedNodes()
+                       + stringIndex.getNumCachedNodes()), 0)
+        for (PageId pageNum : pageNums)
+        {
+            bufMgr->unPinPage(&file, pageNum, false);
+        }
+
+        // a freed node is unpinned along with it
+        checkPassFail(intIndex.lookup(&intKey, rid), true)
+        checkPassFail(intIndex.getNumCachedNodes(), 1)
+        intIndex.rebuild(1.0);
+        checkPassFail(intIndex.getNumCachedNodes(), 0)
+        checkPassFail(bufMgr->getNumHeldPins(), 0)
+        checkPassFail(intIndex.lookup(&intKey, rid), true)
+    }
+    File::remove(intIndexName);
+    File::remove(doubleIndexName);
+    File::remove(stringIndexName);
+    deleteRelation();
+    delete bufMgr;
+    bufMgr = sharedBufMgr;
+}
+
+void test67()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Runs of the insert buffer" << std::endl;
+    createRelationForward();
+    const int numKeys = 20000;
+    std::vector<int> keys;
+    for (int i = 0; i < numKeys; i++)
+        keys.push_back(relationSize + i);
+    for (int i = numKeys - 1; i > 0; i--)
+        std::swap(keys[i], keys[random() % (i + 1)]);
+    {
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+        index.setInsertBuffer(2 * numKeys);
+        for (int key : keys)
+        {
+            RecordId rid = {(PageId)(1000 + key), 2, 0};
+            index.insertEntry(&key, rid);
+        }
+        checkPassFail((int)index.getNumBufferedEntries(), numKeys)
+
+        // a key inserted again with a lower record ID is found with it, wherever its entries lie
+        for (int key = relationSize; key < relationSize + numKeys; key += 7)
+        {
+            RecordId rid = {(PageId)(1000 + key), 1, 0};
+            index.insertEntry(&key, rid);
+        }
+        RecordId rid;
+        int numFound = 0;
+        for (int key = relationSize; key < relationSize + numKeys; key++)
+            numFound += index.lookup(&key, rid) && rid.page_number == (PageId)(1000 + key)
+                        && rid.slot_number == ((key - relationSize) % 7 == 0 ? 1 : 2);
+        checkPassFail(numFound, numKeys)
+
+        // the entries taken out of the buffer are found no more, and dropped once the runs are merged
+        int numDeleted = 0;
+        for (int key = relationSize; key < relationSize + numKeys; key += 3)
+        {
+            RecordId deleted = {(PageId)(1000 + key), 2, 0};
+            numDeleted += index.deleteEntry(&key, deleted);
+        }
+        checkPassFail(numDeleted, (numKeys + 2) / 3)
+        const int numEntries = numKeys + (numKeys + 6) / 7 - numDeleted;
+        checkPassFail((int)index.getNumBufferedEntries(), numEntries)
+        numFound = 0;
+        for (int key = relationSize; key < relationSize + numKeys; key++)
+            numFound += index.lookup(&key, rid);
+        checkPassFail(numFound, numKeys - numDeleted + (numKeys + 20) / 21)
+        index.flushInsertBuffer();
+        checkPassFail((int)index.getNumBufferedEntries(), 0)
+        int lowVal = relationSize, highVal = relationSize + numKeys;
+        checkPassFail((int)index.countRange(&lowVal, GTE, &highVal, LT), numEntries)
+    }
+    File::remove(intIndexName);
+    deleteRelation();
+}
+
+void test68()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Runs of the delta index" << std::endl;
+    createRelationForward();
+    const int numKeys = 20000, numDeleted = 500;
+    std::vector<int> keys;
+    for (int i = 0; i < numKeys; i++)
+        keys.push_back(relationSize + i);
+    for (int i = numKeys - 1; i > 0; i--)
+        std::swap(keys[i], keys[random() % (i + 1)]);
+    // number of entries in [lowVal, highVal), merging the delta with the tree
+    auto countEntries = [](BTreeIndex &index, int lowVal, int highVal) {
+        RecordId rids[256];
+        int numFound = 0;
+        index.startScan(&lowVal, GTE, &highVal, LT);
+        for (std::size_t n; (n = index.scanNextBatch(rids, 256)) > 0; )
+            numFound += n;
+        index.endScan();
+        return numFound;
+    };
+    {
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+        std::vector<RecordId> rids(numDeleted);
+        for (int key = 0; key < numDeleted; key++)
+            index.lookup(&key, rids[key]);
+        index.setDeltaIndex(4 * numKeys);
+        for (int key : keys)
+        {
+            RecordId rid = {(PageId)(1000 + key), 1, 0};
+            index.insertEntry(&key, rid);
+        }
+
+        // deletions of entries of the tree, and of entries of the delta, whichever run they lie in
+        int numRemoved = 0;
+        for (int key = 0; key < numDeleted; key++)
+            numRemoved += index.deleteEntry(&key, rids[key]);
+        for (int key = relationSize; key < relationSize + numKeys; key += 2)
+        {
+            RecordId rid = {(PageId)(1000 + key), 1, 0};
+            numRemoved += index.deleteEntry(&key, rid);
+        }
+        checkPassFail(numRemoved, numDeleted + numKeys / 2)
+        int key = 0;
+        checkPassFail(index.deleteEntry(&key, rids[key]), false)
+        checkPassFail((int)index.getNumBufferedEntries(), numDeleted + numKeys / 2)
+
+        // an entry deleted from the delta or from the tree is inserted again
+        key = relationSize;
+        RecordId rid = {(PageId)(1000 + key), 1, 0};
+        index.insertEntry(&key, rid);
+        key = 1;
+        index.insertEntry(&key, rids[key]);
+        checkPassFail((int)index.getNumBufferedEntries(), numDeleted + numKeys / 2 + 1)
+
+        const int numEntries = relationSize - numDeleted + 1 + numKeys / 2 + 1;
+        checkPassFail(countEntries(index, 0, relationSize + numKeys), numEntries)
+        int numFound = 0;
+        for (key = 0; key < relationSize + numKeys; key++)
+            numFound += index.lookup(&key, rid);
+        checkPassFail(numFound, numEntries)
+        index.flushInsertBuffer();
+        checkPassFail(countEntries(index, 0, relationSize + numKeys), numEntries)
+    }
+    File::remove(intIndexName);
+    deleteRelation();
+}
+
+void test69()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Recovery of the free pages of a blob file" << std::endl;
+    const std::string blobName = relationName + ".blob";
+    const std::string logName = relationName + ".log";
+    std::remove(logName.c_str());
+    {
+        // pages 3 and 5 of the file are free, 5 heading the chain, when it is last synced before a crash
+        BlobFile file = BlobFile::create(blobName);
+        PageId pageNo;
+        for (int i = 0; i < 6; i++)
+            file.allocatePage(pageNo);
+        file.deletePage(3);
+        file.deletePage(5);
+        file.sync();
+        copyFile(blobName, blobName + ".crash");
+
+        // then page 5 is allocated again, and its changes reach the log
+        BufMgr *logBufMgr = new BufMgr(10);
+        LogManager *log = new LogManager(logName);
+        logBufMgr->setLog(log);
+        log->attach(&file);
+        Page *page;
+        logBufMgr->allocPage(&file, pageNo, page);
+        checkPassFail((int)pageNo, 5)
+        std::memset(reinterpret_cast<char *>(page), 'x', Page::SIZE);
+        logBufMgr->unPinPage(&file, pageNo, true);
+        log->flush(log->getEndLsn());
+        copyFile(logName, logName + ".crash");
+        logBufMgr->flushFile(&file);
+        log->detach(&file);
+        logBufMgr->setLog(NULL);
+        delete log;
+        delete logBufMgr;
+    }
+
+    // recovery writes page 5 back and keeps page 3 free, neither being allocated again over the other
+    copyFile(blobName + ".crash", blobName);
+    copyFile(logName + ".crash", logName);
+    LogManager *log = new LogManager(logName);
+    checkPassFail(log->getNumRecovered(), 1)
+    delete log;
+    {
+        BlobFile file = BlobFile::open(blobName);
+        Page five = file.readPage(5);
+        checkPassFail((reinterpret_cast<const char *>(&five)[100] == 'x'), true)
+        PageId pageNo;
+        file.allocatePage(pageNo);
+        checkPassFail((int)pageNo, 3)
+        file.allocatePage(pageNo);
+        checkPassFail((int)pageNo, 7)
+    }
+    File::remove(blobName);
+    std::remove((blobName + ".crash").c_str());
+    std::remove((logName + ".crash").c_str());
+    std::remove(logName.c_str());
+
+    // a file whose name its records cannot hold is not logged
+    const std::string longName = [] {
+        std::string name;
+        for (int i = 0; i < 130; i++)
+            name += "./";
+        return name + "blobA";
+    }();
+    {
+        BlobFile file = BlobFile::create(longName);
+        LogManager *log = new LogManager(logName);
+        int error = 0;
+        try
+        {
+            log->attach(&file);
+        }
+        catch(const FileIoException &e)
+        {
+            error = e.error();
+        }
+        checkPassFail(error, ENAMETOOLONG)
+        checkPassFail(log->isAttached(&file), false)
+        delete log;
+    }
+    File::remove(longName);
+    std::remove(logName.c_str());
+}
+
+void test70()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Buffer hash table" << std::endl;
+    const std::string nameA = relationName + ".ha", nameB = relationName + ".hb";
+    {
+        BlobFile fileA = BlobFile::create(nameA);
+        BlobFile fileB = BlobFile::create(nameB);
+        const PageId numPages = 1000;
+
+        // whether the pages of a file in [first, last] are all present, each in frame base + its number
+        auto allFound = [](BufHashTbl &table, const File *file, PageId first, PageId last, FrameId base) {
+            bool found = true;
+            for (PageId pageNo = first; pageNo <= last; pageNo++)
+            {
+                FrameId frameNo = 0;
+                found = found && table.find(file, pageNo, frameNo) && frameNo == base + pageNo;
+            }
+            return found;
+        };
+        // whether they are all absent
+        auto noneFound = [](BufHashTbl &table, const File *file, PageId first, PageId last) {
+            bool none = true;
+            for (PageId pageNo = first; pageNo <= last; pageNo++)
+            {
+                FrameId frameNo;
+                none = none && !table.find(file, pageNo, frameNo);
+            }
+            return none;
+        };
+
+        // a table sized for a few entries grows to hold those of both files
+        BufHashTbl table(4);
+        for (PageId pageNo = 1; pageNo <= numPages; pageNo++)
+        {
+            table.insert(&fileA, pageNo, pageNo);
+            table.insert(&fileB, pageNo, numPages + pageNo);
+        }
+        checkPassFail(allFound(table, &fileA, 1, numPages, 0), true)
+        checkPassFail(allFound(table, &fileB, 1, numPages, numPages), true)
+        checkPassFail(noneFound(table, &fileA, numPages + 1, 2 * numPages), true)
+        bool thrown = false;
+        try
+        {
+            table.insert(&fileA, 10, 0);
+        }
+        catch(const HashAlreadyPresentException &e)
+        {
+            thrown = true;
+        }
+        checkPassFail(thrown, true)
+
+        // a run of consecutive pages and every other page are removed, the entries after them being shifted
+        // back without losing any
+        for (PageId pageNo = 200; pageNo <= 700; pageNo++)
+            table.remove(&fileA, pageNo);
+        for (PageId pageNo = 2; pageNo <= numPages; pageNo += 2)
+            table.remove(&fileB, pageNo);
+        checkPassFail((noneFound(table, &fileA, 200, 700) && allFound(table, &fileA, 1, 199, 0)
+                       && allFound(table, &fileA, 701, numPages, 0)), true)
+        bool odd = true;
+        for (PageId pageNo = 1; pageNo <= numPages; pageNo++)
+            odd = odd && (pageNo % 2 == 0 ? noneFound(table, &fileB, pageNo, pageNo)
+                                          : allFound(table, &fileB, pageNo, pageNo, numPages));
+        checkPassFail(odd, true)
+        thrown = false;
+        try
+        {
+            table.remove(&fileA, 300);
+        }
+        catch(const HashNotFoundException &e)
+        {
+            thrown = true;
+        }
+        checkPassFail(thrown, true)
+
+        // the pages removed are inserted again in other frames
+        for (PageId pageNo = 200; pageNo <= 700; pageNo++)
+            table.insert(&fileA, pageNo, 5 * numPages + pageNo);
+        checkPassFail((allFound(table, &fileA, 200, 700, 5 * numPages) && allFound(table, &fileA, 701, numPages, 0)), true)
+
+        // threads insert, find and remove the pages of their own ranges at once
+        BufHashTbl shared(4);
+        std::vector<std::thread> threads;
+        std::atomic<int> numFound(0);
+        for (PageId t = 0; t < 4; t++)
+        {
+            threads.emplace_back([&, t]() {
+                PageId first = t * numPages + 1, last = (t + 1) * numPages;
+                for (PageId pageNo = first; pageNo <= last; pageNo++)
+                    shared.insert(&fileA, pageNo, pageNo);
+                for (PageId pageNo = first; pageNo <= last; pageNo += 3)
+                    shared.remove(&fileA, pageNo);
+                for (PageId pageNo = first; pageNo <= last; pageNo++)
+                {
+                    FrameId frameNo = 0;
+                    bool found = shared.find(&fileA, pageNo, frameNo);
+                    numFound += found == ((pageNo - first) % 3 != 0) && (!found || frameNo == pageNo);
+                }
+            });
+        }
+        for (std::thread &thread : threads)
+            thread.join();
+        checkPassFail(numFound.load(), 4 * (int)numPages)
+    }
+    File::remove(nameA);
+    File::remove(nameB);
+}
+
+void test71()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Cached file headers" << std::endl;
+    const std::string pageName = relationName + ".pf", blobName = relationName + ".bf";
+
+    // the header on disk, as a crash would leave it
+    auto headerOnDisk = [](const std::string &name) {
+        FileHeader header;
+        std::ifstream in(name, std::ios::binary);
+        in.read(reinterpret_cast<char *>(&header), sizeof(header));
+        return header;
+    };
+
+    {
+        // pages written without a sync, one of them deleted; the header changes stay in memory until a sync
+        PageFile file = PageFile::create(pageName);
+        PageId numPagesOnDisk = headerOnDisk(pageName).num_pages;
+        for (int i = 0; i < 5; i++)
+        {
+            PageId pageNo;
+            Page page = file.allocatePage(pageNo);
+            page.insertRecord(std::string("record ") + std::to_string(pageNo));
+            file.writePage(pageNo, page);
+        }
+        file.deletePage(3);
+        checkPassFail(headerOnDisk(pageName).num_pages, numPagesOnDisk)
+
+        // another File on the same file shares the header
+        PageFile other = PageFile::open(pageName);
+        checkPassFail(other.numPages(), file.numPages())
+        file.sync();
+        checkPassFail(headerOnDisk(pageName).num_pages, file.numPages())
+        checkPassFail(headerOnDisk(pageName).num_free_pages, 1)
+    }
+    {
+        // the header is written back when the last File closes, without a sync
+        PageFile file = PageFile::create(pageName + ".2");
+        PageId pageNo;
+        for (int i = 0; i < 3; i++)
+            file.writePage(pageNo, file.allocatePage(pageNo));
+        file.deletePage(2);
+    }
+    {
+        PageFile file = PageFile::open(pageName + ".2");
+        checkPassFail((int)file.numPages(), 4)
+        PageId pageNo;
+        file.allocatePage(pageNo);
+        checkPassFail((int)pageNo, 2)
+    }
+    {
+        // the pages written before closing are read back, the deleted one being allocated again
+        PageFile file = PageFile::open(pageName);
+        checkPassFail((int)file.numPages(), 6)
+        int numUsed = 0;
+        for (FileIterator iter = file.begin(); iter != file.end(); ++iter)
+            numUsed++;
+        checkPassFail(numUsed, 4)
+        RecordId rid = {5, 1, 0};
+        checkPassFail(file.readPage(5).getRecord(rid), std::string("record 5"))
+        PageId pageNo;
+        file.allocatePage(pageNo);
+        checkPassFail((int)pageNo, 3)
+    }
+    {
+        // so are those of a blob file, and its chain of free pages
+        BlobFile file = BlobFile::create(blobName);
+        PageId pageNo;
+        for (int i = 0; i < 3; i++)
+            file.allocatePage(pageNo);
+        Page page;
+        std::memset(reinterpret_cast<char *>(&page), 'b', Page::SIZE);
+        file.writePage(2, page);
+        file.deletePage(1);
+    }
+    {
+        BlobFile file = BlobFile::open(blobName);
+        Page page = file.readPage(2);
+        checkPassFail((reinterpret_cast<const char *>(&page)[Page::SIZE - 1] == 'b'), true)
+        PageId pageNo;
+        file.allocatePage(pageNo);
+        checkPassFail((int)pageNo, 1)
+        file.allocatePage(pageNo);
+        checkPassFail((int)pageNo, 4)
+    }
+    File::remove(pageName);
+    File::remove(pageName + ".2");
+    File::remove(blobName);
+}
+
+void test72()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Reading and writing pages in place" << std::endl;
+    const std::string pageName = relationName + ".pf", blobName = relationName + ".bf";
+    {
+        // a page written from and read into caller pages keeps its number and records
+        PageFile file = PageFile::create(pageName);
+        PageId pageNo;
+        Page page = file.allocatePage(pageNo);
+        RecordId first = page.insertRecord(std::string("first"));
+        file.writePageFrom(pageNo, page);
+        Page into;
+        file.readPageInto(pageNo, into);
+        checkPassFail((into.page_number() == pageNo), true)
+        checkPassFail(into.getRecord(first), std::string("first"))
+
+        // the page read in place is written back in place, as the buffer manager does with its frames
+        RecordId second = into.insertRecord(std::string("second"));
+        file.writePageFrom(pageNo, into);
+        checkPassFail(file.readPage(pageNo).getRecord(second), std::string("second"))
+        checkPassFail(file.readPage(pageNo).getRecord(first), std::string("first"))
+
+        // a deleted page is not read
+        file.deletePage(pageNo);
+        bool thrown = false;
+        try
+        {
+            file.readPageInto(pageNo, into);
+        }
+        catch(const InvalidPageException &e)
+        {
+            thrown = true;
+        }
+        checkPassFail(thrown, true)
+    }
+    {
+        // the bytes of a blob page go through unchanged
+        BlobFile file = BlobFile::create(blobName);
+        PageId pageNo;
+        file.allocatePage(pageNo);
+        std::unique_ptr<Page> page(new Page());
+        char *bytes = reinterpret_cast<char *>(page.get());
+        for (std::size_t i = 0; i < Page::SIZE; i++)
+            bytes[i] = (char)(i * 7);
+        file.writePageFrom(pageNo, *page);
+        std::unique_ptr<Page> into(new Page());
+        file.readPageInto(pageNo, *into);
+        checkPassFail(std::memcmp(into.get(), page.get(), Page::SIZE), 0)
+
+        // and so do those of a frame of the buffer pool, written back when the file is flushed
+        BufMgr *frameBufMgr = new BufMgr(10);
+        Page *frame;
+        frameBufMgr->readPage(&file, pageNo, frame);
+        checkPassFail(std::memcmp(frame, page.get(), Page::SIZE), 0)
+        reinterpret_cast<char *>(frame)[0] = 'f';
+        frameBufMgr->unPinPage(&file, pageNo, true);
+        frameBufMgr->flushFile(&file);
+        delete frameBufMgr;
+        file.readPageInto(pageNo, *into);
+        bytes[0] = 'f';
+        checkPassFail(std::memcmp(into.get(), page.get(), Page::SIZE), 0)
+    }
+    File::remove(pageName);
+    File::remove(blobName);
+}
+
+void test73()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Batched lookups of repeated keys" << std::endl;
+    createRelationRandom();
+    {
+        // the entries of a covering index stay in the leaves, so those of a hot key go on over several leaves
+        std::vector<IncludedAttribute> includeD(1, IncludedAttribute{(int)offsetof(tuple, d), (int)sizeof(double)});
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, BULKLOAD_FILL_FACTOR,
+                         INDEX_READ_WRITE, includeD);
+        insertHotKeysRandom(&index, 3000, 1);
+
+        // every occurrence of the hot key finds all of its entries, though the first one leaves the leaf
+        // latched past them
+        std::vector<int> keys = {0, 5, 0, relationSize + 1, 0};
+        std::vector<std::pair<std::size_t, RecordId>> matches;
+        checkPassFail((int)index.lookupBatchAll(&keys[0], keys.size(), matches), 3 * 3001 + 1)
+        std::vector<int> numMatches(keys.size(), 0);
+        bool same = true;
+        for (std::size_t j = 0; j < matches.size(); j++)
+        {
+            numMatches[matches[j].first]++;
+            // the entries of a repeated key are those of its first occurrence, in the same order
+            same = same && (keys[matches[j].first] != 0 || j < 3001 || matches[j].second == matches[j % 3001].second);
+        }
+        checkPassFail(numMatches[0], 3001)
+        checkPassFail(numMatches[1], 1)
+        checkPassFail(numMatches[2], 3001)
+        checkPassFail(numMatches[3], 0)
+        checkPassFail(numMatches[4], 3001)
+        checkPassFail(same, true)
+    }
+    File::remove(intIndexName);
+    deleteRelation();
+}
+
+void test74()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Scans through a ring of frames" << std::endl;
+    const std::string blobName = relationName + ".ring";
+    {
+        BlobFile file = BlobFile::create(blobName);
+        PageId pageNo;
+        for (int i = 0; i < 200; i++)
+            file.allocatePage(pageNo);
+
+        // the pages in use before the scan
+        BufMgr *ringBufMgr = new BufMgr(64, NULL, 1);
+        std::set<Page*> residentFrames;
+        Page *page;
+        for (PageId p = 1; p <= 16; p++)
+        {
+            ringBufMgr->readPage(&file, p, page);
+            residentFrames.insert(page);
+            ringBufMgr->unPinPage(&file, p, false);
+        }
+
+        // a scan of more pages than the pool holds takes no more frames than those of its ring
+        BufRing ring;
+        std::set<Page*> ringFrames;
+        for (PageId p = 17; p <= 200; p++)
+        {
+            ringBufMgr->readPage(&file, p, page, &ring);
+            ringFrames.insert(page);
+            ringBufMgr->unPinPage(&file, p, false);
+        }
+        checkPassFail((ringFrames.size() <= ringBufMgr->ringSize(ring)), true)
+        bool disjoint = true;
+        for (Page *frame : ringFrames)
+            disjoint = disjoint && residentFrames.count(frame) == 0;
+        checkPassFail(disjoint, true)
+
+        // and the pages in use before it are still in the pool
+        ringBufMgr->clearBufStats();
+        for (PageId p = 1; p <= 16; p++)
+        {
+            ringBufMgr->readPage(&file, p, page);
+            ringBufMgr->unPinPage(&file, p, false);
+        }
+        checkPassFail((int)ringBufMgr->getBufStats().hits, 16)
+        checkPassFail((int)ringBufMgr->getBufStats().diskreads, 0)
+
+        // the same scan without a ring goes through the whole pool and evicts them
+        for (PageId p = 17; p <= 200; p++)
+        {
+            ringBufMgr->readPage(&file, p, page);
+            ringBufMgr->unPinPage(&file, p, false);
+        }
+        ringBufMgr->clearBufStats();
+        for (PageId p = 1; p <= 16; p++)
+        {
+            ringBufMgr->readPage(&file, p, page);
+            ringBufMgr->unPinPage(&file, p, false);
+        }
+        checkPassFail((ringBufMgr->getBufStats().diskreads > 0), true)
+        delete ringBufMgr;
+    }
+    File::remove(blobName);
+}
+
+void test75()
+{
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Reads without the partition latch" << std::endl;
+    const std::string blobName = relationName + ".gate";
+
+    // a blob file whose reads of one page wait until they are let through
+    struct GatedFile : public BlobFile
+    {
+        std::atomic<bool> started, open;
+        GatedFile(const BlobFile &file) : BlobFile(file), started(false), open(false) {}
+        void readPageInto(const PageId pageNo, Page &dst) const override
+        {
+            if (pageNo == 1)
+            {
+                const_cast<std::atomic<bool> &>(started) = true;
+                while (!open)
+                    std::this_thread::yield();
+            }
+            BlobFile::readPageInto(pageNo, dst);
+        }
+    };
+    // wait up to a second for a flag
+    auto waitFor = [](const std::atomic<bool> &flag) {
+        for (int i = 0; i < 1000 && !flag; i++)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        return flag.load();
+    };
+    {
+        GatedFile file(BlobFile::create(blobName));
+        PageId pageNo;
+        for (int i = 0; i < 4; i++)
+            file.allocatePage(pageNo);
+        BufMgr *gateBufMgr = new BufMgr(16, NULL, 1);
+        Page *page;
+        gateBufMgr->readPage(&file, 2, page);
+        gateBufMgr->unPinPage(&file, 2, false);
+        gateBufMgr->clearBufStats();
+
+        // a thread reading page 1 holds no latch of the single partition while its read is held up
+        Page *first = nullptr, *second = nullptr;
+        std::thread reader([&]() { gateBufMgr->readPage(&file, 1, first); });
+        checkPassFail(waitFor(file.started), true)
+        std::atomic<bool> hit(false);
+        std::thread other([&]() {
+            Page *otherPage;
+            gateBufMgr->readPage(&file, 2, otherPage);
+            gateBufMgr->unPinPage(&file, 2, false);
+            hit = true;
+        });
+        checkPassFail(waitFor(hit), true)
+
+        // and another thread asking for page 1 waits for that read rather than reading it again
+        std::atomic<bool> waited(false);
+        std::thread waiter([&]() {
+            gateBufMgr->readPage(&file, 1, second);
+            waited = true;
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        checkPassFail(waited.load(), false)
+        file.open = true;
+        reader.join();
+        other.join();
+        waiter.join();
+        checkPassFail((first != nullptr && first == second), true)
+        checkPassFail((int)gateBufMgr->getBufStats().diskreads, 1)
+        gateBufMgr->unPinPage(&file, 1, false);
+        gateBufMgr->unPinPage(&file, 1, false);
+        gateBufMgr->flushFile(&file);
+
+        // a prefetch is issued once, and the first pin of its page waits for the read rather than reading it
+        gateBufMgr->clearBufStats();
+        checkPassFail(gateBufMgr->prefetchPage(&file, 3), true)
+        checkPassFail(gateBufMgr->prefetchPage(&file, 3), false)
+        checkPassFail(gateBufMgr->prefetchPage(&file, 5), false)
+        gateBufMgr->readPage(&file, 3, page);
+        gateBufMgr->unPinPage(&file, 3, false);
+        checkPassFail((int)gateBufMgr->getBufStats().diskreads, 1)
+        checkPassFail((int)gateBufMgr->getBufStats().hits, 1)
+
+        // a flush waits for the reads of the file still in flight, and drops their pages
+        checkPassFail(gateBufMgr->prefetchPages(&file, {2, 4}), 2u)
+        gateBufMgr->flushFile(&file);
+        gateBufMgr->clearBufStats();
+        gateBufMgr->readPage(&file, 4, page);
+        gateBufMgr->unPinPage(&file, 4, false);
+        checkPassFail((int)gateBufMgr->getBufStats().diskreads, 1)
+        delete gateBufMgr;
+    }
+    File::remove(blobName);
+}
+
+// -----------------------------------------------------------------------------
+// createRelationForward
+// -----------------------------------------------------------------------------
+
+void createRelationForward()
+{
+	std::vector<RecordId> ridVec;
+  // destroy any old copies of relation file
+	try
+	{
+		File::remove(relationName);
+	}
+	catch(const FileNotFoundException &e)
+	{
+	}
+
+  file1 = new PageFile(relationName, true);
+
+  // initialize all of record1.s to keep purify happy
+  memset(record1.s, ' ', sizeof(record1.s));
+
+  // Insert a bunch of tuples into the relation, the file finding a page with room for each.
+  for(int i = 0; i < relationSize; i++ )
+	{
+    sprintf(record1.s, "%05d string record", i);
+    record1.i = i;
+    record1.d = (double)i;
+    std::string new_data(reinterpret_cast<char*>(&record1), sizeof(record1));
+
+		file1->insertRecord(new_data);
+  }
+}
+
+// -----------------------------------------------------------------------------
+// createRelationBackward
+// -----------------------------------------------------------------------------
+
+void createRelationBackward()
+{
+  // destroy any old copies of relation file
+	try
+	{
+		File::remove(relationName);
+	}
+	catch(const FileNotFoundException &e)
+	{
+	}
+  file1 = new PageFile(relationName, true);
+
+  // initialize all of record1.s to keep purify happy
+  memset(record1.s, ' ', sizeof(record1.s));
+	PageId new_page_number;
+  Page new_page = file1->allocatePage(new_page_number);
+
+  // Insert a bunch of tuples into the relation.
+  for(int i = relationSize - 1; i >= 0; i-- )
+	{
+    sprintf(record1.s, "%05d string record", i);
+    record1.i = i;
+    record1.d = i;
+
+    std::string new_data(reinterpret_cast<char*>(&record1), sizeof(RECORD));
+
+		while(1)
+		{
+			try
+			{
+    		new_page.insertRecord(new_data);
+				break;
+			}
+			catch(const InsufficientSpaceException &e)
+			{
+				file1->writePage(new_page_number, new_page);
+  			new_page = file1->allocatePage(new_page_number);
+			}
+		}
+  }
+
+	file1->writePage(new_page_number, new_page);
+}
+
+// -----------------------------------------------------------------------------
+// createRelationRandom
+// -----------------------------------------------------------------------------
+
+void createRelationRandom()
+{
+  // destroy any old copies of relation file
+	try
+	{
+		File::remove(relationName);
+	}
+	catch(const FileNotFoundException &e)
+	{
+	}
+  file1 = new PageFile(relationName, true);
+
+  // initialize all of record1.s to keep purify happy
+  memset(record1.s, ' ', sizeof(record1.s));
+	PageId new_page_number;
+  Page new_page = file1->allocatePage(new_page_number);
+
+  // insert records in random order
+
+  std::vector<int> intvec(relationSize);
+  for( int i = 0; i < relationSize; i++ )
+  {
+    intvec[i] = i;
+  }
+
+  long pos;
+  int val;
+	int i = 0;
+  while( i < relationSize )
+  {
+    pos = random() % (relationSize-i);
+    val = intvec[pos];
+    sprintf(record1.s, "%05d string record", val);
+    record1.i = val;
+    record1.d = val;
+
+    std::string new_data(reinterpret_cast<char*>(&record1), sizeof(RECORD));
+
+		while(1)
+		{
+			try
+			{
+    		new_page.insertRecord(new_data);
+				break;
+			}
+			catch(const InsufficientSpaceException &e)
+			{
+      	file1->writePage(new_page_number, new_page);
+  			new_page = file1->allocatePage(new_page_number);
+			}
+		}
+
+		int temp = intvec[relationSize-1-i];
+		intvec[relationSize-1-i] = intvec[pos];
+		intvec[pos] = temp;
+		i++;
+  }
+  
+	file1->writePage(new_page_number, new_page);
+}
+
+// -----------------------------------------------------------------------------
+// createRelationNegative
+// -----------------------------------------------------------------------------
+
+void createRelationNegative()
+{
+    std::vector<RecordId> ridVec;
+    // destroy any old copies of relation file
+    try
+    {
+        File::remove(relationName);
+    }
+    catch(const FileNotFoundException &e)
+    {
+    }
+
+    file1 = new PageFile(relationName, true);
+
+    // initialize all of record1.s to keep purify happy
+    memset(record1.s, ' ', sizeof(record1.s));
+    PageId new_page_number;
+    Page new_page = file1->allocatePage(new_page_number);
+
+    // Insert a bunch of tuples into the relation.
+    for(int i = -relationSize; i < relationSize; i++ )
+    {
+        sprintf(record1.s, "%05d string record", i);
+        record1.i = i;
+        record1.d = (double)i;
+        std::string new_data(reinterpret_cast<char*>(&record1), sizeof(record1));
+
+        while(1)
+        {
+            try
+            {
+                new_page.insertRecord(new_data);
+                break;
+            }
+            catch(const InsufficientSpaceException &e)
+            {
+                file1->writePage(new_page_number, new_page);
+                new_page = file1->allocatePage(new_page_number);
+            }
+        }
+    }
+
+    file1->writePage(new_page_number, new_page);
+}
+
+// -----------------------------------------------------------------------------
+// createRelationForwardSize
+// -----------------------------------------------------------------------------
+
+void createRelationForwardSize(int size)
+{
+    std::vector<RecordId> ridVec;
+    // destroy any old copies of relation file
+    try
+    {
+        File::remove(relationName);
+    }
+    catch(const FileNotFoundException &e)
+    {
+    }
+
+    file1 = new PageFile(relationName, true);
+
+
+    memset(record1.s, ' ', sizeof(record1.s));
+    PageId new_page_number;
+    Page new_page = file1->allocatePage(new_page_number);
+
+    // Insert a bunch of tuples into the relation.
+    for(int i = 0; i < size; i++ )
+    {
+        sprintf(record1.s, "%05d string record", i);
+        record1.i = i;
+        record1.d = (double)i;
+        std::string new_data(reinterpret_cast<char*>(&record1), sizeof(record1));
+
+        while(1)
+        {
+            try
+            {
+                new_page.insertRecord(new_data);
+                break;
+            }
+            catch(const InsufficientSpaceException &e)
+            {
+                file1->writePage(new_page_number, new_page);
+                new_page = file1->allocatePage(new_page_number);
+            }
+        }
+    }
+
+    file1->writePage(new_page_number, new_page);
+}
+
+// -----------------------------------------------------------------------------
+// createRelationBackwardGap
+// -----------------------------------------------------------------------------
+
+void createRelationBackwardGap(int size)
+{
+    {
+        // destroy any old copies of relation file
+        try
+        {
+            File::remove(relationName);
+        }
+        catch(const FileNotFoundException &e)
+        {
+        }
+        file1 = new PageFile(relationName, true);
+
+
+        memset(record1.s, ' ', sizeof(record1.s));
+        PageId new_page_number;
+        Page new_page = file1->allocatePage(new_page_number);
+
+        // Insert a bunch of tuples into the relation.
+        for(int i = size - 1; i >= 0; i = i - 2 )
+        {
+            sprintf(record1.s, "%05d string record", i);
+            record1.i = i;
+            record1.d = i;
+
+            std::string new_data(reinterpret_cast<char*>(&record1), sizeof(RECORD));
+
+            while(1)
+            {
+                try
+                {
+                    new_page.insertRecord(new_data);
+                    break;
+                }
+                catch(const InsufficientSpaceException &e)
+                {
+                    file1->writePage(new_page_number, new_page);
+                    new_page = file1->allocatePage(new_page_number);
+                }
+            }
+        }
+
+        file1->writePage(new_page_number, new_page);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// createRelationBackwardGap
+// -----------------------------------------------------------------------------
+
+void createRelationForwardRange(int lower, int upper)
+{
+    {
+        std::vector<RecordId> ridVec;
+        // destroy any old copies of relation file
+        try
+        {
+            File::remove(relationName);
+        }
+        catch(const FileNotFoundException &e)
+        {
+        }
+
+        file1 = new PageFile(relationName, true);
+
+
+        memset(record1.s, ' ', sizeof(record1.s));
+        PageId new_page_number;
+        Page new_page = file1->allocatePage(new_page_number);
+
+        // Insert a bunch of tuples into the relation.
+        for(int i = lower; i <= upper; i++ )
+        {
+            sprintf(record1.s, "%05d string record", i);
+            record1.i = i;
+            record1.d = (double)i;
+            std::string new_data(reinterpret_cast<char*>(&record1), sizeof(record1));
+
+            while(1)
+            {
+                try
+                {
+                    new_page.insertRecord(new_data);
+                    break;
+                }
+                catch(const InsufficientSpaceException &e)
+                {
+                    file1->writePage(new_page_number, new_page);
+                    new_page = file1->allocatePage(new_page_number);
+                }
+            }
+        }
+
+        file1->writePage(new_page_number, new_page);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// insertRelationRandom
+// -----------------------------------------------------------------------------
+
+void insertRelationRandom(BTreeIndex *index, int size, int attrByteOffset)
+{
+    // append records in random order to the relation and insert them in the index
+    // on the attribute at the given offset
+    memset(record1.s, ' ', sizeof(record1.s));
+    PageId new_page_number;
+    Page new_page = file1->allocatePage(new_page_number);
+
+    std::vector<int> intvec(size);
+    for( int i = 0; i < size; i++ )
+    {
+        intvec[i] = i;
+    }
+    for( int i = size - 1; i > 0; i-- )
+    {
+        std::swap(intvec[i], intvec[random() % (i + 1)]);
+    }
+
+    for( int i = 0; i < size; i++ )
+    {
+        sprintf(record1.s, "%05d string record", intvec[i]);
+        record1.i = intvec[i];
+        record1.d = intvec[i];
+        std::string new_data(reinterpret_cast<char*>(&record1), sizeof(RECORD));
+
+        RecordId new_rid;
+        while(1)
+        {
+            try
+            {
+                new_rid = new_page.insertRecord(new_data);
+                break;
+            }
+            catch(const InsufficientSpaceException &e)
+            {
+                file1->writePage(new_page_number, new_page);
+                new_page = file1->allocatePage(new_page_number);
+            }
+        }
+        index->insertEntry(reinterpret_cast<char*>(&record1) + attrByteOffset, new_rid);
+    }
+
+    file1->writePage(new_page_number, new_page);
+}
+
+// -----------------------------------------------------------------------------
+// insertHotKeysRandom
+// -----------------------------------------------------------------------------
+
+void insertHotKeysRandom(BTreeIndex *index, int size, int numKeys, int attrByteOffset)
+{
+    // append records with keys drawn at random from the first numKeys to the relation
+    // and insert them in the index on the attribute at the given offset if any
+    memset(record1.s, ' ', sizeof(record1.s));
+    PageId new_page_number;
+    Page new_page = file1->allocatePage(new_page_number);
+
+    for( int i = 0; i < size; i++ )
+    {
+        int key = random() % numKeys;
+        sprintf(record1.s, "%05d string record", key);
+        record1.i = key;
+        record1.d = key;
+        std::string new_data(reinterpret_cast<char*>(&record1), sizeof(RECORD));
+
+        RecordId new_rid;
+        while(1)
+        {
+            try
+            {
+                new_rid = new_page.insertRecord(new_data);
+                break;
+            }
+            catch(const InsufficientSpaceException &e)
+            {
+                file1->writePage(new_page_number, new_page);
+                new_page = file1->allocatePage(new_page_number);
+            }
+        }
+        if (index != nullptr)
+        {
+            index->insertEntry(reinterpret_cast<char*>(&record1) + attrByteOffset, new_rid);
+        }
+    }
+
+    file1->writePage(new_page_number, new_page);
+}
+
+// -----------------------------------------------------------------------------
+// insertPathsRandom
+// -----------------------------------------------------------------------------
+
+void insertPathsRandom(BTreeIndex *index, const char *table, int size)
+{
+    // append records with paths of the table as their string in random order to the relation
+    // and insert them in the index if any
+    memset(record1.s, ' ', sizeof(record1.s));
+    PageId new_page_number;
+    Page new_page = file1->allocatePage(new_page_number);
+
+    std::vector<int> intvec(size);
+    for( int i = 0; i < size; i++ )
+    {
+        intvec[i] = i;
+    }
+    for( int i = size - 1; i > 0; i-- )
+    {
+        std::swap(intvec[i], intvec[random() % (i + 1)]);
+    }
+
+    for( int i = 0; i < size; i++ )
+    {
+        strcpy(record1.s, pathKey(table, intvec[i]).c_str());
+        record1.i = intvec[i];
+        record1.d = intvec[i];
+        std::string new_data(reinterpret_cast<char*>(&record1), sizeof(RECORD));
+
+        RecordId new_rid;
+        while(1)
+        {
+            try
+            {
+                new_rid = new_page.insertRecord(new_data);
+                break;
+            }
+            catch(const InsufficientSpaceException &e)
+            {
+                file1->writePage(new_page_number, new_page);
+                new_page = file1->allocatePage(new_page_number);
+            }
+        }
+        if (index != nullptr)
+        {
+            index->insertEntry(record1.s, new_rid);
+        }
+    }
+
+    file1->writePage(new_page_number, new_page);
+}
+
 // -----------------------------------------------------------------------------
-// createRelationForward
+// indexTests
 // -----------------------------------------------------------------------------
 
-void createRelationForward()
+void indexTests()
 {
-	std::vector<RecordId> ridVec;
-  // destroy any old copies of relation file
+  intTests();
 	try
 	{
-		File::remove(relationName);
+		File::remove(intIndexName);
 	}
-	catch(const FileNotFoundException &e)
+  catch(const FileNotFoundException &e)
+  {
+  }
+
+  doubleTests();
+	try
 	{
+		File::remove(doubleIndexName);
 	}
+  catch(const FileNotFoundException &e)
+  {
+  }
 
-  file1 = new PageFile(relationName, true);
+  stringTests();
+	try
+	{
+		File::remove(stringIndexName);
+	}
+  catch(const FileNotFoundException &e)
+  {
+  }
+}
 
-  // initialize all of record1.s to keep purify happy
-  memset(record1.s, ' ', sizeof(record1.s));
-	PageId new_page_number;
-  Page new_page = file1->allocatePage(new_page_number);
+void indexTest1()
+{
+    intTest1();
+    try
+    {
+        File::remove(intIndexName);
+    }
+    catch(const FileNotFoundException &e)
+    {
+    }
+}
 
-  // Insert a bunch of tuples into the relation.
-  for(int i = 0; i < relationSize; i++ )
-	{
-    sprintf(record1.s, "%05d string record", i);
-    record1.i = i;
-    record1.d = (double)i;
-    std::string new_data(reinterpret_cast<char*>(&record1), sizeof(record1));
+void indexTest2()
+{
+    intTest2();
+    try
+    {
+        File::remove(intIndexName);
+    }
+    catch(const FileNotFoundException &e)
+    {
+    }
+}
 
-		while(1)
-		{
-			try
-			{
-    		new_page.insertRecord(new_data);
-				break;
-			}
-			catch(const InsufficientSpaceException &e)
-			{
-				file1->writePage(new_page_number, new_page);
-  			new_page = file1->allocatePage(new_page_number);
-			}
-		}
-  }
+void indexTest3()
+{
+    intTest3();
+    try
+    {
+        File::remove(intIndexName);
+    }
+    catch(const FileNotFoundException &e)
+    {
+    }
+}
 
-	file1->writePage(new_page_number, new_page);
+void indexTest4()
+{
+    intTest4();
+    try
+    {
+        File::remove(intIndexName);
+    }
+    catch(const FileNotFoundException &e)
+    {
+    }
+}
+
+void indexTest5()
+{
+    intTest5();
+    try
+    {
+        File::remove(intIndexName);
+    }
+    catch(const FileNotFoundException &e)
+    {
+    }
+}
+
+void indexTest6()
+{
+    intTest6();
+    try
+    {
+        File::remove(intIndexName);
+    }
+    catch(const FileNotFoundException &e)
+    {
+    }
+}
+
+void indexTest7()
+{
+    intTest7();
+    try
+    {
+        File::remove(intIndexName);
+    }
+    catch(const FileNotFoundException &e)
+    {
+    }
+}
+
+void indexTest8()
+{
+    intTest8();
+    try
+    {
+        File::remove(intIndexName);
+    }
+    catch(const FileNotFoundException &e)
+    {
+    }
+}
+
+void indexTest9()
+{
+    intTest9();
+    try
+    {
+        File::remove(intIndexName);
+    }
+    catch(const FileNotFoundException &e)
+    {
+    }
+}
+
+void indexTest10()
+{
+    intTest10();
+    try
+    {
+        File::remove(intIndexName);
+    }
+    catch(const FileNotFoundException &e)
+    {
+    }
+}
+
+void indexTest11()
+{
+    intTest11();
+    try
+    {
+        File::remove(intIndexName);
+    }
+    catch(const FileNotFoundException &e)
+    {
+    }
+}
+
+void indexTest12()
+{
+    doubleTest1();
+    try
+    {
+        File::remove(doubleIndexName);
+    }
+    catch(const FileNotFoundException &e)
+    {
+    }
+}
+
+void indexTest13()
+{
+    stringTest1();
+    try
+    {
+        File::remove(stringIndexName);
+    }
+    catch(const FileNotFoundException &e)
+    {
+    }
+}
+
+void indexTest14()
+{
+    stringTest2();
+    try
+    {
+        File::remove(stringIndexName);
+    }
+    catch(const FileNotFoundException &e)
+    {
+    }
+}
+
+void indexTest15()
+{
+    intTest12();
+    try
+    {
+        File::remove(intIndexName);
+    }
+    catch(const FileNotFoundException &e)
+    {
+    }
+    stringTest3();
+    try
+    {
+        File::remove(stringIndexName);
+    }
+    catch(const FileNotFoundException &e)
+    {
+    }
+}
+
+void indexTest16()
+{
+    intTest13();
+    try
+    {
+        File::remove(intIndexName);
+    }
+    catch(const FileNotFoundException &e)
+    {
+    }
+    stringTest4();
+    try
+    {
+        File::remove(stringIndexName);
+    }
+    catch(const FileNotFoundException &e)
+    {
+    }
+}
+
+void indexTest17()
+{
+    intTest14();
+    try
+    {
+        File::remove(intIndexName);
+    }
+    catch(const FileNotFoundException &e)
+    {
+    }
+    stringTest5();
+    try
+    {
+        File::remove(stringIndexName);
+    }
+    catch(const FileNotFoundException &e)
+    {
+    }
 }
 
 // -----------------------------------------------------------------------------
-// createRelationBackward
+// intTests
 // -----------------------------------------------------------------------------
 
-void createRelationBackward()
+void intTests()
 {
-  // destroy any old copies of relation file
-	try
-	{
-		File::remove(relationName);
-	}
-	catch(const FileNotFoundException &e)
-	{
-	}
-  file1 = new PageFile(relationName, true);
+  std::cout << "Create a B+ Tree index on the integer field" << std::endl;
+  BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
 
-  // initialize all of record1.s to keep purify happy
-  memset(record1.s, ' ', sizeof(record1.s));
-	PageId new_page_number;
-  Page new_page = file1->allocatePage(new_page_number);
+	// run some tests
+	checkPassFail(intScan(&index,25,GT,40,LT), 14)
+	checkPassFail(intScan(&index,20,GTE,35,LTE), 16)
+	checkPassFail(intScan(&index,-3,GT,3,LT), 3)
+	checkPassFail(intScan(&index,996,GT,1001,LT), 4)
+	checkPassFail(intScan(&index,0,GT,1,LT), 0)
+	checkPassFail(intScan(&index,300,GT,400,LT), 99)
+	checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+}
 
-  // Insert a bunch of tuples into the relation.
-  for(int i = relationSize - 1; i >= 0; i-- )
-	{
-    sprintf(record1.s, "%05d string record", i);
-    record1.i = i;
-    record1.d = i;
+void intTest1()
+{
+    std::cout << "Create a B+ Tree index on the integer field" << std::endl;
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
 
-    std::string new_data(reinterpret_cast<char*>(&record1), sizeof(RECORD));
+    // run some tests
+    checkPassFail(intScan(&index,-5000,GTE,5000,LT), 10000)
+    checkPassFail(intScan(&index,-5,GT,5,LTE), 10)
+	checkPassFail(intScan(&index,-50,GT,500,LTE), 550)
+}
 
-		while(1)
-		{
-			try
-			{
-    		new_page.insertRecord(new_data);
-				break;
-			}
-			catch(const InsufficientSpaceException &e)
-			{
-				file1->writePage(new_page_number, new_page);
-  			new_page = file1->allocatePage(new_page_number);
-			}
-		}
-  }
+void intTest2()
+{
+    std::cout << "Create a B+ Tree index on the integer field" << std::endl;
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
 
-	file1->writePage(new_page_number, new_page);
+    // run some tests
+	checkPassFail(intScan(&index,10,GTE,55,LTE), 46)
+	checkPassFail(intScan(&index,1000,GTE,4000,LT), 3000)
+    checkPassFail(intScan(&index,10,GT,55,LT), 44)
+    checkPassFail(intScan(&index,-10,GT,10,LT), 10)
+    checkPassFail(intScan(&index,0,GT,100,LT), 99)
+    checkPassFail(intScan(&index,-300,GT,400,LT), 400)
 }
 
-// -----------------------------------------------------------------------------
-// createRelationRandom
-// -----------------------------------------------------------------------------
+void intTest3()
+{
+    std::cout << "Create a B+ Tree index on the integer field" << std::endl;
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
 
-void createRelationRandom()
+    // run some tests
+	checkPassFail(intScan(&index,10,GTE,55,LTE), 23)
+	checkPassFail(intScan(&index,100,GTE,200,LTE), 50)
+	checkPassFail(intScan(&index,10,GT,55,LT), 22)   
+    checkPassFail(intScan(&index,100,GTE,200,LT), 50)
+}
+
+void intTest4()
 {
-  // destroy any old copies of relation file
-	try
-	{
-		File::remove(relationName);
-	}
-	catch(const FileNotFoundException &e)
-	{
-	}
-  file1 = new PageFile(relationName, true);
+    std::cout << "Create a B+ Tree index on the integer field" << std::endl;
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
 
-  // initialize all of record1.s to keep purify happy
-  memset(record1.s, ' ', sizeof(record1.s));
-	PageId new_page_number;
-  Page new_page = file1->allocatePage(new_page_number);
+    // run some tests
+	checkPassFail(intScan(&index,4999,GTE,5000,LT), 1)
+	checkPassFail(intScan(&index, 6000, GTE, 7000, LT), 0)
+	checkPassFail(intScan(&index, -1000, GT, 0, LT), 0)
+	checkPassFail(intScan(&index, 4999, GT, 5000, LT), 0)
+	checkPassFail(intScan(&index, -1000, GT, 0, LT), 0)
+	checkPassFail(intScan(&index, 4500, GTE, 5500, LTE), 500)
+}
 
-  // insert records in random order
+void intTest5()
+{
+    std::cout << "Create a B+ Tree index on the integer field" << std::endl;
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
 
-  std::vector<int> intvec(relationSize);
-  for( int i = 0; i < relationSize; i++ )
-  {
-    intvec[i] = i;
-  }
+    // run some tests
+	checkPassFail(intScan(&index, 10, GT, 55, LT), 0)
+	checkPassFail(intScan(&index, -5, GT, 5, LT), 0)
+	checkPassFail(intScan(&index, 900, GT, 1001, LT), 0)
+	checkPassFail(intScan(&index, 0, GT, 1, LT), 0)
+	checkPassFail(intScan(&index, 4500, GTE, 5500, LT), 0)
+}
 
-  long pos;
-  int val;
-	int i = 0;
-  while( i < relationSize )
-  {
-    pos = random() % (relationSize-i);
-    val = intvec[pos];
-    sprintf(record1.s, "%05d string record", val);
-    record1.i = val;
-    record1.d = val;
+void intTest6()
+{
+    std::cout << "Create a B+ Tree index on the integer field" << std::endl;
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
 
-    std::string new_data(reinterpret_cast<char*>(&record1), sizeof(RECORD));
+    // run some tests
+	checkPassFail(intScan(&index,10,GT,55,LT), 0)
+    checkPassFail(intScan(&index,-5,GT,5,LT), 0)
+    checkPassFail(intScan(&index,900,GT,1001,LT), 100)
+    checkPassFail(intScan(&index,0,GT,1,LT), 0)
+    checkPassFail(intScan(&index,400,GT,500,LT), 99)
+    checkPassFail(intScan(&index,4500,GTE,5500,LT), 1000)
+}
 
-		while(1)
-		{
-			try
-			{
-    		new_page.insertRecord(new_data);
-				break;
-			}
-			catch(const InsufficientSpaceException &e)
-			{
-      	file1->writePage(new_page_number, new_page);
-  			new_page = file1->allocatePage(new_page_number);
-			}
-		}
+void intTest7()
+{
+    std::cout << "Create a B+ Tree index on the integer field with half full pages" << std::endl;
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, 0.5);
 
-		int temp = intvec[relationSize-1-i];
-		intvec[relationSize-1-i] = intvec[pos];
-		intvec[pos] = temp;
-		i++;
-  }
-  
-	file1->writePage(new_page_number, new_page);
+    // run some tests
+	checkPassFail(intScan(&index,25,GT,40,LT), 14)
+	checkPassFail(intScan(&index,-3,GT,3,LT), 3)
+	checkPassFail(intScan(&index,0,GTE,5000,LT), 5000)
+	checkPassFail(intScan(&index,4999,GTE,5000,LT), 1)
 }
 
-// -----------------------------------------------------------------------------
-// createRelationNegative
-// -----------------------------------------------------------------------------
+void intTest8()
+{
+    std::cout << "Create a B+ Tree index on the integer field and insert into it" << std::endl;
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+    insertRelationRandom(&index, 20000);
 
-void createRelationNegative()
+    // run some tests
+	checkPassFail(intScan(&index,25,GT,40,LT), 14)
+	checkPassFail(intScan(&index,20,GTE,35,LTE), 16)
+	checkPassFail(intScan(&index,0,GTE,20000,LT), 20000)
+	checkPassFail(intScan(&index,19999,GTE,20000,LT), 1)
+	checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+}
+
+int intLookup(BTreeIndex *index, int lowVal, int highVal)
 {
-    std::vector<RecordId> ridVec;
-    // destroy any old copies of relation file
-    try
+    // count the keys in [lowVal, highVal) found by single lookups
+    // and check that the record found has the key
+    std::cout << "Lookup for [" << lowVal << "," << highVal << ")" << std::endl;
+    int numResults = 0;
+    for (int key = lowVal; key < highVal; key++)
     {
-        File::remove(relationName);
+        RecordId outRid;
+        if (index->lookup(&key, outRid))
+        {
+            Page *curPage;
+            bufMgr->readPage(file1, outRid.page_number, curPage);
+            RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(outRid).data()));
+            bufMgr->unPinPage(file1, outRid.page_number, false);
+            numResults += myRec.i == key;
+        }
     }
-    catch(const FileNotFoundException &e)
+    return numResults;
+}
+
+int intLookupBatch(BTreeIndex *index, int lowVal, int highVal)
+{
+    // count the keys in [lowVal, highVal) found by a batch lookup of the keys in reverse order
+    std::cout << "Batch lookup for [" << lowVal << "," << highVal << ")" << std::endl;
+    std::vector<int> keys;
+    for (int key = highVal - 1; key >= lowVal; key--)
     {
+        keys.push_back(key);
     }
+    std::vector<RecordId> outRids(keys.size());
+    std::unique_ptr<bool[]> found(new bool[keys.size()]);
+    int numResults = index->lookupBatch(keys.data(), keys.size(), outRids.data(), found.get());
 
-    file1 = new PageFile(relationName, true);
+    // the flags should agree with the count and with single lookups
+    int numFlagged = 0;
+    for (std::size_t i = 0; i < keys.size(); i++)
+    {
+        RecordId outRid;
+        if (found[i] != index->lookup(&keys[i], outRid) || (found[i] && outRid != outRids[i]))
+        {
+            return -1;
+        }
+        numFlagged += found[i];
+    }
+    return numFlagged == numResults ? numResults : -1;
+}
 
-    // initialize all of record1.s to keep purify happy
-    memset(record1.s, ' ', sizeof(record1.s));
-    PageId new_page_number;
-    Page new_page = file1->allocatePage(new_page_number);
+void intTest9()
+{
+    std::cout << "Create a B+ Tree index on the integer field and look up keys" << std::endl;
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
 
-    // Insert a bunch of tuples into the relation.
-    for(int i = -relationSize; i < relationSize; i++ )
+    // run some tests
+	checkPassFail(intLookup(&index, 0, relationSize), relationSize)
+	checkPassFail(intLookup(&index, -100, 0), 0)
+	checkPassFail(intLookup(&index, relationSize, relationSize + 100), 0)
+	checkPassFail(intLookupBatch(&index, -100, relationSize + 100), relationSize)
+	checkPassFail(intLookupBatch(&index, 4000, 4001), 1)
+	checkPassFail(intLookupBatch(&index, 0, 0), 0)
+
+    // a lookup should not disturb an executing scan
+    int lowVal = 100;
+    int highVal = 200;
+    int key = 4000;
+    RecordId scanRid;
+    RecordId outRid;
+    int numResults = 0;
+    index.startScan(&lowVal, GTE, &highVal, LT);
+    try
     {
-        sprintf(record1.s, "%05d string record", i);
-        record1.i = i;
-        record1.d = (double)i;
-        std::string new_data(reinterpret_cast<char*>(&record1), sizeof(record1));
+        while (1)
+        {
+            index.scanNext(scanRid);
+            numResults += index.lookup(&key, outRid);
+        }
+    }
+    catch(const IndexScanCompletedException &e)
+    {
+    }
+    index.endScan();
+	checkPassFail(numResults, 100)
+}
 
-        while(1)
+int intCursorScan(BTreeCursor *cursor, int lowVal, int highVal)
+{
+    // count the keys in [lowVal, highVal) returned by the cursor
+    // and check that the record found has a key in the range
+    RecordId scanRid;
+    cursor->startScan(&lowVal, GTE, &highVal, LT);
+    int numResults = 0;
+    try
+    {
+        while (1)
         {
-            try
-            {
-                new_page.insertRecord(new_data);
-                break;
-            }
-            catch(const InsufficientSpaceException &e)
-            {
-                file1->writePage(new_page_number, new_page);
-                new_page = file1->allocatePage(new_page_number);
-            }
+            cursor->scanNext(scanRid);
+            Page *curPage;
+            bufMgr->readPage(file1, scanRid.page_number, curPage);
+            RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(scanRid).data()));
+            bufMgr->unPinPage(file1, scanRid.page_number, false);
+            numResults += myRec.i >= lowVal && myRec.i < highVal;
+        }
+    }
+    catch(const IndexScanCompletedException &e)
+    {
+    }
+    cursor->endScan();
+    return numResults;
+}
+
+void intTest10()
+{
+    std::cout << "Create a B+ Tree index on the integer field and scan with several cursors" << std::endl;
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+
+    // two interleaved cursors over overlapping ranges
+    int lowVal1 = 0;
+    int highVal1 = 3000;
+    int lowVal2 = 1000;
+    int highVal2 = 5000;
+    RecordId scanRid;
+    int numResults1 = 0;
+    int numResults2 = 0;
+    BTreeCursor cursor1(&index);
+    BTreeCursor cursor2(&index);
+    cursor1.startScan(&lowVal1, GTE, &highVal1, LT);
+    cursor2.startScan(&lowVal2, GTE, &highVal2, LT);
+    bool done1 = false;
+    bool done2 = false;
+    while (!done1 || !done2)
+    {
+        try
+        {
+            if (!done1) { cursor1.scanNext(scanRid); numResults1++; }
+        }
+        catch(const IndexScanCompletedException &e)
+        {
+            done1 = true;
+        }
+        try
+        {
+            if (!done2) { cursor2.scanNext(scanRid); numResults2++; }
+        }
+        catch(const IndexScanCompletedException &e)
+        {
+            done2 = true;
+        }
+    }
+    cursor1.endScan();
+    cursor2.endScan();
+	checkPassFail(numResults1, 3000)
+	checkPassFail(numResults2, 4000)
+
+    // a nested cursor inside the scan of the index
+    int lowVal = 100;
+    int highVal = 120;
+    int numResults = 0;
+    index.startScan(&lowVal, GTE, &highVal, LT);
+    try
+    {
+        while (1)
+        {
+            index.scanNext(scanRid);
+            numResults += intCursorScan(&cursor1, 0, 10);
         }
     }
+    catch(const IndexScanCompletedException &e)
+    {
+    }
+    index.endScan();
+	checkPassFail(numResults, 200)
 
-    file1->writePage(new_page_number, new_page);
+    // a cursor left open is ended by its destructor
+    {
+        BTreeCursor cursor(&index);
+        cursor.startScan(&lowVal1, GTE, &highVal1, LT);
+    }
+	checkPassFail(intCursorScan(&cursor2, 4000, 5000), 1000)
 }
 
-// -----------------------------------------------------------------------------
-// createRelationForwardSize
-// -----------------------------------------------------------------------------
-
-void createRelationForwardSize(int size)
+int intBatchScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp, std::size_t batchSize)
 {
-    std::vector<RecordId> ridVec;
-    // destroy any old copies of relation file
+    // count the records returned in batches, checking that their keys lie within the range in order
+    std::cout << "Batch scan of " << batchSize << " for " << lowVal << "," << highVal << std::endl;
     try
     {
-        File::remove(relationName);
+        index->startScan(&lowVal, lowOp, &highVal, highOp);
     }
-    catch(const FileNotFoundException &e)
+    catch(const NoSuchKeyFoundException &e)
     {
+        return 0;
     }
 
-    file1 = new PageFile(relationName, true);
-
-
-    memset(record1.s, ' ', sizeof(record1.s));
-    PageId new_page_number;
-    Page new_page = file1->allocatePage(new_page_number);
-
-    // Insert a bunch of tuples into the relation.
-    for(int i = 0; i < size; i++ )
+    std::vector<RecordId> outRids(batchSize);
+    int numResults = 0;
+    int lastKey = lowVal - 1;
+    std::size_t n;
+    while ((n = index->scanNextBatch(outRids.data(), batchSize)) > 0)
     {
-        sprintf(record1.s, "%05d string record", i);
-        record1.i = i;
-        record1.d = (double)i;
-        std::string new_data(reinterpret_cast<char*>(&record1), sizeof(record1));
-
-        while(1)
+        for (std::size_t i = 0; i < n; i++)
         {
-            try
-            {
-                new_page.insertRecord(new_data);
-                break;
-            }
-            catch(const InsufficientSpaceException &e)
+            Page *curPage;
+            bufMgr->readPage(file1, outRids[i].page_number, curPage);
+            RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(outRids[i]).data()));
+            bufMgr->unPinPage(file1, outRids[i].page_number, false);
+            if (myRec.i <= lastKey || !compareOp(myRec.i, lowVal, lowOp) || !compareOp(myRec.i, highVal, highOp))
             {
-                file1->writePage(new_page_number, new_page);
-                new_page = file1->allocatePage(new_page_number);
+                index->endScan();
+                return -1;
             }
+            lastKey = myRec.i;
+            numResults++;
         }
     }
-
-    file1->writePage(new_page_number, new_page);
+    index->endScan();
+    return numResults;
 }
 
-// -----------------------------------------------------------------------------
-// createRelationBackwardGap
-// -----------------------------------------------------------------------------
-
-void createRelationBackwardGap(int size)
+void intTest11()
 {
+    std::cout << "Create a B+ Tree index on the integer field and scan in batches" << std::endl;
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+
+    // run some tests
+	checkPassFail(intBatchScan(&index,25,GT,40,LT,7), 14)
+	checkPassFail(intBatchScan(&index,20,GTE,35,LTE,1), 16)
+	checkPassFail(intBatchScan(&index,0,GTE,relationSize,LT,1000), relationSize)
+	checkPassFail(intBatchScan(&index,-3,GT,relationSize,LTE,3000), relationSize)
+	checkPassFail(intBatchScan(&index,300,GT,400,LT,682), 99)
+	checkPassFail(intBatchScan(&index,3000,GTE,4000,LT,5000), 1000)
+
+    // mixing single and batched calls on one scan
+    int lowVal = 0;
+    int highVal = 1000;
+    RecordId scanRid;
+    std::vector<RecordId> outRids(100);
+    int numResults = 0;
+    index.startScan(&lowVal, GTE, &highVal, LT);
+    try
     {
-        // destroy any old copies of relation file
-        try
-        {
-            File::remove(relationName);
-        }
-        catch(const FileNotFoundException &e)
+        while (1)
         {
+            index.scanNext(scanRid);
+            numResults += 1 + index.scanNextBatch(outRids.data(), outRids.size());
         }
-        file1 = new PageFile(relationName, true);
+    }
+    catch(const IndexScanCompletedException &e)
+    {
+    }
+    index.endScan();
+	checkPassFail(numResults, 1000)
+}
 
+void intTest12()
+{
+    std::cout << "Create a B+ Tree index on a few hot integer keys and insert more of them" << std::endl;
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
 
-        memset(record1.s, ' ', sizeof(record1.s));
-        PageId new_page_number;
-        Page new_page = file1->allocatePage(new_page_number);
+    int lowVal = 0;
+    int highVal = 3;
+    int hotVal = 2;
+	checkPassFail(hotKeyScan(&index, &lowVal, &highVal, offsetof(tuple,i)), 20000)
+	checkPassFail(hotKeyScan(&index, &hotVal, &hotVal, offsetof(tuple,i)), intScan(&index, hotVal, GTE, hotVal, LTE))
+
+    // the hot keys grow their posting lists, while new keys start with entries in the leaves
+    insertHotKeysRandom(&index, 5000, 4);
+    insertHotKeysRandom(&index, 5000, 1000);
+    highVal = 999;
+	checkPassFail(hotKeyScan(&index, &lowVal, &highVal, offsetof(tuple,i)), 30000)
+	checkPassFail(intScan(&index, 0, GTE, 999, LTE), 30000)
+}
 
-        // Insert a bunch of tuples into the relation.
-        for(int i = size - 1; i >= 0; i = i - 2 )
-        {
-            sprintf(record1.s, "%05d string record", i);
-            record1.i = i;
-            record1.d = i;
+void intTest13()
+{
+    std::cout << "Create a B+ Tree index, delete entries from it and insert more" << std::endl;
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
 
-            std::string new_data(reinterpret_cast<char*>(&record1), sizeof(RECORD));
+    // every other entry, from the posting lists of the hot keys as well
+    int lowVal = 0;
+    int highVal = 4999;
+	checkPassFail(deleteEntries(&index, &lowVal, &highVal, 2, offsetof(tuple,i)), 7500)
+	checkPassFail(hotKeyScan(&index, &lowVal, &highVal, offsetof(tuple,i)), 7500)
+	checkPassFail(intScan(&index, 4000, GTE, 4999, LTE), 500)
+
+    // the leaves emptied of a whole range are merged
+    lowVal = 1000;
+    highVal = 1999;
+	checkPassFail(deleteEntries(&index, &lowVal, &highVal, 1, offsetof(tuple,i)), 500)
+	checkPassFail(intScan(&index, 1000, GTE, 1999, LTE), 0)
+
+    // lazy deletions leave the leaves underfull until the tree is compacted
+    index.setDeletePolicy(DELETE_LAZY);
+    lowVal = 2000;
+    highVal = 4999;
+	checkPassFail(deleteEntries(&index, &lowVal, &highVal, 1, offsetof(tuple,i)), 1500)
+	checkPassFail(intScan(&index, 0, GTE, 4999, LTE), 5500)
+    index.compact();
+    lowVal = 0;
+	checkPassFail(hotKeyScan(&index, &lowVal, &highVal, offsetof(tuple,i)), 5500)
+
+    // the new entries go to the freed pages first
+    insertRelationRandom(&index, 3000);
+	checkPassFail(hotKeyScan(&index, &lowVal, &highVal, offsetof(tuple,i)), 8500)
+	checkPassFail(intScan(&index, 1000, GTE, 1999, LTE), 1000)
+}
 
-            while(1)
+void intTest14()
+{
+    std::cout << "Create a B+ Tree index on the integer field and use it from several threads" << std::endl;
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+
+	checkPassFail(concurrentEntries(&index, INTEGER, 20000), 0)
+    int numKept;
+    BTreeCursor cursor(&index);
+	checkPassFail(concurrentScan(&cursor, INTEGER, 20000, numKept), 10000)
+	checkPassFail(numKept, 10000)
+}
+
+int hotKeyScan(BTreeIndex *index, const void *lowVal, const void *highVal, int attrByteOffset)
+{
+    // count the records within the range [lowVal, highVal], checking that the entries of each key
+    // come in record ID order and that a lookup of the key finds the first of them
+    std::cout << "Hot key scan" << std::endl;
+    try
+    {
+        index->startScan(lowVal, GTE, highVal, LTE);
+    }
+    catch(const NoSuchKeyFoundException &e)
+    {
+        return 0;
+    }
+
+    std::vector<RecordId> outRids(100);
+    int numResults = 0;
+    int lastKey = -1;
+    RecordId lastRid;
+    bool ordered = true;
+    std::size_t n;
+    while ((n = index->scanNextBatch(outRids.data(), outRids.size())) > 0)
+    {
+        for (std::size_t i = 0; i < n; i++)
+        {
+            Page *curPage;
+            bufMgr->readPage(file1, outRids[i].page_number, curPage);
+            RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(outRids[i]).data()));
+            bufMgr->unPinPage(file1, outRids[i].page_number, false);
+            if (myRec.i < lastKey || (myRec.i == lastKey && !(lastRid < outRids[i])))
             {
-                try
-                {
-                    new_page.insertRecord(new_data);
-                    break;
-                }
-                catch(const InsufficientSpaceException &e)
+                ordered = false;
+            }
+            if (myRec.i != lastKey)
+            {
+                RecordId firstRid;
+                if (!index->lookup(reinterpret_cast<char*>(&myRec) + attrByteOffset, firstRid) || firstRid != outRids[i])
                 {
-                    file1->writePage(new_page_number, new_page);
-                    new_page = file1->allocatePage(new_page_number);
+                    ordered = false;
                 }
             }
+            lastKey = myRec.i;
+            lastRid = outRids[i];
+            numResults++;
         }
-
-        file1->writePage(new_page_number, new_page);
     }
+    index->endScan();
+    return ordered ? numResults : -1;
 }
 
-// -----------------------------------------------------------------------------
-// createRelationBackwardGap
-// -----------------------------------------------------------------------------
-
-void createRelationForwardRange(int lower, int upper)
+int deleteEntries(BTreeIndex *index, const void *lowVal, const void *highVal, int step, int attrByteOffset)
 {
+    // delete every step-th entry within the range [lowVal, highVal] in scan order, checking that
+    // each entry is found once only, and return the number of entries deleted
+    std::cout << "Delete entries" << std::endl;
+    std::vector<RecordId> rids(100);
+    std::size_t numRids = 0;
+    try
     {
-        std::vector<RecordId> ridVec;
-        // destroy any old copies of relation file
-        try
-        {
-            File::remove(relationName);
-        }
-        catch(const FileNotFoundException &e)
+        index->startScan(lowVal, GTE, highVal, LTE);
+        std::size_t n;
+        while ((n = index->scanNextBatch(rids.data() + numRids, 100)) > 0)
         {
+            numRids += n;
+            rids.resize(numRids + 100);
         }
+        index->endScan();
+    }
+    catch(const NoSuchKeyFoundException &e)
+    {
+    }
 
-        file1 = new PageFile(relationName, true);
-
-
-        memset(record1.s, ' ', sizeof(record1.s));
-        PageId new_page_number;
-        Page new_page = file1->allocatePage(new_page_number);
-
-        // Insert a bunch of tuples into the relation.
-        for(int i = lower; i <= upper; i++ )
+    int numDeleted = 0;
+    for (std::size_t i = 0; i < numRids; i += step)
+    {
+        Page *curPage;
+        bufMgr->readPage(file1, rids[i].page_number, curPage);
+        RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(rids[i]).data()));
+        bufMgr->unPinPage(file1, rids[i].page_number, false);
+        const char *key = reinterpret_cast<char*>(&myRec) + attrByteOffset;
+        if (!index->deleteEntry(key, rids[i]) || index->deleteEntry(key, rids[i]))
         {
-            sprintf(record1.s, "%05d string record", i);
-            record1.i = i;
-            record1.d = (double)i;
-            std::string new_data(reinterpret_cast<char*>(&record1), sizeof(record1));
-
-            while(1)
-            {
-                try
-                {
-                    new_page.insertRecord(new_data);
-                    break;
-                }
-                catch(const InsufficientSpaceException &e)
-                {
-                    file1->writePage(new_page_number, new_page);
-                    new_page = file1->allocatePage(new_page_number);
-                }
-            }
+            return -1;
         }
-
-        file1->writePage(new_page_number, new_page);
+        numDeleted++;
     }
+    return numDeleted;
 }
 
 // -----------------------------------------------------------------------------
-// indexTests
+// concurrentEntries
 // -----------------------------------------------------------------------------
 
-void indexTests()
+const int numWriters = 4;
+
+const void *concurrentKey(Datatype type, int i, int &intKey, char *strKey)
 {
-  intTests();
-	try
-	{
-		File::remove(intIndexName);
-	}
-  catch(const FileNotFoundException &e)
-  {
-  }
+    // the i-th entry has the key i, written as a record string for a STRING index
+    intKey = i;
+    sprintf(strKey, "%05d string record", i);
+    return type == STRING ? (const void *)strKey : &intKey;
 }
 
-void indexTest1()
+RecordId concurrentRid(int i)
 {
-    intTest1();
+    // the record IDs of the entries are in the order of their keys, and need not exist
+    RecordId rid;
+    rid.page_number = i / 64 + 1;
+    rid.slot_number = i % 64 + 1;
+    return rid;
+}
+
+int concurrentScan(BTreeCursor *cursor, Datatype type, int numEntries, int &numKept)
+{
+    // count the entries returned by the cursor, checking that they come in order,
+    // and count those of them never deleted (the even rounds of the writers) in numKept
+    int lowInt, highInt;
+    char lowStr[64], highStr[64];
+    const void *lowVal = concurrentKey(type, 0, lowInt, lowStr);
+    const void *highVal = concurrentKey(type, numEntries, highInt, highStr);
+    numKept = 0;
     try
     {
-        File::remove(intIndexName);
+        cursor->startScan(lowVal, GTE, highVal, LT);
     }
-    catch(const FileNotFoundException &e)
+    catch(const NoSuchKeyFoundException &e)
     {
+        return 0;
     }
-}
 
-void indexTest2()
-{
-    intTest2();
+    int numResults = 0;
+    int last = -1;
+    RecordId scanRid;
     try
     {
-        File::remove(intIndexName);
+        while (1)
+        {
+            cursor->scanNext(scanRid);
+            int i = (scanRid.page_number - 1) * 64 + scanRid.slot_number - 1;
+            if (i <= last || i >= numEntries)
+            {
+                cursor->endScan();
+                return -1;
+            }
+            last = i;
+            numKept += (i / numWriters) % 2 == 0;
+            numResults++;
+        }
     }
-    catch(const FileNotFoundException &e)
+    catch(const IndexScanCompletedException &e)
     {
     }
+    cursor->endScan();
+    return numResults;
 }
 
-void indexTest3()
+int concurrentEntries(BTreeIndex *index, Datatype type, int numEntries)
 {
-    intTest3();
-    try
+    // insert numEntries entries from several threads, each its own keys, then delete half of them,
+    // while other threads scan the entries and look the kept ones up, and return the number of errors found
+    std::cout << "Concurrent entries" << std::endl;
+    std::atomic<int> numErrors(0);
+    std::atomic<bool> deleting(false);
+    std::atomic<bool> done(false);
+
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 2; r++)
     {
-        File::remove(intIndexName);
+        readers.emplace_back([&]()
+        {
+            BTreeCursor cursor(index);
+            while (!done)
+            {
+                // no entry kept is missed once the inserts are over
+                bool complete = deleting;
+                int numKept;
+                int numResults = concurrentScan(&cursor, type, numEntries, numKept);
+                if (numResults < 0 || (complete && numKept != numEntries / 2))
+                {
+                    numErrors++;
+                }
+            }
+        });
     }
-    catch(const FileNotFoundException &e)
+    readers.emplace_back([&]()
     {
-    }
-}
+        int intKey;
+        char strKey[64];
+        RecordId outRid;
+        while (!done)
+        {
+            for (int i = 0; deleting && i < numEntries; i += 2 * numWriters)
+            {
+                if (!index->lookup(concurrentKey(type, i, intKey, strKey), outRid) || outRid != concurrentRid(i))
+                {
+                    numErrors++;
+                }
+            }
+            std::this_thread::yield();
+        }
+    });
 
-void indexTest4()
-{
-    intTest4();
-    try
+    for (int round = 0; round < 2; round++)
     {
-        File::remove(intIndexName);
+        std::vector<std::thread> writers;
+        for (int t = 0; t < numWriters; t++)
+        {
+            writers.emplace_back([&, t]()
+            {
+                int intKey;
+                char strKey[64];
+                for (int i = t + round * numWriters; i < numEntries; i += numWriters * (round + 1))
+                {
+                    const void *key = concurrentKey(type, i, intKey, strKey);
+                    if (round == 0)
+                    {
+                        index->insertEntry(key, concurrentRid(i));
+                    }
+                    else if (!index->deleteEntry(key, concurrentRid(i)))
+                    {
+                        numErrors++;
+                    }
+                }
+            });
+        }
+        for (std::thread &writer : writers)
+        {
+            writer.join();
+        }
+        deleting = true;
     }
-    catch(const FileNotFoundException &e)
+    done = true;
+    for (std::thread &reader : readers)
     {
+        reader.join();
     }
+    return numErrors;
 }
 
-void indexTest5()
-{
-    intTest5();
-    try
-    {
-        File::remove(intIndexName);
-    }
-    catch(const FileNotFoundException &e)
-    {
-    }
-}
+int intScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp)
+{
+  RecordId scanRid;
+	Page *curPage;
+
+  std::cout << "Scan for ";
+  if( lowOp == GT ) { std::cout << "("; } else { std::cout << "["; }
+  std::cout << lowVal << "," << highVal;
+  if( highOp == LT ) { std::cout << ")"; } else { std::cout << "]"; }
+  std::cout << std::endl;
+
+  int numResults = 0;
+
+	try
+	{
+  	index->startScan(&lowVal, lowOp, &highVal, highOp);
+	}
+	catch(const NoSuchKeyFoundException &e)
+	{
+    std::cout << "No Key Found satisfying the scan criteria." << std::endl;
+		return 0;
+	}
+
+	while(1)
+	{
+		try
+		{
+			index->scanNext(scanRid);
+			bufMgr->readPage(file1, scanRid.page_number, curPage);
+			RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(scanRid).data()));
+			bufMgr->unPinPage(file1, scanRid.page_number, false);
+
+			if( numResults < 5 )
+			{
+				std::cout << "at:" << scanRid.page_number << "," << scanRid.slot_number;
+				std::cout << " -->:" << myRec.i << ":" << myRec.d << ":" << myRec.s << ":" <<std::endl;
+			}
+			else if( numResults == 5 )
+			{
+				std::cout << "..." << std::endl;
+			}
+		}
+		catch(const IndexScanCompletedException &e)
+		{
+			break;
+		}
+
+		numResults++;
+	}
 
-void indexTest6()
-{
-    intTest6();
-    try
-    {
-        File::remove(intIndexName);
-    }
-    catch(const FileNotFoundException &e)
-    {
-    }
-}
+  if( numResults >= 5 )
+  {
+    std::cout << "Number of results: " << numResults << std::endl;
+  }
+  index->endScan();
+  std::cout << std::endl;
 
+	return numResults;
+}
 
 // -----------------------------------------------------------------------------
-// intTests
+// doubleTests
 // -----------------------------------------------------------------------------
 
-void intTests()
+void doubleTests()
 {
-  std::cout << "Create a B+ Tree index on the integer field" << std::endl;
-  BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+  std::cout << "Create a B+ Tree index on the double field" << std::endl;
+  BTreeIndex index(relationName, doubleIndexName, bufMgr, offsetof(tuple,d), DOUBLE);
 
 	// run some tests
-	checkPassFail(intScan(&index,25,GT,40,LT), 14)
-	checkPassFail(intScan(&index,20,GTE,35,LTE), 16)
-	checkPassFail(intScan(&index,-3,GT,3,LT), 3)
-	checkPassFail(intScan(&index,996,GT,1001,LT), 4)
-	checkPassFail(intScan(&index,0,GT,1,LT), 0)
-	checkPassFail(intScan(&index,300,GT,400,LT), 99)
-	checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+	checkPassFail(doubleScan(&index,25,GT,40,LT), 14)
+	checkPassFail(doubleScan(&index,20,GTE,35,LTE), 16)
+	checkPassFail(doubleScan(&index,-3,GT,3,LT), 3)
+	checkPassFail(doubleScan(&index,996,GT,1001,LT), 4)
+	checkPassFail(doubleScan(&index,0,GT,1,LT), 0)
+	checkPassFail(doubleScan(&index,300,GT,400,LT), 99)
+	checkPassFail(doubleScan(&index,3000,GTE,4000,LT), 1000)
+	checkPassFail(doubleScan(&index,24.5,GT,40.5,LTE), 16)
 }
 
-void intTest1()
+void doubleTest1()
 {
-    std::cout << "Create a B+ Tree index on the integer field" << std::endl;
-    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+  std::cout << "Create a B+ Tree index on the double field and insert into it" << std::endl;
+  BTreeIndex index(relationName, doubleIndexName, bufMgr, offsetof(tuple,d), DOUBLE);
+  insertRelationRandom(&index, 20000, offsetof(tuple,d));
 
-    // run some tests
-    checkPassFail(intScan(&index,-5000,GTE,5000,LT), 10000)
-    checkPassFail(intScan(&index,-5,GT,5,LTE), 10)
-	checkPassFail(intScan(&index,-50,GT,500,LTE), 550)
+	// run some tests
+	checkPassFail(doubleScan(&index,25,GT,40,LT), 14)
+	checkPassFail(doubleScan(&index,-0.5,GTE,20000,LT), 20000)
+	checkPassFail(doubleScan(&index,19998.5,GT,19999,LTE), 1)
 }
 
-void intTest2()
+int doubleScan(BTreeIndex * index, double lowVal, Operator lowOp, double highVal, Operator highOp)
 {
-    std::cout << "Create a B+ Tree index on the integer field" << std::endl;
-    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+  RecordId scanRid;
+	Page *curPage;
 
-    // run some tests
-	checkPassFail(intScan(&index,10,GTE,55,LTE), 46)
-	checkPassFail(intScan(&index,1000,GTE,4000,LT), 3000)
-    checkPassFail(intScan(&index,10,GT,55,LT), 44)
-    checkPassFail(intScan(&index,-10,GT,10,LT), 10)
-    checkPassFail(intScan(&index,0,GT,100,LT), 99)
-    checkPassFail(intScan(&index,-300,GT,400,LT), 400)
-}
+  std::cout << "Scan for ";
+  if( lowOp == GT ) { std::cout << "("; } else { std::cout << "["; }
+  std::cout << lowVal << "," << highVal;
+  if( highOp == LT ) { std::cout << ")"; } else { std::cout << "]"; }
+  std::cout << std::endl;
 
-void intTest3()
-{
-    std::cout << "Create a B+ Tree index on the integer field" << std::endl;
-    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+  int numResults = 0;
 
-    // run some tests
-	checkPassFail(intScan(&index,10,GTE,55,LTE), 23)
-	checkPassFail(intScan(&index,100,GTE,200,LTE), 50)
-	checkPassFail(intScan(&index,10,GT,55,LT), 22)   
-    checkPassFail(intScan(&index,100,GTE,200,LT), 50)
-}
+	try
+	{
+  	index->startScan(&lowVal, lowOp, &highVal, highOp);
+	}
+	catch(const NoSuchKeyFoundException &e)
+	{
+    std::cout << "No Key Found satisfying the scan criteria." << std::endl;
+		return 0;
+	}
 
-void intTest4()
-{
-    std::cout << "Create a B+ Tree index on the integer field" << std::endl;
-    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+	while(1)
+	{
+		try
+		{
+			index->scanNext(scanRid);
+			bufMgr->readPage(file1, scanRid.page_number, curPage);
+			RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(scanRid).data()));
+			bufMgr->unPinPage(file1, scanRid.page_number, false);
 
-    // run some tests
-	checkPassFail(intScan(&index,4999,GTE,5000,LT), 1)
-	checkPassFail(intScan(&index, 6000, GTE, 7000, LT), 0)
-	checkPassFail(intScan(&index, -1000, GT, 0, LT), 0)
-	checkPassFail(intScan(&index, 4999, GT, 5000, LT), 0)
-	checkPassFail(intScan(&index, -1000, GT, 0, LT), 0)
-	checkPassFail(intScan(&index, 4500, GTE, 5500, LTE), 500)
+			if( numResults < 5 )
+			{
+				std::cout << "rid:" << scanRid.page_number << "," << scanRid.slot_number;
+				std::cout << " -->:" << myRec.i << ":" << myRec.d << ":" << myRec.s << ":" <<std::endl;
+			}
+			else if( numResults == 5 )
+			{
+				std::cout << "..." << std::endl;
+			}
+		}
+		catch(const IndexScanCompletedException &e)
+		{
+			break;
+		}
+
+		numResults++;
+	}
+
+  if( numResults >= 5 )
+  {
+    std::cout << "Number of results: " << numResults << std::endl;
+  }
+  index->endScan();
+  std::cout << std::endl;
+
+	return numResults;
 }
 
-void intTest5()
+// -----------------------------------------------------------------------------
+// stringTests
+// -----------------------------------------------------------------------------
+
+void stringTests()
 {
-    std::cout << "Create a B+ Tree index on the integer field" << std::endl;
-    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+  std::cout << "Create a B+ Tree index on the string field" << std::endl;
+  BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING);
 
-    // run some tests
-	checkPassFail(intScan(&index, 10, GT, 55, LT), 0)
-	checkPassFail(intScan(&index, -5, GT, 5, LT), 0)
-	checkPassFail(intScan(&index, 900, GT, 1001, LT), 0)
-	checkPassFail(intScan(&index, 0, GT, 1, LT), 0)
-	checkPassFail(intScan(&index, 4500, GTE, 5500, LT), 0)
+	// run some tests
+	checkPassFail(stringScan(&index,25,GT,40,LT), 14)
+	checkPassFail(stringScan(&index,20,GTE,35,LTE), 16)
+	checkPassFail(stringScan(&index,-3,GT,3,LT), 3)
+	checkPassFail(stringScan(&index,996,GT,1001,LT), 4)
+	checkPassFail(stringScan(&index,0,GT,1,LT), 0)
+	checkPassFail(stringScan(&index,300,GT,400,LT), 99)
+	checkPassFail(stringScan(&index,3000,GTE,4000,LT), 1000)
+	checkPassFail(stringLookup(&index,4990,5010), 10)
 }
 
-void intTest6()
+void stringTest1()
 {
-    std::cout << "Create a B+ Tree index on the integer field" << std::endl;
-    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+  std::cout << "Create a B+ Tree index on the string field and insert into it" << std::endl;
+  BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING);
+  insertRelationRandom(&index, 20000, offsetof(tuple,s));
 
-    // run some tests
-	checkPassFail(intScan(&index,10,GT,55,LT), 0)
-    checkPassFail(intScan(&index,-5,GT,5,LT), 0)
-    checkPassFail(intScan(&index,900,GT,1001,LT), 100)
-    checkPassFail(intScan(&index,0,GT,1,LT), 0)
-    checkPassFail(intScan(&index,400,GT,500,LT), 99)
-    checkPassFail(intScan(&index,4500,GTE,5500,LT), 1000)
+	// run some tests
+	checkPassFail(stringScan(&index,25,GT,40,LT), 14)
+	checkPassFail(stringScan(&index,0,GTE,20000,LT), 20000)
+	checkPassFail(stringScan(&index,3000,GTE,4000,LT), 1000)
+	checkPassFail(stringLookup(&index,19990,20010), 10)
 }
 
-int intScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp)
+int stringScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp)
 {
   RecordId scanRid;
 	Page *curPage;
@@ -818,11 +5912,16 @@ int intScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operato
   if( highOp == LT ) { std::cout << ")"; } else { std::cout << "]"; }
   std::cout << std::endl;
 
+  char lowValStr[100];
+  sprintf(lowValStr,"%05d string record",lowVal);
+  char highValStr[100];
+  sprintf(highValStr,"%05d string record",highVal);
+
   int numResults = 0;
 
 	try
 	{
-  	index->startScan(&lowVal, lowOp, &highVal, highOp);
+  	index->startScan(lowValStr, lowOp, highValStr, highOp);
 	}
 	catch(const NoSuchKeyFoundException &e)
 	{
@@ -841,7 +5940,7 @@ int intScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operato
 
 			if( numResults < 5 )
 			{
-				std::cout << "at:" << scanRid.page_number << "," << scanRid.slot_number;
+				std::cout << "rid:" << scanRid.page_number << "," << scanRid.slot_number;
 				std::cout << " -->:" << myRec.i << ":" << myRec.d << ":" << myRec.s << ":" <<std::endl;
 			}
 			else if( numResults == 5 )
@@ -867,6 +5966,175 @@ int intScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operato
 	return numResults;
 }
 
+int stringLookup(BTreeIndex *index, int lowVal, int highVal)
+{
+    // count the keys in [lowVal, highVal) found by single and batch lookups of the strings
+    std::cout << "String lookup for [" << lowVal << "," << highVal << ")" << std::endl;
+    std::vector<std::string> strs;
+    std::vector<const char *> keys;
+    for (int key = lowVal; key < highVal; key++)
+    {
+        char str[100];
+        sprintf(str, "%05d string record", key);
+        strs.push_back(str);
+    }
+    for (const std::string &str : strs)
+    {
+        keys.push_back(str.c_str());
+    }
+
+    std::vector<RecordId> outRids(keys.size());
+    std::unique_ptr<bool[]> found(new bool[keys.size()]);
+    int numResults = index->lookupBatch(keys.data(), keys.size(), outRids.data(), found.get());
+    for (std::size_t i = 0; i < keys.size(); i++)
+    {
+        RecordId outRid;
+        if (found[i] != index->lookup(keys[i], outRid) || (found[i] && outRid != outRids[i]))
+        {
+            return -1;
+        }
+    }
+    return numResults;
+}
+
+void stringTest3()
+{
+  std::cout << "Create a B+ Tree index on a few hot string keys and insert more of them" << std::endl;
+  BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING);
+
+	// the records inserted by intTest12 are bulk loaded as well
+	checkPassFail(hotKeyScan(&index, "00000", "00999 ~", offsetof(tuple,s)), 30000)
+	checkPassFail(hotKeyScan(&index, "00000", "00003 ~", offsetof(tuple,s)), stringScan(&index, 0, GTE, 3, LTE))
+
+  insertHotKeysRandom(&index, 5000, 4, offsetof(tuple,s));
+	checkPassFail(hotKeyScan(&index, "00000", "00999 ~", offsetof(tuple,s)), 35000)
+	checkPassFail(stringScan(&index, 0, GTE, 999, LTE), 35000)
+}
+
+void stringTest4()
+{
+  std::cout << "Create a B+ Tree index on string keys, delete entries from it and insert more" << std::endl;
+  BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING);
+
+	// the records inserted by intTest13 are bulk loaded as well
+	checkPassFail(deleteEntries(&index, "00000", "04999 ~", 3, offsetof(tuple,s)), 6000)
+	checkPassFail(hotKeyScan(&index, "00000", "04999 ~", offsetof(tuple,s)), 12000)
+
+  // empty the tree lazily, then compact it
+  index.setDeletePolicy(DELETE_LAZY);
+	checkPassFail(deleteEntries(&index, "00000", "04999 ~", 1, offsetof(tuple,s)), 12000)
+  index.compact();
+	checkPassFail(stringScan(&index, 0, GTE, 4999, LTE), 0)
+
+  insertHotKeysRandom(&index, 2000, 4, offsetof(tuple,s));
+	checkPassFail(hotKeyScan(&index, "00000", "04999 ~", offsetof(tuple,s)), 2000)
+}
+
+void stringTest5()
+{
+  std::cout << "Create a B+ Tree index on the string field and use it from several threads" << std::endl;
+  BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING);
+
+	checkPassFail(concurrentEntries(&index, STRING, 20000), 0)
+  int numKept;
+  BTreeCursor cursor(&index);
+	checkPassFail(concurrentScan(&cursor, STRING, 20000, numKept), 10000)
+	checkPassFail(numKept, 10000)
+}
+
+void stringTest2()
+{
+  std::cout << "Create a B+ Tree index on long string paths and insert paths of another table into it" << std::endl;
+  BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING);
+
+	checkPassFail(pathScan(&index, pathKey("events", 100), GTE, pathKey("events", 200), LT), 100)
+	checkPassFail(pathScan(&index, pathKey("events", 4990), GT, pathKey("events", 9999), LTE), 9)
+	checkPassFail(pathScan(&index, "/", GTE, "/~", LT), 5000)
+	checkPassFail(pathLookup(&index, "events", 4990, 5010), 10)
+
+  // the new paths sort before the old ones, so the prefixes shared in the nodes get shorter
+  insertPathsRandom(&index, "clicks", 20000);
+
+	checkPassFail(pathScan(&index, "/", GTE, "/~", LT), 25000)
+	checkPassFail(pathScan(&index, "/data/warehouse/clicks", GT, "/data/warehouse/clicks~", LT), 20000)
+	checkPassFail(pathScan(&index, pathKey("clicks", 19995), GTE, pathKey("events", 4), LTE), 10)
+	checkPassFail(pathLookup(&index, "clicks", 19990, 20010), 10)
+	checkPassFail(pathLookup(&index, "events", 0, 5000), 5000)
+}
+
+std::string pathKey(const char *table, int i)
+{
+    char str[64];
+    sprintf(str, "/data/warehouse/%s/2024/part-%06d.parquet", table, i);
+    return str;
+}
+
+int pathScan(BTreeIndex *index, const std::string &lowVal, Operator lowOp, const std::string &highVal, Operator highOp)
+{
+    // count the records returned in batches, checking that their strings lie within the range in order
+    std::cout << "Path scan for " << lowVal << "," << highVal << std::endl;
+    try
+    {
+        index->startScan(lowVal.c_str(), lowOp, highVal.c_str(), highOp);
+    }
+    catch(const NoSuchKeyFoundException &e)
+    {
+        return 0;
+    }
+
+    std::vector<RecordId> outRids(100);
+    int numResults = 0;
+    std::string lastKey;
+    std::size_t n;
+    while ((n = index->scanNextBatch(outRids.data(), outRids.size())) > 0)
+    {
+        for (std::size_t i = 0; i < n; i++)
+        {
+            Page *curPage;
+            bufMgr->readPage(file1, outRids[i].page_number, curPage);
+            RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(outRids[i]).data()));
+            bufMgr->unPinPage(file1, outRids[i].page_number, false);
+            std::string key = myRec.s;
+            if (key <= lastKey || (lowOp == GT ? key <= lowVal : key < lowVal)
+                || (highOp == LT ? key >= highVal : key > highVal))
+            {
+                index->endScan();
+                return -1;
+            }
+            lastKey = key;
+            numResults++;
+        }
+    }
+    index->endScan();
+    return numResults;
+}
+
+int pathLookup(BTreeIndex *index, const char *table, int lowVal, int highVal)
+{
+    // count the paths of the table in [lowVal, highVal) found, checking the records they point to
+    std::cout << "Path lookup for " << table << " [" << lowVal << "," << highVal << ")" << std::endl;
+    int numResults = 0;
+    for (int i = lowVal; i < highVal; i++)
+    {
+        std::string key = pathKey(table, i);
+        RecordId outRid;
+        if (!index->lookup(key.c_str(), outRid))
+        {
+            continue;
+        }
+        Page *curPage;
+        bufMgr->readPage(file1, outRid.page_number, curPage);
+        RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(outRid).data()));
+        bufMgr->unPinPage(file1, outRid.page_number, false);
+        if (key != myRec.s)
+        {
+            return -1;
+        }
+        numResults++;
+    }
+    return numResults;
+}
+
 // -----------------------------------------------------------------------------
 // errorTests
 // -----------------------------------------------------------------------------
@@ -981,6 +6249,15 @@ void errorTests()
 			std::cout << "BadScanrangeException Test 1 Passed." << std::endl;
 		}
 
+		// Buffer manager status codes
+		std::cout << "Unpin pages through the non-throwing calls" << std::endl;
+		Page *page;
+		bufMgr->readPage(file1, new_page_number, page);
+		checkPassFail((int)bufMgr->tryUnPinPage(file1, new_page_number, false), (int)BufStatus::OK)
+		checkPassFail((int)bufMgr->tryUnPinPage(file1, new_page_number, false), (int)BufStatus::PAGE_NOT_PINNED)
+		bufMgr->flushFile(file1);
+		checkPassFail((int)bufMgr->tryUnPinPage(file1, new_page_number, false), (int)BufStatus::PAGE_NOT_FOUND)
+
 		deleteRelation();
 	}
 
@@ -1009,3 +6286,96 @@ void deleteRelation()
 	{
 	}
 }
+
+// -----------------------------------------------------------------------------
+// downgradeLayout
+// -----------------------------------------------------------------------------
+
+void downgradeLayout(const std::string &fileName)
+{
+	// the original layout has the first 16 bytes of the header followed right by page 1
+	std::string bytes;
+	{
+		std::ifstream in(fileName, std::ios::binary);
+		bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+	}
+	PageId numPages;
+	memcpy(&numPages, bytes.data(), sizeof(PageId));
+	bytes.resize(numPages * Page::SIZE, 0);
+	std::ofstream out(fileName, std::ios::binary | std::ios::trunc);
+	out.write(bytes.data(), 4 * sizeof(PageId));
+	out.write(bytes.data() + Page::SIZE, (numPages - 1) * Page::SIZE);
+}
+
+// -----------------------------------------------------------------------------
+// createLegacyIndex
+// -----------------------------------------------------------------------------
+
+void createLegacyIndex(const std::string &indexName, int attrByteOffset)
+{
+	// the INTEGER keys of the relation in order
+	std::vector<std::pair<int, RecordId>> entries;
+	{
+		FileScan fscan(relationName, bufMgr);
+		try
+		{
+			while (true)
+			{
+				RecordId rid;
+				fscan.scanNext(rid);
+				int key;
+				memcpy(&key, fscan.getRecordView().data() + attrByteOffset, sizeof(key));
+				entries.emplace_back(key, rid);
+			}
+		}
+		catch(const EndOfFileException &e)
+		{
+		}
+	}
+	std::sort(entries.begin(), entries.end(),
+	          [](const std::pair<int, RecordId> &a, const std::pair<int, RecordId> &b) { return a.first < b.first; });
+
+	// as INDEX_FORMAT_V1 laid it out: the meta page, a root with an int level over full leaves, and no node header
+	const int numLeaves = (entries.size() + INTARRAYLEAFSIZE - 1) / INTARRAYLEAFSIZE;
+	BlobFile file = BlobFile::create(indexName);
+	std::vector<char> bytes(Page::SIZE, 0);
+	auto writeBytes = [&](PageId pageNo) {
+		Page page;
+		memcpy((void *)&page, bytes.data(), Page::SIZE);
+		file.writePage(pageNo, page);
+		std::fill(bytes.begin(), bytes.end(), 0);
+	};
+	PageId metaPageNo, rootPageNo, leafPageNo;
+	file.allocatePage(metaPageNo);
+	file.allocatePage(rootPageNo);
+	auto *meta = (IndexMetaInfo *)bytes.data();
+	indexName.copy(meta->relationName, 20);
+	meta->attrByteOffset = attrByteOffset;
+	meta->attrType = INTEGER;
+	meta->rootPageNo = rootPageNo;
+	writeBytes(metaPageNo);
+
+	std::vector<char> root(Page::SIZE, 0);
+	auto *rootPtr = (NonLeafNodeInt *)root.data();
+	rootPtr->level = 1;
+	for (int l = 0; l < numLeaves; l++)
+	{
+		file.allocatePage(leafPageNo);
+		auto *leafPtr = (LeafNodeInt *)bytes.data();
+		std::size_t first = (std::size_t)l * INTARRAYLEAFSIZE;
+		for (std::size_t j = first; j < entries.size() && j < first + INTARRAYLEAFSIZE; j++)
+		{
+			leafPtr->keyArray[j - first] = entries[j].first;
+			leafPtr->ridArray[j - first] = entries[j].second;
+		}
+		leafPtr->rightSibPageNo = l + 1 < numLeaves ? leafPageNo + 1 : Page::INVALID_NUMBER;
+		writeBytes(leafPageNo);
+		if (l > 0)
+		{
+			rootPtr->keyArray[l - 1] = entries[first].first;
+		}
+		rootPtr->pageNoArray[l] = leafPageNo;
+	}
+	bytes = root;
+	writeBytes(rootPageNo);
+}
@@ -0,0 +1,102 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+namespace badgerdb
+{
+
+/**
+ * @brief Normalized keys are unsigned integers or byte strings ordered as the values they are made of,
+ * so that keys of every type compare with a fixed width unsigned comparison or with memcmp.
+ */
+
+/**
+ * Normalize an INTEGER value: flipping its sign bit orders it as an unsigned integer.
+ * @param value Integer value
+ * @return the normalized key
+ */
+inline std::uint32_t normalizeKey(int value)
+{
+	return (std::uint32_t)value ^ 0x80000000u;
+}
+
+/**
+ * Normalize a DOUBLE value: the bits of a negative double are all flipped, since it orders backwards,
+ * and only the sign bit of the others, which orders its IEEE bits as an unsigned integer.
+ * Negative zero is normalized as zero, which it equals.
+ * @param value Double value, not a NaN
+ * @return the normalized key
+ */
+inline std::uint64_t normalizeKey(double value)
+{
+	std::uint64_t bits;
+	value += 0.0;
+	memcpy(&bits, &value, sizeof(bits));
+	return (bits >> 63) ? ~bits : bits | 0x8000000000000000ull;
+}
+
+/**
+ * Store an unsigned integer in big-endian order, so that its bytes compare with memcmp as its value.
+ * @param value Integer to store
+ * @param out Returned bytes
+ * @return the number of bytes stored
+ */
+template <class U>
+inline int storeBigEndian(U value, char *out)
+{
+	for (int i = sizeof(U) - 1; i >= 0; --i)
+	{
+		out[i] = (char)(value & 0xFF);
+		value >>= 8;
+	}
+	return sizeof(U);
+}
+
+/**
+ * Encode an INTEGER value into the bytes of its normalized key.
+ * @param value Integer value
+ * @param out Returned 4 bytes
+ * @return the number of bytes stored
+ */
+inline int encodeNormalized(int value, char *out)
+{
+	return storeBigEndian(normalizeKey(value), out);
+}
+
+/**
+ * Encode a DOUBLE value into the bytes of its normalized key.
+ * @param value Double value, not a NaN
+ * @param out Returned 8 bytes
+ * @return the number of bytes stored
+ */
+inline int encodeNormalized(double value, char *out)
+{
+	return storeBigEndian(normalizeKey(value), out);
+}
+
+/**
+ * Encode a char string into its characters followed by a zero byte. A char string holds no zero byte,
+ * so the terminator orders it before its extensions and no escaping is needed: the encoding of a string
+ * is never a prefix of that of another, and values encoded after it compare only between equal strings.
+ * @param value Char string
+ * @param maxLength Maximum number of characters kept
+ * @param out Returned bytes, room for maxLength + 1 of them
+ * @return the number of bytes stored
+ */
+inline int encodeNormalized(const char *value, int maxLength, char *out)
+{
+	int length = strnlen(value, maxLength);
+	memcpy(out, value, length);
+	out[length] = 0;
+	return length + 1;
+}
+
+}
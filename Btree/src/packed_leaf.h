@@ -0,0 +1,450 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "btree.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace badgerdb
+{
+
+/**
+ * @brief Flag of the format of a packed INTEGER leaf, from INDEX_FORMAT_V7 on.
+ * A packed leaf stores its keys as offsets from a base key, and its record IDs as page numbers offset
+ * from a base page followed by slot numbers, each array in the fewest bytes (1, 2 or 4) holding its
+ * largest value. The header and the key offsets take the key slots before the high key, the page and
+ * slot numbers the record ID slots, so the high key and the trailer are where they are in any leaf.
+ * Packed leaves are written by the bulk loader and never hold a posting list. They keep their layout
+ * when entries are removed, and are unpacked into two leaves by the first insertion.
+ */
+const std::uint8_t PACKED_LEAF = 0x80;
+
+/**
+ * @brief Frames of reference and widths of the arrays of a packed leaf, at the start of its key slots.
+ */
+struct PackedLeafHeader{
+  /**
+   * Key the offsets are taken from, the first key of the leaf when it was packed.
+   */
+	int keyBase;
+
+  /**
+   * Page number the page offsets are taken from, the least one of the leaf when it was packed.
+   */
+	PageId pageBase;
+
+  /**
+   * Number of bytes of each key offset.
+   */
+	std::uint8_t keyWidth;
+
+  /**
+   * Number of bytes of each page offset.
+   */
+	std::uint8_t pageWidth;
+
+  /**
+   * Number of bytes of each slot number.
+   */
+	std::uint8_t slotWidth;
+};
+
+/**
+ * @brief Number of bytes of a packed leaf holding its key offsets.
+ */
+const int PACKED_KEY_BYTES = (NodeCapacity<int>::LEAF - 1) * (int)sizeof(int) - (int)sizeof(PackedLeafHeader);
+
+/**
+ * @brief Number of bytes of a packed leaf holding its page offsets and slot numbers.
+ */
+const int PACKED_RID_BYTES = NodeCapacity<int>::LEAF * (int)sizeof(RecordId);
+
+/**
+ * Find the fewest bytes (1, 2 or 4) holding an unsigned value.
+ * @param maxValue Largest value to hold
+ * @return the number of bytes
+ */
+inline int packedWidth(std::uint32_t maxValue)
+{
+	return maxValue <= 0xFF ? 1 : maxValue <= 0xFFFF ? 2 : 4;
+}
+
+/**
+ * Find the number of entries a packed leaf holds with the given widths.
+ * @param keyWidth Number of bytes of each key offset
+ * @param pageWidth Number of bytes of each page offset
+ * @param slotWidth Number of bytes of each slot number
+ * @return the number of entries
+ */
+inline int packedCapacity(int keyWidth, int pageWidth, int slotWidth)
+{
+	return std::min(PACKED_KEY_BYTES / keyWidth, PACKED_RID_BYTES / (pageWidth + slotWidth));
+}
+
+/**
+ * Load the i-th value of an array of 1, 2 or 4 byte unsigned values.
+ * @param values Array of values
+ * @param width Number of bytes of each value
+ * @param i Index of the value
+ * @return the value
+ */
+inline std::uint32_t loadPacked(const unsigned char *values, int width, int i)
+{
+	switch (width)
+	{
+	case 1:
+		return values[i];
+	case 2:
+	{
+		std::uint16_t value;
+		memcpy(&value, values + 2 * i, sizeof(value));
+		return value;
+	}
+	default:
+	{
+		std::uint32_t value;
+		memcpy(&value, values + 4 * i, sizeof(value));
+		return value;
+	}
+	}
+}
+
+/**
+ * Store the i-th value of an array of 1, 2 or 4 byte unsigned values.
+ * @param values Array of values
+ * @param width Number of bytes of each value
+ * @param i Index of the value
+ * @param value Value, holding in width bytes
+ */
+inline void storePacked(unsigned char *values, int width, int i, std::uint32_t value)
+{
+	switch (width)
+	{
+	case 1:
+		values[i] = (unsigned char)value;
+		break;
+	case 2:
+	{
+		std::uint16_t narrow = (std::uint16_t)value;
+		memcpy(values + 2 * i, &narrow, sizeof(narrow));
+		break;
+	}
+	default:
+		memcpy(values + 4 * i, &value, sizeof(value));
+		break;
+	}
+}
+
+/**
+ * Check whether a leaf is packed. Only INTEGER leaves may be.
+ * @param leafPtr Leaf node
+ * @return false
+ */
+template <class T>
+inline bool isPacked(const LeafNode<T> *)
+{
+	return false;
+}
+
+/**
+ * Check whether an INTEGER leaf is packed.
+ * @param leafPtr Leaf node
+ * @return whether it is packed or not
+ */
+inline bool isPacked(const LeafNodeInt *leafPtr)
+{
+	return (leafPtr->format & PACKED_LEAF) != 0;
+}
+
+/**
+ * Get the header of a packed leaf.
+ * @param leafPtr Packed leaf node
+ * @return the header
+ */
+inline const PackedLeafHeader *packedHeader(const LeafNodeInt *leafPtr)
+{
+	return (const PackedLeafHeader *)leafPtr->keyArray;
+}
+
+/**
+ * Get the key offsets of a packed leaf.
+ * @param leafPtr Packed leaf node
+ * @return the key offsets
+ */
+inline unsigned char *packedKeys(const LeafNodeInt *leafPtr)
+{
+	return (unsigned char *)(packedHeader(leafPtr) + 1);
+}
+
+/**
+ * Get the page offsets of a packed leaf.
+ * @param leafPtr Packed leaf node
+ * @return the page offsets
+ */
+inline unsigned char *packedPages(const LeafNodeInt *leafPtr)
+{
+	return (unsigned char *)leafPtr->ridArray;
+}
+
+/**
+ * Get the slot numbers of a packed leaf, which follow room for as many page offsets as it can hold.
+ * @param leafPtr Packed leaf node
+ * @return the slot numbers
+ */
+inline unsigned char *packedSlots(const LeafNodeInt *leafPtr)
+{
+	const PackedLeafHeader *header = packedHeader(leafPtr);
+	return packedPages(leafPtr) + PACKED_RID_BYTES / (header->pageWidth + header->slotWidth) * header->pageWidth;
+}
+
+/**
+ * Get the i-th key of an INTEGER leaf, packed or not.
+ * @param leafPtr Leaf node
+ * @param i Index of the key
+ * @return the key
+ */
+inline int nodeKey(const LeafNodeInt *leafPtr, int i)
+{
+	if (!isPacked(leafPtr))
+	{
+		return leafPtr->keyArray[i];
+	}
+	const PackedLeafHeader *header = packedHeader(leafPtr);
+	return (int)((std::uint32_t)header->keyBase + loadPacked(packedKeys(leafPtr), header->keyWidth, i));
+}
+
+/**
+ * Find the cutoff of the given bound in the sorted keys of an INTEGER leaf, packed or not.
+ * The keys of a packed leaf are searched in place as offsets, the value being turned into one.
+ * @see searchBoundKey
+ * @tparam op Operator (LT/LTE/GTE/GT)
+ * @param leafPtr Leaf node to search in
+ * @param val A given key value
+ * @return the position, between 0 and the number of keys
+ */
+template <Operator op>
+inline int searchBoundKey(const LeafNodeInt *leafPtr, const int &val)
+{
+	int n = leafPtr->numKeys;
+	if (!isPacked(leafPtr))
+	{
+		return searchBoundKey<op>(leafPtr->keyArray, n, val);
+	}
+
+	// a value below the base precedes all keys, one beyond the widest offset follows them
+	const PackedLeafHeader *header = packedHeader(leafPtr);
+	if (val < header->keyBase)
+	{
+		return 0;
+	}
+	std::uint32_t offset = (std::uint32_t)val - (std::uint32_t)header->keyBase;
+	const unsigned char *keys = packedKeys(leafPtr);
+	const bool orEqual = OperatorTraits<op>::orEqual;
+	switch (header->keyWidth)
+	{
+	case 1:
+		return offset > 0xFF ? n : searchKeys<orEqual>(keys, n, (unsigned char)offset);
+	case 2:
+		return offset > 0xFFFF ? n : searchKeys<orEqual>((const std::uint16_t *)keys, n, (std::uint16_t)offset);
+	default:
+		return searchKeys<orEqual>((const std::uint32_t *)keys, n, offset);
+	}
+}
+
+#if defined(__SSE2__)
+/**
+ * Load four consecutive values of an array of 1, 2 or 4 byte unsigned values, widened to 32 bits.
+ * @param values Array of values
+ * @param width Number of bytes of each value
+ * @param i Index of the first value
+ * @return the values
+ */
+inline __m128i loadPacked4(const unsigned char *values, int width, int i)
+{
+	const __m128i zero = _mm_setzero_si128();
+	switch (width)
+	{
+	case 1:
+	{
+		int bytes;
+		memcpy(&bytes, values + i, sizeof(bytes));
+		return _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), zero), zero);
+	}
+	case 2:
+		return _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i *)(values + 2 * i)), zero);
+	default:
+		return _mm_loadu_si128((const __m128i *)(values + 4 * i));
+	}
+}
+#endif
+
+/**
+ * Decode consecutive record IDs of a packed leaf.
+ * They are decoded four at a time with SSE2 when the compiler targets it.
+ * @param leafPtr Packed leaf node
+ * @param pos Position of the first record ID
+ * @param cnt Number of record IDs
+ * @param out Returned record IDs
+ */
+inline void decodePackedRids(const LeafNodeInt *leafPtr, int pos, int cnt, RecordId *out)
+{
+	const PackedLeafHeader *header = packedHeader(leafPtr);
+	const unsigned char *pages = packedPages(leafPtr);
+	const unsigned char *slots = packedSlots(leafPtr);
+	int i = 0;
+#if defined(__SSE2__)
+	// a slot number widened to 32 bits is followed by the zero padding of its record ID
+	const __m128i base = _mm_set1_epi32((int)header->pageBase);
+	for (; i + 4 <= cnt; i += 4)
+	{
+		__m128i pageNos = _mm_add_epi32(loadPacked4(pages, header->pageWidth, pos + i), base);
+		__m128i slotNos = loadPacked4(slots, header->slotWidth, pos + i);
+		_mm_storeu_si128((__m128i *)(out + i), _mm_unpacklo_epi32(pageNos, slotNos));
+		_mm_storeu_si128((__m128i *)(out + i + 2), _mm_unpackhi_epi32(pageNos, slotNos));
+	}
+#endif
+	for (; i < cnt; ++i)
+	{
+		out[i].page_number = header->pageBase + loadPacked(pages, header->pageWidth, pos + i);
+		out[i].slot_number = (SlotId)loadPacked(slots, header->slotWidth, pos + i);
+		out[i].padding = 0;
+	}
+}
+
+/**
+ * Get the i-th record ID of a leaf.
+ * @param leafPtr Leaf node
+ * @param i Index of the entry
+ * @return the record ID
+ */
+template <class T>
+inline RecordId leafRid(const LeafNode<T> *leafPtr, int i)
+{
+	return leafPtr->ridArray[i];
+}
+
+/**
+ * Get the i-th record ID of an INTEGER leaf, packed or not.
+ * @param leafPtr Leaf node
+ * @param i Index of the entry
+ * @return the record ID
+ */
+inline RecordId leafRid(const LeafNodeInt *leafPtr, int i)
+{
+	if (!isPacked(leafPtr))
+	{
+		return leafPtr->ridArray[i];
+	}
+	RecordId rid;
+	decodePackedRids(leafPtr, i, 1, &rid);
+	return rid;
+}
+
+/**
+ * Get the record IDs of a leaf as an array.
+ * @param leafPtr Leaf node
+ * @param decoded Buffer for the record IDs of a packed leaf
+ * @return the record IDs
+ */
+template <class T>
+inline const RecordId *leafRids(const LeafNode<T> *leafPtr, std::vector<RecordId> &)
+{
+	return leafPtr->ridArray;
+}
+
+/**
+ * Get the record IDs of an INTEGER leaf as an array, decoding them into the buffer if it is packed.
+ * @param leafPtr Leaf node
+ * @param decoded Buffer for the record IDs of a packed leaf
+ * @return the record IDs
+ */
+inline const RecordId *leafRids(const LeafNodeInt *leafPtr, std::vector<RecordId> &decoded)
+{
+	if (!isPacked(leafPtr))
+	{
+		return leafPtr->ridArray;
+	}
+	decoded.resize(leafPtr->numKeys);
+	decodePackedRids(leafPtr, 0, leafPtr->numKeys, decoded.data());
+	return decoded.data();
+}
+
+/**
+ * Pack sorted entries into an empty leaf. None may refer to a posting list.
+ * @param leafPtr Leaf node, initialized
+ * @param keys Keys of the entries
+ * @param rids Record IDs of the entries
+ * @param n Number of entries, at least one
+ * @return whether the entries fit packed, the leaf being left untouched otherwise
+ */
+inline bool packLeaf(LeafNodeInt *leafPtr, const int *keys, const RecordId *rids, int n)
+{
+	PageId minPage = rids[0].page_number;
+	PageId maxPage = minPage;
+	SlotId maxSlot = 0;
+	for (int i = 0; i < n; ++i)
+	{
+		minPage = std::min(minPage, rids[i].page_number);
+		maxPage = std::max(maxPage, rids[i].page_number);
+		maxSlot = std::max(maxSlot, rids[i].slot_number);
+	}
+	int keyWidth = packedWidth((std::uint32_t)keys[n - 1] - (std::uint32_t)keys[0]);
+	int pageWidth = packedWidth(maxPage - minPage);
+	int slotWidth = packedWidth(maxSlot);
+	if (n > packedCapacity(keyWidth, pageWidth, slotWidth))
+	{
+		return false;
+	}
+
+	PackedLeafHeader *header = (PackedLeafHeader *)leafPtr->keyArray;
+	header->keyBase = keys[0];
+	header->pageBase = minPage;
+	header->keyWidth = keyWidth;
+	header->pageWidth = pageWidth;
+	header->slotWidth = slotWidth;
+	unsigned char *keyOffsets = packedKeys(leafPtr);
+	unsigned char *pages = packedPages(leafPtr);
+	unsigned char *slots = packedSlots(leafPtr);
+	for (int i = 0; i < n; ++i)
+	{
+		storePacked(keyOffsets, keyWidth, i, (std::uint32_t)keys[i] - (std::uint32_t)keys[0]);
+		storePacked(pages, pageWidth, i, rids[i].page_number - minPage);
+		storePacked(slots, slotWidth, i, rids[i].slot_number);
+	}
+	leafPtr->numKeys = n;
+	leafPtr->format = INDEX_FORMAT_VERSION | PACKED_LEAF;
+	return true;
+}
+
+/**
+ * Remove consecutive entries from a packed leaf, which stays packed.
+ * @param leafPtr Packed leaf node
+ * @param pos Position of the first entry to remove
+ * @param cnt Number of entries to remove
+ */
+inline void erasePackedEntries(LeafNodeInt *leafPtr, int pos, int cnt)
+{
+	const PackedLeafHeader *header = packedHeader(leafPtr);
+	int tail = leafPtr->numKeys - pos - cnt;
+	unsigned char *arrays[] = {packedKeys(leafPtr), packedPages(leafPtr), packedSlots(leafPtr)};
+	int widths[] = {header->keyWidth, header->pageWidth, header->slotWidth};
+	for (int a = 0; a < 3; ++a)
+	{
+		memmove(arrays[a] + pos * widths[a], arrays[a] + (pos + cnt) * widths[a], tail * widths[a]);
+	}
+	leafPtr->numKeys -= cnt;
+}
+
+}
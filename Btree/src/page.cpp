@@ -34,6 +34,10 @@ void Page::initialize() {
 }
 
 RecordId Page::insertRecord(const std::string& record_data) {
+  return insertRecord(std::string_view(record_data));
+}
+
+RecordId Page::insertRecord(std::string_view record_data) {
   if (!hasSpaceForRecord(record_data)) {
     throw InsufficientSpaceException(
         page_number(), record_data.length(), getFreeSpace());
@@ -44,15 +48,22 @@ RecordId Page::insertRecord(const std::string& record_data) {
 }
 
 std::string Page::getRecord(const RecordId& record_id) const {
+  return std::string(getRecordView(record_id));
+}
+
+std::string_view Page::getRecordView(const RecordId& record_id) const {
   validateRecordId(record_id);
   const PageSlot& slot = getSlot(record_id.slot_number);
-	std::string retStr = std::string(data_, DATA_SIZE).substr(slot.item_offset, slot.item_length);
-
-	return retStr;
+  return std::string_view(data_ + slot.item_offset, slot.item_length);
 }
 
 void Page::updateRecord(const RecordId& record_id,
                         const std::string& record_data) {
+  updateRecord(record_id, std::string_view(record_data));
+}
+
+void Page::updateRecord(const RecordId& record_id,
+                        std::string_view record_data) {
   validateRecordId(record_id);
   const PageSlot* slot = getSlot(record_id.slot_number);
   const std::size_t free_space_after_delete =
@@ -98,13 +109,9 @@ void Page::deleteRecord(const RecordId& record_id,
     }
   }
   // If we have data to move, shift it to the right.
+  // The ranges may overlap, so the data is moved in place rather than through a copy of the page.
   if (move_bytes > 0) {
-    const std::string& data_to_move = std::string(data_, DATA_SIZE).substr(move_offset, move_bytes);
-
-		for(std::uint16_t i = 0; i < move_bytes; i++)
-			data_[i + move_offset + slot->item_length] = data_to_move[i];
-
-    //data_.replace(move_offset + slot->item_length, move_bytes, data_to_move);
+    memmove(data_ + move_offset + slot->item_length, data_ + move_offset, move_bytes);
   }
   header_.free_space_upper_bound += slot->item_length;
 
@@ -135,7 +142,7 @@ void Page::deleteRecord(const RecordId& record_id,
   }
 }
 
-bool Page::hasSpaceForRecord(const std::string& record_data) const {
+bool Page::hasSpaceForRecord(std::string_view record_data) const {
   std::size_t record_size = record_data.length();
   if (header_.num_free_slots == 0) {
     record_size += sizeof(PageSlot);
@@ -176,7 +183,7 @@ SlotId Page::getAvailableSlot() {
 }
 
 void Page::insertRecordInSlot(const SlotId slot_number,
-                              const std::string& record_data) {
+                              std::string_view record_data) {
   if (slot_number > header_.num_slots ||
       slot_number == INVALID_SLOT) {
     throw InvalidSlotException(page_number(), slot_number);
@@ -192,8 +199,7 @@ void Page::insertRecordInSlot(const SlotId slot_number,
   header_.free_space_upper_bound = slot->item_offset;
   --header_.num_free_slots;
 
-	for(int i = 0; i < slot->item_length; i++)
-		data_[i + slot->item_offset] = record_data[i];
+	memcpy(data_ + slot->item_offset, record_data.data(), slot->item_length);
 
   //data_.replace(slot->item_offset, slot->item_length, record_data);
 }
@@ -11,6 +11,7 @@
 #include <stdint.h>
 #include <memory>
 #include <string>
+#include <string_view>
 
 //#include <gtest/gtest.h>
 #include "types.h"
@@ -105,13 +106,18 @@ class PageIterator;
  *
  * @warning This class is not threadsafe.
  */
+#ifndef BADGERDB_PAGE_SIZE
+#define BADGERDB_PAGE_SIZE 8192
+#endif
+
 class Page {
  public:
   /**
-   * Page size in bytes.  If this is changed, database files created with a
-   * different page size value will be unreadable by the resulting binaries.
+   * Page size in bytes, BADGERDB_PAGE_SIZE if it is defined when building.
+   * If this is changed, database files created with a different page size
+   * value will be unreadable by the resulting binaries.
    */
-  static const std::size_t SIZE = 8192;
+  static const std::size_t SIZE = BADGERDB_PAGE_SIZE;
 
   /**
    * Size of page free space area in bytes.
@@ -141,6 +147,15 @@ class Page {
    */
   RecordId insertRecord(const std::string& record_data);
 
+  /**
+   * Inserts a new record into the page, copying it from memory it does not
+   * own, e.g. another page.
+   *
+   * @param record_data  Bytes that compose the record.
+   * @return  ID of the newly inserted record.
+   */
+  RecordId insertRecord(std::string_view record_data);
+
   /**
    * Returns the record with the given ID.  Returned data is a copy of what is
    * stored on the page; use updateRecord to change it.
@@ -151,6 +166,17 @@ class Page {
    */
   std::string getRecord(const RecordId& record_id) const;
 
+  /**
+   * Returns the record with the given ID without copying it.  The view points
+   * into the page, and is valid as long as the page is not changed or, for a
+   * page in the buffer pool, as long as it is pinned.
+   *
+   * @see getRecord
+   * @param record_id  ID of the record to return.
+   * @return  View of the record.
+   */
+  std::string_view getRecordView(const RecordId& record_id) const;
+
   /**
    * Updates the record with the given ID, replacing its data with a new
    * version.  This is equivalent to deleting the old record and inserting a
@@ -161,6 +187,15 @@ class Page {
    */
   void updateRecord(const RecordId& record_id, const std::string& record_data);
 
+  /**
+   * Updates the record with the given ID, copying its new version from memory
+   * the page does not own.
+   *
+   * @param record_id   ID of record to update.
+   * @param record_data Updated bytes that compose the record.
+   */
+  void updateRecord(const RecordId& record_id, std::string_view record_data);
+
   /**
    * Deletes the record with the given ID.  Page is compacted upon delete to
    * ensure that data of all records is contiguous.  Slot array is compacted if
@@ -176,7 +211,7 @@ class Page {
    * @param record_data Bytes that compose the record.
    * @return  Whether the page can hold the data.
    */
-  bool hasSpaceForRecord(const std::string& record_data) const;
+  bool hasSpaceForRecord(std::string_view record_data) const;
 
   /**
    * Returns this page's free space in bytes.
@@ -302,7 +337,7 @@ class Page {
    * @throws  SlotInUseException  Thrown when given slot is in use.
    */
   void insertRecordInSlot(const SlotId slot_number,
-                          const std::string& record_data);
+                          std::string_view record_data);
 
   /**
    * Throws an exception if the given record ID is not valid for this page
@@ -343,5 +378,7 @@ static_assert(Page::SIZE > sizeof(PageHeader),
               "Page size must be large enough to hold header and data.");
 static_assert(Page::DATA_SIZE > 0,
               "Page must have some space to hold data.");
+static_assert(Page::SIZE >= 4096 && Page::SIZE <= 32768 && (Page::SIZE & (Page::SIZE - 1)) == 0,
+              "Page size must be a power of two from 4 KB to 32 KB, offsets in a page being 16 bits.");
 
 }
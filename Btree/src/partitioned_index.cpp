@@ -0,0 +1,331 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+#include "partitioned_index.h"
+#include "filescan.h"
+#include "key_filter.h"
+#include "exceptions/bad_index_info_exception.h"
+#include "exceptions/end_of_file_exception.h"
+#include "exceptions/index_scan_completed_exception.h"
+#include "exceptions/no_such_key_found_exception.h"
+#include "exceptions/scan_not_initialized_exception.h"
+
+namespace badgerdb {
+
+const std::size_t PartitionedIndex::SCAN_CHUNK;
+
+PartitionedIndex::PartitionedIndex(const std::string &relationName, BufMgr *bufMgr, int attrByteOffsetIn,
+                                   Datatype attrType, const std::vector<std::string> &partitionNames,
+                                   PartitionScheme schemeIn, const void *splitKeys)
+  : attributeType(attrType), attrByteOffset(attrByteOffsetIn), scheme(schemeIn), scanExecuting(false)
+{
+  if (partitionNames.empty() || (scheme == PARTITION_RANGE && splitKeys == NULL && partitionNames.size() > 1))
+    throw BadIndexInfoException("partitions");
+
+  // the split keys are compared as the keys they split are
+  if (scheme == PARTITION_RANGE)
+  {
+    for (std::size_t i = 0; i + 1 < partitionNames.size(); i++)
+    {
+      const void *key = attributeType == STRING ? ((const char * const *)splitKeys)[i]
+          : (const char *)splitKeys + i * (attributeType == INTEGER ? sizeof(int) : sizeof(double));
+      splits.push_back(encodeKey(key));
+      if (i > 0 && !(splits[i - 1] < splits[i]))
+        throw BadIndexInfoException("split keys");
+    }
+  }
+
+  // the partitions are only opened under the spreading their entries were inserted with
+  const std::string manifestName = partitionNames[0] + '.' + std::to_string(attrByteOffset) + ".parts";
+  const bool hasManifest = File::exists(manifestName);
+  if (hasManifest)
+  {
+    checkManifest(manifestName, bufMgr, partitionNames.size());
+  }
+  else
+  {
+    for (const std::string &name : partitionNames)
+    {
+      if (File::exists(name + '.' + std::to_string(attrByteOffset)))
+        throw BadIndexInfoException(manifestName);
+    }
+  }
+
+  // a partition is created from an empty relation of its name, which names its file
+  std::vector<bool> created(partitionNames.size(), false);
+  for (std::size_t i = 0; i < partitionNames.size(); i++)
+  {
+    std::string indexName = partitionNames[i] + '.' + std::to_string(attrByteOffset);
+    created[i] = !File::exists(indexName);
+    if (created[i])
+    {
+      if (File::exists(partitionNames[i]))
+        throw BadIndexInfoException(partitionNames[i]);
+      PageFile::create(partitionNames[i]);
+    }
+    partitions.emplace_back(new BTreeIndex(partitionNames[i], indexName, bufMgr, attrByteOffset, attributeType));
+    if (created[i])
+      File::remove(partitionNames[i]);
+  }
+  fillPartitions(relationName, bufMgr, created);
+  if (!hasManifest)
+    writeManifest(manifestName);
+}
+
+PartitionedIndex::~PartitionedIndex()
+{
+  if (scanExecuting)
+    endScan();
+}
+
+void PartitionedIndex::checkManifest(const std::string &manifestName, BufMgr *bufMgr,
+                                     std::size_t numPartitions) const
+{
+  // the header, then the split keys
+  std::vector<std::string> records;
+  {
+    FileScan fscan(manifestName, bufMgr);
+    try
+    {
+      while (true)
+      {
+        RecordId rid;
+        fscan.scanNext(rid);
+        records.emplace_back(fscan.getRecordView());
+      }
+    }
+    catch (const EndOfFileException &e)
+    {
+    }
+  }
+
+  PartitionManifest manifest;
+  if (records.size() != splits.size() + 1 || records[0].size() != sizeof(manifest))
+    throw BadIndexInfoException(manifestName);
+  std::memcpy(&manifest, records[0].data(), sizeof(manifest));
+  if (manifest.scheme != scheme || manifest.attrType != attributeType
+      || manifest.numPartitions != (int)numPartitions || !std::equal(splits.begin(), splits.end(), records.begin() + 1))
+    throw BadIndexInfoException(manifestName);
+}
+
+void PartitionedIndex::writeManifest(const std::string &manifestName) const
+{
+  PageFile file = PageFile::create(manifestName);
+  PartitionManifest manifest = {scheme, attributeType, (int)partitions.size()};
+  file.insertRecord(std::string_view((const char *)&manifest, sizeof(manifest)));
+  for (const std::string &split : splits)
+    file.insertRecord(split);
+}
+
+void PartitionedIndex::fillPartitions(const std::string &relationName, BufMgr *bufMgr,
+                                      const std::vector<bool> &created)
+{
+  if (std::find(created.begin(), created.end(), true) == created.end())
+    return;
+
+  // the keys of each partition are gathered in one pass over the relation, a char string with its terminator
+  const std::size_t keyWidth = attributeType == INTEGER ? sizeof(int)
+      : attributeType == DOUBLE ? sizeof(double) : STRINGSIZE + 1;
+  std::vector<std::vector<char>> keys(partitions.size());
+  std::vector<std::vector<RecordId>> rids(partitions.size());
+  {
+    FileScan fscan(relationName, bufMgr);
+    try
+    {
+      while (true)
+      {
+        RecordId rid;
+        fscan.scanNext(rid);
+        const char *key = fscan.getRecordView().data() + attrByteOffset;
+        std::size_t p = partitionOf(key);
+        if (!created[p])
+          continue;
+        std::vector<char> &partKeys = keys[p];
+        partKeys.resize(partKeys.size() + keyWidth, 0);
+        memcpy(&partKeys[partKeys.size() - keyWidth], key,
+               attributeType == STRING ? strnlen(key, STRINGSIZE) : keyWidth);
+        rids[p].push_back(rid);
+      }
+    }
+    catch (const EndOfFileException &e)
+    {
+    }
+  }
+
+  // then the partitions are filled in parallel, and packed
+  std::vector<std::thread> threads;
+  for (std::size_t p = 0; p < partitions.size(); p++)
+  {
+    if (!created[p] || rids[p].empty())
+      continue;
+    threads.emplace_back([this, p, keyWidth, &keys, &rids]() {
+      std::vector<const char *> strings;
+      const void *batch = keys[p].data();
+      if (attributeType == STRING)
+      {
+        for (std::size_t i = 0; i < rids[p].size(); i++)
+          strings.push_back(&keys[p][i * keyWidth]);
+        batch = strings.data();
+      }
+      partitions[p]->insertEntries(batch, rids[p].data(), rids[p].size());
+      partitions[p]->rebuild();
+    });
+  }
+  for (std::thread &thread : threads)
+    thread.join();
+}
+
+std::string PartitionedIndex::encodeKey(const void *key) const
+{
+  StringKey normalized;
+  BTreeIndex::normalizeKey(attributeType, key, normalized);
+  return std::string(normalized.data, normalized.length);
+}
+
+std::size_t PartitionedIndex::partitionOfEncoded(const std::string &encoded) const
+{
+  if (scheme == PARTITION_HASH)
+    return KeyFilter::hash(encoded.data(), encoded.size()) % partitions.size();
+
+  // the partition after the last split key not greater than the key
+  return std::upper_bound(splits.begin(), splits.end(), encoded) - splits.begin();
+}
+
+std::size_t PartitionedIndex::partitionOf(const void *key) const
+{
+  return partitionOfEncoded(encodeKey(key));
+}
+
+void PartitionedIndex::insertEntry(const void *key, const RecordId rid)
+{
+  partitions[partitionOf(key)]->insertEntry(key, rid);
+}
+
+bool PartitionedIndex::deleteEntry(const void *key, const RecordId rid)
+{
+  return partitions[partitionOf(key)]->deleteEntry(key, rid);
+}
+
+bool PartitionedIndex::lookup(const void *key, RecordId &outRid)
+{
+  return partitions[partitionOf(key)]->lookup(key, outRid);
+}
+
+void PartitionedIndex::startScan(const void *lowVal, const Operator lowOp, const void *highVal,
+                                 const Operator highOp)
+{
+  if (scanExecuting)
+    endScan();
+
+  // the range overlaps the partitions of its bounds and those between them, or all of them by hash
+  std::size_t first = 0;
+  std::size_t last = partitions.size() - 1;
+  if (scheme == PARTITION_RANGE)
+  {
+    first = partitionOf(lowVal);
+    last = std::max(first, partitionOf(highVal));
+  }
+
+  // a partition with no key in the range is left out, the operators and the range being checked by the
+  // first partition
+  for (std::size_t p = first; p <= last; p++)
+  {
+    PartitionScan scan;
+    scan.cursor.reset(new BTreeCursor(partitions[p].get()));
+    try
+    {
+      scan.cursor->startScan(lowVal, lowOp, highVal, highOp);
+    }
+    catch (const NoSuchKeyFoundException &e)
+    {
+      continue;
+    }
+    scan.next = 0;
+    scan.completed = false;
+    scans.push_back(std::move(scan));
+  }
+  if (scans.empty())
+    throw NoSuchKeyFoundException();
+
+  // the first chunks are gathered at once, then each next one while the current one is merged
+  for (PartitionScan &scan : scans)
+    scan.pending = std::async(std::launch::async, &PartitionedIndex::gatherChunk, this, scan.cursor.get());
+  for (PartitionScan &scan : scans)
+    takeChunk(scan);
+  scanExecuting = true;
+}
+
+PartitionedIndex::Chunk PartitionedIndex::gatherChunk(BTreeCursor *cursor) const
+{
+  Chunk chunk;
+  char key[STRINGSIZE + 1];
+  try
+  {
+    while (chunk.size() < SCAN_CHUNK)
+    {
+      RecordId rid;
+      cursor->scanNextKey(rid, key);
+      chunk.emplace_back(encodeKey(key), rid);
+    }
+  }
+  catch (const IndexScanCompletedException &e)
+  {
+  }
+  return chunk;
+}
+
+void PartitionedIndex::takeChunk(PartitionScan &scan)
+{
+  scan.chunk = scan.pending.get();
+  scan.next = 0;
+  scan.completed = scan.chunk.size() < SCAN_CHUNK;
+  if (!scan.completed)
+    scan.pending = std::async(std::launch::async, &PartitionedIndex::gatherChunk, this, scan.cursor.get());
+}
+
+void PartitionedIndex::scanNext(RecordId &outRid)
+{
+  if (!scanExecuting)
+    throw ScanNotInitializedException();
+
+  // the partition whose next entry has the least key, the entries of a key being all in one partition
+  PartitionScan *least = NULL;
+  for (PartitionScan &scan : scans)
+  {
+    if (scan.next == scan.chunk.size())
+      continue;
+    if (least == NULL || scan.chunk[scan.next].first < least->chunk[least->next].first)
+      least = &scan;
+  }
+  if (least == NULL)
+    throw IndexScanCompletedException();
+
+  outRid = least->chunk[least->next].second;
+  if (++least->next == least->chunk.size() && !least->completed)
+    takeChunk(*least);
+}
+
+void PartitionedIndex::endScan()
+{
+  if (!scanExecuting)
+    throw ScanNotInitializedException();
+
+  // the cursors end their scans as they are destroyed, once no chunk is being gathered from them
+  for (PartitionScan &scan : scans)
+  {
+    if (!scan.completed)
+      scan.pending.wait();
+  }
+  scans.clear();
+  scanExecuting = false;
+}
+
+}
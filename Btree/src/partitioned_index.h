@@ -0,0 +1,319 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <future>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "types.h"
+#include "buffer.h"
+#include "btree.h"
+
+namespace badgerdb {
+
+/**
+ * @brief How a PartitionedIndex spreads the keys over its partitions.
+ */
+enum PartitionScheme
+{
+	/**
+	 * By a hash of the key, which balances the partitions whatever the keys
+	 */
+	PARTITION_HASH,
+
+	/**
+	 * By ranges of keys between split keys, so that a scan only reads the partitions its range overlaps
+	 */
+	PARTITION_RANGE
+};
+
+/**
+ * @brief First record of the manifest of a PartitionedIndex, which records how its keys are spread over its
+ * partitions. It is followed by a record per split key of PARTITION_RANGE holding its normalized encoding.
+ */
+struct PartitionManifest
+{
+	/**
+	 * How the keys are spread over the partitions
+	 */
+	int scheme;
+
+	/**
+	 * Datatype of the attribute the index is built on
+	 */
+	int attrType;
+
+	/**
+	 * Number of partitions
+	 */
+	int numPartitions;
+};
+
+/**
+* @brief Index of an attribute of a relation split into several BTreeIndex partitions, each in its own file,
+* which may lie on its own device so that the partitions do not share an I/O queue or a root. An entry goes to
+* the partition of its key, so lookups, insertions and deletions reach a single partition. A scan starts a
+* cursor on every partition its range overlaps, and merges their entries in key order: each cursor gathers
+* the entries of its partition a chunk at a time, the next chunk being read in the background while the
+* current one is merged, so that the partitions are read in parallel.
+*
+* The keys are compared by their normalized encoding, on which the partitions of PARTITION_RANGE are split.
+* The scheme, the number of partitions and the split keys are kept in a manifest file next to the first
+* partition, and checked when the index is opened again, since the entries of a partition are only found under
+* the spreading they were inserted with.
+* Lookups, insertions and deletions may be called from several threads at once, as those of BTreeIndex;
+* the scan is used by one thread at a time.
+*/
+class PartitionedIndex
+{
+ public:
+	/**
+   * Number of entries a cursor gathers at a time from its partition
+	 */
+  static const std::size_t SCAN_CHUNK = 1024;
+
+	/**
+	 * Open the partitions of an index, creating those whose file does not exist and filling them with the
+	 * entries of the relation whose key goes to them. A partition is created empty and filled by batches of
+	 * insertions, the partitions being filled in parallel, and then rebuilt so that its leaves are packed.
+	 *
+	 * @param relationName	Name of the relation file
+	 * @param bufMgr 	Buffer manager the partitions and the relation are read through
+	 * @param attrByteOffset	Offset of the attribute in the records
+	 * @param attrType 	Datatype of the attribute
+	 * @param partitionNames	Names the partition files are derived from, one per partition, such as paths on
+	 * 									different devices. The file of partition i is partitionNames[i] followed by '.' and the
+	 * 									attribute offset, as BTreeIndex names it after a relation. The manifest file is that of
+	 * 									partition 0 followed by ".parts"
+	 * @param scheme 	How the keys are spread over the partitions
+	 * @param splitKeys	For PARTITION_RANGE, the partitionNames.size() - 1 increasing keys partition i starts at
+	 * 									for i > 0, an array of integers / doubles or of pointers to char strings as lookupBatch takes
+	 * @throws BadIndexInfoException If there is no partition, if the split keys are missing or not increasing,
+	 * 									if a partition is to be created under the name of an existing file, if the manifest
+	 * 									records another scheme, number of partitions or split keys, or if partitions exist
+	 * 									without a manifest
+	 */
+  PartitionedIndex(const std::string &relationName, BufMgr *bufMgr, int attrByteOffset, Datatype attrType,
+                   const std::vector<std::string> &partitionNames, PartitionScheme scheme = PARTITION_HASH,
+                   const void *splitKeys = NULL);
+
+	/**
+	 * End the scan, and close the partitions.
+	 */
+  ~PartitionedIndex();
+
+  PartitionedIndex(const PartitionedIndex &) = delete;
+  PartitionedIndex &operator=(const PartitionedIndex &) = delete;
+
+	/**
+	 * Find the partition of a key.
+	 *
+	 * @param key 	Pointer to integer / double / char string
+	 * @return the number of the partition, from 0 to getNumPartitions() - 1
+	 */
+  std::size_t partitionOf(const void *key) const;
+
+	/**
+	 * Get the number of partitions.
+	 */
+  std::size_t getNumPartitions() const
+  {
+		return partitions.size();
+  }
+
+	/**
+	 * Get a partition, to tune or inspect it.
+	 *
+	 * @param i 		Number of the partition
+	 */
+  BTreeIndex &getPartition(std::size_t i)
+  {
+		return *partitions[i];
+  }
+
+	/**
+	 * Insert an entry in the partition of its key.
+	 * @see BTreeIndex::insertEntry
+	 *
+	 * @param key 	Pointer to integer / double / char string
+	 * @param rid 	Record ID of the record the key is taken from
+	 */
+  void insertEntry(const void *key, const RecordId rid);
+
+	/**
+	 * Delete an entry from the partition of its key.
+	 * @see BTreeIndex::deleteEntry
+	 *
+	 * @param key 	Pointer to integer / double / char string
+	 * @param rid 	Record ID of the entry
+	 * @return whether the entry was found
+	 */
+  bool deleteEntry(const void *key, const RecordId rid);
+
+	/**
+	 * Find the record ID of an entry with the given key in the partition of the key.
+	 * @see BTreeIndex::lookup
+	 *
+	 * @param key 	Pointer to integer / double / char string
+	 * @param outRid	Record ID of the entry returned in this
+	 * @return whether such entry exists or not
+	 */
+  bool lookup(const void *key, RecordId &outRid);
+
+	/**
+	 * Begin a filtered scan of the partitions the range overlaps, ending the one executing if any. The first
+	 * chunk of every partition is gathered in parallel before it returns.
+	 * @see BTreeIndex::startScan
+	 *
+	 * @param lowVal	Low value of range, pointer to integer / double / char string
+	 * @param lowOp		Low operator (GT/GTE)
+	 * @param highVal	High value of range, pointer to integer / double / char string
+	 * @param highOp	High operator (LT/LTE)
+	 * @throws BadOpcodesException If lowOp and highOp do not contain one of their their expected values
+	 * @throws BadScanrangeException If lowVal > highval
+	 * @throws NoSuchKeyFoundException If no partition has a key in the range
+	 */
+  void startScan(const void *lowVal, const Operator lowOp, const void *highVal, const Operator highOp);
+
+	/**
+	 * Fetch the record ID of the next entry of the scan, in key order across the partitions.
+	 *
+	 * @param outRid	Record ID of the next entry returned in this
+	 * @throws ScanNotInitializedException If no scan has been initialized
+	 * @throws IndexScanCompletedException If no more entries are left to be scanned
+	 */
+  void scanNext(RecordId &outRid);
+
+	/**
+	 * Terminate the scan, waiting for the chunks being gathered.
+	 *
+	 * @throws ScanNotInitializedException If no scan has been initialized
+	 */
+  void endScan();
+
+ private:
+	/**
+	 * Entries gathered from a partition, each with the normalized encoding of its key
+	 */
+  typedef std::vector<std::pair<std::string, RecordId>> Chunk;
+
+	/**
+	 * @brief Scan of one partition: its cursor, the chunk being merged, and the next one being gathered.
+	 */
+  struct PartitionScan
+  {
+    std::unique_ptr<BTreeCursor> cursor;
+    Chunk chunk;
+    std::size_t next;
+    std::future<Chunk> pending;
+
+    /**
+     * Whether the cursor is completed, no chunk being gathered any more
+     */
+    bool completed;
+  };
+
+	/**
+   * Datatype of the attribute the index is built on
+	 */
+  Datatype attributeType;
+
+	/**
+   * Offset of the attribute in the records
+	 */
+  int attrByteOffset;
+
+	/**
+   * How the keys are spread over the partitions
+	 */
+  PartitionScheme scheme;
+
+	/**
+   * Normalized encodings of the split keys of PARTITION_RANGE, in increasing order
+	 */
+  std::vector<std::string> splits;
+
+	/**
+   * Partitions, in the order of their names
+	 */
+  std::vector<std::unique_ptr<BTreeIndex>> partitions;
+
+	/**
+   * Scans of the partitions the range of the scan overlaps, empty if no scan is executing
+	 */
+  std::vector<PartitionScan> scans;
+
+	/**
+   * Whether a scan has been started
+	 */
+  bool scanExecuting;
+
+	/**
+	 * Encode a key into the bytes the partitions are split and merged on.
+	 *
+	 * @param key 	Pointer to integer / double / char string
+	 * @return the normalized encoding of the key
+	 */
+  std::string encodeKey(const void *key) const;
+
+	/**
+	 * Find the partition of the normalized encoding of a key.
+	 *
+	 * @param encoded	Encoded key
+	 * @return the number of the partition
+	 */
+  std::size_t partitionOfEncoded(const std::string &encoded) const;
+
+	/**
+	 * Read the next chunk of entries of a cursor.
+	 *
+	 * @param cursor	Cursor of a partition
+	 * @return the entries, fewer than SCAN_CHUNK once the cursor is completed
+	 */
+  Chunk gatherChunk(BTreeCursor *cursor) const;
+
+	/**
+	 * Make the chunk read in the background the current one of a partition scan, and start reading the next
+	 * one unless the cursor is completed.
+	 *
+	 * @param scan 	Partition scan
+	 */
+  void takeChunk(PartitionScan &scan);
+
+	/**
+	 * Check that the manifest of the index records its scheme, number of partitions and split keys.
+	 *
+	 * @param manifestName	Name of the manifest file
+	 * @param bufMgr 	Buffer manager the manifest is read through
+	 * @param numPartitions	Number of partitions the index is opened with
+	 * @throws BadIndexInfoException If the manifest records another spreading of the keys
+	 */
+  void checkManifest(const std::string &manifestName, BufMgr *bufMgr, std::size_t numPartitions) const;
+
+	/**
+	 * Write the manifest of the index.
+	 *
+	 * @param manifestName	Name of the manifest file
+	 */
+  void writeManifest(const std::string &manifestName) const;
+
+	/**
+	 * Fill the partitions just created with the entries of the relation, by batches of insertions.
+	 *
+	 * @param relationName	Name of the relation file
+	 * @param bufMgr 	Buffer manager the relation is read through
+	 * @param created	Whether each partition was just created
+	 */
+  void fillPartitions(const std::string &relationName, BufMgr *bufMgr, const std::vector<bool> &created);
+};
+
+}
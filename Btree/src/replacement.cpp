@@ -0,0 +1,479 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <algorithm>
+#include "buffer.h"
+#include "replacement.h"
+
+namespace badgerdb {
+
+bool ReplacementPolicy::evictable(const BufDesc *descs, FrameId frame)
+{
+  return descs[frame].pinCnt == 0;
+}
+
+//----------------------------------------
+// FrameList
+//----------------------------------------
+
+void FrameList::init(std::uint32_t numBufs)
+{
+  prev.assign(numBufs, numBufs);
+  next.assign(numBufs, numBufs);
+  member.assign(numBufs, false);
+  head = tail = numBufs;
+  count = 0;
+}
+
+void FrameList::pushBack(FrameId frame)
+{
+  std::uint32_t none = member.size();
+  prev[frame] = tail;
+  next[frame] = none;
+  if (tail != none)
+    next[tail] = frame;
+  else
+    head = frame;
+  tail = frame;
+  member[frame] = true;
+  count++;
+}
+
+void FrameList::erase(FrameId frame)
+{
+  std::uint32_t none = member.size();
+  if (prev[frame] != none)
+    next[prev[frame]] = next[frame];
+  else
+    head = next[frame];
+  if (next[frame] != none)
+    prev[next[frame]] = prev[frame];
+  else
+    tail = prev[frame];
+  member[frame] = false;
+  count--;
+}
+
+bool FrameList::firstEvictable(const BufDesc *descs, FrameId &frame, std::uint32_t &numScanned) const
+{
+  std::uint32_t none = member.size();
+  for (FrameId i = head; i != none; i = next[i])
+  {
+    numScanned++;
+    if (ReplacementPolicy::evictable(descs, i))
+    {
+      frame = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+//----------------------------------------
+// GhostList
+//----------------------------------------
+
+void GhostList::init(std::uint32_t capacity)
+{
+  capacity = std::max(capacity, (std::uint32_t)1);
+  std::uint32_t numSlots = 2;
+  while (numSlots < 2 * capacity)
+    numSlots *= 2;
+  keys.assign(capacity, PageKey());
+  prev.assign(capacity, capacity);
+  next.resize(capacity);
+  for (std::uint32_t i = 0; i < capacity; i++)
+    next[i] = i + 1;
+  slots.assign(numSlots, 0);
+  head = tail = capacity;
+  freeHead = 0;
+  count = 0;
+}
+
+std::uint32_t GhostList::probe(const PageKey &key) const
+{
+  std::uint32_t mask = slots.size() - 1;
+  std::uint32_t i = BufHashTbl::hash(key.file, key.pageNo) & mask;
+  while (slots[i] != 0 && !(keys[slots[i] - 1] == key))
+    i = (i + 1) & mask;
+  return i;
+}
+
+void GhostList::release(std::uint32_t slot)
+{
+  std::uint32_t none = keys.size();
+  std::uint32_t entry = slots[slot] - 1;
+
+  // shift back the slots after the removed one that would be cut off from their hash slot
+  std::uint32_t mask = slots.size() - 1;
+  std::uint32_t i = slot;
+  std::uint32_t j = slot;
+  while (true)
+  {
+    j = (j + 1) & mask;
+    if (slots[j] == 0)
+      break;
+    const PageKey &other = keys[slots[j] - 1];
+    std::uint32_t k = BufHashTbl::hash(other.file, other.pageNo) & mask;
+    bool between = i <= j ? (i < k && k <= j) : (i < k || k <= j);
+    if (!between)
+    {
+      slots[i] = slots[j];
+      i = j;
+    }
+  }
+  slots[i] = 0;
+
+  if (prev[entry] != none)
+    next[prev[entry]] = next[entry];
+  else
+    head = next[entry];
+  if (next[entry] != none)
+    prev[next[entry]] = prev[entry];
+  else
+    tail = prev[entry];
+  next[entry] = freeHead;
+  freeHead = entry;
+  count--;
+}
+
+void GhostList::pushBack(const PageKey &key)
+{
+  if (freeHead == keys.size())
+    popFront();
+
+  std::uint32_t none = keys.size();
+  std::uint32_t entry = freeHead;
+  freeHead = next[entry];
+  keys[entry] = key;
+  prev[entry] = tail;
+  next[entry] = none;
+  if (tail != none)
+    next[tail] = entry;
+  else
+    head = entry;
+  tail = entry;
+  slots[probe(key)] = entry + 1;
+  count++;
+}
+
+bool GhostList::erase(const PageKey &key)
+{
+  std::uint32_t slot = probe(key);
+  if (slots[slot] == 0)
+    return false;
+  release(slot);
+  return true;
+}
+
+void GhostList::popFront()
+{
+  release(probe(keys[head]));
+}
+
+//----------------------------------------
+// ClockPolicy
+//----------------------------------------
+
+void ClockPolicy::init(std::uint32_t bufs)
+{
+  numBufs = bufs;
+  clockHand = bufs - 1;
+  numScanned = 0;
+  valid.assign(bufs, false);
+  refbit.assign(bufs, false);
+}
+
+void ClockPolicy::loaded(FrameId frame, const File *file, PageId pageNo)
+{
+  valid[frame] = true;
+  refbit[frame] = true;
+}
+
+void ClockPolicy::accessed(FrameId frame)
+{
+  refbit[frame] = true;
+}
+
+void ClockPolicy::removed(FrameId frame)
+{
+  valid[frame] = false;
+  refbit[frame] = false;
+}
+
+bool ClockPolicy::victim(const BufDesc *descs, const File *file, PageId pageNo, FrameId &frame)
+{
+  // a frame referenced recently is spared on the first pass, and any unpinned one is taken on the second
+  for (numScanned = 1; numScanned <= 2*numBufs; numScanned++)
+  {
+    // advance the clock
+    clockHand = (clockHand + 1) % numBufs;
+    if (!valid[clockHand])
+      continue;
+
+    if (refbit[clockHand])
+    {
+      // has been referenced, clear the bit
+      refbit[clockHand] = false;
+    }
+    else if (evictable(descs, clockHand))
+    {
+      // hasn't been referenced and is not pinned, use it
+      frame = clockHand;
+      return true;
+    }
+  }
+  numScanned = 2*numBufs;
+  return false;
+}
+
+void ClockPolicy::evicted(FrameId frame)
+{
+  removed(frame);
+}
+
+//----------------------------------------
+// LruKPolicy
+//----------------------------------------
+
+LruKPolicy::LruKPolicy(int k)
+  : k(std::max(k, 1)), now(0), numScanned(0)
+{
+}
+
+void LruKPolicy::init(std::uint32_t numBufs)
+{
+  history.assign((std::size_t)numBufs * k, 0);
+}
+
+void LruKPolicy::loaded(FrameId frame, const File *file, PageId pageNo)
+{
+  std::uint64_t *times = &history[(std::size_t)frame * k];
+  std::fill(times, times + k, 0);
+  times[0] = ++now;
+}
+
+void LruKPolicy::accessed(FrameId frame)
+{
+  std::uint64_t *times = &history[(std::size_t)frame * k];
+  std::copy_backward(times, times + k - 1, times + k);
+  times[0] = ++now;
+}
+
+void LruKPolicy::removed(FrameId frame)
+{
+  std::uint64_t *times = &history[(std::size_t)frame * k];
+  std::fill(times, times + k, 0);
+}
+
+bool LruKPolicy::victim(const BufDesc *descs, const File *file, PageId pageNo, FrameId &frame)
+{
+  // a frame with fewer than K accesses has an infinite backward K-distance, and is ranked by its last access
+  // before all the frames with K accesses, ranked by their K-th
+  bool found = false;
+  bool bestFull = true;
+  std::uint64_t bestTime = UINT64_MAX;
+  std::uint32_t numBufs = history.size() / k;
+  numScanned = numBufs;
+  for (FrameId i = 0; i < numBufs; i++)
+  {
+    const std::uint64_t *times = &history[(std::size_t)i * k];
+    if (times[0] == 0 || !evictable(descs, i))
+      continue;
+
+    bool full = times[k - 1] != 0;
+    std::uint64_t time = full ? times[k - 1] : times[0];
+    if ((bestFull && !full) || (bestFull == full && time < bestTime))
+    {
+      found = true;
+      bestFull = full;
+      bestTime = time;
+      frame = i;
+    }
+  }
+  return found;
+}
+
+void LruKPolicy::evicted(FrameId frame)
+{
+  removed(frame);
+}
+
+//----------------------------------------
+// TwoQPolicy
+//----------------------------------------
+
+void TwoQPolicy::init(std::uint32_t numBufs)
+{
+  kin = std::max(numBufs / 4, (std::uint32_t)1);
+  kout = std::max(numBufs / 2, (std::uint32_t)1);
+  a1in.init(numBufs);
+  am.init(numBufs);
+  a1out.init(kout + 1);
+  pages.assign(numBufs, PageKey());
+  numScanned = 0;
+}
+
+void TwoQPolicy::loaded(FrameId frame, const File *file, PageId pageNo)
+{
+  PageKey key = {file, pageNo};
+  pages[frame] = key;
+  if (a1out.erase(key))
+    am.pushBack(frame);
+  else
+    a1in.pushBack(frame);
+}
+
+void TwoQPolicy::accessed(FrameId frame)
+{
+  // a page in A1in stays there, its accesses being taken as correlated
+  if (am.contains(frame))
+  {
+    am.erase(frame);
+    am.pushBack(frame);
+  }
+}
+
+void TwoQPolicy::removed(FrameId frame)
+{
+  if (am.contains(frame))
+    am.erase(frame);
+  else if (a1in.contains(frame))
+    a1in.erase(frame);
+}
+
+bool TwoQPolicy::victim(const BufDesc *descs, const File *file, PageId pageNo, FrameId &frame)
+{
+  bool fromA1in = a1in.size() > kin || am.size() == 0;
+  numScanned = 0;
+  if (!(fromA1in ? a1in : am).firstEvictable(descs, frame, numScanned))
+  {
+    // every page of the chosen list is pinned, so take one from the other
+    fromA1in = !fromA1in;
+    if (!(fromA1in ? a1in : am).firstEvictable(descs, frame, numScanned))
+      return false;
+  }
+
+  return true;
+}
+
+void TwoQPolicy::evicted(FrameId frame)
+{
+  if (a1in.contains(frame))
+  {
+    a1in.erase(frame);
+    a1out.pushBack(pages[frame]);
+    if (a1out.size() > kout)
+      a1out.popFront();
+  }
+  else
+    am.erase(frame);
+}
+
+void TwoQPolicy::spared(FrameId frame)
+{
+  // move the page to the recent end of its list, accesses leaving the pages of A1in in place
+  FrameList &list = a1in.contains(frame) ? a1in : am;
+  list.erase(frame);
+  list.pushBack(frame);
+}
+
+//----------------------------------------
+// ArcPolicy
+//----------------------------------------
+
+void ArcPolicy::init(std::uint32_t bufs)
+{
+  numBufs = bufs;
+  target = 0;
+  t1.init(bufs);
+  t2.init(bufs);
+  b1.init(bufs);
+  b2.init(2 * bufs);
+  pages.assign(bufs, PageKey());
+  numScanned = 0;
+}
+
+void ArcPolicy::loaded(FrameId frame, const File *file, PageId pageNo)
+{
+  PageKey key = {file, pageNo};
+  pages[frame] = key;
+
+  // a page remembered in a ghost list moves the target towards the list it was evicted from
+  std::uint32_t b1Size = b1.size(), b2Size = b2.size();
+  if (b1.erase(key))
+  {
+    target = std::min(numBufs, target + std::max(b2Size / b1Size, (std::uint32_t)1));
+    t2.pushBack(frame);
+  }
+  else if (b2.erase(key))
+  {
+    std::uint32_t delta = std::max(b1Size / b2Size, (std::uint32_t)1);
+    target = target > delta ? target - delta : 0;
+    t2.pushBack(frame);
+  }
+  else
+    t1.pushBack(frame);
+
+  // keep T1 and B1 within the pool size, and all the lists within twice that
+  while (b1.size() > 0 && t1.size() + b1.size() > numBufs)
+    b1.popFront();
+  while (b2.size() > 0 && t1.size() + t2.size() + b1.size() + b2.size() > 2 * numBufs)
+    b2.popFront();
+}
+
+void ArcPolicy::accessed(FrameId frame)
+{
+  if (t1.contains(frame))
+    t1.erase(frame);
+  else
+    t2.erase(frame);
+  t2.pushBack(frame);
+}
+
+void ArcPolicy::removed(FrameId frame)
+{
+  if (t1.contains(frame))
+    t1.erase(frame);
+  else if (t2.contains(frame))
+    t2.erase(frame);
+}
+
+bool ArcPolicy::victim(const BufDesc *descs, const File *file, PageId pageNo, FrameId &frame)
+{
+  // T1 gives up a page when it is over its target, or at its target if the page to load was evicted from T2
+  PageKey key = {file, pageNo};
+  bool inB2 = b2.contains(key);
+  bool fromT1 = t1.size() > 0 && (t1.size() > target || (inB2 && t1.size() == target));
+
+  numScanned = 0;
+  if (!(fromT1 ? t1 : t2).firstEvictable(descs, frame, numScanned))
+  {
+    // every page of the chosen list is pinned, so take one from the other
+    fromT1 = !fromT1;
+    if (!(fromT1 ? t1 : t2).firstEvictable(descs, frame, numScanned))
+      return false;
+  }
+
+  return true;
+}
+
+void ArcPolicy::evicted(FrameId frame)
+{
+  if (t1.contains(frame))
+  {
+    t1.erase(frame);
+    b1.pushBack(pages[frame]);
+  }
+  else
+  {
+    t2.erase(frame);
+    b2.pushBack(pages[frame]);
+  }
+}
+
+}
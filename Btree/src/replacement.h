@@ -0,0 +1,492 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "file.h"
+#include "types.h"
+
+namespace badgerdb {
+
+class BufDesc;
+
+/**
+* @brief Identity of a page held in, or recently evicted from, the buffer pool.
+*/
+struct PageKey {
+	/**
+	 * File of the page
+	 */
+  const File *file;
+
+	/**
+	 * Page number within the file
+	 */
+  PageId pageNo;
+
+  bool operator==(const PageKey &rhs) const
+  {
+		return file == rhs.file && pageNo == rhs.pageNo;
+  }
+};
+
+/**
+* @brief Interface of the eviction policy of a buffer manager.
+* The buffer manager keeps the free frames itself. A policy only sees the frames holding a page: it is told
+* when a page is loaded in a frame, when it is accessed again, and when it leaves the pool without being
+* evicted, and it chooses the frame to evict when no frame is free. A policy is not latched by itself; the
+* buffer manager calls it with its own latch held.
+*/
+class ReplacementPolicy
+{
+ public:
+  virtual ~ReplacementPolicy() {}
+
+	/**
+	 * Check whether the page in a frame may be evicted, i.e. is not pinned.
+	 *
+	 * @param descs  	Descriptors of the frames of the partition
+	 * @param frame  	Frame number
+	 * @return  			Whether the frame may be evicted.
+	 */
+  static bool evictable(const BufDesc *descs, FrameId frame);
+
+	/**
+	 * Create a policy of the same kind and parameters, not set up yet, for another partition of the pool.
+	 *
+	 * @return  			The new policy, owned by the caller.
+	 */
+  virtual ReplacementPolicy *clone() const = 0;
+
+	/**
+	 * Set up the policy for a partition of a buffer pool, with all frames free. Called once by the buffer
+	 * manager. The frames of the partition are numbered from 0 in the calls to the policy.
+	 *
+	 * @param numBufs Number of frames in the partition
+	 */
+  virtual void init(std::uint32_t numBufs) = 0;
+
+	/**
+	 * A page was loaded in a free or evicted frame.
+	 *
+	 * @param frame  	Frame number
+	 * @param file   	File of the page
+	 * @param pageNo 	Page number within the file
+	 */
+  virtual void loaded(FrameId frame, const File *file, PageId pageNo) = 0;
+
+	/**
+	 * The page held in a frame was accessed again.
+	 *
+	 * @param frame  	Frame number
+	 */
+  virtual void accessed(FrameId frame) = 0;
+
+	/**
+	 * The page held in a frame left the pool without being evicted, e.g. because its file was flushed.
+	 *
+	 * @param frame  	Frame number
+	 */
+  virtual void removed(FrameId frame) = 0;
+
+	/**
+	 * Choose a frame holding a page which is not pinned, to evict its page.
+	 *
+	 * @param descs  	Descriptors of the frames of the partition
+	 * @param file   	File of the page to load in the frame
+	 * @param pageNo 	Page number of the page to load, Page::INVALID_NUMBER if it is a newly allocated page
+	 * @param frame  	Chosen frame, returned via this variable
+	 * @return  			Whether a frame was found, false if all are pinned.
+	 */
+  virtual bool victim(const BufDesc *descs, const File *file, PageId pageNo, FrameId &frame) = 0;
+
+	/**
+	 * The page of a frame returned by victim() is evicted.
+	 *
+	 * @param frame  	Frame number
+	 */
+  virtual void evicted(FrameId frame) = 0;
+
+	/**
+	 * Hint the frame the policy is likely to choose next, from which the background writer sweeps the frames
+	 * to clean them before they are evicted. By default the first frame.
+	 *
+	 * @return  			Frame number
+	 */
+  virtual FrameId sweepStart() const
+  {
+		return 0;
+  }
+
+	/**
+	 * The page of a frame returned by victim() is kept, because it was boosted. It should not be chosen
+	 * again before the other candidates. By default it is taken as accessed.
+	 *
+	 * @param frame  	Frame number
+	 */
+  virtual void spared(FrameId frame)
+  {
+		accessed(frame);
+  }
+
+	/**
+	 * Number of frames the last call of victim() looked at, which the buffer manager keeps a histogram of.
+	 * By default 1.
+	 *
+	 * @return  			Number of frames
+	 */
+  virtual std::uint32_t lastScanned() const
+  {
+		return 1;
+  }
+};
+
+/**
+* @brief Doubly linked list of frames in access order, threaded through arrays indexed by frame number.
+*/
+class FrameList
+{
+ private:
+	/**
+	 * Previous and next frames of each frame in the list
+	 */
+  std::vector<FrameId> prev, next;
+
+	/**
+	 * Whether each frame is in the list
+	 */
+  std::vector<bool> member;
+
+	/**
+	 * Least and most recently added frames, numBufs if the list is empty
+	 */
+  FrameId head, tail;
+
+	/**
+	 * Number of frames in the list
+	 */
+  std::uint32_t count;
+
+ public:
+	/**
+	 * Make the list empty, for frames numbered below numBufs.
+	 *
+	 * @param numBufs Number of frames in the buffer pool
+	 */
+  void init(std::uint32_t numBufs);
+
+	/**
+	 * Add a frame at the most recent end of the list.
+	 */
+  void pushBack(FrameId frame);
+
+	/**
+	 * Remove a frame from the list.
+	 */
+  void erase(FrameId frame);
+
+	/**
+	 * Check whether a frame is in the list.
+	 */
+  bool contains(FrameId frame) const
+  {
+		return member[frame];
+  }
+
+	/**
+	 * Get the number of frames in the list.
+	 */
+  std::uint32_t size() const
+  {
+		return count;
+  }
+
+	/**
+	 * Find the least recent frame of the list which is not pinned.
+	 *
+	 * @param descs  	Descriptors of the frames of the partition
+	 * @param frame  	Frame found, returned via this variable
+	 * @param numScanned	Incremented by the number of frames looked at
+	 * @return  			Whether a frame was found.
+	 */
+  bool firstEvictable(const BufDesc *descs, FrameId &frame, std::uint32_t &numScanned) const;
+};
+
+/**
+* @brief Bounded FIFO of the identities of pages evicted from the buffer pool.
+* Its entries are taken from a slab allocated by init, linked in order through arrays and kept free in a
+* list, and are found through an open addressed index of their positions. A page is thus remembered and
+* forgotten on every eviction without allocating.
+*/
+class GhostList
+{
+ private:
+	/**
+	 * Page of each entry of the slab
+	 */
+  std::vector<PageKey> keys;
+
+	/**
+	 * Previous and next entries of each entry in the list, the next free entry for a free one
+	 */
+  std::vector<std::uint32_t> prev, next;
+
+	/**
+	 * Slots of the index, each holding an entry plus 1, or 0 if empty. Their number is a power of 2
+	 * of at least twice the capacity.
+	 */
+  std::vector<std::uint32_t> slots;
+
+	/**
+	 * Least and most recently added entries, and first free entry, the capacity if none
+	 */
+  std::uint32_t head, tail, freeHead;
+
+	/**
+	 * Number of pages in the list
+	 */
+  std::uint32_t count;
+
+	/**
+	 * Find the slot of a page in the index, or the empty slot ending its probe sequence.
+	 */
+  std::uint32_t probe(const PageKey &key) const;
+
+	/**
+	 * Unlink an entry from the list and its slot from the index, and free it.
+	 *
+	 * @param slot  	Slot of the entry
+	 */
+  void release(std::uint32_t slot);
+
+ public:
+  GhostList() : head(0), tail(0), freeHead(0), count(0) {}
+
+	/**
+	 * Make the list empty, and allocate the slab.
+	 *
+	 * @param capacity Maximum number of pages in the list
+	 */
+  void init(std::uint32_t capacity);
+
+	/**
+	 * Add a page at the most recent end of the list. The least recently added page is removed first
+	 * if the list is full.
+	 */
+  void pushBack(const PageKey &key);
+
+	/**
+	 * Remove a page from the list.
+	 *
+	 * @return  Whether the page was in the list.
+	 */
+  bool erase(const PageKey &key);
+
+	/**
+	 * Check whether a page is in the list.
+	 */
+  bool contains(const PageKey &key) const
+  {
+		return slots[probe(key)] != 0;
+  }
+
+	/**
+	 * Remove the least recently added page.
+	 */
+  void popFront();
+
+	/**
+	 * Get the number of pages in the list.
+	 */
+  std::uint32_t size() const
+  {
+		return count;
+  }
+};
+
+/**
+* @brief The clock algorithm: frames are swept in a circle, and a frame referenced since the hand last passed it
+* is spared once.
+*/
+class ClockPolicy : public ReplacementPolicy
+{
+ private:
+	/**
+   * Current position of clockhand in our buffer pool
+	 */
+  FrameId clockHand;
+
+	/**
+   * Number of frames in the buffer pool
+	 */
+  std::uint32_t numBufs;
+
+	/**
+   * Whether each frame holds a page, and whether it has been referenced recently
+	 */
+  std::vector<bool> valid, refbit;
+
+	/**
+   * Number of frames the hand went past in the last call of victim()
+	 */
+  std::uint32_t numScanned;
+
+ public:
+  ReplacementPolicy *clone() const { return new ClockPolicy(*this); }
+  void init(std::uint32_t numBufs);
+  void loaded(FrameId frame, const File *file, PageId pageNo);
+  void accessed(FrameId frame);
+  void removed(FrameId frame);
+  bool victim(const BufDesc *descs, const File *file, PageId pageNo, FrameId &frame);
+  void evicted(FrameId frame);
+  FrameId sweepStart() const { return (clockHand + 1) % numBufs; }
+  std::uint32_t lastScanned() const { return numScanned; }
+};
+
+/**
+* @brief LRU-K: the frame evicted is the one whose K-th most recent access is the oldest. Frames accessed fewer
+* than K times go first, in LRU order, so that pages read once by a scan do not push out the pages in use.
+* The access history of a page is kept while it is in the pool.
+*/
+class LruKPolicy : public ReplacementPolicy
+{
+ private:
+	/**
+   * Number of accesses K
+	 */
+  int k;
+
+	/**
+   * Logical time, incremented at every access
+	 */
+  std::uint64_t now;
+
+	/**
+   * Times of the last K accesses of each frame, the most recent first, 0 for none. Indexed by frame * K
+	 */
+  std::vector<std::uint64_t> history;
+
+	/**
+   * Number of frames looked at in the last call of victim(), all of them
+	 */
+  std::uint32_t numScanned;
+
+ public:
+	/**
+   * Constructor of LruKPolicy class
+	 *
+	 * @param k  	Number of accesses the eviction order is based on, at least 1
+	 */
+  LruKPolicy(int k = 2);
+
+  ReplacementPolicy *clone() const { return new LruKPolicy(*this); }
+  void init(std::uint32_t numBufs);
+  void loaded(FrameId frame, const File *file, PageId pageNo);
+  void accessed(FrameId frame);
+  void removed(FrameId frame);
+  bool victim(const BufDesc *descs, const File *file, PageId pageNo, FrameId &frame);
+  void evicted(FrameId frame);
+  std::uint32_t lastScanned() const { return numScanned; }
+};
+
+/**
+* @brief 2Q: a page first enters a FIFO (A1in) holding about a quarter of the frames. When evicted from it,
+* the page is remembered in a ghost FIFO (A1out), and only a page loaded again while remembered enters the
+* LRU list of hot pages (Am).
+*/
+class TwoQPolicy : public ReplacementPolicy
+{
+ private:
+	/**
+   * Target size of A1in, and maximum size of A1out
+	 */
+  std::uint32_t kin, kout;
+
+	/**
+   * Resident pages seen once, and hot resident pages
+	 */
+  FrameList a1in, am;
+
+	/**
+   * Pages recently evicted from A1in
+	 */
+  GhostList a1out;
+
+	/**
+   * Page held in each frame
+	 */
+  std::vector<PageKey> pages;
+
+	/**
+   * Number of frames of the lists looked at in the last call of victim()
+	 */
+  std::uint32_t numScanned;
+
+ public:
+  ReplacementPolicy *clone() const { return new TwoQPolicy(*this); }
+  void init(std::uint32_t numBufs);
+  void loaded(FrameId frame, const File *file, PageId pageNo);
+  void accessed(FrameId frame);
+  void removed(FrameId frame);
+  bool victim(const BufDesc *descs, const File *file, PageId pageNo, FrameId &frame);
+  void evicted(FrameId frame);
+  void spared(FrameId frame);
+  std::uint32_t lastScanned() const { return numScanned; }
+};
+
+/**
+* @brief ARC: resident pages are split between pages seen once (T1) and pages seen at least twice (T2), and
+* the pages evicted from each are remembered in ghost lists (B1 and B2). A page loaded again while remembered
+* in B1 (resp. B2) moves the target size of T1 up (resp. down), so that the split adapts to the workload.
+*/
+class ArcPolicy : public ReplacementPolicy
+{
+ private:
+	/**
+   * Number of frames in the buffer pool
+	 */
+  std::uint32_t numBufs;
+
+	/**
+   * Target size of T1
+	 */
+  std::uint32_t target;
+
+	/**
+   * Resident pages seen once, and seen at least twice
+	 */
+  FrameList t1, t2;
+
+	/**
+   * Pages recently evicted from T1 and from T2
+	 */
+  GhostList b1, b2;
+
+	/**
+   * Page held in each frame
+	 */
+  std::vector<PageKey> pages;
+
+	/**
+   * Number of frames of the lists looked at in the last call of victim()
+	 */
+  std::uint32_t numScanned;
+
+ public:
+  ReplacementPolicy *clone() const { return new ArcPolicy(*this); }
+  void init(std::uint32_t numBufs);
+  void loaded(FrameId frame, const File *file, PageId pageNo);
+  void accessed(FrameId frame);
+  void removed(FrameId frame);
+  bool victim(const BufDesc *descs, const File *file, PageId pageNo, FrameId &frame);
+  void evicted(FrameId frame);
+  std::uint32_t lastScanned() const { return numScanned; }
+};
+
+}
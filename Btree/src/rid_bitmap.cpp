@@ -0,0 +1,114 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "rid_bitmap.h"
+
+#include <algorithm>
+
+namespace badgerdb {
+
+bool RidBitmap::add(const RecordId &rid)
+{
+  std::vector<std::uint64_t> &words = bitmaps[rid.page_number];
+  std::size_t word = rid.slot_number >> 6;
+  if (words.size() <= word)
+    words.resize(word + 1, 0);
+  std::uint64_t bit = (std::uint64_t)1 << (rid.slot_number & 63);
+  if (words[word] & bit)
+    return false;
+  words[word] |= bit;
+  count++;
+  return true;
+}
+
+bool RidBitmap::contains(const RecordId &rid) const
+{
+  PageMap::const_iterator it = bitmaps.find(rid.page_number);
+  std::size_t word = rid.slot_number >> 6;
+  return it != bitmaps.end() && word < it->second.size()
+      && (it->second[word] >> (rid.slot_number & 63) & 1);
+}
+
+RidBitmap &RidBitmap::operator&=(const RidBitmap &rhs)
+{
+  // both maps are walked in page order, the pages left without a slot being dropped
+  PageMap::iterator it = bitmaps.begin();
+  PageMap::const_iterator other = rhs.bitmaps.begin();
+  count = 0;
+  while (it != bitmaps.end())
+  {
+    while (other != rhs.bitmaps.end() && other->first < it->first)
+      ++other;
+    std::vector<std::uint64_t> &words = it->second;
+    std::size_t numWords = 0;
+    if (other != rhs.bitmaps.end() && other->first == it->first)
+    {
+      numWords = std::min(words.size(), other->second.size());
+      for (std::size_t i = 0; i < numWords; i++)
+      {
+        words[i] &= other->second[i];
+        count += __builtin_popcountll(words[i]);
+      }
+    }
+    words.resize(numWords);
+    if (std::none_of(words.begin(), words.end(), [](std::uint64_t w) { return w != 0; }))
+      it = bitmaps.erase(it);
+    else
+      ++it;
+  }
+  return *this;
+}
+
+RidBitmap &RidBitmap::operator|=(const RidBitmap &rhs)
+{
+  for (const PageMap::value_type &page : rhs.bitmaps)
+  {
+    PageMap::iterator hint = bitmaps.lower_bound(page.first);
+    if (hint == bitmaps.end() || hint->first != page.first)
+      hint = bitmaps.emplace_hint(hint, page.first, std::vector<std::uint64_t>());
+    std::vector<std::uint64_t> &words = hint->second;
+    if (words.size() < page.second.size())
+      words.resize(page.second.size(), 0);
+    for (std::size_t i = 0; i < page.second.size(); i++)
+    {
+      count += __builtin_popcountll(page.second[i] & ~words[i]);
+      words[i] |= page.second[i];
+    }
+  }
+  return *this;
+}
+
+void RidBitmap::toRids(std::vector<RecordId> &rids) const
+{
+  rids.reserve(rids.size() + count);
+  for (const PageMap::value_type &page : bitmaps)
+  {
+    for (std::size_t i = 0; i < page.second.size(); i++)
+    {
+      for (std::uint64_t w = page.second[i]; w != 0; w &= w - 1)
+      {
+        RecordId rid = {page.first, (SlotId)(i * 64 + __builtin_ctzll(w)), 0};
+        rids.push_back(rid);
+      }
+    }
+  }
+}
+
+void RidBitmap::pageSlots(PageId pageNo, std::vector<SlotId> &slots) const
+{
+  slots.clear();
+  PageMap::const_iterator it = bitmaps.find(pageNo);
+  if (it == bitmaps.end())
+    return;
+  for (std::size_t i = 0; i < it->second.size(); i++)
+  {
+    for (std::uint64_t w = it->second[i]; w != 0; w &= w - 1)
+      slots.push_back((SlotId)(i * 64 + __builtin_ctzll(w)));
+  }
+}
+
+}
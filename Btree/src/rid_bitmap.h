@@ -0,0 +1,126 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+* @brief Set of record IDs grouped by page: each page holding some of them has a bitmap of its slots.
+* An index range scan collects its record IDs in a bitmap, so that the records are then fetched in page
+* order, each page being read once, rather than in key order. The bitmaps of several scans are intersected
+* or united for queries with several predicates.
+*/
+class RidBitmap
+{
+ public:
+	/**
+	 * Bitmaps of the slots of the pages holding record IDs of the set, by page number. The bit of a slot
+	 * is bit slot % 64 of word slot / 64.
+	 */
+  typedef std::map<PageId, std::vector<std::uint64_t>> PageMap;
+
+  RidBitmap() : count(0) {}
+
+	/**
+	 * Add a record ID to the set.
+	 *
+	 * @param rid  		Record ID
+	 * @return  			Whether it was not in the set yet
+	 */
+  bool add(const RecordId &rid);
+
+	/**
+	 * Check whether a record ID is in the set.
+	 *
+	 * @param rid  		Record ID
+	 */
+  bool contains(const RecordId &rid) const;
+
+	/**
+	 * Keep the record IDs which are in both sets.
+	 *
+	 * @param rhs  		Other set
+	 * @return  			This set
+	 */
+  RidBitmap &operator&=(const RidBitmap &rhs);
+
+	/**
+	 * Add the record IDs of another set.
+	 *
+	 * @param rhs  		Other set
+	 * @return  			This set
+	 */
+  RidBitmap &operator|=(const RidBitmap &rhs);
+
+	/**
+	 * Get the record IDs of the set, in page and slot order.
+	 *
+	 * @param rids  	Record IDs, appended to
+	 */
+  void toRids(std::vector<RecordId> &rids) const;
+
+	/**
+	 * Get the slots of a page which are in the set, in order.
+	 *
+	 * @param pageNo 	Page number
+	 * @param slots  	Slot numbers, replaced
+	 */
+  void pageSlots(PageId pageNo, std::vector<SlotId> &slots) const;
+
+	/**
+	 * Get the bitmaps of the pages holding record IDs of the set.
+	 */
+  const PageMap &pages() const
+  {
+		return bitmaps;
+  }
+
+	/**
+	 * Get the number of record IDs in the set.
+	 */
+  std::size_t size() const
+  {
+		return count;
+  }
+
+	/**
+	 * Get the number of pages holding record IDs of the set.
+	 */
+  std::size_t numPages() const
+  {
+		return bitmaps.size();
+  }
+
+	/**
+	 * Remove all the record IDs.
+	 */
+  void clear()
+  {
+		bitmaps.clear();
+		count = 0;
+  }
+
+ private:
+	/**
+	 * Bitmaps of the pages, none of them all zero
+	 */
+  PageMap bitmaps;
+
+	/**
+	 * Number of record IDs in the set
+	 */
+  std::size_t count;
+};
+
+}
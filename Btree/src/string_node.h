@@ -0,0 +1,630 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include "btree.h"
+
+namespace badgerdb
+{
+
+/**
+ * @brief Properties of the slotted layouts of STRING nodes, for the operations shared by leaf and non leaf nodes.
+ * The items are the page numbers of a non leaf node, of which there is one more than keys,
+ * and the record IDs of a leaf. The trailer is the number of bytes reserved at the end of the page from
+ * INDEX_FORMAT_V6 on, for the high key followed by the right link of a non leaf node.
+ */
+template <class N>
+struct SlottedLayout;
+
+template <>
+struct SlottedLayout<NonLeafNodeString>
+{
+	typedef PageId Item;
+	static const int EXTRA_ITEMS = 1;
+	static const int HEADER = offsetof(NonLeafNodeString, pageNoArray);
+	static const int TRAILER = sizeof(StringKey) + sizeof(PageId);
+	static Item *items(NonLeafNodeString *nodePtr) { return nodePtr->pageNoArray; }
+	static const Item *items(const NonLeafNodeString *nodePtr) { return nodePtr->pageNoArray; }
+};
+
+template <>
+struct SlottedLayout<LeafNodeString>
+{
+	typedef RecordId Item;
+	static const int EXTRA_ITEMS = 0;
+	static const int HEADER = offsetof(LeafNodeString, ridArray);
+	static const int TRAILER = sizeof(StringKey);
+	static Item *items(LeafNodeString *leafPtr) { return leafPtr->ridArray; }
+	static const Item *items(const LeafNodeString *leafPtr) { return leafPtr->ridArray; }
+};
+
+/**
+ * Find the length of the longest common prefix of two byte strings.
+ * @param a First bytes
+ * @param aLen Length of the first bytes
+ * @param b Second bytes
+ * @param bLen Length of the second bytes
+ * @return the length of the common prefix
+ */
+inline int commonPrefixLength(const char *a, int aLen, const char *b, int bLen)
+{
+	int n = std::min(aLen, bLen);
+	int i = 0;
+	while (i < n && a[i] == b[i])
+	{
+		++i;
+	}
+	return i;
+}
+
+/**
+ * Find the shortest separator between two adjacent keys, i.e. the shortest prefix of the right key
+ * that is greater than the left key. It is the right key itself if both are equal.
+ * @param left Left key
+ * @param right Right key, not less than the left key
+ * @return the separator, greater than the left key (unless equal) and not greater than the right key
+ */
+inline StringKey shortestSeparator(const StringKey &left, const StringKey &right)
+{
+	StringKey sep = right;
+	int shared = commonPrefixLength(left.data, left.length, right.data, right.length);
+	if (shared < right.length)
+	{
+		sep.length = shared + 1;
+	}
+	return sep;
+}
+
+/**
+ * Number of bytes used in a slotted node.
+ * @param numKeys Number of keys of the node
+ * @param keyBytes Number of bytes of the keys, counting the shared prefix once
+ * @return the size of the node
+ */
+template <class N>
+inline int slottedSize(int numKeys, int keyBytes)
+{
+	typedef SlottedLayout<N> L;
+	return L::HEADER + (numKeys + L::EXTRA_ITEMS) * (int)sizeof(typename L::Item)
+	       + numKeys * (int)sizeof(KeySlot) + keyBytes;
+}
+
+/**
+ * Number of bytes that a slotted node in INDEX_FORMAT_V6 may use, the trailer being reserved.
+ * @return the capacity of the node
+ */
+template <class N>
+inline int slottedCapacity()
+{
+	return Page::SIZE - SlottedLayout<N>::TRAILER;
+}
+
+/**
+ * Offset of the end of the key bytes of a slotted node, i.e. of its trailer, or of the page
+ * for a node from before INDEX_FORMAT_V6. It is also the number of bytes the node may use.
+ * @param nodePtr Slotted node
+ * @return the end of the key bytes
+ */
+template <class N>
+inline int slottedEnd(const N *nodePtr)
+{
+	return nodePtr->format >= INDEX_FORMAT_V6 ? slottedCapacity<N>() : (int)Page::SIZE;
+}
+
+/**
+ * Number of bytes used in a slotted node, whose key bytes are contiguous.
+ * @param nodePtr Slotted node
+ * @return the size of the node
+ */
+template <class N>
+inline int slottedUsed(const N *nodePtr)
+{
+	return slottedSize<N>(nodePtr->numKeys, slottedEnd(nodePtr) - nodePtr->heapOffset);
+}
+
+/**
+ * Get the key slots of a slotted node, which follow its items.
+ * @param nodePtr Slotted node
+ * @return the key slots
+ */
+template <class N>
+inline KeySlot *keySlots(N *nodePtr)
+{
+	return (KeySlot *)(SlottedLayout<N>::items(nodePtr) + nodePtr->numKeys + SlottedLayout<N>::EXTRA_ITEMS);
+}
+
+template <class N>
+inline const KeySlot *keySlots(const N *nodePtr)
+{
+	return (const KeySlot *)(SlottedLayout<N>::items(nodePtr) + nodePtr->numKeys + SlottedLayout<N>::EXTRA_ITEMS);
+}
+
+/**
+ * Get the prefix shared by all keys of a slotted node, stored at the end of its key bytes.
+ * @param nodePtr Slotted node
+ * @return the prefix, of prefixLength characters
+ */
+template <class N>
+inline const char *keyPrefix(const N *nodePtr)
+{
+	return (const char *)nodePtr + slottedEnd(nodePtr) - nodePtr->prefixLength;
+}
+
+/**
+ * Initialize the key area of an empty slotted node.
+ * @param nodePtr Slotted node
+ */
+template <class N>
+inline void initSlotted(N *nodePtr)
+{
+	nodePtr->numKeys = 0;
+	nodePtr->prefixLength = 0;
+	nodePtr->heapOffset = slottedEnd(nodePtr);
+}
+
+/**
+ * Get the i-th key of a slotted node.
+ * @param nodePtr Slotted node
+ * @param i Index of the key
+ * @return the key
+ */
+template <class N>
+inline StringKey slottedKey(const N *nodePtr, int i)
+{
+	const KeySlot &slot = keySlots(nodePtr)[i];
+	StringKey key;
+	memcpy(key.data, keyPrefix(nodePtr), nodePtr->prefixLength);
+	memcpy(key.data + nodePtr->prefixLength, (const char *)nodePtr + slot.offset, slot.length);
+	key.length = nodePtr->prefixLength + slot.length;
+	return key;
+}
+
+/**
+ * Check whether the rest of the i-th key of a slotted node after the prefix equals the given bytes.
+ * @param nodePtr Slotted node
+ * @param i Index of the key
+ * @param rest Bytes following the prefix
+ * @param restLength Number of bytes
+ * @return whether they are equal or not
+ */
+template <class N>
+inline bool slottedRestEquals(const N *nodePtr, int i, const char *rest, int restLength)
+{
+	const KeySlot &slot = keySlots(nodePtr)[i];
+	return slot.length == restLength && memcmp((const char *)nodePtr + slot.offset, rest, restLength) == 0;
+}
+
+/**
+ * Find the position of the first key not satisfying key < val (or key <= val if orEqual) in a slotted node.
+ * The value is compared once against the shared prefix, then only the rest of the keys are searched.
+ * @tparam orEqual Whether to skip the keys equal to the value as well
+ * @param nodePtr Slotted node
+ * @param val A given key value
+ * @return the position, between 0 and the number of keys
+ */
+template <bool orEqual, class N>
+inline int searchSlotted(const N *nodePtr, const StringKey &val)
+{
+	int p = nodePtr->prefixLength;
+	int n = nodePtr->numKeys;
+
+	// a value that does not start with the prefix lies before or after all keys
+	int c = memcmp(keyPrefix(nodePtr), val.data, std::min<int>(p, val.length));
+	if (c < 0)
+	{
+		return n;
+	}
+	if (c > 0 || val.length < p)
+	{
+		return 0;
+	}
+
+	const char *base = (const char *)nodePtr;
+	const KeySlot *slots = keySlots(nodePtr);
+	const char *rest = val.data + p;
+	int restLength = val.length - p;
+	int lo = 0;
+	int hi = n;
+	while (lo < hi)
+	{
+		int mid = (lo + hi) >> 1;
+		int cmp = compareBytes(base + slots[mid].offset, slots[mid].length, rest, restLength);
+		if (orEqual ? cmp <= 0 : cmp < 0)
+		{
+			lo = mid + 1;
+		}
+		else
+		{
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+/**
+ * Start writing the keys of a slotted node from scratch. The items are left to the caller.
+ * @param nodePtr Slotted node
+ * @param numKeys Number of keys to be written
+ * @param prefix Prefix shared by all keys to be written
+ * @param prefixLength Number of characters of the prefix
+ */
+template <class N>
+inline void beginSlotted(N *nodePtr, int numKeys, const char *prefix, int prefixLength)
+{
+	nodePtr->numKeys = numKeys;
+	nodePtr->prefixLength = prefixLength;
+	nodePtr->heapOffset = slottedEnd(nodePtr) - prefixLength;
+	memcpy((char *)nodePtr + nodePtr->heapOffset, prefix, prefixLength);
+}
+
+/**
+ * Write the i-th key of a slotted node started by beginSlotted. The keys must be written in order.
+ * A key equal to the previous one shares its bytes.
+ * @param nodePtr Slotted node
+ * @param i Index of the key
+ * @param key Key, starting with the prefix of the node
+ */
+template <class N>
+inline void setSlottedKey(N *nodePtr, int i, const StringKey &key)
+{
+	int restLength = key.length - nodePtr->prefixLength;
+	const char *rest = key.data + nodePtr->prefixLength;
+	if (i > 0 && slottedRestEquals(nodePtr, i - 1, rest, restLength))
+	{
+		keySlots(nodePtr)[i] = keySlots(nodePtr)[i - 1];
+		return;
+	}
+	nodePtr->heapOffset -= restLength;
+	memcpy((char *)nodePtr + nodePtr->heapOffset, key.data + nodePtr->prefixLength, restLength);
+	keySlots(nodePtr)[i] = {nodePtr->heapOffset, (std::uint16_t)restLength};
+}
+
+/**
+ * Write the given sorted keys in a slotted node from scratch, behind the longest prefix they share.
+ * The items are left to the caller.
+ * @param nodePtr Slotted node
+ * @param keys Sorted keys
+ * @param n Number of keys
+ */
+template <class N>
+inline void fillSlotted(N *nodePtr, const StringKey *keys, int n)
+{
+	if (n == 0)
+	{
+		initSlotted(nodePtr);
+		return;
+	}
+
+	// sorted keys share the prefix shared by the first and the last
+	int p = commonPrefixLength(keys[0].data, keys[0].length, keys[n - 1].data, keys[n - 1].length);
+	beginSlotted(nodePtr, n, keys[0].data, p);
+	for (int i = 0; i < n; ++i)
+	{
+		setSlottedKey(nodePtr, i, keys[i]);
+	}
+}
+
+/**
+ * Number of bytes used in a slotted node once fillSlotted writes the given sorted keys in it.
+ * @param keys Sorted keys
+ * @param n Number of keys
+ * @return the size of the node
+ */
+template <class N>
+inline int filledSlottedSize(const StringKey *keys, int n)
+{
+	if (n == 0)
+	{
+		return slottedSize<N>(0, 0);
+	}
+
+	// the prefix is stored once, and equal keys share the rest
+	int p = commonPrefixLength(keys[0].data, keys[0].length, keys[n - 1].data, keys[n - 1].length);
+	int keyBytes = p;
+	for (int i = 0; i < n; ++i)
+	{
+		if (i == 0 || keys[i] != keys[i - 1])
+		{
+			keyBytes += keys[i].length - p;
+		}
+	}
+	return slottedSize<N>(n, keyBytes);
+}
+
+/**
+ * Rewrite the keys of a slotted node behind a shorter shared prefix.
+ * @param nodePtr Slotted node
+ * @param prefixLength Number of characters of the new prefix, at most that of the current one
+ */
+template <class N>
+void rebuildSlotted(N *nodePtr, int prefixLength)
+{
+	typedef SlottedLayout<N> L;
+	alignas(N) char buf[Page::SIZE];
+	N *tmpPtr = (N *)buf;
+
+	// the header, items and trailer are unchanged
+	int n = nodePtr->numKeys;
+	int end = slottedEnd(nodePtr);
+	memcpy(buf, nodePtr, L::HEADER + (n + L::EXTRA_ITEMS) * sizeof(typename L::Item));
+	memcpy(buf + end, (const char *)nodePtr + end, Page::SIZE - end);
+	beginSlotted(tmpPtr, n, keyPrefix(nodePtr), prefixLength);
+	for (int i = 0; i < n; ++i)
+	{
+		setSlottedKey(tmpPtr, i, slottedKey(nodePtr, i));
+	}
+	memcpy(nodePtr, buf, Page::SIZE);
+}
+
+/**
+ * Write the keys of a slotted node from scratch without some of them and their items.
+ * The items removed are those at the positions of the items that follow the keys.
+ * @param nodePtr Slotted node
+ * @param pos Position of the first key to remove
+ * @param cnt Number of keys to remove
+ */
+template <class N>
+void eraseSlotted(N *nodePtr, int pos, int cnt)
+{
+	typedef SlottedLayout<N> L;
+	typedef typename L::Item Item;
+	alignas(N) char buf[Page::SIZE];
+	N *tmpPtr = (N *)buf;
+
+	// the header, the items around the removed ones and the trailer
+	int n = nodePtr->numKeys;
+	int numItems = n + L::EXTRA_ITEMS;
+	int itemPos = pos + L::EXTRA_ITEMS;
+	int end = slottedEnd(nodePtr);
+	memcpy(buf, nodePtr, L::HEADER + itemPos * sizeof(Item));
+	memcpy(buf + end, (const char *)nodePtr + end, Page::SIZE - end);
+	memcpy(L::items(tmpPtr) + itemPos, L::items(nodePtr) + itemPos + cnt, (numItems - itemPos - cnt) * sizeof(Item));
+
+	// the remaining keys still share the prefix
+	beginSlotted(tmpPtr, n - cnt, keyPrefix(nodePtr), nodePtr->prefixLength);
+	for (int i = 0; i < n - cnt; ++i)
+	{
+		setSlottedKey(tmpPtr, i, slottedKey(nodePtr, i < pos ? i : i + cnt));
+	}
+	memcpy(nodePtr, buf, Page::SIZE);
+}
+
+/**
+ * Check whether a key can be inserted in a slotted node without splitting it.
+ * A key equal to one of the node shares its bytes. A key that does not start with the prefix of the node
+ * shortens the prefix, lengthening the other keys.
+ * @param nodePtr Slotted node
+ * @param key Key to insert
+ * @return whether the key fits
+ */
+template <class N>
+inline bool slottedFits(const N *nodePtr, const StringKey &key)
+{
+	int p = nodePtr->prefixLength;
+	int shared = commonPrefixLength(keyPrefix(nodePtr), p, key.data, key.length);
+	int n = nodePtr->numKeys;
+
+	// the used key bytes are contiguous
+	int end = slottedEnd(nodePtr);
+	int keyBytes = end - nodePtr->heapOffset;
+	if (shared == p)
+	{
+		int pos = searchSlotted<false>(nodePtr, key);
+		if (pos < n && slottedRestEquals(nodePtr, pos, key.data + p, key.length - p))
+		{
+			return slottedSize<N>(n + 1, keyBytes) <= end;
+		}
+		return slottedSize<N>(n + 1, keyBytes + key.length - p) <= end;
+	}
+
+	// each distinct key is lengthened once
+	const KeySlot *slots = keySlots(nodePtr);
+	int distinct = 0;
+	for (int i = 0; i < n; ++i)
+	{
+		distinct += i == 0 || slots[i].offset != slots[i - 1].offset || slots[i].length != slots[i - 1].length;
+	}
+	return slottedSize<N>(n + 1, keyBytes + distinct * (p - shared) + key.length - p) <= end;
+}
+
+/**
+ * Insert a key and its item in a slotted node, assuming it fits.
+ * The key is stored at position pos, and the item at the position of the item that follows the key.
+ * @param nodePtr Slotted node
+ * @param pos Insert position of the key
+ * @param key Key to insert
+ * @param item Item to insert
+ */
+template <class N>
+void insertSlotted(N *nodePtr, int pos, const StringKey &key, const typename SlottedLayout<N>::Item &item)
+{
+	typedef SlottedLayout<N> L;
+	typedef typename L::Item Item;
+
+	int shared = commonPrefixLength(keyPrefix(nodePtr), nodePtr->prefixLength, key.data, key.length);
+	if (shared < nodePtr->prefixLength)
+	{
+		rebuildSlotted(nodePtr, shared);
+	}
+
+	int n = nodePtr->numKeys;
+	int numItems = n + L::EXTRA_ITEMS;
+	Item *items = L::items(nodePtr);
+	KeySlot *slots = keySlots(nodePtr);
+	KeySlot *newSlots = (KeySlot *)(items + numItems + 1);
+
+	// shift the key slots past the new item, leaving room for the new slot
+	memmove(newSlots + pos + 1, slots + pos, (n - pos) * sizeof(KeySlot));
+	memmove(newSlots, slots, pos * sizeof(KeySlot));
+
+	int itemPos = pos + L::EXTRA_ITEMS;
+	memmove(items + itemPos + 1, items + itemPos, (numItems - itemPos) * sizeof(Item));
+	items[itemPos] = item;
+
+	++nodePtr->numKeys;
+
+	// share the bytes of an equal neighbour
+	const char *rest = key.data + nodePtr->prefixLength;
+	int restLength = key.length - nodePtr->prefixLength;
+	if (pos > 0 && slottedRestEquals(nodePtr, pos - 1, rest, restLength))
+	{
+		newSlots[pos] = newSlots[pos - 1];
+	}
+	else if (pos < n && slottedRestEquals(nodePtr, pos + 1, rest, restLength))
+	{
+		newSlots[pos] = newSlots[pos + 1];
+	}
+	else
+	{
+		nodePtr->heapOffset -= restLength;
+		memcpy((char *)nodePtr + nodePtr->heapOffset, rest, restLength);
+		newSlots[pos] = {nodePtr->heapOffset, (std::uint16_t)restLength};
+	}
+}
+
+/**
+ * Replace a key of a slotted node by another one lying between the same neighbours, if it fits.
+ * The items are unchanged.
+ * @param nodePtr Slotted node
+ * @param pos Position of the key
+ * @param key New key
+ * @return whether the key has been replaced or not
+ */
+template <class N>
+bool replaceSlottedKey(N *nodePtr, int pos, const StringKey &key)
+{
+	typedef SlottedLayout<N> L;
+	int itemPos = pos + L::EXTRA_ITEMS;
+	typename L::Item item = L::items(nodePtr)[itemPos];
+	StringKey old = slottedKey(nodePtr, pos);
+
+	// the old key always fits back in the bytes it has freed
+	eraseSlotted(nodePtr, pos, 1);
+	bool fits = slottedFits(nodePtr, key);
+	insertSlotted(nodePtr, pos, fits ? key : old, item);
+	return fits;
+}
+
+/**
+ * Find the cutoff of the given bound in the keys of a STRING non leaf node.
+ * @see searchBoundKey
+ */
+template <Operator op>
+inline int searchBoundKey(const NonLeafNodeString *nodePtr, const StringKey &val)
+{
+	return searchSlotted<OperatorTraits<op>::orEqual>(nodePtr, val);
+}
+
+/**
+ * Find the cutoff of the given bound in the keys of a STRING leaf node.
+ * @see searchBoundKey
+ */
+template <Operator op>
+inline int searchBoundKey(const LeafNodeString *leafPtr, const StringKey &val)
+{
+	return searchSlotted<OperatorTraits<op>::orEqual>(leafPtr, val);
+}
+
+/**
+ * Get the i-th key of a STRING non leaf node.
+ * @see nodeKey
+ */
+inline StringKey nodeKey(const NonLeafNodeString *nodePtr, int i)
+{
+	return slottedKey(nodePtr, i);
+}
+
+/**
+ * Get the i-th key of a STRING leaf node.
+ * @see nodeKey
+ */
+inline StringKey nodeKey(const LeafNodeString *leafPtr, int i)
+{
+	return slottedKey(leafPtr, i);
+}
+
+/**
+ * Get the high key stored in the trailer of a slotted node.
+ * Its length is clamped, since the node may be read while it changes.
+ * @param nodePtr Slotted node
+ * @return the high key
+ */
+template <class N>
+inline StringKey slottedHighKey(const N *nodePtr)
+{
+	StringKey key;
+	memcpy(&key, (const char *)nodePtr + slottedCapacity<N>(), sizeof(StringKey));
+	key.length = std::min<int>(key.length, STRINGSIZE);
+	return key;
+}
+
+/**
+ * Get the high key of a STRING leaf node.
+ * @see highKey
+ */
+inline StringKey highKey(const LeafNodeString *leafPtr)
+{
+	return slottedHighKey(leafPtr);
+}
+
+/**
+ * Set the high key of an INDEX_FORMAT_V6 STRING leaf node.
+ * @see setHighKey
+ */
+inline void setHighKey(LeafNodeString *leafPtr, const StringKey &key)
+{
+	memcpy((char *)leafPtr + slottedCapacity<LeafNodeString>(), &key, sizeof(StringKey));
+	leafPtr->hasHighKey = 1;
+}
+
+/**
+ * Get the right link of a STRING non leaf node, stored at the end of its trailer.
+ * @see rightLink
+ */
+inline PageId rightLink(const NonLeafNodeString *nodePtr)
+{
+	if (nodePtr->format < INDEX_FORMAT_V6)
+	{
+		return Page::INVALID_NUMBER;
+	}
+	PageId rightPageNo;
+	memcpy(&rightPageNo, (const char *)nodePtr + Page::SIZE - sizeof(PageId), sizeof(PageId));
+	return rightPageNo;
+}
+
+/**
+ * Check whether a STRING non leaf node has a high key.
+ * @see hasHighKey
+ */
+inline bool hasHighKey(const NonLeafNodeString *nodePtr)
+{
+	return rightLink(nodePtr) != Page::INVALID_NUMBER;
+}
+
+/**
+ * Get the high key of a STRING non leaf node.
+ * @see highKey
+ */
+inline StringKey highKey(const NonLeafNodeString *nodePtr)
+{
+	return slottedHighKey(nodePtr);
+}
+
+/**
+ * Set the right link and the high key of an INDEX_FORMAT_V6 STRING non leaf node.
+ * @see setRightLink
+ */
+inline void setRightLink(NonLeafNodeString *nodePtr, PageId rightPageNo, const StringKey &key)
+{
+	memcpy((char *)nodePtr + Page::SIZE - sizeof(PageId), &rightPageNo, sizeof(PageId));
+	memcpy((char *)nodePtr + slottedCapacity<NonLeafNodeString>(), &key, sizeof(StringKey));
+}
+
+}
@@ -62,6 +62,18 @@ struct RecordId {
   bool operator!=(const RecordId& rhs) const {
     return (page_number != rhs.page_number) || (slot_number != rhs.slot_number);
   }
+
+  /**
+   * Returns true if this record ID comes before the given ID in page and slot order.
+   *
+   * @param rhs   Record ID to compare against.
+   * @return  Whether this ID orders before the other one.
+   */
+  bool operator<(const RecordId& rhs) const {
+    return page_number != rhs.page_number
+        ? page_number < rhs.page_number
+        : slot_number < rhs.slot_number;
+  }
 };
 
 }